@@ -0,0 +1,69 @@
+/**
+ * Cultivio AquaSense - Microbenchmark Firmware
+ *
+ * Runs the shared/bench suite (bench_kernels.h) on the target with the CPU
+ * cycle counter, prints a table, then the results as JSON between marker
+ * lines. Capture and compare with the host runner:
+ *
+ *   idf.py -p PORT flash monitor | tee bench.log
+ *   bench_host --compare bench.log       (or keep bench.log as a baseline)
+ *
+ * The label is the app version, `git describe` of the tree when built.
+ */
+
+#include <stdio.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_log.h"
+#include "esp_app_desc.h"
+#include "nvs_flash.h"
+#include "ble_provision.h"
+#include "bench.h"
+#include "bench_kernels.h"
+
+static const char *TAG = "BENCH";
+
+#define JSON_BEGIN  "----- AQBENCH JSON BEGIN -----"
+#define JSON_END    "----- AQBENCH JSON END -----"
+
+static bench_result_t s_results[16];
+
+void app_main(void)
+{
+    esp_err_t ret = nvs_flash_init();
+    if (ret == ESP_ERR_NVS_NO_FREE_PAGES || ret == ESP_ERR_NVS_NEW_VERSION_FOUND) {
+        ESP_ERROR_CHECK(nvs_flash_erase());
+        ret = nvs_flash_init();
+    }
+    ESP_ERROR_CHECK(ret);
+
+    // Config and status paths need the provisioning core, not the radio
+    ESP_ERROR_CHECK(ble_provision_init(NODE_TYPE_SENSOR));
+    ESP_ERROR_CHECK(bench_kernels_setup());
+
+    const bench_case_t *cases;
+    int count = bench_kernels(&cases);
+    if (count > (int)(sizeof(s_results) / sizeof(s_results[0]))) {
+        count = sizeof(s_results) / sizeof(s_results[0]);
+    }
+    bench_config_t cfg = BENCH_CONFIG_DEFAULT();
+    ESP_LOGI(TAG, "%d benchmarks, %lu samples after %lu warmup, %llu Hz %s", count,
+             (unsigned long)cfg.samples, (unsigned long)cfg.warmup,
+             (unsigned long long)bench_port_cycle_hz(), bench_port_clock());
+
+    for (int i = 0; i < count; i++) {
+        ESP_ERROR_CHECK(bench_run(&cases[i], &cfg, &s_results[i]));
+        bench_print(stdout, &s_results[i], i == 0);
+        vTaskDelay(1);      // Let the idle task feed the watchdog
+    }
+
+    bench_json_t json;
+    printf("%s\n", JSON_BEGIN);
+    bench_json_open(&json, stdout, esp_app_get_description()->version, &cfg);
+    for (int i = 0; i < count; i++) {
+        bench_json_add(&json, &s_results[i]);
+    }
+    bench_json_close(&json);
+    printf("%s\n", JSON_END);
+    ESP_LOGI(TAG, "Done");
+}
@@ -22,6 +22,10 @@
 #include "ha/esp_zigbee_ha_standard.h"
 
 #include "ble_provision.h"
+#include "config_derived.h"
+#include "node_hal.h"
+#include "pump_control.h"
+#include "trace.h"
 #include "cultivio_brand.h"
 
 /* ============================================================================
@@ -30,14 +34,13 @@
 
 static const char *TAG = "CONTROLLER";
 
-// Hardware Pins (ESP32-H2 Mini compatible)
-#define PUMP_RELAY_PIN          GPIO_NUM_2      // Relay to control pump
-#define LED_STATUS_PIN          GPIO_NUM_8      // Status LED
-#define LED_PUMP_PIN            GPIO_NUM_9      // Pump running indicator
-#define BUTTON_PIN              GPIO_NUM_10     // Button for provisioning mode
+// Hardware Pins (ESP32-H2 Mini compatible, see node_hal.h)
+#define PUMP_RELAY_PIN          NODE_PIN_RELAY          // Relay to control pump
+#define LED_STATUS_PIN          NODE_PIN_LED_STATUS     // Status LED
+#define LED_PUMP_PIN            NODE_PIN_LED_ACTIVITY   // Pump running indicator
+#define BUTTON_PIN              NODE_PIN_BUTTON         // Button for provisioning mode
 
 // Timing
-#define SENSOR_TIMEOUT_MS       30000   // Sensor offline after 30 seconds
 #define STATUS_UPDATE_MS        1000    // Status check interval
 #define DEBOUNCE_DELAY_MS       50      // Button debounce delay
 #define BUTTON_CHECK_INTERVAL_MS 100    // Button press check interval
@@ -45,7 +48,6 @@ static const char *TAG = "CONTROLLER";
 #define LED_BLINK_MEDIUM_MS     100     // Medium LED blink
 #define LED_BLINK_LONG_MS       200     // Long LED blink
 #define PROVISIONING_HOLD_COUNT 30      // 3 seconds at 100ms intervals
-#define MAX_PUMP_TIMEOUT_SEC    7200    // 2 hour safety limit
 
 // Zigbee configuration
 #define CONTROLLER_ENDPOINT     1
@@ -61,29 +63,21 @@ static const char *TAG = "CONTROLLER";
 
 static device_config_t g_config;
 
-// Received sensor data
-static uint8_t  g_water_level_percent = 0;
+// Received sensor data (level and last update time live in g_pump)
 static uint16_t g_water_level_cm = 0;
 static uint8_t  g_sensor_status = 0xFF;  // FIX: BUG #13 - Removed unused attribute, will be updated
-static int64_t  g_last_sensor_update_us = 0;  // FIX: Use 64-bit microseconds to avoid 49-day overflow
 
-// Signal strength tracking
+// Signal strength tracking: the sensor's neighbour table entry once it has
+// reported, else the best neighbour
+static uint16_t g_sensor_addr = NODE_ZB_PEER_ANY;
 static int8_t   g_last_rssi = -100;
 static uint8_t  g_signal_quality = 0;
 
-// Pump control
-static bool     g_pump_running = false;
-static uint32_t g_pump_start_time = 0;
-static uint8_t  g_pump_state_attr = 0;
-
-// Manual override
-static bool     g_manual_override = false;
-static uint32_t g_manual_override_end_time = 0;
-static uint16_t g_manual_duration_min = 0;
+// Pump control and manual override (shared/node_logic, 64-bit time)
+static pump_control_t g_pump;
 
 // Zigbee
 static bool     g_zigbee_started = false;
-static bool     g_sensor_connected = false;
 static bool     g_provisioning_mode = false;
 
 // FIX: BUG #12 - Zigbee network formation retry limit
@@ -120,11 +114,6 @@ static void button_init(void)
     gpio_config(&btn_conf);
 }
 
-static void led_set_pump(bool on)
-{
-    gpio_set_level(LED_PUMP_PIN, on ? 1 : 0);
-}
-
 static void led_blink(int pin, int times, int delay_ms)
 {
     for (int i = 0; i < times; i++) {
@@ -149,57 +138,16 @@ static void pump_init(void)
         .intr_type = GPIO_INTR_DISABLE
     };
     gpio_config(&relay_conf);
-    gpio_set_level(PUMP_RELAY_PIN, 0);
+    pump_control_init(&g_pump);
     ESP_LOGI(TAG, "Pump relay initialized (OFF)");
 }
 
-static void pump_on(void)
-{
-    if (!g_pump_running) {
-        gpio_set_level(PUMP_RELAY_PIN, 1);
-        g_pump_running = true;
-        g_pump_start_time = esp_timer_get_time() / 1000000;  // FIX: Use esp_timer for consistency
-        g_pump_state_attr = 1;
-        led_set_pump(true);
-        ESP_LOGI(TAG, ">>> PUMP ON <<< Water level: %d%%", g_water_level_percent);
-    }
-}
-
-static void pump_off(void)
-{
-    // Clear manual override when pump is turned off
-    if (g_manual_override) {
-        g_manual_override = false;
-        g_manual_override_end_time = 0;
-        g_manual_duration_min = 0;
-        ESP_LOGI(TAG, "Manual override cleared");
-    }
-    
-    if (g_pump_running) {
-        gpio_set_level(PUMP_RELAY_PIN, 0);
-        g_pump_running = false;
-        g_pump_state_attr = 0;
-        led_set_pump(false);
-        
-        // FIX: Use esp_timer for consistent time calculation
-        uint32_t runtime = (uint32_t)(esp_timer_get_time() / 1000000) - g_pump_start_time;
-        ESP_LOGI(TAG, ">>> PUMP OFF <<< Runtime: %lu seconds", runtime);
-    }
-}
-
 // Manual pump command handler - called from BLE
 static void manual_pump_cmd_handler(const manual_pump_cmd_t *cmd)
 {
-    if (cmd->command == PUMP_CMD_START_TIMED && cmd->duration_minutes > 0) {
-        // Start manual override
-        // FIX: BUG #8 - Use esp_timer for 64-bit time (no overflow after 49 days)
-        g_manual_override = true;
-        g_manual_duration_min = cmd->duration_minutes;
-        g_manual_override_end_time = (esp_timer_get_time() / 1000000) + (cmd->duration_minutes * 60);
-        
-        ESP_LOGW(TAG, ">>> MANUAL OVERRIDE: Pump ON for %d minutes <<<", cmd->duration_minutes);
-        pump_on();
-        
+    pump_control_manual(&g_pump, cmd);
+    
+    if (g_pump.manual_override) {
         // Triple blink to indicate manual mode
         for (int i = 0; i < 3; i++) {
             gpio_set_level(LED_STATUS_PIN, 0);
@@ -207,106 +155,6 @@ static void manual_pump_cmd_handler(const manual_pump_cmd_t *cmd)
             gpio_set_level(LED_STATUS_PIN, 1);
             vTaskDelay(pdMS_TO_TICKS(100));
         }
-    } else {
-        // Stop manual override
-        ESP_LOGW(TAG, ">>> MANUAL OVERRIDE: Pump STOP <<<");
-        g_manual_override = false;
-        g_manual_override_end_time = 0;
-        g_manual_duration_min = 0;
-        pump_off();
-    }
-}
-
-static void pump_control_logic(void)
-{
-    // FIX: Use esp_timer consistently for all time comparisons (avoids 49-day overflow)
-    int64_t now_us = esp_timer_get_time();
-    uint32_t now_sec = (uint32_t)(now_us / 1000000);
-    
-    // Sensor timeout check using 64-bit time (no overflow)
-    int64_t sensor_elapsed_ms = (now_us - g_last_sensor_update_us) / 1000;
-    bool sensor_online = sensor_elapsed_ms < SENSOR_TIMEOUT_MS && g_last_sensor_update_us > 0;
-    
-    // Get thresholds from config
-    uint8_t pump_on_threshold = g_config.pump_on_threshold > 0 ? g_config.pump_on_threshold : 20;
-    uint8_t pump_off_threshold = g_config.pump_off_threshold > 0 ? g_config.pump_off_threshold : 80;
-    
-    // FIX: BUG #3 - Use uint32_t to prevent overflow when multiplying by 60
-    uint32_t pump_timeout_sec = g_config.pump_timeout_minutes > 0 ? 
-                                ((uint32_t)g_config.pump_timeout_minutes * 60) : 3600;
-    
-    // Safety limit: Max 2 hours
-    if (pump_timeout_sec > MAX_PUMP_TIMEOUT_SEC) {
-        ESP_LOGW(TAG, "Pump timeout capped at 2 hours for safety (was %lu)", pump_timeout_sec);
-        pump_timeout_sec = MAX_PUMP_TIMEOUT_SEC;
-    }
-    
-    // ========== MANUAL OVERRIDE MODE ==========
-    if (g_manual_override) {
-        // Check if manual override has expired
-        if (now_sec >= g_manual_override_end_time) {
-            ESP_LOGW(TAG, "Manual override expired after %d minutes", g_manual_duration_min);
-            g_manual_override = false;
-            g_manual_override_end_time = 0;
-            g_manual_duration_min = 0;
-            pump_off();
-            return;
-        }
-        
-        // Keep pump running in manual mode
-        if (!g_pump_running) {
-            pump_on();
-        }
-        
-        // Log remaining time every 30 seconds
-        static uint32_t last_log_time = 0;
-        if (now_sec - last_log_time >= 30) {
-            uint32_t remaining = g_manual_override_end_time - now_sec;
-            ESP_LOGI(TAG, "MANUAL MODE: %lu min %lu sec remaining", 
-                     remaining / 60, remaining % 60);
-            last_log_time = now_sec;
-        }
-        return; // Skip automatic control in manual mode
-    }
-    
-    // ========== AUTOMATIC MODE ==========
-    if (!sensor_online) {
-        if (g_sensor_connected) {
-            ESP_LOGW(TAG, "Sensor offline!");
-            g_sensor_connected = false;
-        }
-        // In automatic mode, turn off pump if sensor is offline
-        // (unless manual override is active - handled above)
-        if (g_pump_running) {
-            ESP_LOGW(TAG, "Turning pump OFF - sensor timeout");
-            pump_off();
-        }
-        return;
-    }
-    
-    if (!g_sensor_connected) {
-        ESP_LOGI(TAG, "Sensor online");
-        g_sensor_connected = true;
-    }
-
-    // Check pump timeout
-    if (g_pump_running) {
-        uint32_t runtime = now_sec - g_pump_start_time;
-        if (runtime >= pump_timeout_sec) {
-            ESP_LOGW(TAG, "Pump timeout after %lu seconds", runtime);
-            pump_off();
-            return;
-        }
-    }
-
-    // Control logic
-    if (g_water_level_percent <= pump_on_threshold && !g_pump_running) {
-        ESP_LOGI(TAG, "Water LOW (%d%% <= %d%%), pump ON", g_water_level_percent, pump_on_threshold);
-        pump_on();
-    }
-    else if (g_water_level_percent >= pump_off_threshold && g_pump_running) {
-        ESP_LOGI(TAG, "Water HIGH (%d%% >= %d%%), pump OFF", g_water_level_percent, pump_off_threshold);
-        pump_off();
     }
 }
 
@@ -333,7 +181,7 @@ static esp_zb_cluster_list_t *create_controller_clusters(void)
     
     esp_zb_custom_cluster_add_custom_attr(water_cluster, ATTR_WATER_LEVEL_PCT,
         ESP_ZB_ZCL_ATTR_TYPE_U8, ESP_ZB_ZCL_ATTR_ACCESS_READ_WRITE,
-        &g_water_level_percent);
+        &g_pump.water_level_pct);
     
     esp_zb_custom_cluster_add_custom_attr(water_cluster, ATTR_WATER_LEVEL_CM,
         ESP_ZB_ZCL_ATTR_TYPE_U16, ESP_ZB_ZCL_ATTR_ACCESS_READ_WRITE,
@@ -341,7 +189,7 @@ static esp_zb_cluster_list_t *create_controller_clusters(void)
     
     esp_zb_custom_cluster_add_custom_attr(water_cluster, ATTR_PUMP_STATE,
         ESP_ZB_ZCL_ATTR_TYPE_U8, ESP_ZB_ZCL_ATTR_ACCESS_READ_ONLY,
-        &g_pump_state_attr);
+        &g_pump.state_attr);
 
     esp_zb_cluster_list_add_custom_cluster(cluster_list, water_cluster, ESP_ZB_ZCL_CLUSTER_CLIENT_ROLE);
 
@@ -355,9 +203,8 @@ static esp_err_t zb_action_handler(esp_zb_core_action_callback_id_t callback_id,
             esp_zb_zcl_set_attr_value_message_t *msg = (esp_zb_zcl_set_attr_value_message_t *)message;
             if (msg->info.cluster == CLUSTER_WATER_LEVEL) {
                 if (msg->attribute.id == ATTR_WATER_LEVEL_PCT) {
-                    g_water_level_percent = *(uint8_t *)msg->attribute.data.value;
-                    g_last_sensor_update_us = esp_timer_get_time();  // FIX: Use 64-bit time
-                    ESP_LOGI(TAG, "Received water level: %d%%", g_water_level_percent);
+                    pump_control_sensor_update(&g_pump, *(uint8_t *)msg->attribute.data.value);
+                    TRACE(LEVEL_WRITE, g_pump.water_level_pct);
                 }
                 else if (msg->attribute.id == ATTR_WATER_LEVEL_CM) {
                     g_water_level_cm = *(uint16_t *)msg->attribute.data.value;
@@ -375,9 +222,9 @@ static esp_err_t zb_action_handler(esp_zb_core_action_callback_id_t callback_id,
             esp_zb_zcl_report_attr_message_t *msg = (esp_zb_zcl_report_attr_message_t *)message;
             if (msg->cluster == CLUSTER_WATER_LEVEL) {
                 if (msg->attribute.id == ATTR_WATER_LEVEL_PCT) {
-                    g_water_level_percent = *(uint8_t *)msg->attribute.data.value;
-                    g_last_sensor_update_us = esp_timer_get_time();  // FIX: Use 64-bit time
-                    ESP_LOGI(TAG, "Report - Water: %d%%", g_water_level_percent);
+                    pump_control_sensor_update(&g_pump, *(uint8_t *)msg->attribute.data.value);
+                    g_sensor_addr = msg->src_address.u.short_addr;
+                    TRACE(REPORT_RX, g_sensor_addr, g_pump.water_level_pct);
                     led_blink(LED_STATUS_PIN, 1, LED_BLINK_SHORT_MS);
                 }
                 // FIX: BUG #13 - Update sensor status from Zigbee reports
@@ -510,7 +357,6 @@ static void zigbee_task(void *pvParameters)
  * ============================================================================ */
 
 static uint32_t g_uptime_seconds = 0;
-static uint32_t g_pump_runtime_total = 0;
 
 static void control_task(void *pvParameters)
 {
@@ -519,43 +365,34 @@ static void control_task(void *pvParameters)
         esp_task_wdt_reset();
         
         if (!g_provisioning_mode) {
-            pump_control_logic();
+            // Thresholds from the live derived config: defaults, hysteresis
+            // band and the 2 hour cap are resolved once per config change
+            config_derived_t dc;
+            ble_provision_config_derived(&dc);
+            pump_control_step(&g_pump, &dc);
             
-            // Calculate manual override remaining time
-            // FIX: BUG #8 - Use esp_timer for consistent time calculation
-            uint32_t manual_remaining = 0;
-            uint32_t current_time_sec = esp_timer_get_time() / 1000000;
-            if (g_manual_override && g_manual_override_end_time > current_time_sec) {
-                manual_remaining = g_manual_override_end_time - current_time_sec;
+            node_zb_link_t link;
+            esp_zb_lock_acquire(portMAX_DELAY);
+            if (node_hal_zb_link_quality(g_sensor_addr, &link) == ESP_OK) {
+                g_last_rssi = link.rssi_dbm;
+                g_signal_quality = NODE_ZB_LQI_TO_PCT(link.lqi);
             }
+            esp_zb_lock_release();
             
             // Update BLE status for mobile monitoring
             device_status_t status = {
                 .node_type = NODE_TYPE_CONTROLLER,
                 .zigbee_connected = g_zigbee_started,
                 .uptime_seconds = g_uptime_seconds,
-                .water_level_percent = g_water_level_percent,
-                .water_level_cm = 0,
-                .sensor_status = g_sensor_connected ? 0 : 1,
-                .pump_active = g_pump_running,
-                .pump_runtime_sec = g_pump_runtime_total,
-                .last_water_level = g_water_level_percent,
                 .last_update_time = g_uptime_seconds,
-                .manual_override = g_manual_override,
-                .manual_remaining_sec = manual_remaining,
                 .rssi_dbm = g_last_rssi,
                 .signal_quality = g_signal_quality
             };
-            ble_status_update(&status);
-            
-            // Track pump runtime
-            if (g_pump_running) {
-                g_pump_runtime_total++;
-            }
+            pump_control_report_status(&g_pump, &status);
             g_uptime_seconds++;
             
             if (g_zigbee_started) {
-                if (g_sensor_connected) {
+                if (g_pump.sensor_connected) {
                     gpio_set_level(LED_STATUS_PIN, 1);
                 } else {
                     static bool toggle = false;
@@ -567,10 +404,7 @@ static void control_task(void *pvParameters)
             static int log_counter = 0;
             if (++log_counter >= 10) {
                 log_counter = 0;
-                ESP_LOGI(TAG, "Water=%d%%, Pump=%s, Sensor=%s",
-                         g_water_level_percent,
-                         g_pump_running ? "ON" : "OFF",
-                         g_sensor_connected ? "Online" : "Offline");
+                TRACE(CTRL_STATUS, g_pump.water_level_pct, g_pump.running, g_pump.sensor_connected);
             }
         }
         
@@ -710,6 +544,7 @@ void app_main(void)
     
     led_blink(LED_STATUS_PIN, 2, 200);
     ESP_LOGI(TAG, "Hardware initialized");
+    trace_start_task(TRACE_OUTPUT_LOG, tskIDLE_PRIORITY + 1);
 
     // Initialize provisioning
     ble_provision_init(NODE_TYPE_CONTROLLER);
@@ -0,0 +1,163 @@
+/*
+ * Cultivio AquaSense - Microbenchmark Runner (host)
+ * The shared/bench suite on Linux, against the real firmware sources.
+ *
+ * Usage: bench_host [--samples N] [--warmup N] [--filter TEXT] [--list]
+ *                   [--json FILE] [--label TEXT]
+ *                   [--compare BASELINE.json] [--threshold PCT]
+ *
+ * Prints a table of per-call cycles (TSC) and ns; --json writes the same
+ * results for later runs to compare against. --compare matches the
+ * benchmarks of a baseline by name (host or device JSON, log text around it
+ * is fine) and fails if a median got more than --threshold percent slower
+ * (default 10). Host figures rank changes; absolute costs come from the
+ * device app (firmware/bench_esp32).
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "esp_log.h"
+#include "ble_provision.h"
+#include "ble_backend_posix.h"
+#include "node_hal_posix.h"
+#include "nvs_posix.h"
+#include "bench.h"
+#include "bench_kernels.h"
+
+#define DEFAULT_THRESHOLD_PCT   10.0
+
+static char *read_file(const char *path)
+{
+    FILE *f = fopen(path, "rb");
+    if (f == NULL) {
+        return NULL;
+    }
+    fseek(f, 0, SEEK_END);
+    long size = ftell(f);
+    fseek(f, 0, SEEK_SET);
+    char *text = size >= 0 ? malloc((size_t)size + 1) : NULL;
+    if (text != NULL) {
+        size_t n = fread(text, 1, (size_t)size, f);
+        text[n] = '\0';
+    }
+    fclose(f);
+    return text;
+}
+
+int main(int argc, char **argv)
+{
+    bench_config_t cfg = BENCH_CONFIG_DEFAULT();
+    const char *filter = NULL;
+    const char *json_file = NULL;
+    const char *label = "";
+    const char *baseline_file = NULL;
+    double threshold = DEFAULT_THRESHOLD_PCT;
+    bool list = false;
+    bool usage = false;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--samples") == 0 && i + 1 < argc) {
+            cfg.samples = (uint32_t)atol(argv[++i]);
+        } else if (strcmp(argv[i], "--warmup") == 0 && i + 1 < argc) {
+            cfg.warmup = (uint32_t)atol(argv[++i]);
+        } else if (strcmp(argv[i], "--filter") == 0 && i + 1 < argc) {
+            filter = argv[++i];
+        } else if (strcmp(argv[i], "--json") == 0 && i + 1 < argc) {
+            json_file = argv[++i];
+        } else if (strcmp(argv[i], "--label") == 0 && i + 1 < argc) {
+            label = argv[++i];
+        } else if (strcmp(argv[i], "--compare") == 0 && i + 1 < argc) {
+            baseline_file = argv[++i];
+        } else if (strcmp(argv[i], "--threshold") == 0 && i + 1 < argc) {
+            threshold = atof(argv[++i]);
+        } else if (strcmp(argv[i], "--list") == 0) {
+            list = true;
+        } else {
+            usage = true;
+        }
+    }
+    if (usage || cfg.samples == 0 || cfg.samples > BENCH_MAX_SAMPLES || threshold <= 0) {
+        fprintf(stderr, "usage: %s [--samples 1..%d] [--warmup N] [--filter TEXT] [--list]\n"
+                        "       [--json FILE] [--label TEXT] [--compare BASELINE.json] [--threshold PCT]\n",
+                argv[0], BENCH_MAX_SAMPLES);
+        return 2;
+    }
+
+    const bench_case_t *cases;
+    int count = bench_kernels(&cases);
+    if (list) {
+        for (int i = 0; i < count; i++) {
+            printf("%s\n", cases[i].name);
+        }
+        return 0;
+    }
+
+    char *baseline = NULL;
+    if (baseline_file != NULL && (baseline = read_file(baseline_file)) == NULL) {
+        fprintf(stderr, "cannot read %s\n", baseline_file);
+        return 2;
+    }
+    bench_json_t json = { 0 };
+    FILE *json_out = NULL;
+    if (json_file != NULL && (json_out = fopen(json_file, "w")) == NULL) {
+        fprintf(stderr, "cannot write %s\n", json_file);
+        return 2;
+    }
+
+    // The provisioning core as on a fresh sensor, no radio
+    esp_log_level_set("*", ESP_LOG_WARN);
+    node_hal_posix_reset(NODE_HAL_CLOCK_VIRTUAL);
+    nvs_posix_reset();
+    ble_backend_posix_reset();
+    ble_provision_init(NODE_TYPE_SENSOR);
+    if (bench_kernels_setup() != ESP_OK) {
+        fprintf(stderr, "bench setup failed\n");
+        return 1;
+    }
+
+    printf("Clock:          %s, %.3f GHz, %lu samples after %lu warmup\n", bench_port_clock(),
+           bench_port_cycle_hz() / 1e9, (unsigned long)cfg.samples, (unsigned long)cfg.warmup);
+    if (json_out != NULL) {
+        bench_json_open(&json, json_out, label, &cfg);
+    }
+
+    int ran = 0, regressions = 0, missing = 0;
+    for (int i = 0; i < count; i++) {
+        if (filter != NULL && strstr(cases[i].name, filter) == NULL) {
+            continue;
+        }
+        bench_result_t r;
+        bench_run(&cases[i], &cfg, &r);
+        bench_print(stdout, &r, ran++ == 0);
+        if (json_out != NULL) {
+            bench_json_add(&json, &r);
+        }
+        if (baseline != NULL) {
+            double base_ns;
+            if (bench_json_find(baseline, r.name, "median_ns", &base_ns) != ESP_OK || base_ns <= 0) {
+                missing++;
+                continue;
+            }
+            double change = (r.median_ns - base_ns) * 100.0 / base_ns;
+            bool slower = change > threshold;
+            regressions += slower;
+            printf("  vs baseline:  %.1f -> %.1f ns (%+.1f%%)%s\n", base_ns, r.median_ns, change,
+                   slower ? "  REGRESSION" : "");
+        }
+    }
+    if (json_out != NULL) {
+        bench_json_close(&json);
+        fclose(json_out);
+        printf("JSON:           %d benchmarks to %s\n", ran, json_file);
+    }
+
+    if (baseline != NULL) {
+        free(baseline);
+        printf("Compare:        %d slower than +%.0f%%, %d not in the baseline\n",
+               regressions, threshold, missing);
+        return regressions > 0 ? 1 : 0;
+    }
+    return ran > 0 ? 0 : 1;
+}
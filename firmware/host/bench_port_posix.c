@@ -0,0 +1,64 @@
+/*
+ * Host build: microbenchmark clock
+ * The TSC on x86-64 (invariant on anything recent: constant rate, not CPU
+ * cycles under frequency scaling), calibrated once against CLOCK_MONOTONIC;
+ * CLOCK_MONOTONIC in ns elsewhere.
+ */
+
+#include "bench.h"
+
+#include <time.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define HAVE_TSC 1
+#else
+#define HAVE_TSC 0
+#endif
+
+#define CALIBRATE_NS    20000000LL
+
+static int64_t mono_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+uint64_t bench_port_cycles(void)
+{
+#if HAVE_TSC
+    return __rdtsc();
+#else
+    return (uint64_t)mono_ns();
+#endif
+}
+
+uint64_t bench_port_cycle_hz(void)
+{
+#if HAVE_TSC
+    static uint64_t s_hz;
+    if (s_hz == 0) {
+        int64_t start_ns = mono_ns();
+        uint64_t start = __rdtsc();
+        int64_t took_ns;
+        do {
+            took_ns = mono_ns() - start_ns;
+        } while (took_ns < CALIBRATE_NS);
+        s_hz = (uint64_t)((double)(__rdtsc() - start) * 1e9 / took_ns);
+    }
+    return s_hz;
+#else
+    return 1000000000ULL;
+#endif
+}
+
+const char *bench_port_clock(void)
+{
+    return HAVE_TSC ? "rdtsc" : "clock_gettime";
+}
+
+const char *bench_port_platform(void)
+{
+    return "host";
+}
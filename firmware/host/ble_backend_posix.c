@@ -0,0 +1,193 @@
+/*
+ * Host build: BLE backend on POSIX
+ * Implements ble_provision_priv.h without a radio. Advertising and
+ * connections are state only; writes and status reads go straight to the
+ * core callbacks, as from the BLE host task on target.
+ */
+
+#include "ble_provision_priv.h"
+#include "ble_backend_posix.h"
+#include <stdio.h>
+#include <string.h>
+#include "esp_mac.h"
+#include "esp_system.h"
+
+static const uint8_t s_default_mac[6] = { 0x60, 0x55, 0xF9, 0x00, 0xA3, 0xB2 };
+
+static uint8_t s_mac[6] = { 0x60, 0x55, 0xF9, 0x00, 0xA3, 0xB2 };
+static char s_name[32];
+static ble_backend_posix_stats_t s_stats;
+static uint16_t s_nimble_mtu;           // 0: offset reads (Bluedroid)
+
+/* ============================================================================
+ * ESP-IDF PIECES THE CORE CALLS
+ * ============================================================================ */
+
+esp_err_t esp_read_mac(uint8_t *mac, esp_mac_type_t type)
+{
+    (void)type;
+    memcpy(mac, s_mac, sizeof(s_mac));
+    return ESP_OK;
+}
+
+/* ============================================================================
+ * BACKEND API
+ * ============================================================================ */
+
+esp_err_t ble_backend_start(void)
+{
+    s_stats.stack_up = true;
+    ble_core_on_host_ready();
+    return ble_backend_adv_start();
+}
+
+esp_err_t ble_backend_stop(void)
+{
+    s_stats.advertising = false;
+    s_stats.connected = false;
+    s_stats.stack_up = false;
+    return ESP_OK;
+}
+
+esp_err_t ble_backend_set_name(const char *name)
+{
+    snprintf(s_name, sizeof(s_name), "%s", name);
+    s_stats.name_updates++;
+    return ESP_OK;
+}
+
+esp_err_t ble_backend_adv_start(void)
+{
+    if (!s_stats.stack_up || s_stats.connected) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    if (!s_stats.advertising) {
+        s_stats.advertising = true;
+        s_stats.adv_starts++;
+        ble_core_on_adv_started();
+    }
+    return ESP_OK;
+}
+
+esp_err_t ble_backend_adv_stop(void)
+{
+    if (s_stats.advertising) {
+        s_stats.advertising = false;
+        ble_core_on_adv_stopped();
+    }
+    return ESP_OK;
+}
+
+esp_err_t ble_backend_adv_data_update(void)
+{
+    if (s_stats.advertising) {
+        s_stats.adv_data_updates++;
+    }
+    return ESP_OK;
+}
+
+const char *ble_backend_name(void)
+{
+    return "POSIX";
+}
+
+/* ============================================================================
+ * RUNNER CONTROLS
+ * ============================================================================ */
+
+void ble_backend_posix_reset(void)
+{
+    memset(&s_stats, 0, sizeof(s_stats));
+    memcpy(s_mac, s_default_mac, sizeof(s_mac));
+    s_name[0] = '\0';
+    s_nimble_mtu = 0;
+}
+
+void ble_backend_posix_set_nimble_reads(uint16_t att_mtu)
+{
+    s_nimble_mtu = att_mtu;
+}
+
+// NimBLE's side of a long read: one piece cut from the whole value
+static uint16_t nimble_slice(const uint8_t *whole, uint16_t whole_len, uint16_t offset, uint8_t *data)
+{
+    uint16_t len = offset < whole_len ? whole_len - offset : 0;
+    if (len > s_nimble_mtu - 1) {
+        len = s_nimble_mtu - 1;
+    }
+    memmove(data, whole + offset, len);
+    return len;
+}
+
+void ble_backend_posix_set_mac(const uint8_t mac[6])
+{
+    memcpy(s_mac, mac, sizeof(s_mac));
+}
+
+void ble_backend_posix_connect(void)
+{
+    s_stats.advertising = false;
+    s_stats.connected = true;
+    ble_core_on_connect();
+}
+
+void ble_backend_posix_disconnect(void)
+{
+    s_stats.connected = false;
+    if (ble_core_on_disconnect() && s_stats.stack_up) {
+        ble_backend_adv_start();
+    }
+}
+
+bool ble_backend_posix_write(const uint8_t *data, uint16_t len)
+{
+    if (len > BLE_BACKEND_POSIX_MAX_WRITE) {
+        s_stats.writes_dropped++;
+        return false;
+    }
+    s_stats.writes++;
+    ble_core_on_write(data, len);
+    return true;
+}
+
+uint16_t ble_backend_posix_read_status(uint8_t *data)
+{
+    uint16_t len = 0;
+    s_stats.status_reads++;
+    ble_core_on_status_read(data, &len);
+    return len;
+}
+
+uint16_t ble_backend_posix_read_metrics(uint16_t offset, uint8_t *data)
+{
+    uint16_t len = 0;
+    s_stats.metrics_reads++;
+    if (s_nimble_mtu > 0) {
+        ble_core_on_metrics_read_whole(s_nimble_mtu - 1, data, &len);
+        return nimble_slice(data, len, offset, data);
+    }
+    ble_core_on_metrics_read(offset, data, &len);
+    return len;
+}
+
+uint16_t ble_backend_posix_read_links(uint16_t offset, uint8_t *data)
+{
+    uint16_t len = 0;
+    s_stats.links_reads++;
+    if (s_nimble_mtu > 0) {
+        ble_core_on_links_read_whole(s_nimble_mtu - 1, data, &len);
+        return nimble_slice(data, len, offset, data);
+    }
+    ble_core_on_links_read(offset, data, &len);
+    return len;
+}
+
+const char *ble_backend_posix_name(void)
+{
+    return s_name;
+}
+
+void ble_backend_posix_get_stats(ble_backend_posix_stats_t *stats)
+{
+    *stats = s_stats;
+}
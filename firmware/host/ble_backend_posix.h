@@ -0,0 +1,92 @@
+/*
+ * Host build: BLE backend on POSIX - test and runner controls
+ *
+ * Stands in for ble_provision_bluedroid.c / ble_provision_nimble.c so the
+ * real provisioning core (ble_provision.c) runs on Linux. There is no radio:
+ * a runner plays the central through the calls below, which reach the core
+ * the same way the BLE host task would.
+ */
+
+#ifndef BLE_BACKEND_POSIX_H
+#define BLE_BACKEND_POSIX_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "esp_err.h"
+
+// Largest write the backends hand to the core in one piece (ATT MTU - 3);
+// longer ones arrive as prepared writes, which the core ignores
+#define BLE_BACKEND_POSIX_MAX_WRITE     (GATTS_LOCAL_MTU - 3)
+
+typedef struct {
+    bool     stack_up;
+    bool     advertising;
+    bool     connected;
+    uint32_t adv_starts;
+    uint32_t adv_data_updates;
+    uint32_t name_updates;
+    uint32_t writes;            // Delivered to the core
+    uint32_t writes_dropped;    // Over BLE_BACKEND_POSIX_MAX_WRITE
+    uint32_t status_reads;
+    uint32_t metrics_reads;
+    uint32_t links_reads;
+} ble_backend_posix_stats_t;
+
+/**
+ * Back to power-on: stack down, counters cleared, default address
+ */
+void ble_backend_posix_reset(void);
+
+/**
+ * Address returned by esp_read_mac()
+ */
+void ble_backend_posix_set_mac(const uint8_t mac[6]);
+
+void ble_backend_posix_connect(void);
+void ble_backend_posix_disconnect(void);
+
+/**
+ * Write to the config / command characteristic
+ *
+ * @return false if the write was too long to arrive in one piece
+ */
+bool ble_backend_posix_write(const uint8_t *data, uint16_t len);
+
+/**
+ * Read the status characteristic
+ *
+ * @param data GATTS_STATUS_MAX_LEN bytes
+ */
+uint16_t ble_backend_posix_read_status(uint8_t *data);
+
+/**
+ * Serve long reads as NimBLE does: the core hands over the whole value for
+ * every piece, and the backend slices att_mtu - 1 bytes from the client's
+ * offset. 0 (the reset default) passes the offset on, as Bluedroid does.
+ */
+void ble_backend_posix_set_nimble_reads(uint16_t att_mtu);
+
+/**
+ * Read the metrics characteristic at an offset (long read)
+ *
+ * @param data GATTS_METRICS_MAX_LEN bytes
+ * @return Bytes from offset; with NimBLE reads at most one piece
+ */
+uint16_t ble_backend_posix_read_metrics(uint16_t offset, uint8_t *data);
+
+/**
+ * Read the link quality characteristic at an offset (long read)
+ *
+ * @param data GATTS_LINKS_MAX_LEN bytes
+ * @return Bytes from offset; with NimBLE reads at most one piece
+ */
+uint16_t ble_backend_posix_read_links(uint16_t offset, uint8_t *data);
+
+/**
+ * Current GAP device name
+ */
+const char *ble_backend_posix_name(void);
+
+void ble_backend_posix_get_stats(ble_backend_posix_stats_t *stats);
+
+#endif // BLE_BACKEND_POSIX_H
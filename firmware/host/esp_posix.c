@@ -0,0 +1,88 @@
+/*
+ * Host build: ESP-IDF runtime pieces the shared sources call
+ * (logging, esp_timer clock, heap figures, error names)
+ */
+
+#include <stdio.h>
+#include <stdarg.h>
+#include "esp_err.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "esp_system.h"
+#include "esp_heap_caps.h"
+#include "nvs.h"
+#include "node_hal.h"
+
+static esp_log_level_t s_log_level = ESP_LOG_INFO;
+
+void esp_log_level_set(const char *tag, esp_log_level_t level)
+{
+    (void)tag;
+    s_log_level = level;
+}
+
+void esp_log_write(esp_log_level_t level, const char *tag, const char *format, ...)
+{
+    static const char letters[] = "NEWIDV";
+
+    if (level > s_log_level) {
+        return;
+    }
+    fprintf(stderr, "%c (%lld) %s: ", letters[level],
+            (long long)(node_hal_time_us() / 1000), tag);
+    va_list args;
+    va_start(args, format);
+    vfprintf(stderr, format, args);
+    va_end(args);
+    fputc('\n', stderr);
+}
+
+uint32_t esp_log_timestamp(void)
+{
+    return (uint32_t)(node_hal_time_us() / 1000);
+}
+
+int64_t esp_timer_get_time(void)
+{
+    return node_hal_time_us();
+}
+
+// Fixed figures: the host heap says nothing about the device's
+#define HOST_HEAP_FREE      (256 * 1024)
+
+uint32_t esp_get_free_heap_size(void)
+{
+    return HOST_HEAP_FREE;
+}
+
+uint32_t esp_get_minimum_free_heap_size(void)
+{
+    return HOST_HEAP_FREE;
+}
+
+size_t heap_caps_get_largest_free_block(uint32_t caps)
+{
+    (void)caps;
+    return HOST_HEAP_FREE;
+}
+
+const char *esp_err_to_name(esp_err_t code)
+{
+    switch (code) {
+        case ESP_OK:                        return "ESP_OK";
+        case ESP_FAIL:                      return "ESP_FAIL";
+        case ESP_ERR_NO_MEM:                return "ESP_ERR_NO_MEM";
+        case ESP_ERR_INVALID_ARG:           return "ESP_ERR_INVALID_ARG";
+        case ESP_ERR_INVALID_STATE:         return "ESP_ERR_INVALID_STATE";
+        case ESP_ERR_INVALID_SIZE:          return "ESP_ERR_INVALID_SIZE";
+        case ESP_ERR_NOT_FOUND:             return "ESP_ERR_NOT_FOUND";
+        case ESP_ERR_NOT_SUPPORTED:         return "ESP_ERR_NOT_SUPPORTED";
+        case ESP_ERR_TIMEOUT:               return "ESP_ERR_TIMEOUT";
+        case ESP_ERR_INVALID_CRC:           return "ESP_ERR_INVALID_CRC";
+        case ESP_ERR_INVALID_VERSION:       return "ESP_ERR_INVALID_VERSION";
+        case ESP_ERR_NVS_NOT_FOUND:         return "ESP_ERR_NVS_NOT_FOUND";
+        case ESP_ERR_NVS_INVALID_LENGTH:    return "ESP_ERR_NVS_INVALID_LENGTH";
+        case ESP_ERR_NVS_NO_FREE_PAGES:     return "ESP_ERR_NVS_NO_FREE_PAGES";
+        default:                            return "UNKNOWN_ERROR";
+    }
+}
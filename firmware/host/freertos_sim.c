@@ -0,0 +1,1012 @@
+/*
+ * Discrete-Event Simulator - FreeRTOS and esp_timer in virtual time
+ * (firmware/host)
+ *
+ * See sim.h for the scheduling model. Blocked tasks park on an object
+ * (queue, semaphore, event group) and/or a deadline; anything that changes
+ * an object wakes the tasks parked on it and they re-check, so the kernel
+ * needs no per-object wait lists. Event groups are the exception: waiters
+ * are resolved at set time, as in FreeRTOS.
+ */
+
+#define _XOPEN_SOURCE 700
+
+#include "sim.h"
+#include "node_hal_posix.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/queue.h"
+#include "freertos/semphr.h"
+#include "freertos/event_groups.h"
+#include "esp_timer.h"
+#include "esp_log.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ucontext.h>
+#include <time.h>
+
+static const char *TAG = "SIM";
+
+#define TICK_US         (1000000LL / configTICK_RATE_HZ)
+#define NEVER           INT64_MAX
+#define STACK_PAINT     0xA5    // Untouched stack bytes, for the high-water mark
+
+/* ============================================================================
+ * OBJECTS
+ * ============================================================================ */
+
+typedef enum {
+    SIM_TASK_FREE = 0,
+    SIM_TASK_READY,
+    SIM_TASK_RUNNING,
+    SIM_TASK_BLOCKED,
+    SIM_TASK_DELETED,       // Returned or deleted itself; stack freed by the scheduler
+} sim_task_state_t;
+
+struct sim_task {
+    sim_task_state_t state;
+    ucontext_t  ctx;
+    void       *stack;
+    size_t      stack_size;     // Host stack
+    uint32_t    stack_depth;    // As requested by the firmware
+    UBaseType_t number;         // xTaskNumber
+    UBaseType_t trace_number;   // uxTaskGetTaskNumber(), set by the application
+    uint64_t    run_ns;         // Host CPU while running
+    TaskFunction_t fn;
+    void       *arg;
+    char        name[16];
+    UBaseType_t priority;
+    uint64_t    ready_seq;      // FIFO order within a priority
+    const void *wait_obj;       // Object parked on, NULL for a plain delay
+    int64_t     wake_us;        // Timeout, NEVER to wait forever
+    void       *tls[configNUM_THREAD_LOCAL_STORAGE_POINTERS];
+
+    // xEventGroupWaitBits() request and result
+    EventBits_t eg_bits;
+    bool        eg_all;
+    bool        eg_clear;
+    bool        eg_satisfied;
+    EventBits_t eg_result;
+};
+
+typedef enum {
+    SIM_QUEUE,
+    SIM_QUEUE_SEMAPHORE,
+    SIM_QUEUE_MUTEX,
+    SIM_QUEUE_RECURSIVE_MUTEX,
+} sim_queue_kind_t;
+
+struct QueueDefinition {
+    sim_queue_kind_t kind;
+    uint8_t     *storage;
+    UBaseType_t  item_size;
+    UBaseType_t  length;
+    UBaseType_t  count;
+    UBaseType_t  head;
+    TaskHandle_t holder;        // Mutexes only
+    UBaseType_t  recursion;
+};
+
+struct EventGroupDef_t {
+    EventBits_t bits;
+};
+
+struct esp_timer {
+    bool            used;
+    bool            active;
+    esp_timer_cb_t  callback;
+    void           *arg;
+    int64_t         expiry_us;
+    uint64_t        period_us;  // 0 for one-shot
+    uint64_t        seq;        // Start order breaks expiry ties
+};
+
+static struct sim_task s_tasks[SIM_MAX_TASKS];
+static int s_task_slots;                // Slots ever used; scans stop here
+static struct esp_timer s_timers[SIM_MAX_TIMERS];
+static struct sim_task *s_current;      // NULL in the scheduler, timers and the runner
+static ucontext_t s_sched_ctx;
+static uint64_t s_seq;
+static UBaseType_t s_task_numbers;
+static int64_t s_run_epoch_ns;          // Run-time clock zero (sim_reset)
+static int64_t s_last_yield_us = -1;    // Instant of the last elided taskYIELD()
+static int64_t s_yield_horizon_us;      // Until then taskYIELD() has no one to yield to
+static sim_stats_t s_stats;
+
+/* ============================================================================
+ * SCHEDULER CORE
+ * ============================================================================ */
+
+static int64_t now_us(void)
+{
+    return node_hal_time_us();
+}
+
+// Tick boundary `ticks` ticks after the current one, like xTaskGetTickCount() + ticks
+static int64_t tick_deadline(TickType_t ticks)
+{
+    if (ticks == portMAX_DELAY) {
+        return NEVER;
+    }
+    return (now_us() / TICK_US + (int64_t)ticks) * TICK_US;
+}
+
+static void make_ready(struct sim_task *t)
+{
+    s_yield_horizon_us = INT64_MIN;
+    t->state = SIM_TASK_READY;
+    t->ready_seq = s_seq++;
+    t->wait_obj = NULL;
+    t->wake_us = NEVER;
+}
+
+static void free_task(struct sim_task *t)
+{
+    free(t->stack);
+    memset(t, 0, sizeof(*t));
+    s_stats.tasks--;
+}
+
+// Back to the scheduler; returns when this task is next picked
+static void switch_out(void)
+{
+    swapcontext(&s_current->ctx, &s_sched_ctx);
+}
+
+static void block_until(const void *obj, int64_t deadline_us)
+{
+    s_current->state = SIM_TASK_BLOCKED;
+    s_current->wait_obj = obj;
+    s_current->wake_us = deadline_us;
+    switch_out();
+}
+
+static void wake_waiters(const void *obj)
+{
+    for (int i = 0; i < s_task_slots; i++) {
+        if (s_tasks[i].state == SIM_TASK_BLOCKED && s_tasks[i].wait_obj == obj) {
+            make_ready(&s_tasks[i]);
+        }
+    }
+}
+
+static struct sim_task *pick_ready(void)
+{
+    struct sim_task *best = NULL;
+    for (int i = 0; i < s_task_slots; i++) {
+        struct sim_task *t = &s_tasks[i];
+        if (t->state != SIM_TASK_READY) {
+            continue;
+        }
+        if (best == NULL || t->priority > best->priority ||
+            (t->priority == best->priority && t->ready_seq < best->ready_seq)) {
+            best = t;
+        }
+    }
+    return best;
+}
+
+// A task that just woke a higher-priority one gives up the CPU, as the
+// real kernel would on return from the API call
+static void preempt_check(void)
+{
+    if (s_current == NULL) {
+        return;
+    }
+    struct sim_task *next = pick_ready();
+    if (next != NULL && next->priority > s_current->priority) {
+        make_ready(s_current);
+        switch_out();
+    }
+}
+
+static void fire_due(void)
+{
+    int64_t now = now_us();
+
+    // Timers first, in expiry order: the esp_timer task outranks app tasks
+    for (;;) {
+        struct esp_timer *due = NULL;
+        for (int i = 0; i < SIM_MAX_TIMERS; i++) {
+            struct esp_timer *tm = &s_timers[i];
+            if (!tm->active || tm->expiry_us > now) {
+                continue;
+            }
+            if (due == NULL || tm->expiry_us < due->expiry_us ||
+                (tm->expiry_us == due->expiry_us && tm->seq < due->seq)) {
+                due = tm;
+            }
+        }
+        if (due == NULL) {
+            break;
+        }
+        if (due->period_us > 0) {
+            due->expiry_us += (int64_t)due->period_us;
+        } else {
+            due->active = false;
+        }
+        s_stats.timer_callbacks++;
+        due->callback(due->arg);
+    }
+
+    for (int i = 0; i < s_task_slots; i++) {
+        if (s_tasks[i].state == SIM_TASK_BLOCKED && s_tasks[i].wake_us <= now) {
+            make_ready(&s_tasks[i]);
+        }
+    }
+}
+
+static int64_t next_event_us(void)
+{
+    int64_t next = NEVER;
+    for (int i = 0; i < SIM_MAX_TIMERS; i++) {
+        if (s_timers[i].active && s_timers[i].expiry_us < next) {
+            next = s_timers[i].expiry_us;
+        }
+    }
+    for (int i = 0; i < s_task_slots; i++) {
+        if (s_tasks[i].state == SIM_TASK_BLOCKED && s_tasks[i].wake_us < next) {
+            next = s_tasks[i].wake_us;
+        }
+    }
+    return next;
+}
+
+static void task_entry(void)
+{
+    struct sim_task *t = s_current;
+    t->fn(t->arg);
+
+    // FreeRTOS asserts here; finishing the task keeps the run going
+    ESP_LOGE(TAG, "Task %s returned without vTaskDelete", t->name);
+    t->state = SIM_TASK_DELETED;
+    switch_out();
+}
+
+// Run-time stats clock. Tasks never sleep in wall time while running (they
+// block back into the scheduler), so monotonic time is their CPU time.
+static int64_t host_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+static void run_task(struct sim_task *t)
+{
+    s_current = t;
+    s_yield_horizon_us = INT64_MIN;
+    t->state = SIM_TASK_RUNNING;
+    s_stats.context_switches++;
+    int64_t start_ns = host_ns();
+    swapcontext(&s_sched_ctx, &t->ctx);
+    t->run_ns += host_ns() - start_ns;
+    s_current = NULL;
+
+    if (t->state == SIM_TASK_DELETED) {
+        free_task(t);
+    }
+}
+
+/* ============================================================================
+ * RUNNER API
+ * ============================================================================ */
+
+void sim_reset(void)
+{
+    for (int i = 0; i < SIM_MAX_TASKS; i++) {
+        free(s_tasks[i].stack);
+    }
+    memset(s_tasks, 0, sizeof(s_tasks));
+    s_task_slots = 0;
+    memset(s_timers, 0, sizeof(s_timers));
+    memset(&s_stats, 0, sizeof(s_stats));
+    s_current = NULL;
+    s_seq = 0;
+    s_task_numbers = 0;
+    s_run_epoch_ns = host_ns();
+    s_last_yield_us = -1;
+    s_yield_horizon_us = INT64_MIN;
+}
+
+esp_err_t sim_run_until(int64_t end_us)
+{
+    if (s_current != NULL) {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    int64_t last_us = now_us();
+    uint32_t switches_here = 0;
+
+    while (now_us() <= end_us) {
+        fire_due();
+
+        struct sim_task *t = pick_ready();
+        if (t != NULL) {
+            run_task(t);
+            if (now_us() != last_us) {
+                last_us = now_us();
+                switches_here = 0;
+            } else if (++switches_here >= SIM_LIVELOCK_SWITCHES) {
+                ESP_LOGE(TAG, "No progress at %lld us: tasks yield without blocking",
+                         (long long)last_us);
+                return ESP_ERR_TIMEOUT;
+            }
+            continue;
+        }
+
+        int64_t next = next_event_us();
+        if (next > end_us) {
+            node_hal_posix_wait_until(end_us);
+            break;
+        }
+        node_hal_posix_wait_until(next);
+        s_stats.time_jumps++;
+    }
+    return ESP_OK;
+}
+
+esp_err_t sim_run_for(int64_t duration_us)
+{
+    return sim_run_until(now_us() + duration_us);
+}
+
+bool sim_in_task(void)
+{
+    return s_current != NULL;
+}
+
+void sim_get_stats(sim_stats_t *stats)
+{
+    *stats = s_stats;
+}
+
+/* ============================================================================
+ * TASKS
+ * ============================================================================ */
+
+BaseType_t xTaskCreate(TaskFunction_t fn, const char *name, uint32_t usStackDepth,
+                       void *arg, UBaseType_t priority, TaskHandle_t *out)
+{
+    struct sim_task *t = NULL;
+    for (int i = 0; i < SIM_MAX_TASKS && t == NULL; i++) {
+        if (s_tasks[i].state == SIM_TASK_FREE) {
+            t = &s_tasks[i];
+            if (i >= s_task_slots) {
+                s_task_slots = i + 1;
+            }
+        }
+    }
+    if (t == NULL) {
+        ESP_LOGE(TAG, "No task slot for %s (max %d)", name, SIM_MAX_TASKS);
+        return pdFAIL;
+    }
+
+    size_t stack_size = usStackDepth > SIM_TASK_MIN_STACK ? usStackDepth : SIM_TASK_MIN_STACK;
+    t->stack = malloc(stack_size);
+    if (t->stack == NULL) {
+        return pdFAIL;
+    }
+    memset(t->stack, STACK_PAINT, stack_size);
+    t->stack_size = stack_size;
+    t->stack_depth = usStackDepth;
+    t->number = ++s_task_numbers;
+    t->trace_number = 0;
+    getcontext(&t->ctx);
+    t->ctx.uc_stack.ss_sp = t->stack;
+    t->ctx.uc_stack.ss_size = stack_size;
+    t->ctx.uc_link = &s_sched_ctx;
+    makecontext(&t->ctx, task_entry, 0);
+
+    t->fn = fn;
+    t->arg = arg;
+    snprintf(t->name, sizeof(t->name), "%s", name != NULL ? name : "");
+    t->priority = priority < configMAX_PRIORITIES ? priority : configMAX_PRIORITIES - 1;
+    s_stats.tasks++;
+    make_ready(t);
+
+    if (out != NULL) {
+        *out = t;
+    }
+    preempt_check();
+    return pdPASS;
+}
+
+BaseType_t xTaskCreatePinnedToCore(TaskFunction_t fn, const char *name, uint32_t usStackDepth,
+                                   void *arg, UBaseType_t priority, TaskHandle_t *out,
+                                   BaseType_t core)
+{
+    (void)core;
+    return xTaskCreate(fn, name, usStackDepth, arg, priority, out);
+}
+
+void vTaskDelete(TaskHandle_t task)
+{
+    if (task == NULL || task == s_current) {
+        if (s_current == NULL) {
+            return;
+        }
+        s_current->state = SIM_TASK_DELETED;
+        switch_out();
+        return;     // Not reached
+    }
+    if (task->state != SIM_TASK_FREE) {
+        free_task(task);
+    }
+}
+
+void vTaskDelay(TickType_t ticks)
+{
+    if (s_current == NULL) {
+        // Runner or timer callback: nothing to schedule around, just move time
+        node_hal_posix_wait_until(now_us() + (int64_t)ticks * TICK_US);
+        return;
+    }
+    if (ticks == 0) {
+        taskYIELD();
+        return;
+    }
+    block_until(NULL, tick_deadline(ticks));
+}
+
+BaseType_t xTaskDelayUntil(TickType_t *previous_wake, TickType_t increment)
+{
+    TickType_t now = xTaskGetTickCount();
+    TickType_t target = *previous_wake + increment;
+    *previous_wake = target;
+
+    if ((TickType_t)(target - now) == 0 || (TickType_t)(target - now) > increment) {
+        // Already due (or overran the period): no delay, as in FreeRTOS
+        return pdFALSE;
+    }
+    vTaskDelay(target - now);
+    return pdTRUE;
+}
+
+void taskYIELD(void)
+{
+    if (s_current == NULL) {
+        return;
+    }
+    // Nothing else could take the CPU: the kernel would resume this task, so
+    // skip the two context switches (busy-wait loops yield every few us).
+    // The answer holds until the next event or until some task becomes ready
+    // or a timer starts, which reset the horizon. Only while time moves; a
+    // task spinning at one instant still goes through the scheduler so its
+    // livelock check sees it.
+    int64_t now = now_us();
+    if (now != s_last_yield_us) {
+        if (now < s_yield_horizon_us) {
+            s_last_yield_us = now;
+            return;
+        }
+        struct sim_task *next = pick_ready();
+        int64_t next_us = next_event_us();
+        if ((next == NULL || next->priority < s_current->priority) && next_us > now) {
+            s_yield_horizon_us = next_us;
+            s_last_yield_us = now;
+            return;
+        }
+    }
+    make_ready(s_current);
+    switch_out();
+}
+
+TickType_t xTaskGetTickCount(void)
+{
+    return (TickType_t)(now_us() / TICK_US);
+}
+
+TaskHandle_t xTaskGetCurrentTaskHandle(void)
+{
+    return s_current;
+}
+
+char *pcTaskGetName(TaskHandle_t task)
+{
+    if (task == NULL) {
+        task = s_current;
+    }
+    return task != NULL ? task->name : NULL;
+}
+
+UBaseType_t uxTaskPriorityGet(TaskHandle_t task)
+{
+    if (task == NULL) {
+        task = s_current;
+    }
+    return task != NULL ? task->priority : 0;
+}
+
+void vTaskSetThreadLocalStoragePointer(TaskHandle_t task, BaseType_t index, void *value)
+{
+    if (task == NULL) {
+        task = s_current;
+    }
+    if (task != NULL && index >= 0 && index < configNUM_THREAD_LOCAL_STORAGE_POINTERS) {
+        task->tls[index] = value;
+    }
+}
+
+void *pvTaskGetThreadLocalStoragePointer(TaskHandle_t task, BaseType_t index)
+{
+    if (task == NULL) {
+        task = s_current;
+    }
+    if (task == NULL || index < 0 || index >= configNUM_THREAD_LOCAL_STORAGE_POINTERS) {
+        return NULL;
+    }
+    return task->tls[index];
+}
+
+UBaseType_t uxTaskGetNumberOfTasks(void)
+{
+    return s_stats.tasks;
+}
+
+static eTaskState task_state(const struct sim_task *t)
+{
+    switch (t->state) {
+        case SIM_TASK_RUNNING:  return eRunning;
+        case SIM_TASK_READY:    return eReady;
+        case SIM_TASK_BLOCKED:  return eBlocked;
+        case SIM_TASK_DELETED:  return eDeleted;
+        default:                return eInvalid;
+    }
+}
+
+UBaseType_t uxTaskGetSystemState(TaskStatus_t *array, UBaseType_t array_size,
+                                 uint32_t *total_runtime)
+{
+    if (array_size < s_stats.tasks) {
+        return 0;
+    }
+    UBaseType_t n = 0;
+    for (int i = 0; i < s_task_slots; i++) {
+        struct sim_task *t = &s_tasks[i];
+        if (t->state == SIM_TASK_FREE) {
+            continue;
+        }
+        array[n++] = (TaskStatus_t) {
+            .xHandle = t,
+            .pcTaskName = t->name,
+            .xTaskNumber = t->number,
+            .eCurrentState = task_state(t),
+            .uxCurrentPriority = t->priority,
+            .uxBasePriority = t->priority,
+            .ulRunTimeCounter = (uint32_t)(t->run_ns / 1000),
+            .usStackHighWaterMark = uxTaskGetStackHighWaterMark(t),
+        };
+    }
+    if (total_runtime != NULL) {
+        *total_runtime = (uint32_t)((host_ns() - s_run_epoch_ns) / 1000);
+    }
+    return n;
+}
+
+size_t sim_task_stack_used(TaskHandle_t task)
+{
+    if (task == NULL) {
+        task = s_current;
+    }
+    if (task == NULL || task->stack == NULL) {
+        return 0;
+    }
+    // Stacks grow down: the lowest byte ever written marks the peak
+    const uint8_t *p = task->stack;
+    size_t untouched = 0;
+    while (untouched < task->stack_size && p[untouched] == STACK_PAINT) {
+        untouched++;
+    }
+    return task->stack_size - untouched;
+}
+
+UBaseType_t uxTaskGetStackHighWaterMark(TaskHandle_t task)
+{
+    if (task == NULL) {
+        task = s_current;
+    }
+    if (task == NULL) {
+        return 0;
+    }
+    size_t used = sim_task_stack_used(task);
+    return used < task->stack_depth ? (UBaseType_t)(task->stack_depth - used) : 0;
+}
+
+UBaseType_t uxTaskGetTaskNumber(TaskHandle_t task)
+{
+    return task != NULL ? task->trace_number : 0;
+}
+
+void vTaskSetTaskNumber(TaskHandle_t task, UBaseType_t number)
+{
+    if (task == NULL) {
+        task = s_current;
+    }
+    if (task != NULL) {
+        task->trace_number = number;
+    }
+}
+
+/* ============================================================================
+ * QUEUES AND SEMAPHORES
+ * ============================================================================ */
+
+static QueueHandle_t queue_create(sim_queue_kind_t kind, UBaseType_t length,
+                                  UBaseType_t item_size, UBaseType_t count)
+{
+    if (length == 0) {
+        return NULL;
+    }
+    QueueHandle_t q = calloc(1, sizeof(*q));
+    if (q == NULL) {
+        return NULL;
+    }
+    if (item_size > 0) {
+        q->storage = malloc((size_t)length * item_size);
+        if (q->storage == NULL) {
+            free(q);
+            return NULL;
+        }
+    }
+    q->kind = kind;
+    q->length = length;
+    q->item_size = item_size;
+    q->count = count;
+    return q;
+}
+
+QueueHandle_t xQueueCreate(UBaseType_t length, UBaseType_t item_size)
+{
+    return queue_create(SIM_QUEUE, length, item_size, 0);
+}
+
+void vQueueDelete(QueueHandle_t queue)
+{
+    if (queue == NULL) {
+        return;
+    }
+    free(queue->storage);
+    free(queue);
+}
+
+static BaseType_t queue_send(QueueHandle_t q, const void *item, TickType_t ticks, bool front)
+{
+    int64_t deadline = tick_deadline(ticks);
+
+    for (;;) {
+        if (q->count < q->length) {
+            if (q->item_size > 0) {
+                UBaseType_t slot;
+                if (front) {
+                    q->head = (q->head + q->length - 1) % q->length;
+                    slot = q->head;
+                } else {
+                    slot = (q->head + q->count) % q->length;
+                }
+                memcpy(q->storage + (size_t)slot * q->item_size, item, q->item_size);
+            }
+            q->count++;
+            wake_waiters(q);
+            preempt_check();
+            return pdTRUE;
+        }
+        if (s_current == NULL || now_us() >= deadline) {
+            return errQUEUE_FULL;
+        }
+        block_until(q, deadline);
+    }
+}
+
+static BaseType_t queue_receive(QueueHandle_t q, void *item, TickType_t ticks, bool peek)
+{
+    int64_t deadline = tick_deadline(ticks);
+
+    for (;;) {
+        if (q->count > 0) {
+            if (q->item_size > 0 && item != NULL) {
+                memcpy(item, q->storage + (size_t)q->head * q->item_size, q->item_size);
+            }
+            if (!peek) {
+                q->head = (q->head + 1) % q->length;
+                q->count--;
+                wake_waiters(q);
+                preempt_check();
+            }
+            return pdTRUE;
+        }
+        if (s_current == NULL || now_us() >= deadline) {
+            return errQUEUE_EMPTY;
+        }
+        block_until(q, deadline);
+    }
+}
+
+BaseType_t xQueueSend(QueueHandle_t queue, const void *item, TickType_t ticks)
+{
+    return queue_send(queue, item, ticks, false);
+}
+
+BaseType_t xQueueSendToFront(QueueHandle_t queue, const void *item, TickType_t ticks)
+{
+    return queue_send(queue, item, ticks, true);
+}
+
+BaseType_t xQueueOverwrite(QueueHandle_t queue, const void *item)
+{
+    // Only meaningful on length-1 queues (FreeRTOS asserts otherwise)
+    queue->count = 0;
+    queue->head = 0;
+    return queue_send(queue, item, 0, false);
+}
+
+BaseType_t xQueueReceive(QueueHandle_t queue, void *item, TickType_t ticks)
+{
+    return queue_receive(queue, item, ticks, false);
+}
+
+BaseType_t xQueuePeek(QueueHandle_t queue, void *item, TickType_t ticks)
+{
+    return queue_receive(queue, item, ticks, true);
+}
+
+BaseType_t xQueueReset(QueueHandle_t queue)
+{
+    queue->count = 0;
+    queue->head = 0;
+    wake_waiters(queue);
+    return pdPASS;
+}
+
+UBaseType_t uxQueueMessagesWaiting(QueueHandle_t queue)
+{
+    return queue->count;
+}
+
+UBaseType_t uxQueueSpacesAvailable(QueueHandle_t queue)
+{
+    return queue->length - queue->count;
+}
+
+SemaphoreHandle_t xSemaphoreCreateBinary(void)
+{
+    return queue_create(SIM_QUEUE_SEMAPHORE, 1, 0, 0);
+}
+
+SemaphoreHandle_t xSemaphoreCreateCounting(UBaseType_t max_count, UBaseType_t initial_count)
+{
+    if (initial_count > max_count) {
+        return NULL;
+    }
+    return queue_create(SIM_QUEUE_SEMAPHORE, max_count, 0, initial_count);
+}
+
+SemaphoreHandle_t xSemaphoreCreateMutex(void)
+{
+    return queue_create(SIM_QUEUE_MUTEX, 1, 0, 1);
+}
+
+SemaphoreHandle_t xSemaphoreCreateRecursiveMutex(void)
+{
+    return queue_create(SIM_QUEUE_RECURSIVE_MUTEX, 1, 0, 1);
+}
+
+BaseType_t xSemaphoreTake(SemaphoreHandle_t sem, TickType_t ticks)
+{
+    if (queue_receive(sem, NULL, ticks, false) != pdTRUE) {
+        return pdFALSE;
+    }
+    if (sem->kind != SIM_QUEUE_SEMAPHORE) {
+        sem->holder = s_current;
+    }
+    return pdTRUE;
+}
+
+BaseType_t xSemaphoreGive(SemaphoreHandle_t sem)
+{
+    if (sem->kind != SIM_QUEUE_SEMAPHORE) {
+        if (sem->holder != s_current) {
+            return pdFALSE;
+        }
+        sem->holder = NULL;
+    }
+    return queue_send(sem, NULL, 0, false);
+}
+
+BaseType_t xSemaphoreTakeRecursive(SemaphoreHandle_t sem, TickType_t ticks)
+{
+    if (sem->holder != NULL && sem->holder == s_current) {
+        sem->recursion++;
+        return pdTRUE;
+    }
+    if (xSemaphoreTake(sem, ticks) != pdTRUE) {
+        return pdFALSE;
+    }
+    sem->recursion = 1;
+    return pdTRUE;
+}
+
+BaseType_t xSemaphoreGiveRecursive(SemaphoreHandle_t sem)
+{
+    if (sem->holder != s_current || sem->recursion == 0) {
+        return pdFALSE;
+    }
+    if (--sem->recursion > 0) {
+        return pdTRUE;
+    }
+    return xSemaphoreGive(sem);
+}
+
+UBaseType_t uxSemaphoreGetCount(SemaphoreHandle_t sem)
+{
+    return sem->count;
+}
+
+TaskHandle_t xSemaphoreGetMutexHolder(SemaphoreHandle_t sem)
+{
+    return sem->holder;
+}
+
+/* ============================================================================
+ * EVENT GROUPS
+ * ============================================================================ */
+
+static bool bits_match(EventBits_t have, EventBits_t want, bool all)
+{
+    return all ? (have & want) == want : (have & want) != 0;
+}
+
+EventGroupHandle_t xEventGroupCreate(void)
+{
+    return calloc(1, sizeof(struct EventGroupDef_t));
+}
+
+void vEventGroupDelete(EventGroupHandle_t group)
+{
+    free(group);
+}
+
+EventBits_t xEventGroupSetBits(EventGroupHandle_t group, EventBits_t bits)
+{
+    group->bits |= bits;
+
+    EventBits_t clear = 0;
+    for (int i = 0; i < s_task_slots; i++) {
+        struct sim_task *t = &s_tasks[i];
+        if (t->state != SIM_TASK_BLOCKED || t->wait_obj != group ||
+            !bits_match(group->bits, t->eg_bits, t->eg_all)) {
+            continue;
+        }
+        t->eg_satisfied = true;
+        t->eg_result = group->bits;
+        if (t->eg_clear) {
+            clear |= t->eg_bits;
+        }
+        make_ready(t);
+    }
+    group->bits &= ~clear;
+
+    EventBits_t result = group->bits;
+    preempt_check();
+    return result;
+}
+
+EventBits_t xEventGroupClearBits(EventGroupHandle_t group, EventBits_t bits)
+{
+    EventBits_t before = group->bits;
+    group->bits &= ~bits;
+    return before;
+}
+
+EventBits_t xEventGroupGetBits(EventGroupHandle_t group)
+{
+    return group->bits;
+}
+
+EventBits_t xEventGroupWaitBits(EventGroupHandle_t group, EventBits_t bits,
+                                BaseType_t clear_on_exit, BaseType_t wait_for_all,
+                                TickType_t ticks)
+{
+    EventBits_t now_bits = group->bits;
+    if (bits_match(now_bits, bits, wait_for_all)) {
+        if (clear_on_exit) {
+            group->bits &= ~bits;
+        }
+        return now_bits;
+    }
+
+    int64_t deadline = tick_deadline(ticks);
+    if (s_current == NULL || now_us() >= deadline) {
+        return now_bits;
+    }
+
+    s_current->eg_bits = bits;
+    s_current->eg_all = wait_for_all;
+    s_current->eg_clear = clear_on_exit;
+    s_current->eg_satisfied = false;
+    block_until(group, deadline);
+
+    return s_current->eg_satisfied ? s_current->eg_result : group->bits;
+}
+
+/* ============================================================================
+ * ESP_TIMER
+ * ============================================================================ */
+
+esp_err_t esp_timer_create(const esp_timer_create_args_t *args, esp_timer_handle_t *out)
+{
+    if (args == NULL || args->callback == NULL || out == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    for (int i = 0; i < SIM_MAX_TIMERS; i++) {
+        if (!s_timers[i].used) {
+            memset(&s_timers[i], 0, sizeof(s_timers[i]));
+            s_timers[i].used = true;
+            s_timers[i].callback = args->callback;
+            s_timers[i].arg = args->arg;
+            *out = &s_timers[i];
+            return ESP_OK;
+        }
+    }
+    return ESP_ERR_NO_MEM;
+}
+
+static esp_err_t timer_start(esp_timer_handle_t timer, uint64_t timeout_us, uint64_t period_us)
+{
+    if (timer == NULL || !timer->used) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (timer->active) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    s_yield_horizon_us = INT64_MIN;
+    timer->active = true;
+    timer->expiry_us = now_us() + (int64_t)timeout_us;
+    timer->period_us = period_us;
+    timer->seq = s_seq++;
+    return ESP_OK;
+}
+
+esp_err_t esp_timer_start_once(esp_timer_handle_t timer, uint64_t timeout_us)
+{
+    return timer_start(timer, timeout_us, 0);
+}
+
+esp_err_t esp_timer_start_periodic(esp_timer_handle_t timer, uint64_t period_us)
+{
+    if (period_us == 0) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    return timer_start(timer, period_us, period_us);
+}
+
+esp_err_t esp_timer_stop(esp_timer_handle_t timer)
+{
+    if (timer == NULL || !timer->used) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (!timer->active) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    timer->active = false;
+    return ESP_OK;
+}
+
+esp_err_t esp_timer_delete(esp_timer_handle_t timer)
+{
+    if (timer == NULL || !timer->used) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (timer->active) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    timer->used = false;
+    return ESP_OK;
+}
+
+bool esp_timer_is_active(esp_timer_handle_t timer)
+{
+    return timer != NULL && timer->used && timer->active;
+}
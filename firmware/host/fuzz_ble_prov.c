@@ -0,0 +1,446 @@
+/*
+ * Cultivio AquaSense - BLE Provisioning Fuzz Harness
+ * Host build only (real ble_provision.c behind the POSIX BLE backend)
+ *
+ * One input is one provisioning session from power-on: a sequence of GATT
+ * writes to the config characteristic, each framed as
+ *
+ *   len:u8 | len bytes        (a short last frame takes what is left)
+ *
+ * After every write the status characteristic is read and the published
+ * config is checked: command limits hold, strings are terminated, the
+ * device name fits, the status response matches the snapshot and leaks
+ * nothing past its length, and the metrics characteristic reassembles from
+ * MTU-sized long reads into one snapshot that decodes, with the offset
+ * handed to the core (Bluedroid) or the whole value sliced by the host
+ * (NimBLE). A broken invariant aborts, so libFuzzer, AFL and the sanitizers
+ * all see it as a crash.
+ *
+ * Builds:
+ *   default       fuzz_ble_prov [options] FILE|DIR...   (replay, mutate, bench)
+ *   libFuzzer     cmake -DAQUASENSE_LIBFUZZER=ON with clang (no main)
+ *   AFL           CC=afl-clang-fast, then afl-fuzz ... -- fuzz_ble_prov @@
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <signal.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <sys/stat.h>
+
+#include "esp_log.h"
+#include "ble_provision.h"
+#include "ble_provision_priv.h"
+#include "config_derived.h"
+#include "ble_backend_posix.h"
+#include "node_hal_posix.h"
+#include "nvs_posix.h"
+#include "metrics.h"
+
+#define STATUS_LEN          29
+#define METRICS_READ_CHUNK  22          // Default ATT MTU 23, minus the opcode
+#define FUZZ_MAX_INPUT      4096
+#define FUZZ_MAX_CORPUS     256
+
+/* ============================================================================
+ * INVARIANTS
+ * ============================================================================ */
+
+static const char *s_input_name = "stdin";
+
+static void fail(const char *what, int frame)
+{
+    fprintf(stderr, "INVARIANT BROKEN (%s, after frame %d): %s\n", s_input_name, frame, what);
+    abort();
+}
+
+#define CHECK(cond, frame) do { if (!(cond)) fail(#cond, frame); } while (0)
+
+static bool terminated(const char *s, size_t size)
+{
+    return memchr(s, '\0', size) != NULL;
+}
+
+// Metrics: one snapshot across a long read, though a counter encoded past
+// the first piece moves between pieces. nimble_mtu as
+// ble_backend_posix_set_nimble_reads().
+static void check_metrics_read(uint16_t nimble_mtu, int frame)
+{
+    uint8_t blob[GATTS_METRICS_MAX_LEN];
+    uint8_t chunk[GATTS_METRICS_MAX_LEN];
+    uint16_t total = 0;
+    int32_t sent = metrics_get(METRIC_REPORT_SEQ_GAPS);
+    ble_backend_posix_set_nimble_reads(nimble_mtu);
+    for (;;) {
+        uint16_t n = ble_backend_posix_read_metrics(total, chunk);
+        if (n > METRICS_READ_CHUNK) {
+            n = METRICS_READ_CHUNK;
+        }
+        memcpy(blob + total, chunk, n);
+        total += n;
+        metrics_inc(METRIC_REPORT_SEQ_GAPS);
+        if (n < METRICS_READ_CHUNK) {
+            break;
+        }
+    }
+    ble_backend_posix_set_nimble_reads(0);
+    CHECK(total == METRICS_ENCODED_MAX + 1, frame);                    // Empty task table
+    metrics_snapshot_t snap;
+    CHECK(metrics_decode(blob, total, &snap) == ESP_OK, frame);
+    CHECK(snap.value[METRIC_REPORT_SEQ_GAPS] == sent, frame);
+    CHECK(snap.task_count == 0, frame);
+    CHECK(snap.hist[METRIC_CONFIG_LOCK_WAIT_US].max_us == 0, frame);   // Nothing contends
+}
+
+static void check_session(int frame)
+{
+    device_config_t active;
+    config_derived_t derived;
+    ble_provision_config_snapshot(&active);
+    ble_provision_config_derived(&derived);
+    const device_config_t *cfg = &active;
+    const config_derived_t *dc = &derived;
+
+    // Command limits (the session starts from valid defaults, and updates
+    // that break them must be rejected)
+    CHECK(cfg->node_type >= NODE_TYPE_SENSOR && cfg->node_type <= NODE_TYPE_ROUTER, frame);
+    CHECK(cfg->tank_height_cm >= 50 && cfg->tank_height_cm <= 1000, frame);
+    CHECK(cfg->tank_diameter_cm >= 30 && cfg->tank_diameter_cm <= 500, frame);
+    CHECK(cfg->sensor_offset_cm <= 50, frame);
+    CHECK(cfg->report_interval_sec >= 1 && cfg->report_interval_sec <= 300, frame);
+    CHECK(cfg->pump_on_threshold < cfg->pump_off_threshold, frame);
+    CHECK(cfg->pump_off_threshold <= 100, frame);
+    CHECK(cfg->pump_timeout_minutes >= 1 && cfg->pump_timeout_minutes <= 120, frame);
+    CHECK(cfg->zigbee_channel >= 11 && cfg->zigbee_channel <= 26, frame);
+    CHECK(cfg->ble_adv_policy < BLE_ADV_POLICY_MAX, frame);
+    CHECK(cfg->ble_idle_timeout_sec == 0 || cfg->ble_idle_timeout_sec >= 30, frame);
+
+    CHECK(terminated(cfg->device_name, sizeof(cfg->device_name)), frame);
+    CHECK(terminated(cfg->custom_name, sizeof(cfg->custom_name)), frame);
+    CHECK(terminated(cfg->password, sizeof(cfg->password)), frame);
+    CHECK(terminated(cfg->location, sizeof(cfg->location)), frame);
+    CHECK(strncmp(cfg->device_name, DEVICE_NAME_PREFIX, strlen(DEVICE_NAME_PREFIX)) == 0, frame);
+    CHECK(strcmp(ble_backend_posix_name(), cfg->device_name) == 0, frame);
+    CHECK(!cfg->password_enabled || strlen(cfg->password) > 0, frame);
+
+    CHECK(dc->pump_on_pct < dc->pump_off_pct, frame);
+    CHECK(dc->tank_height_cm > 0, frame);
+
+    // Status response: fixed length, mirrors the snapshot, zero tail
+    uint8_t status[GATTS_STATUS_MAX_LEN];
+    memset(status, 0xA5, sizeof(status));
+    uint16_t len = ble_backend_posix_read_status(status);
+    CHECK(len == STATUS_LEN, frame);
+    for (size_t i = len; i < sizeof(status); i++) {
+        CHECK(status[i] == 0, frame);
+    }
+    CHECK(status[1] <= PROV_STATE_PROVISIONED, frame);
+    CHECK(status[2] == (cfg->provisioned ? 1 : 0), frame);
+    CHECK(((status[3] << 8) | status[4]) == cfg->tank_height_cm, frame);
+    CHECK(status[5] == cfg->pump_on_threshold && status[6] == cfg->pump_off_threshold, frame);
+    CHECK(((status[7] << 8) | status[8]) == cfg->zigbee_pan_id, frame);
+    CHECK(status[9] == cfg->zigbee_channel, frame);
+
+    check_metrics_read(0, frame);
+    check_metrics_read(METRICS_READ_CHUNK + 1, frame);
+}
+
+/* ============================================================================
+ * SESSION
+ * ============================================================================ */
+
+static bool s_ready;
+
+// Fresh device each session: erased NVS, defaults, stack up, app connected
+static void session_start(void)
+{
+    if (!s_ready) {
+        esp_log_level_set("*", ESP_LOG_NONE);
+        node_hal_posix_reset(NODE_HAL_CLOCK_VIRTUAL);
+        node_hal_posix_advance_us(1000000);
+        s_ready = true;
+    }
+    nvs_posix_reset();
+    metrics_reset();
+    ble_backend_posix_reset();
+    ble_provision_init(NODE_TYPE_SENSOR);
+    ble_provision_start();
+    ble_backend_posix_connect();
+}
+
+/**
+ * Play one input
+ *
+ * @return Number of writes delivered
+ */
+static int session_run(const uint8_t *data, size_t size, bool check)
+{
+    session_start();
+    if (check) {
+        check_session(-1);
+    }
+
+    int frames = 0;
+    size_t pos = 0;
+    while (pos < size) {
+        size_t len = data[pos++];
+        if (len > size - pos) {
+            len = size - pos;
+        }
+        ble_backend_posix_write(&data[pos], (uint16_t)len);
+        pos += len;
+        if (check) {
+            check_session(frames);
+        }
+        frames++;
+    }
+
+    ble_backend_posix_disconnect();
+    return frames;
+}
+
+int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size)
+{
+    if (size <= FUZZ_MAX_INPUT) {
+        session_run(data, size, true);
+    }
+    return 0;
+}
+
+#ifndef AQUASENSE_LIBFUZZER
+
+/* ============================================================================
+ * CORPUS
+ * ============================================================================ */
+
+typedef struct {
+    char     name[128];
+    uint8_t *data;
+    size_t   size;
+} input_t;
+
+static input_t s_corpus[FUZZ_MAX_CORPUS];
+static int s_corpus_count;
+
+static void load_file(const char *path)
+{
+    if (s_corpus_count >= FUZZ_MAX_CORPUS) {
+        return;
+    }
+    FILE *f = fopen(path, "rb");
+    if (f == NULL) {
+        return;
+    }
+    input_t *in = &s_corpus[s_corpus_count];
+    in->data = malloc(FUZZ_MAX_INPUT);
+    in->size = fread(in->data, 1, FUZZ_MAX_INPUT, f);
+    fclose(f);
+
+    const char *base = strrchr(path, '/');
+    snprintf(in->name, sizeof(in->name), "%s", base != NULL ? base + 1 : path);
+    s_corpus_count++;
+}
+
+static void load_path(const char *path)
+{
+    struct stat st;
+    if (stat(path, &st) != 0) {
+        fprintf(stderr, "No such input: %s\n", path);
+        exit(2);
+    }
+    if (!S_ISDIR(st.st_mode)) {
+        load_file(path);
+        return;
+    }
+
+    DIR *dir = opendir(path);
+    struct dirent *e;
+    while (dir != NULL && (e = readdir(dir)) != NULL) {
+        if (e->d_name[0] != '.') {
+            char file[512];
+            snprintf(file, sizeof(file), "%s/%s", path, e->d_name);
+            load_file(file);
+        }
+    }
+    if (dir != NULL) {
+        closedir(dir);
+    }
+}
+
+/* ============================================================================
+ * MUTATION (no libFuzzer/AFL at hand)
+ * ============================================================================ */
+
+static uint64_t s_rng = 0x9E3779B97F4A7C15ULL;
+
+static uint32_t rng_below(uint32_t n)
+{
+    s_rng ^= s_rng >> 12;
+    s_rng ^= s_rng << 25;
+    s_rng ^= s_rng >> 27;
+    return (uint32_t)((s_rng * 0x2545F4914F6CDD1DULL) % n);
+}
+
+// Byte flips, boundary values, frame splices from other corpus inputs
+static size_t mutate(uint8_t *buf, size_t size)
+{
+    static const uint8_t interesting[] = { 0x00, 0x01, 0x0A, 0x0B, 0x10, 0x13, 0x14,
+                                           0x1A, 0x1B, 0x1F, 0x20, 0x64, 0x65, 0x7F,
+                                           0x80, 0xFE, 0xFF };
+    int ops = 1 + (int)rng_below(4);
+    for (int i = 0; i < ops; i++) {
+        switch (rng_below(5)) {
+            case 0:
+                if (size > 0) buf[rng_below((uint32_t)size)] ^= (uint8_t)(1 << rng_below(8));
+                break;
+            case 1:
+                if (size > 0) buf[rng_below((uint32_t)size)] = interesting[rng_below(sizeof(interesting))];
+                break;
+            case 2:
+                if (size > 1) size -= 1 + rng_below((uint32_t)(size / 2));
+                break;
+            case 3:
+                if (size < FUZZ_MAX_INPUT) buf[size++] = (uint8_t)rng_below(256);
+                break;
+            default: {
+                const input_t *other = &s_corpus[rng_below((uint32_t)s_corpus_count)];
+                size_t n = other->size < FUZZ_MAX_INPUT - size ? other->size : FUZZ_MAX_INPUT - size;
+                memcpy(buf + size, other->data, n);
+                size += n;
+                break;
+            }
+        }
+    }
+    return size;
+}
+
+// Input under test, written out if it crashes
+static const uint8_t *s_current;
+static size_t s_current_size;
+static const char *s_save_dir = ".";
+
+static void save_finding(int sig)
+{
+    char path[512];
+    snprintf(path, sizeof(path), "%s/crash-%d.bin", s_save_dir, (int)getpid());
+    FILE *f = fopen(path, "wb");
+    if (f != NULL) {
+        fwrite(s_current, 1, s_current_size, f);
+        fclose(f);
+        fprintf(stderr, "Input saved to %s\n", path);
+    }
+    signal(sig, SIG_DFL);
+    raise(sig);
+}
+
+/* ============================================================================
+ * MAIN
+ * ============================================================================ */
+
+static double seconds(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void usage(const char *prog)
+{
+    fprintf(stderr,
+            "usage: %s [--mutate N] [--seed N] [--save DIR] [--bench SECONDS] FILE|DIR...\n"
+            "  no options: replay every input with invariant checks\n"
+            "  no inputs:  one input from stdin\n", prog);
+}
+
+int main(int argc, char **argv)
+{
+    long mutate_runs = 0;
+    double bench_sec = 0;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--mutate") == 0 && i + 1 < argc) {
+            mutate_runs = atol(argv[++i]);
+        } else if (strcmp(argv[i], "--seed") == 0 && i + 1 < argc) {
+            s_rng = strtoull(argv[++i], NULL, 0) | 1;
+        } else if (strcmp(argv[i], "--save") == 0 && i + 1 < argc) {
+            s_save_dir = argv[++i];
+        } else if (strcmp(argv[i], "--bench") == 0 && i + 1 < argc) {
+            bench_sec = atof(argv[++i]);
+        } else if (argv[i][0] == '-') {
+            usage(argv[0]);
+            return 2;
+        } else {
+            load_path(argv[i]);
+        }
+    }
+
+    if (s_corpus_count == 0) {
+        static uint8_t buf[FUZZ_MAX_INPUT];
+        size_t size = fread(buf, 1, sizeof(buf), stdin);
+        LLVMFuzzerTestOneInput(buf, size);
+        return 0;
+    }
+
+    // Replay: every input must hold all invariants
+    long frames = 0;
+    for (int i = 0; i < s_corpus_count; i++) {
+        s_input_name = s_corpus[i].name;
+        frames += session_run(s_corpus[i].data, s_corpus[i].size, true);
+    }
+    printf("%d inputs, %ld writes: all invariants held\n", s_corpus_count, frames);
+
+    if (mutate_runs > 0) {
+        static uint8_t buf[2 * FUZZ_MAX_INPUT];
+        signal(SIGABRT, save_finding);
+        signal(SIGSEGV, save_finding);
+        s_input_name = "mutated";
+        double start = seconds();
+        for (long iter = 0; iter < mutate_runs; iter++) {
+            const input_t *base = &s_corpus[rng_below((uint32_t)s_corpus_count)];
+            memcpy(buf, base->data, base->size);
+            size_t size = mutate(buf, base->size);
+            if (size > FUZZ_MAX_INPUT) {
+                size = FUZZ_MAX_INPUT;
+            }
+            s_current = buf;
+            s_current_size = size;
+            session_run(buf, size, true);
+        }
+        printf("%ld mutated sessions in %.2f s: all invariants held\n",
+               mutate_runs, seconds() - start);
+    }
+
+    if (bench_sec > 0) {
+        // Parser path only: writes without the invariant checks, then the
+        // status builder on its own
+        long writes = 0;
+        double start = seconds();
+        double elapsed;
+        do {
+            for (int i = 0; i < s_corpus_count; i++) {
+                writes += session_run(s_corpus[i].data, s_corpus[i].size, false);
+            }
+            elapsed = seconds() - start;
+        } while (elapsed < bench_sec);
+        printf("Writes:         %.0f commands/s (%ld in %.2f s, session setup included)\n",
+               writes / elapsed, writes, elapsed);
+
+        uint8_t status[GATTS_STATUS_MAX_LEN];
+        long reads = 0;
+        start = seconds();
+        do {
+            for (int i = 0; i < 10000; i++) {
+                ble_backend_posix_read_status(status);
+            }
+            reads += 10000;
+            elapsed = seconds() - start;
+        } while (elapsed < bench_sec);
+        printf("Status builds:  %.0f responses/s\n", reads / elapsed);
+    }
+    return 0;
+}
+
+#endif // AQUASENSE_LIBFUZZER
@@ -0,0 +1,19 @@
+/*
+ * Host build: esp_heap_caps.h subset (firmware/host/esp_posix.c)
+ */
+
+#ifndef HOST_ESP_HEAP_CAPS_H
+#define HOST_ESP_HEAP_CAPS_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define MALLOC_CAP_8BIT     (1 << 2)
+#define MALLOC_CAP_DEFAULT  (1 << 12)
+
+/**
+ * Constant on the host, like esp_get_free_heap_size()
+ */
+size_t heap_caps_get_largest_free_block(uint32_t caps);
+
+#endif // HOST_ESP_HEAP_CAPS_H
@@ -0,0 +1,40 @@
+/*
+ * Host build: esp_log.h subset (firmware/host)
+ * Lines go to stderr with the ESP-IDF "L (time) TAG: msg" layout, time taken
+ * from node_hal_time_us() so virtual-time runs log virtual timestamps.
+ */
+
+#ifndef HOST_ESP_LOG_H
+#define HOST_ESP_LOG_H
+
+#include <stdint.h>
+
+typedef enum {
+    ESP_LOG_NONE,
+    ESP_LOG_ERROR,
+    ESP_LOG_WARN,
+    ESP_LOG_INFO,
+    ESP_LOG_DEBUG,
+    ESP_LOG_VERBOSE
+} esp_log_level_t;
+
+/**
+ * Global level; "*" is the only tag supported
+ */
+void esp_log_level_set(const char *tag, esp_log_level_t level);
+
+void esp_log_write(esp_log_level_t level, const char *tag, const char *format, ...)
+    __attribute__((format(printf, 3, 4)));
+
+/**
+ * Milliseconds since start (node_hal_time_us() based, like the log lines)
+ */
+uint32_t esp_log_timestamp(void);
+
+#define ESP_LOGE(tag, format, ...) esp_log_write(ESP_LOG_ERROR, tag, format, ##__VA_ARGS__)
+#define ESP_LOGW(tag, format, ...) esp_log_write(ESP_LOG_WARN, tag, format, ##__VA_ARGS__)
+#define ESP_LOGI(tag, format, ...) esp_log_write(ESP_LOG_INFO, tag, format, ##__VA_ARGS__)
+#define ESP_LOGD(tag, format, ...) esp_log_write(ESP_LOG_DEBUG, tag, format, ##__VA_ARGS__)
+#define ESP_LOGV(tag, format, ...) esp_log_write(ESP_LOG_VERBOSE, tag, format, ##__VA_ARGS__)
+
+#endif // HOST_ESP_LOG_H
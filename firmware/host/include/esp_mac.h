@@ -0,0 +1,24 @@
+/*
+ * Host build: esp_mac.h subset (firmware/host/ble_backend_posix.c)
+ */
+
+#ifndef HOST_ESP_MAC_H
+#define HOST_ESP_MAC_H
+
+#include <stdint.h>
+#include "esp_err.h"
+
+typedef enum {
+    ESP_MAC_WIFI_STA,
+    ESP_MAC_WIFI_SOFTAP,
+    ESP_MAC_BT,
+    ESP_MAC_ETH,
+    ESP_MAC_IEEE802154,
+} esp_mac_type_t;
+
+/**
+ * Fixed per-process address (see ble_backend_posix_set_mac())
+ */
+esp_err_t esp_read_mac(uint8_t *mac, esp_mac_type_t type);
+
+#endif // HOST_ESP_MAC_H
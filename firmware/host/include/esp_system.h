@@ -0,0 +1,17 @@
+/*
+ * Host build: esp_system.h subset (firmware/host/esp_posix.c)
+ */
+
+#ifndef HOST_ESP_SYSTEM_H
+#define HOST_ESP_SYSTEM_H
+
+#include <stdint.h>
+#include "esp_err.h"
+
+/**
+ * Constant on the host: heap deltas read as 0
+ */
+uint32_t esp_get_free_heap_size(void);
+uint32_t esp_get_minimum_free_heap_size(void);
+
+#endif // HOST_ESP_SYSTEM_H
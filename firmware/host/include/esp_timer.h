@@ -0,0 +1,44 @@
+/*
+ * Host build: esp_timer.h subset (firmware/host)
+ *
+ * Timers fire from the simulator's scheduler (freertos_sim.c) before any
+ * task runs at the same instant, like the high-priority esp_timer task.
+ * Callbacks must not block.
+ */
+
+#ifndef HOST_ESP_TIMER_H
+#define HOST_ESP_TIMER_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "esp_err.h"
+
+typedef struct esp_timer *esp_timer_handle_t;
+typedef void (*esp_timer_cb_t)(void *arg);
+
+typedef enum {
+    ESP_TIMER_TASK,
+    ESP_TIMER_ISR,
+} esp_timer_dispatch_t;
+
+typedef struct {
+    esp_timer_cb_t       callback;
+    void                *arg;
+    esp_timer_dispatch_t dispatch_method;
+    const char          *name;
+    bool                 skip_unhandled_events;
+} esp_timer_create_args_t;
+
+/**
+ * Same clock as node_hal_time_us()
+ */
+int64_t esp_timer_get_time(void);
+
+esp_err_t esp_timer_create(const esp_timer_create_args_t *args, esp_timer_handle_t *out);
+esp_err_t esp_timer_start_once(esp_timer_handle_t timer, uint64_t timeout_us);
+esp_err_t esp_timer_start_periodic(esp_timer_handle_t timer, uint64_t period_us);
+esp_err_t esp_timer_stop(esp_timer_handle_t timer);
+esp_err_t esp_timer_delete(esp_timer_handle_t timer);
+bool esp_timer_is_active(esp_timer_handle_t timer);
+
+#endif // HOST_ESP_TIMER_H
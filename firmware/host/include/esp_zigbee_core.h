@@ -0,0 +1,368 @@
+/*
+ * Host build: esp_zigbee_core.h subset (firmware/host)
+ *
+ * The esp-zigbee-lib calls the node firmware makes, implemented by the mesh
+ * simulator in zb_sim.c: stack init and main loop, BDB commissioning
+ * (formation / steering), app signals, the Zigbee lock and scheduler alarms,
+ * endpoint and custom cluster registration, attribute writes, attribute
+ * reports and their send-status callback, the APS data indication and the
+ * neighbour table. Names, values and layouts follow
+ * the SDK so node code reads the same on both sides.
+ *
+ * Every call acts on the node that owns the calling task (zb_sim.h).
+ */
+
+#ifndef HOST_ESP_ZIGBEE_CORE_H
+#define HOST_ESP_ZIGBEE_CORE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "esp_err.h"
+#include "freertos/FreeRTOS.h"
+
+/* ============================================================================
+ * NETWORK CONFIGURATION
+ * ============================================================================ */
+
+typedef enum {
+    ESP_ZB_DEVICE_TYPE_COORDINATOR = 0x0,
+    ESP_ZB_DEVICE_TYPE_ROUTER      = 0x1,
+    ESP_ZB_DEVICE_TYPE_ED          = 0x2,
+    ESP_ZB_DEVICE_TYPE_NONE        = 0x3,
+} esp_zb_nwk_device_type_t;
+
+typedef enum {
+    ESP_ZB_ED_AGING_TIMEOUT_10SEC  = 0x00,
+    ESP_ZB_ED_AGING_TIMEOUT_2MIN   = 0x01,
+    ESP_ZB_ED_AGING_TIMEOUT_4MIN   = 0x02,
+    ESP_ZB_ED_AGING_TIMEOUT_8MIN   = 0x03,
+    ESP_ZB_ED_AGING_TIMEOUT_16MIN  = 0x04,
+    ESP_ZB_ED_AGING_TIMEOUT_32MIN  = 0x05,
+    ESP_ZB_ED_AGING_TIMEOUT_64MIN  = 0x06,
+} esp_zb_aging_timeout_t;
+
+typedef struct {
+    uint8_t  max_children;
+} esp_zb_zczr_cfg_t;
+
+typedef struct {
+    uint8_t  ed_timeout;
+    uint32_t keep_alive;
+} esp_zb_zed_cfg_t;
+
+typedef struct {
+    esp_zb_nwk_device_type_t esp_zb_role;
+    bool install_code_policy;
+    union {
+        esp_zb_zczr_cfg_t zczr_cfg;
+        esp_zb_zed_cfg_t  zed_cfg;
+    } nwk_cfg;
+} esp_zb_cfg_t;
+
+#define ESP_ZB_TRANSCEIVER_ALL_CHANNELS_MASK    0x07FFF800U
+#define ESP_ZB_AF_HA_PROFILE_ID                 0x0104U
+#define ESP_ZB_HA_CUSTOM_ATTR_DEVICE_ID         0xFFF2U
+
+/* ============================================================================
+ * STACK
+ * ============================================================================ */
+
+void esp_zb_init(esp_zb_cfg_t *nwk_cfg);
+esp_err_t esp_zb_start(bool autostart);
+
+/**
+ * Runs the node's stack in the calling task: app signals, received frames,
+ * send status and scheduler alarms are dispatched from here, under the
+ * Zigbee lock. Does not return.
+ */
+void esp_zb_stack_main_loop(void);
+
+esp_err_t esp_zb_set_channel_mask(uint32_t channel_mask);
+uint16_t esp_zb_get_pan_id(void);
+uint8_t esp_zb_get_current_channel(void);
+uint16_t esp_zb_get_short_address(void);
+
+bool esp_zb_lock_acquire(TickType_t block_ticks);
+void esp_zb_lock_release(void);
+
+typedef void (*esp_zb_callback_t)(uint8_t param);
+
+/**
+ * Call cb(param) from the stack task time_ms from now
+ */
+void esp_zb_scheduler_alarm(esp_zb_callback_t cb, uint8_t param, uint32_t time_ms);
+
+/* ============================================================================
+ * NWK: NEIGHBOUR TABLE
+ * ============================================================================ */
+
+typedef int esp_zb_nwk_info_iterator_t;
+#define ESP_ZB_NWK_INFO_ITERATOR_INIT   0
+
+typedef enum {
+    ESP_ZB_NWK_RELATIONSHIP_PARENT  = 0x00,
+    ESP_ZB_NWK_RELATIONSHIP_CHILD   = 0x01,
+    ESP_ZB_NWK_RELATIONSHIP_SIBLING = 0x02,
+    ESP_ZB_NWK_RELATIONSHIP_NONE_OF_THE_ABOVE = 0x03,
+} esp_zb_nwk_relationship_t;
+
+typedef struct {
+    uint8_t  ieee_addr[8];
+    uint16_t short_addr;
+    uint8_t  device_type;       // esp_zb_nwk_device_type_t
+    uint8_t  depth;
+    uint8_t  rx_on_when_idle;
+    uint8_t  relationship;      // esp_zb_nwk_relationship_t
+    uint8_t  lqi;
+    int8_t   rssi;
+    uint8_t  outgoing_cost;
+    uint8_t  age;
+    uint32_t device_timeout;
+    uint32_t timeout_counter;
+} esp_zb_nwk_neighbor_info_t;
+
+/**
+ * Next neighbour table entry after *iterator
+ *
+ * @return ESP_OK, ESP_ERR_NOT_FOUND past the last entry
+ */
+esp_err_t esp_zb_nwk_get_next_neighbor(esp_zb_nwk_info_iterator_t *iterator,
+                                       esp_zb_nwk_neighbor_info_t *nbr_info);
+
+/* ============================================================================
+ * COMMISSIONING AND APP SIGNALS
+ * ============================================================================ */
+
+typedef enum {
+    ESP_ZB_BDB_MODE_INITIALIZATION          = 0x00,
+    ESP_ZB_BDB_MODE_TOUCHLINK_COMMISSIONING = 0x01,
+    ESP_ZB_BDB_MODE_NETWORK_STEERING        = 0x02,
+    ESP_ZB_BDB_MODE_NETWORK_FORMATION       = 0x04,
+} esp_zb_bdb_commissioning_mode_mask_t;
+
+esp_err_t esp_zb_bdb_start_top_level_commissioning(uint8_t mode_mask);
+
+typedef enum {
+    ESP_ZB_ZDO_SIGNAL_DEFAULT_START     = 0x00,
+    ESP_ZB_ZDO_SIGNAL_SKIP_STARTUP      = 0x01,
+    ESP_ZB_ZDO_SIGNAL_DEVICE_ANNCE      = 0x02,
+    ESP_ZB_ZDO_SIGNAL_LEAVE             = 0x03,
+    ESP_ZB_BDB_SIGNAL_DEVICE_FIRST_START = 0x05,
+    ESP_ZB_BDB_SIGNAL_DEVICE_REBOOT     = 0x06,
+    ESP_ZB_BDB_SIGNAL_STEERING          = 0x0A,
+    ESP_ZB_BDB_SIGNAL_FORMATION         = 0x0B,
+} esp_zb_app_signal_type_t;
+
+typedef struct {
+    uint32_t  *p_app_signal;        // Signal type, parameters follow
+    esp_err_t  esp_err_status;
+} esp_zb_app_signal_t;
+
+typedef struct {
+    uint16_t device_short_addr;
+    uint8_t  ieee_addr[8];
+    uint8_t  capability;
+} esp_zb_zdo_signal_device_annce_params_t;
+
+/**
+ * Provided by the application (a weak no-op default exists on the host)
+ */
+void esp_zb_app_signal_handler(esp_zb_app_signal_t *signal_s);
+
+void *esp_zb_app_signal_get_params(uint32_t *signal_p);
+
+/* ============================================================================
+ * ZCL: ENDPOINTS, CLUSTERS, ATTRIBUTES
+ * ============================================================================ */
+
+typedef enum {
+    ESP_ZB_ZCL_CLUSTER_SERVER_ROLE = 0x01,
+    ESP_ZB_ZCL_CLUSTER_CLIENT_ROLE = 0x02,
+} esp_zb_zcl_cluster_role_t;
+
+typedef enum {
+    ESP_ZB_ZCL_ATTR_TYPE_BOOL   = 0x10,
+    ESP_ZB_ZCL_ATTR_TYPE_U8     = 0x20,
+    ESP_ZB_ZCL_ATTR_TYPE_U16    = 0x21,
+    ESP_ZB_ZCL_ATTR_TYPE_U32    = 0x23,
+    ESP_ZB_ZCL_ATTR_TYPE_S8     = 0x28,
+    ESP_ZB_ZCL_ATTR_TYPE_S16    = 0x29,
+    ESP_ZB_ZCL_ATTR_TYPE_OCTET_STRING = 0x41,   // Length byte first
+} esp_zb_zcl_attr_type_t;
+
+typedef enum {
+    ESP_ZB_ZCL_ATTR_ACCESS_READ_ONLY  = 0x01,
+    ESP_ZB_ZCL_ATTR_ACCESS_WRITE_ONLY = 0x02,
+    ESP_ZB_ZCL_ATTR_ACCESS_READ_WRITE = 0x03,
+    ESP_ZB_ZCL_ATTR_ACCESS_REPORTING  = 0x04,
+} esp_zb_zcl_attr_access_t;
+
+typedef enum {
+    ESP_ZB_ZCL_STATUS_SUCCESS       = 0x00,
+    ESP_ZB_ZCL_STATUS_FAIL          = 0x01,
+    ESP_ZB_ZCL_STATUS_INVALID_VALUE = 0x87,
+    ESP_ZB_ZCL_STATUS_UNSUP_ATTRIB  = 0x86,
+} esp_zb_zcl_status_t;
+
+typedef struct esp_zb_attribute_list_s esp_zb_attribute_list_t;
+typedef struct esp_zb_cluster_list_s esp_zb_cluster_list_t;
+typedef struct esp_zb_ep_list_s esp_zb_ep_list_t;
+
+typedef struct {
+    uint8_t  endpoint;
+    uint16_t app_profile_id;
+    uint16_t app_device_id;
+    uint32_t app_device_version;
+} esp_zb_endpoint_config_t;
+
+esp_zb_attribute_list_t *esp_zb_zcl_attr_list_create(uint16_t cluster_id);
+
+/**
+ * The initial value is copied in, as in the SDK: later writes go through
+ * esp_zb_zcl_set_attribute_val()
+ */
+esp_err_t esp_zb_custom_cluster_add_custom_attr(esp_zb_attribute_list_t *attr_list,
+                                                uint16_t attr_id, uint8_t type,
+                                                uint8_t access, void *value);
+
+esp_zb_cluster_list_t *esp_zb_zcl_cluster_list_create(void);
+esp_err_t esp_zb_cluster_list_add_custom_cluster(esp_zb_cluster_list_t *list,
+                                                 esp_zb_attribute_list_t *attr_list,
+                                                 uint8_t role_mask);
+esp_zb_ep_list_t *esp_zb_ep_list_create(void);
+esp_err_t esp_zb_ep_list_add_ep(esp_zb_ep_list_t *ep_list, esp_zb_cluster_list_t *cluster_list,
+                                esp_zb_endpoint_config_t endpoint_config);
+esp_err_t esp_zb_device_register(esp_zb_ep_list_t *ep_list);
+
+esp_zb_zcl_status_t esp_zb_zcl_set_attribute_val(uint8_t endpoint, uint16_t cluster_id,
+                                                 uint8_t cluster_role, uint16_t attr_id,
+                                                 void *value_p, bool check);
+
+/* ============================================================================
+ * ZCL: REPORTS
+ * ============================================================================ */
+
+typedef union {
+    uint16_t addr_short;
+    uint8_t  addr_long[8];
+} esp_zb_addr_u;
+
+typedef enum {
+    ESP_ZB_APS_ADDR_MODE_DST_ADDR_ENDP_NOT_PRESENT = 0x00,
+    ESP_ZB_APS_ADDR_MODE_16_GROUP_ENDP_NOT_PRESENT = 0x01,
+    ESP_ZB_APS_ADDR_MODE_16_ENDP_PRESENT           = 0x02,
+    ESP_ZB_APS_ADDR_MODE_64_ENDP_PRESENT           = 0x03,
+} esp_zb_aps_address_mode_t;
+
+typedef struct {
+    esp_zb_addr_u dst_addr_u;
+    uint8_t dst_endpoint;
+    uint8_t src_endpoint;
+} esp_zb_zcl_basic_cmd_t;
+
+typedef struct {
+    esp_zb_zcl_basic_cmd_t    zcl_basic_cmd;
+    esp_zb_aps_address_mode_t address_mode;
+    uint16_t clusterID;
+    uint16_t attributeID;
+    uint8_t  cluster_role;
+} esp_zb_zcl_report_attr_cmd_t;
+
+/**
+ * Send the attribute's current value. Only unicast to a short address is
+ * modelled (ESP_ZB_APS_ADDR_MODE_16_ENDP_PRESENT).
+ */
+esp_err_t esp_zb_zcl_report_attr_cmd_req(esp_zb_zcl_report_attr_cmd_t *cmd);
+
+/* ============================================================================
+ * ZCL: CALLBACKS
+ * ============================================================================ */
+
+typedef enum {
+    ESP_ZB_CORE_SET_ATTR_VALUE_CB_ID = 0x0000,
+    ESP_ZB_CORE_REPORT_ATTR_CB_ID    = 0x2000,
+} esp_zb_core_action_callback_id_t;
+
+typedef struct {
+    uint8_t  type;
+    uint16_t size;
+    void    *value;
+} esp_zb_zcl_attribute_data_t;
+
+typedef struct {
+    uint16_t id;
+    esp_zb_zcl_attribute_data_t data;
+} esp_zb_zcl_attribute_t;
+
+typedef struct {
+    esp_zb_zcl_status_t status;
+    uint8_t  dst_endpoint;
+    uint16_t cluster;
+} esp_zb_device_cb_common_info_t;
+
+typedef struct {
+    esp_zb_device_cb_common_info_t info;
+    esp_zb_zcl_attribute_t attribute;
+} esp_zb_zcl_set_attr_value_message_t;
+
+typedef struct {
+    uint8_t addr_type;
+    union {
+        uint16_t short_addr;
+        uint8_t  ieee_addr[8];
+    } u;
+} esp_zb_zcl_addr_t;
+
+typedef struct {
+    esp_zb_zcl_status_t status;
+    esp_zb_zcl_addr_t src_address;
+    uint8_t  src_endpoint;
+    uint8_t  dst_endpoint;
+    uint16_t cluster;
+    esp_zb_zcl_attribute_t attribute;
+} esp_zb_zcl_report_attr_message_t;
+
+typedef esp_err_t (*esp_zb_core_action_callback_t)(esp_zb_core_action_callback_id_t callback_id,
+                                                   const void *message);
+void esp_zb_core_action_handler_register(esp_zb_core_action_callback_t cb);
+
+typedef struct {
+    esp_err_t status;               // ESP_OK once the first hop acknowledged
+    uint8_t   tsn;
+    esp_zb_zcl_addr_t dst_addr;
+    uint8_t   dst_endpoint;
+    uint8_t   src_endpoint;
+} esp_zb_zcl_command_send_status_message_t;
+
+typedef void (*esp_zb_zcl_command_send_status_callback_t)(esp_zb_zcl_command_send_status_message_t message);
+void esp_zb_zcl_command_send_status_handler_register(esp_zb_zcl_command_send_status_callback_t cb);
+
+/* ============================================================================
+ * APS: DATA INDICATION
+ * ============================================================================ */
+
+typedef struct {
+    uint8_t  states;
+    uint8_t  dst_addr_mode;
+    uint16_t dst_short_addr;
+    uint8_t  dst_endpoint;
+    uint16_t src_short_addr;    // Originator, not the last hop
+    uint8_t  src_endpoint;
+    uint16_t profile_id;
+    uint16_t cluster_id;
+    uint32_t asdu_length;       // The ZCL payload is not modelled: 0
+    uint8_t *asdu;
+    uint8_t  security_status;
+    int      lqi;               // Of the last hop
+    int      rx_time;
+} esp_zb_apsde_data_ind_t;
+
+/**
+ * Called for every APS frame received, before ZCL processing
+ *
+ * @return true if the frame was handled: the stack drops it
+ */
+typedef bool (*esp_zb_aps_data_indication_callback_t)(esp_zb_apsde_data_ind_t ind);
+void esp_zb_aps_data_indication_handler_register(esp_zb_aps_data_indication_callback_t cb);
+
+#endif // HOST_ESP_ZIGBEE_CORE_H
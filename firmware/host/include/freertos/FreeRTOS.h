@@ -0,0 +1,46 @@
+/*
+ * Host build: FreeRTOS.h subset (firmware/host)
+ *
+ * Kernel objects are implemented by the discrete-event simulator in
+ * freertos_sim.c; time is the node_hal_posix clock, so vTaskDelay() and
+ * blocking timeouts cost no wall time.
+ */
+
+#ifndef HOST_FREERTOS_H
+#define HOST_FREERTOS_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+typedef uint32_t TickType_t;
+typedef int      BaseType_t;
+typedef unsigned UBaseType_t;
+typedef void   (*TaskFunction_t)(void *);
+
+#define configTICK_RATE_HZ      100     // CONFIG_FREERTOS_HZ in sdkconfig.defaults
+#define configMAX_PRIORITIES    25
+#define configNUM_THREAD_LOCAL_STORAGE_POINTERS 4
+#define configMAX_TASK_NAME_LEN 16
+#define configUSE_TRACE_FACILITY        1   // uxTaskGetSystemState()
+#define configGENERATE_RUN_TIME_STATS   1   // ulRunTimeCounter, see task.h
+#define portTICK_PERIOD_MS      ((TickType_t)(1000 / configTICK_RATE_HZ))
+#define portMAX_DELAY           ((TickType_t)0xFFFFFFFFUL)
+#define pdMS_TO_TICKS(ms)       ((TickType_t)(((uint64_t)(ms) * configTICK_RATE_HZ) / 1000))
+
+#define pdFALSE                 ((BaseType_t)0)
+#define pdTRUE                  ((BaseType_t)1)
+#define pdFAIL                  pdFALSE
+#define pdPASS                  pdTRUE
+#define errQUEUE_EMPTY          ((BaseType_t)0)
+#define errQUEUE_FULL           ((BaseType_t)0)
+
+// One task runs at a time and only switches where it blocks or yields, so
+// critical sections have nothing to exclude
+typedef int portMUX_TYPE;
+#define portMUX_INITIALIZER_UNLOCKED    0
+#define portENTER_CRITICAL(mux)         ((void)(mux))
+#define portEXIT_CRITICAL(mux)          ((void)(mux))
+#define portYIELD_FROM_ISR(woken)       ((void)(woken))
+
+#endif // HOST_FREERTOS_H
@@ -0,0 +1,27 @@
+/*
+ * Host build: FreeRTOS event_groups.h subset (firmware/host)
+ */
+
+#ifndef HOST_FREERTOS_EVENT_GROUPS_H
+#define HOST_FREERTOS_EVENT_GROUPS_H
+
+#include "freertos/FreeRTOS.h"
+
+typedef struct EventGroupDef_t *EventGroupHandle_t;
+typedef uint32_t EventBits_t;
+
+EventGroupHandle_t xEventGroupCreate(void);
+void vEventGroupDelete(EventGroupHandle_t group);
+
+/**
+ * Waiters are evaluated when the bits are set, so a task that sets and
+ * immediately clears a bit still releases everyone waiting on it.
+ */
+EventBits_t xEventGroupSetBits(EventGroupHandle_t group, EventBits_t bits);
+EventBits_t xEventGroupClearBits(EventGroupHandle_t group, EventBits_t bits);
+EventBits_t xEventGroupGetBits(EventGroupHandle_t group);
+EventBits_t xEventGroupWaitBits(EventGroupHandle_t group, EventBits_t bits,
+                                BaseType_t clear_on_exit, BaseType_t wait_for_all,
+                                TickType_t ticks);
+
+#endif // HOST_FREERTOS_EVENT_GROUPS_H
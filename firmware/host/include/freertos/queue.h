@@ -0,0 +1,30 @@
+/*
+ * Host build: FreeRTOS queue.h subset (firmware/host)
+ */
+
+#ifndef HOST_FREERTOS_QUEUE_H
+#define HOST_FREERTOS_QUEUE_H
+
+#include "freertos/FreeRTOS.h"
+
+typedef struct QueueDefinition *QueueHandle_t;
+
+QueueHandle_t xQueueCreate(UBaseType_t length, UBaseType_t item_size);
+void vQueueDelete(QueueHandle_t queue);
+
+BaseType_t xQueueSend(QueueHandle_t queue, const void *item, TickType_t ticks);
+BaseType_t xQueueSendToFront(QueueHandle_t queue, const void *item, TickType_t ticks);
+#define xQueueSendToBack(q, item, ticks)    xQueueSend((q), (item), (ticks))
+BaseType_t xQueueOverwrite(QueueHandle_t queue, const void *item);
+BaseType_t xQueueReceive(QueueHandle_t queue, void *item, TickType_t ticks);
+BaseType_t xQueuePeek(QueueHandle_t queue, void *item, TickType_t ticks);
+BaseType_t xQueueReset(QueueHandle_t queue);
+
+UBaseType_t uxQueueMessagesWaiting(QueueHandle_t queue);
+UBaseType_t uxQueueSpacesAvailable(QueueHandle_t queue);
+
+// ISR variants never block; esp_timer callbacks may use either form
+#define xQueueSendFromISR(q, item, woken)       xQueueSend((q), (item), ((void)(woken), 0))
+#define xQueueReceiveFromISR(q, item, woken)    xQueueReceive((q), (item), ((void)(woken), 0))
+
+#endif // HOST_FREERTOS_QUEUE_H
@@ -0,0 +1,31 @@
+/*
+ * Host build: FreeRTOS semphr.h subset (firmware/host)
+ *
+ * Semaphores are zero-size queues, as in the real kernel. Mutexes track
+ * their holder but do not implement priority inheritance.
+ */
+
+#ifndef HOST_FREERTOS_SEMPHR_H
+#define HOST_FREERTOS_SEMPHR_H
+
+#include "freertos/queue.h"
+#include "freertos/task.h"
+
+typedef QueueHandle_t SemaphoreHandle_t;
+
+SemaphoreHandle_t xSemaphoreCreateBinary(void);
+SemaphoreHandle_t xSemaphoreCreateCounting(UBaseType_t max_count, UBaseType_t initial_count);
+SemaphoreHandle_t xSemaphoreCreateMutex(void);
+SemaphoreHandle_t xSemaphoreCreateRecursiveMutex(void);
+
+BaseType_t xSemaphoreTake(SemaphoreHandle_t sem, TickType_t ticks);
+BaseType_t xSemaphoreGive(SemaphoreHandle_t sem);
+BaseType_t xSemaphoreTakeRecursive(SemaphoreHandle_t sem, TickType_t ticks);
+BaseType_t xSemaphoreGiveRecursive(SemaphoreHandle_t sem);
+UBaseType_t uxSemaphoreGetCount(SemaphoreHandle_t sem);
+TaskHandle_t xSemaphoreGetMutexHolder(SemaphoreHandle_t sem);
+
+#define vSemaphoreDelete(sem)                   vQueueDelete(sem)
+#define xSemaphoreGiveFromISR(sem, woken)       ((void)(woken), xSemaphoreGive(sem))
+
+#endif // HOST_FREERTOS_SEMPHR_H
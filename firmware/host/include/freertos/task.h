@@ -0,0 +1,95 @@
+/*
+ * Host build: FreeRTOS task.h subset (firmware/host)
+ */
+
+#ifndef HOST_FREERTOS_TASK_H
+#define HOST_FREERTOS_TASK_H
+
+#include "freertos/FreeRTOS.h"
+
+typedef struct sim_task *TaskHandle_t;
+
+#define tskIDLE_PRIORITY    0
+
+/**
+ * usStackDepth is in bytes, as on ESP-IDF. Tasks run on host stacks of at
+ * least SIM_TASK_MIN_STACK bytes so printf and the sanitizers fit.
+ */
+BaseType_t xTaskCreate(TaskFunction_t fn, const char *name, uint32_t usStackDepth,
+                       void *arg, UBaseType_t priority, TaskHandle_t *out);
+BaseType_t xTaskCreatePinnedToCore(TaskFunction_t fn, const char *name, uint32_t usStackDepth,
+                                   void *arg, UBaseType_t priority, TaskHandle_t *out,
+                                   BaseType_t core);
+void vTaskDelete(TaskHandle_t task);
+
+/**
+ * Block for a number of ticks. Wake-ups land on tick boundaries like the
+ * real kernel, so vTaskDelay(1) sleeps anywhere up to one tick.
+ */
+void vTaskDelay(TickType_t ticks);
+BaseType_t xTaskDelayUntil(TickType_t *previous_wake, TickType_t increment);
+#define vTaskDelayUntil(prev, inc)  ((void)xTaskDelayUntil((prev), (inc)))
+
+void taskYIELD(void);
+
+TickType_t xTaskGetTickCount(void);
+TaskHandle_t xTaskGetCurrentTaskHandle(void);
+char *pcTaskGetName(TaskHandle_t task);
+UBaseType_t uxTaskPriorityGet(TaskHandle_t task);
+
+/**
+ * Per-task pointers (index < configNUM_THREAD_LOCAL_STORAGE_POINTERS);
+ * NULL task means the calling task
+ */
+void vTaskSetThreadLocalStoragePointer(TaskHandle_t task, BaseType_t index, void *value);
+void *pvTaskGetThreadLocalStoragePointer(TaskHandle_t task, BaseType_t index);
+
+/* ============================================================================
+ * INTROSPECTION
+ * ============================================================================ */
+
+typedef enum {
+    eRunning = 0,
+    eReady,
+    eBlocked,
+    eSuspended,
+    eDeleted,
+    eInvalid,
+} eTaskState;
+
+typedef struct {
+    TaskHandle_t xHandle;
+    const char  *pcTaskName;
+    UBaseType_t  xTaskNumber;           // Unique for the life of the simulation
+    eTaskState   eCurrentState;
+    UBaseType_t  uxCurrentPriority;
+    UBaseType_t  uxBasePriority;
+    uint32_t     ulRunTimeCounter;      // us of host CPU while the task ran (wraps)
+    uint32_t     usStackHighWaterMark;  // Bytes, see uxTaskGetStackHighWaterMark()
+} TaskStatus_t;
+
+UBaseType_t uxTaskGetNumberOfTasks(void);
+
+/**
+ * Fill up to array_size entries; total_runtime gets the run-time clock
+ * (host CPU us since sim_reset(), wraps like the ESP-IDF counter).
+ * @return Entries filled, 0 if array_size is below the task count
+ */
+UBaseType_t uxTaskGetSystemState(TaskStatus_t *array, UBaseType_t array_size,
+                                 uint32_t *total_runtime);
+
+/**
+ * Least stack headroom the task has had, in bytes of the usStackDepth it
+ * was created with (0 if it used more). Host frames (x86-64, glibc printf)
+ * are larger than on the ESP32-H2, so this is a pessimistic estimate.
+ */
+UBaseType_t uxTaskGetStackHighWaterMark(TaskHandle_t task);
+
+/**
+ * Trace-tool task number: 0 until set, unrelated to xTaskNumber. NULL
+ * means the calling task for the setter; the getter returns 0 for NULL.
+ */
+UBaseType_t uxTaskGetTaskNumber(TaskHandle_t task);
+void vTaskSetTaskNumber(TaskHandle_t task, UBaseType_t number);
+
+#endif // HOST_FREERTOS_TASK_H
@@ -0,0 +1,10 @@
+/*
+ * Host build: nvs_flash.h (the in-memory NVS needs no partition init)
+ */
+
+#ifndef HOST_NVS_FLASH_H
+#define HOST_NVS_FLASH_H
+
+#include "nvs.h"
+
+#endif // HOST_NVS_FLASH_H
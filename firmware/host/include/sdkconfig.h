@@ -0,0 +1,8 @@
+/*
+ * Host build: sdkconfig.h. No coexistence hardware, no radio options set.
+ */
+
+#ifndef HOST_SDKCONFIG_H
+#define HOST_SDKCONFIG_H
+
+#endif // HOST_SDKCONFIG_H
@@ -0,0 +1,795 @@
+/*
+ * Cultivio AquaSense - Mesh Host Runner
+ * Runs a whole Zigbee network on Linux: one controller (coordinator),
+ * routers, and sensors (end devices), each with its own board, stack task
+ * and firmware tasks, over the simulated mesh (zb_sim.h).
+ *
+ * Usage: mesh_host [--nodes N] [--sensors N] [--topology star|line|grid|random]
+ *                  [--latency-ms X] [--jitter-ms X] [--loss PCT] [--retries N]
+ *                  [--seed N] [--days N | --seconds N] [--legacy-controller]
+ *                  [--stamp-only] [-v] [--check]
+ *
+ * Node 0 is the controller, the last --sensors nodes are sensors watching
+ * one shared tank, the rest are routers. The Zigbee glue below follows
+ * unified_main.c (signal handler, action handler, report retries), so what
+ * is measured is the firmware's behaviour: join time, end-to-end report
+ * latency, delivery, and how long the controller takes to start the pump
+ * once a sensor reads the tank as low.
+ *
+ * Sensors report the stamped level (e2e.h) and keep network time from the
+ * controller's beacons (net_time.h), so the controller's per-sensor
+ * sample->rx and rx->relay histograms are the firmware's own. All nodes
+ * really share one clock here: a synced sensor's offset is exactly its
+ * sync error, printed as such.
+ *
+ * Until a sensor has network time, each stamp is followed by the bare
+ * percentage, as unified_main.c sends it for controllers from before the
+ * stamp. --legacy-controller makes the
+ * controller one of those (like controller_node.c: percentage reports only,
+ * no stamps, no network time); --stamp-only drops the bare copy, which such
+ * a controller never hears from.
+ *
+ * The controller keeps smoothed link quality per peer (link_quality.h) from
+ * every frame's LQI and a neighbour table scan every 10 s, as unified_main.c
+ * does; each neighbour is printed against its simulated link mean.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "esp_zigbee_core.h"
+#include "config_derived.h"
+#include "metrics.h"
+#include "e2e.h"
+#include "net_time.h"
+#include "link_quality.h"
+#include "water_level.h"
+#include "pump_control.h"
+#include "radio_coex.h"
+#include "tank_plant.h"
+#include "node_hal_posix.h"
+#include "sim.h"
+#include "zb_sim.h"
+#include "zb_instr.h"
+
+static const char *TAG = "MESH";
+
+/* ============================================================================
+ * TANK
+ * ============================================================================ */
+
+#define TANK_STEP_US            1000000 // Plant model update period
+
+/* ============================================================================
+ * NODES
+ * ============================================================================ */
+
+#define DEVICE_ENDPOINT         NODE_ZB_ENDPOINT
+#define CLUSTER_WATER_LEVEL     NODE_ZB_CLUSTER_WATER_LEVEL
+#define CLUSTER_NET_TIME        NODE_ZB_CLUSTER_NET_TIME
+
+#define ZB_TASK_PRIORITY        5
+#define SENSOR_TASK_PRIORITY    5
+#define CONTROL_TASK_PRIORITY   4
+#define CONTROLLER_NODE         0
+#define SENSOR_BOOT_SPREAD_MS   1237    // Sensors power up this far apart
+#define LINK_SCAN_US            (10LL * 1000000)    // Neighbour table scans, as DIAG_REFRESH_US
+#define LINK_CHECK_DB           3       // Smoothed RSSI within this of the link mean
+
+typedef struct {
+    prov_node_type_t type;
+    bool        connected;
+    node_hal_posix_board_t *board;
+
+    // Sensor
+    water_level_t level;
+    uint8_t     report_retries;         // Retries spent on the current report
+    uint8_t     report_frames_pending;  // Send statuses still due for this report
+    bool        report_frames_ok;
+    uint16_t    report_seq;
+    uint8_t     stamp[E2E_STAMP_ATTR_SIZE];
+    bool        report_copy;            // Follow the stamp with the bare percentage
+    net_time_t  net_time;
+
+    // Controller
+    uint32_t    net_time_ms;            // Beacon attribute storage
+} mesh_node_t;
+
+static mesh_node_t s_nodes[ZB_SIM_MAX_NODES];
+static config_derived_t s_dc;
+static tank_plant_t s_plant;
+static pump_control_t s_pump;
+
+// Controller reaction: a sensor reads at or below the ON threshold -> relay on
+static int64_t s_low_since_us = -1;
+static uint32_t s_reactions;
+static int64_t s_reaction_sum_us;
+static int64_t s_reaction_max_us;
+static int s_node_total;
+
+static uint32_t s_reports_received;
+static uint32_t s_reports_retried;
+static uint32_t s_reports_abandoned;
+static uint32_t s_beacons_sent;
+static uint32_t s_copies_sent;          // Bare percentages after a stamp
+static bool s_legacy_controller;
+static bool s_stamp_only;
+
+static mesh_node_t *self(void)
+{
+    return &s_nodes[zb_sim_current_node()];
+}
+
+static bool relay_on(void)
+{
+    node_hal_posix_stats_t hal;
+    node_hal_posix_select(s_nodes[CONTROLLER_NODE].board);
+    node_hal_posix_get_stats(&hal);
+    node_hal_posix_select(NULL);
+    return hal.relay_on;
+}
+
+static void tank_step(void *arg)
+{
+    (void)arg;
+    bool pump_on = relay_on();
+    tank_plant_step(&s_plant, pump_on, node_hal_time_us());
+}
+
+// Sensor side: a reading at or below the ON threshold while the pump is off.
+// Peeks at the controller's state directly; relay_on() would read this
+// task's own board.
+static void reaction_mark_low(const water_level_t *level)
+{
+    if (level->percent <= s_dc.pump_on_pct && s_low_since_us < 0 && !s_pump.running) {
+        s_low_since_us = node_hal_time_us();
+    }
+}
+
+// Controller side, after each pump control call
+static void reaction_check(void)
+{
+    if (s_low_since_us >= 0 && s_pump.running) {
+        int64_t reaction = node_hal_time_us() - s_low_since_us;
+        s_reactions++;
+        s_reaction_sum_us += reaction;
+        if (reaction > s_reaction_max_us) s_reaction_max_us = reaction;
+        s_low_since_us = -1;
+    }
+}
+
+/* ============================================================================
+ * ZIGBEE - SENSOR ROLE
+ * ============================================================================ */
+
+static esp_zb_cluster_list_t *create_sensor_clusters(mesh_node_t *node)
+{
+    esp_zb_cluster_list_t *cluster_list = esp_zb_zcl_cluster_list_create();
+    esp_zb_attribute_list_t *water_cluster = esp_zb_zcl_attr_list_create(CLUSTER_WATER_LEVEL);
+
+    esp_zb_custom_cluster_add_custom_attr(water_cluster, NODE_ZB_ATTR_LEVEL_PCT,
+        ESP_ZB_ZCL_ATTR_TYPE_U8, ESP_ZB_ZCL_ATTR_ACCESS_READ_ONLY | ESP_ZB_ZCL_ATTR_ACCESS_REPORTING,
+        &node->level.percent);
+    esp_zb_custom_cluster_add_custom_attr(water_cluster, NODE_ZB_ATTR_LEVEL_CM,
+        ESP_ZB_ZCL_ATTR_TYPE_U16, ESP_ZB_ZCL_ATTR_ACCESS_READ_ONLY | ESP_ZB_ZCL_ATTR_ACCESS_REPORTING,
+        &node->level.cm);
+    esp_zb_custom_cluster_add_custom_attr(water_cluster, NODE_ZB_ATTR_SENSOR_STATUS,
+        ESP_ZB_ZCL_ATTR_TYPE_U8, ESP_ZB_ZCL_ATTR_ACCESS_READ_ONLY,
+        &node->level.status);
+    esp_zb_custom_cluster_add_custom_attr(water_cluster, NODE_ZB_ATTR_LEVEL_STAMP,
+        ESP_ZB_ZCL_ATTR_TYPE_OCTET_STRING, ESP_ZB_ZCL_ATTR_ACCESS_READ_ONLY | ESP_ZB_ZCL_ATTR_ACCESS_REPORTING,
+        node->stamp);
+
+    esp_zb_cluster_list_add_custom_cluster(cluster_list, water_cluster, ESP_ZB_ZCL_CLUSTER_SERVER_ROLE);
+    return cluster_list;
+}
+
+// Caller holds the Zigbee lock
+static void publish_stamp(mesh_node_t *node)
+{
+    e2e_stamp_t stamp = {
+        .level_pct = node->level.percent,
+        .status = node->level.status,
+        .seq = ++node->report_seq,
+        .sample_ms = net_time_now_ms(&node->net_time),
+        .flags = net_time_synced(&node->net_time) ? E2E_STAMP_SYNCED : 0,
+    };
+    e2e_stamp_encode(&stamp, node->stamp);
+    esp_zb_zcl_set_attribute_val(DEVICE_ENDPOINT, CLUSTER_WATER_LEVEL,
+        ESP_ZB_ZCL_CLUSTER_SERVER_ROLE, NODE_ZB_ATTR_LEVEL_STAMP, node->stamp, false);
+    node->report_copy = !s_stamp_only && !(stamp.flags & E2E_STAMP_SYNCED);
+}
+
+static void send_report_cmd(void)
+{
+    esp_zb_zcl_report_attr_cmd_t report_cmd = {
+        .zcl_basic_cmd = {
+            .dst_addr_u.addr_short = 0x0000,
+            .dst_endpoint = DEVICE_ENDPOINT,
+            .src_endpoint = DEVICE_ENDPOINT,
+        },
+        .address_mode = ESP_ZB_APS_ADDR_MODE_16_ENDP_PRESENT,
+        .clusterID = CLUSTER_WATER_LEVEL,
+        .attributeID = NODE_ZB_ATTR_LEVEL_STAMP,
+    };
+    mesh_node_t *node = self();
+    node->report_frames_pending = node->report_copy ? 2 : 1;
+    node->report_frames_ok = true;
+    esp_zb_zcl_report_attr_cmd_req(&report_cmd);
+    if (node->report_copy) {
+        report_cmd.attributeID = NODE_ZB_ATTR_LEVEL_PCT;
+        esp_zb_zcl_report_attr_cmd_req(&report_cmd);
+        s_copies_sent++;
+    }
+}
+
+static void report_retry_cb(uint8_t param)
+{
+    (void)param;
+    int64_t start_us = zb_instr_callback_begin();
+    if (self()->connected) {
+        send_report_cmd();
+    }
+    zb_instr_callback_end(ZB_CB_ALARM, start_us);
+}
+
+// Same policy as radio_coex_report_result(): a couple of quick retries,
+// once both frames of a report are accounted for
+static void zcl_send_status_cb(esp_zb_zcl_command_send_status_message_t message)
+{
+    int64_t start_us = zb_instr_callback_begin();
+    mesh_node_t *node = self();
+    if (message.status != ESP_OK) {
+        node->report_frames_ok = false;
+    }
+    if (node->report_frames_pending == 0 || --node->report_frames_pending > 0) {
+        // Not a report, or its other frame is still out
+    } else if (node->report_frames_ok) {
+        node->report_retries = 0;
+    } else if (node->report_retries < RADIO_COEX_REPORT_MAX_RETRIES) {
+        node->report_retries++;
+        s_reports_retried++;
+        esp_zb_scheduler_alarm(report_retry_cb, 0, RADIO_COEX_REPORT_RETRY_MS);
+    } else {
+        node->report_retries = 0;
+        s_reports_abandoned++;
+    }
+    zb_instr_callback_end(ZB_CB_SEND_STATUS, start_us);
+}
+
+static void sensor_task(void *arg)
+{
+    mesh_node_t *node = arg;
+
+    // Boards never boot in lockstep; neither should their reports
+    uint32_t boot_ms = (uint32_t)zb_sim_current_node() * SENSOR_BOOT_SPREAD_MS;
+    vTaskDelay(pdMS_TO_TICKS(boot_ms % s_dc.report_interval_ms));
+
+    for (;;) {
+        water_level_measure(&s_dc, &node->level);
+        reaction_mark_low(&node->level);
+
+        zb_lock_held_t held = zb_instr_lock(ZB_LOCK_SITE_SENSOR_REPORT);
+        water_level_publish(&node->level);
+        publish_stamp(node);
+        if (node->connected) {
+            node->report_retries = 0;
+            send_report_cmd();
+        }
+        zb_instr_unlock(&held);
+
+        vTaskDelay(pdMS_TO_TICKS(s_dc.report_interval_ms));
+    }
+}
+
+/* ============================================================================
+ * ZIGBEE - CONTROLLER ROLE
+ * ============================================================================ */
+
+static esp_zb_cluster_list_t *create_controller_clusters(void)
+{
+    esp_zb_cluster_list_t *cluster_list = esp_zb_zcl_cluster_list_create();
+    esp_zb_attribute_list_t *water_cluster = esp_zb_zcl_attr_list_create(CLUSTER_WATER_LEVEL);
+
+    esp_zb_custom_cluster_add_custom_attr(water_cluster, NODE_ZB_ATTR_LEVEL_PCT,
+        ESP_ZB_ZCL_ATTR_TYPE_U8, ESP_ZB_ZCL_ATTR_ACCESS_READ_WRITE, &s_pump.water_level_pct);
+    esp_zb_custom_cluster_add_custom_attr(water_cluster, NODE_ZB_ATTR_PUMP_STATE,
+        ESP_ZB_ZCL_ATTR_TYPE_U8, ESP_ZB_ZCL_ATTR_ACCESS_READ_ONLY, &s_pump.state_attr);
+
+    esp_zb_cluster_list_add_custom_cluster(cluster_list, water_cluster, ESP_ZB_ZCL_CLUSTER_CLIENT_ROLE);
+
+    esp_zb_attribute_list_t *time_cluster = esp_zb_zcl_attr_list_create(CLUSTER_NET_TIME);
+    esp_zb_custom_cluster_add_custom_attr(time_cluster, NODE_ZB_ATTR_NET_TIME_MS,
+        ESP_ZB_ZCL_ATTR_TYPE_U32, ESP_ZB_ZCL_ATTR_ACCESS_READ_ONLY | ESP_ZB_ZCL_ATTR_ACCESS_REPORTING,
+        &s_nodes[CONTROLLER_NODE].net_time_ms);
+    esp_zb_cluster_list_add_custom_cluster(cluster_list, time_cluster, ESP_ZB_ZCL_CLUSTER_SERVER_ROLE);
+    return cluster_list;
+}
+
+// Our network time to one sensor, stamped as late as possible. Caller holds
+// the Zigbee lock.
+static void send_net_time(uint16_t addr)
+{
+    uint32_t now_ms = net_time_now_ms(NULL);
+    esp_zb_zcl_set_attribute_val(DEVICE_ENDPOINT, CLUSTER_NET_TIME, ESP_ZB_ZCL_CLUSTER_SERVER_ROLE,
+                                 NODE_ZB_ATTR_NET_TIME_MS, &now_ms, false);
+    esp_zb_zcl_report_attr_cmd_t report_cmd = {
+        .zcl_basic_cmd = {
+            .dst_addr_u.addr_short = addr,
+            .dst_endpoint = DEVICE_ENDPOINT,
+            .src_endpoint = DEVICE_ENDPOINT,
+        },
+        .address_mode = ESP_ZB_APS_ADDR_MODE_16_ENDP_PRESENT,
+        .clusterID = CLUSTER_NET_TIME,
+        .attributeID = NODE_ZB_ATTR_NET_TIME_MS,
+    };
+    esp_zb_zcl_report_attr_cmd_req(&report_cmd);
+    s_beacons_sent++;
+}
+
+static void control_task(void *arg)
+{
+    (void)arg;
+    int64_t beacon_us = 0;
+    int64_t scan_us = 0;
+    for (;;) {
+        zb_lock_held_t held = zb_instr_lock(ZB_LOCK_SITE_CONTROL);
+        pump_control_step(&s_pump, &s_dc);
+        reaction_check();
+        if (node_hal_time_us() - beacon_us >= NET_TIME_BEACON_PERIOD_MS * 1000LL) {
+            beacon_us = node_hal_time_us();
+            e2e_sensor_t sensors[E2E_MAX_SENSORS];
+            int n = e2e_get_sensors(sensors, E2E_MAX_SENSORS);
+            for (int i = 0; i < n; i++) {
+                send_net_time(sensors[i].addr);
+            }
+        }
+        if (node_hal_time_us() - scan_us >= LINK_SCAN_US) {
+            scan_us = node_hal_time_us();
+            link_sample_t nbrs[LINK_MAX_PEERS];
+            int count = node_hal_zb_neighbors(nbrs, LINK_MAX_PEERS);
+            link_quality_scan(nbrs, count < LINK_MAX_PEERS ? count : LINK_MAX_PEERS);
+        }
+        zb_instr_unlock(&held);
+        vTaskDelay(pdMS_TO_TICKS(1000));
+    }
+}
+
+/* ============================================================================
+ * ZIGBEE CALLBACKS
+ * ============================================================================ */
+
+static esp_err_t zb_action_handler(esp_zb_core_action_callback_id_t callback_id, const void *message)
+{
+    int64_t start_us = zb_instr_callback_begin();
+    const esp_zb_zcl_report_attr_message_t *msg = message;
+    if (callback_id != ESP_ZB_CORE_REPORT_ATTR_CB_ID) {
+        // Nothing else to handle
+    } else if (self()->type == NODE_TYPE_CONTROLLER && msg->cluster == CLUSTER_WATER_LEVEL &&
+               msg->attribute.id == NODE_ZB_ATTR_LEVEL_STAMP && !s_legacy_controller) {
+        e2e_stamp_t stamp;
+        if (e2e_stamp_decode(msg->attribute.data.value, msg->attribute.data.size, &stamp) == ESP_OK) {
+            if (e2e_report_rx(msg->src_address.u.short_addr, &stamp, net_time_now_ms(NULL))) {
+                send_net_time(msg->src_address.u.short_addr);
+            }
+            pump_control_sensor_update(&s_pump, stamp.level_pct);
+            reaction_check();
+            s_reports_received++;
+        }
+    } else if (self()->type == NODE_TYPE_CONTROLLER && msg->cluster == CLUSTER_WATER_LEVEL &&
+               msg->attribute.id == NODE_ZB_ATTR_LEVEL_PCT &&
+               (s_legacy_controller || !e2e_sends_copy(msg->src_address.u.short_addr))) {
+        pump_control_sensor_update(&s_pump, *(uint8_t *)msg->attribute.data.value);
+        reaction_check();
+        s_reports_received++;
+    } else if (self()->type == NODE_TYPE_SENSOR && msg->cluster == CLUSTER_NET_TIME &&
+               msg->attribute.id == NODE_ZB_ATTR_NET_TIME_MS) {
+        net_time_beacon(&self()->net_time, *(uint32_t *)msg->attribute.data.value);
+    }
+    zb_instr_callback_end(ZB_CB_ACTION, start_us);
+    return ESP_OK;
+}
+
+static bool zb_aps_indication_cb(esp_zb_apsde_data_ind_t ind)
+{
+    int64_t start_us = zb_instr_callback_begin();
+    link_quality_frame(ind.src_short_addr, (uint8_t)ind.lqi);
+    zb_instr_callback_end(ZB_CB_APS_INDICATION, start_us);
+    return false;
+}
+
+static void bdb_start_top_level_commissioning_cb(uint8_t mode_mask)
+{
+    int64_t start_us = zb_instr_callback_begin();
+    esp_zb_bdb_start_top_level_commissioning(mode_mask);
+    zb_instr_callback_end(ZB_CB_ALARM, start_us);
+}
+
+static void zb_signal_dispatch(esp_zb_app_signal_t *signal_struct)
+{
+    mesh_node_t *node = self();
+    uint32_t *p_sg_p = signal_struct->p_app_signal;
+    esp_err_t err_status = signal_struct->esp_err_status;
+
+    switch ((esp_zb_app_signal_type_t)*p_sg_p) {
+        case ESP_ZB_ZDO_SIGNAL_SKIP_STARTUP:
+            esp_zb_bdb_start_top_level_commissioning(ESP_ZB_BDB_MODE_INITIALIZATION);
+            break;
+
+        case ESP_ZB_BDB_SIGNAL_DEVICE_FIRST_START:
+        case ESP_ZB_BDB_SIGNAL_DEVICE_REBOOT:
+            if (err_status == ESP_OK) {
+                esp_zb_bdb_start_top_level_commissioning(node->type == NODE_TYPE_CONTROLLER ?
+                    ESP_ZB_BDB_MODE_NETWORK_FORMATION : ESP_ZB_BDB_MODE_NETWORK_STEERING);
+            }
+            break;
+
+        case ESP_ZB_BDB_SIGNAL_FORMATION:
+            if (err_status == ESP_OK) {
+                ESP_LOGI(TAG, "Network formed! PAN: 0x%04x, CH: %d",
+                         esp_zb_get_pan_id(), esp_zb_get_current_channel());
+                esp_zb_bdb_start_top_level_commissioning(ESP_ZB_BDB_MODE_NETWORK_STEERING);
+                node->connected = true;
+            } else {
+                esp_zb_scheduler_alarm(bdb_start_top_level_commissioning_cb,
+                                       ESP_ZB_BDB_MODE_NETWORK_FORMATION, 1000);
+            }
+            break;
+
+        case ESP_ZB_BDB_SIGNAL_STEERING:
+            if (err_status == ESP_OK) {
+                if (node->type != NODE_TYPE_CONTROLLER) {
+                    ESP_LOGI(TAG, "Node %d joined (0x%04x, depth %d)", zb_sim_current_node(),
+                             esp_zb_get_short_address(), zb_sim_node_depth(zb_sim_current_node()));
+                    node->connected = true;
+                }
+            } else {
+                esp_zb_scheduler_alarm(bdb_start_top_level_commissioning_cb,
+                                       ESP_ZB_BDB_MODE_NETWORK_STEERING, 1000);
+            }
+            break;
+
+        case ESP_ZB_ZDO_SIGNAL_DEVICE_ANNCE: {
+            esp_zb_zdo_signal_device_annce_params_t *dev_annce =
+                (esp_zb_zdo_signal_device_annce_params_t *)esp_zb_app_signal_get_params(p_sg_p);
+            ESP_LOGD(TAG, "Device joined! Addr: 0x%04x", dev_annce->device_short_addr);
+            break;
+        }
+
+        default:
+            break;
+    }
+}
+
+void esp_zb_app_signal_handler(esp_zb_app_signal_t *signal_struct)
+{
+    int64_t start_us = zb_instr_callback_begin();
+    zb_signal_dispatch(signal_struct);
+    zb_instr_callback_end(ZB_CB_SIGNAL, start_us);
+}
+
+/* ============================================================================
+ * ZIGBEE TASK
+ * ============================================================================ */
+
+static void zigbee_task(void *arg)
+{
+    mesh_node_t *node = arg;
+
+    esp_zb_cfg_t zb_nwk_cfg;
+    memset(&zb_nwk_cfg, 0, sizeof(zb_nwk_cfg));
+    switch (node->type) {
+        case NODE_TYPE_SENSOR:
+            zb_nwk_cfg.esp_zb_role = ESP_ZB_DEVICE_TYPE_ED;
+            zb_nwk_cfg.nwk_cfg.zed_cfg.ed_timeout = ESP_ZB_ED_AGING_TIMEOUT_64MIN;
+            zb_nwk_cfg.nwk_cfg.zed_cfg.keep_alive = 3000;
+            break;
+        case NODE_TYPE_CONTROLLER:
+            zb_nwk_cfg.esp_zb_role = ESP_ZB_DEVICE_TYPE_COORDINATOR;
+            zb_nwk_cfg.nwk_cfg.zczr_cfg.max_children = 10;
+            break;
+        default:
+            zb_nwk_cfg.esp_zb_role = ESP_ZB_DEVICE_TYPE_ROUTER;
+            zb_nwk_cfg.nwk_cfg.zczr_cfg.max_children = 10;
+            break;
+    }
+    esp_zb_init(&zb_nwk_cfg);
+
+    esp_zb_ep_list_t *ep_list = esp_zb_ep_list_create();
+    esp_zb_cluster_list_t *cluster_list;
+    switch (node->type) {
+        case NODE_TYPE_SENSOR:
+            cluster_list = create_sensor_clusters(node);
+            break;
+        case NODE_TYPE_CONTROLLER:
+            cluster_list = create_controller_clusters();
+            break;
+        default:
+            cluster_list = esp_zb_zcl_cluster_list_create();
+            break;
+    }
+    esp_zb_endpoint_config_t endpoint_config = {
+        .endpoint = DEVICE_ENDPOINT,
+        .app_profile_id = ESP_ZB_AF_HA_PROFILE_ID,
+        .app_device_id = ESP_ZB_HA_CUSTOM_ATTR_DEVICE_ID,
+        .app_device_version = 0,
+    };
+    esp_zb_ep_list_add_ep(ep_list, cluster_list, endpoint_config);
+    esp_zb_device_register(ep_list);
+
+    esp_zb_core_action_handler_register(zb_action_handler);
+    if (node->type == NODE_TYPE_SENSOR) {
+        esp_zb_zcl_command_send_status_handler_register(zcl_send_status_cb);
+    }
+    if (node->type == NODE_TYPE_CONTROLLER) {
+        // One link table per process: the controller's
+        esp_zb_aps_data_indication_handler_register(zb_aps_indication_cb);
+    }
+    esp_zb_set_channel_mask(ESP_ZB_TRANSCEIVER_ALL_CHANNELS_MASK);
+    esp_zb_start(false);
+    esp_zb_stack_main_loop();
+}
+
+// A firmware task for node idx: its board and its Zigbee stack
+static void spawn(TaskFunction_t fn, const char *name, UBaseType_t priority, int idx)
+{
+    TaskHandle_t task;
+    xTaskCreate(fn, name, 4096, &s_nodes[idx], priority, &task);
+    node_hal_posix_bind(task, s_nodes[idx].board);
+    zb_sim_bind_task(task, idx);
+}
+
+/* ============================================================================
+ * MAIN
+ * ============================================================================ */
+
+static bool parse_topology(const char *name, zb_sim_topology_t *out)
+{
+    static const char *names[] = { "star", "line", "grid", "random" };
+    for (int i = 0; i < 4; i++) {
+        if (strcmp(name, names[i]) == 0) {
+            *out = (zb_sim_topology_t)i;
+            return true;
+        }
+    }
+    return false;
+}
+
+int main(int argc, char **argv)
+{
+    int nodes = 3;
+    int sensors = 1;
+    zb_sim_topology_t topology = ZB_SIM_TOPOLOGY_LINE;
+    zb_sim_config_t zcfg = ZB_SIM_CONFIG_DEFAULT();
+    int64_t duration_s = 24 * 3600;
+    bool check = false;
+    esp_log_level_t level = ESP_LOG_WARN;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--nodes") == 0 && i + 1 < argc) {
+            nodes = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--sensors") == 0 && i + 1 < argc) {
+            sensors = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--topology") == 0 && i + 1 < argc) {
+            if (!parse_topology(argv[++i], &topology)) {
+                fprintf(stderr, "unknown topology %s\n", argv[i]);
+                return 2;
+            }
+        } else if (strcmp(argv[i], "--latency-ms") == 0 && i + 1 < argc) {
+            zcfg.hop_latency_us = (uint32_t)(atof(argv[++i]) * 1000);
+        } else if (strcmp(argv[i], "--jitter-ms") == 0 && i + 1 < argc) {
+            zcfg.hop_jitter_us = (uint32_t)(atof(argv[++i]) * 1000);
+        } else if (strcmp(argv[i], "--loss") == 0 && i + 1 < argc) {
+            zcfg.loss_pct = (uint8_t)atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--retries") == 0 && i + 1 < argc) {
+            zcfg.mac_retries = (uint8_t)atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--seed") == 0 && i + 1 < argc) {
+            zcfg.seed = (uint32_t)strtoul(argv[++i], NULL, 0);
+        } else if (strcmp(argv[i], "--days") == 0 && i + 1 < argc) {
+            duration_s = (int64_t)(atof(argv[++i]) * 24 * 3600);
+        } else if (strcmp(argv[i], "--seconds") == 0 && i + 1 < argc) {
+            duration_s = atoll(argv[++i]);
+        } else if (strcmp(argv[i], "--legacy-controller") == 0) {
+            s_legacy_controller = true;
+        } else if (strcmp(argv[i], "--stamp-only") == 0) {
+            s_stamp_only = true;
+        } else if (strcmp(argv[i], "-v") == 0) {
+            level = ESP_LOG_INFO;
+        } else if (strcmp(argv[i], "--check") == 0) {
+            check = true;
+        } else {
+            fprintf(stderr, "usage: %s [--nodes N] [--sensors N] [--topology star|line|grid|random]\n"
+                            "       [--latency-ms X] [--jitter-ms X] [--loss PCT] [--retries N]\n"
+                            "       [--seed N] [--days N | --seconds N] [--legacy-controller]\n"
+                            "       [--stamp-only] [-v] [--check]\n", argv[0]);
+            return 2;
+        }
+    }
+    if (nodes < 2 || nodes > ZB_SIM_MAX_NODES || sensors < 1 || sensors >= nodes ||
+        zcfg.loss_pct > 100) {
+        fprintf(stderr, "need 2..%d nodes, 1..nodes-1 sensors, loss 0..100\n", ZB_SIM_MAX_NODES);
+        return 2;
+    }
+
+    esp_log_level_set("*", level);
+    node_hal_posix_reset(NODE_HAL_CLOCK_VIRTUAL);
+    sim_reset();
+    zb_sim_init(&zcfg);
+
+    device_config_t cfg;
+    memset(&cfg, 0, sizeof(cfg));
+    cfg.tank_height_cm = 200;
+    cfg.tank_diameter_cm = 100;
+    cfg.pump_on_threshold = 20;
+    cfg.pump_off_threshold = 80;
+    cfg.pump_timeout_minutes = 60;
+    cfg.report_interval_sec = 5;
+    config_derive(&cfg, &s_dc);
+
+    tank_plant_config_t pcfg = TANK_PLANT_CONFIG_DEFAULT();
+    pcfg.height_cm = s_dc.tank_height_cm;
+    pcfg.diameter_cm = cfg.tank_diameter_cm;
+    pcfg.sensor_offset_cm = s_dc.sensor_offset_cm;
+    pcfg.initial_pct = 30;              // Short runs still reach the ON threshold
+    pcfg.seed = zcfg.seed;
+    tank_plant_init(&s_plant, &pcfg, 0);
+    pump_control_init(&s_pump);
+
+    s_node_total = nodes;
+    for (int i = 0; i < nodes; i++) {
+        mesh_node_t *node = &s_nodes[i];
+        node->type = i == CONTROLLER_NODE ? NODE_TYPE_CONTROLLER :
+                     i >= nodes - sensors ? NODE_TYPE_SENSOR : NODE_TYPE_ROUTER;
+        node->level.status = WATER_LEVEL_STATUS_OK;
+        node->level.percent = 100;      // Nothing measured yet
+        net_time_init(&node->net_time);
+        node->board = node_hal_posix_board_create();
+        zb_sim_node_create();
+        if (node->type == NODE_TYPE_SENSOR) {
+            node_hal_posix_select(node->board);
+            node_hal_posix_set_echo(tank_plant_echo_cm, &s_plant);
+        }
+    }
+    node_hal_posix_select(NULL);
+    zb_sim_topology(topology);
+
+    for (int i = 0; i < nodes; i++) {
+        spawn(zigbee_task, "zigbee", ZB_TASK_PRIORITY, i);
+        if (s_nodes[i].type == NODE_TYPE_SENSOR) {
+            spawn(sensor_task, "sensor", SENSOR_TASK_PRIORITY, i);
+        } else if (s_nodes[i].type == NODE_TYPE_CONTROLLER) {
+            spawn(control_task, "control", CONTROL_TASK_PRIORITY, i);
+        }
+    }
+
+    esp_timer_handle_t tank_timer;
+    const esp_timer_create_args_t tank_args = { .callback = tank_step, .name = "tank" };
+    esp_timer_create(&tank_args, &tank_timer);
+    esp_timer_start_periodic(tank_timer, TANK_STEP_US);
+
+    struct timespec wall_start, wall_end;
+    clock_gettime(CLOCK_MONOTONIC, &wall_start);
+
+    esp_err_t ret = sim_run_until(duration_s * 1000000);
+
+    clock_gettime(CLOCK_MONOTONIC, &wall_end);
+    double wall_ms = (wall_end.tv_sec - wall_start.tv_sec) * 1e3 +
+                     (wall_end.tv_nsec - wall_start.tv_nsec) / 1e6;
+
+    zb_sim_stats_t zb;
+    sim_stats_t sim;
+    zb_sim_get_stats(&zb);
+    sim_get_stats(&sim);
+
+    int joined = 0, max_depth = 0;
+    for (int i = 0; i < nodes; i++) {
+        if (zb_sim_node_joined(i)) joined++;
+        if (zb_sim_node_depth(i) > max_depth) max_depth = zb_sim_node_depth(i);
+    }
+    static const char *topo_names[] = { "star", "line", "grid", "random" };
+
+    printf("Simulated:      %lld s, wall %.1f ms\n", (long long)(node_hal_time_us() / 1000000), wall_ms);
+    printf("Mesh:           %d nodes (%d sensors), %s, %.1f ms/hop +%.1f jitter, %u%% loss, %u MAC retries\n",
+           nodes, sensors, topo_names[topology], zcfg.hop_latency_us / 1e3, zcfg.hop_jitter_us / 1e3,
+           zcfg.loss_pct, zcfg.mac_retries);
+    printf("Joined:         %d/%d, max depth %d, last join at %.1f s\n",
+           joined, nodes, max_depth, zb.last_join_us / 1e6);
+    printf("Reports:        %lu sent, %lu delivered, %lu lost, %lu queue drops, %lu legacy copies\n",
+           (unsigned long)zb.frames_sent, (unsigned long)zb.frames_delivered,
+           (unsigned long)zb.frames_lost, (unsigned long)zb.queue_drops,
+           (unsigned long)s_copies_sent);
+    printf("Retries:        %lu MAC of %lu attempts, %lu app retries, %lu abandoned\n",
+           (unsigned long)zb.mac_retries, (unsigned long)zb.mac_attempts,
+           (unsigned long)s_reports_retried, (unsigned long)s_reports_abandoned);
+    if (zb.frames_delivered > 0) {
+        printf("Latency:        avg %.1f ms, p50 %.0f ms, p99 %.0f ms, max %.1f ms, %.1f hops avg\n",
+               zb.latency_sum_us / 1e3 / zb.frames_delivered,
+               zb_sim_latency_percentile(&zb, 50) / 1e3, zb_sim_latency_percentile(&zb, 99) / 1e3,
+               zb.latency_max_us / 1e3, (double)zb.hops / zb.frames_delivered);
+    }
+    printf("Pump reaction:  %lu starts, avg %.1f s, max %.1f s\n", (unsigned long)s_reactions,
+           s_reactions ? s_reaction_sum_us / 1e6 / s_reactions : 0.0, s_reaction_max_us / 1e6);
+    printf("Tank level:     %.1f .. %.1f cm of %.0f, %.0f l used, %.0f l unmet\n",
+           s_plant.stats.min_cm, s_plant.stats.max_cm, s_plant.cfg.height_cm,
+           s_plant.stats.consumed_l, s_plant.stats.unmet_l);
+    metrics_hist_t wait, hold, cb;
+    metrics_get_hist(METRIC_ZB_LOCK_WAIT_US, &wait);
+    metrics_get_hist(METRIC_ZB_LOCK_HOLD_US, &hold);
+    metrics_get_hist(METRIC_ZB_CALLBACK_US, &cb);
+    printf("Stack:          %lu lock holds, max wait %lu us, max hold %lu us, %ld over budget; "
+           "%lu callbacks, max %lu us, %ld over budget\n",
+           (unsigned long)hold.count, (unsigned long)wait.max_us, (unsigned long)hold.max_us,
+           (long)metrics_get(METRIC_ZB_LOCK_OVERRUNS),
+           (unsigned long)cb.count, (unsigned long)cb.max_us,
+           (long)metrics_get(METRIC_ZB_CALLBACK_OVERRUNS));
+    e2e_sensor_t e2e[E2E_MAX_SENSORS];
+    int e2e_count = e2e_get_sensors(e2e, E2E_MAX_SENSORS);
+    // A legacy controller measures nothing
+    bool e2e_ok = s_legacy_controller ||
+                  e2e_count == (sensors < E2E_MAX_SENSORS ? sensors : E2E_MAX_SENSORS);
+    for (int i = 0; i < e2e_count; i++) {
+        const e2e_sensor_t *s = &e2e[i];
+        printf("E2E 0x%04x:     %lu reports, %lu lost, %lu dup; sample->rx n=%lu max %lu ms; "
+               "rx->relay n=%lu max %lu ms\n", s->addr, (unsigned long)s->reports,
+               (unsigned long)s->seq_gaps, (unsigned long)s->duplicates,
+               (unsigned long)s->sample_rx.count, (unsigned long)s->sample_rx.max_us,
+               (unsigned long)s->rx_relay.count, (unsigned long)s->rx_relay.max_us);
+        e2e_ok = e2e_ok && s->sample_rx.count > 0;
+    }
+    // One clock underneath: a sensor's offset is its sync error
+    int32_t sync_err_ms = 0;
+    uint32_t beacons_rx = 0;
+    for (int i = 0; i < nodes; i++) {
+        const net_time_t *nt = &s_nodes[i].net_time;
+        int32_t err = nt->offset_ms < 0 ? -nt->offset_ms : nt->offset_ms;
+        if (err > sync_err_ms) sync_err_ms = err;
+        beacons_rx += nt->beacons;
+    }
+    printf("Net time:       %lu beacons sent, %lu received, max sync error %ld ms\n",
+           (unsigned long)s_beacons_sent, (unsigned long)beacons_rx, (long)sync_err_ms);
+    // Neighbours against the simulated link means; others by their last hop
+    link_peer_t peers[LINK_MAX_PEERS];
+    int peer_count = link_quality_get_peers(peers, LINK_MAX_PEERS);
+    int link_neighbors = 0, link_off = 0;
+    for (int i = 0; i < peer_count; i++) {
+        const link_peer_t *p = &peers[i];
+        if (p->flags & LINK_PEER_NEIGHBOR) {
+            int mean = zb_sim_link_rssi(CONTROLLER_NODE, zb_sim_node_by_addr(p->addr));
+            int err = p->rssi_dbm - mean;
+            link_neighbors++;
+            link_off += err > LINK_CHECK_DB || err < -LINK_CHECK_DB;
+            printf("Link 0x%04x:    lqi %u, rssi %d dBm (link %d), %lu frames, neighbour\n",
+                   p->addr, p->lqi, p->rssi_dbm, mean, (unsigned long)p->frames);
+        } else {
+            printf("Link 0x%04x:    lqi %u via last hop, %lu frames\n",
+                   p->addr, p->lqi, (unsigned long)p->frames);
+        }
+    }
+    bool link_ok = link_neighbors > 0 && link_off == 0;
+    printf("Scheduler:      %lu tasks, %llu switches, %llu timer callbacks, %llu time jumps\n",
+           (unsigned long)sim.tasks, (unsigned long long)sim.context_switches,
+           (unsigned long long)sim.timer_callbacks, (unsigned long long)sim.time_jumps);
+
+    for (int i = 0; i < nodes; i++) {
+        node_hal_posix_board_delete(s_nodes[i].board);
+    }
+
+    if (check) {
+        // Everyone joins, most reports make it, and the pump still cycles
+        // without the tank running dry; every sensor syncs and is measured,
+        // and the smoothed neighbour links match the simulated ones. The
+        // pump only cycles if the controller understood the reports.
+        bool ok = ret == ESP_OK && joined == nodes && zb.frames_delivered > 0 &&
+                  zb.frames_delivered * 10 >= zb.frames_sent * 9 &&
+                  s_reactions > 0 && s_plant.stats.dry_us == 0 && e2e_ok && link_ok;
+        printf("Check:          %s\n", ok ? "PASS" : "FAIL");
+        return ok ? 0 : 1;
+    }
+    return ret == ESP_OK ? 0 : 1;
+}
@@ -0,0 +1,355 @@
+/*
+ * Node Hardware Abstraction Layer - POSIX implementation (firmware/host)
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include "node_hal_posix.h"
+#include "water_level.h"
+#include "sim.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_zigbee_core.h"
+#include "zb_sim.h"
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <sched.h>
+
+#define NODE_HAL_GPIO_COUNT     32
+#define ECHO_LATENCY_US         100     // Trigger fall to echo rise (HC-SR04 ~ 8 x 40 kHz burst)
+
+static node_hal_clock_t s_clock = NODE_HAL_CLOCK_VIRTUAL;
+static int64_t s_virtual_us;
+static int64_t s_realtime_base_ns;
+
+// Everything a node's firmware sees through node_hal.h apart from the clock
+struct node_hal_posix_board {
+    int      gpio[NODE_HAL_GPIO_COUNT];
+    node_hal_echo_fn_t echo_fn;
+    void    *echo_ctx;
+    int64_t  echo_rise_us;
+    int64_t  echo_fall_us;
+    uint32_t zb_attr[4];
+    node_zb_link_t link;
+    bool     link_set;
+    device_status_t ble_status;
+    node_hal_posix_stats_t stats;
+};
+
+static node_hal_posix_board_t s_default_board;
+static node_hal_posix_board_t *s_selected;
+
+/* ============================================================================
+ * BOARDS
+ * ============================================================================ */
+
+static void board_init(node_hal_posix_board_t *b)
+{
+    memset(b, 0, sizeof(*b));
+    b->echo_rise_us = -1;
+    b->echo_fall_us = -1;
+}
+
+// The running task's board, else the runner's selection, else the default
+static node_hal_posix_board_t *board(void)
+{
+    node_hal_posix_board_t *b = NULL;
+    if (sim_in_task()) {
+        b = pvTaskGetThreadLocalStoragePointer(NULL, NODE_HAL_POSIX_TLS_INDEX);
+    }
+    if (b == NULL) {
+        b = s_selected != NULL ? s_selected : &s_default_board;
+    }
+    return b;
+}
+
+node_hal_posix_board_t *node_hal_posix_board_create(void)
+{
+    node_hal_posix_board_t *b = malloc(sizeof(*b));
+    if (b != NULL) {
+        board_init(b);
+    }
+    return b;
+}
+
+void node_hal_posix_board_delete(node_hal_posix_board_t *b)
+{
+    if (b == s_selected) {
+        s_selected = NULL;
+    }
+    free(b);
+}
+
+void node_hal_posix_bind(TaskHandle_t task, node_hal_posix_board_t *b)
+{
+    vTaskSetThreadLocalStoragePointer(task, NODE_HAL_POSIX_TLS_INDEX, b);
+}
+
+void node_hal_posix_select(node_hal_posix_board_t *b)
+{
+    s_selected = b;
+}
+
+/* ============================================================================
+ * CLOCK
+ * ============================================================================ */
+
+static int64_t monotonic_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+void node_hal_posix_reset(node_hal_clock_t clock)
+{
+    s_clock = clock;
+    s_virtual_us = 0;
+    s_realtime_base_ns = monotonic_ns();
+    board_init(&s_default_board);
+    s_selected = NULL;
+}
+
+void node_hal_posix_advance_us(int64_t us)
+{
+    if (s_clock == NODE_HAL_CLOCK_VIRTUAL && us > 0) {
+        s_virtual_us += us;
+    }
+}
+
+void node_hal_posix_wait_until(int64_t t_us)
+{
+    int64_t wait_us = t_us - node_hal_time_us();
+    if (wait_us <= 0) {
+        return;
+    }
+    if (s_clock == NODE_HAL_CLOCK_VIRTUAL) {
+        s_virtual_us += wait_us;
+        return;
+    }
+    struct timespec ts = { .tv_sec = wait_us / 1000000, .tv_nsec = (long)(wait_us % 1000000) * 1000L };
+    nanosleep(&ts, NULL);
+}
+
+int64_t node_hal_time_us(void)
+{
+    if (s_clock == NODE_HAL_CLOCK_VIRTUAL) {
+        return s_virtual_us;
+    }
+    return (monotonic_ns() - s_realtime_base_ns) / 1000;
+}
+
+void node_hal_delay_ms(uint32_t ms)
+{
+    // Inside the simulator this is the firmware's vTaskDelay(), so other
+    // tasks run meanwhile
+    if (sim_in_task()) {
+        vTaskDelay(pdMS_TO_TICKS(ms));
+        return;
+    }
+    if (s_clock == NODE_HAL_CLOCK_VIRTUAL) {
+        s_virtual_us += (int64_t)ms * 1000;
+        return;
+    }
+    struct timespec ts = { .tv_sec = ms / 1000, .tv_nsec = (long)(ms % 1000) * 1000000L };
+    nanosleep(&ts, NULL);
+}
+
+void node_hal_delay_us(uint32_t us)
+{
+    if (s_clock == NODE_HAL_CLOCK_VIRTUAL) {
+        s_virtual_us += us;
+        return;
+    }
+    // Spin like esp_rom_delay_us() so profiles show the same busy-wait
+    int64_t end = node_hal_time_us() + us;
+    while (node_hal_time_us() < end) {
+    }
+}
+
+void node_hal_yield(void)
+{
+    if (sim_in_task()) {
+        taskYIELD();
+        return;
+    }
+    if (s_clock == NODE_HAL_CLOCK_REALTIME) {
+        sched_yield();
+    }
+}
+
+/* ============================================================================
+ * GPIO AND ECHO MODEL
+ * ============================================================================ */
+
+void node_hal_posix_set_echo(node_hal_echo_fn_t fn, void *ctx)
+{
+    node_hal_posix_board_t *b = board();
+    b->echo_fn = fn;
+    b->echo_ctx = ctx;
+}
+
+// Trigger falling edge: the sensor bursts and the echo pulse width encodes
+// the round trip
+static void echo_start(node_hal_posix_board_t *b)
+{
+    b->stats.pings++;
+    b->echo_rise_us = -1;
+    b->echo_fall_us = -1;
+
+    float distance_cm = b->echo_fn != NULL ? b->echo_fn(b->echo_ctx) : -1.0f;
+    if (distance_cm <= 0) {
+        return;
+    }
+    int64_t now = node_hal_time_us();
+    b->echo_rise_us = now + ECHO_LATENCY_US;
+    b->echo_fall_us = b->echo_rise_us +
+                      (int64_t)(distance_cm * 2.0f / WATER_LEVEL_SOUND_SPEED_CM_US);
+}
+
+void node_hal_gpio_set(int pin, int level)
+{
+    if (pin < 0 || pin >= NODE_HAL_GPIO_COUNT) {
+        return;
+    }
+    node_hal_posix_board_t *b = board();
+    if (pin == NODE_PIN_TRIGGER && b->gpio[pin] == 1 && level == 0) {
+        echo_start(b);
+    }
+    b->gpio[pin] = level;
+}
+
+int node_hal_gpio_get(int pin)
+{
+    node_hal_posix_board_t *b = board();
+    if (pin == NODE_PIN_ECHO) {
+        int64_t now = node_hal_time_us();
+        return (b->echo_rise_us >= 0 && now >= b->echo_rise_us && now < b->echo_fall_us) ? 1 : 0;
+    }
+    if (pin < 0 || pin >= NODE_HAL_GPIO_COUNT) {
+        return 0;
+    }
+    return b->gpio[pin];
+}
+
+void node_hal_pump_relay(bool on)
+{
+    // Kept apart from GPIO 2 so a sensor and a controller can share one
+    // board (the pin is the trigger on one, the relay on the other)
+    node_hal_posix_board_t *b = board();
+    if (on != b->stats.relay_on) {
+        b->stats.relay_switches++;
+    }
+    b->stats.relay_on = on;
+    b->gpio[NODE_PIN_LED_ACTIVITY] = on ? 1 : 0;
+}
+
+/* ============================================================================
+ * ZIGBEE ATTRIBUTE I/O
+ * ============================================================================ */
+
+esp_err_t node_hal_zb_set_attr(uint16_t attr_id, void *value)
+{
+    node_hal_posix_board_t *b = board();
+    switch (attr_id) {
+        case NODE_ZB_ATTR_LEVEL_CM:
+            b->zb_attr[attr_id] = *(uint16_t *)value;
+            break;
+        case NODE_ZB_ATTR_LEVEL_PCT:
+        case NODE_ZB_ATTR_SENSOR_STATUS:
+        case NODE_ZB_ATTR_PUMP_STATE:
+            b->zb_attr[attr_id] = *(uint8_t *)value;
+            break;
+        default:
+            return ESP_ERR_NOT_FOUND;
+    }
+    b->stats.zb_attr_writes++;
+
+    // On a simulated mesh node the write also lands in the stack's attribute
+    // table, as node_hal_esp.c does, so reports carry it
+    if (zb_sim_current_node() >= 0) {
+        esp_zb_zcl_status_t status = esp_zb_zcl_set_attribute_val(NODE_ZB_ENDPOINT,
+            NODE_ZB_CLUSTER_WATER_LEVEL, ESP_ZB_ZCL_CLUSTER_SERVER_ROLE, attr_id, value, false);
+        return status == ESP_ZB_ZCL_STATUS_SUCCESS ? ESP_OK : ESP_FAIL;
+    }
+    return ESP_OK;
+}
+
+uint32_t node_hal_posix_zb_attr(uint16_t attr_id)
+{
+    return attr_id < 4 ? board()->zb_attr[attr_id] : 0;
+}
+
+/* ============================================================================
+ * ZIGBEE LINK QUALITY
+ * ============================================================================ */
+
+esp_err_t node_hal_zb_link_quality(uint16_t peer, node_zb_link_t *link)
+{
+    (void)peer;     // One link per board
+    node_hal_posix_board_t *b = board();
+    if (!b->link_set) {
+        return ESP_ERR_NOT_FOUND;
+    }
+    *link = b->link;
+    return ESP_OK;
+}
+
+int node_hal_zb_neighbors(link_sample_t *out, int max)
+{
+    int n = 0;
+
+    // A simulated mesh node has a real neighbour table, as on ESP
+    if (zb_sim_current_node() >= 0) {
+        esp_zb_nwk_info_iterator_t it = ESP_ZB_NWK_INFO_ITERATOR_INIT;
+        esp_zb_nwk_neighbor_info_t nbr;
+        while (esp_zb_nwk_get_next_neighbor(&it, &nbr) == ESP_OK) {
+            if (n < max) {
+                out[n] = (link_sample_t){ .addr = nbr.short_addr, .lqi = nbr.lqi, .rssi_dbm = nbr.rssi };
+            }
+            n++;
+        }
+        return n;
+    }
+
+    // Otherwise the board's one link, to the coordinator
+    node_hal_posix_board_t *b = board();
+    if (!b->link_set) {
+        return 0;
+    }
+    if (max > 0) {
+        out[0] = (link_sample_t){ .addr = 0x0000, .lqi = b->link.lqi, .rssi_dbm = b->link.rssi_dbm };
+    }
+    return 1;
+}
+
+void node_hal_posix_set_link(const node_zb_link_t *link)
+{
+    node_hal_posix_board_t *b = board();
+    b->link_set = link != NULL;
+    if (link != NULL) {
+        b->link = *link;
+    }
+}
+
+/* ============================================================================
+ * BLE STATUS
+ * ============================================================================ */
+
+void node_hal_ble_status(const device_status_t *status)
+{
+    node_hal_posix_board_t *b = board();
+    b->ble_status = *status;
+    b->stats.ble_status_updates++;
+}
+
+const device_status_t *node_hal_posix_ble_status(void)
+{
+    return &board()->ble_status;
+}
+
+void node_hal_posix_get_stats(node_hal_posix_stats_t *stats)
+{
+    *stats = board()->stats;
+}
@@ -0,0 +1,120 @@
+/*
+ * Node HAL on POSIX - test and runner controls
+ *
+ * The host side of node_hal.h: what the firmware would see from the board
+ * (echo pulses, a clock) is driven from here, and what it would drive (relay,
+ * Zigbee attributes, BLE status) is recorded here.
+ *
+ * One process can host several nodes: each gets a board (pins, echo model,
+ * attributes, counters) bound to its simulator tasks. The clock is shared.
+ * Calls below act on the current board: the running task's, else the one
+ * the runner selected, else a default board.
+ */
+
+#ifndef NODE_HAL_POSIX_H
+#define NODE_HAL_POSIX_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "node_hal.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+
+/* ============================================================================
+ * CLOCK
+ * ============================================================================ */
+
+typedef enum {
+    NODE_HAL_CLOCK_VIRTUAL,     // Advances only in delays (default, deterministic)
+    NODE_HAL_CLOCK_REALTIME,    // CLOCK_MONOTONIC, delays sleep / spin
+} node_hal_clock_t;
+
+/**
+ * Reset the clock to 0 and the default board: pins low, attributes and
+ * counters cleared. Boards from node_hal_posix_board_create() are the
+ * runner's to delete.
+ */
+void node_hal_posix_reset(node_hal_clock_t clock);
+
+/**
+ * Virtual clock only: jump forward (time never goes backwards)
+ */
+void node_hal_posix_advance_us(int64_t us);
+
+/**
+ * Move the clock to t_us: a jump on the virtual clock, a sleep on the real
+ * one. No-op if t_us is not in the future. The simulator (sim.h) advances
+ * time only through here.
+ */
+void node_hal_posix_wait_until(int64_t t_us);
+
+/* ============================================================================
+ * BOARDS
+ * ============================================================================ */
+
+#define NODE_HAL_POSIX_TLS_INDEX    0   // Task-local pointer slot holding the board
+
+typedef struct node_hal_posix_board node_hal_posix_board_t;
+
+node_hal_posix_board_t *node_hal_posix_board_create(void);
+void node_hal_posix_board_delete(node_hal_posix_board_t *board);
+
+/**
+ * Give a simulator task (sim.h) its node's board
+ */
+void node_hal_posix_bind(TaskHandle_t task, node_hal_posix_board_t *board);
+
+/**
+ * Board used outside bound tasks (runner, timer callbacks); NULL for the
+ * default board
+ */
+void node_hal_posix_select(node_hal_posix_board_t *board);
+
+/* ============================================================================
+ * ULTRASONIC ECHO MODEL
+ * ============================================================================ */
+
+/**
+ * Distance the simulated sensor sees, in cm. Called once per trigger pulse;
+ * a value <= 0 means no echo (the ping times out).
+ */
+typedef float (*node_hal_echo_fn_t)(void *ctx);
+
+void node_hal_posix_set_echo(node_hal_echo_fn_t fn, void *ctx);
+
+/* ============================================================================
+ * ZIGBEE LINK QUALITY
+ * ============================================================================ */
+
+/**
+ * What node_hal_zb_link_quality() reports for every peer, and
+ * node_hal_zb_neighbors() as the coordinator's entry outside a simulated
+ * mesh node; NULL for an empty neighbour table (the default)
+ */
+void node_hal_posix_set_link(const node_zb_link_t *link);
+
+/* ============================================================================
+ * OBSERVED OUTPUTS
+ * ============================================================================ */
+
+typedef struct {
+    bool     relay_on;
+    uint32_t relay_switches;
+    uint32_t pings;
+    uint32_t zb_attr_writes;
+    uint32_t ble_status_updates;
+} node_hal_posix_stats_t;
+
+void node_hal_posix_get_stats(node_hal_posix_stats_t *stats);
+
+/**
+ * Last value written to a water level cluster attribute (0 if never written)
+ */
+uint32_t node_hal_posix_zb_attr(uint16_t attr_id);
+
+/**
+ * Last status passed to node_hal_ble_status()
+ */
+const device_status_t *node_hal_posix_ble_status(void);
+
+#endif // NODE_HAL_POSIX_H
@@ -0,0 +1,515 @@
+/*
+ * Cultivio AquaSense - Host Runner
+ * Runs the real sensor and controller logic (shared/node_logic) together on
+ * Linux against the POSIX HAL, with the tank plant model in the loop.
+ *
+ * Usage: node_host [--days N | --seconds N] [--realtime] [--nvs FILE]
+ *                  [--record FILE] [--trace FILE] [-v] [--check]
+ *                  [--energy] [--battery MAH] [--current NAME=MA]
+ *
+ * The nodes run as FreeRTOS tasks on the discrete-event simulator (sim.h):
+ * the sensor task measures and reports over a queue standing in for the
+ * Zigbee link, the controller's Zigbee task feeds pump control, and the
+ * control task steps it once a second, all under the shared Zigbee lock.
+ * The tank (shared/tank_plant) is stepped from an esp_timer. Virtual time by default: a day of operation
+ * runs in well under a second, identically every time, which makes it a
+ * stable target for perf/valgrind. --record writes the controller's report
+ * capture (shared/report_capture) for replay_host. --trace exports the event
+ * trace as Chrome JSON (trace_export.h) for ui.perfetto.dev, one track per
+ * task; it replaces the log lines -v would print for trace points.
+ *
+ * A boot task goes through the unified firmware's app_main stages with its
+ * fixed delays before starting the node tasks, marking them like the
+ * firmware does (boot_prof.h); the table is printed with -v.
+ *
+ * The sensor's pings, reports and keep-alive polls are accounted like on
+ * target (energy.h) and its battery life projected from the run. --energy
+ * adds the per-state breakdown and a table of other configurations, using
+ * the run's mean ping time; --battery and --current (repeatable, names from
+ * ENERGY_CURRENTS) change the current table.
+ *
+ * Reports carry the firmware's stamp (e2e.h) with the sample time; the nodes
+ * share one clock, so it counts as network time and the controller records
+ * sample->rx and rx->relay latencies as on target.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/queue.h"
+#include "freertos/semphr.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "nvs.h"
+#include "config_store.h"
+#include "config_derived.h"
+#include "water_level.h"
+#include "pump_control.h"
+#include "tank_plant.h"
+#include "report_capture.h"
+#include "metrics.h"
+#include "boot_prof.h"
+#include "trace.h"
+#include "trace_export.h"
+#include "energy.h"
+#include "e2e.h"
+#include "net_time.h"
+#include "esp_zigbee_core.h"
+#include "node_hal_posix.h"
+#include "nvs_posix.h"
+#include "sim.h"
+
+static const char *TAG = "HOST";
+
+/* ============================================================================
+ * TANK
+ * ============================================================================ */
+
+#define TANK_STEP_US            1000000 // Plant model update period
+
+/* ============================================================================
+ * CONFIG
+ * ============================================================================ */
+
+static void load_config(const char *nvs_file, device_config_t *cfg)
+{
+    memset(cfg, 0, sizeof(*cfg));
+    snprintf(cfg->device_name, sizeof(cfg->device_name), "Cultivio-Host");
+    cfg->node_type = NODE_TYPE_CONTROLLER;
+    cfg->tank_height_cm = 200;
+    cfg->tank_diameter_cm = 100;
+    cfg->pump_on_threshold = 20;
+    cfg->pump_off_threshold = 80;
+    cfg->pump_timeout_minutes = 60;
+    cfg->report_interval_sec = 5;
+    cfg->provisioned = true;
+
+    if (nvs_posix_set_file(nvs_file) != ESP_OK) {
+        ESP_LOGW(TAG, "NVS file %s unreadable, starting empty", nvs_file);
+    }
+    esp_err_t ret = config_store_load(cfg);
+    if (ret == ESP_ERR_NVS_NOT_FOUND) {
+        config_store_save(cfg);
+    } else if (ret != ESP_OK) {
+        ESP_LOGW(TAG, "Stored config unusable (%s), using defaults", esp_err_to_name(ret));
+    }
+}
+
+/* ============================================================================
+ * NODES
+ * ============================================================================ */
+
+#define SENSOR_TASK_PRIORITY    5
+#define ZB_TASK_PRIORITY        5
+#define CONTROL_TASK_PRIORITY   4
+#define ZB_LINK_DEPTH           4       // Reports in flight sensor -> controller
+#define SENSOR_SHORT_ADDR       0x0001  // Source of the simulated reports
+#define BOOT_TASK_PRIORITY      1       // app_main's
+#define SENSOR_KEEP_ALIVE_MS    3000    // unified_main.c end device keep-alive
+
+// unified_main.c app_main delays
+#define BOOT_BLINK_MS           (2 * 2 * 200)   // led_blink(LED_STATUS_PIN, 2, 200)
+#define BOOT_ROLE_DELAY_MS      2000            // zigbee_task before the role task
+#define BOOT_BLE_DELAY_MS       1000            // Before ble_status_request()
+
+// The stamp attribute as it goes on air
+typedef struct {
+    uint8_t stamp[E2E_STAMP_ATTR_SIZE];
+} zb_report_t;
+
+static config_derived_t s_dc;
+static tank_plant_t s_plant;
+static water_level_t s_level = { .status = WATER_LEVEL_STATUS_OK };
+static pump_control_t s_pump;
+static QueueHandle_t s_zb_link;
+static SemaphoreHandle_t s_zb_lock;
+static uint32_t s_reports;
+static uint32_t s_reports_dropped;
+static uint16_t s_report_seq;
+
+static void tank_step(void *arg)
+{
+    (void)arg;
+    node_hal_posix_stats_t hal;
+    node_hal_posix_get_stats(&hal);
+    tank_plant_step(&s_plant, hal.relay_on, node_hal_time_us());
+}
+
+// Sensor: measure, publish to its attributes, report the stamped percentage
+static void sensor_task(void *arg)
+{
+    (void)arg;
+    for (;;) {
+        water_level_measure(&s_dc, &s_level);
+        uint32_t sample_ms = net_time_now_ms(NULL);
+
+        xSemaphoreTake(s_zb_lock, portMAX_DELAY);
+        water_level_publish(&s_level);
+        e2e_stamp_t stamp = {
+            .level_pct = (uint8_t)node_hal_posix_zb_attr(NODE_ZB_ATTR_LEVEL_PCT),
+            .status = (uint8_t)node_hal_posix_zb_attr(NODE_ZB_ATTR_SENSOR_STATUS),
+            .seq = ++s_report_seq,
+            .sample_ms = sample_ms,
+            .flags = E2E_STAMP_SYNCED,
+        };
+        xSemaphoreGive(s_zb_lock);
+        zb_report_t report;
+        e2e_stamp_encode(&stamp, report.stamp);
+
+        energy_zb_frame();
+        if (xQueueSend(s_zb_link, &report, 0) == pdTRUE) {
+            s_reports++;
+        } else {
+            s_reports_dropped++;
+        }
+        vTaskDelay(pdMS_TO_TICKS(s_dc.report_interval_ms));
+    }
+}
+
+// Controller Zigbee stack: attribute reports arrive here
+static void zb_task(void *arg)
+{
+    (void)arg;
+    zb_report_t report;
+    boot_prof_mark(BOOT_STAGE_NETWORK_JOINED);     // The queue link is up at once
+    for (;;) {
+        if (xQueueReceive(s_zb_link, &report, portMAX_DELAY) == pdTRUE) {
+            xSemaphoreTake(s_zb_lock, portMAX_DELAY);
+            TRACE(ZB_CALLBACK, ESP_ZB_CORE_REPORT_ATTR_CB_ID);
+            e2e_stamp_t stamp;
+            e2e_stamp_decode(report.stamp, sizeof(report.stamp), &stamp);
+            e2e_report_rx(SENSOR_SHORT_ADDR, &stamp, net_time_now_ms(NULL));
+            report_capture_report(0, NODE_ZB_ATTR_LEVEL_PCT, stamp.level_pct);
+            pump_control_sensor_update(&s_pump, stamp.level_pct);
+            TRACE(REPORT_RX, SENSOR_SHORT_ADDR, s_pump.water_level_pct);
+            boot_prof_mark(BOOT_STAGE_FIRST_REPORT);
+            TRACE(ZB_CALLBACK_END, ESP_OK);
+            xSemaphoreGive(s_zb_lock);
+        }
+    }
+}
+
+// Controller: one control pass per second, like control_task
+static void control_task(void *arg)
+{
+    (void)arg;
+    report_capture_config(s_dc.pump_on_pct, s_dc.pump_off_pct, s_dc.pump_timeout_sec);
+    for (;;) {
+        xSemaphoreTake(s_zb_lock, portMAX_DELAY);
+        bool was_running = s_pump.running;
+        pump_control_step(&s_pump, &s_dc);
+        if (s_pump.running != was_running) {
+            report_capture_pump(s_pump.running, s_pump.water_level_pct);
+        }
+        device_status_t status = { .node_type = NODE_TYPE_CONTROLLER };
+        pump_control_report_status(&s_pump, &status);
+        xSemaphoreGive(s_zb_lock);
+        vTaskDelay(pdMS_TO_TICKS(1000));
+    }
+}
+
+// app_main: nothing to initialise on the host but its delays
+static void boot_task(void *arg)
+{
+    (void)arg;
+    boot_prof_mark(BOOT_STAGE_APP_MAIN);
+    boot_prof_mark(BOOT_STAGE_BANNER);
+    boot_prof_mark(BOOT_STAGE_NVS);
+    boot_prof_mark(BOOT_STAGE_WATCHDOG);
+    boot_prof_mark(BOOT_STAGE_GPIO);
+    vTaskDelay(pdMS_TO_TICKS(BOOT_BLINK_MS));
+    boot_prof_mark(BOOT_STAGE_LED_BLINK);
+    boot_prof_mark(BOOT_STAGE_BLE_INIT);
+    boot_prof_mark(BOOT_STAGE_BUTTON_CHECK);
+
+    // Firmware task names: they label the exported tracks
+    xTaskCreate(zb_task, "zigbee_task", 4096, NULL, ZB_TASK_PRIORITY, NULL);
+    vTaskDelay(pdMS_TO_TICKS(BOOT_ROLE_DELAY_MS));
+    xTaskCreate(control_task, "control_task", 4096, NULL, CONTROL_TASK_PRIORITY, NULL);
+    xTaskCreate(sensor_task, "sensor_task", 4096, NULL, SENSOR_TASK_PRIORITY, NULL);
+    boot_prof_mark(BOOT_STAGE_ROLE_START);
+    vTaskDelay(pdMS_TO_TICKS(BOOT_BLE_DELAY_MS));
+    boot_prof_mark(BOOT_STAGE_BLE_STATUS);
+    boot_prof_mark(BOOT_STAGE_READY);
+    boot_prof_log();
+    vTaskDelete(NULL);
+}
+
+static trace_export_t s_export;
+
+// Drained like the firmware's drain task, from a timer: no track of its own
+static void trace_export_step(void *arg)
+{
+    (void)arg;
+    trace_drain_named(trace_export_event, &s_export, SIZE_MAX);
+}
+
+static esp_err_t capture_file_write(const void *data, size_t len, void *ctx)
+{
+    return fwrite(data, 1, len, ctx) == len ? ESP_OK : ESP_FAIL;
+}
+
+/* ============================================================================
+ * ENERGY
+ * ============================================================================ */
+
+static void print_energy_states(const energy_ledger_t *l, const energy_estimate_t *est)
+{
+    for (int s = 0; s < ENERGY_STATE_COUNT; s++) {
+        printf("  %-12s %12.1f s %9.2f mAh/day\n", energy_state_name(s),
+               l->state_us[s] / 1e6, est->mah_state[s]);
+    }
+    printf("  %-12s %14s %9.2f mAh/day\n", "us_standby", "", est->mah_standby);
+    for (int e = 0; e < ENERGY_EVENT_COUNT; e++) {
+        printf("  %-14s %lu\n", energy_event_name(e), (unsigned long)l->events[e]);
+    }
+}
+
+// Battery life of other sensor configurations at the same currents
+static void print_energy_configs(const energy_model_t *model, uint32_t ping_us)
+{
+    static const uint32_t intervals_s[] = { 5, 30, 60, 300, 900 };
+    static const uint8_t samples[] = { WATER_LEVEL_NUM_SAMPLES, 1 };
+    static const uint32_t keep_alive_ms[] = { SENSOR_KEEP_ALIVE_MS, 30000 };
+    // Slow advertising, the DECAY policy's mean interval
+    const uint32_t adv_ms = (BLE_ADV_SLOW_INT_MIN + BLE_ADV_SLOW_INT_MAX) / 2 * 625 / 1000;
+
+    printf("  interval samples keep_alive   mAh/day     days  days+adv\n");
+    for (size_t i = 0; i < sizeof(intervals_s) / sizeof(intervals_s[0]); i++) {
+        for (size_t n = 0; n < sizeof(samples); n++) {
+            for (size_t k = 0; k < sizeof(keep_alive_ms) / sizeof(keep_alive_ms[0]); k++) {
+                energy_config_t cfg = {
+                    .report_interval_s = intervals_s[i],
+                    .samples = samples[n],
+                    .ping_us = ping_us,
+                    .keep_alive_ms = keep_alive_ms[k],
+                };
+                energy_ledger_t day;
+                energy_estimate_t est, est_adv;
+                energy_from_config(&cfg, &day);
+                energy_estimate(&day, model, &est);
+                cfg.ble_adv_interval_ms = adv_ms;
+                energy_from_config(&cfg, &day);
+                energy_estimate(&day, model, &est_adv);
+                printf("  %6lu s %7u %8lu ms %9.2f %8.0f %9.0f\n",
+                       (unsigned long)intervals_s[i], samples[n], (unsigned long)keep_alive_ms[k],
+                       est.mah_per_day, est.battery_days, est_adv.battery_days);
+            }
+        }
+    }
+}
+
+/* ============================================================================
+ * MAIN
+ * ============================================================================ */
+
+int main(int argc, char **argv)
+{
+    int64_t duration_s = 24 * 3600;
+    bool realtime = false;
+    bool check = false;
+    bool energy_detail = false;
+    energy_model_t model = ENERGY_MODEL_DEFAULT();
+    const char *nvs_file = NULL;
+    const char *record_file = NULL;
+    const char *trace_file = NULL;
+    esp_log_level_t level = ESP_LOG_WARN;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--days") == 0 && i + 1 < argc) {
+            duration_s = (int64_t)(atof(argv[++i]) * 24 * 3600);
+        } else if (strcmp(argv[i], "--seconds") == 0 && i + 1 < argc) {
+            duration_s = atoll(argv[++i]);
+        } else if (strcmp(argv[i], "--realtime") == 0) {
+            realtime = true;
+        } else if (strcmp(argv[i], "--nvs") == 0 && i + 1 < argc) {
+            nvs_file = argv[++i];
+        } else if (strcmp(argv[i], "--record") == 0 && i + 1 < argc) {
+            record_file = argv[++i];
+        } else if (strcmp(argv[i], "--trace") == 0 && i + 1 < argc) {
+            trace_file = argv[++i];
+        } else if (strcmp(argv[i], "-v") == 0) {
+            level = ESP_LOG_INFO;
+        } else if (strcmp(argv[i], "--check") == 0) {
+            check = true;
+        } else if (strcmp(argv[i], "--energy") == 0) {
+            energy_detail = true;
+        } else if (strcmp(argv[i], "--battery") == 0 && i + 1 < argc) {
+            model.battery_mah = (float)atof(argv[++i]);
+        } else if (strcmp(argv[i], "--current") == 0 && i + 1 < argc &&
+                   strchr(argv[i + 1], '=') != NULL) {
+            char name[16];
+            const char *arg = argv[++i];
+            size_t len = (size_t)(strchr(arg, '=') - arg);
+            snprintf(name, sizeof(name), "%.*s", (int)len, arg);
+            if (energy_model_set(&model, name, (float)atof(arg + len + 1)) != ESP_OK) {
+                fprintf(stderr, "unknown current %s\n", name);
+                return 2;
+            }
+        } else {
+            fprintf(stderr, "usage: %s [--days N | --seconds N] [--realtime] "
+                            "[--nvs FILE] [--record FILE] [--trace FILE] [-v] [--check] "
+                            "[--energy] [--battery MAH] [--current NAME=MA]\n",
+                    argv[0]);
+            return 2;
+        }
+    }
+
+    esp_log_level_set("*", level);
+    node_hal_posix_reset(realtime ? NODE_HAL_CLOCK_REALTIME : NODE_HAL_CLOCK_VIRTUAL);
+    sim_reset();
+    energy_reset();
+    e2e_reset();
+    energy_set_poll_interval_ms(SENSOR_KEEP_ALIVE_MS);
+
+    device_config_t cfg;
+    load_config(nvs_file, &cfg);
+    config_derive(&cfg, &s_dc);
+
+    tank_plant_config_t pcfg = TANK_PLANT_CONFIG_DEFAULT();
+    pcfg.height_cm = s_dc.tank_height_cm;
+    pcfg.diameter_cm = cfg.tank_diameter_cm;
+    pcfg.sensor_offset_cm = s_dc.sensor_offset_cm;
+    tank_plant_init(&s_plant, &pcfg, 0);
+    node_hal_posix_set_echo(tank_plant_echo_cm, &s_plant);
+
+    FILE *capture = NULL;
+    if (record_file != NULL) {
+        capture = fopen(record_file, "wb");
+        if (capture == NULL || report_capture_start(capture_file_write, capture, true) != ESP_OK) {
+            fprintf(stderr, "cannot record to %s\n", record_file);
+            return 2;
+        }
+    }
+
+    if (trace_file != NULL) {
+        if (trace_export_open(&s_export, trace_file) != ESP_OK) {
+            fprintf(stderr, "cannot write %s\n", trace_file);
+            return 2;
+        }
+        trace_reset();
+    }
+
+    pump_control_init(&s_pump);
+    s_zb_link = xQueueCreate(ZB_LINK_DEPTH, sizeof(zb_report_t));
+    s_zb_lock = xSemaphoreCreateMutex();
+
+    esp_timer_handle_t tank_timer;
+    const esp_timer_create_args_t tank_args = { .callback = tank_step, .name = "tank" };
+    esp_timer_create(&tank_args, &tank_timer);
+    esp_timer_start_periodic(tank_timer, TANK_STEP_US);
+
+    boot_prof_reset();
+    xTaskCreate(boot_task, "main", 4096, NULL, BOOT_TASK_PRIORITY, NULL);
+    if (trace_file != NULL) {
+        esp_timer_handle_t trace_timer;
+        const esp_timer_create_args_t trace_args = { .callback = trace_export_step, .name = "trace" };
+        esp_timer_create(&trace_args, &trace_timer);
+        esp_timer_start_periodic(trace_timer, TRACE_DRAIN_PERIOD_MS * 1000);
+    } else if (level >= ESP_LOG_INFO) {
+        trace_start_task(TRACE_OUTPUT_LOG, tskIDLE_PRIORITY + 1);  // Pump and level lines
+    }
+
+    struct timespec wall_start, wall_end;
+    clock_gettime(CLOCK_MONOTONIC, &wall_start);
+
+    esp_err_t ret = sim_run_until(duration_s * 1000000);
+
+    clock_gettime(CLOCK_MONOTONIC, &wall_end);
+    double wall_ms = (wall_end.tv_sec - wall_start.tv_sec) * 1e3 +
+                     (wall_end.tv_nsec - wall_start.tv_nsec) / 1e6;
+
+    if (capture != NULL) {
+        report_capture_stop();
+        fclose(capture);
+    }
+    esp_err_t trace_ret = ESP_OK;
+    if (trace_file != NULL) {
+        trace_export_step(NULL);
+        trace_ret = trace_export_close(&s_export);
+    }
+
+    TaskStatus_t tasks[8];
+    UBaseType_t task_count = uxTaskGetSystemState(tasks, 8, NULL);
+
+    node_hal_posix_stats_t hal;
+    nvs_posix_stats_t nvs;
+    sim_stats_t sim;
+    node_hal_posix_get_stats(&hal);
+    nvs_posix_get_stats(&nvs);
+    sim_get_stats(&sim);
+
+    printf("Simulated:      %lld s (%s clock), wall %.1f ms\n",
+           (long long)(node_hal_time_us() / 1000000), realtime ? "real" : "virtual", wall_ms);
+    printf("Reports:        %lu (%lu dropped, %lu pings)\n", (unsigned long)s_reports,
+           (unsigned long)s_reports_dropped, (unsigned long)hal.pings);
+    printf("Pump:           %lu starts, %lu s runtime\n",
+           (unsigned long)((hal.relay_switches + 1) / 2),
+           (unsigned long)pump_control_runtime_sec(&s_pump));
+    printf("Tank level:     %.1f .. %.1f cm of %.0f, %.0f l used, %.0f l unmet\n",
+           s_plant.stats.min_cm, s_plant.stats.max_cm, s_plant.cfg.height_cm,
+           s_plant.stats.consumed_l, s_plant.stats.unmet_l);
+    printf("Metrics:        %ld reports received, %ld pump transitions, %ld sensor timeouts\n",
+           (long)metrics_get(METRIC_REPORTS_RECEIVED), (long)metrics_get(METRIC_PUMP_TRANSITIONS),
+           (long)metrics_get(METRIC_SENSOR_TIMEOUTS));
+    printf("Stack peak:    ");
+    for (UBaseType_t i = 0; i < task_count; i++) {
+        printf(" %s %zu", tasks[i].pcTaskName, sim_task_stack_used(tasks[i].xHandle));
+    }
+    printf(" bytes (x86-64 frames, 4096 requested)\n");
+    if (trace_file != NULL) {
+        const trace_export_stats_t *ts = &s_export.stats;
+        printf("Trace:          %llu events (%llu lost), %llu report->relay spans, "
+               "mean %.1f ms, max %.1f ms%s\n",
+               (unsigned long long)ts->events, (unsigned long long)ts->dropped,
+               (unsigned long long)ts->latency_spans,
+               ts->latency_spans ? ts->latency_sum_us / 1e3 / ts->latency_spans : 0.0,
+               ts->latency_max_us / 1e3, trace_ret == ESP_OK ? "" : " (write failed)");
+    }
+    printf("Boot:           ready %ld ms, link up %ld ms, first report %ld ms\n",
+           (long)metrics_get(METRIC_BOOT_READY_MS), (long)metrics_get(METRIC_BOOT_JOINED_MS),
+           (long)metrics_get(METRIC_BOOT_FIRST_REPORT_MS));
+    energy_ledger_t ledger;
+    energy_estimate_t est;
+    energy_get(&ledger);
+    energy_estimate(&ledger, &model, &est);
+    uint32_t ping_us = ledger.events[ENERGY_EV_PING] ?
+        (uint32_t)(ledger.state_us[ENERGY_ULTRASONIC] / ledger.events[ENERGY_EV_PING]) : 0;
+    printf("Energy:         sensor %.2f mAh/day (%.3f mA), %.0f days on %.0f mAh, "
+           "ping %.1f ms\n", est.mah_per_day, est.avg_ma, est.battery_days, model.battery_mah,
+           ping_us / 1e3);
+    if (energy_detail) {
+        print_energy_states(&ledger, &est);
+        print_energy_configs(&model, ping_us);
+    }
+    e2e_sensor_t e2e;
+    memset(&e2e, 0, sizeof(e2e));
+    e2e_get_sensors(&e2e, 1);
+    printf("E2E:            %lu reports, %lu lost, sample->rx max %lu ms, "
+           "rx->relay %lu switches max %lu ms\n", (unsigned long)e2e.reports,
+           (unsigned long)e2e.seq_gaps, (unsigned long)e2e.sample_rx.max_us,
+           (unsigned long)e2e.rx_relay.count, (unsigned long)e2e.rx_relay.max_us);
+    printf("Zigbee attrs:   %lu writes\n", (unsigned long)hal.zb_attr_writes);
+    printf("BLE status:     %lu updates\n", (unsigned long)hal.ble_status_updates);
+    printf("NVS:            %lu writes, %lu bytes\n",
+           (unsigned long)nvs.writes, (unsigned long)nvs.bytes_written);
+    printf("Scheduler:      %llu switches, %llu timer callbacks, %llu time jumps\n",
+           (unsigned long long)sim.context_switches, (unsigned long long)sim.timer_callbacks,
+           (unsigned long long)sim.time_jumps);
+
+    if (check) {
+        // A day at the default demand must cycle the pump and never run dry
+        bool ok = ret == ESP_OK && trace_ret == ESP_OK && hal.relay_switches >= 2 && s_plant.stats.dry_us == 0 &&
+                  s_reports > 0 && s_reports_dropped == 0 &&
+                  e2e.reports == s_reports && e2e.seq_gaps == 0 &&
+                  ledger.events[ENERGY_EV_PING] == hal.pings &&
+                  metrics_get(METRIC_PUMP_TRANSITIONS) == (int32_t)hal.relay_switches;
+        printf("Check:          %s\n", ok ? "PASS" : "FAIL");
+        return ok ? 0 : 1;
+    }
+    return ret == ESP_OK && trace_ret == ESP_OK ? 0 : 1;
+}
@@ -0,0 +1,273 @@
+/*
+ * Host build: NVS on POSIX
+ * In-memory key/value store with optional file backing, same semantics as the
+ * parts of ESP-IDF NVS that config_store.c uses (typed entries, namespaces,
+ * NOT_FOUND on a type mismatch, length query with a NULL blob buffer).
+ */
+
+#include "nvs.h"
+#include "nvs_posix.h"
+#include <stdio.h>
+#include <string.h>
+#include <stdbool.h>
+
+#define NVS_KEY_LEN         16      // 15 chars + NUL, as on ESP-IDF
+#define NVS_MAX_NAMESPACES  8
+
+typedef enum {
+    NVS_TYPE_U8 = 1,
+    NVS_TYPE_U16 = 2,
+    NVS_TYPE_BLOB = 3,
+} nvs_type_t;
+
+typedef struct {
+    bool     used;
+    uint8_t  ns;
+    uint8_t  type;
+    char     key[NVS_KEY_LEN];
+    uint16_t len;
+    uint8_t  value[NVS_POSIX_MAX_VALUE];
+} nvs_entry_t;
+
+static char s_namespaces[NVS_MAX_NAMESPACES][NVS_KEY_LEN];
+static nvs_entry_t s_entries[NVS_POSIX_MAX_ENTRIES];
+static nvs_posix_stats_t s_stats;
+static char s_file[256];
+
+/* ============================================================================
+ * FILE BACKING
+ * ============================================================================ */
+
+// Image: namespace table, then the entry table, native layout. Host-only
+// scratch state, not a portable format.
+static void file_save(void)
+{
+    if (s_file[0] == '\0') {
+        return;
+    }
+    FILE *f = fopen(s_file, "wb");
+    if (f == NULL) {
+        return;
+    }
+    fwrite(s_namespaces, sizeof(s_namespaces), 1, f);
+    fwrite(s_entries, sizeof(s_entries), 1, f);
+    fclose(f);
+}
+
+esp_err_t nvs_posix_set_file(const char *path)
+{
+    nvs_posix_reset();
+    if (path == NULL) {
+        return ESP_OK;
+    }
+    snprintf(s_file, sizeof(s_file), "%s", path);
+
+    FILE *f = fopen(path, "rb");
+    if (f == NULL) {
+        return ESP_OK;      // Created on first commit
+    }
+    bool ok = fread(s_namespaces, sizeof(s_namespaces), 1, f) == 1 &&
+              fread(s_entries, sizeof(s_entries), 1, f) == 1;
+    fclose(f);
+    if (!ok) {
+        nvs_posix_reset();
+        snprintf(s_file, sizeof(s_file), "%s", path);
+        return ESP_ERR_INVALID_SIZE;
+    }
+    return ESP_OK;
+}
+
+void nvs_posix_reset(void)
+{
+    memset(s_namespaces, 0, sizeof(s_namespaces));
+    memset(s_entries, 0, sizeof(s_entries));
+    memset(&s_stats, 0, sizeof(s_stats));
+    s_file[0] = '\0';
+}
+
+void nvs_posix_get_stats(nvs_posix_stats_t *stats)
+{
+    *stats = s_stats;
+}
+
+/* ============================================================================
+ * ENTRIES
+ * ============================================================================ */
+
+// Handles are namespace index + 1 (0 is never valid)
+static bool handle_ns(nvs_handle_t handle, uint8_t *ns)
+{
+    if (handle == 0 || handle > NVS_MAX_NAMESPACES || s_namespaces[handle - 1][0] == '\0') {
+        return false;
+    }
+    *ns = (uint8_t)(handle - 1);
+    return true;
+}
+
+static nvs_entry_t *entry_find(uint8_t ns, const char *key)
+{
+    for (int i = 0; i < NVS_POSIX_MAX_ENTRIES; i++) {
+        if (s_entries[i].used && s_entries[i].ns == ns &&
+            strncmp(s_entries[i].key, key, NVS_KEY_LEN) == 0) {
+            return &s_entries[i];
+        }
+    }
+    return NULL;
+}
+
+static esp_err_t entry_set(nvs_handle_t handle, const char *key, nvs_type_t type,
+                           const void *value, size_t len)
+{
+    uint8_t ns;
+    if (!handle_ns(handle, &ns) || key == NULL || strlen(key) >= NVS_KEY_LEN) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (len > NVS_POSIX_MAX_VALUE) {
+        return ESP_ERR_NVS_INVALID_LENGTH;
+    }
+
+    nvs_entry_t *e = entry_find(ns, key);
+    for (int i = 0; e == NULL && i < NVS_POSIX_MAX_ENTRIES; i++) {
+        if (!s_entries[i].used) {
+            e = &s_entries[i];
+        }
+    }
+    if (e == NULL) {
+        return ESP_ERR_NVS_NO_FREE_PAGES;
+    }
+
+    e->used = true;
+    e->ns = ns;
+    e->type = type;
+    snprintf(e->key, sizeof(e->key), "%s", key);
+    e->len = (uint16_t)len;
+    memcpy(e->value, value, len);
+
+    s_stats.writes++;
+    s_stats.bytes_written += len;
+    return ESP_OK;
+}
+
+static nvs_entry_t *entry_get(nvs_handle_t handle, const char *key, nvs_type_t type)
+{
+    uint8_t ns;
+    if (!handle_ns(handle, &ns) || key == NULL) {
+        return NULL;
+    }
+    nvs_entry_t *e = entry_find(ns, key);
+    return (e != NULL && e->type == type) ? e : NULL;
+}
+
+/* ============================================================================
+ * NVS API
+ * ============================================================================ */
+
+esp_err_t nvs_open(const char *name, nvs_open_mode_t open_mode, nvs_handle_t *out_handle)
+{
+    (void)open_mode;
+    if (name == NULL || strlen(name) >= NVS_KEY_LEN) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    for (int i = 0; i < NVS_MAX_NAMESPACES; i++) {
+        if (strcmp(s_namespaces[i], name) == 0 || s_namespaces[i][0] == '\0') {
+            snprintf(s_namespaces[i], NVS_KEY_LEN, "%s", name);
+            *out_handle = (nvs_handle_t)(i + 1);
+            return ESP_OK;
+        }
+    }
+    return ESP_ERR_NVS_NO_FREE_PAGES;
+}
+
+void nvs_close(nvs_handle_t handle)
+{
+    (void)handle;
+}
+
+esp_err_t nvs_commit(nvs_handle_t handle)
+{
+    (void)handle;
+    s_stats.commits++;
+    file_save();
+    return ESP_OK;
+}
+
+esp_err_t nvs_set_u8(nvs_handle_t handle, const char *key, uint8_t value)
+{
+    return entry_set(handle, key, NVS_TYPE_U8, &value, sizeof(value));
+}
+
+esp_err_t nvs_set_u16(nvs_handle_t handle, const char *key, uint16_t value)
+{
+    return entry_set(handle, key, NVS_TYPE_U16, &value, sizeof(value));
+}
+
+esp_err_t nvs_set_blob(nvs_handle_t handle, const char *key, const void *value, size_t length)
+{
+    return entry_set(handle, key, NVS_TYPE_BLOB, value, length);
+}
+
+esp_err_t nvs_get_u8(nvs_handle_t handle, const char *key, uint8_t *out_value)
+{
+    nvs_entry_t *e = entry_get(handle, key, NVS_TYPE_U8);
+    if (e == NULL) {
+        return ESP_ERR_NVS_NOT_FOUND;
+    }
+    memcpy(out_value, e->value, sizeof(*out_value));
+    return ESP_OK;
+}
+
+esp_err_t nvs_get_u16(nvs_handle_t handle, const char *key, uint16_t *out_value)
+{
+    nvs_entry_t *e = entry_get(handle, key, NVS_TYPE_U16);
+    if (e == NULL) {
+        return ESP_ERR_NVS_NOT_FOUND;
+    }
+    memcpy(out_value, e->value, sizeof(*out_value));
+    return ESP_OK;
+}
+
+esp_err_t nvs_get_blob(nvs_handle_t handle, const char *key, void *out_value, size_t *length)
+{
+    nvs_entry_t *e = entry_get(handle, key, NVS_TYPE_BLOB);
+    if (e == NULL) {
+        return ESP_ERR_NVS_NOT_FOUND;
+    }
+    if (out_value == NULL) {
+        *length = e->len;
+        return ESP_OK;
+    }
+    if (*length < e->len) {
+        return ESP_ERR_NVS_INVALID_LENGTH;
+    }
+    memcpy(out_value, e->value, e->len);
+    *length = e->len;
+    return ESP_OK;
+}
+
+esp_err_t nvs_erase_key(nvs_handle_t handle, const char *key)
+{
+    uint8_t ns;
+    if (!handle_ns(handle, &ns)) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    nvs_entry_t *e = entry_find(ns, key);
+    if (e == NULL) {
+        return ESP_ERR_NVS_NOT_FOUND;
+    }
+    e->used = false;
+    return ESP_OK;
+}
+
+esp_err_t nvs_erase_all(nvs_handle_t handle)
+{
+    uint8_t ns;
+    if (!handle_ns(handle, &ns)) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    for (int i = 0; i < NVS_POSIX_MAX_ENTRIES; i++) {
+        if (s_entries[i].used && s_entries[i].ns == ns) {
+            s_entries[i].used = false;
+        }
+    }
+    return ESP_OK;
+}
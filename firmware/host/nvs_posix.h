@@ -0,0 +1,34 @@
+/*
+ * Host build: NVS on POSIX - test and runner controls
+ */
+
+#ifndef NVS_POSIX_H
+#define NVS_POSIX_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include "esp_err.h"
+
+#define NVS_POSIX_MAX_ENTRIES   64
+#define NVS_POSIX_MAX_VALUE     256
+
+typedef struct {
+    uint32_t writes;            // set_* calls (each one a flash write on target)
+    uint32_t bytes_written;
+    uint32_t commits;
+} nvs_posix_stats_t;
+
+/**
+ * Erase everything and drop the file backing
+ */
+void nvs_posix_reset(void);
+
+/**
+ * Back the store with a file: loaded now, rewritten on every nvs_commit().
+ * NULL keeps the store in memory only.
+ */
+esp_err_t nvs_posix_set_file(const char *path);
+
+void nvs_posix_get_stats(nvs_posix_stats_t *stats);
+
+#endif // NVS_POSIX_H
@@ -0,0 +1,331 @@
+/*
+ * Cultivio AquaSense - Control Strategy Benchmark
+ * Closes the loop between the real sensor and controller logic and the tank
+ * plant model (shared/tank_plant) for a matrix of strategies and configs,
+ * and scores each run, so tuning changes are judged on numbers.
+ *
+ * Usage: plant_bench [--days N] [--seed N] [--csv] [--check]
+ *
+ * Each scenario runs like node_host: sensor task measuring the plant through
+ * the HAL echo model, a Zigbee link queue, the controller's control pass
+ * every second, all in virtual time. Metrics per scenario:
+ *   cycles/day     pump starts per simulated day
+ *   runtime        relay-closed hours per day
+ *   overshoot      level above the OFF threshold when the relay opened
+ *   undershoot     level below the ON threshold when the relay closed
+ *   dry            minutes the level sat below the tank outlet
+ *   unmet          litres the household wanted while dry
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/queue.h"
+#include "freertos/semphr.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "config_derived.h"
+#include "water_level.h"
+#include "pump_control.h"
+#include "tank_plant.h"
+#include "node_hal_posix.h"
+#include "sim.h"
+
+/* ============================================================================
+ * SCENARIOS
+ * ============================================================================ */
+
+#define PLANT_STEP_US           1000000
+#define ZB_LINK_DEPTH           4
+
+typedef enum {
+    STRATEGY_HYSTERESIS,        // Firmware pump_control_step(): ON/OFF band
+    STRATEGY_SETPOINT,          // Reference: one threshold, no band
+} strategy_t;
+
+static const char *s_strategy_names[] = { "hysteresis", "setpoint" };
+
+typedef struct {
+    strategy_t strategy;
+    uint8_t  on_pct;
+    uint8_t  off_pct;            // Setpoint strategy: ignored
+    uint16_t report_sec;
+    uint16_t timeout_min;
+    float    noise_cm;
+    uint8_t  ping_fail_pct;
+} scenario_t;
+
+static const scenario_t s_scenarios[] = {
+    { STRATEGY_HYSTERESIS, 20, 80,  5, 60, 0.5f,  2 },    // Shipping defaults
+    { STRATEGY_HYSTERESIS, 20, 80, 60, 60, 0.5f,  2 },    // Slow reports
+    { STRATEGY_HYSTERESIS, 30, 70,  5, 60, 0.5f,  2 },    // Narrow band
+    { STRATEGY_HYSTERESIS, 10, 95,  5, 60, 0.5f,  2 },    // Wide band
+    { STRATEGY_HYSTERESIS, 20, 80,  5, 30, 0.5f,  2 },    // Short pump timeout
+    { STRATEGY_HYSTERESIS, 20, 80,  5, 60, 5.0f, 20 },    // Poor sensor
+    { STRATEGY_SETPOINT,   50, 50,  5, 60, 0.5f,  2 },
+};
+
+#define SCENARIO_COUNT (sizeof(s_scenarios) / sizeof(s_scenarios[0]))
+
+typedef struct {
+    float    cycles_per_day;
+    float    runtime_h_per_day;
+    float    overshoot_avg_pct;
+    float    overshoot_max_pct;
+    float    undershoot_max_pct;
+    float    dry_min;
+    float    unmet_l;
+    float    min_pct;
+    float    max_pct;
+    uint32_t reports;
+    double   wall_ms;
+} result_t;
+
+/* ============================================================================
+ * CLOSED LOOP
+ * ============================================================================ */
+
+typedef struct {
+    uint8_t level_pct;
+} zb_report_t;
+
+static const scenario_t *s_sc;
+static config_derived_t s_dc;
+static tank_plant_t s_plant;
+static water_level_t s_level;
+static pump_control_t s_pump;
+static QueueHandle_t s_zb_link;
+static SemaphoreHandle_t s_zb_lock;
+static uint32_t s_reports;
+
+// Transition scoring, sampled with the plant
+static bool s_relay_was_on;
+static uint32_t s_stops;
+static float s_overshoot_sum;
+static float s_overshoot_max;
+static float s_undershoot_max;
+
+static void plant_step(void *arg)
+{
+    (void)arg;
+    node_hal_posix_stats_t hal;
+    node_hal_posix_get_stats(&hal);
+    tank_plant_step(&s_plant, hal.relay_on, node_hal_time_us());
+
+    float pct = tank_plant_level_pct(&s_plant);
+    if (hal.relay_on && !s_relay_was_on) {
+        float under = (float)s_sc->on_pct - pct;
+        if (under > s_undershoot_max) s_undershoot_max = under;
+    } else if (!hal.relay_on && s_relay_was_on) {
+        float over = pct - (float)s_sc->off_pct;
+        if (over < 0) over = 0;
+        s_stops++;
+        s_overshoot_sum += over;
+        if (over > s_overshoot_max) s_overshoot_max = over;
+    }
+    s_relay_was_on = hal.relay_on;
+}
+
+static void sensor_task(void *arg)
+{
+    (void)arg;
+    for (;;) {
+        water_level_measure(&s_dc, &s_level);
+        zb_report_t report = { .level_pct = s_level.percent };
+        if (xQueueSend(s_zb_link, &report, 0) == pdTRUE) {
+            s_reports++;
+        }
+        vTaskDelay(pdMS_TO_TICKS(s_dc.report_interval_ms));
+    }
+}
+
+static void zb_task(void *arg)
+{
+    (void)arg;
+    zb_report_t report;
+    for (;;) {
+        if (xQueueReceive(s_zb_link, &report, portMAX_DELAY) == pdTRUE) {
+            xSemaphoreTake(s_zb_lock, portMAX_DELAY);
+            pump_control_sensor_update(&s_pump, report.level_pct);
+            xSemaphoreGive(s_zb_lock);
+        }
+    }
+}
+
+static void control_task(void *arg)
+{
+    (void)arg;
+    for (;;) {
+        xSemaphoreTake(s_zb_lock, portMAX_DELAY);
+        switch (s_sc->strategy) {
+            case STRATEGY_HYSTERESIS:
+                pump_control_step(&s_pump, &s_dc);
+                break;
+            case STRATEGY_SETPOINT:
+                if (s_pump.last_sensor_update_us > 0) {
+                    if (s_pump.water_level_pct < s_sc->on_pct && !s_pump.running) {
+                        pump_control_on(&s_pump);
+                    } else if (s_pump.water_level_pct >= s_sc->on_pct && s_pump.running) {
+                        pump_control_off(&s_pump);
+                    }
+                }
+                break;
+        }
+        xSemaphoreGive(s_zb_lock);
+        vTaskDelay(pdMS_TO_TICKS(1000));
+    }
+}
+
+static esp_err_t run_scenario(const scenario_t *sc, double days, uint32_t seed, result_t *res)
+{
+    node_hal_posix_reset(NODE_HAL_CLOCK_VIRTUAL);
+    sim_reset();
+
+    s_sc = sc;
+    s_reports = 0;
+    s_relay_was_on = false;
+    s_stops = 0;
+    s_overshoot_sum = s_overshoot_max = s_undershoot_max = 0;
+
+    device_config_t cfg;
+    memset(&cfg, 0, sizeof(cfg));
+    cfg.tank_height_cm = 200;
+    cfg.tank_diameter_cm = 100;
+    cfg.pump_on_threshold = sc->on_pct;
+    cfg.pump_off_threshold = sc->strategy == STRATEGY_SETPOINT ? sc->on_pct + 1 : sc->off_pct;
+    cfg.pump_timeout_minutes = sc->timeout_min;
+    cfg.report_interval_sec = sc->report_sec;
+    config_derive(&cfg, &s_dc);
+
+    tank_plant_config_t pcfg = TANK_PLANT_CONFIG_DEFAULT();
+    pcfg.height_cm = s_dc.tank_height_cm;
+    pcfg.diameter_cm = cfg.tank_diameter_cm;
+    pcfg.sensor_offset_cm = s_dc.sensor_offset_cm;
+    pcfg.noise_cm = sc->noise_cm;
+    pcfg.ping_fail_pct = sc->ping_fail_pct;
+    pcfg.seed = seed;
+    tank_plant_init(&s_plant, &pcfg, 0);
+    node_hal_posix_set_echo(tank_plant_echo_cm, &s_plant);
+
+    memset(&s_level, 0, sizeof(s_level));
+    pump_control_init(&s_pump);
+    s_zb_link = xQueueCreate(ZB_LINK_DEPTH, sizeof(zb_report_t));
+    s_zb_lock = xSemaphoreCreateMutex();
+
+    esp_timer_handle_t plant_timer;
+    const esp_timer_create_args_t plant_args = { .callback = plant_step, .name = "plant" };
+    esp_timer_create(&plant_args, &plant_timer);
+    esp_timer_start_periodic(plant_timer, PLANT_STEP_US);
+
+    xTaskCreate(zb_task, "zigbee", 4096, NULL, 5, NULL);
+    xTaskCreate(control_task, "control", 4096, NULL, 4, NULL);
+    xTaskCreate(sensor_task, "sensor", 4096, NULL, 5, NULL);
+
+    struct timespec wall_start, wall_end;
+    clock_gettime(CLOCK_MONOTONIC, &wall_start);
+    esp_err_t ret = sim_run_until((int64_t)(days * 24 * 3600) * 1000000);
+    clock_gettime(CLOCK_MONOTONIC, &wall_end);
+
+    const tank_plant_stats_t *st = &s_plant.stats;
+    res->cycles_per_day = (float)(st->pump_starts / days);
+    res->runtime_h_per_day = (float)(st->pump_on_us / 3600e6 / days);
+    res->overshoot_avg_pct = s_stops ? s_overshoot_sum / (float)s_stops : 0;
+    res->overshoot_max_pct = s_overshoot_max;
+    res->undershoot_max_pct = s_undershoot_max;
+    res->dry_min = (float)(st->dry_us / 60e6);
+    res->unmet_l = st->unmet_l;
+    res->min_pct = st->min_cm * 100.0f / pcfg.height_cm;
+    res->max_pct = st->max_cm * 100.0f / pcfg.height_cm;
+    res->reports = s_reports;
+    res->wall_ms = (wall_end.tv_sec - wall_start.tv_sec) * 1e3 +
+                   (wall_end.tv_nsec - wall_start.tv_nsec) / 1e6;
+
+    vQueueDelete(s_zb_link);
+    vSemaphoreDelete(s_zb_lock);
+    return ret;
+}
+
+/* ============================================================================
+ * MAIN
+ * ============================================================================ */
+
+int main(int argc, char **argv)
+{
+    double days = 2;
+    uint32_t seed = 1;
+    bool csv = false;
+    bool check = false;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--days") == 0 && i + 1 < argc) {
+            days = atof(argv[++i]);
+        } else if (strcmp(argv[i], "--seed") == 0 && i + 1 < argc) {
+            seed = (uint32_t)strtoul(argv[++i], NULL, 0);
+        } else if (strcmp(argv[i], "--csv") == 0) {
+            csv = true;
+        } else if (strcmp(argv[i], "--check") == 0) {
+            check = true;
+        } else {
+            fprintf(stderr, "usage: %s [--days N] [--seed N] [--csv] [--check]\n", argv[0]);
+            return 2;
+        }
+    }
+    if (days <= 0) {
+        fprintf(stderr, "--days must be positive\n");
+        return 2;
+    }
+
+    esp_log_level_set("*", ESP_LOG_NONE);
+
+    if (csv) {
+        printf("strategy,on_pct,off_pct,report_s,timeout_min,noise_cm,ping_fail_pct,"
+               "cycles_per_day,runtime_h_per_day,overshoot_avg_pct,overshoot_max_pct,"
+               "undershoot_max_pct,dry_min,unmet_l,min_pct,max_pct\n");
+    } else {
+        printf("%.1f simulated days per scenario, seed %lu\n\n", days, (unsigned long)seed);
+        printf("%-10s %7s %6s %5s %9s %7s %7s %11s %6s %6s %7s %11s\n",
+               "strategy", "on/off", "report", "tmo", "noise", "cyc/d", "run h/d",
+               "over avg/max", "under", "dry", "unmet", "range %");
+    }
+
+    bool ok = true;
+    for (size_t i = 0; i < SCENARIO_COUNT; i++) {
+        const scenario_t *sc = &s_scenarios[i];
+        result_t r;
+        if (run_scenario(sc, days, seed, &r) != ESP_OK) {
+            ok = false;
+        }
+
+        if (csv) {
+            printf("%s,%u,%u,%u,%u,%.1f,%u,%.2f,%.2f,%.2f,%.2f,%.2f,%.1f,%.0f,%.1f,%.1f\n",
+                   s_strategy_names[sc->strategy], sc->on_pct, sc->off_pct, sc->report_sec,
+                   sc->timeout_min, sc->noise_cm, sc->ping_fail_pct, r.cycles_per_day,
+                   r.runtime_h_per_day, r.overshoot_avg_pct, r.overshoot_max_pct,
+                   r.undershoot_max_pct, r.dry_min, r.unmet_l, r.min_pct, r.max_pct);
+        } else {
+            char band[12], noise[16];
+            snprintf(band, sizeof(band), "%u/%u", sc->on_pct, sc->off_pct);
+            snprintf(noise, sizeof(noise), "%.1f/%u%%", sc->noise_cm, sc->ping_fail_pct);
+            printf("%-10s %7s %5us %4um %9s %7.1f %7.2f %5.2f/%5.2f %6.2f %5.0fm %6.0fl %5.0f-%-5.0f\n",
+                   s_strategy_names[sc->strategy], band, sc->report_sec, sc->timeout_min, noise,
+                   r.cycles_per_day, r.runtime_h_per_day, r.overshoot_avg_pct,
+                   r.overshoot_max_pct, r.undershoot_max_pct, r.dry_min, r.unmet_l,
+                   r.min_pct, r.max_pct);
+        }
+
+        // The shipping configuration must keep water in the tank and cycle
+        if (i == 0 && (r.dry_min > 0 || r.cycles_per_day < 1)) {
+            ok = false;
+        }
+    }
+
+    if (check) {
+        printf("\nCheck:          %s\n", ok ? "PASS" : "FAIL");
+        return ok ? 0 : 1;
+    }
+    return 0;
+}
@@ -0,0 +1,395 @@
+/*
+ * Cultivio AquaSense - Report Replay
+ * Feeds a controller report capture (shared/report_capture) back through the
+ * real pump control logic in virtual time and compares the pump decisions
+ * with the ones the device recorded.
+ *
+ * Usage: replay_host FILE [--tolerance-ms N] [--repeat N] [-v] [--check]
+ *
+ * FILE is a binary capture (node_host --record, a flash dump saved as
+ * binary) or a serial log containing "AQRC:" lines, as printed by the UART
+ * sink or a flash dump; other log lines are ignored.
+ *
+ * The controller runs its control pass once a second. CONFIG and PUMP
+ * records are written from inside a pass, so the replay re-aligns its pass
+ * schedule on them; a replayed decision matches a recorded one when the
+ * direction agrees and the times are within the tolerance (one pass by
+ * default). No simulator tasks: the clock jumps straight from event to
+ * event, so months of captures replay in well under a second.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "esp_log.h"
+#include "config_derived.h"
+#include "pump_control.h"
+#include "node_hal.h"
+#include "report_capture.h"
+#include "node_hal_posix.h"
+
+#define CONTROL_PERIOD_MS       1000
+#define DECISION_QUEUE          16
+#define MISMATCH_PRINT_MAX      10
+
+/* ============================================================================
+ * CAPTURE LOADING
+ * ============================================================================ */
+
+typedef struct {
+    uint8_t *data;
+    size_t   len;
+    size_t   cap;
+} buffer_t;
+
+static bool buffer_append(buffer_t *b, const uint8_t *data, size_t len)
+{
+    if (b->len + len > b->cap) {
+        size_t cap = b->cap ? b->cap * 2 : 4096;
+        while (cap < b->len + len) cap *= 2;
+        uint8_t *p = realloc(b->data, cap);
+        if (p == NULL) {
+            return false;
+        }
+        b->data = p;
+        b->cap = cap;
+    }
+    memcpy(b->data + b->len, data, len);
+    b->len += len;
+    return true;
+}
+
+static bool load_capture(const char *path, buffer_t *out)
+{
+    FILE *f = fopen(path, "rb");
+    if (f == NULL) {
+        return false;
+    }
+
+    buffer_t raw = { 0 };
+    uint8_t chunk[65536];
+    size_t n;
+    while ((n = fread(chunk, 1, sizeof(chunk), f)) > 0) {
+        if (!buffer_append(&raw, chunk, n)) {
+            fclose(f);
+            return false;
+        }
+    }
+    fclose(f);
+
+    if (raw.len >= 4 && memcmp(raw.data, REPORT_CAPTURE_MAGIC, 4) == 0) {
+        *out = raw;
+        return true;
+    }
+
+    // Serial log: decode the capture lines, skip everything else
+    uint8_t line_bytes[256];
+    char *text = realloc(raw.data, raw.len + 1);
+    if (text == NULL) {
+        free(raw.data);
+        return false;
+    }
+    text[raw.len] = '\0';
+    for (char *line = strtok(text, "\r\n"); line != NULL; line = strtok(NULL, "\r\n")) {
+        int len = report_capture_line_decode(line, line_bytes, sizeof(line_bytes));
+        if (len > 0 && !buffer_append(out, line_bytes, (size_t)len)) {
+            free(text);
+            return false;
+        }
+    }
+    free(text);
+    return true;
+}
+
+/* ============================================================================
+ * DECISION MATCHING
+ * ============================================================================ */
+
+typedef struct {
+    int64_t t_ms;
+    bool    on;
+} decision_t;
+
+typedef struct {
+    decision_t items[DECISION_QUEUE];
+    int head;
+    int count;
+} decision_queue_t;
+
+static void queue_push(decision_queue_t *q, int64_t t_ms, bool on)
+{
+    if (q->count == DECISION_QUEUE) {
+        q->head = (q->head + 1) % DECISION_QUEUE;     // Oldest is reported as lost
+        q->count--;
+    }
+    q->items[(q->head + q->count) % DECISION_QUEUE] = (decision_t){ t_ms, on };
+    q->count++;
+}
+
+static decision_t queue_pop(decision_queue_t *q)
+{
+    decision_t d = q->items[q->head];
+    q->head = (q->head + 1) % DECISION_QUEUE;
+    q->count--;
+    return d;
+}
+
+typedef struct {
+    // Capture contents
+    uint32_t records;
+    uint32_t reports;
+    uint32_t boots;
+    uint32_t configs;
+    uint32_t manuals;
+    int64_t  span_ms;
+
+    // Replay
+    uint64_t passes;
+    uint32_t recorded;
+    uint32_t replayed;
+    uint32_t matched;
+    uint32_t mismatched;
+} replay_result_t;
+
+typedef struct {
+    pump_control_t   pump;
+    config_derived_t dc;
+    bool             was_running;
+    int64_t          next_pass_ms;      // -1 until a pass is seen
+    int64_t          tolerance_ms;
+    decision_queue_t recorded;
+    decision_queue_t replayed;
+    replay_result_t *res;
+    bool             print;
+} replay_t;
+
+static void print_time(int64_t t_ms)
+{
+    int64_t s = t_ms / 1000;
+    printf("%lldd %02lld:%02lld:%02lld.%03lld", (long long)(s / 86400), (long long)(s / 3600 % 24),
+           (long long)(s / 60 % 60), (long long)(s % 60), (long long)(t_ms % 1000));
+}
+
+static void mismatch(replay_t *rp, const char *what, const decision_t *d)
+{
+    rp->res->mismatched++;
+    if (rp->print && rp->res->mismatched <= MISMATCH_PRINT_MAX) {
+        printf("Mismatch:       %s pump %s at ", what, d->on ? "ON" : "OFF");
+        print_time(d->t_ms);
+        printf("\n");
+    }
+}
+
+// Pair recorded and replayed decisions in order; anything left unpaired for
+// longer than the tolerance is a mismatch
+static void match(replay_t *rp, int64_t now_ms)
+{
+    while (rp->recorded.count > 0 && rp->replayed.count > 0) {
+        decision_t rec = queue_pop(&rp->recorded);
+        decision_t rep = queue_pop(&rp->replayed);
+        int64_t dt = rep.t_ms - rec.t_ms;
+        if (rec.on == rep.on && dt <= rp->tolerance_ms && dt >= -rp->tolerance_ms) {
+            rp->res->matched++;
+        } else {
+            mismatch(rp, "recorded", &rec);
+            mismatch(rp, "replayed", &rep);
+        }
+    }
+    while (rp->recorded.count > 0 &&
+           now_ms - rp->recorded.items[rp->recorded.head].t_ms > rp->tolerance_ms) {
+        decision_t d = queue_pop(&rp->recorded);
+        mismatch(rp, "recorded", &d);
+    }
+    while (rp->replayed.count > 0 &&
+           now_ms - rp->replayed.items[rp->replayed.head].t_ms > rp->tolerance_ms) {
+        decision_t d = queue_pop(&rp->replayed);
+        mismatch(rp, "replayed", &d);
+    }
+}
+
+/* ============================================================================
+ * REPLAY
+ * ============================================================================ */
+
+static void observe(replay_t *rp, int64_t t_ms)
+{
+    if (rp->pump.running != rp->was_running) {
+        rp->was_running = rp->pump.running;
+        rp->res->replayed++;
+        queue_push(&rp->replayed, t_ms, rp->pump.running);
+    }
+}
+
+static void control_pass(replay_t *rp, int64_t t_ms)
+{
+    node_hal_posix_wait_until(t_ms * 1000);
+    pump_control_step(&rp->pump, &rp->dc);
+    rp->res->passes++;
+    observe(rp, t_ms);
+    rp->next_pass_ms = t_ms + CONTROL_PERIOD_MS;
+}
+
+static void replay_capture(const uint8_t *data, size_t len, int64_t tolerance_ms,
+                           bool print, replay_result_t *res)
+{
+    static replay_t rp;
+    memset(&rp, 0, sizeof(rp));
+    rp.next_pass_ms = -1;
+    rp.tolerance_ms = tolerance_ms;
+    rp.res = res;
+    rp.print = print;
+
+    device_config_t cfg;
+    memset(&cfg, 0, sizeof(cfg));
+    config_derive(&cfg, &rp.dc);
+
+    node_hal_posix_reset(NODE_HAL_CLOCK_VIRTUAL);
+    pump_control_init(&rp.pump);
+
+    report_capture_reader_t reader;
+    report_capture_reader_init(&reader, data, len);
+    report_capture_event_t ev;
+
+    while (report_capture_next(&reader, &ev)) {
+        res->records++;
+
+        if (rp.next_pass_ms >= 0) {
+            while (rp.next_pass_ms < ev.t_ms) {
+                control_pass(&rp, rp.next_pass_ms);
+            }
+        }
+        node_hal_posix_wait_until(ev.t_ms * 1000);
+
+        switch (ev.type) {
+            case REPORT_CAPTURE_BOOT:
+                // Device restarted: relay off, controller state gone
+                res->boots++;
+                pump_control_init(&rp.pump);
+                rp.was_running = false;
+                rp.next_pass_ms = -1;
+                break;
+
+            case REPORT_CAPTURE_REPORT:
+                res->reports++;
+                if (ev.id == NODE_ZB_ATTR_LEVEL_PCT) {
+                    pump_control_sensor_update(&rp.pump, (uint8_t)ev.value);
+                }
+                break;
+
+            case REPORT_CAPTURE_CONFIG: {
+                // Recorded at the start of a pass, before its step
+                res->configs++;
+                cfg.pump_on_threshold = ev.arg;
+                cfg.pump_off_threshold = (uint8_t)ev.id;
+                cfg.pump_timeout_minutes = (uint16_t)((ev.value + 59) / 60);
+                config_derive(&cfg, &rp.dc);
+                rp.dc.pump_timeout_sec = ev.value;
+                rp.dc.pump_timeout_us = (int64_t)ev.value * 1000000;
+                control_pass(&rp, ev.t_ms);
+                break;
+            }
+
+            case REPORT_CAPTURE_PUMP:
+                // Recorded right after the pass that switched the relay
+                res->recorded++;
+                if (rp.next_pass_ms != ev.t_ms + CONTROL_PERIOD_MS) {
+                    control_pass(&rp, ev.t_ms);
+                }
+                queue_push(&rp.recorded, ev.t_ms, ev.arg != 0);
+                break;
+
+            case REPORT_CAPTURE_MANUAL: {
+                res->manuals++;
+                manual_pump_cmd_t cmd = { .command = ev.arg, .duration_minutes = ev.value };
+                pump_control_manual(&rp.pump, &cmd);
+                observe(&rp, ev.t_ms);
+                break;
+            }
+
+            default:
+                break;
+        }
+
+        match(&rp, ev.t_ms);
+        res->span_ms = ev.t_ms;
+    }
+
+    match(&rp, INT64_MAX);
+}
+
+/* ============================================================================
+ * MAIN
+ * ============================================================================ */
+
+int main(int argc, char **argv)
+{
+    const char *path = NULL;
+    int64_t tolerance_ms = CONTROL_PERIOD_MS;
+    int repeat = 1;
+    bool verbose = false;
+    bool check = false;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--tolerance-ms") == 0 && i + 1 < argc) {
+            tolerance_ms = atoll(argv[++i]);
+        } else if (strcmp(argv[i], "--repeat") == 0 && i + 1 < argc) {
+            repeat = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "-v") == 0) {
+            verbose = true;
+        } else if (strcmp(argv[i], "--check") == 0) {
+            check = true;
+        } else if (argv[i][0] != '-' && path == NULL) {
+            path = argv[i];
+        } else {
+            path = NULL;
+            break;
+        }
+    }
+    if (path == NULL || repeat < 1) {
+        fprintf(stderr, "usage: %s FILE [--tolerance-ms N] [--repeat N] [-v] [--check]\n", argv[0]);
+        return 2;
+    }
+
+    buffer_t capture = { 0 };
+    if (!load_capture(path, &capture)) {
+        fprintf(stderr, "cannot read %s\n", path);
+        return 2;
+    }
+
+    esp_log_level_set("*", verbose ? ESP_LOG_INFO : ESP_LOG_NONE);
+
+    replay_result_t res;
+    struct timespec wall_start, wall_end;
+    clock_gettime(CLOCK_MONOTONIC, &wall_start);
+    for (int i = 0; i < repeat; i++) {
+        memset(&res, 0, sizeof(res));
+        replay_capture(capture.data, capture.len, tolerance_ms, i == 0, &res);
+    }
+    clock_gettime(CLOCK_MONOTONIC, &wall_end);
+    double wall_s = (double)(wall_end.tv_sec - wall_start.tv_sec) +
+                    (double)(wall_end.tv_nsec - wall_start.tv_nsec) / 1e9;
+    double events = (double)res.records * repeat;
+
+    printf("Capture:        %lu records over %.2f days: %lu reports, %lu config, "
+           "%lu manual, %lu boots\n",
+           (unsigned long)res.records, res.span_ms / 86400e3, (unsigned long)res.reports,
+           (unsigned long)res.configs, (unsigned long)res.manuals, (unsigned long)res.boots);
+    printf("Decisions:      %lu recorded, %lu replayed, %lu matched, %lu mismatched "
+           "(tolerance %lld ms)\n",
+           (unsigned long)res.recorded, (unsigned long)res.replayed, (unsigned long)res.matched,
+           (unsigned long)res.mismatched, (long long)tolerance_ms);
+    printf("Replay:         %d x in %.1f ms, %.2f M events/s, %llu control passes each\n",
+           repeat, wall_s * 1e3, wall_s > 0 ? events / wall_s / 1e6 : 0,
+           (unsigned long long)res.passes);
+
+    free(capture.data);
+
+    if (check) {
+        bool ok = res.records > 0 && res.mismatched == 0;
+        printf("Check:          %s\n", ok ? "PASS" : "FAIL");
+        return ok ? 0 : 1;
+    }
+    return 0;
+}
@@ -0,0 +1,79 @@
+/*
+ * Discrete-Event Simulator - runner controls (firmware/host)
+ *
+ * FreeRTOS tasks, queues, semaphores, event groups and esp_timer for host
+ * builds, scheduled in virtual time. Tasks are cooperative coroutines: one
+ * runs at a time, highest priority first (FIFO within a priority), until it
+ * blocks, yields or is preempted by a task it woke. When every task is
+ * blocked the clock jumps straight to the next wake-up or timer expiry, so
+ * a simulated day costs only the CPU time the firmware logic itself needs.
+ *
+ * Nothing depends on wall time or allocation addresses: the same inputs
+ * give the same interleaving, every run.
+ *
+ * Typical runner:
+ *
+ *   node_hal_posix_reset(NODE_HAL_CLOCK_VIRTUAL);
+ *   sim_reset();
+ *   xTaskCreate(sensor_task, "sensor", 4096, NULL, 5, NULL);
+ *   sim_run_until(24LL * 3600 * 1000000);
+ */
+
+#ifndef SIM_H
+#define SIM_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "esp_err.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+
+#define SIM_MAX_TASKS           512             // Enough for a 200-node mesh (zb_sim.h)
+#define SIM_MAX_TIMERS          32
+#define SIM_TASK_MIN_STACK      (64 * 1024)     // Host stack per task, bytes
+#define SIM_LIVELOCK_SWITCHES   100000          // Switches without time moving
+
+typedef struct {
+    uint32_t tasks;                 // Live tasks
+    uint64_t context_switches;      // Scheduler -> task resumptions
+    uint64_t timer_callbacks;       // esp_timer callbacks fired
+    uint64_t time_jumps;            // Clock advances while all tasks blocked
+} sim_stats_t;
+
+/**
+ * Drop every task and timer and clear the counters. Does not touch the
+ * clock (node_hal_posix_reset() owns it). Call from outside the simulation.
+ */
+void sim_reset(void);
+
+/**
+ * Run the scheduler until the clock passes end_us or nothing is left to
+ * happen. Everything due at exactly end_us runs.
+ *
+ * @return ESP_OK, ESP_ERR_INVALID_STATE if called from a task, or
+ *         ESP_ERR_TIMEOUT if tasks keep yielding without time moving
+ */
+esp_err_t sim_run_until(int64_t end_us);
+
+/**
+ * sim_run_until(now + duration_us)
+ */
+esp_err_t sim_run_for(int64_t duration_us);
+
+/**
+ * True while a simulated task is running (false in timer callbacks and in
+ * the runner itself)
+ */
+bool sim_in_task(void);
+
+void sim_get_stats(sim_stats_t *stats);
+
+/**
+ * Peak stack use of a task in bytes of host stack (NULL: the current task).
+ * uxTaskGetStackHighWaterMark() reports the same against the requested
+ * depth, which host frames often exceed.
+ */
+size_t sim_task_stack_used(TaskHandle_t task);
+
+#endif // SIM_H
@@ -0,0 +1,568 @@
+/*
+ * Cultivio AquaSense - Pump Control Property Tests
+ * Host build only (links pump_control.c and the POSIX HAL)
+ *
+ * Random event sequences (sensor reports, dropouts, long gaps, manual
+ * commands, config changes, clocks starting near the 24.8 and 49.7 day
+ * wraps of 32-bit millisecond counters) are driven through pump_control,
+ * with safety invariants checked after every event and every control pass.
+ * A failing sequence is shrunk to a minimal reproduction and printed.
+ *
+ * Run: ctest --test-dir build-host -R property_tests
+ *      test_props [--runs N] [--seed N] [--events N]
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "../test_native/mocks/test_assert.h"
+
+#include "esp_log.h"
+#include "config_derived.h"
+#include "pump_control.h"
+#include "node_hal_posix.h"
+
+#define MS  1000LL
+#define SEC 1000000LL
+#define MIN (60 * SEC)
+
+#define DEFAULT_RUNS        1000000
+#define DEFAULT_MAX_EVENTS  48
+#define MAX_EVENTS          256
+#define SHRINK_MAX_TRIES    20000
+
+/* ============================================================================
+ * EVENTS
+ * ============================================================================ */
+
+typedef enum {
+    EV_REPORT,              // a = level %
+    EV_PASS,                // a = ms to advance first, then one control pass
+    EV_DROPOUT,             // Like PASS, across the sensor timeout
+    EV_GAP,                 // Like PASS, minutes to hours (control task starved)
+    EV_MANUAL_START,        // a = minutes
+    EV_MANUAL_STOP,
+    EV_CONFIG,              // a = ON %, b = OFF %, c = timeout minutes
+    EV_TYPE_COUNT,
+} event_type_t;
+
+static const char *s_event_names[] = {
+    "report", "pass", "dropout", "gap", "manual_start", "manual_stop", "config",
+};
+
+typedef struct {
+    uint8_t  type;
+    uint32_t a;
+    uint32_t b;
+    uint32_t c;
+} event_t;
+
+typedef struct {
+    int64_t start_us;
+    int     count;
+    event_t events[MAX_EVENTS];
+} sequence_t;
+
+static uint64_t s_rng;
+
+static uint64_t rng_next(void) {
+    // xorshift64*
+    s_rng ^= s_rng >> 12;
+    s_rng ^= s_rng << 25;
+    s_rng ^= s_rng >> 27;
+    return s_rng * 0x2545F4914F6CDD1DULL;
+}
+
+static uint32_t rng_below(uint32_t n) {
+    return (uint32_t)(rng_next() % n);
+}
+
+static int64_t pick_start_us(void) {
+    switch (rng_below(4)) {
+        case 0:  return (1 + rng_below(60000)) * MS;                            // Boot
+        case 1:  return (int64_t)(1ULL << 31) * MS - rng_below(600000) * MS;    // int32 ms wrap
+        case 2:  return (int64_t)(1ULL << 32) * MS - rng_below(600000) * MS;    // uint32 ms wrap
+        default: return (int64_t)rng_below(365 * 24 * 3600) * SEC + 1;
+    }
+}
+
+static uint8_t pick_level(void) {
+    switch (rng_below(8)) {
+        case 0:  return (uint8_t)rng_below(256);           // Out-of-range attribute
+        case 1:  return 0;
+        case 2:  return 100;
+        default: return (uint8_t)rng_below(101);
+    }
+}
+
+static void generate(sequence_t *seq, int max_events) {
+    seq->start_us = pick_start_us();
+    seq->count = 1 + (int)rng_below((uint32_t)max_events);
+
+    for (int i = 0; i < seq->count; i++) {
+        event_t *ev = &seq->events[i];
+        memset(ev, 0, sizeof(*ev));
+
+        uint32_t r = rng_below(100);
+        if (r < 30) {
+            ev->type = EV_REPORT;
+            ev->a = pick_level();
+        } else if (r < 70) {
+            ev->type = EV_PASS;
+            ev->a = rng_below(4) == 0 ? 0 : 1 + rng_below(5000);
+        } else if (r < 78) {
+            ev->type = EV_DROPOUT;
+            ev->a = 25000 + rng_below(15000);
+        } else if (r < 84) {
+            ev->type = EV_GAP;
+            ev->a = 1 + rng_below(240);
+        } else if (r < 90) {
+            static const uint16_t durations[] = { 15, 30, 45, 60 };
+            ev->type = EV_MANUAL_START;
+            ev->a = rng_below(2) ? durations[rng_below(4)] : rng_below(65536);
+        } else if (r < 95) {
+            ev->type = EV_MANUAL_STOP;
+        } else {
+            ev->type = EV_CONFIG;
+            ev->a = rng_below(256);
+            ev->b = rng_below(256);
+            ev->c = rng_below(4) == 0 ? rng_below(65536) : rng_below(180);
+        }
+    }
+}
+
+/* ============================================================================
+ * PROPERTIES
+ * ============================================================================ */
+
+typedef enum {
+    PROP_OK = 0,
+    PROP_RELAY_MIRRORS_STATE,       // Relay and Zigbee state attribute follow running
+    PROP_OFF_WHEN_SENSOR_OFFLINE,   // Auto mode, no report for 30 s -> off
+    PROP_AUTO_RUN_WITHIN_TIMEOUT,   // Auto run never outlives the pass that sees the timeout
+    PROP_MANUAL_EXPIRY_STOPS,       // Pass at or after manual end -> off, override cleared
+    PROP_SAFETY_LIMIT,              // No run, auto or manual, beyond the 2 hour limit
+    PROP_HYSTERESIS,                // Online, not timed out: ON/OFF band obeyed
+    PROP_RUNTIME_ACCOUNTING,        // Reported runtime matches relay-on time
+    PROP_COUNT,
+} property_t;
+
+static const char *s_property_names[] = {
+    "ok",
+    "relay and state attribute mirror pump state",
+    "pump never on while the sensor is offline in auto mode",
+    "auto run never exceeds the pump timeout",
+    "manual expiry always stops the pump",
+    "no run exceeds the 2 hour safety limit",
+    "hysteresis band obeyed while online",
+    "runtime accounting matches relay-on time",
+};
+
+// Run limit for PROP_SAFETY_LIMIT; lowered by the shrinker test to plant a failure
+static int64_t s_run_limit_us = (int64_t)CONFIG_MAX_PUMP_TIMEOUT_SEC * SEC;
+
+// What the harness knows independently of pump_control's own state
+typedef struct {
+    pump_control_t   pc;
+    config_derived_t dc;
+    bool     reported;
+    int64_t  report_us;
+    bool     relay;
+    int64_t  relay_on_us;           // Current run start as seen at the relay
+    int64_t  manual_cmd_us;         // Last accepted manual start
+    uint64_t on_total_us;           // Finished runs
+} model_t;
+
+static bool relay_is_on(void) {
+    node_hal_posix_stats_t hal;
+    node_hal_posix_get_stats(&hal);
+    return hal.relay_on;
+}
+
+// Follow the relay, then check what must hold after any event
+static property_t observe(model_t *m) {
+    int64_t now = node_hal_time_us();
+    bool relay = relay_is_on();
+
+    if (relay && !m->relay) {
+        m->relay_on_us = now;
+    } else if (!relay && m->relay) {
+        m->on_total_us += (uint64_t)(now - m->relay_on_us);
+    }
+    m->relay = relay;
+
+    if (relay != m->pc.running || m->pc.state_attr != (m->pc.running ? 1 : 0)) {
+        return PROP_RELAY_MIRRORS_STATE;
+    }
+
+    uint64_t on_us = m->on_total_us + (relay ? (uint64_t)(now - m->relay_on_us) : 0);
+    if (pump_control_runtime_sec(&m->pc) != (uint32_t)(on_us / SEC)) {
+        return PROP_RUNTIME_ACCOUNTING;
+    }
+    return PROP_OK;
+}
+
+static property_t control_pass(model_t *m) {
+    int64_t now = node_hal_time_us();
+    bool manual_before = m->pc.manual_override;
+    int64_t manual_end = m->pc.manual_end_us;
+    bool was_running = m->relay;
+    bool online = m->reported && now - m->report_us < PUMP_CONTROL_SENSOR_TIMEOUT_US;
+    bool timed_out = was_running && now - m->relay_on_us >= m->dc.pump_timeout_us;
+
+    pump_control_step(&m->pc, &m->dc);
+
+    property_t p = observe(m);
+    if (p != PROP_OK) {
+        return p;
+    }
+
+    if (manual_before && now >= manual_end && (m->pc.running || m->pc.manual_override)) {
+        return PROP_MANUAL_EXPIRY_STOPS;
+    }
+
+    if (m->pc.running) {
+        int64_t run_start = m->relay_on_us > m->manual_cmd_us ? m->relay_on_us : m->manual_cmd_us;
+        if (now - run_start >= s_run_limit_us) {
+            return PROP_SAFETY_LIMIT;
+        }
+    }
+
+    if (!manual_before) {
+        if (!online && m->pc.running) {
+            return PROP_OFF_WHEN_SENSOR_OFFLINE;
+        }
+        if (m->pc.running && now - m->relay_on_us >= m->dc.pump_timeout_us) {
+            return PROP_AUTO_RUN_WITHIN_TIMEOUT;
+        }
+        if (online && !timed_out) {
+            uint8_t level = m->pc.water_level_pct;
+            if ((level <= m->dc.pump_on_pct && !m->pc.running) ||
+                (level >= m->dc.pump_off_pct && m->pc.running)) {
+                return PROP_HYSTERESIS;
+            }
+        }
+    }
+    return PROP_OK;
+}
+
+static void apply_config(model_t *m, uint8_t on, uint8_t off, uint16_t timeout_min) {
+    device_config_t cfg;
+    memset(&cfg, 0, sizeof(cfg));
+    cfg.pump_on_threshold = on;
+    cfg.pump_off_threshold = off;
+    cfg.pump_timeout_minutes = timeout_min;
+    config_derive(&cfg, &m->dc);
+}
+
+/**
+ * Replay a sequence from a fresh controller
+ *
+ * @param failed_at Index of the event that broke a property
+ * @return The broken property, PROP_OK if all held
+ */
+static property_t run_sequence(const sequence_t *seq, int *failed_at) {
+    static model_t m;
+    memset(&m, 0, sizeof(m));
+    node_hal_posix_reset(NODE_HAL_CLOCK_VIRTUAL);
+    node_hal_posix_advance_us(seq->start_us);
+    apply_config(&m, 20, 80, 60);
+    pump_control_init(&m.pc);
+
+    for (int i = 0; i < seq->count; i++) {
+        const event_t *ev = &seq->events[i];
+        property_t p = PROP_OK;
+
+        switch (ev->type) {
+            case EV_REPORT:
+                pump_control_sensor_update(&m.pc, (uint8_t)ev->a);
+                m.reported = true;
+                m.report_us = node_hal_time_us();
+                p = observe(&m);
+                break;
+            case EV_PASS:
+            case EV_DROPOUT:
+                node_hal_posix_advance_us((int64_t)ev->a * MS);
+                p = control_pass(&m);
+                break;
+            case EV_GAP:
+                node_hal_posix_advance_us((int64_t)ev->a * MIN);
+                p = control_pass(&m);
+                break;
+            case EV_MANUAL_START:
+            case EV_MANUAL_STOP: {
+                manual_pump_cmd_t cmd = {
+                    .command = ev->type == EV_MANUAL_START ? PUMP_CMD_START_TIMED : PUMP_CMD_STOP,
+                    .duration_minutes = (uint16_t)ev->a,
+                };
+                pump_control_manual(&m.pc, &cmd);
+                if (m.pc.manual_override) {
+                    m.manual_cmd_us = node_hal_time_us();
+                }
+                p = observe(&m);
+                break;
+            }
+            case EV_CONFIG:
+                apply_config(&m, (uint8_t)ev->a, (uint8_t)ev->b, (uint16_t)ev->c);
+                break;
+        }
+
+        if (p != PROP_OK) {
+            *failed_at = i;
+            return p;
+        }
+    }
+    return PROP_OK;
+}
+
+/* ============================================================================
+ * SHRINKING
+ * ============================================================================ */
+
+static int s_shrink_tries;
+
+static bool still_fails(const sequence_t *seq, property_t prop) {
+    int at;
+    s_shrink_tries++;
+    return run_sequence(seq, &at) == prop;
+}
+
+static bool try_remove(sequence_t *seq, int from, int n, property_t prop) {
+    static sequence_t cand;
+    cand.start_us = seq->start_us;
+    cand.count = seq->count - n;
+    memcpy(cand.events, seq->events, (size_t)from * sizeof(event_t));
+    memcpy(&cand.events[from], &seq->events[from + n], (size_t)(seq->count - from - n) * sizeof(event_t));
+    if (!still_fails(&cand, prop)) {
+        return false;
+    }
+    *seq = cand;
+    return true;
+}
+
+static bool try_event(sequence_t *seq, int i, event_t simpler, property_t prop) {
+    event_t orig = seq->events[i];
+    if (memcmp(&orig, &simpler, sizeof(orig)) == 0) {
+        return false;
+    }
+    seq->events[i] = simpler;
+    if (still_fails(seq, prop)) {
+        return true;
+    }
+    seq->events[i] = orig;
+    return false;
+}
+
+static bool simplify_event(sequence_t *seq, int i, property_t prop) {
+    event_t ev = seq->events[i];
+    event_t s = ev;
+
+    switch (ev.type) {
+        case EV_REPORT:
+        case EV_PASS:
+        case EV_DROPOUT:
+        case EV_GAP:
+        case EV_MANUAL_START:
+            // Round numbers first, then halve towards zero
+            if (ev.type == EV_REPORT) {
+                static const uint32_t levels[] = { 0, 50, 100 };
+                for (int k = 0; k < 3; k++) {
+                    s.a = levels[k];
+                    if (s.a < ev.a && try_event(seq, i, s, prop)) return true;
+                }
+            }
+            if (ev.type == EV_DROPOUT) {
+                s.a = (uint32_t)(PUMP_CONTROL_SENSOR_TIMEOUT_US / MS);
+                if (s.a < ev.a && try_event(seq, i, s, prop)) return true;
+            }
+            s.a = ev.a / 2;
+            if (try_event(seq, i, s, prop)) return true;
+            s.a = ev.a - 1;
+            if (ev.a > 0 && try_event(seq, i, s, prop)) return true;
+            break;
+        case EV_CONFIG: {
+            event_t defaults = { .type = EV_CONFIG, .a = 20, .b = 80, .c = 60 };
+            if (try_event(seq, i, defaults, prop)) return true;
+            break;
+        }
+        default:
+            break;
+    }
+    return false;
+}
+
+static void shrink(sequence_t *seq, property_t prop) {
+    int at;
+    run_sequence(seq, &at);
+    seq->count = at + 1;                // Nothing after the failure matters
+    s_shrink_tries = 0;
+
+    bool progress = true;
+    while (progress && s_shrink_tries < SHRINK_MAX_TRIES) {
+        progress = false;
+
+        for (int chunk = seq->count / 2; chunk >= 1; chunk /= 2) {
+            for (int i = 0; i + chunk <= seq->count; ) {
+                if (try_remove(seq, i, chunk, prop)) {
+                    progress = true;
+                } else {
+                    i++;
+                }
+            }
+        }
+
+        // Simplest start first; stop at the one already in use
+        static const int64_t starts[] = { 1 * SEC, (int64_t)(1ULL << 32) * MS - 60 * SEC };
+        int64_t orig = seq->start_us;
+        for (int k = 0; k < 2 && starts[k] != orig; k++) {
+            seq->start_us = starts[k];
+            if (still_fails(seq, prop)) {
+                progress = true;
+                break;
+            }
+            seq->start_us = orig;
+        }
+
+        for (int i = 0; i < seq->count; i++) {
+            while (simplify_event(seq, i, prop)) {
+                progress = true;
+            }
+        }
+    }
+}
+
+static void print_sequence(const sequence_t *seq) {
+    int64_t t = seq->start_us;
+    printf("    start at %lld ms\n", (long long)(t / MS));
+    for (int i = 0; i < seq->count; i++) {
+        const event_t *ev = &seq->events[i];
+        if (ev->type == EV_PASS || ev->type == EV_DROPOUT) {
+            t += (int64_t)ev->a * MS;
+        } else if (ev->type == EV_GAP) {
+            t += (int64_t)ev->a * MIN;
+        }
+        printf("    %2d  t=%-14lld %-12s", i, (long long)(t / MS), s_event_names[ev->type]);
+        switch (ev->type) {
+            case EV_REPORT:         printf(" level %lu%%", (unsigned long)ev->a); break;
+            case EV_PASS:
+            case EV_DROPOUT:        printf(" after %lu ms", (unsigned long)ev->a); break;
+            case EV_GAP:            printf(" after %lu min", (unsigned long)ev->a); break;
+            case EV_MANUAL_START:   printf(" %lu min", (unsigned long)ev->a); break;
+            case EV_CONFIG:
+                printf(" ON %lu%% OFF %lu%% timeout %lu min",
+                       (unsigned long)ev->a, (unsigned long)ev->b, (unsigned long)ev->c);
+                break;
+            default: break;
+        }
+        printf("\n");
+    }
+}
+
+/* ============================================================================
+ * TESTS
+ * ============================================================================ */
+
+static uint64_t s_seed = 1;
+static long s_runs = DEFAULT_RUNS;
+static int s_max_events = DEFAULT_MAX_EVENTS;
+
+void test_props_pump_invariants(void) {
+    static sequence_t seq;
+    uint64_t events = 0;
+    uint32_t hits[EV_TYPE_COUNT] = { 0 };
+    s_rng = s_seed ? s_seed : 1;
+
+    clock_t start = clock();
+    for (long run = 0; run < s_runs; run++) {
+        generate(&seq, s_max_events);
+        events += (uint64_t)seq.count;
+        for (int i = 0; i < seq.count; i++) {
+            hits[seq.events[i].type]++;
+        }
+
+        int at;
+        property_t prop = run_sequence(&seq, &at);
+        if (prop != PROP_OK) {
+            TEST_ASSERT_EQUAL(PROP_OK, prop);
+            printf("  Property violated after %ld runs: %s\n", run, s_property_names[prop]);
+            shrink(&seq, prop);
+            printf("  Minimal sequence (%d events, %d shrink runs):\n", seq.count, s_shrink_tries);
+            print_sequence(&seq);
+            return;
+        }
+    }
+    double secs = (double)(clock() - start) / CLOCKS_PER_SEC;
+
+    printf("%ld sequences, %llu events in %.2f s (%.1f M events/s) ... ",
+           s_runs, (unsigned long long)events, secs, secs > 0 ? events / secs / 1e6 : 0);
+    for (int t = 0; t < EV_TYPE_COUNT; t++) {
+        TEST_ASSERT_TRUE(hits[t] > 0);
+    }
+}
+
+// A planted failure (10 minute run limit) buried in noise must shrink to
+// the two events that cause it
+void test_props_shrinks_to_minimal(void) {
+    static sequence_t seq;
+    memset(&seq, 0, sizeof(seq));
+    seq.start_us = (int64_t)(1ULL << 32) * MS - 123456789;
+    seq.count = 60;
+    for (int i = 0; i < seq.count; i++) {
+        seq.events[i] = (event_t){ .type = EV_PASS, .a = 777 };
+    }
+    seq.events[5] = (event_t){ .type = EV_REPORT, .a = 90 };
+    seq.events[12] = (event_t){ .type = EV_CONFIG, .a = 33, .b = 90, .c = 120 };
+    seq.events[20] = (event_t){ .type = EV_MANUAL_START, .a = 45 };
+    seq.events[31] = (event_t){ .type = EV_REPORT, .a = 15 };
+    seq.events[40] = (event_t){ .type = EV_GAP, .a = 40 };
+
+    s_run_limit_us = 10 * MIN;
+    int at;
+    property_t prop = run_sequence(&seq, &at);
+    TEST_ASSERT_EQUAL(PROP_SAFETY_LIMIT, prop);
+
+    shrink(&seq, prop);
+    TEST_ASSERT_EQUAL(PROP_SAFETY_LIMIT, run_sequence(&seq, &at));
+    TEST_ASSERT_EQUAL(2, seq.count);
+    TEST_ASSERT_EQUAL(EV_MANUAL_START, seq.events[0].type);
+    TEST_ASSERT_EQUAL(EV_GAP, seq.events[1].type);
+    TEST_ASSERT_EQUAL(1 * SEC, seq.start_us);
+    s_run_limit_us = (int64_t)CONFIG_MAX_PUMP_TIMEOUT_SEC * SEC;
+}
+
+/* ============================================================================
+ * MAIN
+ * ============================================================================ */
+
+int main(int argc, char **argv) {
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--runs") == 0 && i + 1 < argc) {
+            s_runs = atol(argv[++i]);
+        } else if (strcmp(argv[i], "--seed") == 0 && i + 1 < argc) {
+            s_seed = strtoull(argv[++i], NULL, 0);
+        } else if (strcmp(argv[i], "--events") == 0 && i + 1 < argc) {
+            s_max_events = atoi(argv[++i]);
+        } else {
+            fprintf(stderr, "usage: %s [--runs N] [--seed N] [--events N]\n", argv[0]);
+            return 2;
+        }
+    }
+    if (s_max_events < 1 || s_max_events > MAX_EVENTS) {
+        fprintf(stderr, "--events must be 1..%d\n", MAX_EVENTS);
+        return 2;
+    }
+
+    esp_log_level_set("*", ESP_LOG_NONE);
+
+    printf("\n========================================\n");
+    printf("Cultivio AquaSense - Property Tests (seed %llu)\n", (unsigned long long)s_seed);
+    printf("========================================\n\n");
+
+    printf("Pump Control:\n");
+    RUN_TEST(test_props_pump_invariants);
+    RUN_TEST(test_props_shrinks_to_minimal);
+
+    TEST_SUMMARY();
+
+    return g_test_failures > 0 ? 1 : 0;
+}
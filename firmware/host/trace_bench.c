@@ -0,0 +1,204 @@
+/*
+ * Cultivio AquaSense - Trace Point Benchmark
+ * Cost of a binary trace point (shared/trace) against the ESP_LOGI line it
+ * replaces, on the host.
+ *
+ * Usage: trace_bench [--iterations N] [--lines FILE] [--check]
+ *
+ * Measured per event:
+ *   trace      TRACE(): claim a ring slot, timestamp, copy arguments
+ *   drain      the deferred half: drain + format (off the hot path)
+ *   snprintf   formatting the same line, no output
+ *   ESP_LOGI   the log line into /dev/null (host esp_log_write)
+ * plus the UART time the line costs on the device at 115200 baud, text
+ * versus AQTR: lines. --lines writes one drained batch as AQTR: lines for
+ * trace_decode; --check requires the trace point to beat ESP_LOGI.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "esp_log.h"
+#include "trace.h"
+#include "node_hal_posix.h"
+
+static const char *TAG = "BENCH";
+
+#define UART_BAUD       115200
+#define UART_BITS       10          // 8N1 bits per character
+#define SAMPLE_ADDR     0x1A2B
+
+static double now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+static double uart_us(size_t chars)
+{
+    return (double)chars * UART_BITS * 1e6 / UART_BAUD;
+}
+
+/* ============================================================================
+ * SINKS
+ * ============================================================================ */
+
+static volatile size_t s_formatted_chars;
+
+static void format_sink(const trace_event_t *ev, void *ctx)
+{
+    (void)ctx;
+    char text[TRACE_TEXT_MAX];
+    s_formatted_chars += (size_t)trace_format(ev, text, sizeof(text));
+}
+
+typedef struct {
+    FILE    *out;
+    uint8_t  data[TRACE_LINE_RECORDS * TRACE_REC_MAX_SIZE];
+    size_t   len;
+    int      records;
+    uint64_t events;
+} line_writer_t;
+
+static void line_flush(line_writer_t *w)
+{
+    char text[sizeof(TRACE_LINE_PREFIX) + 2 * sizeof(w->data)];
+    if (w->len > 0) {
+        trace_line_encode(w->data, w->len, text, sizeof(text));
+        fprintf(w->out, "%s\n", text);
+    }
+    w->len = 0;
+    w->records = 0;
+}
+
+static void line_sink(const trace_event_t *ev, void *ctx)
+{
+    line_writer_t *w = ctx;
+    w->len += trace_encode(ev, w->data + w->len);
+    w->events++;
+    if (++w->records == TRACE_LINE_RECORDS) {
+        line_flush(w);
+    }
+}
+
+/* ============================================================================
+ * MAIN
+ * ============================================================================ */
+
+int main(int argc, char **argv)
+{
+    long iterations = 1000000;
+    const char *lines_file = NULL;
+    bool check = false;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--iterations") == 0 && i + 1 < argc) {
+            iterations = atol(argv[++i]);
+        } else if (strcmp(argv[i], "--lines") == 0 && i + 1 < argc) {
+            lines_file = argv[++i];
+        } else if (strcmp(argv[i], "--check") == 0) {
+            check = true;
+        } else {
+            iterations = 0;
+            break;
+        }
+    }
+    if (iterations < TRACE_RING_SLOTS) {
+        fprintf(stderr, "usage: %s [--iterations N (>= %d)] [--lines FILE] [--check]\n",
+                argv[0], TRACE_RING_SLOTS);
+        return 2;
+    }
+
+    node_hal_posix_reset(NODE_HAL_CLOCK_VIRTUAL);
+    esp_log_level_set("*", ESP_LOG_INFO);
+    trace_reset();
+
+    // Hot path: trace points only (the ring overwrites, as with a slow drain)
+    double t0 = now_ns();
+    for (long i = 0; i < iterations; i++) {
+        TRACE(REPORT_RX, SAMPLE_ADDR, (int32_t)(i % 100));
+    }
+    double trace_ns = (now_ns() - t0) / iterations;
+
+    // Deferred half: drain + format, a ring at a time
+    long drained = 0;
+    t0 = now_ns();
+    for (long done = 0; done < iterations; done += TRACE_RING_SLOTS) {
+        trace_reset();
+        for (int i = 0; i < TRACE_RING_SLOTS; i++) {
+            TRACE(REPORT_RX, SAMPLE_ADDR, i % 100);
+        }
+        drained += (long)trace_drain(format_sink, NULL, TRACE_RING_SLOTS);
+    }
+    double drain_ns = (now_ns() - t0) / drained - trace_ns;
+
+    char text[TRACE_TEXT_MAX];
+    t0 = now_ns();
+    for (long i = 0; i < iterations; i++) {
+        s_formatted_chars += (size_t)snprintf(text, sizeof(text), "Report from 0x%04x - Water: %d%%",
+                                              SAMPLE_ADDR, (int)(i % 100));
+    }
+    double snprintf_ns = (now_ns() - t0) / iterations;
+
+    // ESP_LOGI into /dev/null: formatting plus the stdio write path
+    fflush(stderr);
+    int saved_stderr = dup(STDERR_FILENO);
+    int null_fd = open("/dev/null", O_WRONLY);
+    dup2(null_fd, STDERR_FILENO);
+    t0 = now_ns();
+    for (long i = 0; i < iterations; i++) {
+        ESP_LOGI(TAG, "Report from 0x%04x - Water: %d%%", SAMPLE_ADDR, (int)(i % 100));
+    }
+    fflush(stderr);
+    double log_ns = (now_ns() - t0) / iterations;
+    dup2(saved_stderr, STDERR_FILENO);
+    close(null_fd);
+    close(saved_stderr);
+
+    // Device UART: the log line versus the event's share of an AQTR: line
+    trace_event_t ev = { .id = TRACE_REPORT_RX, .nargs = 2, .arg = { SAMPLE_ADDR, 42 } };
+    uint8_t rec[TRACE_REC_MAX_SIZE];
+    size_t rec_len = trace_encode(&ev, rec);
+    size_t log_chars = strlen("I (123456) REPORT: ") + (size_t)trace_format(&ev, text, sizeof(text)) + 2;
+    double line_chars = 2.0 * rec_len + (sizeof(TRACE_LINE_PREFIX) + 1.0) / TRACE_LINE_RECORDS;
+
+    printf("Iterations:     %ld\n", iterations);
+    printf("TRACE():        %8.1f ns/event (hot path)\n", trace_ns);
+    printf("Drain+format:   %8.1f ns/event (low-priority task)\n", drain_ns);
+    printf("snprintf:       %8.1f ns/event\n", snprintf_ns);
+    printf("ESP_LOGI:       %8.1f ns/event (to /dev/null)\n", log_ns);
+    printf("Speedup:        %8.1fx on the hot path\n", log_ns / trace_ns);
+    printf("UART @%d:   %8.0f us/line as text (%zu chars), %.0f us/event as AQTR: lines\n",
+           UART_BAUD, uart_us(log_chars), log_chars, uart_us((size_t)(line_chars + 0.5)));
+
+    bool ok = true;
+    if (lines_file != NULL) {
+        line_writer_t w = { .out = fopen(lines_file, "w") };
+        if (w.out == NULL) {
+            fprintf(stderr, "cannot write %s\n", lines_file);
+            return 2;
+        }
+        // One lapped ring: the decoder sees a DROPPED event, then the rest
+        trace_reset();
+        for (int i = 0; i < TRACE_RING_SLOTS + 8; i++) {
+            TRACE(REPORT_RX, SAMPLE_ADDR, i % 100);
+        }
+        trace_drain(line_sink, &w, TRACE_RING_SLOTS);
+        line_flush(&w);
+        fclose(w.out);
+        printf("Lines:          %llu events to %s\n", (unsigned long long)w.events, lines_file);
+        ok = w.events == TRACE_RING_SLOTS + 1;
+    }
+
+    if (check) {
+        ok = ok && trace_ns < log_ns;
+        printf("Check:          %s\n", ok ? "PASS" : "FAIL");
+        return ok ? 0 : 1;
+    }
+    return 0;
+}
@@ -0,0 +1,150 @@
+/*
+ * Cultivio AquaSense - Trace Decoder
+ * Turns the binary event trace (shared/trace) printed by the drain task in
+ * TRACE_OUTPUT_LINES mode back into the log lines the trace points replace.
+ *
+ * Usage: trace_decode FILE [--all] [--chrome JSON] [--check]
+ *
+ * FILE is a serial log ("-" for stdin); "AQTR:" lines are decoded, other
+ * lines are dropped, or passed through in order with --all. Each log event
+ * is printed as "I (ms) TAG: text", timestamps unwrapped from the 32-bit us
+ * clock; spans and markers only go to the --chrome export (trace_export.h),
+ * which opens in ui.perfetto.dev. --check fails on malformed records,
+ * unknown ids or an empty trace.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "trace.h"
+#include "trace_export.h"
+
+#define LINE_MAX_CHARS  1024
+
+typedef struct {
+    uint64_t events;
+    uint64_t dropped;           // Sum of DROPPED arguments
+    uint64_t malformed;         // Lines with a partial record
+    uint64_t unknown;           // Ids newer than this decoder
+    int64_t  t_us;              // Unwrapped time of the last event
+    uint32_t last_raw;
+    trace_export_t *chrome;     // NULL without --chrome
+} decode_state_t;
+
+static void print_event(decode_state_t *st, const trace_event_t *ev)
+{
+    // Events arrive in order, less than one wrap (~71 min) apart
+    st->t_us += st->events == 0 ? ev->t_us : (uint32_t)(ev->t_us - st->last_raw);
+    st->last_raw = ev->t_us;
+    st->events++;
+
+    if (ev->id >= TRACE_EVENT_COUNT) {
+        st->unknown++;
+    } else if (ev->id == TRACE_DROPPED) {
+        st->dropped += (uint32_t)ev->arg[0];
+    }
+    if (st->chrome != NULL) {
+        trace_export_event(ev, st->chrome);
+    }
+    if (trace_event_kind(ev->id) != TRACE_KIND_LOG) {
+        return;
+    }
+    char text[TRACE_TEXT_MAX];
+    trace_format(ev, text, sizeof(text));
+    printf("I (%lld) %s: %s\n", (long long)(st->t_us / 1000), trace_event_tag(ev->id), text);
+}
+
+static void decode_line(decode_state_t *st, const char *line, bool pass_through)
+{
+    uint8_t data[LINE_MAX_CHARS / 2];
+    int len = trace_line_decode(line, data, sizeof(data));
+    if (len < 0) {
+        if (pass_through) {
+            printf("%s\n", line);
+        }
+        return;
+    }
+
+    size_t pos = 0;
+    trace_event_t ev;
+    while (pos < (size_t)len) {
+        size_t n = trace_decode(data + pos, (size_t)len - pos, &ev);
+        if (n == 0) {
+            st->malformed++;
+            break;
+        }
+        print_event(st, &ev);
+        pos += n;
+    }
+}
+
+int main(int argc, char **argv)
+{
+    const char *path = NULL;
+    const char *chrome_path = NULL;
+    bool all = false;
+    bool check = false;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--all") == 0) {
+            all = true;
+        } else if (strcmp(argv[i], "--check") == 0) {
+            check = true;
+        } else if (strcmp(argv[i], "--chrome") == 0 && i + 1 < argc) {
+            chrome_path = argv[++i];
+        } else if ((argv[i][0] != '-' || strcmp(argv[i], "-") == 0) && path == NULL) {
+            path = argv[i];
+        } else {
+            path = NULL;
+            break;
+        }
+    }
+    if (path == NULL) {
+        fprintf(stderr, "usage: %s FILE [--all] [--chrome JSON] [--check]\n", argv[0]);
+        return 2;
+    }
+
+    FILE *f = strcmp(path, "-") == 0 ? stdin : fopen(path, "r");
+    if (f == NULL) {
+        fprintf(stderr, "cannot read %s\n", path);
+        return 2;
+    }
+
+    decode_state_t st = { 0 };
+    trace_export_t chrome;
+    if (chrome_path != NULL) {
+        if (trace_export_open(&chrome, chrome_path) != ESP_OK) {
+            fprintf(stderr, "cannot write %s\n", chrome_path);
+            return 2;
+        }
+        st.chrome = &chrome;
+    }
+    char line[LINE_MAX_CHARS];
+    while (fgets(line, sizeof(line), f) != NULL) {
+        line[strcspn(line, "\r\n")] = '\0';
+        decode_line(&st, line, all);
+    }
+    if (f != stdin) {
+        fclose(f);
+    }
+
+    fprintf(stderr, "%llu events, last at %.1f s, %llu lost on the device, "
+            "%llu malformed lines, %llu unknown ids\n",
+            (unsigned long long)st.events, st.t_us / 1e6, (unsigned long long)st.dropped,
+            (unsigned long long)st.malformed, (unsigned long long)st.unknown);
+
+    bool exported = true;
+    if (st.chrome != NULL) {
+        exported = trace_export_close(&chrome) == ESP_OK;
+        fprintf(stderr, "Chrome trace: %s, %llu report->relay spans%s\n", chrome_path,
+                (unsigned long long)chrome.stats.latency_spans, exported ? "" : " (write failed)");
+    }
+
+    if (check) {
+        bool ok = st.events > 0 && st.malformed == 0 && st.unknown == 0 && exported;
+        fprintf(stderr, "Check: %s\n", ok ? "PASS" : "FAIL");
+        return ok ? 0 : 1;
+    }
+    return exported ? 0 : 1;
+}
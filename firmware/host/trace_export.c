@@ -0,0 +1,207 @@
+/*
+ * Trace Export - Chrome JSON writer
+ */
+
+#include "trace_export.h"
+
+#include <string.h>
+
+#define EXPORT_PID      1
+#define LATENCY_CAT     "LATENCY"
+
+/* ============================================================================
+ * JSON
+ * ============================================================================ */
+
+static void put_string(FILE *f, const char *s)
+{
+    fputc('"', f);
+    for (; *s != '\0'; s++) {
+        unsigned char c = (unsigned char)*s;
+        if (c == '"' || c == '\\') {
+            fprintf(f, "\\%c", c);
+        } else if (c < 0x20) {
+            fprintf(f, "\\u%04x", c);
+        } else {
+            fputc(c, f);
+        }
+    }
+    fputc('"', f);
+}
+
+// Opens an event object: the caller adds its fields and the closing brace
+static void begin_event(trace_export_t *x, const char *ph, const char *name, const char *cat,
+                        int64_t ts_us, unsigned tid)
+{
+    fputs(x->first ? "\n" : ",\n", x->f);
+    x->first = false;
+    fprintf(x->f, "{\"ph\":\"%s\",\"name\":", ph);
+    put_string(x->f, name);
+    if (cat != NULL) {
+        fputs(",\"cat\":", x->f);
+        put_string(x->f, cat);
+    }
+    fprintf(x->f, ",\"ts\":%lld,\"pid\":%d,\"tid\":%u", (long long)ts_us, EXPORT_PID, tid);
+}
+
+static void name_track(trace_export_t *x, unsigned tid, const char *name)
+{
+    x->named[tid / 32] |= 1u << (tid % 32);
+    begin_event(x, "M", "thread_name", NULL, 0, tid);
+    fputs(",\"args\":{\"name\":", x->f);
+    put_string(x->f, name);
+    fputs("}}", x->f);
+}
+
+static void counter(trace_export_t *x, const char *name, const char *series, long value)
+{
+    begin_event(x, "C", name, NULL, x->t_us, 0);
+    fprintf(x->f, ",\"args\":{\"%s\":%ld}}", series, value);
+}
+
+/* ============================================================================
+ * REPORT -> RELAY LATENCY
+ * ============================================================================ */
+
+static void track_latency(trace_export_t *x, const trace_event_t *ev)
+{
+    switch (ev->id) {
+    case TRACE_REPORT_RX:
+        x->report_seen = true;
+        x->report_us = x->t_us;
+        x->report_src = ev->arg[0];
+        x->report_pct = ev->arg[1];
+        break;
+    case TRACE_LEVEL_WRITE:             // Same data, written instead of reported
+        x->report_seen = true;
+        x->report_us = x->t_us;
+        x->report_src = -1;
+        x->report_pct = ev->arg[0];
+        break;
+    case TRACE_WATER_LOW:
+    case TRACE_WATER_HIGH:
+        x->decision = x->report_seen;
+        break;
+    case TRACE_PUMP_ON:
+    case TRACE_PUMP_OFF: {
+        if (!x->decision) {
+            break;          // Manual command, timeout or sensor loss
+        }
+        x->decision = false;
+        int64_t latency_us = x->t_us - x->report_us;
+        unsigned long long id = ++x->stats.latency_spans;
+        x->stats.latency_sum_us += latency_us;
+        if (latency_us > x->stats.latency_max_us) {
+            x->stats.latency_max_us = latency_us;
+        }
+        // Retroactive begin: viewers sort by timestamp
+        begin_event(x, "b", "report_to_relay", LATENCY_CAT, x->report_us, ev->task);
+        fprintf(x->f, ",\"id\":%llu,\"args\":{\"src\":%ld,\"level_pct\":%ld}}",
+                id, (long)x->report_src, (long)x->report_pct);
+        begin_event(x, "e", "report_to_relay", LATENCY_CAT, x->t_us, ev->task);
+        fprintf(x->f, ",\"id\":%llu,\"args\":{\"latency_ms\":%.3f,\"relay\":%d}}",
+                id, latency_us / 1000.0, ev->id == TRACE_PUMP_ON);
+        break;
+    }
+    default:
+        break;
+    }
+}
+
+/* ============================================================================
+ * EXPORT
+ * ============================================================================ */
+
+esp_err_t trace_export_open(trace_export_t *x, const char *path)
+{
+    memset(x, 0, sizeof(*x));
+    x->f = fopen(path, "w");
+    if (x->f == NULL) {
+        return ESP_FAIL;
+    }
+    x->first = true;
+    fputs("{\"displayTimeUnit\":\"ms\",\"traceEvents\":[", x->f);
+    begin_event(x, "M", "process_name", NULL, 0, 0);
+    fputs(",\"args\":{\"name\":\"AquaSense\"}}", x->f);
+    name_track(x, 0, "timers/isr");
+    return ESP_OK;
+}
+
+void trace_export_event(const trace_event_t *ev, void *ctx)
+{
+    trace_export_t *x = ctx;
+    x->t_us += x->stats.events == 0 ? ev->t_us : (uint32_t)(ev->t_us - x->last_raw);
+    x->last_raw = ev->t_us;
+    x->stats.events++;
+
+    if (ev->id == TRACE_TASK_NAME) {
+        char name[TRACE_TASK_NAME_LEN + 1];
+        trace_task_name(ev, name);
+        name_track(x, (uint8_t)ev->arg[0], name);
+        return;
+    }
+    if (!(x->named[ev->task / 32] & (1u << (ev->task % 32)))) {
+        char name[16];
+        snprintf(name, sizeof(name), "task %u", ev->task);
+        name_track(x, ev->task, name);
+    }
+
+    char text[TRACE_TEXT_MAX];
+    trace_format(ev, text, sizeof(text));
+    trace_kind_t kind = trace_event_kind(ev->id);
+    // An _END event closes the event declared right before it
+    uint8_t span = kind == TRACE_KIND_END || kind == TRACE_KIND_ASYNC_END ? ev->id - 1 : ev->id;
+    const char *name = trace_event_name(span);
+    const char *cat = trace_event_tag(span);
+
+    switch (kind) {
+    case TRACE_KIND_BEGIN:
+    case TRACE_KIND_END:
+        begin_event(x, kind == TRACE_KIND_BEGIN ? "B" : "E", name, cat, x->t_us, ev->task);
+        break;
+    case TRACE_KIND_ASYNC_BEGIN:
+    case TRACE_KIND_ASYNC_END:
+        begin_event(x, kind == TRACE_KIND_ASYNC_BEGIN ? "b" : "e", name, cat, x->t_us, ev->task);
+        fprintf(x->f, ",\"id\":%lu", (unsigned long)(uint32_t)ev->arg[0]);
+        break;
+    default:
+        begin_event(x, "i", name, cat, x->t_us, ev->task);
+        // Lost events concern the whole trace, not one task
+        fprintf(x->f, ",\"s\":\"%s\"", ev->id == TRACE_DROPPED ? "g" : "t");
+        break;
+    }
+    fputs(",\"args\":{\"text\":", x->f);
+    put_string(x->f, text);
+    fputs("}}", x->f);
+
+    switch (ev->id) {
+    case TRACE_DROPPED:
+        x->stats.dropped += (uint32_t)ev->arg[0];
+        break;
+    case TRACE_WATER_LEVEL:
+        counter(x, "measured_level", "pct", ev->arg[0]);
+        break;
+    case TRACE_REPORT_RX:
+        counter(x, "reported_level", "pct", ev->arg[1]);
+        break;
+    case TRACE_PUMP_ON:
+    case TRACE_PUMP_OFF:
+        counter(x, "relay", "on", ev->id == TRACE_PUMP_ON);
+        break;
+    default:
+        break;
+    }
+    track_latency(x, ev);
+}
+
+esp_err_t trace_export_close(trace_export_t *x)
+{
+    if (x->f == NULL) {
+        return ESP_FAIL;
+    }
+    fputs("\n]}\n", x->f);
+    bool ok = !ferror(x->f);
+    ok = fclose(x->f) == 0 && ok;
+    x->f = NULL;
+    return ok ? ESP_OK : ESP_FAIL;
+}
@@ -0,0 +1,70 @@
+/*
+ * Trace Export - event trace to Chrome JSON (chrome://tracing, Perfetto)
+ *
+ * Turns a drained or decoded event trace (shared/trace) into the Chrome
+ * trace event format, which ui.perfetto.dev and chrome://tracing open
+ * directly:
+ *
+ *   - one track per FreeRTOS task (TASK_NAME events name them; events from
+ *     outside a task go to "timers/isr")
+ *   - LOG and INSTANT events as instants, BEGIN/END as slices on the task,
+ *     ASYNC spans (measurement cycles) as async slices
+ *   - counters for the reported and measured water level and the relay
+ *   - a derived "report_to_relay" async span for every relay switch made
+ *     by the automatic thresholds: from the last REPORT_RX (or LEVEL_WRITE)
+ *     before the WATER_LOW / WATER_HIGH decision to the PUMP_ON / PUMP_OFF
+ *
+ * Timestamps are unwrapped from the 32-bit us clock the way trace_decode
+ * does: events in order, less than one wrap apart.
+ */
+
+#ifndef TRACE_EXPORT_H
+#define TRACE_EXPORT_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include "esp_err.h"
+#include "trace.h"
+
+typedef struct {
+    uint64_t events;            // Trace events exported
+    uint64_t dropped;           // Sum of DROPPED arguments
+    uint64_t latency_spans;     // report_to_relay spans
+    int64_t  latency_max_us;
+    int64_t  latency_sum_us;
+} trace_export_stats_t;
+
+typedef struct {
+    FILE    *f;
+    bool     first;             // No event written yet (no comma)
+    int64_t  t_us;              // Unwrapped time of the last event
+    uint32_t last_raw;
+    uint32_t named[256 / 32];   // Tracks with a thread_name
+    // report_to_relay: last report, and whether a threshold decision used it
+    bool     report_seen;
+    bool     decision;
+    int64_t  report_us;
+    int32_t  report_src;
+    int32_t  report_pct;
+    trace_export_stats_t stats;
+} trace_export_t;
+
+/**
+ * Create the JSON file and write its header
+ * @return ESP_OK, ESP_FAIL if the file cannot be created
+ */
+esp_err_t trace_export_open(trace_export_t *x, const char *path);
+
+/**
+ * Export one event (a trace_sink_fn_t: pass the exporter as ctx)
+ */
+void trace_export_event(const trace_event_t *ev, void *ctx);
+
+/**
+ * Terminate the JSON and close the file
+ * @return ESP_OK, ESP_FAIL if any write failed
+ */
+esp_err_t trace_export_close(trace_export_t *x);
+
+#endif // TRACE_EXPORT_H
@@ -0,0 +1,1207 @@
+/*
+ * Zigbee Mesh Simulator - esp_zigbee_core.h on the discrete-event
+ * simulator (firmware/host)
+ *
+ * See zb_sim.h for the model. Everything that happens "in the air" (frame
+ * hops, commissioning, scheduler alarms) is an item on one time-ordered bus
+ * heap driven by a single esp_timer; what a node's stack task must see
+ * (signals, received reports, send status, alarms) is posted to that node's
+ * event queue and dispatched by esp_zb_stack_main_loop() under its lock.
+ */
+
+#include "zb_sim.h"
+#include "sim.h"
+#include "esp_zigbee_core.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/queue.h"
+#include "freertos/semphr.h"
+#include "esp_timer.h"
+#include "esp_log.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+static const char *TAG = "ZB_SIM";
+
+#define ZB_SIM_MAX_ATTRS        16      // Registered attributes per node
+#define ZB_SIM_SHORT_BASE       0x1000  // Short address of node i is base + i
+#define ZB_SIM_ATTR_VALUE_MAX   16      // Octet strings longer than this are truncated
+#define ZB_SIM_LQI_RSSI_MIN     (-100)  // RSSI that maps to LQI 0
+#define ZB_SIM_LQI_RSSI_MAX     (-30)   // ... and to LQI 255
+#define NO_NODE                 (-1)
+
+/* ============================================================================
+ * OBJECTS
+ * ============================================================================ */
+
+typedef struct {
+    uint8_t  endpoint;
+    uint8_t  role;
+    uint16_t cluster;
+    uint16_t id;
+    uint8_t  type;
+    uint8_t  value[ZB_SIM_ATTR_VALUE_MAX];
+} zb_attr_t;
+
+// A report in flight
+typedef struct {
+    int16_t  src;
+    int16_t  dst;
+    int16_t  at;                // Node currently holding the frame
+    uint8_t  tsn;
+    uint8_t  hops;
+    uint8_t  src_endpoint;
+    uint8_t  dst_endpoint;
+    uint16_t cluster;
+    uint16_t attr_id;
+    uint8_t  type;
+    uint8_t  value[ZB_SIM_ATTR_VALUE_MAX];
+    int8_t   rssi;              // Last hop, as received
+    int64_t  sent_us;
+} zb_frame_t;
+
+typedef enum {
+    ZB_EV_SIGNAL,
+    ZB_EV_ALARM,
+    ZB_EV_REPORT,
+    ZB_EV_SEND_STATUS,
+} zb_event_kind_t;
+
+// What a node's stack task dispatches
+typedef struct {
+    zb_event_kind_t kind;
+    esp_err_t status;
+    union {
+        struct {
+            uint32_t type;
+            esp_zb_zdo_signal_device_annce_params_t annce;
+        } signal;
+        struct {
+            esp_zb_callback_t cb;
+            uint8_t param;
+        } alarm;
+        zb_frame_t frame;
+    };
+} zb_event_t;
+
+typedef enum {
+    BUS_HOP,                    // Frame leaves frame.at
+    BUS_POST,                   // Event reaches a node's queue
+    BUS_FORMED,
+    BUS_STEERED,
+} bus_kind_t;
+
+typedef struct {
+    int64_t    at_us;
+    uint64_t   seq;             // Insertion order breaks ties
+    bus_kind_t kind;
+    int16_t    node;
+    zb_event_t ev;              // BUS_HOP: ev.frame
+} bus_item_t;
+
+struct esp_zb_attribute_list_s {
+    uint16_t  cluster;
+    int       count;
+    zb_attr_t attrs[ZB_SIM_MAX_ATTRS];
+};
+
+struct esp_zb_cluster_list_s {
+    int count;
+    esp_zb_attribute_list_t *clusters[ZB_SIM_MAX_ATTRS];
+    uint8_t roles[ZB_SIM_MAX_ATTRS];
+};
+
+struct esp_zb_ep_list_s {
+    int count;
+    esp_zb_cluster_list_t *lists[4];
+    uint8_t endpoints[4];
+};
+
+typedef struct {
+    esp_zb_nwk_device_type_t role;
+    bool     initialised;       // esp_zb_init() called
+    bool     joined;
+    bool     commissioning;     // Formation / steering in progress
+    int16_t  parent;
+    int16_t  depth;
+    int64_t  joined_us;
+    uint8_t  tsn;
+    uint32_t links[ZB_SIM_MAX_NODES / 32];
+    QueueHandle_t queue;
+    SemaphoreHandle_t lock;
+    zb_attr_t attrs[ZB_SIM_MAX_ATTRS];
+    int      attr_count;
+    esp_zb_core_action_callback_t action_cb;
+    esp_zb_zcl_command_send_status_callback_t send_status_cb;
+    esp_zb_aps_data_indication_callback_t aps_ind_cb;
+
+    // RSSI of the last frame heard from each linked node: the neighbour table
+    int8_t   heard_rssi[ZB_SIM_MAX_NODES];
+
+    // Next hop from every node towards this one, rebuilt when the mesh changes
+    int16_t *routes;
+    uint32_t routes_gen;
+} zb_node_t;
+
+static zb_sim_config_t s_cfg;
+static zb_node_t s_nodes[ZB_SIM_MAX_NODES];
+static int s_node_count;
+static int s_coordinator = NO_NODE;
+static uint32_t s_mesh_gen = 1;         // Bumped on every join or link
+static uint32_t s_rng;
+static uint32_t s_rssi_rng;             // Own sequence: RSSI noise leaves loss and jitter as they were
+static zb_sim_stats_t s_stats;
+
+static bus_item_t *s_bus;
+static size_t s_bus_len;
+static size_t s_bus_cap;
+static uint64_t s_bus_seq;
+static esp_timer_handle_t s_bus_timer;
+static int64_t s_bus_armed_us = INT64_MAX;
+static bool s_bus_draining;             // In the timer callback: it re-arms on the way out
+
+/* ============================================================================
+ * HELPERS
+ * ============================================================================ */
+
+static uint32_t rng_next(void)
+{
+    // xorshift32: cheap, and the same sequence on every host
+    s_rng ^= s_rng << 13;
+    s_rng ^= s_rng >> 17;
+    s_rng ^= s_rng << 5;
+    return s_rng;
+}
+
+static uint32_t rssi_rng_next(void)
+{
+    s_rssi_rng ^= s_rssi_rng << 13;
+    s_rssi_rng ^= s_rssi_rng >> 17;
+    s_rssi_rng ^= s_rssi_rng << 5;
+    return s_rssi_rng;
+}
+
+static zb_node_t *current(void)
+{
+    int idx = zb_sim_current_node();
+    return idx >= 0 ? &s_nodes[idx] : NULL;
+}
+
+static bool linked(int a, int b)
+{
+    return (s_nodes[a].links[b / 32] >> (b % 32)) & 1U;
+}
+
+static bool routes_frames(int idx)
+{
+    const zb_node_t *n = &s_nodes[idx];
+    return n->joined && n->role != ESP_ZB_DEVICE_TYPE_ED;
+}
+
+// Fixed per link and seed, the same whichever end asks
+static int link_mean_rssi(int a, int b)
+{
+    uint32_t h = s_cfg.seed * 0x9E3779B1U ^ ((uint32_t)(a < b ? a : b) << 16 | (uint32_t)(a < b ? b : a));
+    h ^= h >> 15;
+    h *= 0x2C1B3C6DU;
+    h ^= h >> 12;
+    h *= 0x297A2D39U;
+    h ^= h >> 15;
+    return s_cfg.link_rssi_dbm - (int)(h % (s_cfg.link_rssi_spread_db + 1U));
+}
+
+// One frame over the link from a to b: b records what it heard
+static int8_t link_sample_rssi(int a, int b)
+{
+    int rssi = link_mean_rssi(a, b);
+    if (s_cfg.rssi_noise_db > 0) {
+        rssi += (int)(rssi_rng_next() % (2U * s_cfg.rssi_noise_db + 1U)) - s_cfg.rssi_noise_db;
+    }
+    rssi = rssi < INT8_MIN ? INT8_MIN : rssi > INT8_MAX ? INT8_MAX : rssi;
+    s_nodes[b].heard_rssi[a] = (int8_t)rssi;
+    return (int8_t)rssi;
+}
+
+static uint8_t lqi_of(int rssi)
+{
+    int lqi = (rssi - ZB_SIM_LQI_RSSI_MIN) * 255 / (ZB_SIM_LQI_RSSI_MAX - ZB_SIM_LQI_RSSI_MIN);
+    return (uint8_t)(lqi < 0 ? 0 : lqi > 255 ? 255 : lqi);
+}
+
+static uint16_t short_addr(int idx)
+{
+    return idx == s_coordinator ? 0x0000 : (uint16_t)(ZB_SIM_SHORT_BASE + idx);
+}
+
+static int node_by_short(uint16_t addr)
+{
+    if (addr == 0x0000) {
+        return s_coordinator;
+    }
+    int idx = (int)addr - ZB_SIM_SHORT_BASE;
+    return idx >= 0 && idx < s_node_count ? idx : NO_NODE;
+}
+
+// Octet strings are stored as in the SDK: length byte first
+static size_t attr_size(uint8_t type, const void *value)
+{
+    switch (type) {
+        case ESP_ZB_ZCL_ATTR_TYPE_OCTET_STRING: {
+            size_t len = 1 + *(const uint8_t *)value;
+            return len < ZB_SIM_ATTR_VALUE_MAX ? len : ZB_SIM_ATTR_VALUE_MAX;
+        }
+        case ESP_ZB_ZCL_ATTR_TYPE_U16:
+        case ESP_ZB_ZCL_ATTR_TYPE_S16:
+            return 2;
+        case ESP_ZB_ZCL_ATTR_TYPE_U32:
+            return 4;
+        default:
+            return 1;
+    }
+}
+
+// role 0 matches either side
+static zb_attr_t *find_attr(zb_node_t *n, uint8_t endpoint, uint16_t cluster,
+                            uint8_t role, uint16_t id)
+{
+    for (int i = 0; i < n->attr_count; i++) {
+        zb_attr_t *a = &n->attrs[i];
+        if (a->endpoint == endpoint && a->cluster == cluster && a->id == id &&
+            (role == 0 || a->role == role)) {
+            return a;
+        }
+    }
+    return NULL;
+}
+
+/* ============================================================================
+ * BUS
+ * ============================================================================ */
+
+static bool bus_before(const bus_item_t *a, const bus_item_t *b)
+{
+    return a->at_us < b->at_us || (a->at_us == b->at_us && a->seq < b->seq);
+}
+
+static void bus_arm(void)
+{
+    if (s_bus_draining || s_bus_len == 0 || s_bus[0].at_us >= s_bus_armed_us) {
+        return;
+    }
+    esp_timer_stop(s_bus_timer);
+    int64_t delay = s_bus[0].at_us - esp_timer_get_time();
+    esp_timer_start_once(s_bus_timer, delay > 0 ? (uint64_t)delay : 0);
+    s_bus_armed_us = s_bus[0].at_us;
+}
+
+static void bus_push(int64_t delay_us, bus_kind_t kind, int node, const zb_event_t *ev)
+{
+    if (s_bus_len == s_bus_cap) {
+        size_t cap = s_bus_cap ? s_bus_cap * 2 : 64;
+        bus_item_t *grown = realloc(s_bus, cap * sizeof(*grown));
+        if (grown == NULL) {
+            ESP_LOGE(TAG, "Bus heap full, item dropped");
+            return;
+        }
+        s_bus = grown;
+        s_bus_cap = cap;
+    }
+
+    bus_item_t item = {
+        .at_us = esp_timer_get_time() + delay_us,
+        .seq = s_bus_seq++,
+        .kind = kind,
+        .node = (int16_t)node,
+    };
+    if (ev != NULL) {
+        item.ev = *ev;
+    }
+
+    size_t i = s_bus_len++;
+    while (i > 0 && bus_before(&item, &s_bus[(i - 1) / 2])) {
+        s_bus[i] = s_bus[(i - 1) / 2];
+        i = (i - 1) / 2;
+    }
+    s_bus[i] = item;
+    bus_arm();
+}
+
+static bus_item_t bus_pop(void)
+{
+    bus_item_t top = s_bus[0];
+    bus_item_t last = s_bus[--s_bus_len];
+    size_t i = 0;
+    for (;;) {
+        size_t child = 2 * i + 1;
+        if (child >= s_bus_len) {
+            break;
+        }
+        if (child + 1 < s_bus_len && bus_before(&s_bus[child + 1], &s_bus[child])) {
+            child++;
+        }
+        if (!bus_before(&s_bus[child], &last)) {
+            break;
+        }
+        s_bus[i] = s_bus[child];
+        i = child;
+    }
+    if (s_bus_len > 0) {
+        s_bus[i] = last;
+    }
+    return top;
+}
+
+static void post(int node, const zb_event_t *ev)
+{
+    if (xQueueSend(s_nodes[node].queue, ev, 0) != pdTRUE) {
+        s_stats.queue_drops++;
+        if (ev->kind == ZB_EV_REPORT) {
+            s_stats.frames_lost++;
+        }
+    }
+}
+
+static void post_signal(int node, uint32_t type, esp_err_t status)
+{
+    zb_event_t ev = { .kind = ZB_EV_SIGNAL, .status = status, .signal.type = type };
+    post(node, &ev);
+}
+
+/* ============================================================================
+ * ROUTING
+ * ============================================================================ */
+
+// Breadth-first from dst over routing nodes: routes[i] is i's next hop
+static void build_routes(int dst)
+{
+    zb_node_t *d = &s_nodes[dst];
+    if (d->routes == NULL) {
+        d->routes = malloc(ZB_SIM_MAX_NODES * sizeof(*d->routes));
+        if (d->routes == NULL) {
+            return;
+        }
+    }
+    for (int i = 0; i < s_node_count; i++) {
+        d->routes[i] = NO_NODE;
+    }
+
+    int16_t fifo[ZB_SIM_MAX_NODES];
+    int head = 0, tail = 0;
+    fifo[tail++] = (int16_t)dst;
+    d->routes[dst] = (int16_t)dst;
+    while (head < tail) {
+        int at = fifo[head++];
+        for (int nb = 0; nb < s_node_count; nb++) {
+            if (d->routes[nb] == NO_NODE && linked(at, nb) && routes_frames(nb)) {
+                d->routes[nb] = (int16_t)at;
+                fifo[tail++] = (int16_t)nb;
+            }
+        }
+    }
+    d->routes_gen = s_mesh_gen;
+}
+
+static int next_hop(int at, int dst)
+{
+    if (at == dst) {
+        return dst;
+    }
+    // End devices only talk to their parent, in both directions
+    if (s_nodes[at].role == ESP_ZB_DEVICE_TYPE_ED) {
+        return s_nodes[at].parent;
+    }
+    int target = dst;
+    if (s_nodes[dst].role == ESP_ZB_DEVICE_TYPE_ED) {
+        target = s_nodes[dst].parent;
+        if (target == NO_NODE) {
+            return NO_NODE;
+        }
+        if (at == target) {
+            return dst;
+        }
+    }
+    zb_node_t *t = &s_nodes[target];
+    if (!routes_frames(target)) {
+        return NO_NODE;
+    }
+    if (t->routes == NULL || t->routes_gen != s_mesh_gen) {
+        build_routes(target);
+    }
+    return t->routes != NULL ? t->routes[at] : NO_NODE;
+}
+
+/* ============================================================================
+ * BUS EVENTS
+ * ============================================================================ */
+
+static void frame_hop(zb_frame_t *f)
+{
+    bool first = f->at == f->src;
+    int next = next_hop(f->at, f->dst);
+
+    // One hop: transmit until ACKed or out of retries
+    int64_t delay = 0;
+    bool acked = false;
+    if (next != NO_NODE) {
+        for (int attempt = 0; attempt <= s_cfg.mac_retries && !acked; attempt++) {
+            s_stats.mac_attempts++;
+            if (attempt > 0) {
+                s_stats.mac_retries++;
+            }
+            delay += s_cfg.hop_latency_us;
+            if (s_cfg.hop_jitter_us > 0) {
+                delay += rng_next() % (s_cfg.hop_jitter_us + 1);
+            }
+            acked = s_cfg.loss_pct == 0 || (int)(rng_next() % 100) >= s_cfg.loss_pct;
+        }
+    }
+
+    if (first) {
+        zb_event_t status = {
+            .kind = ZB_EV_SEND_STATUS,
+            .status = acked ? ESP_OK : ESP_FAIL,
+            .frame = *f,
+        };
+        bus_push(delay, BUS_POST, f->src, &status);
+    }
+    if (!acked) {
+        s_stats.frames_lost++;
+        return;
+    }
+
+    f->rssi = link_sample_rssi(f->at, next);
+    link_sample_rssi(next, f->at);     // The ACK
+    f->at = (int16_t)next;
+    f->hops++;
+    zb_event_t ev = { .kind = ZB_EV_REPORT, .status = ESP_OK, .frame = *f };
+    if (next == f->dst) {
+        bus_push(delay, BUS_POST, f->dst, &ev);
+    } else {
+        bus_push(delay, BUS_HOP, next, &ev);
+    }
+}
+
+static void mesh_changed(void)
+{
+    s_mesh_gen++;
+}
+
+static void formed(int idx)
+{
+    zb_node_t *n = &s_nodes[idx];
+    n->commissioning = false;
+    n->joined = true;
+    n->joined_us = esp_timer_get_time();
+    n->depth = 0;
+    n->parent = NO_NODE;
+    s_coordinator = idx;
+    mesh_changed();
+    post_signal(idx, ESP_ZB_BDB_SIGNAL_FORMATION, ESP_OK);
+}
+
+// Join through the shallowest router or coordinator in range that was on
+// the network before this attempt ended (beacons heard during steering)
+static void steered(int idx)
+{
+    zb_node_t *n = &s_nodes[idx];
+    n->commissioning = false;
+
+    int64_t now = esp_timer_get_time();
+    int parent = NO_NODE;
+    for (int nb = 0; nb < s_node_count; nb++) {
+        if (nb != idx && linked(idx, nb) && routes_frames(nb) && s_nodes[nb].joined_us < now &&
+            (parent == NO_NODE || s_nodes[nb].depth < s_nodes[parent].depth)) {
+            parent = nb;
+        }
+    }
+    if (parent == NO_NODE) {
+        post_signal(idx, ESP_ZB_BDB_SIGNAL_STEERING, ESP_FAIL);
+        return;
+    }
+
+    n->joined = true;
+    n->joined_us = now;
+    n->parent = (int16_t)parent;
+    n->depth = (int16_t)(s_nodes[parent].depth + 1);
+    s_stats.joins++;
+    s_stats.last_join_us = now;
+    mesh_changed();
+    ESP_LOGD(TAG, "Node %d joined via %d (depth %d)", idx, parent, n->depth);
+    post_signal(idx, ESP_ZB_BDB_SIGNAL_STEERING, ESP_OK);
+
+    if (s_coordinator != NO_NODE) {
+        zb_event_t annce = {
+            .kind = ZB_EV_SIGNAL,
+            .status = ESP_OK,
+            .signal.type = ESP_ZB_ZDO_SIGNAL_DEVICE_ANNCE,
+            .signal.annce.device_short_addr = short_addr(idx),
+            .signal.annce.capability = n->role == ESP_ZB_DEVICE_TYPE_ED ? 0x80 : 0x8E,
+        };
+        annce.signal.annce.ieee_addr[0] = (uint8_t)idx;
+        annce.signal.annce.ieee_addr[1] = (uint8_t)(idx >> 8);
+        post(s_coordinator, &annce);
+    }
+}
+
+static void bus_timer_cb(void *arg)
+{
+    (void)arg;
+    s_bus_armed_us = INT64_MAX;
+    s_bus_draining = true;
+    int64_t now = esp_timer_get_time();
+    while (s_bus_len > 0 && s_bus[0].at_us <= now) {
+        bus_item_t item = bus_pop();
+        switch (item.kind) {
+            case BUS_HOP:
+                frame_hop(&item.ev.frame);
+                break;
+            case BUS_POST:
+                post(item.node, &item.ev);
+                break;
+            case BUS_FORMED:
+                formed(item.node);
+                break;
+            case BUS_STEERED:
+                steered(item.node);
+                break;
+        }
+    }
+    s_bus_draining = false;
+    bus_arm();
+}
+
+/* ============================================================================
+ * RUNNER API
+ * ============================================================================ */
+
+esp_err_t zb_sim_init(const zb_sim_config_t *cfg)
+{
+    for (int i = 0; i < s_node_count; i++) {
+        vQueueDelete(s_nodes[i].queue);
+        vSemaphoreDelete(s_nodes[i].lock);
+        free(s_nodes[i].routes);
+    }
+    memset(s_nodes, 0, sizeof(s_nodes));
+    s_node_count = 0;
+    s_coordinator = NO_NODE;
+    s_mesh_gen = 1;
+    memset(&s_stats, 0, sizeof(s_stats));
+
+    free(s_bus);
+    s_bus = NULL;
+    s_bus_len = s_bus_cap = 0;
+    s_bus_seq = 0;
+    s_bus_armed_us = INT64_MAX;
+    s_bus_draining = false;
+
+    zb_sim_config_t defaults = ZB_SIM_CONFIG_DEFAULT();
+    s_cfg = cfg != NULL ? *cfg : defaults;
+    s_rng = s_cfg.seed != 0 ? s_cfg.seed : 1;
+    s_rssi_rng = s_rng ^ 0x5A5A5A5AU;
+
+    // sim_reset() dropped the previous run's timer
+    const esp_timer_create_args_t args = { .callback = bus_timer_cb, .name = "zb_bus" };
+    return esp_timer_create(&args, &s_bus_timer);
+}
+
+int zb_sim_node_create(void)
+{
+    if (s_node_count >= ZB_SIM_MAX_NODES) {
+        return NO_NODE;
+    }
+    int idx = s_node_count;
+    zb_node_t *n = &s_nodes[idx];
+    memset(n, 0, sizeof(*n));
+    n->role = ESP_ZB_DEVICE_TYPE_NONE;
+    n->parent = NO_NODE;
+    n->depth = -1;
+    n->queue = xQueueCreate(ZB_SIM_QUEUE_DEPTH, sizeof(zb_event_t));
+    n->lock = xSemaphoreCreateRecursiveMutex();
+    if (n->queue == NULL || n->lock == NULL) {
+        vQueueDelete(n->queue);
+        vSemaphoreDelete(n->lock);
+        return NO_NODE;
+    }
+    s_node_count++;
+    return idx;
+}
+
+esp_err_t zb_sim_link(int a, int b)
+{
+    if (a < 0 || b < 0 || a >= s_node_count || b >= s_node_count || a == b) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    s_nodes[a].links[b / 32] |= 1U << (b % 32);
+    s_nodes[b].links[a / 32] |= 1U << (a % 32);
+    // Heard at the mean while joining, until frames cross the link
+    s_nodes[a].heard_rssi[b] = s_nodes[b].heard_rssi[a] = (int8_t)link_mean_rssi(a, b);
+    mesh_changed();
+    return ESP_OK;
+}
+
+int8_t zb_sim_link_rssi(int a, int b)
+{
+    if (a < 0 || b < 0 || a >= s_node_count || b >= s_node_count || a == b || !linked(a, b)) {
+        return INT8_MIN;
+    }
+    return (int8_t)link_mean_rssi(a, b);
+}
+
+esp_err_t zb_sim_topology(zb_sim_topology_t topology)
+{
+    int n = s_node_count;
+    switch (topology) {
+        case ZB_SIM_TOPOLOGY_STAR:
+            for (int i = 1; i < n; i++) {
+                zb_sim_link(0, i);
+            }
+            return ESP_OK;
+        case ZB_SIM_TOPOLOGY_LINE:
+            for (int i = 1; i < n; i++) {
+                zb_sim_link(i - 1, i);
+            }
+            return ESP_OK;
+        case ZB_SIM_TOPOLOGY_GRID: {
+            int side = 1;
+            while (side * side < n) {
+                side++;
+            }
+            for (int i = 0; i < n; i++) {
+                if ((i % side) + 1 < side && i + 1 < n) {
+                    zb_sim_link(i, i + 1);
+                }
+                if (i + side < n) {
+                    zb_sim_link(i, i + side);
+                }
+            }
+            return ESP_OK;
+        }
+        case ZB_SIM_TOPOLOGY_RANDOM:
+            // A random spanning tree keeps it connected, extra links add
+            // alternative paths
+            for (int i = 1; i < n; i++) {
+                zb_sim_link(i, (int)(rng_next() % (uint32_t)i));
+                if (i > 1 && rng_next() % 2 == 0) {
+                    zb_sim_link(i, (int)(rng_next() % (uint32_t)i));
+                }
+            }
+            return ESP_OK;
+    }
+    return ESP_ERR_INVALID_ARG;
+}
+
+void zb_sim_bind_task(TaskHandle_t task, int node)
+{
+    vTaskSetThreadLocalStoragePointer(task, ZB_SIM_TLS_INDEX, (void *)(intptr_t)(node + 1));
+}
+
+int zb_sim_current_node(void)
+{
+    if (!sim_in_task()) {
+        return NO_NODE;
+    }
+    intptr_t tag = (intptr_t)pvTaskGetThreadLocalStoragePointer(NULL, ZB_SIM_TLS_INDEX);
+    return tag > 0 && tag <= s_node_count ? (int)(tag - 1) : NO_NODE;
+}
+
+void zb_sim_get_stats(zb_sim_stats_t *stats)
+{
+    *stats = s_stats;
+}
+
+int64_t zb_sim_latency_percentile(const zb_sim_stats_t *stats, int pct)
+{
+    if (stats->frames_delivered == 0) {
+        return 0;
+    }
+    uint64_t want = ((uint64_t)stats->frames_delivered * (uint64_t)pct + 99) / 100;
+    uint64_t seen = 0;
+    for (int i = 0; i < ZB_SIM_LATENCY_BUCKETS; i++) {
+        seen += stats->latency_hist[i];
+        if (seen >= want) {
+            return (int64_t)(i + 1) * ZB_SIM_LATENCY_BUCKET_US;
+        }
+    }
+    return stats->latency_max_us;
+}
+
+int zb_sim_node_by_addr(uint16_t addr)
+{
+    return node_by_short(addr);
+}
+
+int zb_sim_node_count(void)
+{
+    return s_node_count;
+}
+
+bool zb_sim_node_joined(int node)
+{
+    return node >= 0 && node < s_node_count && s_nodes[node].joined;
+}
+
+int zb_sim_node_depth(int node)
+{
+    return zb_sim_node_joined(node) ? s_nodes[node].depth : -1;
+}
+
+/* ============================================================================
+ * STACK
+ * ============================================================================ */
+
+void esp_zb_init(esp_zb_cfg_t *nwk_cfg)
+{
+    zb_node_t *n = current();
+    if (n == NULL || nwk_cfg == NULL) {
+        ESP_LOGE(TAG, "esp_zb_init outside a node task");
+        return;
+    }
+    n->role = nwk_cfg->esp_zb_role;
+    n->initialised = true;
+}
+
+esp_err_t esp_zb_start(bool autostart)
+{
+    zb_node_t *n = current();
+    if (n == NULL || !n->initialised) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    post_signal(zb_sim_current_node(), autostart ? ESP_ZB_BDB_SIGNAL_DEVICE_FIRST_START
+                                                 : ESP_ZB_ZDO_SIGNAL_SKIP_STARTUP, ESP_OK);
+    return ESP_OK;
+}
+
+static void dispatch(zb_node_t *n, zb_event_t *ev)
+{
+    switch (ev->kind) {
+        case ZB_EV_SIGNAL: {
+            // Signal type followed by its parameters, as the SDK lays it out
+            struct {
+                uint32_t type;
+                esp_zb_zdo_signal_device_annce_params_t params;
+            } raw = { .type = ev->signal.type, .params = ev->signal.annce };
+            esp_zb_app_signal_t sig = { .p_app_signal = &raw.type, .esp_err_status = ev->status };
+            esp_zb_app_signal_handler(&sig);
+            break;
+        }
+
+        case ZB_EV_ALARM:
+            ev->alarm.cb(ev->alarm.param);
+            break;
+
+        case ZB_EV_REPORT: {
+            zb_frame_t *f = &ev->frame;
+            int64_t latency = esp_timer_get_time() - f->sent_us;
+            s_stats.frames_delivered++;
+            s_stats.hops += f->hops;
+            s_stats.latency_sum_us += (uint64_t)latency;
+            if (latency > s_stats.latency_max_us) {
+                s_stats.latency_max_us = latency;
+            }
+            int bucket = (int)(latency / ZB_SIM_LATENCY_BUCKET_US);
+            s_stats.latency_hist[bucket < ZB_SIM_LATENCY_BUCKETS ? bucket : ZB_SIM_LATENCY_BUCKETS - 1]++;
+
+            if (n->aps_ind_cb != NULL) {
+                esp_zb_apsde_data_ind_t ind = {
+                    .dst_addr_mode = ESP_ZB_APS_ADDR_MODE_16_ENDP_PRESENT,
+                    .dst_short_addr = short_addr(f->dst),
+                    .dst_endpoint = f->dst_endpoint,
+                    .src_short_addr = short_addr(f->src),
+                    .src_endpoint = f->src_endpoint,
+                    .profile_id = ESP_ZB_AF_HA_PROFILE_ID,
+                    .cluster_id = f->cluster,
+                    .lqi = lqi_of(f->rssi),
+                    .rx_time = (int)(esp_timer_get_time() / 1000),
+                };
+                if (n->aps_ind_cb(ind)) {
+                    break;
+                }
+            }
+            if (n->action_cb != NULL) {
+                esp_zb_zcl_report_attr_message_t msg = {
+                    .status = ESP_ZB_ZCL_STATUS_SUCCESS,
+                    .src_address = { .addr_type = 0, .u.short_addr = short_addr(f->src) },
+                    .src_endpoint = f->src_endpoint,
+                    .dst_endpoint = f->dst_endpoint,
+                    .cluster = f->cluster,
+                    .attribute = {
+                        .id = f->attr_id,
+                        .data = { .type = f->type, .size = (uint16_t)attr_size(f->type, f->value), .value = f->value },
+                    },
+                };
+                n->action_cb(ESP_ZB_CORE_REPORT_ATTR_CB_ID, &msg);
+            }
+            break;
+        }
+
+        case ZB_EV_SEND_STATUS:
+            if (n->send_status_cb != NULL) {
+                esp_zb_zcl_command_send_status_message_t msg = {
+                    .status = ev->status,
+                    .tsn = ev->frame.tsn,
+                    .dst_addr = { .addr_type = 0, .u.short_addr = short_addr(ev->frame.dst) },
+                    .dst_endpoint = ev->frame.dst_endpoint,
+                    .src_endpoint = ev->frame.src_endpoint,
+                };
+                n->send_status_cb(msg);
+            }
+            break;
+    }
+}
+
+void esp_zb_stack_main_loop(void)
+{
+    zb_node_t *n = current();
+    if (n == NULL) {
+        ESP_LOGE(TAG, "Stack main loop outside a node task");
+        vTaskDelete(NULL);
+        return;
+    }
+    for (;;) {
+        zb_event_t ev;
+        if (xQueueReceive(n->queue, &ev, portMAX_DELAY) != pdTRUE) {
+            continue;
+        }
+        esp_zb_lock_acquire(portMAX_DELAY);
+        dispatch(n, &ev);
+        esp_zb_lock_release();
+    }
+}
+
+esp_err_t esp_zb_set_channel_mask(uint32_t channel_mask)
+{
+    return (channel_mask & (1U << s_cfg.channel)) ? ESP_OK : ESP_ERR_INVALID_ARG;
+}
+
+uint16_t esp_zb_get_pan_id(void)
+{
+    return s_cfg.pan_id;
+}
+
+uint8_t esp_zb_get_current_channel(void)
+{
+    return s_cfg.channel;
+}
+
+uint16_t esp_zb_get_short_address(void)
+{
+    int idx = zb_sim_current_node();
+    return idx >= 0 && s_nodes[idx].joined ? short_addr(idx) : 0xFFFE;
+}
+
+bool esp_zb_lock_acquire(TickType_t block_ticks)
+{
+    zb_node_t *n = current();
+    return n != NULL && xSemaphoreTakeRecursive(n->lock, block_ticks) == pdTRUE;
+}
+
+void esp_zb_lock_release(void)
+{
+    zb_node_t *n = current();
+    if (n != NULL) {
+        xSemaphoreGiveRecursive(n->lock);
+    }
+}
+
+void esp_zb_scheduler_alarm(esp_zb_callback_t cb, uint8_t param, uint32_t time_ms)
+{
+    int idx = zb_sim_current_node();
+    if (idx < 0 || cb == NULL) {
+        return;
+    }
+    zb_event_t ev = { .kind = ZB_EV_ALARM, .alarm = { .cb = cb, .param = param } };
+    bus_push((int64_t)time_ms * 1000, BUS_POST, idx, &ev);
+}
+
+/* ============================================================================
+ * COMMISSIONING AND APP SIGNALS
+ * ============================================================================ */
+
+esp_err_t esp_zb_bdb_start_top_level_commissioning(uint8_t mode_mask)
+{
+    int idx = zb_sim_current_node();
+    if (idx < 0 || !s_nodes[idx].initialised) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    zb_node_t *n = &s_nodes[idx];
+
+    if (mode_mask == ESP_ZB_BDB_MODE_INITIALIZATION) {
+        post_signal(idx, ESP_ZB_BDB_SIGNAL_DEVICE_FIRST_START, ESP_OK);
+        return ESP_OK;
+    }
+    if (mode_mask & ESP_ZB_BDB_MODE_NETWORK_FORMATION) {
+        if (n->role != ESP_ZB_DEVICE_TYPE_COORDINATOR || s_coordinator != NO_NODE) {
+            post_signal(idx, ESP_ZB_BDB_SIGNAL_FORMATION, ESP_FAIL);
+            return ESP_OK;
+        }
+        if (!n->commissioning) {
+            n->commissioning = true;
+            bus_push(s_cfg.steering_us, BUS_FORMED, idx, NULL);
+        }
+        return ESP_OK;
+    }
+    if (mode_mask & ESP_ZB_BDB_MODE_NETWORK_STEERING) {
+        // On a formed network this just opens it for joining
+        if (n->joined) {
+            post_signal(idx, ESP_ZB_BDB_SIGNAL_STEERING, ESP_OK);
+        } else if (!n->commissioning) {
+            n->commissioning = true;
+            bus_push(s_cfg.steering_us, BUS_STEERED, idx, NULL);
+        }
+        return ESP_OK;
+    }
+    return ESP_ERR_NOT_SUPPORTED;
+}
+
+void *esp_zb_app_signal_get_params(uint32_t *signal_p)
+{
+    return signal_p + 1;
+}
+
+__attribute__((weak)) void esp_zb_app_signal_handler(esp_zb_app_signal_t *signal_s)
+{
+    (void)signal_s;
+}
+
+/* ============================================================================
+ * ZCL: ENDPOINTS, CLUSTERS, ATTRIBUTES
+ * ============================================================================ */
+
+esp_zb_attribute_list_t *esp_zb_zcl_attr_list_create(uint16_t cluster_id)
+{
+    esp_zb_attribute_list_t *list = calloc(1, sizeof(*list));
+    if (list != NULL) {
+        list->cluster = cluster_id;
+    }
+    return list;
+}
+
+esp_err_t esp_zb_custom_cluster_add_custom_attr(esp_zb_attribute_list_t *attr_list,
+                                                uint16_t attr_id, uint8_t type,
+                                                uint8_t access, void *value)
+{
+    (void)access;
+    if (attr_list == NULL || value == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (attr_list->count >= ZB_SIM_MAX_ATTRS) {
+        return ESP_ERR_NO_MEM;
+    }
+    zb_attr_t *a = &attr_list->attrs[attr_list->count++];
+    memset(a, 0, sizeof(*a));
+    a->cluster = attr_list->cluster;
+    a->id = attr_id;
+    a->type = type;
+    memcpy(a->value, value, attr_size(type, value));
+    return ESP_OK;
+}
+
+esp_zb_cluster_list_t *esp_zb_zcl_cluster_list_create(void)
+{
+    return calloc(1, sizeof(esp_zb_cluster_list_t));
+}
+
+esp_err_t esp_zb_cluster_list_add_custom_cluster(esp_zb_cluster_list_t *list,
+                                                 esp_zb_attribute_list_t *attr_list,
+                                                 uint8_t role_mask)
+{
+    if (list == NULL || attr_list == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (list->count >= ZB_SIM_MAX_ATTRS) {
+        return ESP_ERR_NO_MEM;
+    }
+    list->clusters[list->count] = attr_list;
+    list->roles[list->count] = role_mask;
+    list->count++;
+    return ESP_OK;
+}
+
+esp_zb_ep_list_t *esp_zb_ep_list_create(void)
+{
+    return calloc(1, sizeof(esp_zb_ep_list_t));
+}
+
+esp_err_t esp_zb_ep_list_add_ep(esp_zb_ep_list_t *ep_list, esp_zb_cluster_list_t *cluster_list,
+                                esp_zb_endpoint_config_t endpoint_config)
+{
+    if (ep_list == NULL || cluster_list == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (ep_list->count >= (int)(sizeof(ep_list->lists) / sizeof(ep_list->lists[0]))) {
+        return ESP_ERR_NO_MEM;
+    }
+    ep_list->lists[ep_list->count] = cluster_list;
+    ep_list->endpoints[ep_list->count] = endpoint_config.endpoint;
+    ep_list->count++;
+    return ESP_OK;
+}
+
+// The stack takes ownership of the lists, as in the SDK
+esp_err_t esp_zb_device_register(esp_zb_ep_list_t *ep_list)
+{
+    zb_node_t *n = current();
+    if (n == NULL || ep_list == NULL) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    esp_err_t ret = ESP_OK;
+    for (int e = 0; e < ep_list->count; e++) {
+        esp_zb_cluster_list_t *cl = ep_list->lists[e];
+        for (int c = 0; c < cl->count; c++) {
+            esp_zb_attribute_list_t *al = cl->clusters[c];
+            for (int a = 0; a < al->count; a++) {
+                if (n->attr_count >= ZB_SIM_MAX_ATTRS) {
+                    ret = ESP_ERR_NO_MEM;
+                    break;
+                }
+                zb_attr_t *attr = &n->attrs[n->attr_count++];
+                *attr = al->attrs[a];
+                attr->endpoint = ep_list->endpoints[e];
+                attr->role = cl->roles[c];
+            }
+            free(al);
+        }
+        free(cl);
+    }
+    free(ep_list);
+    return ret;
+}
+
+esp_zb_zcl_status_t esp_zb_zcl_set_attribute_val(uint8_t endpoint, uint16_t cluster_id,
+                                                 uint8_t cluster_role, uint16_t attr_id,
+                                                 void *value_p, bool check)
+{
+    (void)check;
+    zb_node_t *n = current();
+    if (n == NULL || value_p == NULL) {
+        return ESP_ZB_ZCL_STATUS_FAIL;
+    }
+    zb_attr_t *a = find_attr(n, endpoint, cluster_id, cluster_role, attr_id);
+    if (a == NULL) {
+        return ESP_ZB_ZCL_STATUS_UNSUP_ATTRIB;
+    }
+    memcpy(a->value, value_p, attr_size(a->type, value_p));
+    return ESP_ZB_ZCL_STATUS_SUCCESS;
+}
+
+/* ============================================================================
+ * ZCL: REPORTS AND CALLBACKS
+ * ============================================================================ */
+
+esp_err_t esp_zb_zcl_report_attr_cmd_req(esp_zb_zcl_report_attr_cmd_t *cmd)
+{
+    int idx = zb_sim_current_node();
+    if (idx < 0 || cmd == NULL) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    zb_node_t *n = &s_nodes[idx];
+    if (!n->joined) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    if (cmd->address_mode != ESP_ZB_APS_ADDR_MODE_16_ENDP_PRESENT) {
+        return ESP_ERR_NOT_SUPPORTED;
+    }
+    const zb_attr_t *a = find_attr(n, cmd->zcl_basic_cmd.src_endpoint, cmd->clusterID,
+                                   cmd->cluster_role, cmd->attributeID);
+    if (a == NULL) {
+        return ESP_ERR_NOT_FOUND;
+    }
+
+    zb_frame_t f = {
+        .src = (int16_t)idx,
+        .dst = (int16_t)node_by_short(cmd->zcl_basic_cmd.dst_addr_u.addr_short),
+        .at = (int16_t)idx,
+        .tsn = n->tsn++,
+        .src_endpoint = cmd->zcl_basic_cmd.src_endpoint,
+        .dst_endpoint = cmd->zcl_basic_cmd.dst_endpoint,
+        .cluster = cmd->clusterID,
+        .attr_id = cmd->attributeID,
+        .type = a->type,
+        .sent_us = esp_timer_get_time(),
+    };
+    memcpy(f.value, a->value, sizeof(f.value));
+    s_stats.frames_sent++;
+
+    if (f.dst == NO_NODE) {
+        // Unknown address: the first hop has nowhere to go
+        s_stats.frames_lost++;
+        zb_event_t status = { .kind = ZB_EV_SEND_STATUS, .status = ESP_FAIL, .frame = f };
+        post(idx, &status);
+        return ESP_OK;
+    }
+    zb_event_t ev = { .kind = ZB_EV_REPORT, .frame = f };
+    bus_push(0, BUS_HOP, idx, &ev);
+    return ESP_OK;
+}
+
+void esp_zb_core_action_handler_register(esp_zb_core_action_callback_t cb)
+{
+    zb_node_t *n = current();
+    if (n != NULL) {
+        n->action_cb = cb;
+    }
+}
+
+void esp_zb_zcl_command_send_status_handler_register(esp_zb_zcl_command_send_status_callback_t cb)
+{
+    zb_node_t *n = current();
+    if (n != NULL) {
+        n->send_status_cb = cb;
+    }
+}
+
+void esp_zb_aps_data_indication_handler_register(esp_zb_aps_data_indication_callback_t cb)
+{
+    zb_node_t *n = current();
+    if (n != NULL) {
+        n->aps_ind_cb = cb;
+    }
+}
+
+/* ============================================================================
+ * NEIGHBOUR TABLE
+ * ============================================================================ */
+
+// An end device knows only its parent; a router its routers and children in range
+static bool is_neighbor(int idx, int nb)
+{
+    const zb_node_t *n = &s_nodes[idx];
+    const zb_node_t *m = &s_nodes[nb];
+    if (nb == idx || !m->joined || !linked(idx, nb)) {
+        return false;
+    }
+    if (n->role == ESP_ZB_DEVICE_TYPE_ED) {
+        return n->parent == nb;
+    }
+    return routes_frames(nb) || m->parent == idx;
+}
+
+esp_err_t esp_zb_nwk_get_next_neighbor(esp_zb_nwk_info_iterator_t *iterator,
+                                       esp_zb_nwk_neighbor_info_t *nbr_info)
+{
+    int idx = zb_sim_current_node();
+    if (idx < 0 || !s_nodes[idx].joined) {
+        return ESP_ERR_NOT_FOUND;
+    }
+    for (int nb = *iterator; nb < s_node_count; nb++) {
+        if (!is_neighbor(idx, nb)) {
+            continue;
+        }
+        const zb_node_t *m = &s_nodes[nb];
+        memset(nbr_info, 0, sizeof(*nbr_info));
+        nbr_info->short_addr = short_addr(nb);
+        nbr_info->device_type = (uint8_t)m->role;
+        nbr_info->depth = (uint8_t)m->depth;
+        nbr_info->rx_on_when_idle = m->role != ESP_ZB_DEVICE_TYPE_ED;
+        nbr_info->relationship = s_nodes[idx].parent == nb ? ESP_ZB_NWK_RELATIONSHIP_PARENT
+                               : m->parent == idx ? ESP_ZB_NWK_RELATIONSHIP_CHILD
+                               : ESP_ZB_NWK_RELATIONSHIP_SIBLING;
+        nbr_info->rssi = s_nodes[idx].heard_rssi[nb];
+        nbr_info->lqi = lqi_of(nbr_info->rssi);
+        *iterator = nb + 1;
+        return ESP_OK;
+    }
+    *iterator = s_node_count;
+    return ESP_ERR_NOT_FOUND;
+}
@@ -0,0 +1,171 @@
+/*
+ * Zigbee Mesh Simulator - runner controls (firmware/host)
+ *
+ * Backs the esp_zigbee_core.h subset for host builds: any number of nodes
+ * (1 coordinator, routers, end devices) share one process and one virtual
+ * clock, each with its own stack task, lock, attribute table and callbacks.
+ * Frames travel hop by hop over a configurable topology with per-hop
+ * latency, jitter, loss and MAC retries, all scheduled on the discrete-event
+ * simulator (sim.h), so a 200-node mesh is as reproducible as a single node.
+ *
+ * Typical runner:
+ *
+ *   sim_reset();
+ *   zb_sim_config_t cfg = ZB_SIM_CONFIG_DEFAULT();
+ *   zb_sim_init(&cfg);
+ *   for (int i = 0; i < n; i++) zb_sim_node_create();
+ *   zb_sim_topology(ZB_SIM_TOPOLOGY_LINE);
+ *   xTaskCreate(zigbee_task, "zb", 4096, NULL, 5, &task);
+ *   zb_sim_bind_task(task, 0);       // esp_zb_* calls from it act on node 0
+ *   sim_run_until(...);
+ *
+ * Routing is shortest path over joined routers (and the coordinator); end
+ * devices talk only through their parent. Send status reflects the first
+ * hop's MAC outcome, as for unacknowledged ZCL reports on the real stack:
+ * a frame lost further along is counted but not reported to the sender.
+ *
+ * Each link has a fixed mean RSSI (a hash of the seed and its two ends, so
+ * adding links does not disturb the loss and jitter sequence); every frame
+ * crossing it is received at that mean plus noise, and its LQI follows from
+ * the RSSI. Receivers see it as the APS indication's LQI and in their
+ * neighbour table (esp_zb_nwk_get_next_neighbor(), last frame heard). Loss
+ * stays the uniform loss_pct whatever the RSSI.
+ */
+
+#ifndef ZB_SIM_H
+#define ZB_SIM_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "esp_err.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+
+#define ZB_SIM_TLS_INDEX            1       // Task-local pointer slot holding the node
+#define ZB_SIM_MAX_NODES            256
+#define ZB_SIM_QUEUE_DEPTH          64      // Stack events pending per node
+#define ZB_SIM_LATENCY_BUCKET_US    1000
+#define ZB_SIM_LATENCY_BUCKETS      1024    // Last bucket collects everything slower
+
+/* ============================================================================
+ * CONFIGURATION
+ * ============================================================================ */
+
+typedef struct {
+    uint32_t hop_latency_us;    // One MAC transmission incl. CSMA and ACK
+    uint32_t hop_jitter_us;     // Uniform extra delay per transmission
+    uint8_t  loss_pct;          // Chance a transmission is not acknowledged
+    uint8_t  mac_retries;       // Retransmissions before a hop fails
+    uint32_t steering_us;       // Formation / steering duration
+    uint32_t seed;              // Loss and jitter PRNG
+    uint16_t pan_id;
+    uint8_t  channel;
+    int8_t   link_rssi_dbm;     // Strongest link's mean RSSI
+    uint8_t  link_rssi_spread_db;   // Link means spread below it, uniform
+    uint8_t  rssi_noise_db;     // Uniform +/- per frame
+} zb_sim_config_t;
+
+#define ZB_SIM_CONFIG_DEFAULT() {   \
+    .hop_latency_us = 5000,         \
+    .hop_jitter_us = 2000,          \
+    .loss_pct = 0,                  \
+    .mac_retries = 3,               \
+    .steering_us = 2000000,         \
+    .seed = 1,                      \
+    .pan_id = 0x1A62,               \
+    .channel = 15,                  \
+    .link_rssi_dbm = -50,           \
+    .link_rssi_spread_db = 30,      \
+    .rssi_noise_db = 4,             \
+}
+
+typedef enum {
+    ZB_SIM_TOPOLOGY_STAR,       // Everyone in range of node 0
+    ZB_SIM_TOPOLOGY_LINE,       // i <-> i + 1
+    ZB_SIM_TOPOLOGY_GRID,       // Square grid, 4 neighbours, row-major
+    ZB_SIM_TOPOLOGY_RANDOM,     // Connected random graph, ~3 links per node
+} zb_sim_topology_t;
+
+/* ============================================================================
+ * SETUP
+ * ============================================================================ */
+
+/**
+ * Drop every node and link and clear the counters. Call after sim_reset()
+ * and before creating the nodes' tasks; NULL config for the defaults.
+ */
+esp_err_t zb_sim_init(const zb_sim_config_t *cfg);
+
+/**
+ * Add a node (radio only: its role comes from esp_zb_init())
+ *
+ * @return Node index, or -1 when ZB_SIM_MAX_NODES exist
+ */
+int zb_sim_node_create(void);
+
+/**
+ * Put two nodes in radio range of each other
+ */
+esp_err_t zb_sim_link(int a, int b);
+
+/**
+ * Mean RSSI of the link between a and b, INT8_MIN if they are not linked
+ */
+int8_t zb_sim_link_rssi(int a, int b);
+
+/**
+ * Link all nodes created so far in the given shape
+ */
+esp_err_t zb_sim_topology(zb_sim_topology_t topology);
+
+/**
+ * esp_zb_* calls from this simulator task act on the given node
+ */
+void zb_sim_bind_task(TaskHandle_t task, int node);
+
+/* ============================================================================
+ * OBSERVATION
+ * ============================================================================ */
+
+typedef struct {
+    uint32_t frames_sent;       // Reports handed to the stack
+    uint32_t frames_delivered;  // Reports passed to the destination's handler
+    uint32_t frames_lost;       // MAC retries exhausted or no route
+    uint32_t queue_drops;       // Destination stack queue full
+    uint32_t mac_attempts;      // Transmissions, every hop
+    uint32_t mac_retries;       // Transmissions after a missing ACK
+    uint32_t joins;
+    int64_t  last_join_us;
+    uint64_t hops;              // Over delivered reports
+    uint64_t latency_sum_us;    // Request to handler, delivered reports
+    int64_t  latency_max_us;
+    uint32_t latency_hist[ZB_SIM_LATENCY_BUCKETS];
+} zb_sim_stats_t;
+
+void zb_sim_get_stats(zb_sim_stats_t *stats);
+
+/**
+ * Latency under which pct % of delivered reports arrived (bucket upper
+ * bound), 0 if none were delivered
+ */
+int64_t zb_sim_latency_percentile(const zb_sim_stats_t *stats, int pct);
+
+/**
+ * Node owning the running task, -1 outside a bound task
+ */
+int zb_sim_current_node(void);
+
+int zb_sim_node_count(void);
+
+/**
+ * Node with the given short address, -1 if none
+ */
+int zb_sim_node_by_addr(uint16_t short_addr);
+bool zb_sim_node_joined(int node);
+
+/**
+ * Hops to the coordinator along parent links, -1 if not joined
+ */
+int zb_sim_node_depth(int node);
+
+#endif // ZB_SIM_H
@@ -43,7 +43,6 @@ static const char *TAG = "ROUTER_NODE";
  * ============================================================================ */
 
 static bool g_zigbee_connected = false;
-static uint32_t g_packets_relayed = 0;
 static uint32_t g_uptime_seconds = 0;
 
 /* ============================================================================
@@ -218,12 +217,32 @@ static void status_task(void *pvParameters)
                 led_activity_pulse();
             }
             
-            // Log status every minute
+            // Log status every minute. The stack keeps no relayed-frame
+            // count; the neighbour table shows what this router serves.
             if (g_uptime_seconds % 60 == 0) {
-                ESP_LOGI(TAG, "Router Status: Uptime=%lu min, Connected=YES, PAN=0x%04x, CH=%d",
+                int neighbors = 0;
+                int children = 0;
+                uint8_t best_lqi = 0;
+                esp_zb_nwk_info_iterator_t it = ESP_ZB_NWK_INFO_ITERATOR_INIT;
+                esp_zb_nwk_neighbor_info_t nbr;
+                esp_zb_lock_acquire(portMAX_DELAY);
+                while (esp_zb_nwk_get_next_neighbor(&it, &nbr) == ESP_OK) {
+                    neighbors++;
+                    if (nbr.relationship == ESP_ZB_NWK_RELATIONSHIP_CHILD) {
+                        children++;
+                    }
+                    if (nbr.lqi > best_lqi) {
+                        best_lqi = nbr.lqi;
+                    }
+                }
+                esp_zb_lock_release();
+                
+                ESP_LOGI(TAG, "Router Status: Uptime=%lu min, Connected=YES, PAN=0x%04x, CH=%d, "
+                         "Neighbors=%d (children %d), Best LQI=%d",
                          g_uptime_seconds / 60,
                          esp_zb_get_pan_id(),
-                         esp_zb_get_current_channel());
+                         esp_zb_get_current_channel(),
+                         neighbors, children, best_lqi);
             }
         } else {
             // Blink status LED when not connected
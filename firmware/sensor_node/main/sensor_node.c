@@ -21,6 +21,10 @@
 #include "ha/esp_zigbee_ha_standard.h"
 
 #include "ble_provision.h"
+#include "config_derived.h"
+#include "node_hal.h"
+#include "water_level.h"
+#include "trace.h"
 #include "cultivio_brand.h"
 
 /* ============================================================================
@@ -30,18 +34,11 @@
 static const char *TAG = "SENSOR_NODE";
 
 // Hardware Pins (ESP32-H2 Mini compatible)
-#define ULTRASONIC_TRIG_PIN     GPIO_NUM_2
-#define ULTRASONIC_ECHO_PIN     GPIO_NUM_3
-#define LED_STATUS_PIN          GPIO_NUM_8
-#define LED_PROV_PIN            GPIO_NUM_9      // Provisioning mode LED
-#define BUTTON_PIN              GPIO_NUM_10     // Button for provisioning mode
-
-// Ultrasonic sensor settings
-#define SOUND_SPEED_CM_US       0.0343f
-#define ULTRASONIC_TIMEOUT_US   30000
-#define NUM_SAMPLES             5
-#define SAMPLE_DELAY_MS         50
-#define SENSOR_TOLERANCE_CM     50      // Allow readings slightly beyond tank height
+#define ULTRASONIC_TRIG_PIN     NODE_PIN_TRIGGER
+#define ULTRASONIC_ECHO_PIN     NODE_PIN_ECHO
+#define LED_STATUS_PIN          NODE_PIN_LED_STATUS
+#define LED_PROV_PIN            NODE_PIN_LED_ACTIVITY   // Provisioning mode LED
+#define BUTTON_PIN              NODE_PIN_BUTTON         // Button for provisioning mode
 
 // Timing constants
 #define DEBOUNCE_DELAY_MS       50      // Button debounce delay
@@ -63,11 +60,11 @@ static const char *TAG = "SENSOR_NODE";
  * ============================================================================ */
 
 static device_config_t g_config;
-static uint8_t  g_water_level_percent = 0;
-static uint16_t g_water_level_cm = 0;
-static uint8_t  g_sensor_status = 0;
+static water_level_t g_level = { .status = WATER_LEVEL_STATUS_OK };  // Also Zigbee attribute storage
 static bool     g_zigbee_connected = false;
 static bool     g_provisioning_mode = false;
+static int8_t   g_last_rssi = -100;     // Link to the parent, see measure_water_level()
+static uint8_t  g_signal_quality = 0;
 
 // FIX: BUG #12 - Zigbee join retry limit
 static uint8_t g_join_retry_count = 0;
@@ -141,106 +138,21 @@ static void ultrasonic_init(void)
     ESP_LOGI(TAG, "Ultrasonic sensor initialized");
 }
 
-static float measure_distance_cm(void)
-{
-    gpio_set_level(ULTRASONIC_TRIG_PIN, 0);
-    esp_rom_delay_us(2);
-    gpio_set_level(ULTRASONIC_TRIG_PIN, 1);
-    esp_rom_delay_us(10);
-    gpio_set_level(ULTRASONIC_TRIG_PIN, 0);
-
-    int64_t start_wait = esp_timer_get_time();
-    while (gpio_get_level(ULTRASONIC_ECHO_PIN) == 0) {
-        if ((esp_timer_get_time() - start_wait) > ULTRASONIC_TIMEOUT_US) {
-            return -1.0f;
-        }
-        // FIX: BUG #2 - Prevent watchdog timeout and allow task switching
-        esp_rom_delay_us(10);
-        taskYIELD();
-    }
-
-    int64_t echo_start = esp_timer_get_time();
-    while (gpio_get_level(ULTRASONIC_ECHO_PIN) == 1) {
-        if ((esp_timer_get_time() - echo_start) > ULTRASONIC_TIMEOUT_US) {
-            return -1.0f;
-        }
-        // FIX: BUG #2 - Prevent watchdog timeout and allow task switching
-        esp_rom_delay_us(10);
-        taskYIELD();
-    }
-    int64_t echo_end = esp_timer_get_time();
-
-    float duration_us = (float)(echo_end - echo_start);
-    float distance_cm = (duration_us * SOUND_SPEED_CM_US) / 2.0f;
-
-    return distance_cm;
-}
-
 static void measure_water_level(void)
 {
-    float total_distance = 0;
-    int valid_samples = 0;
-    
-    uint16_t tank_height = g_config.tank_height_cm > 0 ? g_config.tank_height_cm : 200;
-    uint8_t sensor_offset = g_config.sensor_offset_cm;
-
-    for (int i = 0; i < NUM_SAMPLES; i++) {
-        float distance = measure_distance_cm();
-        if (distance > 0 && distance < tank_height + SENSOR_TOLERANCE_CM) {
-            total_distance += distance;
-            valid_samples++;
-        }
-        vTaskDelay(pdMS_TO_TICKS(SAMPLE_DELAY_MS));
-    }
-
-    if (valid_samples > 0) {
-        // FIX: BUG #5 - Validate tank height before division
-        if (tank_height == 0) {
-            ESP_LOGE(TAG, "FATAL: Tank height is 0! Cannot calculate water level.");
-            g_sensor_status = 1;
-            g_water_level_percent = 0;
-            g_water_level_cm = 0;
-            return;
-        }
-        
-        float avg_distance = total_distance / valid_samples;
-        float water_depth = tank_height - avg_distance - sensor_offset;
-        
-        if (water_depth < 0) water_depth = 0;
-        if (water_depth > tank_height) water_depth = tank_height;
-
-        g_water_level_cm = (uint16_t)water_depth;
-        g_water_level_percent = (uint8_t)((water_depth / tank_height) * 100.0f);
-        g_sensor_status = 0;
-
-        esp_zb_lock_acquire(portMAX_DELAY);
-        esp_zb_zcl_set_attribute_val(SENSOR_ENDPOINT, CLUSTER_WATER_LEVEL,
-            ESP_ZB_ZCL_CLUSTER_SERVER_ROLE, ATTR_WATER_LEVEL_PCT, 
-            &g_water_level_percent, false);
-        esp_zb_zcl_set_attribute_val(SENSOR_ENDPOINT, CLUSTER_WATER_LEVEL,
-            ESP_ZB_ZCL_CLUSTER_SERVER_ROLE, ATTR_WATER_LEVEL_CM, 
-            &g_water_level_cm, false);
-        esp_zb_zcl_set_attribute_val(SENSOR_ENDPOINT, CLUSTER_WATER_LEVEL,
-            ESP_ZB_ZCL_CLUSTER_SERVER_ROLE, ATTR_SENSOR_STATUS, 
-            &g_sensor_status, false);
-        esp_zb_lock_release();
-
-        ESP_LOGI(TAG, "Water Level: %d%% (%d cm)", g_water_level_percent, g_water_level_cm);
-    } else {
-        g_sensor_status = 1;
-        ESP_LOGW(TAG, "Sensor measurement failed");
-        esp_zb_lock_acquire(portMAX_DELAY);
-        esp_zb_zcl_set_attribute_val(SENSOR_ENDPOINT, CLUSTER_WATER_LEVEL,
-            ESP_ZB_ZCL_CLUSTER_SERVER_ROLE, ATTR_WATER_LEVEL_PCT, 
-            &g_water_level_percent, false);
-        esp_zb_zcl_set_attribute_val(SENSOR_ENDPOINT, CLUSTER_WATER_LEVEL,
-            ESP_ZB_ZCL_CLUSTER_SERVER_ROLE, ATTR_WATER_LEVEL_CM, 
-            &g_water_level_cm, false);
-        esp_zb_zcl_set_attribute_val(SENSOR_ENDPOINT, CLUSTER_WATER_LEVEL,
-            ESP_ZB_ZCL_CLUSTER_SERVER_ROLE, ATTR_SENSOR_STATUS, 
-            &g_sensor_status, false);
-        esp_zb_lock_release();
+    // Live derived config, copied once per measurement
+    config_derived_t dc;
+    ble_provision_config_derived(&dc);
+    water_level_measure(&dc, &g_level);
+
+    node_zb_link_t link;
+    esp_zb_lock_acquire(portMAX_DELAY);
+    water_level_publish(&g_level);
+    if (node_hal_zb_link_quality(NODE_ZB_PEER_ANY, &link) == ESP_OK) {
+        g_last_rssi = link.rssi_dbm;
+        g_signal_quality = NODE_ZB_LQI_TO_PCT(link.lqi);
     }
+    esp_zb_lock_release();
 }
 
 /* ============================================================================
@@ -266,15 +178,15 @@ static esp_zb_cluster_list_t *create_water_sensor_clusters(void)
     
     esp_zb_custom_cluster_add_custom_attr(water_cluster, ATTR_WATER_LEVEL_PCT,
         ESP_ZB_ZCL_ATTR_TYPE_U8, ESP_ZB_ZCL_ATTR_ACCESS_READ_ONLY | ESP_ZB_ZCL_ATTR_ACCESS_REPORTING,
-        &g_water_level_percent);
+        &g_level.percent);
     
     esp_zb_custom_cluster_add_custom_attr(water_cluster, ATTR_WATER_LEVEL_CM,
         ESP_ZB_ZCL_ATTR_TYPE_U16, ESP_ZB_ZCL_ATTR_ACCESS_READ_ONLY | ESP_ZB_ZCL_ATTR_ACCESS_REPORTING,
-        &g_water_level_cm);
+        &g_level.cm);
     
     esp_zb_custom_cluster_add_custom_attr(water_cluster, ATTR_SENSOR_STATUS,
         ESP_ZB_ZCL_ATTR_TYPE_U8, ESP_ZB_ZCL_ATTR_ACCESS_READ_ONLY,
-        &g_sensor_status);
+        &g_level.status);
 
     esp_zb_cluster_list_add_custom_cluster(cluster_list, water_cluster, ESP_ZB_ZCL_CLUSTER_SERVER_ROLE);
 
@@ -285,12 +197,6 @@ static void send_water_level_report(void)
 {
     if (!g_zigbee_connected) return;
 
-    esp_zb_zcl_set_attribute_val(SENSOR_ENDPOINT, CLUSTER_WATER_LEVEL,
-        ESP_ZB_ZCL_CLUSTER_SERVER_ROLE, ATTR_WATER_LEVEL_PCT, &g_water_level_percent, false);
-    
-    esp_zb_zcl_set_attribute_val(SENSOR_ENDPOINT, CLUSTER_WATER_LEVEL,
-        ESP_ZB_ZCL_CLUSTER_SERVER_ROLE, ATTR_WATER_LEVEL_CM, &g_water_level_cm, false);
-
     esp_zb_zcl_report_attr_cmd_t report_cmd = {
         .zcl_basic_cmd = {
             .dst_addr_u.addr_short = 0x0000,
@@ -413,9 +319,12 @@ static uint32_t g_uptime_seconds = 0;
 
 static void sensor_task(void *pvParameters)
 {
-    uint16_t interval = g_config.report_interval_sec > 0 ? g_config.report_interval_sec : 5;
-    
     while (1) {
+        // Re-read each cycle so a new report interval applies without reboot
+        config_derived_t dc;
+        ble_provision_config_derived(&dc);
+        uint32_t interval_ms = dc.report_interval_ms;
+        
         // FIX: BUG #10 - Feed watchdog in sensor loop
         esp_task_wdt_reset();
         
@@ -428,30 +337,22 @@ static void sensor_task(void *pvParameters)
                 .node_type = NODE_TYPE_SENSOR,
                 .zigbee_connected = g_zigbee_connected,
                 .uptime_seconds = g_uptime_seconds,
-                .water_level_percent = g_water_level_percent,
-                .water_level_cm = g_water_level_cm,
-                .sensor_status = g_sensor_status,
-                .pump_active = false,
-                .pump_runtime_sec = 0,
-                .last_water_level = g_water_level_percent,
                 .last_update_time = g_uptime_seconds,
-                .manual_override = false,
-                .manual_remaining_sec = 0,
-                .rssi_dbm = -50,  // Sensor doesn't receive, so fixed value
-                .signal_quality = g_zigbee_connected ? 80 : 0
+                .rssi_dbm = g_last_rssi,
+                .signal_quality = g_signal_quality
             };
-            ble_status_update(&status);
+            water_level_report_status(&g_level, &status);
             
-            if (g_sensor_status == 0) {
+            if (g_level.status == WATER_LEVEL_STATUS_OK) {
                 led_blink(LED_STATUS_PIN, 1, 50);
             } else {
                 led_blink(LED_STATUS_PIN, 3, 100);
             }
             
-            g_uptime_seconds += interval;
+            g_uptime_seconds += interval_ms / 1000;
         }
         
-        vTaskDelay(pdMS_TO_TICKS(interval * 1000));
+        vTaskDelay(pdMS_TO_TICKS(interval_ms));
     }
 }
 
@@ -588,6 +489,7 @@ void app_main(void)
     // Startup indication
     led_blink(LED_STATUS_PIN, 2, 200);
     ESP_LOGI(TAG, "Hardware initialized");
+    trace_start_task(TRACE_OUTPUT_LOG, tskIDLE_PRIORITY + 1);
 
     // Initialize provisioning
     ble_provision_init(NODE_TYPE_SENSOR);
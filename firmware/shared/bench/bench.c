@@ -0,0 +1,159 @@
+/*
+ * Microbenchmarks - runner, statistics and JSON
+ * Platform-independent; the clock is the port's.
+ */
+
+#include "bench.h"
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Per-call figures of the current run (one runner at a time)
+static double s_per_call[BENCH_MAX_SAMPLES];
+
+/* ============================================================================
+ * TIMING
+ * ============================================================================ */
+
+static uint64_t time_batch(const bench_case_t *c, uint32_t batch)
+{
+    uint64_t start = bench_port_cycles();
+    for (uint32_t i = 0; i < batch; i++) {
+        c->fn(c->ctx);
+    }
+    return bench_port_cycles() - start;
+}
+
+// Cost of the two clock reads around a batch: the cheapest of a few tries
+static uint64_t clock_overhead(void)
+{
+    uint64_t best = UINT64_MAX;
+    for (int i = 0; i < 32; i++) {
+        uint64_t start = bench_port_cycles();
+        uint64_t took = bench_port_cycles() - start;
+        if (took < best) {
+            best = took;
+        }
+    }
+    return best;
+}
+
+static int cmp_double(const void *a, const void *b)
+{
+    double x = *(const double *)a;
+    double y = *(const double *)b;
+    return x < y ? -1 : x > y;
+}
+
+// Nearest-rank percentile of sorted values
+static double percentile(const double *sorted, uint32_t n, int pct)
+{
+    uint32_t rank = (uint32_t)((pct * (uint64_t)n + 99) / 100);
+    return sorted[rank > 0 ? rank - 1 : 0];
+}
+
+esp_err_t bench_run(const bench_case_t *c, const bench_config_t *cfg, bench_result_t *out)
+{
+    if (c == NULL || c->fn == NULL || cfg->samples == 0 || cfg->samples > BENCH_MAX_SAMPLES) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    uint64_t overhead = clock_overhead();
+
+    // Grow the batch until a sample is long enough to time (this warms too)
+    uint32_t batch = 1;
+    while (batch < BENCH_MAX_BATCH && time_batch(c, batch) < BENCH_MIN_SAMPLE_CYCLES) {
+        batch *= 2;
+    }
+    for (uint32_t i = 0; i < cfg->warmup; i++) {
+        time_batch(c, batch);
+    }
+
+    double sum = 0;
+    for (uint32_t i = 0; i < cfg->samples; i++) {
+        uint64_t took = time_batch(c, batch);
+        took = took > overhead ? took - overhead : 0;
+        s_per_call[i] = (double)took / batch;
+        sum += s_per_call[i];
+    }
+    uint32_t n = cfg->samples;
+    double mean = sum / n;
+    double var = 0;
+    for (uint32_t i = 0; i < n; i++) {
+        var += (s_per_call[i] - mean) * (s_per_call[i] - mean);
+    }
+    qsort(s_per_call, n, sizeof(s_per_call[0]), cmp_double);
+
+    *out = (bench_result_t){
+        .name = c->name,
+        .batch = batch,
+        .samples = n,
+        .min_cycles = s_per_call[0],
+        .median_cycles = percentile(s_per_call, n, 50),
+        .mean_cycles = mean,
+        .p90_cycles = percentile(s_per_call, n, 90),
+        .max_cycles = s_per_call[n - 1],
+        .stddev_cycles = n > 1 ? sqrt(var / (n - 1)) : 0,
+    };
+    out->median_ns = out->median_cycles * 1e9 / (double)bench_port_cycle_hz();
+    return ESP_OK;
+}
+
+void bench_print(FILE *f, const bench_result_t *r, bool print_header)
+{
+    if (print_header) {
+        fprintf(f, "%-22s %8s %10s %10s %10s %10s %10s\n",
+                "benchmark", "batch", "min cyc", "median", "p90", "stddev", "median ns");
+    }
+    fprintf(f, "%-22s %8lu %10.1f %10.1f %10.1f %10.1f %10.1f\n", r->name, (unsigned long)r->batch,
+            r->min_cycles, r->median_cycles, r->p90_cycles, r->stddev_cycles, r->median_ns);
+}
+
+/* ============================================================================
+ * JSON
+ * ============================================================================ */
+
+void bench_json_open(bench_json_t *j, FILE *f, const char *label, const bench_config_t *cfg)
+{
+    j->f = f;
+    j->first = true;
+    fprintf(f, "{\"format\":%d,\"platform\":\"%s\",\"clock\":\"%s\",\"cycle_hz\":%llu,"
+            "\"label\":\"%s\",\"warmup\":%lu,\"samples\":%lu,\"benchmarks\":[",
+            BENCH_FORMAT_VERSION, bench_port_platform(), bench_port_clock(),
+            (unsigned long long)bench_port_cycle_hz(), label != NULL ? label : "",
+            (unsigned long)cfg->warmup, (unsigned long)cfg->samples);
+}
+
+void bench_json_add(bench_json_t *j, const bench_result_t *r)
+{
+    fprintf(j->f, "%s\n{\"name\":\"%s\",\"batch\":%lu,\"samples\":%lu,\"min_cycles\":%.2f,"
+            "\"median_cycles\":%.2f,\"mean_cycles\":%.2f,\"p90_cycles\":%.2f,\"max_cycles\":%.2f,"
+            "\"stddev_cycles\":%.2f,\"median_ns\":%.2f}",
+            j->first ? "" : ",", r->name, (unsigned long)r->batch, (unsigned long)r->samples,
+            r->min_cycles, r->median_cycles, r->mean_cycles, r->p90_cycles, r->max_cycles,
+            r->stddev_cycles, r->median_ns);
+    j->first = false;
+}
+
+void bench_json_close(bench_json_t *j)
+{
+    fputs("\n]}\n", j->f);
+}
+
+esp_err_t bench_json_find(const char *json, const char *name, const char *field, double *out)
+{
+    char key[64];
+    snprintf(key, sizeof(key), "{\"name\":\"%s\",", name);
+    const char *entry = strstr(json, key);
+    if (entry == NULL) {
+        return ESP_ERR_NOT_FOUND;
+    }
+    const char *end = strchr(entry, '}');
+    snprintf(key, sizeof(key), "\"%s\":", field);
+    const char *value = strstr(entry, key);
+    if (value == NULL || (end != NULL && value > end)) {
+        return ESP_ERR_NOT_FOUND;
+    }
+    *out = strtod(value + strlen(key), NULL);
+    return ESP_OK;
+}
@@ -0,0 +1,114 @@
+/*
+ * Microbenchmarks
+ * Times small firmware kernels in CPU cycles, on the target (CCOUNT via
+ * esp_cpu_get_cycle_count()) and on the host (rdtsc, or clock_gettime where
+ * there is no TSC), with the same cases and the same statistics, and emits
+ * the results as JSON so runs can be compared across commits.
+ *
+ * A case is a function called `batch` times per sample: the batch is grown
+ * until one sample takes at least BENCH_MIN_SAMPLE_CYCLES, so the two clock
+ * reads around it stay small, and their measured cost is then subtracted.
+ * Each run starts with untimed warmup samples (caches, branch predictors,
+ * lazily initialised state), then records `samples` samples and reports per
+ * call: min, median, mean, p90, max and standard deviation.
+ *
+ * JSON (one object, one benchmark per line; readers match on "name"):
+ *
+ *   {"format":1,"platform":"esp32h2","clock":"ccount","cycle_hz":96000000,
+ *    "label":"v1.2-3-gabc","warmup":N,"samples":N,"benchmarks":[
+ *   {"name":"pump_control_step","batch":N,"samples":N,"min_cycles":x,
+ *    "median_cycles":x,"mean_cycles":x,"p90_cycles":x,"max_cycles":x,
+ *    "stddev_cycles":x,"median_ns":x},
+ *   ...]}
+ */
+
+#ifndef BENCH_H
+#define BENCH_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include "esp_err.h"
+
+#define BENCH_FORMAT_VERSION        1
+#define BENCH_MAX_SAMPLES           256
+#define BENCH_MIN_SAMPLE_CYCLES     20000
+#define BENCH_MAX_BATCH             (1u << 16)
+
+typedef void (*bench_fn_t)(void *ctx);
+
+typedef struct {
+    const char *name;
+    bench_fn_t  fn;
+    void       *ctx;
+} bench_case_t;
+
+typedef struct {
+    uint32_t warmup;            // Untimed samples first
+    uint32_t samples;           // Timed samples, at most BENCH_MAX_SAMPLES
+} bench_config_t;
+
+#define BENCH_CONFIG_DEFAULT() { .warmup = 8, .samples = 64 }
+
+typedef struct {
+    const char *name;
+    uint32_t batch;             // Calls per sample
+    uint32_t samples;
+    // Per call, in cycles of the port clock
+    double   min_cycles;
+    double   median_cycles;
+    double   mean_cycles;
+    double   p90_cycles;
+    double   max_cycles;
+    double   stddev_cycles;
+    double   median_ns;
+} bench_result_t;
+
+/* ============================================================================
+ * PORT (bench_port_esp.c, host/bench_port_posix.c)
+ * ============================================================================ */
+
+uint64_t bench_port_cycles(void);
+uint64_t bench_port_cycle_hz(void);
+const char *bench_port_clock(void);         // "ccount", "rdtsc", "clock_gettime"
+const char *bench_port_platform(void);      // "esp32h2", "host"
+
+/* ============================================================================
+ * RUNNING
+ * ============================================================================ */
+
+/**
+ * Warm up, size the batch and time one case
+ * @return ESP_OK, ESP_ERR_INVALID_ARG for a bad config
+ */
+esp_err_t bench_run(const bench_case_t *c, const bench_config_t *cfg, bench_result_t *out);
+
+/**
+ * Print a table row (header first with print_header)
+ */
+void bench_print(FILE *f, const bench_result_t *r, bool print_header);
+
+/* ============================================================================
+ * JSON
+ * ============================================================================ */
+
+typedef struct {
+    FILE *f;
+    bool  first;
+} bench_json_t;
+
+/**
+ * Write the header; label identifies the build (commit, version)
+ */
+void bench_json_open(bench_json_t *j, FILE *f, const char *label, const bench_config_t *cfg);
+void bench_json_add(bench_json_t *j, const bench_result_t *r);
+void bench_json_close(bench_json_t *j);
+
+/**
+ * Find a benchmark's numeric field in JSON text from bench_json_*()
+ * (any log text around it is skipped)
+ * @return ESP_OK, ESP_ERR_NOT_FOUND
+ */
+esp_err_t bench_json_find(const char *json, const char *name, const char *field, double *out);
+
+#endif // BENCH_H
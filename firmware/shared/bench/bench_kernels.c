@@ -0,0 +1,135 @@
+/*
+ * Microbenchmark suite - cases
+ * Platform-independent; the host runner links the same firmware sources.
+ */
+
+#include "bench_kernels.h"
+
+#include <string.h>
+#include "esp_log.h"
+#include "ble_provision.h"
+#include "ble_provision_priv.h"
+#include "config_derived.h"
+#include "water_level.h"
+#include "pump_control.h"
+#include "metrics.h"
+#include "trace.h"
+
+// Tank config command (0x01): 200 cm high, 100 cm wide, 5 cm offset, 5 s
+static const uint8_t TANK_CONFIG_CMD[] = { 0x01, 0x00, 0xC8, 0x00, 0x64, 0x05, 0x00, 0x05 };
+
+static const float VALID_PINGS[WATER_LEVEL_NUM_SAMPLES] = { 120.4f, 119.8f, 121.0f, 120.1f, 119.9f };
+static const float NOISY_PINGS[WATER_LEVEL_NUM_SAMPLES] = { -1.0f, 120.1f, 999.0f, 119.8f, 120.4f };
+
+static device_config_t s_cfg;
+static config_derived_t s_dc;
+static pump_control_t s_pump;
+static water_level_t s_level;
+static device_status_t s_status;
+static uint8_t s_out[METRICS_ENCODED_MAX > GATTS_STATUS_MAX_LEN ? METRICS_ENCODED_MAX
+                                                                : GATTS_STATUS_MAX_LEN];
+// Results land here so the compiler cannot drop the calls
+static volatile uint32_t s_sink;
+
+/* ============================================================================
+ * CASES
+ * ============================================================================ */
+
+static void run_water_level_compute(void *ctx)
+{
+    s_sink += water_level_compute(ctx, WATER_LEVEL_NUM_SAMPLES, &s_dc, &s_level);
+}
+
+static void run_config_derive(void *ctx)
+{
+    (void)ctx;
+    config_derive(&s_cfg, &s_dc);
+    s_sink += s_dc.report_interval_ms;
+}
+
+static void run_parse_config_data(void *ctx)
+{
+    (void)ctx;
+    ble_core_on_write(TANK_CONFIG_CMD, sizeof(TANK_CONFIG_CMD));
+}
+
+static void run_status_response(void *ctx)
+{
+    (void)ctx;
+    uint16_t len;
+    ble_core_on_status_read(s_out, &len);
+    s_sink += len;
+}
+
+static void run_beacon_encode(void *ctx)
+{
+    (void)ctx;
+    ble_beacon_encode(&s_status, (uint8_t)s_sink, s_out);
+    s_sink += s_out[0];
+}
+
+static void run_metrics_encode(void *ctx)
+{
+    (void)ctx;
+    s_sink += (uint32_t)metrics_encode(s_out, sizeof(s_out));
+}
+
+static void run_trace_encode(void *ctx)
+{
+    (void)ctx;
+    static const trace_event_t ev = {
+        .t_us = 123456789, .id = TRACE_REPORT_RX, .task = 3, .nargs = 2, .arg = { 0x1A2B, 42 },
+    };
+    s_sink += (uint32_t)trace_encode(&ev, s_out);
+}
+
+static void run_pump_control_step(void *ctx)
+{
+    (void)ctx;
+    pump_control_step(&s_pump, &s_dc);
+    s_sink += s_pump.running;
+}
+
+static const bench_case_t s_cases[] = {
+    { "water_level_compute",    run_water_level_compute,    (void *)VALID_PINGS },
+    { "water_level_reject",     run_water_level_compute,    (void *)NOISY_PINGS },
+    { "config_derive",          run_config_derive,          NULL },
+    { "parse_config_data",      run_parse_config_data,      NULL },
+    { "status_response",        run_status_response,        NULL },
+    { "beacon_encode",          run_beacon_encode,          NULL },
+    { "metrics_encode",         run_metrics_encode,         NULL },
+    { "trace_encode",           run_trace_encode,           NULL },
+    { "pump_control_step",      run_pump_control_step,      NULL },
+};
+
+/* ============================================================================
+ * SETUP
+ * ============================================================================ */
+
+esp_err_t bench_kernels_setup(void)
+{
+    esp_log_level_set("BLE_PROV", ESP_LOG_WARN);
+    esp_log_level_set("PUMP", ESP_LOG_WARN);
+
+    ble_provision_config_snapshot(&s_cfg);
+    config_derive(&s_cfg, &s_dc);
+    if (!water_level_compute(VALID_PINGS, WATER_LEVEL_NUM_SAMPLES, &s_dc, &s_level)) {
+        return ESP_FAIL;
+    }
+    // Between the thresholds: the control pass decides to do nothing
+    pump_control_init(&s_pump);
+    pump_control_sensor_update(&s_pump, 50);
+
+    memset(&s_status, 0, sizeof(s_status));
+    s_status.node_type = NODE_TYPE_SENSOR;
+    s_status.zigbee_connected = true;
+    s_status.water_level_percent = s_level.percent;
+    s_status.water_level_cm = s_level.cm;
+    return ESP_OK;
+}
+
+int bench_kernels(const bench_case_t **cases)
+{
+    *cases = s_cases;
+    return (int)(sizeof(s_cases) / sizeof(s_cases[0]));
+}
@@ -0,0 +1,36 @@
+/*
+ * Microbenchmark suite: the firmware's hot kernels
+ *
+ *   water_level_compute   level math over five valid pings
+ *   water_level_reject    the same with two pings rejected by the range filter
+ *   config_derive         derived config block (on every config change)
+ *   parse_config_data     tank config write, through the GATT write entry
+ *   status_response       status characteristic serialisation
+ *   beacon_encode         advertising status beacon
+ *   metrics_encode        diagnostics snapshot (Zigbee attribute, BLE read)
+ *   trace_encode          one trace record for the UART stream
+ *   pump_control_step     one controller pass, sensor online, no switching
+ *
+ * Cases call the real functions with their side effects: parse_config_data
+ * rewrites the running config with the same values, pump_control_step and
+ * the parse emit trace points.
+ */
+
+#ifndef BENCH_KERNELS_H
+#define BENCH_KERNELS_H
+
+#include "esp_err.h"
+#include "bench.h"
+
+/**
+ * Prepare the cases. Call after ble_provision_init(); quiets the
+ * BLE_PROV and PUMP logs to warnings.
+ */
+esp_err_t bench_kernels_setup(void);
+
+/**
+ * @return Number of cases, *cases set to the table
+ */
+int bench_kernels(const bench_case_t **cases);
+
+#endif // BENCH_KERNELS_H
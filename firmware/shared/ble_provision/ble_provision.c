@@ -1,138 +1,182 @@
 /*
  * BLE Provisioning Implementation
- * Provides BLE GATT server for device configuration
+ * Provides BLE GATT server for device configuration.
+ * Host-independent core; the BLE host lives in ble_provision_bluedroid.c or
+ * ble_provision_nimble.c (selected by CONFIG_BT_NIMBLE_ENABLED).
  */
 
 #include "ble_provision.h"
+#include "ble_provision_priv.h"
+#include "config_store.h"
+#include "config_derived.h"
+#include <stdio.h>
 #include <string.h>
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
 #include "freertos/semphr.h"
 #include "esp_log.h"
 #include "esp_mac.h"
+#include "esp_timer.h"
+#include "esp_system.h"
 #include "nvs_flash.h"
 #include "nvs.h"
-#include "esp_bt.h"
-#include "esp_gap_ble_api.h"
-#include "esp_gatts_api.h"
-#include "esp_bt_main.h"
-#include "esp_gatt_common_api.h"
+#include "radio_coex.h"
+#include "metrics.h"
+#include "trace.h"
 
 static const char *TAG = "BLE_PROV";
 
-/* ============================================================================
- * BLE CONFIGURATION
- * ============================================================================ */
-
-#define DEVICE_NAME_PREFIX      "Cultivio-"
-#define GATTS_SERVICE_UUID      0x00FF
-#define GATTS_CHAR_UUID_CONFIG  0xFF01
-#define GATTS_CHAR_UUID_STATUS  0xFF02
-#define GATTS_CHAR_UUID_CMD     0xFF03
-
-#define GATTS_NUM_HANDLE        8
-#define PROFILE_NUM             1
-#define PROFILE_APP_ID          0
-
-#define ADV_CONFIG_FLAG         (1 << 0)
-#define SCAN_RSP_CONFIG_FLAG    (1 << 1)
-
 /* ============================================================================
  * GLOBAL VARIABLES
  * ============================================================================ */
 
+// Writer's working copy; readers use the published snapshot instead
 static device_config_t g_device_config = {0};
 static prov_state_t g_prov_state = PROV_STATE_NOT_PROVISIONED;
 static prov_node_type_t g_node_type = NODE_TYPE_SENSOR;
 static void (*g_complete_callback)(const device_config_t *config) = NULL;
 
-// Mutex for thread-safe config access (FIX: BUG #1)
+// Serialises config writers (FIX: BUG #1). Readers never take it.
 static SemaphoreHandle_t g_config_mutex = NULL;
 
-static uint8_t adv_config_done = 0;
-static uint16_t gatts_handle_table[GATTS_NUM_HANDLE];
-static uint8_t service_uuid[16] = {
-    0xfb, 0x34, 0x9b, 0x5f, 0x80, 0x00, 0x00, 0x80,
-    0x00, 0x10, 0x00, 0x00, 0xFF, 0x00, 0x00, 0x00,
-};
+// Whole-value long read (NimBLE): bytes handed out so far, which is the
+// offset the client asks for next
+typedef struct {
+    uint16_t served;
+    int64_t  last_us;
+} long_read_t;
 
-static esp_ble_adv_data_t adv_data = {
-    .set_scan_rsp = false,
-    .include_name = true,
-    .include_txpower = true,
-    .min_interval = 0x0006,
-    .max_interval = 0x0010,
-    .appearance = 0x00,
-    .manufacturer_len = 0,
-    .p_manufacturer_data = NULL,
-    .service_data_len = 0,
-    .p_service_data = NULL,
-    .service_uuid_len = sizeof(service_uuid),
-    .p_service_uuid = service_uuid,
-    .flag = (ESP_BLE_ADV_FLAG_GEN_DISC | ESP_BLE_ADV_FLAG_BREDR_NOT_SPT),
-};
+// Metrics characteristic: snapshot served across one long read
+static uint8_t g_metrics_snapshot[GATTS_METRICS_MAX_LEN];
+static uint16_t g_metrics_snapshot_len = 0;
+static long_read_t g_metrics_long_read;
+static uint8_t g_links_snapshot[GATTS_LINKS_MAX_LEN];
+static uint16_t g_links_snapshot_len = 0;
+static long_read_t g_links_long_read;
 
-static esp_ble_adv_data_t scan_rsp_data = {
-    .set_scan_rsp = true,
-    .include_name = true,
-    .include_txpower = true,
-    .appearance = 0x00,
-    .manufacturer_len = 0,
-    .p_manufacturer_data = NULL,
-    .service_data_len = 0,
-    .p_service_data = NULL,
-    .service_uuid_len = sizeof(service_uuid),
-    .p_service_uuid = service_uuid,
-    .flag = (ESP_BLE_ADV_FLAG_GEN_DISC | ESP_BLE_ADV_FLAG_BREDR_NOT_SPT),
-};
+// Published config snapshots, see ble_provision_config_snapshot(). Each
+// slot carries the config and its derived block, published together, and a
+// sequence count that is odd while the writer is refilling it.
+typedef struct {
+    uint32_t seq;
+    device_config_t config;
+    config_derived_t derived;
+} config_slot_t;
 
-static esp_ble_adv_params_t adv_params = {
-    .adv_int_min = 0x20,
-    .adv_int_max = 0x40,
-    .adv_type = ADV_TYPE_IND,
-    .own_addr_type = BLE_ADDR_TYPE_PUBLIC,
-    .channel_map = ADV_CHNL_ALL,
-    .adv_filter_policy = ADV_FILTER_ALLOW_SCAN_ANY_CON_ANY,
+static config_slot_t g_config_slots[CONFIG_SNAPSHOT_SLOTS];
+static const config_slot_t *g_config_current = &g_config_slots[0];
+static uint32_t g_config_generation = 0;
+
+// Status beacon (manufacturer data), see ble_provision.h for layout
+static uint8_t g_beacon_data[BLE_BEACON_LEN] = {
+    BLE_BEACON_COMPANY_ID & 0xFF, (BLE_BEACON_COMPANY_ID >> 8) & 0xFF,
+    BLE_BEACON_FORMAT_VERSION << 4,
 };
+static bool g_ble_stack_up = false;         // Controller + BLE host running
+static bool g_ble_connected = false;        // Central connected (advertising paused)
 
-/* ============================================================================
- * GATT SERVER CALLBACKS
- * ============================================================================ */
+// Current advertising interval (units of 0.625 ms), set by the advertising policy
+static uint16_t g_adv_int_min = BLE_ADV_FAST_INT_MIN;
+static uint16_t g_adv_int_max = BLE_ADV_FAST_INT_MAX;
 
-static void gatts_profile_event_handler(esp_gatts_cb_event_t event,
-                                        esp_gatt_if_t gatts_if,
-                                        esp_ble_gatts_cb_param_t *param);
-
-static struct gatts_profile_inst {
-    esp_gatts_cb_t gatts_cb;
-    uint16_t gatts_if;
-    uint16_t app_id;
-    uint16_t conn_id;
-    uint16_t service_handle;
-    esp_gatt_srvc_id_t service_id;
-    uint16_t char_handle;
-    esp_bt_uuid_t char_uuid;
-    esp_gatt_perm_t perm;
-    esp_gatt_char_prop_t property;
-    uint16_t descr_handle;
-    esp_bt_uuid_t descr_uuid;
-} gl_profile_tab[PROFILE_NUM] = {
-    [PROFILE_APP_ID] = {
-        .gatts_cb = gatts_profile_event_handler,
-        .gatts_if = ESP_GATT_IF_NONE,
-    },
-};
+// BLE init measurements (see ble_provision_get_init_stats)
+static ble_init_stats_t g_init_stats = {0};
+static int64_t g_init_start_us = 0;
 
 /* ============================================================================
  * FORWARD DECLARATIONS
  * ============================================================================ */
 
 void ble_handle_pump_command(uint8_t command, uint16_t duration_minutes);
+static void adv_set_on_air(bool on_air);
+static bool adv_should_restart(void);
+static void adv_open_fast_window(void);
+static void idle_timer_rearm(void);
+static void idle_timer_stop(void);
+
+/* ============================================================================
+ * CONFIG SNAPSHOT
+ * ============================================================================ */
+
+/**
+ * Copy the current slot (either part may be NULL). A reader that was
+ * preempted while the ring came round to its slot sees the count move and
+ * copies again from the new current slot.
+ */
+static void config_read(device_config_t *config, config_derived_t *derived) {
+    const config_slot_t *slot;
+    uint32_t seq;
+    do {
+        slot = __atomic_load_n(&g_config_current, __ATOMIC_ACQUIRE);
+        seq = __atomic_load_n(&slot->seq, __ATOMIC_ACQUIRE);
+        if (config) {
+            *config = slot->config;
+        }
+        if (derived) {
+            *derived = slot->derived;
+        }
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+    } while ((seq & 1) || seq != __atomic_load_n(&slot->seq, __ATOMIC_RELAXED));
+}
+
+void ble_provision_config_snapshot(device_config_t *config) {
+    config_read(config, NULL);
+}
+
+void ble_provision_config_derived(config_derived_t *derived) {
+    config_read(NULL, derived);
+}
+
+uint32_t ble_provision_config_generation(void) {
+    return __atomic_load_n(&g_config_generation, __ATOMIC_ACQUIRE);
+}
+
+/**
+ * Copy the working config into the next slot, compile its derived block
+ * and make it current. Caller holds g_config_mutex (or runs before any
+ * reader exists).
+ */
+static void config_publish(void) {
+    uint32_t next = g_config_generation + 1;
+    config_slot_t *slot = &g_config_slots[next % CONFIG_SNAPSHOT_SLOTS];
+    
+    __atomic_add_fetch(&slot->seq, 1, __ATOMIC_ACQ_REL);
+    slot->config = g_device_config;
+    config_derive(&slot->config, &slot->derived);
+    __atomic_add_fetch(&slot->seq, 1, __ATOMIC_RELEASE);
+    
+    // Reported once per change instead of on every control pass
+    if (slot->derived.defaults_applied) {
+        ESP_LOGW(TAG, "Config incomplete - defaults used for unset fields");
+    }
+    if (slot->derived.pump_timeout_capped) {
+        ESP_LOGW(TAG, "Pump timeout capped at 2 hours for safety (was %u min)",
+                 slot->config.pump_timeout_minutes);
+    }
+    
+    __atomic_store_n(&g_config_current, slot, __ATOMIC_RELEASE);
+    __atomic_store_n(&g_config_generation, next, __ATOMIC_RELEASE);
+}
+
+/**
+ * Whole-config check before publishing (same limits as the BLE commands)
+ */
+static bool config_validate(const device_config_t *cfg) {
+    return cfg->tank_height_cm >= 50 && cfg->tank_height_cm <= 1000 &&
+           cfg->tank_diameter_cm >= 30 && cfg->tank_diameter_cm <= 500 &&
+           cfg->sensor_offset_cm <= 50 &&
+           cfg->report_interval_sec >= 1 && cfg->report_interval_sec <= 300 &&
+           cfg->pump_on_threshold < cfg->pump_off_threshold &&
+           cfg->pump_off_threshold <= 100 &&
+           cfg->pump_timeout_minutes >= 1 && cfg->pump_timeout_minutes <= 120 &&
+           cfg->zigbee_channel >= 11 && cfg->zigbee_channel <= 26;
+}
 
 /* ============================================================================
  * HELPER FUNCTIONS
  * ============================================================================ */
 
+// Writer side: updates g_device_config.device_name (caller holds the mutex)
 static void set_device_name(void) {
     char name[64];  // FIX: BUG #6 - Larger buffer for safety
     uint8_t mac[6];
@@ -152,7 +196,9 @@ static void set_device_name(void) {
     // FIX: BUG #6 - Ensure null termination and bounds check
     name[sizeof(name) - 1] = '\0';
     
-    esp_ble_gap_set_device_name(name);
+    if (g_ble_stack_up) {
+        ble_backend_set_name(name);
+    }
     
     // Copy to config with bounds checking
     strncpy(g_device_config.device_name, name, sizeof(g_device_config.device_name) - 1);
@@ -161,16 +207,28 @@ static void set_device_name(void) {
     ESP_LOGI(TAG, "Device name set to: %s", name);
 }
 
+// Take the config mutex, recording the wait (METRIC_CONFIG_LOCK_WAIT_US)
+static bool config_lock(void) {
+    if (g_config_mutex == NULL) {
+        return false;
+    }
+    int64_t start_us = esp_timer_get_time();
+    bool taken = xSemaphoreTake(g_config_mutex, pdMS_TO_TICKS(1000)) == pdTRUE;
+    metrics_observe_us(METRIC_CONFIG_LOCK_WAIT_US, esp_timer_get_time() - start_us);
+    return taken;
+}
+
 static void parse_config_data(const uint8_t *data, uint16_t len) {
     if (len < 1) return;
     
     // Acquire mutex for thread-safe config access (FIX: BUG #1)
-    if (g_config_mutex == NULL || xSemaphoreTake(g_config_mutex, pdMS_TO_TICKS(1000)) != pdTRUE) {
+    if (!config_lock()) {
         ESP_LOGE(TAG, "Failed to acquire config mutex");
         return;
     }
     
     uint8_t cmd = data[0];
+    bool adv_rearm = false;
     
     switch (cmd) {
         case 0x00: // Set device role (NEW!)
@@ -323,7 +381,7 @@ static void parse_config_data(const uint8_t *data, uint16_t len) {
                 int written = snprintf(temp_name, sizeof(temp_name), "%s%s", 
                                      DEVICE_NAME_PREFIX, g_device_config.custom_name);
                 
-                if (written >= sizeof(g_device_config.device_name)) {
+                if (written >= (int)sizeof(g_device_config.device_name)) {
                     ESP_LOGE(TAG, "Device name too long after prefix! Truncating.");
                     size_t max_custom = sizeof(g_device_config.device_name) - strlen(DEVICE_NAME_PREFIX) - 1;
                     if (max_custom < sizeof(g_device_config.custom_name)) {
@@ -345,7 +403,9 @@ static void parse_config_data(const uint8_t *data, uint16_t len) {
             if (len >= 2) {
                 // Data format: [0x06, password_length, password_bytes...]
                 uint8_t pwd_len = data[1];
-                if (pwd_len >= 4 && pwd_len < MAX_PASSWORD_LENGTH && len >= (2 + pwd_len)) {
+                // A NUL inside would leave a shorter (or empty) password enabled
+                if (pwd_len >= 4 && pwd_len < MAX_PASSWORD_LENGTH && len >= (2 + pwd_len) &&
+                    memchr(&data[2], '\0', pwd_len) == NULL) {
                     memset(g_device_config.password, 0, sizeof(g_device_config.password));
                     memcpy(g_device_config.password, &data[2], pwd_len);
                     g_device_config.password[pwd_len] = '\0';
@@ -363,6 +423,9 @@ static void parse_config_data(const uint8_t *data, uint16_t len) {
                     g_device_config.password_enabled = false;
                     memset(g_device_config.password, 0, sizeof(g_device_config.password));
                     ESP_LOGI(TAG, "Password disabled");
+                } else {
+                    ESP_LOGW(TAG, "Invalid password (length %d, must be 4-%d bytes without NUL)",
+                             pwd_len, MAX_PASSWORD_LENGTH - 1);
                 }
             }
             break;
@@ -379,10 +442,42 @@ static void parse_config_data(const uint8_t *data, uint16_t len) {
             }
             break;
             
+        case 0x08: // Set advertising policy
+            if (len >= 2) {
+                uint8_t policy = data[1];
+                if (policy < BLE_ADV_POLICY_MAX) {
+                    g_device_config.ble_adv_policy = policy;
+                    ESP_LOGI(TAG, "Advertising policy set to: %d", policy);
+                    adv_rearm = ble_status_is_active();  // Once published
+                } else {
+                    ESP_LOGW(TAG, "Invalid advertising policy: %d", policy);
+                }
+            }
+            break;
+            
+        case 0x09: // Set lazy BLE triggers and idle timeout
+            if (len >= 4) {
+                uint8_t triggers = data[1];
+                uint16_t idle_sec = (data[2] << 8) | data[3];
+                if (idle_sec != 0 && idle_sec < 30) {
+                    ESP_LOGW(TAG, "Invalid BLE idle timeout: %d (must be >= 30 sec, 0=default)", idle_sec);
+                } else {
+                    g_device_config.ble_triggers = triggers;
+                    g_device_config.ble_idle_timeout_sec = idle_sec;
+                    ESP_LOGI(TAG, "BLE triggers: 0x%02X, idle timeout: %d s", triggers, idle_sec);
+                }
+            }
+            break;
+            
         case 0x10: // Complete provisioning
             g_device_config.provisioned = true;
             g_device_config.provision_timestamp = esp_log_timestamp();
-            ble_provision_save_config(&g_device_config);
+            // Mutex already held: save directly (ble_provision_save_config
+            // would wait on it and time out)
+            if (config_store_save(&g_device_config) != ESP_OK) {
+                ESP_LOGE(TAG, "Failed to save configuration");
+            }
+            config_publish();
             g_prov_state = PROV_STATE_PROVISIONED;
             ESP_LOGI(TAG, "Provisioning complete! Role: %s",
                      g_device_config.node_type == NODE_TYPE_SENSOR ? "SENSOR" :
@@ -398,200 +493,213 @@ static void parse_config_data(const uint8_t *data, uint16_t len) {
             break;
     }
     
+    // Publish the result. An update that would turn a valid config invalid
+    // is dropped and the working copy reset to the active snapshot; a config
+    // that was already out of range (old firmware) can still be repaired.
+    // Only writers refill slots, and we are the writer: no copy needed
+    const device_config_t *active = &g_config_current->config;
+    if (config_validate(&g_device_config) || !config_validate(active)) {
+        if (memcmp(&g_device_config, active, sizeof(g_device_config)) != 0) {
+            config_publish();
+            // Live changes on a provisioned node survive a reboot; only the
+            // keys that changed are rewritten. Mutex already held.
+            if (g_device_config.provisioned && config_store_save(&g_device_config) != ESP_OK) {
+                ESP_LOGE(TAG, "Failed to save configuration");
+            }
+        }
+    } else {
+        ESP_LOGE(TAG, "Config update rejected - keeping active configuration");
+        g_device_config = *active;
+    }
+    
     // Release mutex (FIX: BUG #1)
     xSemaphoreGive(g_config_mutex);
+    
+    // The fast window reads the policy from the snapshot just published
+    if (adv_rearm) {
+        adv_open_fast_window();
+    }
 }
 
 static void prepare_status_response(uint8_t *data, uint16_t *len) {
     // Clear buffer first to prevent stack memory exposure (FIX: SEC #4)
-    memset(data, 0, 64);
-    
-    // Acquire mutex for thread-safe config access (FIX: BUG #1)
-    if (g_config_mutex && xSemaphoreTake(g_config_mutex, pdMS_TO_TICKS(100)) == pdTRUE) {
-        data[0] = g_node_type;
-        data[1] = g_prov_state;
-        data[2] = g_device_config.provisioned ? 1 : 0;
-        data[3] = (g_device_config.tank_height_cm >> 8) & 0xFF;
-        data[4] = g_device_config.tank_height_cm & 0xFF;
-        data[5] = g_device_config.pump_on_threshold;
-        data[6] = g_device_config.pump_off_threshold;
-        data[7] = (g_device_config.zigbee_pan_id >> 8) & 0xFF;
-        data[8] = g_device_config.zigbee_pan_id & 0xFF;
-        data[9] = g_device_config.zigbee_channel;
-        data[10] = g_device_config.password_change_required ? 1 : 0;
-        *len = 11;
-        xSemaphoreGive(g_config_mutex);
-    } else {
-        ESP_LOGW(TAG, "Could not acquire mutex for status response");
-        *len = 0;
+    memset(data, 0, GATTS_STATUS_MAX_LEN);
+    
+    // Lock-free: a consistent copy of the published snapshot
+    device_config_t cfg;
+    ble_provision_config_snapshot(&cfg);
+    data[0] = g_node_type;
+    data[1] = g_prov_state;
+    data[2] = cfg.provisioned ? 1 : 0;
+    data[3] = (cfg.tank_height_cm >> 8) & 0xFF;
+    data[4] = cfg.tank_height_cm & 0xFF;
+    data[5] = cfg.pump_on_threshold;
+    data[6] = cfg.pump_off_threshold;
+    data[7] = (cfg.zigbee_pan_id >> 8) & 0xFF;
+    data[8] = cfg.zigbee_pan_id & 0xFF;
+    data[9] = cfg.zigbee_channel;
+    data[10] = cfg.password_change_required ? 1 : 0;
+    
+    // Advertising duty cycle (big endian)
+    ble_adv_stats_t adv;
+    ble_adv_get_stats(&adv);
+    data[11] = adv.policy;
+    data[12] = adv.phase;
+    data[13] = (adv.radio_on_ms >> 24) & 0xFF;
+    data[14] = (adv.radio_on_ms >> 16) & 0xFF;
+    data[15] = (adv.radio_on_ms >> 8) & 0xFF;
+    data[16] = adv.radio_on_ms & 0xFF;
+    data[17] = (adv.adv_events >> 24) & 0xFF;
+    data[18] = (adv.adv_events >> 16) & 0xFF;
+    data[19] = (adv.adv_events >> 8) & 0xFF;
+    data[20] = adv.adv_events & 0xFF;
+    
+    // Radio coexistence counters (big endian, saturated to 16 bits)
+    radio_coex_stats_t coex;
+    radio_coex_get_stats(&coex);
+    uint16_t coex_counters[4] = {
+        coex.ble_deferred > 0xFFFF ? 0xFFFF : coex.ble_deferred,
+        coex.zigbee_retried > 0xFFFF ? 0xFFFF : coex.zigbee_retried,
+        coex.zigbee_lost > 0xFFFF ? 0xFFFF : coex.zigbee_lost,
+        coex.reports_missed > 0xFFFF ? 0xFFFF : coex.reports_missed,
+    };
+    for (int i = 0; i < 4; i++) {
+        data[21 + i * 2] = (coex_counters[i] >> 8) & 0xFF;
+        data[22 + i * 2] = coex_counters[i] & 0xFF;
     }
+    *len = 29;
 }
 
 /* ============================================================================
- * GAP EVENT HANDLER
+ * BACKEND CALLBACKS
  * ============================================================================ */
 
-static void gap_event_handler(esp_gap_ble_cb_event_t event, esp_ble_gap_cb_param_t *param) {
-    switch (event) {
-        case ESP_GAP_BLE_ADV_DATA_SET_COMPLETE_EVT:
-            adv_config_done &= (~ADV_CONFIG_FLAG);
-            if (adv_config_done == 0) {
-                esp_ble_gap_start_advertising(&adv_params);
-            }
-            break;
-            
-        case ESP_GAP_BLE_SCAN_RSP_DATA_SET_COMPLETE_EVT:
-            adv_config_done &= (~SCAN_RSP_CONFIG_FLAG);
-            if (adv_config_done == 0) {
-                esp_ble_gap_start_advertising(&adv_params);
-            }
-            break;
-            
-        case ESP_GAP_BLE_ADV_START_COMPLETE_EVT:
-            if (param->adv_start_cmpl.status != ESP_BT_STATUS_SUCCESS) {
-                ESP_LOGE(TAG, "Advertising start failed");
-            } else {
-                ESP_LOGI(TAG, "Advertising started - ready for provisioning");
-                g_prov_state = PROV_STATE_PROVISIONING;
-            }
-            break;
-            
-        case ESP_GAP_BLE_ADV_STOP_COMPLETE_EVT:
-            ESP_LOGI(TAG, "Advertising stopped");
-            break;
-            
-        case ESP_GAP_BLE_UPDATE_CONN_PARAMS_EVT:
-            ESP_LOGI(TAG, "Connection params updated");
-            break;
-            
-        default:
-            break;
+void ble_core_on_host_ready(void) {
+    // May run before ble_backend_start() returns: apply the name directly
+    device_config_t cfg;
+    ble_provision_config_snapshot(&cfg);
+    ble_backend_set_name(cfg.device_name);
+}
+
+void ble_core_on_adv_started(void) {
+    if (!ble_provision_is_provisioned()) {
+        ESP_LOGI(TAG, "Advertising started - ready for provisioning");
+        g_prov_state = PROV_STATE_PROVISIONING;
+    } else {
+        ESP_LOGI(TAG, "Advertising started - status beacon active");
     }
+    
+    if (g_init_start_us != 0) {
+        g_init_stats.adv_ready_us = (uint32_t)(esp_timer_get_time() - g_init_start_us);
+        g_init_start_us = 0;
+        ESP_LOGI(TAG, "BLE init [%s]: start %lu ms, advertising after %lu ms, "
+                 "free heap %lu -> %lu bytes",
+                 g_init_stats.backend,
+                 (unsigned long)(g_init_stats.init_us / 1000),
+                 (unsigned long)(g_init_stats.adv_ready_us / 1000),
+                 (unsigned long)g_init_stats.heap_before,
+                 (unsigned long)g_init_stats.heap_after);
+    }
+    
+    adv_set_on_air(true);
 }
 
-/* ============================================================================
- * GATTS EVENT HANDLER
- * ============================================================================ */
+void ble_core_on_adv_stopped(void) {
+    adv_set_on_air(false);
+}
 
-static void gatts_event_handler(esp_gatts_cb_event_t event, esp_gatt_if_t gatts_if,
-                                esp_ble_gatts_cb_param_t *param) {
-    if (event == ESP_GATTS_REG_EVT) {
-        if (param->reg.status == ESP_GATT_OK) {
-            gl_profile_tab[param->reg.app_id].gatts_if = gatts_if;
-        } else {
-            ESP_LOGE(TAG, "Reg app failed, app_id %04x, status %d",
-                     param->reg.app_id, param->reg.status);
-            return;
-        }
+void ble_core_on_connect(void) {
+    TRACE(BLE_CONNECT, ble_provision_is_provisioned());
+    g_ble_connected = true;
+    adv_set_on_air(false);  // Controller stops advertising on connection
+    idle_timer_stop();
+}
+
+bool ble_core_on_disconnect(void) {
+    g_ble_connected = false;
+    // A long read never outlives its connection
+    g_metrics_long_read.served = 0;
+    g_links_long_read.served = 0;
+    idle_timer_rearm();
+    bool restart = adv_should_restart();
+    TRACE(BLE_DISCONNECT, restart);
+    return restart;
+}
+
+void ble_core_on_write(const uint8_t *data, uint16_t len) {
+    TRACE(BLE_WRITE, len);
+    parse_config_data(data, len);
+}
+
+void ble_core_on_status_read(uint8_t *data, uint16_t *len) {
+    prepare_status_response(data, len);
+}
+
+/**
+ * Count one response of a whole-value long read
+ *
+ * @return true if it continues the read in progress (same snapshot), false
+ *         if it starts a new one. A value that is an exact number of pieces
+ *         ends with an empty Read Blob at its length, still the same read.
+ */
+static bool long_read_continues(long_read_t *lr, uint16_t snapshot_len, uint16_t piece) {
+    int64_t now_us = esp_timer_get_time();
+    bool continues = lr->served > 0 && lr->served <= snapshot_len &&
+                     now_us - lr->last_us < GATTS_LONG_READ_TIMEOUT_MS * 1000LL;
+    lr->served = (continues ? lr->served : 0) + piece;
+    lr->last_us = now_us;
+    return continues;
+}
+
+static void metrics_snapshot_take(void) {
+    size_t n = metrics_encode(g_metrics_snapshot, sizeof(g_metrics_snapshot));
+    n += metrics_encode_tasks(g_metrics_snapshot + n, sizeof(g_metrics_snapshot) - n);
+    g_metrics_snapshot_len = (uint16_t)n;
+}
+
+void ble_core_on_metrics_read(uint16_t offset, uint8_t *data, uint16_t *len) {
+    if (offset == 0 || g_metrics_snapshot_len == 0) {
+        metrics_snapshot_take();
     }
+    *len = offset < g_metrics_snapshot_len ? g_metrics_snapshot_len - offset : 0;
+    memcpy(data, g_metrics_snapshot + offset, *len);
+}
 
-    for (int idx = 0; idx < PROFILE_NUM; idx++) {
-        if (gatts_if == ESP_GATT_IF_NONE ||
-            gatts_if == gl_profile_tab[idx].gatts_if) {
-            if (gl_profile_tab[idx].gatts_cb) {
-                gl_profile_tab[idx].gatts_cb(event, gatts_if, param);
-            }
-        }
+void ble_core_on_metrics_read_whole(uint16_t piece, uint8_t *data, uint16_t *len) {
+    if (!long_read_continues(&g_metrics_long_read, g_metrics_snapshot_len, piece)) {
+        metrics_snapshot_take();
     }
+    *len = g_metrics_snapshot_len;
+    memcpy(data, g_metrics_snapshot, *len);
 }
 
-static const uint8_t char_prop_rw = ESP_GATT_CHAR_PROP_BIT_READ | ESP_GATT_CHAR_PROP_BIT_WRITE;
-static const uint8_t char_prop_r = ESP_GATT_CHAR_PROP_BIT_READ | ESP_GATT_CHAR_PROP_BIT_NOTIFY;
+static void links_snapshot_take(void) {
+    g_links_snapshot_len = (uint16_t)link_quality_encode(g_links_snapshot, sizeof(g_links_snapshot));
+}
 
-static const esp_gatts_attr_db_t gatt_db[GATTS_NUM_HANDLE] = {
-    // Service Declaration
-    [0] = {{ESP_GATT_AUTO_RSP}, {ESP_UUID_LEN_16, (uint8_t *)&(uint16_t){ESP_GATT_UUID_PRI_SERVICE},
-            ESP_GATT_PERM_READ, sizeof(uint16_t), sizeof(GATTS_SERVICE_UUID), (uint8_t *)&(uint16_t){GATTS_SERVICE_UUID}}},
-    
-    // Config Characteristic Declaration
-    [1] = {{ESP_GATT_AUTO_RSP}, {ESP_UUID_LEN_16, (uint8_t *)&(uint16_t){ESP_GATT_UUID_CHAR_DECLARE},
-            ESP_GATT_PERM_READ, sizeof(uint8_t), sizeof(uint8_t), (uint8_t *)&char_prop_rw}},
-    
-    // Config Characteristic Value
-    [2] = {{ESP_GATT_RSP_BY_APP}, {ESP_UUID_LEN_16, (uint8_t *)&(uint16_t){GATTS_CHAR_UUID_CONFIG},
-            ESP_GATT_PERM_READ | ESP_GATT_PERM_WRITE, 512, 0, NULL}},
-    
-    // Status Characteristic Declaration
-    [3] = {{ESP_GATT_AUTO_RSP}, {ESP_UUID_LEN_16, (uint8_t *)&(uint16_t){ESP_GATT_UUID_CHAR_DECLARE},
-            ESP_GATT_PERM_READ, sizeof(uint8_t), sizeof(uint8_t), (uint8_t *)&char_prop_r}},
-    
-    // Status Characteristic Value
-    [4] = {{ESP_GATT_RSP_BY_APP}, {ESP_UUID_LEN_16, (uint8_t *)&(uint16_t){GATTS_CHAR_UUID_STATUS},
-            ESP_GATT_PERM_READ, 64, 0, NULL}},
-    
-    // Command Characteristic Declaration
-    [5] = {{ESP_GATT_AUTO_RSP}, {ESP_UUID_LEN_16, (uint8_t *)&(uint16_t){ESP_GATT_UUID_CHAR_DECLARE},
-            ESP_GATT_PERM_READ, sizeof(uint8_t), sizeof(uint8_t), (uint8_t *)&char_prop_rw}},
-    
-    // Command Characteristic Value
-    [6] = {{ESP_GATT_RSP_BY_APP}, {ESP_UUID_LEN_16, (uint8_t *)&(uint16_t){GATTS_CHAR_UUID_CMD},
-            ESP_GATT_PERM_READ | ESP_GATT_PERM_WRITE, 64, 0, NULL}},
-};
+void ble_core_on_links_read(uint16_t offset, uint8_t *data, uint16_t *len) {
+    if (offset == 0 || g_links_snapshot_len == 0) {
+        links_snapshot_take();
+    }
+    *len = offset < g_links_snapshot_len ? g_links_snapshot_len - offset : 0;
+    memcpy(data, g_links_snapshot + offset, *len);
+}
 
-static void gatts_profile_event_handler(esp_gatts_cb_event_t event,
-                                        esp_gatt_if_t gatts_if,
-                                        esp_ble_gatts_cb_param_t *param) {
-    switch (event) {
-        case ESP_GATTS_REG_EVT:
-            set_device_name();
-            esp_ble_gap_config_adv_data(&adv_data);
-            adv_config_done |= ADV_CONFIG_FLAG;
-            esp_ble_gap_config_adv_data(&scan_rsp_data);
-            adv_config_done |= SCAN_RSP_CONFIG_FLAG;
-            esp_ble_gatts_create_attr_tab(gatt_db, gatts_if, GATTS_NUM_HANDLE, 0);
-            break;
-            
-        case ESP_GATTS_CREAT_ATTR_TAB_EVT:
-            if (param->add_attr_tab.status != ESP_GATT_OK) {
-                ESP_LOGE(TAG, "Create attr table failed, error code=0x%x", param->add_attr_tab.status);
-            } else {
-                memcpy(gatts_handle_table, param->add_attr_tab.handles, sizeof(gatts_handle_table));
-                esp_ble_gatts_start_service(gatts_handle_table[0]);
-            }
-            break;
-            
-        case ESP_GATTS_CONNECT_EVT:
-            ESP_LOGI(TAG, "Client connected, conn_id=%d", param->connect.conn_id);
-            gl_profile_tab[PROFILE_APP_ID].conn_id = param->connect.conn_id;
-            break;
-            
-        case ESP_GATTS_DISCONNECT_EVT:
-            ESP_LOGI(TAG, "Client disconnected, reason=0x%x", param->disconnect.reason);
-            esp_ble_gap_start_advertising(&adv_params);
-            break;
-            
-        case ESP_GATTS_READ_EVT: {
-            esp_gatt_rsp_t rsp;
-            memset(&rsp, 0, sizeof(esp_gatt_rsp_t));
-            rsp.attr_value.handle = param->read.handle;
-            
-            if (param->read.handle == gatts_handle_table[4]) {
-                // Status read
-                prepare_status_response(rsp.attr_value.value, &rsp.attr_value.len);
-            }
-            
-            esp_ble_gatts_send_response(gatts_if, param->read.conn_id,
-                                       param->read.trans_id, ESP_GATT_OK, &rsp);
-            break;
-        }
-            
-        case ESP_GATTS_WRITE_EVT:
-            if (!param->write.is_prep) {
-                if (param->write.handle == gatts_handle_table[2] ||
-                    param->write.handle == gatts_handle_table[6]) {
-                    parse_config_data(param->write.value, param->write.len);
-                }
-            }
-            
-            if (param->write.need_rsp) {
-                esp_ble_gatts_send_response(gatts_if, param->write.conn_id,
-                                           param->write.trans_id, ESP_GATT_OK, NULL);
-            }
-            break;
-            
-        default:
-            break;
+void ble_core_on_links_read_whole(uint16_t piece, uint8_t *data, uint16_t *len) {
+    if (!long_read_continues(&g_links_long_read, g_links_snapshot_len, piece)) {
+        links_snapshot_take();
     }
+    *len = g_links_snapshot_len;
+    memcpy(data, g_links_snapshot, *len);
+}
+
+void ble_core_get_adv_interval(uint16_t *min, uint16_t *max) {
+    *min = g_adv_int_min;
+    *max = g_adv_int_max;
+}
+
+const uint8_t *ble_core_beacon_data(void) {
+    return g_beacon_data;
 }
 
 /* ============================================================================
@@ -639,6 +747,12 @@ esp_err_t ble_provision_init(prov_node_type_t node_type) {
     
     // Try to load existing config
     ble_provision_load_config(&g_device_config);
+    set_device_name();
+    
+    if (!config_validate(&g_device_config)) {
+        ESP_LOGW(TAG, "Stored config outside command limits - roles apply their defaults");
+    }
+    config_publish();
     
     if (g_device_config.provisioned) {
         g_prov_state = PROV_STATE_PROVISIONED;
@@ -658,150 +772,71 @@ esp_err_t ble_provision_init(prov_node_type_t node_type) {
 }
 
 esp_err_t ble_provision_start(void) {
-    esp_err_t ret;
-    
-    esp_bt_controller_config_t bt_cfg = BT_CONTROLLER_INIT_CONFIG_DEFAULT();
-    ret = esp_bt_controller_init(&bt_cfg);
-    if (ret) {
-        ESP_LOGE(TAG, "BT controller init failed: %s", esp_err_to_name(ret));
-        return ret;
-    }
-    
-    ret = esp_bt_controller_enable(ESP_BT_MODE_BLE);
-    if (ret) {
-        ESP_LOGE(TAG, "BT controller enable failed: %s", esp_err_to_name(ret));
-        return ret;
-    }
-    
-    ret = esp_bluedroid_init();
-    if (ret) {
-        ESP_LOGE(TAG, "Bluedroid init failed: %s", esp_err_to_name(ret));
-        return ret;
-    }
-    
-    ret = esp_bluedroid_enable();
-    if (ret) {
-        ESP_LOGE(TAG, "Bluedroid enable failed: %s", esp_err_to_name(ret));
-        return ret;
-    }
-    
-    ret = esp_ble_gatts_register_callback(gatts_event_handler);
-    if (ret) {
-        ESP_LOGE(TAG, "GATTS register callback failed: %s", esp_err_to_name(ret));
-        return ret;
-    }
-    
-    ret = esp_ble_gap_register_callback(gap_event_handler);
-    if (ret) {
-        ESP_LOGE(TAG, "GAP register callback failed: %s", esp_err_to_name(ret));
-        return ret;
-    }
-    
-    // FIX: SEC #2 - Enable BLE security (encryption and authentication)
-    ESP_LOGI(TAG, "Configuring BLE security...");
-    
-    // Set authentication requirements: Secure Connections + MITM protection + Bonding
-    esp_ble_auth_req_t auth_req = ESP_LE_AUTH_REQ_SC_MITM_BOND;
-    ret = esp_ble_gap_set_security_param(ESP_BLE_SM_AUTHEN_REQ_MODE, &auth_req, sizeof(uint8_t));
-    if (ret) {
-        ESP_LOGW(TAG, "Set auth req failed: %s", esp_err_to_name(ret));
-    }
-    
-    // Set IO capability (display-only for PIN display)
-    esp_ble_io_cap_t iocap = ESP_IO_CAP_OUT;
-    ret = esp_ble_gap_set_security_param(ESP_BLE_SM_IOCAP_MODE, &iocap, sizeof(uint8_t));
-    if (ret) {
-        ESP_LOGW(TAG, "Set IO cap failed: %s", esp_err_to_name(ret));
-    }
-    
-    // Set key size (128-bit)
-    uint8_t key_size = 16;
-    ret = esp_ble_gap_set_security_param(ESP_BLE_SM_MAX_KEY_SIZE, &key_size, sizeof(uint8_t));
-    if (ret) {
-        ESP_LOGW(TAG, "Set key size failed: %s", esp_err_to_name(ret));
-    }
-    
-    // Enable encryption
-    uint8_t init_key = ESP_BLE_ENC_KEY_MASK | ESP_BLE_ID_KEY_MASK;
-    ret = esp_ble_gap_set_security_param(ESP_BLE_SM_SET_INIT_KEY, &init_key, sizeof(uint8_t));
-    if (ret) {
-        ESP_LOGW(TAG, "Set init key failed: %s", esp_err_to_name(ret));
-    }
-    
-    uint8_t rsp_key = ESP_BLE_ENC_KEY_MASK | ESP_BLE_ID_KEY_MASK;
-    ret = esp_ble_gap_set_security_param(ESP_BLE_SM_SET_RSP_KEY, &rsp_key, sizeof(uint8_t));
-    if (ret) {
-        ESP_LOGW(TAG, "Set rsp key failed: %s", esp_err_to_name(ret));
+    if (g_ble_stack_up) {
+        return ESP_OK;
     }
     
-    ESP_LOGI(TAG, "BLE security configured - pairing required for connections");
+    g_init_stats.backend = ble_backend_name();
+    g_init_stats.heap_before = esp_get_free_heap_size();
+    g_init_start_us = esp_timer_get_time();
     
-    ret = esp_ble_gatts_app_register(PROFILE_APP_ID);
-    if (ret) {
-        ESP_LOGE(TAG, "GATTS app register failed: %s", esp_err_to_name(ret));
+    esp_err_t ret = ble_backend_start();
+    if (ret != ESP_OK) {
+        g_init_start_us = 0;
         return ret;
     }
     
-    esp_ble_gatt_set_local_mtu(500);
+    g_init_stats.init_us = (uint32_t)(esp_timer_get_time() - g_init_start_us);
+    g_init_stats.heap_after = esp_get_free_heap_size();
+    g_ble_stack_up = true;
     
-    ESP_LOGI(TAG, "BLE Provisioning started");
+    ESP_LOGI(TAG, "BLE Provisioning started (%s)", g_init_stats.backend);
     return ESP_OK;
 }
 
 esp_err_t ble_provision_stop(void) {
-    esp_ble_gap_stop_advertising();
-    esp_bluedroid_disable();
-    esp_bluedroid_deinit();
-    esp_bt_controller_disable();
-    esp_bt_controller_deinit();
+    ble_backend_stop();
+    adv_set_on_air(false);
+    g_ble_connected = false;
+    g_ble_stack_up = false;
     
-    ESP_LOGI(TAG, "BLE Provisioning stopped");
+    ESP_LOGI(TAG, "BLE Provisioning stopped, free heap %lu bytes",
+             (unsigned long)esp_get_free_heap_size());
+    return ESP_OK;
+}
+
+esp_err_t ble_provision_get_init_stats(ble_init_stats_t *stats) {
+    if (stats == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    memcpy(stats, &g_init_stats, sizeof(ble_init_stats_t));
     return ESP_OK;
 }
 
 bool ble_provision_is_provisioned(void) {
-    return g_device_config.provisioned;
+    device_config_t cfg;
+    ble_provision_config_snapshot(&cfg);
+    return cfg.provisioned;
 }
 
 esp_err_t ble_provision_get_config(device_config_t *config) {
     if (!config) return ESP_ERR_INVALID_ARG;
     
-    // Acquire mutex for thread-safe config access (FIX: BUG #1)
-    if (g_config_mutex == NULL || xSemaphoreTake(g_config_mutex, pdMS_TO_TICKS(1000)) != pdTRUE) {
-        ESP_LOGE(TAG, "Failed to acquire config mutex in get_config");
-        return ESP_ERR_TIMEOUT;
-    }
-    
-    memcpy(config, &g_device_config, sizeof(device_config_t));
-    
-    xSemaphoreGive(g_config_mutex);
+    ble_provision_config_snapshot(config);
     return ESP_OK;
 }
 
 esp_err_t ble_provision_save_config(const device_config_t *config) {
-    nvs_handle_t nvs;
     esp_err_t ret;
     
     // Acquire mutex for thread-safe config access (FIX: BUG #1)
-    if (g_config_mutex == NULL || xSemaphoreTake(g_config_mutex, pdMS_TO_TICKS(1000)) != pdTRUE) {
+    if (!config_lock()) {
         ESP_LOGE(TAG, "Failed to acquire config mutex in save_config");
         return ESP_ERR_TIMEOUT;
     }
     
-    ret = nvs_open("provision", NVS_READWRITE, &nvs);
-    if (ret != ESP_OK) {
-        xSemaphoreGive(g_config_mutex);
-        return ret;
-    }
-    
-    ret = nvs_set_blob(nvs, "config", config, sizeof(device_config_t));
-    if (ret == ESP_OK) {
-        ret = nvs_commit(nvs);
-        if (ret != ESP_OK) {
-            ESP_LOGE(TAG, "NVS commit failed: %s", esp_err_to_name(ret));
-        }
-    }
-    nvs_close(nvs);
+    // Versioned store: only changed keys are rewritten
+    ret = config_store_save(config);
     
     xSemaphoreGive(g_config_mutex);
     
@@ -812,24 +847,16 @@ esp_err_t ble_provision_save_config(const device_config_t *config) {
 }
 
 esp_err_t ble_provision_load_config(device_config_t *config) {
-    nvs_handle_t nvs;
     esp_err_t ret;
     
     // Acquire mutex for thread-safe config access (FIX: BUG #1)
-    if (g_config_mutex == NULL || xSemaphoreTake(g_config_mutex, pdMS_TO_TICKS(1000)) != pdTRUE) {
+    if (!config_lock()) {
         ESP_LOGE(TAG, "Failed to acquire config mutex in load_config");
         return ESP_ERR_TIMEOUT;
     }
     
-    ret = nvs_open("provision", NVS_READONLY, &nvs);
-    if (ret != ESP_OK) {
-        xSemaphoreGive(g_config_mutex);
-        return ret;
-    }
-    
-    size_t len = sizeof(device_config_t);
-    ret = nvs_get_blob(nvs, "config", config, &len);
-    nvs_close(nvs);
+    // Migrates older schemas; leaves defaults in place on any error
+    ret = config_store_load(config);
     
     xSemaphoreGive(g_config_mutex);
     
@@ -840,15 +867,10 @@ esp_err_t ble_provision_load_config(device_config_t *config) {
 }
 
 esp_err_t ble_provision_reset(void) {
-    nvs_handle_t nvs;
-    esp_err_t ret = nvs_open("provision", NVS_READWRITE, &nvs);
-    if (ret == ESP_OK) {
-        nvs_erase_all(nvs);
-        nvs_commit(nvs);
-        nvs_close(nvs);
-    }
+    config_store_erase();
     
     g_device_config.provisioned = false;
+    config_publish();
     g_prov_state = PROV_STATE_NOT_PROVISIONED;
     
     ESP_LOGW(TAG, "Factory reset complete");
@@ -870,20 +892,427 @@ void ble_provision_set_complete_callback(void (*callback)(const device_config_t
 static device_status_t g_device_status = {0};
 static bool g_status_mode_active = false;
 
+// Beacon refresh state. Updates are published from the esp_timer task only,
+// at most once per BLE_BEACON_MIN_REFRESH_MS.
+static portMUX_TYPE g_status_lock = portMUX_INITIALIZER_UNLOCKED;
+static esp_timer_handle_t g_beacon_timer = NULL;
+static int64_t g_beacon_last_refresh_us = 0;
+static uint8_t g_beacon_counter = 0;
+static bool g_beacon_deferred = false;      // Publish postponed by a coex window
+
+// Adaptive advertising state, guarded by g_status_lock. Time is accounted on
+// every on-air / phase change, driven by GAP events and the window timer.
+#define ADV_FAST_EVENT_US   (((BLE_ADV_FAST_INT_MIN + BLE_ADV_FAST_INT_MAX) * 625 / 2) + 5000)
+#define ADV_SLOW_EVENT_US   (((BLE_ADV_SLOW_INT_MIN + BLE_ADV_SLOW_INT_MAX) * 625 / 2) + 5000)
+
+static esp_timer_handle_t g_adv_window_timer = NULL;
+static ble_adv_policy_t g_adv_policy = BLE_ADV_POLICY_CONTINUOUS;
+static ble_adv_phase_t g_adv_phase = BLE_ADV_PHASE_OFF;
+static bool g_adv_on_air = false;
+static int64_t g_adv_mark_us = 0;
+static int64_t g_adv_fast_us = 0;
+static int64_t g_adv_slow_us = 0;
+static int64_t g_adv_idle_us = 0;
+static uint16_t g_adv_wakeups = 0;
+static bool g_adv_window_deferred = false;  // Window end postponed by a coex window
+
+// Lazy bring-up: stack start/stop run in short-lived tasks (Bluedroid
+// init/deinit blocks and needs more stack than the esp_timer task has)
+static esp_timer_handle_t g_idle_timer = NULL;
+static bool g_lifecycle_busy = false;
+static bool g_lifecycle_requested = false;  // Request that arrived while busy
+
+void ble_beacon_encode(const device_status_t *status, uint8_t counter, uint8_t *out) {
+    uint8_t flags = 0;
+    if (status->zigbee_connected) flags |= BLE_BEACON_FLAG_ZIGBEE;
+    if (status->pump_active)      flags |= BLE_BEACON_FLAG_PUMP_ACTIVE;
+    if (status->sensor_status)    flags |= BLE_BEACON_FLAG_SENSOR_ERROR;
+    if (status->manual_override)  flags |= BLE_BEACON_FLAG_MANUAL;
+    
+    out[0] = BLE_BEACON_COMPANY_ID & 0xFF;
+    out[1] = (BLE_BEACON_COMPANY_ID >> 8) & 0xFF;
+    out[2] = (BLE_BEACON_FORMAT_VERSION << 4) | (status->node_type & 0x0F);
+    out[3] = status->water_level_percent;
+    out[4] = status->water_level_cm & 0xFF;
+    out[5] = (status->water_level_cm >> 8) & 0xFF;
+    out[6] = flags;
+    out[7] = counter;
+}
+
+static void beacon_publish_cb(void *arg) {
+    uint8_t next[BLE_BEACON_LEN];
+    
+    // Don't touch the controller during a Zigbee window
+    uint32_t defer_ms = radio_coex_ble_defer_ms(!g_beacon_deferred);
+    if (defer_ms > 0) {
+        g_beacon_deferred = true;
+        esp_timer_start_once(g_beacon_timer, (uint64_t)defer_ms * 1000);
+        return;
+    }
+    g_beacon_deferred = false;
+    
+    portENTER_CRITICAL(&g_status_lock);
+    ble_beacon_encode(&g_device_status, g_beacon_counter, next);
+    portEXIT_CRITICAL(&g_status_lock);
+    
+    // Counter byte excluded: only real content changes are published
+    if (memcmp(next, g_beacon_data, BLE_BEACON_LEN - 1) == 0) {
+        return;
+    }
+    
+    next[BLE_BEACON_LEN - 1] = ++g_beacon_counter;
+    memcpy(g_beacon_data, next, BLE_BEACON_LEN);
+    g_beacon_last_refresh_us = esp_timer_get_time();
+    
+    if (g_ble_stack_up) {
+        ble_backend_adv_data_update();
+    }
+}
+
+static void beacon_schedule_refresh(void) {
+    if (g_beacon_timer == NULL) {
+        const esp_timer_create_args_t timer_args = {
+            .callback = beacon_publish_cb,
+            .name = "ble_beacon",
+        };
+        if (esp_timer_create(&timer_args, &g_beacon_timer) != ESP_OK) {
+            ESP_LOGE(TAG, "Failed to create beacon timer");
+            return;
+        }
+    }
+    
+    if (esp_timer_is_active(g_beacon_timer)) {
+        return;  // Refresh already pending, it will pick up the latest status
+    }
+    
+    int64_t elapsed_us = esp_timer_get_time() - g_beacon_last_refresh_us;
+    int64_t min_us = (int64_t)BLE_BEACON_MIN_REFRESH_MS * 1000;
+    uint64_t delay_us = elapsed_us >= min_us ? 0 : (uint64_t)(min_us - elapsed_us);
+    esp_timer_start_once(g_beacon_timer, delay_us);
+}
+
+/* ---------------------------------------------------------------------------
+ * Adaptive advertising
+ * --------------------------------------------------------------------------- */
+
+// Caller holds g_status_lock
+static void adv_account_locked(int64_t now_us) {
+    int64_t elapsed_us = now_us - g_adv_mark_us;
+    g_adv_mark_us = now_us;
+    
+    if (g_adv_on_air) {
+        // Provisioning advertises with phase OFF, always at the fast interval
+        if (g_adv_phase == BLE_ADV_PHASE_SLOW) {
+            g_adv_slow_us += elapsed_us;
+        } else {
+            g_adv_fast_us += elapsed_us;
+        }
+    } else if (g_status_mode_active) {
+        g_adv_idle_us += elapsed_us;
+    }
+}
+
+static void adv_set_on_air(bool on_air) {
+    portENTER_CRITICAL(&g_status_lock);
+    adv_account_locked(esp_timer_get_time());
+    g_adv_on_air = on_air;
+    portEXIT_CRITICAL(&g_status_lock);
+}
+
+static bool adv_should_restart(void) {
+    return !g_status_mode_active || g_adv_phase != BLE_ADV_PHASE_OFF;
+}
+
+static ble_adv_policy_t adv_effective_policy(void) {
+    device_config_t cfg;
+    ble_provision_config_snapshot(&cfg);
+    uint8_t policy = cfg.ble_adv_policy;
+    if (policy != BLE_ADV_POLICY_ROLE_DEFAULT && policy < BLE_ADV_POLICY_MAX) {
+        return (ble_adv_policy_t)policy;
+    }
+    // Sensors are usually battery powered and out of sight: only advertise on request
+    return cfg.node_type == NODE_TYPE_SENSOR ?
+           BLE_ADV_POLICY_ON_DEMAND : BLE_ADV_POLICY_DECAY;
+}
+
+static void adv_enter_phase(ble_adv_phase_t phase) {
+    portENTER_CRITICAL(&g_status_lock);
+    adv_account_locked(esp_timer_get_time());
+    g_adv_phase = phase;
+    portEXIT_CRITICAL(&g_status_lock);
+    
+    if (phase == BLE_ADV_PHASE_SLOW) {
+        g_adv_int_min = BLE_ADV_SLOW_INT_MIN;
+        g_adv_int_max = BLE_ADV_SLOW_INT_MAX;
+    } else {
+        g_adv_int_min = BLE_ADV_FAST_INT_MIN;
+        g_adv_int_max = BLE_ADV_FAST_INT_MAX;
+    }
+    
+    if (!g_ble_stack_up) {
+        return;  // Host bring-up starts advertising with this interval
+    }
+    
+    // The interval only changes on restart; while connected, the disconnect
+    // handler restarts advertising with the new interval
+    ble_backend_adv_stop();
+    if (phase != BLE_ADV_PHASE_OFF && !g_ble_connected) {
+        ble_backend_adv_start();
+    }
+    
+    ESP_LOGI(TAG, "Advertising phase: %s",
+             phase == BLE_ADV_PHASE_FAST ? "FAST" :
+             phase == BLE_ADV_PHASE_SLOW ? "SLOW" : "OFF");
+}
+
+static void adv_window_expired_cb(void *arg) {
+    if (!g_status_mode_active) {
+        return;
+    }
+    
+    // Advertising restart waits for the Zigbee window to close
+    uint32_t defer_ms = radio_coex_ble_defer_ms(!g_adv_window_deferred);
+    if (defer_ms > 0) {
+        g_adv_window_deferred = true;
+        esp_timer_start_once(g_adv_window_timer, (uint64_t)defer_ms * 1000);
+        return;
+    }
+    g_adv_window_deferred = false;
+    adv_enter_phase(g_adv_policy == BLE_ADV_POLICY_ON_DEMAND ?
+                    BLE_ADV_PHASE_OFF : BLE_ADV_PHASE_SLOW);
+}
+
+static void adv_open_fast_window(void) {
+    g_adv_policy = adv_effective_policy();
+    
+    portENTER_CRITICAL(&g_status_lock);
+    g_adv_wakeups++;
+    portEXIT_CRITICAL(&g_status_lock);
+    
+    if (g_adv_phase != BLE_ADV_PHASE_FAST) {
+        adv_enter_phase(BLE_ADV_PHASE_FAST);
+    }
+    
+    if (g_adv_window_timer == NULL) {
+        const esp_timer_create_args_t timer_args = {
+            .callback = adv_window_expired_cb,
+            .name = "ble_adv_window",
+        };
+        if (esp_timer_create(&timer_args, &g_adv_window_timer) != ESP_OK) {
+            ESP_LOGE(TAG, "Failed to create advertising window timer");
+            return;  // Stays in the fast phase
+        }
+    }
+    
+    esp_timer_stop(g_adv_window_timer);
+    g_adv_window_deferred = false;
+    if (g_adv_policy != BLE_ADV_POLICY_CONTINUOUS) {
+        esp_timer_start_once(g_adv_window_timer, (uint64_t)BLE_ADV_FAST_WINDOW_SEC * 1000000);
+    }
+    
+    idle_timer_rearm();
+}
+
+esp_err_t ble_status_wake(void) {
+    return ble_status_request(BLE_TRIGGER_BUTTON);
+}
+
+/* ---------------------------------------------------------------------------
+ * Lazy bring-up / idle teardown
+ * --------------------------------------------------------------------------- */
+
+static uint8_t effective_triggers(void) {
+    device_config_t cfg;
+    ble_provision_config_snapshot(&cfg);
+    uint8_t triggers = cfg.ble_triggers;
+    if (triggers == 0) {
+        triggers = BLE_TRIGGER_DEFAULT;
+    }
+    return triggers | BLE_TRIGGER_BUTTON;
+}
+
+static uint32_t idle_timeout_sec(void) {
+    if (effective_triggers() & BLE_TRIGGER_BOOT) {
+        return BLE_IDLE_TIMEOUT_NEVER;  // Eager mode keeps the stack up
+    }
+    device_config_t cfg;
+    ble_provision_config_snapshot(&cfg);
+    uint16_t timeout_sec = cfg.ble_idle_timeout_sec;
+    return timeout_sec ? timeout_sec : BLE_IDLE_TIMEOUT_DEFAULT_SEC;
+}
+
+// A request that finds the claim taken is recorded for its holder to serve
+static bool lifecycle_try_claim(bool record_request) {
+    bool claimed = false;
+    portENTER_CRITICAL(&g_status_lock);
+    if (!g_lifecycle_busy) {
+        g_lifecycle_busy = true;
+        claimed = true;
+    } else if (record_request) {
+        g_lifecycle_requested = true;
+    }
+    portEXIT_CRITICAL(&g_status_lock);
+    return claimed;
+}
+
+// Drop the claim, unless a request arrived meanwhile: then it is kept
+static bool lifecycle_release(void) {
+    portENTER_CRITICAL(&g_status_lock);
+    bool requested = g_lifecycle_requested;
+    g_lifecycle_requested = false;
+    g_lifecycle_busy = requested;
+    portEXIT_CRITICAL(&g_status_lock);
+    return requested;
+}
+
+// Drop the claim and anything recorded under it (the task to serve it failed)
+static void lifecycle_drop(void) {
+    portENTER_CRITICAL(&g_status_lock);
+    g_lifecycle_requested = false;
+    g_lifecycle_busy = false;
+    portEXIT_CRITICAL(&g_status_lock);
+}
+
+// Serve the requests recorded while the claim was held, then drop it
+static void lifecycle_finish(void) {
+    while (lifecycle_release()) {
+        if (g_status_mode_active) {
+            adv_open_fast_window();
+        } else if (ble_status_start() != ESP_OK) {
+            ESP_LOGE(TAG, "Lazy BLE start failed");
+        }
+    }
+}
+
+static void ble_up_task(void *arg) {
+    if (ble_status_start() != ESP_OK) {
+        ESP_LOGE(TAG, "Lazy BLE start failed");
+    }
+    lifecycle_finish();
+    vTaskDelete(NULL);
+}
+
+static void ble_down_task(void *arg) {
+    // A phone may have connected since the timer fired
+    if (!g_ble_connected && g_status_mode_active) {
+        uint32_t heap_before = esp_get_free_heap_size();
+        ble_status_stop();
+        ble_provision_stop();
+        ESP_LOGI(TAG, "BLE idle - stack released (%lu bytes freed)",
+                 (unsigned long)(esp_get_free_heap_size() - heap_before));
+    }
+    lifecycle_finish();  // A wake during teardown brings it back up
+    vTaskDelete(NULL);
+}
+
+static void idle_timeout_cb(void *arg) {
+    if (g_ble_connected || !lifecycle_try_claim(false)) {
+        return;  // Re-armed on disconnect / next request
+    }
+    if (xTaskCreate(ble_down_task, "ble_down", 4096, NULL, 3, NULL) != pdPASS) {
+        lifecycle_drop();
+    }
+}
+
+static void idle_timer_rearm(void) {
+    uint32_t timeout_sec = idle_timeout_sec();
+    if (timeout_sec == BLE_IDLE_TIMEOUT_NEVER) {
+        return;
+    }
+    
+    if (g_idle_timer == NULL) {
+        const esp_timer_create_args_t timer_args = {
+            .callback = idle_timeout_cb,
+            .name = "ble_idle",
+        };
+        if (esp_timer_create(&timer_args, &g_idle_timer) != ESP_OK) {
+            ESP_LOGE(TAG, "Failed to create BLE idle timer");
+            return;  // Stack simply stays up
+        }
+    }
+    
+    esp_timer_stop(g_idle_timer);
+    esp_timer_start_once(g_idle_timer, (uint64_t)timeout_sec * 1000000);
+}
+
+static void idle_timer_stop(void) {
+    if (g_idle_timer) {
+        esp_timer_stop(g_idle_timer);
+    }
+}
+
+esp_err_t ble_status_request(uint8_t trigger) {
+    if (!(effective_triggers() & trigger)) {
+        return ESP_ERR_NOT_SUPPORTED;
+    }
+    
+    if (!lifecycle_try_claim(true)) {
+        return ESP_OK;  // Bring-up or teardown in progress: served when it ends
+    }
+    
+    if (g_status_mode_active) {
+        adv_open_fast_window();
+        lifecycle_finish();  // Stack stays up: recorded requests only reopen the window
+        return ESP_OK;
+    }
+    
+    ESP_LOGI(TAG, "BLE requested (trigger 0x%02X) - starting stack", trigger);
+    if (xTaskCreate(ble_up_task, "ble_up", 4096, NULL, 3, NULL) != pdPASS) {
+        lifecycle_drop();
+        return ESP_ERR_NO_MEM;
+    }
+    return ESP_OK;
+}
+
+esp_err_t ble_adv_get_stats(ble_adv_stats_t *stats) {
+    if (stats == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    
+    portENTER_CRITICAL(&g_status_lock);
+    adv_account_locked(esp_timer_get_time());
+    int64_t fast_us = g_adv_fast_us;
+    int64_t slow_us = g_adv_slow_us;
+    int64_t idle_us = g_adv_idle_us;
+    stats->phase = g_adv_phase;
+    stats->wakeups = g_adv_wakeups;
+    portEXIT_CRITICAL(&g_status_lock);
+    
+    int64_t events = fast_us / ADV_FAST_EVENT_US + slow_us / ADV_SLOW_EVENT_US;
+    stats->policy = g_status_mode_active ? g_adv_policy : adv_effective_policy();
+    stats->fast_ms = (uint32_t)(fast_us / 1000);
+    stats->slow_ms = (uint32_t)(slow_us / 1000);
+    stats->idle_ms = (uint32_t)(idle_us / 1000);
+    stats->adv_events = (uint32_t)events;
+    stats->radio_on_ms = (uint32_t)(events * BLE_ADV_EVENT_AIRTIME_US / 1000);
+    return ESP_OK;
+}
+
 esp_err_t ble_status_start(void) {
     if (g_status_mode_active) {
         ESP_LOGW(TAG, "Status mode already active");
         return ESP_OK;
     }
     
-    // BLE should already be initialized from provisioning
-    // Just start advertising again
     g_status_mode_active = true;
+    adv_open_fast_window();
     
-    // Start advertising for status monitoring
-    esp_ble_gap_start_advertising(&adv_params);
+    if (!g_ble_stack_up) {
+        // Provisioned boot: stack not up yet. GATT registration configures
+        // the advertising data (including the beacon) and starts advertising.
+        esp_err_t ret = ble_provision_start();
+        if (ret != ESP_OK) {
+            if (g_adv_window_timer) {
+                esp_timer_stop(g_adv_window_timer);
+            }
+            g_status_mode_active = false;
+            g_adv_phase = BLE_ADV_PHASE_OFF;
+            return ret;
+        }
+    }
     
-    ESP_LOGI(TAG, "BLE Status monitoring started - connect with mobile app to view status");
+    ESP_LOGI(TAG, "BLE Status monitoring started (policy %d, fast window %d s)",
+             g_adv_policy, BLE_ADV_FAST_WINDOW_SEC);
     return ESP_OK;
 }
 
@@ -892,7 +1321,11 @@ esp_err_t ble_status_stop(void) {
         return ESP_OK;
     }
     
-    esp_ble_gap_stop_advertising();
+    if (g_adv_window_timer) {
+        esp_timer_stop(g_adv_window_timer);
+    }
+    idle_timer_stop();
+    adv_enter_phase(BLE_ADV_PHASE_OFF);
     g_status_mode_active = false;
     
     ESP_LOGI(TAG, "BLE Status monitoring stopped");
@@ -904,7 +1337,11 @@ esp_err_t ble_status_update(const device_status_t *status) {
         return ESP_ERR_INVALID_ARG;
     }
     
+    portENTER_CRITICAL(&g_status_lock);
     memcpy(&g_device_status, status, sizeof(device_status_t));
+    portEXIT_CRITICAL(&g_status_lock);
+    
+    beacon_schedule_refresh();
     return ESP_OK;
 }
 
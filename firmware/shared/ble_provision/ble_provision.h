@@ -28,6 +28,15 @@ typedef enum {
     PROV_STATE_PROVISIONED
 } prov_state_t;
 
+// Advertising policy after provisioning (stored in device_config_t)
+typedef enum {
+    BLE_ADV_POLICY_ROLE_DEFAULT = 0,    // Sensor: ON_DEMAND, controller/router: DECAY
+    BLE_ADV_POLICY_CONTINUOUS,          // Fast advertising forever (legacy behaviour)
+    BLE_ADV_POLICY_DECAY,               // Fast window, then slow advertising
+    BLE_ADV_POLICY_ON_DEMAND,           // Fast window, then stopped until ble_status_wake()
+    BLE_ADV_POLICY_MAX
+} ble_adv_policy_t;
+
 /* ============================================================================
  * SECURITY & NAMING
  * ============================================================================ */
@@ -70,6 +79,14 @@ typedef struct {
     // Flags
     bool provisioned;
     uint32_t provision_timestamp;
+    
+    // BLE advertising policy (ble_adv_policy_t). Appended last so configs
+    // saved by older firmware still load (missing byte reads as ROLE_DEFAULT).
+    uint8_t  ble_adv_policy;
+    
+    // Lazy BLE bring-up after provisioning (0 = defaults)
+    uint8_t  ble_triggers;           // BLE_TRIGGER_* bitmask
+    uint16_t ble_idle_timeout_sec;   // Tear stack down after this idle time
 } device_config_t;
 
 /* ============================================================================
@@ -140,6 +157,51 @@ prov_state_t ble_provision_get_state(void);
  */
 void ble_provision_set_complete_callback(void (*callback)(const device_config_t *config));
 
+/* ============================================================================
+ * CONFIG SNAPSHOT (lock-free reads)
+ * ============================================================================ */
+
+/*
+ * The active configuration is published as a snapshot. BLE config commands
+ * edit a private copy under the writer mutex, validate it and publish it into
+ * the next of CONFIG_SNAPSHOT_SLOTS slots, so readers never block and pick up
+ * threshold changes without a reboot.
+ *
+ * Readers get a copy, taken under the slot's sequence count: a copy that
+ * overlapped a refill of its slot (a burst of updates while the reader was
+ * preempted) is retried, never torn. Nothing points into a slot after the
+ * call returns.
+ */
+#define CONFIG_SNAPSHOT_SLOTS   4
+
+/**
+ * Copy the active configuration (valid after ble_provision_init)
+ */
+void ble_provision_config_snapshot(device_config_t *config);
+
+/**
+ * Incremented on every published change; cheap "did config change?" check
+ */
+uint32_t ble_provision_config_generation(void);
+
+/**
+ * BLE stack bring-up measurements (for backend comparison)
+ */
+typedef struct {
+    const char *backend;          // "Bluedroid" or "NimBLE" (NULL before first start)
+    uint32_t init_us;             // Duration of controller + host init
+    uint32_t adv_ready_us;        // Start of init to first advertising
+    uint32_t heap_before;         // Free heap before init (bytes)
+    uint32_t heap_after;          // Free heap after init (bytes)
+} ble_init_stats_t;
+
+/**
+ * Get measurements of the last BLE stack bring-up
+ * @param stats Output measurements
+ * @return ESP_OK on success
+ */
+esp_err_t ble_provision_get_init_stats(ble_init_stats_t *stats);
+
 /* ============================================================================
  * BLE STATUS MONITORING (Post-Provisioning)
  * ============================================================================ */
@@ -201,6 +263,127 @@ esp_err_t ble_status_update(const device_status_t *status);
  */
 bool ble_status_is_active(void);
 
+/* ============================================================================
+ * CONNECTIONLESS STATUS BEACON
+ * ============================================================================ */
+
+/*
+ * The latest device_status_t is mirrored into manufacturer-specific data of
+ * the advertising packet, so a passive scan shows every device's state
+ * without opening a connection. The device name moves to the scan response
+ * to make room (flags + beacon + 128-bit service UUID = 31 bytes).
+ *
+ * Beacon layout (BLE_BEACON_LEN bytes, multi-byte fields little endian):
+ *   [0..1] Company ID (BLE_BEACON_COMPANY_ID)
+ *   [2]    Format version (high nibble) | node type (low nibble)
+ *   [3]    Water level percent (0-100)
+ *   [4..5] Water level cm
+ *   [6]    Flags (BLE_BEACON_FLAG_*)
+ *   [7]    Rolling counter, incremented each time the content changes
+ */
+#define BLE_BEACON_COMPANY_ID           0xFFFF  // Bluetooth SIG ID reserved for internal use
+#define BLE_BEACON_FORMAT_VERSION       1
+#define BLE_BEACON_LEN                  8
+#define BLE_BEACON_MIN_REFRESH_MS       2000    // Max one advertising data update per 2 s
+
+// Beacon flags
+#define BLE_BEACON_FLAG_ZIGBEE          (1 << 0)    // Zigbee network connected
+#define BLE_BEACON_FLAG_PUMP_ACTIVE     (1 << 1)    // Pump running
+#define BLE_BEACON_FLAG_SENSOR_ERROR    (1 << 2)    // Sensor error / sensor offline
+#define BLE_BEACON_FLAG_MANUAL          (1 << 3)    // Manual override active
+
+/**
+ * Encode a device status into beacon manufacturer data
+ * @param status Status to encode
+ * @param counter Rolling counter value to embed
+ * @param out Output buffer, BLE_BEACON_LEN bytes
+ */
+void ble_beacon_encode(const device_status_t *status, uint8_t counter, uint8_t *out);
+
+/* ============================================================================
+ * ADAPTIVE ADVERTISING
+ * ============================================================================ */
+
+/*
+ * Provisioning always advertises at the fast interval. In status mode the
+ * policy from device_config_t applies: every ble_status_start() and
+ * ble_status_wake() opens a fast window of BLE_ADV_FAST_WINDOW_SEC so the app
+ * finds the device quickly, after which advertising either drops to the slow
+ * interval (DECAY) or stops altogether (ON_DEMAND).
+ *
+ * Radio-on time is an estimate: advertising events x BLE_ADV_EVENT_AIRTIME_US.
+ */
+#define BLE_ADV_FAST_INT_MIN            0x20    // 20 ms   (units of 0.625 ms)
+#define BLE_ADV_FAST_INT_MAX            0x40    // 40 ms
+#define BLE_ADV_SLOW_INT_MIN            0x0640  // 1000 ms
+#define BLE_ADV_SLOW_INT_MAX            0x0800  // 1280 ms
+#define BLE_ADV_FAST_WINDOW_SEC         30
+#define BLE_ADV_EVENT_AIRTIME_US        1500    // 3 channels x (TX PDU + RX window for scan/connect req)
+
+// Current advertising phase
+typedef enum {
+    BLE_ADV_PHASE_OFF = 0,
+    BLE_ADV_PHASE_FAST,
+    BLE_ADV_PHASE_SLOW
+} ble_adv_phase_t;
+
+/**
+ * Advertising duty-cycle statistics since boot
+ */
+typedef struct {
+    uint8_t  policy;              // Effective ble_adv_policy_t (role default resolved)
+    uint8_t  phase;               // Current ble_adv_phase_t
+    uint32_t fast_ms;             // Time on air at the fast interval
+    uint32_t slow_ms;             // Time on air at the slow interval
+    uint32_t idle_ms;             // Status mode with advertising stopped or connected
+    uint32_t adv_events;          // Estimated advertising events
+    uint32_t radio_on_ms;         // Estimated radio-on time spent advertising
+    uint16_t wakeups;             // Fast windows opened (start + wake)
+} ble_adv_stats_t;
+
+/**
+ * Open a fast advertising window (e.g. on button press). Restarts
+ * advertising if the ON_DEMAND policy had stopped it, and brings the BLE
+ * stack up if it is down. Same as ble_status_request(BLE_TRIGGER_BUTTON).
+ * @return ESP_OK on success
+ */
+esp_err_t ble_status_wake(void);
+
+/**
+ * Get advertising duty-cycle statistics
+ * @param stats Output statistics
+ * @return ESP_OK on success
+ */
+esp_err_t ble_adv_get_stats(ble_adv_stats_t *stats);
+
+/* ============================================================================
+ * LAZY BLE BRING-UP
+ * ============================================================================ */
+
+/*
+ * Provisioned devices boot with BLE off. The stack (controller + host) is
+ * brought up in the background when an enabled trigger fires, and torn down
+ * again - releasing its heap - after ble_idle_timeout_sec without a
+ * connection or a new trigger. The BOOT trigger restores the old behaviour:
+ * start at boot and never tear down.
+ */
+#define BLE_TRIGGER_BUTTON              (1 << 0)    // Button press (always enabled)
+#define BLE_TRIGGER_BOOT                (1 << 1)    // At boot, stay up (eager)
+#define BLE_TRIGGER_NETWORK_LOST        (1 << 2)    // Zigbee not joined / lost
+#define BLE_TRIGGER_FAULT               (1 << 3)    // Sensor error / sensor offline
+#define BLE_TRIGGER_DEFAULT             (BLE_TRIGGER_BUTTON | BLE_TRIGGER_NETWORK_LOST | BLE_TRIGGER_FAULT)
+
+#define BLE_IDLE_TIMEOUT_DEFAULT_SEC    120
+#define BLE_IDLE_TIMEOUT_NEVER          0xFFFF
+
+/**
+ * Request BLE status mode for a trigger. Brings the stack up in the
+ * background if needed, otherwise opens a fast advertising window.
+ * @param trigger One BLE_TRIGGER_* value
+ * @return ESP_OK if accepted, ESP_ERR_NOT_SUPPORTED if the trigger is disabled
+ */
+esp_err_t ble_status_request(uint8_t trigger);
+
 /* ============================================================================
  * MANUAL PUMP CONTROL (Emergency Override)
  * ============================================================================ */
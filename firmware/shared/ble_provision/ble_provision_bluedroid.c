@@ -0,0 +1,465 @@
+/*
+ * BLE Provisioning - Bluedroid backend
+ * GATT server, advertising and security on the Bluedroid host
+ */
+
+#include "ble_provision_priv.h"
+#include <string.h>
+#include "esp_log.h"
+#include "esp_bt.h"
+#include "esp_gap_ble_api.h"
+#include "esp_gatts_api.h"
+#include "esp_bt_main.h"
+#include "esp_gatt_common_api.h"
+#include "radio_coex.h"
+
+static const char *TAG = "BLE_PROV";
+
+/* ============================================================================
+ * BLE CONFIGURATION
+ * ============================================================================ */
+
+#define GATTS_NUM_HANDLE        11
+#define PROFILE_NUM             1
+#define PROFILE_APP_ID          0
+
+#define ADV_CONFIG_FLAG         (1 << 0)
+#define SCAN_RSP_CONFIG_FLAG    (1 << 1)
+
+/* ============================================================================
+ * GLOBAL VARIABLES
+ * ============================================================================ */
+
+static uint8_t adv_config_done = 0;
+static uint16_t gatts_handle_table[GATTS_NUM_HANDLE];
+static uint8_t service_uuid[16] = { BLE_PROV_SERVICE_UUID128 };
+
+static bool g_beacon_live = false;          // Advertising configured, beacon updates go on air
+static bool g_beacon_adv_update = false;    // Beacon-only adv data update in flight
+
+// Advertising packet: flags + status beacon + service UUID (31 bytes).
+// The name goes in the scan response so it is never truncated.
+// p_manufacturer_data is set at start (beacon buffer owned by the core).
+static esp_ble_adv_data_t adv_data = {
+    .set_scan_rsp = false,
+    .include_name = false,
+    .include_txpower = false,
+    .min_interval = 0x0006,
+    .max_interval = 0x0010,
+    .appearance = 0x00,
+    .manufacturer_len = BLE_BEACON_LEN,
+    .p_manufacturer_data = NULL,
+    .service_data_len = 0,
+    .p_service_data = NULL,
+    .service_uuid_len = sizeof(service_uuid),
+    .p_service_uuid = service_uuid,
+    .flag = (ESP_BLE_ADV_FLAG_GEN_DISC | ESP_BLE_ADV_FLAG_BREDR_NOT_SPT),
+};
+
+static esp_ble_adv_data_t scan_rsp_data = {
+    .set_scan_rsp = true,
+    .include_name = true,
+    .include_txpower = false,
+    .appearance = 0x00,
+    .manufacturer_len = 0,
+    .p_manufacturer_data = NULL,
+    .service_data_len = 0,
+    .p_service_data = NULL,
+    .service_uuid_len = 0,
+    .p_service_uuid = NULL,
+    .flag = (ESP_BLE_ADV_FLAG_GEN_DISC | ESP_BLE_ADV_FLAG_BREDR_NOT_SPT),
+};
+
+// Interval is filled in from the core's advertising policy on every start
+static esp_ble_adv_params_t adv_params = {
+    .adv_int_min = BLE_ADV_FAST_INT_MIN,
+    .adv_int_max = BLE_ADV_FAST_INT_MAX,
+    .adv_type = ADV_TYPE_IND,
+    .own_addr_type = BLE_ADDR_TYPE_PUBLIC,
+    .channel_map = ADV_CHNL_ALL,
+    .adv_filter_policy = ADV_FILTER_ALLOW_SCAN_ANY_CON_ANY,
+};
+
+/* ============================================================================
+ * GATT SERVER CALLBACKS
+ * ============================================================================ */
+
+static void gatts_profile_event_handler(esp_gatts_cb_event_t event,
+                                        esp_gatt_if_t gatts_if,
+                                        esp_ble_gatts_cb_param_t *param);
+
+static struct gatts_profile_inst {
+    esp_gatts_cb_t gatts_cb;
+    uint16_t gatts_if;
+    uint16_t app_id;
+    uint16_t conn_id;
+    uint16_t service_handle;
+    esp_gatt_srvc_id_t service_id;
+    uint16_t char_handle;
+    esp_bt_uuid_t char_uuid;
+    esp_gatt_perm_t perm;
+    esp_gatt_char_prop_t property;
+    uint16_t descr_handle;
+    esp_bt_uuid_t descr_uuid;
+} gl_profile_tab[PROFILE_NUM] = {
+    [PROFILE_APP_ID] = {
+        .gatts_cb = gatts_profile_event_handler,
+        .gatts_if = ESP_GATT_IF_NONE,
+    },
+};
+
+/* ============================================================================
+ * HELPER FUNCTIONS
+ * ============================================================================ */
+
+static void start_advertising(void) {
+    ble_core_get_adv_interval(&adv_params.adv_int_min, &adv_params.adv_int_max);
+    esp_ble_gap_start_advertising(&adv_params);
+}
+
+/* ============================================================================
+ * GAP EVENT HANDLER
+ * ============================================================================ */
+
+static void gap_event_handler(esp_gap_ble_cb_event_t event, esp_ble_gap_cb_param_t *param) {
+    switch (event) {
+        case ESP_GAP_BLE_ADV_DATA_SET_COMPLETE_EVT:
+            if (g_beacon_adv_update) {
+                // Beacon refresh: payload swapped in place, advertising keeps running
+                g_beacon_adv_update = false;
+                break;
+            }
+            adv_config_done &= (~ADV_CONFIG_FLAG);
+            if (adv_config_done == 0) {
+                start_advertising();
+            }
+            break;
+
+        case ESP_GAP_BLE_SCAN_RSP_DATA_SET_COMPLETE_EVT:
+            adv_config_done &= (~SCAN_RSP_CONFIG_FLAG);
+            if (adv_config_done == 0) {
+                start_advertising();
+            }
+            break;
+
+        case ESP_GAP_BLE_ADV_START_COMPLETE_EVT:
+            if (param->adv_start_cmpl.status != ESP_BT_STATUS_SUCCESS) {
+                ESP_LOGE(TAG, "Advertising start failed");
+            } else {
+                g_beacon_live = true;
+                ble_core_on_adv_started();
+            }
+            break;
+
+        case ESP_GAP_BLE_ADV_STOP_COMPLETE_EVT:
+            ESP_LOGI(TAG, "Advertising stopped");
+            ble_core_on_adv_stopped();
+            break;
+
+        case ESP_GAP_BLE_UPDATE_CONN_PARAMS_EVT:
+            ESP_LOGI(TAG, "Connection params updated");
+            break;
+
+        default:
+            break;
+    }
+}
+
+/* ============================================================================
+ * GATTS EVENT HANDLER
+ * ============================================================================ */
+
+static void gatts_event_handler(esp_gatts_cb_event_t event, esp_gatt_if_t gatts_if,
+                                esp_ble_gatts_cb_param_t *param) {
+    if (event == ESP_GATTS_REG_EVT) {
+        if (param->reg.status == ESP_GATT_OK) {
+            gl_profile_tab[param->reg.app_id].gatts_if = gatts_if;
+        } else {
+            ESP_LOGE(TAG, "Reg app failed, app_id %04x, status %d",
+                     param->reg.app_id, param->reg.status);
+            return;
+        }
+    }
+
+    for (int idx = 0; idx < PROFILE_NUM; idx++) {
+        if (gatts_if == ESP_GATT_IF_NONE ||
+            gatts_if == gl_profile_tab[idx].gatts_if) {
+            if (gl_profile_tab[idx].gatts_cb) {
+                gl_profile_tab[idx].gatts_cb(event, gatts_if, param);
+            }
+        }
+    }
+}
+
+static const uint8_t char_prop_rw = ESP_GATT_CHAR_PROP_BIT_READ | ESP_GATT_CHAR_PROP_BIT_WRITE;
+static const uint8_t char_prop_r = ESP_GATT_CHAR_PROP_BIT_READ | ESP_GATT_CHAR_PROP_BIT_NOTIFY;
+static const uint8_t char_prop_ro = ESP_GATT_CHAR_PROP_BIT_READ;
+
+static const esp_gatts_attr_db_t gatt_db[GATTS_NUM_HANDLE] = {
+    // Service Declaration
+    [0] = {{ESP_GATT_AUTO_RSP}, {ESP_UUID_LEN_16, (uint8_t *)&(uint16_t){ESP_GATT_UUID_PRI_SERVICE},
+            ESP_GATT_PERM_READ, sizeof(uint16_t), sizeof(GATTS_SERVICE_UUID), (uint8_t *)&(uint16_t){GATTS_SERVICE_UUID}}},
+
+    // Config Characteristic Declaration
+    [1] = {{ESP_GATT_AUTO_RSP}, {ESP_UUID_LEN_16, (uint8_t *)&(uint16_t){ESP_GATT_UUID_CHAR_DECLARE},
+            ESP_GATT_PERM_READ, sizeof(uint8_t), sizeof(uint8_t), (uint8_t *)&char_prop_rw}},
+
+    // Config Characteristic Value
+    [2] = {{ESP_GATT_RSP_BY_APP}, {ESP_UUID_LEN_16, (uint8_t *)&(uint16_t){GATTS_CHAR_UUID_CONFIG},
+            ESP_GATT_PERM_READ | ESP_GATT_PERM_WRITE, GATTS_CONFIG_MAX_LEN, 0, NULL}},
+
+    // Status Characteristic Declaration
+    [3] = {{ESP_GATT_AUTO_RSP}, {ESP_UUID_LEN_16, (uint8_t *)&(uint16_t){ESP_GATT_UUID_CHAR_DECLARE},
+            ESP_GATT_PERM_READ, sizeof(uint8_t), sizeof(uint8_t), (uint8_t *)&char_prop_r}},
+
+    // Status Characteristic Value
+    [4] = {{ESP_GATT_RSP_BY_APP}, {ESP_UUID_LEN_16, (uint8_t *)&(uint16_t){GATTS_CHAR_UUID_STATUS},
+            ESP_GATT_PERM_READ, GATTS_STATUS_MAX_LEN, 0, NULL}},
+
+    // Command Characteristic Declaration
+    [5] = {{ESP_GATT_AUTO_RSP}, {ESP_UUID_LEN_16, (uint8_t *)&(uint16_t){ESP_GATT_UUID_CHAR_DECLARE},
+            ESP_GATT_PERM_READ, sizeof(uint8_t), sizeof(uint8_t), (uint8_t *)&char_prop_rw}},
+
+    // Command Characteristic Value
+    [6] = {{ESP_GATT_RSP_BY_APP}, {ESP_UUID_LEN_16, (uint8_t *)&(uint16_t){GATTS_CHAR_UUID_CMD},
+            ESP_GATT_PERM_READ | ESP_GATT_PERM_WRITE, GATTS_CMD_MAX_LEN, 0, NULL}},
+
+    // Metrics Characteristic Declaration
+    [7] = {{ESP_GATT_AUTO_RSP}, {ESP_UUID_LEN_16, (uint8_t *)&(uint16_t){ESP_GATT_UUID_CHAR_DECLARE},
+            ESP_GATT_PERM_READ, sizeof(uint8_t), sizeof(uint8_t), (uint8_t *)&char_prop_ro}},
+
+    // Metrics Characteristic Value
+    [8] = {{ESP_GATT_RSP_BY_APP}, {ESP_UUID_LEN_16, (uint8_t *)&(uint16_t){GATTS_CHAR_UUID_METRICS},
+            ESP_GATT_PERM_READ, GATTS_METRICS_MAX_LEN, 0, NULL}},
+
+    // Link Quality Characteristic Declaration
+    [9] = {{ESP_GATT_AUTO_RSP}, {ESP_UUID_LEN_16, (uint8_t *)&(uint16_t){ESP_GATT_UUID_CHAR_DECLARE},
+            ESP_GATT_PERM_READ, sizeof(uint8_t), sizeof(uint8_t), (uint8_t *)&char_prop_ro}},
+
+    // Link Quality Characteristic Value
+    [10] = {{ESP_GATT_RSP_BY_APP}, {ESP_UUID_LEN_16, (uint8_t *)&(uint16_t){GATTS_CHAR_UUID_LINKS},
+            ESP_GATT_PERM_READ, GATTS_LINKS_MAX_LEN, 0, NULL}},
+};
+
+static void gatts_profile_event_handler(esp_gatts_cb_event_t event,
+                                        esp_gatt_if_t gatts_if,
+                                        esp_ble_gatts_cb_param_t *param) {
+    switch (event) {
+        case ESP_GATTS_REG_EVT:
+            ble_core_on_host_ready();
+            esp_ble_gap_config_adv_data(&adv_data);
+            adv_config_done |= ADV_CONFIG_FLAG;
+            esp_ble_gap_config_adv_data(&scan_rsp_data);
+            adv_config_done |= SCAN_RSP_CONFIG_FLAG;
+            esp_ble_gatts_create_attr_tab(gatt_db, gatts_if, GATTS_NUM_HANDLE, 0);
+            break;
+
+        case ESP_GATTS_CREAT_ATTR_TAB_EVT:
+            if (param->add_attr_tab.status != ESP_GATT_OK) {
+                ESP_LOGE(TAG, "Create attr table failed, error code=0x%x", param->add_attr_tab.status);
+            } else {
+                memcpy(gatts_handle_table, param->add_attr_tab.handles, sizeof(gatts_handle_table));
+                esp_ble_gatts_start_service(gatts_handle_table[0]);
+            }
+            break;
+
+        case ESP_GATTS_CONNECT_EVT:
+            ESP_LOGI(TAG, "Client connected, conn_id=%d", param->connect.conn_id);
+            gl_profile_tab[PROFILE_APP_ID].conn_id = param->connect.conn_id;
+            ble_core_on_connect();
+
+            // Leave airtime to 802.15.4 while the app is connected
+            esp_ble_conn_update_params_t conn_params = {0};
+            memcpy(conn_params.bda, param->connect.remote_bda, sizeof(esp_bd_addr_t));
+            conn_params.min_int = RADIO_COEX_BLE_CONN_INT_MIN;
+            conn_params.max_int = RADIO_COEX_BLE_CONN_INT_MAX;
+            conn_params.latency = RADIO_COEX_BLE_CONN_LATENCY;
+            conn_params.timeout = RADIO_COEX_BLE_CONN_TIMEOUT;
+            esp_ble_gap_update_conn_params(&conn_params);
+            break;
+
+        case ESP_GATTS_DISCONNECT_EVT:
+            ESP_LOGI(TAG, "Client disconnected, reason=0x%x", param->disconnect.reason);
+            if (ble_core_on_disconnect()) {
+                start_advertising();
+            }
+            break;
+
+        case ESP_GATTS_READ_EVT: {
+            esp_gatt_rsp_t rsp;
+            memset(&rsp, 0, sizeof(esp_gatt_rsp_t));
+            rsp.attr_value.handle = param->read.handle;
+
+            if (param->read.handle == gatts_handle_table[4]) {
+                // Status read
+                ble_core_on_status_read(rsp.attr_value.value, &rsp.attr_value.len);
+            } else if (param->read.handle == gatts_handle_table[8]) {
+                // Metrics read, in pieces below the negotiated MTU
+                ble_core_on_metrics_read(param->read.offset, rsp.attr_value.value, &rsp.attr_value.len);
+                rsp.attr_value.offset = param->read.offset;
+            } else if (param->read.handle == gatts_handle_table[10]) {
+                // Link quality read, long reads as for the metrics
+                ble_core_on_links_read(param->read.offset, rsp.attr_value.value, &rsp.attr_value.len);
+                rsp.attr_value.offset = param->read.offset;
+            }
+
+            esp_ble_gatts_send_response(gatts_if, param->read.conn_id,
+                                       param->read.trans_id, ESP_GATT_OK, &rsp);
+            break;
+        }
+
+        case ESP_GATTS_WRITE_EVT:
+            if (!param->write.is_prep) {
+                if (param->write.handle == gatts_handle_table[2] ||
+                    param->write.handle == gatts_handle_table[6]) {
+                    ble_core_on_write(param->write.value, param->write.len);
+                }
+            }
+
+            if (param->write.need_rsp) {
+                esp_ble_gatts_send_response(gatts_if, param->write.conn_id,
+                                           param->write.trans_id, ESP_GATT_OK, NULL);
+            }
+            break;
+
+        default:
+            break;
+    }
+}
+
+/* ============================================================================
+ * BACKEND API IMPLEMENTATION
+ * ============================================================================ */
+
+esp_err_t ble_backend_start(void) {
+    esp_err_t ret;
+
+    adv_data.p_manufacturer_data = (uint8_t *)ble_core_beacon_data();
+    adv_config_done = 0;
+
+    esp_bt_controller_config_t bt_cfg = BT_CONTROLLER_INIT_CONFIG_DEFAULT();
+    ret = esp_bt_controller_init(&bt_cfg);
+    if (ret) {
+        ESP_LOGE(TAG, "BT controller init failed: %s", esp_err_to_name(ret));
+        return ret;
+    }
+
+    ret = esp_bt_controller_enable(ESP_BT_MODE_BLE);
+    if (ret) {
+        ESP_LOGE(TAG, "BT controller enable failed: %s", esp_err_to_name(ret));
+        return ret;
+    }
+
+    ret = esp_bluedroid_init();
+    if (ret) {
+        ESP_LOGE(TAG, "Bluedroid init failed: %s", esp_err_to_name(ret));
+        return ret;
+    }
+
+    ret = esp_bluedroid_enable();
+    if (ret) {
+        ESP_LOGE(TAG, "Bluedroid enable failed: %s", esp_err_to_name(ret));
+        return ret;
+    }
+
+    ret = esp_ble_gatts_register_callback(gatts_event_handler);
+    if (ret) {
+        ESP_LOGE(TAG, "GATTS register callback failed: %s", esp_err_to_name(ret));
+        return ret;
+    }
+
+    ret = esp_ble_gap_register_callback(gap_event_handler);
+    if (ret) {
+        ESP_LOGE(TAG, "GAP register callback failed: %s", esp_err_to_name(ret));
+        return ret;
+    }
+
+    // FIX: SEC #2 - Enable BLE security (encryption and authentication)
+    ESP_LOGI(TAG, "Configuring BLE security...");
+
+    // Set authentication requirements: Secure Connections + MITM protection + Bonding
+    esp_ble_auth_req_t auth_req = ESP_LE_AUTH_REQ_SC_MITM_BOND;
+    ret = esp_ble_gap_set_security_param(ESP_BLE_SM_AUTHEN_REQ_MODE, &auth_req, sizeof(uint8_t));
+    if (ret) {
+        ESP_LOGW(TAG, "Set auth req failed: %s", esp_err_to_name(ret));
+    }
+
+    // Set IO capability (display-only for PIN display)
+    esp_ble_io_cap_t iocap = ESP_IO_CAP_OUT;
+    ret = esp_ble_gap_set_security_param(ESP_BLE_SM_IOCAP_MODE, &iocap, sizeof(uint8_t));
+    if (ret) {
+        ESP_LOGW(TAG, "Set IO cap failed: %s", esp_err_to_name(ret));
+    }
+
+    // Set key size (128-bit)
+    uint8_t key_size = 16;
+    ret = esp_ble_gap_set_security_param(ESP_BLE_SM_MAX_KEY_SIZE, &key_size, sizeof(uint8_t));
+    if (ret) {
+        ESP_LOGW(TAG, "Set key size failed: %s", esp_err_to_name(ret));
+    }
+
+    // Enable encryption
+    uint8_t init_key = ESP_BLE_ENC_KEY_MASK | ESP_BLE_ID_KEY_MASK;
+    ret = esp_ble_gap_set_security_param(ESP_BLE_SM_SET_INIT_KEY, &init_key, sizeof(uint8_t));
+    if (ret) {
+        ESP_LOGW(TAG, "Set init key failed: %s", esp_err_to_name(ret));
+    }
+
+    uint8_t rsp_key = ESP_BLE_ENC_KEY_MASK | ESP_BLE_ID_KEY_MASK;
+    ret = esp_ble_gap_set_security_param(ESP_BLE_SM_SET_RSP_KEY, &rsp_key, sizeof(uint8_t));
+    if (ret) {
+        ESP_LOGW(TAG, "Set rsp key failed: %s", esp_err_to_name(ret));
+    }
+
+    ESP_LOGI(TAG, "BLE security configured - pairing required for connections");
+
+    ret = esp_ble_gatts_app_register(PROFILE_APP_ID);
+    if (ret) {
+        ESP_LOGE(TAG, "GATTS app register failed: %s", esp_err_to_name(ret));
+        return ret;
+    }
+
+    esp_ble_gatt_set_local_mtu(GATTS_LOCAL_MTU);
+    return ESP_OK;
+}
+
+esp_err_t ble_backend_stop(void) {
+    g_beacon_live = false;
+    g_beacon_adv_update = false;
+    esp_ble_gap_stop_advertising();
+    esp_bluedroid_disable();
+    esp_bluedroid_deinit();
+    esp_bt_controller_disable();
+    esp_bt_controller_deinit();
+    return ESP_OK;
+}
+
+esp_err_t ble_backend_set_name(const char *name) {
+    return esp_ble_gap_set_device_name(name);
+}
+
+esp_err_t ble_backend_adv_start(void) {
+    start_advertising();
+    return ESP_OK;
+}
+
+esp_err_t ble_backend_adv_stop(void) {
+    return esp_ble_gap_stop_advertising();
+}
+
+esp_err_t ble_backend_adv_data_update(void) {
+    if (!g_beacon_live) {
+        return ESP_OK;  // Picked up when advertising data is first configured
+    }
+
+    g_beacon_adv_update = true;
+    esp_err_t ret = esp_ble_gap_config_adv_data(&adv_data);
+    if (ret != ESP_OK) {
+        g_beacon_adv_update = false;
+    }
+    return ret;
+}
+
+const char *ble_backend_name(void) {
+    return "Bluedroid";
+}
@@ -0,0 +1,399 @@
+/*
+ * BLE Provisioning - NimBLE backend
+ * Same GATT layout, advertising and security as the Bluedroid backend,
+ * on the smaller NimBLE host (CONFIG_BT_NIMBLE_ENABLED=y)
+ */
+
+#include "ble_provision_priv.h"
+#include <string.h>
+#include "esp_log.h"
+#include "esp_random.h"
+#include "nimble/nimble_port.h"
+#include "nimble/nimble_port_freertos.h"
+#include "host/ble_hs.h"
+#include "host/util/util.h"
+#include "services/gap/ble_svc_gap.h"
+#include "services/gatt/ble_svc_gatt.h"
+#include "radio_coex.h"
+
+static const char *TAG = "BLE_PROV";
+
+// Provided by the NimBLE port (store/config), not exported in a header
+void ble_store_config_init(void);
+
+/* ============================================================================
+ * GLOBAL VARIABLES
+ * ============================================================================ */
+
+static const ble_uuid128_t g_service_uuid128 = BLE_UUID128_INIT(BLE_PROV_SERVICE_UUID128);
+
+static uint16_t g_config_val_handle;
+static uint16_t g_status_val_handle;
+static uint16_t g_cmd_val_handle;
+static uint16_t g_metrics_val_handle;
+static uint16_t g_links_val_handle;
+
+static uint8_t g_own_addr_type = BLE_OWN_ADDR_PUBLIC;
+static bool g_synced = false;               // Host and controller in sync
+static uint16_t g_conn_handle = BLE_HS_CONN_HANDLE_NONE;
+
+// Write buffer, only touched from the NimBLE host task
+static uint8_t g_write_buf[GATTS_CONFIG_MAX_LEN];
+
+/* ============================================================================
+ * GATT SERVICE
+ * ============================================================================ */
+
+static int gatt_access_cb(uint16_t conn_handle, uint16_t attr_handle,
+                          struct ble_gatt_access_ctxt *ctxt, void *arg);
+
+static const struct ble_gatt_svc_def gatt_svcs[] = {
+    {
+        .type = BLE_GATT_SVC_TYPE_PRIMARY,
+        .uuid = BLE_UUID16_DECLARE(GATTS_SERVICE_UUID),
+        .characteristics = (struct ble_gatt_chr_def[]) {
+            {
+                // Config Characteristic
+                .uuid = BLE_UUID16_DECLARE(GATTS_CHAR_UUID_CONFIG),
+                .access_cb = gatt_access_cb,
+                .flags = BLE_GATT_CHR_F_READ | BLE_GATT_CHR_F_WRITE,
+                .val_handle = &g_config_val_handle,
+            },
+            {
+                // Status Characteristic
+                .uuid = BLE_UUID16_DECLARE(GATTS_CHAR_UUID_STATUS),
+                .access_cb = gatt_access_cb,
+                .flags = BLE_GATT_CHR_F_READ | BLE_GATT_CHR_F_NOTIFY,
+                .val_handle = &g_status_val_handle,
+            },
+            {
+                // Command Characteristic
+                .uuid = BLE_UUID16_DECLARE(GATTS_CHAR_UUID_CMD),
+                .access_cb = gatt_access_cb,
+                .flags = BLE_GATT_CHR_F_READ | BLE_GATT_CHR_F_WRITE,
+                .val_handle = &g_cmd_val_handle,
+            },
+            {
+                // Metrics Characteristic
+                .uuid = BLE_UUID16_DECLARE(GATTS_CHAR_UUID_METRICS),
+                .access_cb = gatt_access_cb,
+                .flags = BLE_GATT_CHR_F_READ,
+                .val_handle = &g_metrics_val_handle,
+            },
+            {
+                // Link Quality Characteristic
+                .uuid = BLE_UUID16_DECLARE(GATTS_CHAR_UUID_LINKS),
+                .access_cb = gatt_access_cb,
+                .flags = BLE_GATT_CHR_F_READ,
+                .val_handle = &g_links_val_handle,
+            },
+            { 0 },
+        },
+    },
+    { 0 },
+};
+
+static int gatt_access_cb(uint16_t conn_handle, uint16_t attr_handle,
+                          struct ble_gatt_access_ctxt *ctxt, void *arg) {
+    switch (ctxt->op) {
+        case BLE_GATT_ACCESS_OP_READ_CHR:
+            if (attr_handle == g_status_val_handle) {
+                uint8_t data[GATTS_STATUS_MAX_LEN];
+                uint16_t len = 0;
+                ble_core_on_status_read(data, &len);
+                if (os_mbuf_append(ctxt->om, data, len) != 0) {
+                    return BLE_ATT_ERR_INSUFFICIENT_RES;
+                }
+            } else if (attr_handle == g_metrics_val_handle) {
+                // NimBLE slices long reads itself from the whole value and
+                // calls us for every piece, without the offset
+                uint8_t data[GATTS_METRICS_MAX_LEN];
+                uint16_t len = 0;
+                ble_core_on_metrics_read_whole(ble_att_mtu(conn_handle) - 1, data, &len);
+                if (os_mbuf_append(ctxt->om, data, len) != 0) {
+                    return BLE_ATT_ERR_INSUFFICIENT_RES;
+                }
+            } else if (attr_handle == g_links_val_handle) {
+                uint8_t data[GATTS_LINKS_MAX_LEN];
+                uint16_t len = 0;
+                ble_core_on_links_read_whole(ble_att_mtu(conn_handle) - 1, data, &len);
+                if (os_mbuf_append(ctxt->om, data, len) != 0) {
+                    return BLE_ATT_ERR_INSUFFICIENT_RES;
+                }
+            }
+            // Config / command reads return empty, as with Bluedroid
+            return 0;
+
+        case BLE_GATT_ACCESS_OP_WRITE_CHR: {
+            uint16_t max_len = attr_handle == g_cmd_val_handle ?
+                               GATTS_CMD_MAX_LEN : GATTS_CONFIG_MAX_LEN;
+            uint16_t len = 0;
+            if (ble_hs_mbuf_to_flat(ctxt->om, g_write_buf, max_len, &len) != 0) {
+                return BLE_ATT_ERR_INVALID_ATTR_VALUE_LEN;
+            }
+            ble_core_on_write(g_write_buf, len);
+            return 0;
+        }
+
+        default:
+            return BLE_ATT_ERR_UNLIKELY;
+    }
+}
+
+/* ============================================================================
+ * ADVERTISING
+ * ============================================================================ */
+
+static int gap_event_handler(struct ble_gap_event *event, void *arg);
+
+// Advertising packet: flags + status beacon + service UUID (31 bytes),
+// name in the scan response
+static int set_adv_fields(void) {
+    struct ble_hs_adv_fields fields;
+    memset(&fields, 0, sizeof(fields));
+    fields.flags = BLE_HS_ADV_F_DISC_GEN | BLE_HS_ADV_F_BREDR_UNSUP;
+    fields.mfg_data = ble_core_beacon_data();
+    fields.mfg_data_len = BLE_BEACON_LEN;
+    fields.uuids128 = &g_service_uuid128;
+    fields.num_uuids128 = 1;
+    fields.uuids128_is_complete = 1;
+    return ble_gap_adv_set_fields(&fields);
+}
+
+static int set_scan_rsp_fields(void) {
+    const char *name = ble_svc_gap_device_name();
+    struct ble_hs_adv_fields rsp;
+    memset(&rsp, 0, sizeof(rsp));
+    rsp.name = (const uint8_t *)name;
+    rsp.name_len = strlen(name);
+    rsp.name_is_complete = 1;
+    return ble_gap_adv_rsp_set_fields(&rsp);
+}
+
+static void start_advertising(void) {
+    if (!g_synced || ble_gap_adv_active()) {
+        return;
+    }
+
+    int rc = set_adv_fields();
+    if (rc == 0) {
+        rc = set_scan_rsp_fields();
+    }
+    if (rc != 0) {
+        ESP_LOGE(TAG, "Advertising data config failed, rc=%d", rc);
+        return;
+    }
+
+    struct ble_gap_adv_params adv_params;
+    memset(&adv_params, 0, sizeof(adv_params));
+    adv_params.conn_mode = BLE_GAP_CONN_MODE_UND;
+    adv_params.disc_mode = BLE_GAP_DISC_MODE_GEN;
+    ble_core_get_adv_interval(&adv_params.itvl_min, &adv_params.itvl_max);
+
+    rc = ble_gap_adv_start(g_own_addr_type, NULL, BLE_HS_FOREVER,
+                           &adv_params, gap_event_handler, NULL);
+    if (rc != 0) {
+        ESP_LOGE(TAG, "Advertising start failed, rc=%d", rc);
+        return;
+    }
+    ble_core_on_adv_started();
+}
+
+/* ============================================================================
+ * GAP EVENT HANDLER
+ * ============================================================================ */
+
+static int gap_event_handler(struct ble_gap_event *event, void *arg) {
+    switch (event->type) {
+        case BLE_GAP_EVENT_CONNECT:
+            if (event->connect.status != 0) {
+                // Connection failed: advertising has stopped, resume it
+                ble_core_on_adv_stopped();
+                if (ble_core_on_disconnect()) {
+                    start_advertising();
+                }
+                break;
+            }
+
+            ESP_LOGI(TAG, "Client connected, conn_id=%d", event->connect.conn_handle);
+            g_conn_handle = event->connect.conn_handle;
+            ble_core_on_connect();
+
+            // Leave airtime to 802.15.4 while the app is connected
+            struct ble_gap_upd_params conn_params = {
+                .itvl_min = RADIO_COEX_BLE_CONN_INT_MIN,
+                .itvl_max = RADIO_COEX_BLE_CONN_INT_MAX,
+                .latency = RADIO_COEX_BLE_CONN_LATENCY,
+                .supervision_timeout = RADIO_COEX_BLE_CONN_TIMEOUT,
+            };
+            ble_gap_update_params(g_conn_handle, &conn_params);
+            break;
+
+        case BLE_GAP_EVENT_DISCONNECT:
+            ESP_LOGI(TAG, "Client disconnected, reason=0x%x", event->disconnect.reason);
+            g_conn_handle = BLE_HS_CONN_HANDLE_NONE;
+            if (ble_core_on_disconnect()) {
+                start_advertising();
+            }
+            break;
+
+        case BLE_GAP_EVENT_ADV_COMPLETE:
+            ESP_LOGI(TAG, "Advertising stopped");
+            ble_core_on_adv_stopped();
+            break;
+
+        case BLE_GAP_EVENT_CONN_UPDATE:
+            ESP_LOGI(TAG, "Connection params updated");
+            break;
+
+        case BLE_GAP_EVENT_PASSKEY_ACTION:
+            // Display-only IO capability: we generate the passkey
+            if (event->passkey.params.action == BLE_SM_IOACT_DISP) {
+                struct ble_sm_io pkey = {0};
+                pkey.action = BLE_SM_IOACT_DISP;
+                pkey.passkey = esp_random() % 1000000;
+                ESP_LOGI(TAG, "Pairing passkey: %06lu", (unsigned long)pkey.passkey);
+                ble_sm_inject_io(event->passkey.conn_handle, &pkey);
+            }
+            break;
+
+        case BLE_GAP_EVENT_REPEAT_PAIRING: {
+            // Phone lost its bond: drop ours and pair again
+            struct ble_gap_conn_desc desc;
+            if (ble_gap_conn_find(event->repeat_pairing.conn_handle, &desc) == 0) {
+                ble_store_util_delete_peer(&desc.peer_id_addr);
+            }
+            return BLE_GAP_REPEAT_PAIRING_RETRY;
+        }
+
+        default:
+            break;
+    }
+    return 0;
+}
+
+/* ============================================================================
+ * HOST CALLBACKS
+ * ============================================================================ */
+
+static void on_sync(void) {
+    int rc = ble_hs_util_ensure_addr(0);
+    if (rc == 0) {
+        rc = ble_hs_id_infer_auto(0, &g_own_addr_type);
+    }
+    if (rc != 0) {
+        ESP_LOGE(TAG, "No usable BLE address, rc=%d", rc);
+        return;
+    }
+
+    g_synced = true;
+    ble_core_on_host_ready();
+    start_advertising();
+}
+
+static void on_reset(int reason) {
+    g_synced = false;
+    ESP_LOGW(TAG, "NimBLE host reset, reason=%d", reason);
+}
+
+static void host_task(void *param) {
+    nimble_port_run();  // Returns after nimble_port_stop()
+    nimble_port_freertos_deinit();
+}
+
+/* ============================================================================
+ * BACKEND API IMPLEMENTATION
+ * ============================================================================ */
+
+esp_err_t ble_backend_start(void) {
+    esp_err_t ret = nimble_port_init();
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "NimBLE init failed: %s", esp_err_to_name(ret));
+        return ret;
+    }
+
+    ble_hs_cfg.sync_cb = on_sync;
+    ble_hs_cfg.reset_cb = on_reset;
+    ble_hs_cfg.store_status_cb = ble_store_util_status_rr;
+
+    // FIX: SEC #2 - Secure Connections + MITM protection + Bonding,
+    // display-only IO capability, encryption and identity keys exchanged
+    ble_hs_cfg.sm_io_cap = BLE_SM_IO_CAP_DISP_ONLY;
+    ble_hs_cfg.sm_bonding = 1;
+    ble_hs_cfg.sm_mitm = 1;
+    ble_hs_cfg.sm_sc = 1;
+    ble_hs_cfg.sm_our_key_dist = BLE_SM_PAIR_KEY_DIST_ENC | BLE_SM_PAIR_KEY_DIST_ID;
+    ble_hs_cfg.sm_their_key_dist = BLE_SM_PAIR_KEY_DIST_ENC | BLE_SM_PAIR_KEY_DIST_ID;
+    ESP_LOGI(TAG, "BLE security configured - pairing required for connections");
+
+    ble_svc_gap_init();
+    ble_svc_gatt_init();
+
+    int rc = ble_gatts_count_cfg(gatt_svcs);
+    if (rc == 0) {
+        rc = ble_gatts_add_svcs(gatt_svcs);
+    }
+    if (rc != 0) {
+        ESP_LOGE(TAG, "GATT service registration failed, rc=%d", rc);
+        nimble_port_deinit();
+        return ESP_FAIL;
+    }
+
+    ble_att_set_preferred_mtu(GATTS_LOCAL_MTU);
+    ble_store_config_init();
+
+    nimble_port_freertos_init(host_task);
+    return ESP_OK;
+}
+
+esp_err_t ble_backend_stop(void) {
+    if (g_synced) {
+        ble_gap_adv_stop();
+    }
+    g_synced = false;
+
+    if (nimble_port_stop() == 0) {
+        nimble_port_deinit();
+    }
+    return ESP_OK;
+}
+
+esp_err_t ble_backend_set_name(const char *name) {
+    if (ble_svc_gap_device_name_set(name) != 0) {
+        return ESP_FAIL;
+    }
+    if (g_synced && ble_gap_adv_active()) {
+        set_scan_rsp_fields();
+    }
+    return ESP_OK;
+}
+
+esp_err_t ble_backend_adv_start(void) {
+    start_advertising();
+    return ESP_OK;
+}
+
+esp_err_t ble_backend_adv_stop(void) {
+    if (!g_synced || !ble_gap_adv_active()) {
+        return ESP_OK;
+    }
+
+    // NimBLE stops synchronously and reports no event
+    int rc = ble_gap_adv_stop();
+    if (rc == 0) {
+        ESP_LOGI(TAG, "Advertising stopped");
+        ble_core_on_adv_stopped();
+    }
+    return rc == 0 ? ESP_OK : ESP_FAIL;
+}
+
+esp_err_t ble_backend_adv_data_update(void) {
+    if (!g_synced || !ble_gap_adv_active()) {
+        return ESP_OK;  // Picked up on the next advertising start
+    }
+    return set_adv_fields() == 0 ? ESP_OK : ESP_FAIL;
+}
+
+const char *ble_backend_name(void) {
+    return "NimBLE";
+}
@@ -0,0 +1,146 @@
+/*
+ * BLE Provisioning - internal interface between the core (ble_provision.c)
+ * and the BLE host backend (ble_provision_bluedroid.c / ble_provision_nimble.c).
+ * Not part of the public API.
+ */
+
+#ifndef BLE_PROVISION_PRIV_H
+#define BLE_PROVISION_PRIV_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "esp_err.h"
+#include "ble_provision.h"
+#include "metrics.h"
+#include "link_quality.h"
+
+/* ============================================================================
+ * GATT LAYOUT (identical for every backend)
+ * ============================================================================ */
+
+#define DEVICE_NAME_PREFIX      "Cultivio-"
+#define GATTS_SERVICE_UUID      0x00FF
+#define GATTS_CHAR_UUID_CONFIG  0xFF01  // Read/Write: configuration commands
+#define GATTS_CHAR_UUID_STATUS  0xFF02  // Read/Notify: status response
+#define GATTS_CHAR_UUID_CMD     0xFF03  // Read/Write: same commands as config
+#define GATTS_CHAR_UUID_METRICS 0xFF04  // Read: runtime metrics snapshot + task table (metrics.h)
+#define GATTS_CHAR_UUID_LINKS   0xFF05  // Read: per-neighbour link quality (link_quality.h)
+
+#define GATTS_CONFIG_MAX_LEN    512
+#define GATTS_STATUS_MAX_LEN    64
+#define GATTS_CMD_MAX_LEN       64
+#define GATTS_METRICS_MAX_LEN   (METRICS_ENCODED_MAX + METRICS_TASKS_ENCODED_MAX)
+_Static_assert(GATTS_METRICS_MAX_LEN <= 512, "metrics snapshot exceeds the ATT attribute limit");
+#define GATTS_LINKS_MAX_LEN     LINK_ENCODED_MAX
+#define GATTS_LOCAL_MTU         500
+#define GATTS_LONG_READ_TIMEOUT_MS  2000    // A long read idle this long is abandoned
+
+// Service UUID as advertised (128-bit, little endian, 0x00FF on the SIG base)
+#define BLE_PROV_SERVICE_UUID128 \
+    0xfb, 0x34, 0x9b, 0x5f, 0x80, 0x00, 0x00, 0x80, \
+    0x00, 0x10, 0x00, 0x00, 0xFF, 0x00, 0x00, 0x00
+
+/* ============================================================================
+ * BACKEND API (implemented by the selected BLE host)
+ * ============================================================================ */
+
+/**
+ * Bring up controller + host, register the GATT service and security
+ * parameters. Once the host is ready the backend calls
+ * ble_core_on_host_ready() and starts advertising.
+ */
+esp_err_t ble_backend_start(void);
+
+/**
+ * Stop advertising and tear the controller + host down
+ */
+esp_err_t ble_backend_stop(void);
+
+/**
+ * Set the GAP device name (also used in the scan response)
+ */
+esp_err_t ble_backend_set_name(const char *name);
+
+/**
+ * Start advertising with the interval from ble_core_get_adv_interval()
+ */
+esp_err_t ble_backend_adv_start(void);
+
+/**
+ * Stop advertising
+ */
+esp_err_t ble_backend_adv_stop(void);
+
+/**
+ * Beacon content changed: push new advertising data if advertising
+ */
+esp_err_t ble_backend_adv_data_update(void);
+
+/**
+ * Backend name for logs and reports ("Bluedroid" / "NimBLE")
+ */
+const char *ble_backend_name(void);
+
+/* ============================================================================
+ * CORE CALLBACKS (implemented by ble_provision.c, called from the host task)
+ * ============================================================================ */
+
+void ble_core_on_host_ready(void);
+void ble_core_on_adv_started(void);
+void ble_core_on_adv_stopped(void);
+void ble_core_on_connect(void);
+
+/**
+ * @return true if the backend should restart advertising
+ */
+bool ble_core_on_disconnect(void);
+
+/**
+ * Write to the config or command characteristic
+ */
+void ble_core_on_write(const uint8_t *data, uint16_t len);
+
+/**
+ * Read of the status characteristic
+ * @param data Output buffer, GATTS_STATUS_MAX_LEN bytes
+ * @param len Output length
+ */
+void ble_core_on_status_read(uint8_t *data, uint16_t *len);
+
+/**
+ * Read of the metrics characteristic. A read at offset 0 takes a fresh
+ * snapshot; long reads (offset > 0) continue from the same one.
+ * @param data Output buffer, GATTS_METRICS_MAX_LEN bytes
+ * @param len Output length from offset
+ */
+void ble_core_on_metrics_read(uint16_t offset, uint8_t *data, uint16_t *len);
+
+/**
+ * Read of the metrics characteristic for a host that slices long reads
+ * itself (NimBLE): the whole value every time, and no offset. Each call is
+ * one Read or Read Blob response of up to piece bytes; the snapshot is kept
+ * until the client has had all of it, or GATTS_LONG_READ_TIMEOUT_MS.
+ * @param piece Response payload, ATT MTU - 1
+ * @param data Output buffer, GATTS_METRICS_MAX_LEN bytes
+ * @param len Output length of the whole value
+ */
+void ble_core_on_metrics_read_whole(uint16_t piece, uint8_t *data, uint16_t *len);
+
+/**
+ * Read of the link quality characteristic, snapshotted like the metrics
+ * @param data Output buffer, GATTS_LINKS_MAX_LEN bytes
+ * @param len Output length from offset
+ */
+void ble_core_on_links_read(uint16_t offset, uint8_t *data, uint16_t *len);
+
+/**
+ * Whole-value read of the link quality characteristic, as
+ * ble_core_on_metrics_read_whole()
+ * @param data Output buffer, GATTS_LINKS_MAX_LEN bytes
+ */
+void ble_core_on_links_read_whole(uint16_t piece, uint8_t *data, uint16_t *len);
+
+void ble_core_get_adv_interval(uint16_t *min, uint16_t *max);
+const uint8_t *ble_core_beacon_data(void);
+
+#endif // BLE_PROVISION_PRIV_H
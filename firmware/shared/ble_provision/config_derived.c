@@ -0,0 +1,65 @@
+/*
+ * Derived Configuration Implementation
+ * No ESP-IDF dependencies (also built by test_native)
+ */
+
+#include "config_derived.h"
+#include <string.h>
+
+#define PI_F    3.14159265f
+
+void config_derive(const device_config_t *cfg, config_derived_t *out)
+{
+    memset(out, 0, sizeof(*out));
+
+    // Tank geometry
+    out->tank_height_cm = cfg->tank_height_cm;
+    if (out->tank_height_cm == 0) {
+        out->tank_height_cm = CONFIG_DEFAULT_TANK_HEIGHT_CM;
+        out->defaults_applied = true;
+    }
+    out->sensor_offset_cm = cfg->sensor_offset_cm;
+    out->max_distance_cm = (float)(out->tank_height_cm + CONFIG_SENSOR_TOLERANCE_CM);
+    out->pct_per_cm = 100.0f / out->tank_height_cm;
+
+    float radius_cm = cfg->tank_diameter_cm / 2.0f;
+    out->litres_per_cm = PI_F * radius_cm * radius_cm / 1000.0f;
+    out->capacity_litres = (uint32_t)(out->litres_per_cm * out->tank_height_cm);
+
+    uint16_t interval_sec = cfg->report_interval_sec;
+    if (interval_sec == 0) {
+        interval_sec = CONFIG_DEFAULT_REPORT_INTERVAL_SEC;
+        out->defaults_applied = true;
+    }
+    out->report_interval_ms = (uint32_t)interval_sec * 1000;
+
+    // Hysteresis band: fall back to defaults as a pair so ON < OFF always holds
+    out->pump_on_pct = cfg->pump_on_threshold;
+    out->pump_off_pct = cfg->pump_off_threshold;
+    if (out->pump_on_pct == 0) {
+        out->pump_on_pct = CONFIG_DEFAULT_PUMP_ON_PCT;
+        out->defaults_applied = true;
+    }
+    if (out->pump_off_pct == 0) {
+        out->pump_off_pct = CONFIG_DEFAULT_PUMP_OFF_PCT;
+        out->defaults_applied = true;
+    }
+    if (out->pump_off_pct > 100 || out->pump_on_pct >= out->pump_off_pct) {
+        out->pump_on_pct = CONFIG_DEFAULT_PUMP_ON_PCT;
+        out->pump_off_pct = CONFIG_DEFAULT_PUMP_OFF_PCT;
+        out->defaults_applied = true;
+    }
+
+    // FIX: BUG #3 - uint32_t so minutes * 60 cannot overflow
+    uint32_t timeout_min = cfg->pump_timeout_minutes;
+    if (timeout_min == 0) {
+        timeout_min = CONFIG_DEFAULT_PUMP_TIMEOUT_MIN;
+        out->defaults_applied = true;
+    }
+    out->pump_timeout_sec = timeout_min * 60;
+    if (out->pump_timeout_sec > CONFIG_MAX_PUMP_TIMEOUT_SEC) {
+        out->pump_timeout_sec = CONFIG_MAX_PUMP_TIMEOUT_SEC;
+        out->pump_timeout_capped = true;
+    }
+    out->pump_timeout_us = (int64_t)out->pump_timeout_sec * 1000000;
+}
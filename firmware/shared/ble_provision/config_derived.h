@@ -0,0 +1,68 @@
+/*
+ * Derived Configuration
+ * Values the control paths need, resolved and precomputed once per config change
+ */
+
+#ifndef CONFIG_DERIVED_H
+#define CONFIG_DERIVED_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "ble_provision.h"
+
+/* ============================================================================
+ * DEFAULTS AND LIMITS
+ * ============================================================================ */
+
+// Used when a stored field is 0 or out of range
+#define CONFIG_DEFAULT_TANK_HEIGHT_CM       200
+#define CONFIG_DEFAULT_PUMP_ON_PCT          20
+#define CONFIG_DEFAULT_PUMP_OFF_PCT         80
+#define CONFIG_DEFAULT_PUMP_TIMEOUT_MIN     60
+#define CONFIG_DEFAULT_REPORT_INTERVAL_SEC  5
+
+#define CONFIG_MAX_PUMP_TIMEOUT_SEC         7200    // 2 hour safety limit
+#define CONFIG_SENSOR_TOLERANCE_CM          50      // Readings allowed beyond tank height
+
+/* ============================================================================
+ * DERIVED BLOCK
+ * ============================================================================ */
+
+typedef struct {
+    // Sensor: tank geometry
+    uint16_t tank_height_cm;            // Never 0
+    uint8_t  sensor_offset_cm;
+    float    max_distance_cm;           // Reject echoes at or beyond this
+    float    pct_per_cm;                // 100 / tank_height_cm
+    float    litres_per_cm;             // Cross-section (0 if diameter unknown)
+    uint32_t capacity_litres;
+    uint32_t report_interval_ms;
+
+    // Controller: hysteresis band and pump safety timeout
+    uint8_t  pump_on_pct;               // Start at or below
+    uint8_t  pump_off_pct;              // Stop at or above, always > pump_on_pct
+    uint32_t pump_timeout_sec;          // Capped to CONFIG_MAX_PUMP_TIMEOUT_SEC
+    int64_t  pump_timeout_us;
+
+    // What the resolver had to change (logged once per change, not per pass)
+    bool     defaults_applied;
+    bool     pump_timeout_capped;
+} config_derived_t;
+
+/* ============================================================================
+ * API
+ * ============================================================================ */
+
+/**
+ * Validate and resolve cfg into ready-to-use values. Pure function.
+ */
+void config_derive(const device_config_t *cfg, config_derived_t *out);
+
+/**
+ * Copy the derived block of the active config snapshot, compiled once per
+ * change (implemented by ble_provision.c). Same consistency rules as
+ * ble_provision_config_snapshot().
+ */
+void ble_provision_config_derived(config_derived_t *derived);
+
+#endif // CONFIG_DERIVED_H
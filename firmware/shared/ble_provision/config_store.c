@@ -0,0 +1,564 @@
+/*
+ * Versioned Configuration Store Implementation
+ * Cold "ident" record + hot per-field keys, with legacy blob migration
+ */
+
+#include "config_store.h"
+#include <string.h>
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "nvs.h"
+
+static const char *TAG = "CONFIG_STORE";
+
+#define NVS_NAMESPACE       "provision"
+#define KEY_VERSION         "cfg_ver"
+#define KEY_IDENT           "ident"
+#define KEY_LEGACY          "config"
+
+/* ============================================================================
+ * LEGACY IMAGES (frozen - never edit, add a new version instead)
+ * ============================================================================ */
+
+// Schema 1: device_config_t of firmware 1.0.x, stored raw
+typedef struct {
+    char device_name[32];
+    char custom_name[20];
+    char password[16];
+    char location[32];
+    bool password_enabled;
+    bool password_change_required;
+    prov_node_type_t node_type;
+    uint16_t tank_height_cm;
+    uint16_t tank_diameter_cm;
+    uint8_t  sensor_offset_cm;
+    uint8_t  pump_on_threshold;
+    uint8_t  pump_off_threshold;
+    uint16_t pump_timeout_minutes;
+    uint16_t zigbee_pan_id;
+    uint8_t  zigbee_channel;
+    uint16_t report_interval_sec;
+    bool provisioned;
+    uint32_t provision_timestamp;
+} config_v1_t;
+
+// Schema 2: schema 1 + BLE advertising policy and lazy bring-up fields
+typedef struct {
+    char device_name[32];
+    char custom_name[20];
+    char password[16];
+    char location[32];
+    bool password_enabled;
+    bool password_change_required;
+    prov_node_type_t node_type;
+    uint16_t tank_height_cm;
+    uint16_t tank_diameter_cm;
+    uint8_t  sensor_offset_cm;
+    uint8_t  pump_on_threshold;
+    uint8_t  pump_off_threshold;
+    uint16_t pump_timeout_minutes;
+    uint16_t zigbee_pan_id;
+    uint8_t  zigbee_channel;
+    uint16_t report_interval_sec;
+    bool provisioned;
+    uint32_t provision_timestamp;
+    uint8_t  ble_adv_policy;
+    uint8_t  ble_triggers;
+    uint16_t ble_idle_timeout_sec;
+} config_v2_t;
+
+// Legacy blobs are told apart by size; these match the ESP32-H2 ABI
+_Static_assert(sizeof(config_v1_t) == 132, "config_v1_t layout changed");
+_Static_assert(sizeof(config_v2_t) == 136, "config_v2_t layout changed");
+
+typedef union {
+    config_v1_t v1;
+    config_v2_t v2;
+    device_config_t current;
+} config_image_t;
+
+/* ============================================================================
+ * MIGRATION TABLE
+ * ============================================================================ */
+
+static void migrate_v1_to_v2(const config_image_t *from, config_image_t *to)
+{
+    const config_v1_t *v1 = &from->v1;
+    config_v2_t *v2 = &to->v2;
+
+    memcpy(v2->device_name, v1->device_name, sizeof(v2->device_name));
+    memcpy(v2->custom_name, v1->custom_name, sizeof(v2->custom_name));
+    memcpy(v2->password, v1->password, sizeof(v2->password));
+    memcpy(v2->location, v1->location, sizeof(v2->location));
+    v2->password_enabled = v1->password_enabled;
+    v2->password_change_required = v1->password_change_required;
+    v2->node_type = v1->node_type;
+    v2->tank_height_cm = v1->tank_height_cm;
+    v2->tank_diameter_cm = v1->tank_diameter_cm;
+    v2->sensor_offset_cm = v1->sensor_offset_cm;
+    v2->pump_on_threshold = v1->pump_on_threshold;
+    v2->pump_off_threshold = v1->pump_off_threshold;
+    v2->pump_timeout_minutes = v1->pump_timeout_minutes;
+    v2->zigbee_pan_id = v1->zigbee_pan_id;
+    v2->zigbee_channel = v1->zigbee_channel;
+    v2->report_interval_sec = v1->report_interval_sec;
+    v2->provisioned = v1->provisioned;
+    v2->provision_timestamp = v1->provision_timestamp;
+
+    // New fields: 0 = role/firmware defaults
+    v2->ble_adv_policy = 0;
+    v2->ble_triggers = 0;
+    v2->ble_idle_timeout_sec = 0;
+}
+
+static void migrate_v2_to_v3(const config_image_t *from, config_image_t *to)
+{
+    const config_v2_t *v2 = &from->v2;
+    device_config_t *cfg = &to->current;
+
+    memcpy(cfg->device_name, v2->device_name, sizeof(cfg->device_name));
+    memcpy(cfg->custom_name, v2->custom_name, sizeof(cfg->custom_name));
+    memcpy(cfg->password, v2->password, sizeof(cfg->password));
+    memcpy(cfg->location, v2->location, sizeof(cfg->location));
+    cfg->password_enabled = v2->password_enabled;
+    cfg->password_change_required = v2->password_change_required;
+    cfg->node_type = v2->node_type;
+    cfg->tank_height_cm = v2->tank_height_cm;
+    cfg->tank_diameter_cm = v2->tank_diameter_cm;
+    cfg->sensor_offset_cm = v2->sensor_offset_cm;
+    cfg->pump_on_threshold = v2->pump_on_threshold;
+    cfg->pump_off_threshold = v2->pump_off_threshold;
+    cfg->pump_timeout_minutes = v2->pump_timeout_minutes;
+    cfg->zigbee_pan_id = v2->zigbee_pan_id;
+    cfg->zigbee_channel = v2->zigbee_channel;
+    cfg->report_interval_sec = v2->report_interval_sec;
+    cfg->provisioned = v2->provisioned;
+    cfg->provision_timestamp = v2->provision_timestamp;
+
+    // Early schema 2 builds left the trigger/timeout bytes as struct padding
+    cfg->ble_adv_policy = v2->ble_adv_policy < BLE_ADV_POLICY_MAX ? v2->ble_adv_policy : 0;
+    cfg->ble_triggers = v2->ble_triggers & (BLE_TRIGGER_BUTTON | BLE_TRIGGER_BOOT |
+                                            BLE_TRIGGER_NETWORK_LOST | BLE_TRIGGER_FAULT);
+    cfg->ble_idle_timeout_sec = (v2->ble_idle_timeout_sec == 0 ||
+                                 v2->ble_idle_timeout_sec >= 30) ?
+                                v2->ble_idle_timeout_sec : 0;
+}
+
+typedef struct {
+    uint8_t version;        // Image version this step upgrades from
+    size_t  image_size;     // Size of that image as stored
+    void  (*upgrade)(const config_image_t *from, config_image_t *to);
+} config_migration_t;
+
+// Step i upgrades version i+1 to i+2; the last step yields device_config_t
+static const config_migration_t g_migrations[] = {
+    { 1, sizeof(config_v1_t), migrate_v1_to_v2 },
+    { 2, sizeof(config_v2_t), migrate_v2_to_v3 },
+};
+
+#define MIGRATION_COUNT (sizeof(g_migrations) / sizeof(g_migrations[0]))
+
+esp_err_t config_migrate_legacy(const uint8_t *blob, size_t len,
+                                device_config_t *config, uint8_t *from_version)
+{
+    if (!blob || !config) return ESP_ERR_INVALID_ARG;
+
+    size_t first = MIGRATION_COUNT;
+    for (size_t i = 0; i < MIGRATION_COUNT; i++) {
+        if (g_migrations[i].image_size == len) {
+            first = i;
+            break;
+        }
+    }
+    if (first == MIGRATION_COUNT) {
+        return ESP_ERR_INVALID_SIZE;
+    }
+
+    config_image_t a, b;
+    memset(&a, 0, sizeof(a));
+    memcpy(&a, blob, len);
+
+    for (size_t i = first; i < MIGRATION_COUNT; i++) {
+        memset(&b, 0, sizeof(b));
+        g_migrations[i].upgrade(&a, &b);
+        a = b;
+    }
+
+    // The last step sets every field of device_config_t
+    *config = a.current;
+    config->device_name[sizeof(config->device_name) - 1] = '\0';
+    config->custom_name[sizeof(config->custom_name) - 1] = '\0';
+    config->password[sizeof(config->password) - 1] = '\0';
+    config->location[sizeof(config->location) - 1] = '\0';
+
+    if (from_version) {
+        *from_version = g_migrations[first].version;
+    }
+    return ESP_OK;
+}
+
+/* ============================================================================
+ * COLD RECORD CODEC
+ * ============================================================================ */
+
+uint32_t config_crc32(const uint8_t *data, size_t len)
+{
+    uint32_t crc = 0xFFFFFFFF;
+    for (size_t i = 0; i < len; i++) {
+        crc ^= data[i];
+        for (int bit = 0; bit < 8; bit++) {
+            crc = (crc >> 1) ^ (0xEDB88320 & (0 - (crc & 1)));
+        }
+    }
+    return ~crc;
+}
+
+static void put_u16(uint8_t *p, uint16_t v)
+{
+    p[0] = v & 0xFF;
+    p[1] = v >> 8;
+}
+
+static void put_u32(uint8_t *p, uint32_t v)
+{
+    put_u16(p, v & 0xFFFF);
+    put_u16(p + 2, v >> 16);
+}
+
+static uint16_t get_u16(const uint8_t *p)
+{
+    return p[0] | (p[1] << 8);
+}
+
+static uint32_t get_u32(const uint8_t *p)
+{
+    return get_u16(p) | ((uint32_t)get_u16(p + 2) << 16);
+}
+
+static void put_str(uint8_t *p, const char *s, size_t size)
+{
+    memset(p, 0, size);
+    memcpy(p, s, strnlen(s, size - 1));
+}
+
+static void get_str(char *s, const uint8_t *p, size_t size)
+{
+    memcpy(s, p, size);
+    s[size - 1] = '\0';
+}
+
+// Payload offsets (schema 3). Append only.
+#define OFF_DEVICE_NAME     0
+#define OFF_CUSTOM_NAME     32
+#define OFF_PASSWORD        52
+#define OFF_LOCATION        68
+#define OFF_PASSWORD_EN     100
+#define OFF_PASSWORD_CHG    101
+#define OFF_NODE_TYPE       102
+#define OFF_PROVISIONED     103
+#define OFF_PROVISION_TS    104
+#define OFF_TANK_HEIGHT     108
+#define OFF_TANK_DIAMETER   110
+#define OFF_SENSOR_OFFSET   112
+#define OFF_PAN_ID          113
+#define OFF_CHANNEL         115
+
+size_t config_ident_encode(const device_config_t *config, uint8_t *out)
+{
+    uint8_t *p = out + CONFIG_IDENT_HEADER_LEN;
+
+    memset(p, 0, CONFIG_IDENT_PAYLOAD_LEN);
+    put_str(p + OFF_DEVICE_NAME, config->device_name, 32);
+    put_str(p + OFF_CUSTOM_NAME, config->custom_name, MAX_CUSTOM_NAME_LENGTH);
+    put_str(p + OFF_PASSWORD, config->password, MAX_PASSWORD_LENGTH);
+    put_str(p + OFF_LOCATION, config->location, 32);
+    p[OFF_PASSWORD_EN] = config->password_enabled;
+    p[OFF_PASSWORD_CHG] = config->password_change_required;
+    p[OFF_NODE_TYPE] = (uint8_t)config->node_type;
+    p[OFF_PROVISIONED] = config->provisioned;
+    put_u32(p + OFF_PROVISION_TS, config->provision_timestamp);
+    put_u16(p + OFF_TANK_HEIGHT, config->tank_height_cm);
+    put_u16(p + OFF_TANK_DIAMETER, config->tank_diameter_cm);
+    p[OFF_SENSOR_OFFSET] = config->sensor_offset_cm;
+    put_u16(p + OFF_PAN_ID, config->zigbee_pan_id);
+    p[OFF_CHANNEL] = config->zigbee_channel;
+
+    out[0] = CONFIG_SCHEMA_VERSION;
+    out[1] = 0;
+    put_u16(out + 2, CONFIG_IDENT_PAYLOAD_LEN);
+    put_u32(out + 4, config_crc32(p, CONFIG_IDENT_PAYLOAD_LEN));
+
+    return CONFIG_IDENT_HEADER_LEN + CONFIG_IDENT_PAYLOAD_LEN;
+}
+
+esp_err_t config_ident_decode(const uint8_t *data, size_t len, device_config_t *config)
+{
+    if (!data || !config || len < CONFIG_IDENT_HEADER_LEN) {
+        return ESP_ERR_INVALID_SIZE;
+    }
+
+    uint8_t version = data[0];
+    uint16_t payload_len = get_u16(data + 2);
+    const uint8_t *p = data + CONFIG_IDENT_HEADER_LEN;
+
+    if (version < CONFIG_SCHEMA_VERSION) {
+        return ESP_ERR_INVALID_VERSION;
+    }
+    if (payload_len < CONFIG_IDENT_PAYLOAD_LEN ||
+        (size_t)payload_len > len - CONFIG_IDENT_HEADER_LEN) {
+        return ESP_ERR_INVALID_SIZE;
+    }
+    if (config_crc32(p, payload_len) != get_u32(data + 4)) {
+        return ESP_ERR_INVALID_CRC;
+    }
+
+    get_str(config->device_name, p + OFF_DEVICE_NAME, 32);
+    get_str(config->custom_name, p + OFF_CUSTOM_NAME, MAX_CUSTOM_NAME_LENGTH);
+    get_str(config->password, p + OFF_PASSWORD, MAX_PASSWORD_LENGTH);
+    get_str(config->location, p + OFF_LOCATION, 32);
+    config->password_enabled = p[OFF_PASSWORD_EN] != 0;
+    config->password_change_required = p[OFF_PASSWORD_CHG] != 0;
+    config->node_type = (prov_node_type_t)p[OFF_NODE_TYPE];
+    config->provisioned = p[OFF_PROVISIONED] != 0;
+    config->provision_timestamp = get_u32(p + OFF_PROVISION_TS);
+    config->tank_height_cm = get_u16(p + OFF_TANK_HEIGHT);
+    config->tank_diameter_cm = get_u16(p + OFF_TANK_DIAMETER);
+    config->sensor_offset_cm = p[OFF_SENSOR_OFFSET];
+    config->zigbee_pan_id = get_u16(p + OFF_PAN_ID);
+    config->zigbee_channel = p[OFF_CHANNEL];
+
+    return ESP_OK;
+}
+
+/* ============================================================================
+ * HOT FIELDS
+ * ============================================================================ */
+
+typedef struct {
+    const char *key;
+    size_t offset;
+    uint8_t size;           // 1 = u8, 2 = u16
+} config_hot_field_t;
+
+static const config_hot_field_t g_hot_fields[] = {
+    { "on_pct",   offsetof(device_config_t, pump_on_threshold),    1 },
+    { "off_pct",  offsetof(device_config_t, pump_off_threshold),   1 },
+    { "pump_min", offsetof(device_config_t, pump_timeout_minutes), 2 },
+    { "rpt_sec",  offsetof(device_config_t, report_interval_sec),  2 },
+    { "adv_pol",  offsetof(device_config_t, ble_adv_policy),       1 },
+    { "ble_trg",  offsetof(device_config_t, ble_triggers),         1 },
+    { "ble_idle", offsetof(device_config_t, ble_idle_timeout_sec), 2 },
+};
+
+#define HOT_FIELD_COUNT (sizeof(g_hot_fields) / sizeof(g_hot_fields[0]))
+
+static uint16_t hot_get(const device_config_t *config, const config_hot_field_t *f)
+{
+    const uint8_t *p = (const uint8_t *)config + f->offset;
+    if (f->size == 1) return *p;
+    uint16_t v;
+    memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+static void hot_set(device_config_t *config, const config_hot_field_t *f, uint16_t v)
+{
+    uint8_t *p = (uint8_t *)config + f->offset;
+    if (f->size == 1) {
+        *p = (uint8_t)v;
+    } else {
+        memcpy(p, &v, sizeof(v));
+    }
+}
+
+/* ============================================================================
+ * NVS STORE
+ * ============================================================================ */
+
+// Last state known to be in flash, used to skip unchanged keys
+static device_config_t g_store_shadow;
+static bool g_store_shadow_valid = false;
+static bool g_store_legacy_present = false;
+static config_store_stats_t g_store_stats = {0};
+
+static void load_hot_fields(nvs_handle_t nvs, device_config_t *config)
+{
+    for (size_t i = 0; i < HOT_FIELD_COUNT; i++) {
+        const config_hot_field_t *f = &g_hot_fields[i];
+        if (f->size == 1) {
+            uint8_t v;
+            if (nvs_get_u8(nvs, f->key, &v) == ESP_OK) hot_set(config, f, v);
+        } else {
+            uint16_t v;
+            if (nvs_get_u16(nvs, f->key, &v) == ESP_OK) hot_set(config, f, v);
+        }
+    }
+}
+
+esp_err_t config_store_load(device_config_t *config)
+{
+    if (!config) return ESP_ERR_INVALID_ARG;
+
+    int64_t start_us = esp_timer_get_time();
+    nvs_handle_t nvs;
+    esp_err_t ret = nvs_open(NVS_NAMESPACE, NVS_READONLY, &nvs);
+    if (ret != ESP_OK) {
+        return ret;
+    }
+
+    uint8_t version = 0;
+    if (nvs_get_u8(nvs, KEY_VERSION, &version) == ESP_OK) {
+        uint8_t buf[CONFIG_IDENT_MAX_LEN];
+        size_t len = sizeof(buf);
+        device_config_t loaded = *config;
+
+        ret = nvs_get_blob(nvs, KEY_IDENT, buf, &len);
+        if (ret == ESP_OK) {
+            ret = config_ident_decode(buf, len, &loaded);
+        }
+        if (ret == ESP_OK) {
+            load_hot_fields(nvs, &loaded);
+        }
+        nvs_close(nvs);
+
+        if (ret != ESP_OK) {
+            ESP_LOGE(TAG, "Config record v%d unusable: %s - using defaults",
+                     version, esp_err_to_name(ret));
+            return ret;
+        }
+
+        *config = loaded;
+        g_store_shadow = loaded;
+        g_store_shadow_valid = true;
+        g_store_stats.loaded_version = version;
+        g_store_stats.load_us = (uint32_t)(esp_timer_get_time() - start_us);
+        ESP_LOGI(TAG, "Config v%d loaded in %lu us", version,
+                 (unsigned long)g_store_stats.load_us);
+        return ESP_OK;
+    }
+
+    // No versioned record: look for a legacy raw blob
+    config_image_t legacy;
+    size_t len = sizeof(legacy);
+    ret = nvs_get_blob(nvs, KEY_LEGACY, &legacy, &len);
+    nvs_close(nvs);
+    if (ret != ESP_OK) {
+        return ret;
+    }
+
+    uint8_t from_version = 0;
+    ret = config_migrate_legacy((const uint8_t *)&legacy, len, config, &from_version);
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "Legacy config of %u bytes matches no schema - using defaults",
+                 (unsigned)len);
+        return ret;
+    }
+
+    ESP_LOGW(TAG, "Migrating config schema %d -> %d", from_version, CONFIG_SCHEMA_VERSION);
+    g_store_legacy_present = true;
+    g_store_shadow_valid = false;
+    g_store_stats.loaded_version = from_version;
+
+    // Persist immediately so the migration runs once
+    if (config_store_save(config) != ESP_OK) {
+        ESP_LOGW(TAG, "Migrated config not saved, will retry on next boot");
+    }
+
+    g_store_stats.load_us = (uint32_t)(esp_timer_get_time() - start_us);
+    return ESP_OK;
+}
+
+esp_err_t config_store_save(const device_config_t *config)
+{
+    if (!config) return ESP_ERR_INVALID_ARG;
+
+    nvs_handle_t nvs;
+    esp_err_t ret = nvs_open(NVS_NAMESPACE, NVS_READWRITE, &nvs);
+    if (ret != ESP_OK) {
+        return ret;
+    }
+
+    uint8_t cur[CONFIG_IDENT_MAX_LEN];
+    size_t cur_len = config_ident_encode(config, cur);
+    bool cold_changed = true;
+    if (g_store_shadow_valid) {
+        uint8_t old[CONFIG_IDENT_MAX_LEN];
+        config_ident_encode(&g_store_shadow, old);
+        cold_changed = memcmp(cur, old, cur_len) != 0;
+    }
+
+    uint32_t cold_writes = 0;
+    uint32_t hot_writes = 0;
+
+    if (cold_changed) {
+        ret = nvs_set_blob(nvs, KEY_IDENT, cur, cur_len);
+        cold_writes++;
+    }
+
+    for (size_t i = 0; i < HOT_FIELD_COUNT && ret == ESP_OK; i++) {
+        const config_hot_field_t *f = &g_hot_fields[i];
+        uint16_t v = hot_get(config, f);
+        if (g_store_shadow_valid && hot_get(&g_store_shadow, f) == v) {
+            continue;
+        }
+        ret = (f->size == 1) ? nvs_set_u8(nvs, f->key, (uint8_t)v)
+                             : nvs_set_u16(nvs, f->key, v);
+        hot_writes++;
+    }
+
+    // Version last: a half-written record is never marked current
+    if (ret == ESP_OK && !g_store_shadow_valid) {
+        ret = nvs_set_u8(nvs, KEY_VERSION, CONFIG_SCHEMA_VERSION);
+    }
+    if (ret == ESP_OK && g_store_legacy_present) {
+        esp_err_t erase_ret = nvs_erase_key(nvs, KEY_LEGACY);
+        if (erase_ret != ESP_OK && erase_ret != ESP_ERR_NVS_NOT_FOUND) {
+            ret = erase_ret;
+        }
+    }
+    if (ret == ESP_OK && (cold_writes || hot_writes || g_store_legacy_present ||
+                          !g_store_shadow_valid)) {
+        ret = nvs_commit(nvs);
+    }
+    nvs_close(nvs);
+
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "Config save failed: %s", esp_err_to_name(ret));
+        g_store_shadow_valid = false;   // Rewrite everything next time
+        return ret;
+    }
+
+    g_store_shadow = *config;
+    g_store_shadow_valid = true;
+    g_store_legacy_present = false;
+    g_store_stats.cold_writes += cold_writes;
+    g_store_stats.hot_writes += hot_writes;
+
+    ESP_LOGI(TAG, "Config saved (%s record, %lu hot keys)",
+             cold_writes ? "new" : "unchanged", (unsigned long)hot_writes);
+    return ESP_OK;
+}
+
+esp_err_t config_store_erase(void)
+{
+    nvs_handle_t nvs;
+    esp_err_t ret = nvs_open(NVS_NAMESPACE, NVS_READWRITE, &nvs);
+    if (ret == ESP_OK) {
+        ret = nvs_erase_all(nvs);
+        if (ret == ESP_OK) {
+            ret = nvs_commit(nvs);
+        }
+        nvs_close(nvs);
+    }
+
+    g_store_shadow_valid = false;
+    g_store_legacy_present = false;
+    return ret;
+}
+
+void config_store_get_stats(config_store_stats_t *stats)
+{
+    if (stats) {
+        *stats = g_store_stats;
+    }
+}
@@ -0,0 +1,119 @@
+/*
+ * Versioned Configuration Store
+ * Schema-versioned, CRC-protected NVS layout for device_config_t
+ */
+
+#ifndef CONFIG_STORE_H
+#define CONFIG_STORE_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include "esp_err.h"
+#include "ble_provision.h"
+
+/* ============================================================================
+ * LAYOUT
+ * ============================================================================ */
+
+/*
+ * NVS namespace "provision":
+ *
+ *   "cfg_ver"  u8    Schema version (CONFIG_SCHEMA_VERSION)
+ *   "ident"    blob  Cold record: names, password, location, role, tank
+ *                    geometry, network. Header + packed payload + CRC32.
+ *                    Rewritten only when one of those fields changes.
+ *   "on_pct" .. u8/u16 Hot fields: thresholds, intervals, BLE policy. One
+ *                    small key each, so a threshold tweak rewrites 1-2 bytes
+ *                    instead of the whole config.
+ *
+ * Schema history:
+ *   1  "config" blob, raw device_config_t of firmware 1.0.x
+ *   2  "config" blob, raw device_config_t + BLE policy/trigger fields
+ *   3  split cold/hot layout above
+ *
+ * Versions 1 and 2 are recognised by blob size, migrated on first boot,
+ * saved as version 3 and the old "config" key erased.
+ *
+ * Cold payload fields are only ever appended; a record with a higher
+ * version but at least the known payload length still loads (downgrade).
+ */
+
+#define CONFIG_SCHEMA_VERSION       3
+
+#define CONFIG_IDENT_HEADER_LEN     8       // version, reserved, length, crc32
+#define CONFIG_IDENT_PAYLOAD_LEN    116     // Schema 3 cold payload
+#define CONFIG_IDENT_MAX_LEN        160     // Room for appended fields
+
+/* ============================================================================
+ * STATISTICS
+ * ============================================================================ */
+
+typedef struct {
+    uint8_t  loaded_version;    // Schema found at boot (0 = nothing stored)
+    uint32_t load_us;           // Duration of the last config_store_load()
+    uint32_t cold_writes;       // "ident" blob writes since boot
+    uint32_t hot_writes;        // Hot key writes since boot
+} config_store_stats_t;
+
+/* ============================================================================
+ * API
+ * ============================================================================ */
+
+/**
+ * Load configuration from NVS, migrating older schemas
+ * @param config In: defaults, out: stored values (hot keys that are missing
+ *               keep their default)
+ * @return ESP_OK, ESP_ERR_NVS_NOT_FOUND if nothing stored,
+ *         ESP_ERR_INVALID_CRC / ESP_ERR_INVALID_VERSION / ESP_ERR_INVALID_SIZE
+ *         if the stored record is unusable (config left unchanged)
+ */
+esp_err_t config_store_load(device_config_t *config);
+
+/**
+ * Save configuration, writing only the keys that changed since the last
+ * load or save
+ */
+esp_err_t config_store_save(const device_config_t *config);
+
+/**
+ * Erase all stored configuration (factory reset)
+ */
+esp_err_t config_store_erase(void);
+
+/**
+ * Get write/load statistics
+ */
+void config_store_get_stats(config_store_stats_t *stats);
+
+/* ============================================================================
+ * CODEC (no NVS access; exposed for host tests)
+ * ============================================================================ */
+
+/**
+ * CRC-32 (IEEE 802.3, reflected, init/xorout 0xFFFFFFFF)
+ */
+uint32_t config_crc32(const uint8_t *data, size_t len);
+
+/**
+ * Encode the cold fields of config into an "ident" record
+ * @param out Output buffer, at least CONFIG_IDENT_HEADER_LEN + CONFIG_IDENT_PAYLOAD_LEN
+ * @return Record length
+ */
+size_t config_ident_encode(const device_config_t *config, uint8_t *out);
+
+/**
+ * Decode an "ident" record into the cold fields of config
+ * (hot fields untouched)
+ */
+esp_err_t config_ident_decode(const uint8_t *data, size_t len, device_config_t *config);
+
+/**
+ * Migrate a legacy "config" blob (schema 1 or 2) to the current config
+ * @param from_version Optional, receives the detected schema version
+ * @return ESP_ERR_INVALID_SIZE if the blob matches no known schema
+ */
+esp_err_t config_migrate_legacy(const uint8_t *blob, size_t len,
+                                device_config_t *config, uint8_t *from_version);
+
+#endif // CONFIG_STORE_H
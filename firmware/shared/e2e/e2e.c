@@ -0,0 +1,236 @@
+/*
+ * End-to-End Report Latency - stamp codec and controller table
+ * Platform-independent; the host mesh drives it with simulated links.
+ */
+
+#include "e2e.h"
+
+#include <string.h>
+#include "esp_log.h"
+
+static const char *TAG = "E2E";
+
+static e2e_sensor_t s_sensors[E2E_MAX_SENSORS];
+static int s_sensor_count;
+
+// Sources whose last stamp lacked network time, when it arrived
+typedef struct {
+    uint16_t addr;
+    uint32_t rx_ms;
+} e2e_copier_t;
+
+static e2e_copier_t s_copiers[E2E_MAX_COPIERS];
+static int s_copier_count;
+
+// The report the next relay switch acts on
+static bool s_pending;
+static uint32_t s_pending_rx_ms;
+static int s_pending_slot;              // -1: not in the table
+
+/* ============================================================================
+ * REPORT STAMP
+ * ============================================================================ */
+
+void e2e_stamp_encode(const e2e_stamp_t *stamp, uint8_t out[E2E_STAMP_ATTR_SIZE])
+{
+    out[0] = E2E_STAMP_LEN;
+    out[1] = stamp->level_pct;
+    out[2] = stamp->status;
+    out[3] = (uint8_t)stamp->seq;
+    out[4] = (uint8_t)(stamp->seq >> 8);
+    for (int i = 0; i < 4; i++) {
+        out[5 + i] = (uint8_t)(stamp->sample_ms >> (8 * i));
+    }
+    out[9] = stamp->flags;
+}
+
+esp_err_t e2e_stamp_decode(const uint8_t *attr, size_t size, e2e_stamp_t *out)
+{
+    memset(out, 0, sizeof(*out));
+    if (size < E2E_STAMP_ATTR_SIZE || attr[0] < E2E_STAMP_LEN || (size_t)attr[0] + 1 > size) {
+        return ESP_ERR_INVALID_SIZE;
+    }
+    out->level_pct = attr[1];
+    out->status = attr[2];
+    out->seq = (uint16_t)(attr[3] | (attr[4] << 8));
+    for (int i = 0; i < 4; i++) {
+        out->sample_ms |= (uint32_t)attr[5 + i] << (8 * i);
+    }
+    out->flags = attr[9];
+    return ESP_OK;
+}
+
+/* ============================================================================
+ * CONTROLLER
+ * ============================================================================ */
+
+static int find_slot(uint16_t addr, bool *added)
+{
+    *added = false;
+    for (int i = 0; i < s_sensor_count; i++) {
+        if (s_sensors[i].addr == addr) {
+            return i;
+        }
+    }
+    if (s_sensor_count >= E2E_MAX_SENSORS) {
+        return -1;
+    }
+    e2e_sensor_t *s = &s_sensors[s_sensor_count];
+    memset(s, 0, sizeof(*s));
+    s->addr = addr;
+    *added = true;
+    return s_sensor_count++;
+}
+
+static int find_copier(uint16_t addr)
+{
+    for (int i = 0; i < s_copier_count; i++) {
+        if (s_copiers[i].addr == addr) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+bool e2e_sends_copy(uint16_t addr)
+{
+    return find_copier(addr) >= 0;
+}
+
+// A synced stamp ends the copies; otherwise the source joins or stays,
+// the one stamped longest ago making room
+static void track_copier(uint16_t addr, bool synced, uint32_t rx_ms)
+{
+    int i = find_copier(addr);
+    if (synced) {
+        if (i >= 0) {
+            s_copiers[i] = s_copiers[--s_copier_count];
+        }
+        return;
+    }
+    if (i < 0 && s_copier_count < E2E_MAX_COPIERS) {
+        i = s_copier_count++;
+    } else if (i < 0) {
+        i = 0;
+        for (int j = 1; j < s_copier_count; j++) {
+            if (rx_ms - s_copiers[j].rx_ms > rx_ms - s_copiers[i].rx_ms) {
+                i = j;
+            }
+        }
+    }
+    s_copiers[i].addr = addr;
+    s_copiers[i].rx_ms = rx_ms;
+}
+
+bool e2e_report_rx(uint16_t addr, const e2e_stamp_t *stamp, uint32_t rx_ms)
+{
+    track_copier(addr, stamp->flags & E2E_STAMP_SYNCED, rx_ms);
+    bool added;
+    int slot = find_slot(addr, &added);
+    e2e_sensor_t *s = slot >= 0 ? &s_sensors[slot] : NULL;
+
+    if (s != NULL && !added) {
+        uint16_t d = (uint16_t)(stamp->seq - s->last_seq);
+        if (d == 0) {
+            s->duplicates++;
+            return false;
+        }
+        if (d < 0x8000) {
+            s->seq_gaps += d - 1u;
+            metrics_add(METRIC_REPORT_SEQ_GAPS, d - 1u);
+        } else {
+            s->restarts++;
+        }
+    }
+    if (s != NULL) {
+        s->last_seq = stamp->seq;
+        s->reports++;
+    }
+
+    if (stamp->flags & E2E_STAMP_SYNCED) {
+        // Unsigned difference survives the wrap; a stamp ahead of rx records 0
+        int32_t ms = (int32_t)(rx_ms - stamp->sample_ms);
+        if (s != NULL) {
+            metrics_hist_add(&s->sample_rx, ms);
+        }
+        metrics_observe_us(METRIC_E2E_SAMPLE_RX_MS, ms);
+    }
+
+    s_pending = true;
+    s_pending_rx_ms = rx_ms;
+    s_pending_slot = slot;
+    return added || !(stamp->flags & E2E_STAMP_SYNCED);
+}
+
+void e2e_relay_switched(uint32_t now_ms)
+{
+    if (!s_pending) {
+        return;
+    }
+    s_pending = false;
+    int32_t ms = (int32_t)(now_ms - s_pending_rx_ms);
+    if (s_pending_slot >= 0) {
+        metrics_hist_add(&s_sensors[s_pending_slot].rx_relay, ms);
+    }
+    metrics_observe_us(METRIC_E2E_RX_RELAY_MS, ms);
+}
+
+int e2e_get_sensors(e2e_sensor_t *out, int max)
+{
+    int n = s_sensor_count < max ? s_sensor_count : max;
+    memcpy(out, s_sensors, (size_t)n * sizeof(*out));
+    return n;
+}
+
+size_t e2e_encode(uint8_t *out, size_t len)
+{
+    if (len < E2E_ENCODED_MAX) {
+        return 0;
+    }
+    e2e_sensor_t sensors[E2E_MAX_SENSORS];
+    int n = e2e_get_sensors(sensors, E2E_MAX_SENSORS);
+
+    out[0] = (uint8_t)n;
+    uint8_t *p = out + 1;
+    for (int i = 0; i < n; i++) {
+        const e2e_sensor_t *s = &sensors[i];
+        uint16_t gaps = s->seq_gaps > UINT16_MAX ? UINT16_MAX : (uint16_t)s->seq_gaps;
+        p[0] = (uint8_t)s->addr;
+        p[1] = (uint8_t)(s->addr >> 8);
+        for (int b = 0; b < 4; b++) {
+            p[2 + b] = (uint8_t)(s->reports >> (8 * b));
+        }
+        p[6] = (uint8_t)gaps;
+        p[7] = (uint8_t)(gaps >> 8);
+        p += 8;
+        p += metrics_encode_hist(&s->sample_rx, p);
+        p += metrics_encode_hist(&s->rx_relay, p);
+    }
+    return (size_t)(p - out);
+}
+
+void e2e_reset(void)
+{
+    memset(s_sensors, 0, sizeof(s_sensors));
+    s_sensor_count = 0;
+    s_copier_count = 0;
+    s_pending = false;
+}
+
+/* ============================================================================
+ * LOGGING
+ * ============================================================================ */
+
+void e2e_log(void)
+{
+    e2e_sensor_t sensors[E2E_MAX_SENSORS];
+    int n = e2e_get_sensors(sensors, E2E_MAX_SENSORS);
+    for (int i = 0; i < n; i++) {
+        const e2e_sensor_t *s = &sensors[i];
+        ESP_LOGI(TAG, "0x%04x: %lu reports, %lu lost, %lu dup, sample->rx n=%lu max=%lu ms, "
+                 "rx->relay n=%lu max=%lu ms", s->addr, (unsigned long)s->reports,
+                 (unsigned long)s->seq_gaps, (unsigned long)s->duplicates,
+                 (unsigned long)s->sample_rx.count, (unsigned long)s->sample_rx.max_us,
+                 (unsigned long)s->rx_relay.count, (unsigned long)s->rx_relay.max_us);
+    }
+}
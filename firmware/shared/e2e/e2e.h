@@ -0,0 +1,142 @@
+/*
+ * End-to-End Report Latency
+ * How long a water level takes from the sensor's measurement to the pump
+ * relay, per sensor, on the controller.
+ *
+ * Every report carries a stamp (e2e_stamp_t): the level, a per-sensor
+ * sequence number and the network time of the measurement (net_time.h).
+ * The controller records, per sensor and in the registry (metrics.h):
+ *
+ *   sample -> rx     measurement to report decoded on the controller, only
+ *                    for stamps taken with network time (an upper bound,
+ *                    see net_time.h)
+ *   rx -> relay      report decoded to the relay switching on it, for the
+ *                    reports that crossed a threshold
+ *   seq gaps         reports lost between two received ones; duplicates
+ *                    (a retry whose first copy arrived) are counted apart
+ *
+ * Both histograms are in milliseconds on the metrics bucket scale.
+ *
+ * Until a sensor has network time it follows each stamp with the bare
+ * percentage (ATTR_WATER_LEVEL_PCT), for controllers that predate the stamp.
+ * Those never send network time, so they keep getting it; a controller that
+ * takes stamps sends the time for every unsynced stamp, which ends the
+ * copies, and drops them meanwhile (e2e_sends_copy()). It keeps the
+ * sources whose last stamp lacked network time, dropping one when its next
+ * stamp has it; when full, the one stamped longest ago makes room. A copy is
+ * only misread if E2E_MAX_COPIERS other unsynced stamps arrive between it
+ * and its own stamp.
+ *
+ * Controller state, updated and read under the Zigbee lock: e2e_report_rx()
+ * from the report callback, e2e_relay_switched() from the control pass.
+ */
+
+#ifndef E2E_H
+#define E2E_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "esp_err.h"
+#include "metrics.h"
+
+/* ============================================================================
+ * REPORT STAMP
+ * ============================================================================ */
+
+/*
+ * Wire format, an octet string attribute (little-endian, length byte first):
+ *
+ *   len:u8 (9) | level_pct:u8 | status:u8 | seq:u16 | sample_ms:u32 | flags:u8
+ */
+#define E2E_STAMP_LEN           9
+#define E2E_STAMP_ATTR_SIZE     (1 + E2E_STAMP_LEN)
+#define E2E_STAMP_SYNCED        0x01    // sample_ms is network time
+
+typedef struct {
+    uint8_t  level_pct;
+    uint8_t  status;            // water_level_status_t
+    uint16_t seq;               // Per sensor, +1 per measurement reported
+    uint32_t sample_ms;         // net_time_now_ms() when measured
+    uint8_t  flags;
+} e2e_stamp_t;
+
+void e2e_stamp_encode(const e2e_stamp_t *stamp, uint8_t out[E2E_STAMP_ATTR_SIZE]);
+
+/**
+ * @param attr Attribute value, length byte first
+ * @return ESP_OK, ESP_ERR_INVALID_SIZE if shorter than a stamp (longer
+ *         stamps from newer firmware decode)
+ */
+esp_err_t e2e_stamp_decode(const uint8_t *attr, size_t size, e2e_stamp_t *out);
+
+/* ============================================================================
+ * CONTROLLER
+ * ============================================================================ */
+
+#define E2E_MAX_SENSORS         4       // Sensors tracked; more only reach the registry
+#define E2E_MAX_COPIERS         16      // Unsynced sources, all sending copies at once
+
+typedef struct {
+    uint16_t addr;              // Short address
+    uint16_t last_seq;
+    uint32_t reports;           // Distinct reports received
+    uint32_t seq_gaps;          // Reports missing between received ones
+    uint32_t duplicates;
+    uint32_t restarts;          // Sequence went backwards: the sensor rebooted
+    metrics_hist_t sample_rx;   // ms
+    metrics_hist_t rx_relay;    // ms
+} e2e_sensor_t;
+
+/*
+ * Per-sensor table (Zigbee diagnostics, little-endian):
+ *
+ *   count:u8 | { addr:u16 | reports:u32 | seq_gaps:u16 |
+ *                sample_rx:hist | rx_relay:hist } x count
+ *
+ * hist as in a metrics snapshot entry without id and type.
+ */
+#define E2E_SIZE_SENSOR         (8 + 2 * (METRICS_SIZE_HISTOGRAM - 2))
+#define E2E_ENCODED_MAX         (1 + E2E_SIZE_SENSOR * E2E_MAX_SENSORS)
+
+/**
+ * A stamped report arrived from a sensor
+ *
+ * @param rx_ms Controller network time at reception (net_time_now_ms(NULL))
+ * @return true for a sensor not heard from before, or one whose stamp was
+ *         taken without network time (send it the time now)
+ */
+bool e2e_report_rx(uint16_t addr, const e2e_stamp_t *stamp, uint32_t rx_ms);
+
+/**
+ * True if addr's last stamp was taken without network time, so a bare
+ * percentage from it is that stamp's copy
+ */
+bool e2e_sends_copy(uint16_t addr);
+
+/**
+ * The relay just switched on the last report received
+ */
+void e2e_relay_switched(uint32_t now_ms);
+
+/**
+ * Copy the table
+ *
+ * @return Sensors copied
+ */
+int e2e_get_sensors(e2e_sensor_t *out, int max);
+
+/**
+ * @param len At least E2E_ENCODED_MAX
+ * @return Bytes written, 0 if the buffer is too small
+ */
+size_t e2e_encode(uint8_t *out, size_t len);
+
+void e2e_reset(void);
+
+/**
+ * Log each sensor's latencies at INFO level
+ */
+void e2e_log(void);
+
+#endif // E2E_H
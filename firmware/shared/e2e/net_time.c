@@ -0,0 +1,51 @@
+/*
+ * Network Time - min-delay offset filter
+ * Platform-independent; on the host every node shares the simulator's clock.
+ */
+
+#include "net_time.h"
+
+#include <string.h>
+#include "esp_timer.h"
+
+void net_time_init(net_time_t *nt)
+{
+    memset(nt, 0, sizeof(*nt));
+}
+
+void net_time_beacon(net_time_t *nt, uint32_t source_ms)
+{
+    nt->offsets_ms[nt->next] = (int32_t)(source_ms - net_time_local_ms());
+    nt->next = (uint8_t)((nt->next + 1) % NET_TIME_WINDOW);
+    if (nt->count < NET_TIME_WINDOW) {
+        nt->count++;
+    }
+    nt->beacons++;
+
+    // Compared as differences from the newest, so a wrap in between is harmless
+    int32_t newest = nt->offsets_ms[(nt->next + NET_TIME_WINDOW - 1) % NET_TIME_WINDOW];
+    int32_t best = 0;
+    for (int i = 0; i < nt->count; i++) {
+        int32_t d = nt->offsets_ms[i] - newest;
+        if (d > best) {
+            best = d;
+        }
+    }
+    nt->offset_ms = newest + best;
+}
+
+bool net_time_synced(const net_time_t *nt)
+{
+    return nt != NULL && nt->beacons > 0;
+}
+
+uint32_t net_time_local_ms(void)
+{
+    return (uint32_t)(esp_timer_get_time() / 1000);
+}
+
+uint32_t net_time_now_ms(const net_time_t *nt)
+{
+    uint32_t local = net_time_local_ms();
+    return net_time_synced(nt) ? local + (uint32_t)nt->offset_ms : local;
+}
@@ -0,0 +1,59 @@
+/*
+ * Network Time
+ * A millisecond clock shared by the nodes, so a sensor's sample time means
+ * something on the controller.
+ *
+ * The controller (coordinator) is the source: its network time is its own
+ * uptime. Every NET_TIME_BEACON_PERIOD_MS, and when it first hears from a
+ * sensor, it sends each sensor its current time. A beacon can only arrive
+ * late, so source_ms - local_ms underestimates the true offset by the
+ * beacon's delivery time (hops, plus up to one poll period for a sleepy end
+ * device). The sensor keeps the largest of the last NET_TIME_WINDOW
+ * estimates: the least delayed beacon. Timestamps taken against it err
+ * early, which makes latencies measured from them upper bounds.
+ *
+ * State is per node (one net_time_t each), so the host mesh can run many
+ * sensors in one process. 32-bit milliseconds wrap after 49.7 days; compare
+ * them with unsigned differences.
+ */
+
+#ifndef NET_TIME_H
+#define NET_TIME_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#define NET_TIME_BEACON_PERIOD_MS   60000
+#define NET_TIME_WINDOW             8       // Beacons the offset is taken over
+
+typedef struct {
+    int32_t  offsets_ms[NET_TIME_WINDOW];   // source - local, newest at next - 1
+    uint8_t  count;
+    uint8_t  next;
+    int32_t  offset_ms;                     // Largest in the window
+    uint32_t beacons;
+} net_time_t;
+
+void net_time_init(net_time_t *nt);
+
+/**
+ * A beacon from the source arrived: its time when it was sent
+ */
+void net_time_beacon(net_time_t *nt, uint32_t source_ms);
+
+/**
+ * True once a beacon has arrived
+ */
+bool net_time_synced(const net_time_t *nt);
+
+/**
+ * This node's uptime in ms: the network time on the source
+ */
+uint32_t net_time_local_ms(void);
+
+/**
+ * Network time, or local time before the first beacon (NULL: the source)
+ */
+uint32_t net_time_now_ms(const net_time_t *nt);
+
+#endif // NET_TIME_H
@@ -0,0 +1,230 @@
+/*
+ * Energy Accounting - ledger and battery estimate
+ * Platform-independent; the host simulator drives the same instrumentation.
+ */
+
+#include "energy.h"
+
+#include <string.h>
+#include "esp_log.h"
+#include "esp_timer.h"
+
+static const char *TAG = "ENERGY";
+
+#define STATE_NAME_OF(id, name) [ENERGY_##id] = name,
+static const char *const s_state_name[ENERGY_STATE_COUNT] = { ENERGY_STATES(STATE_NAME_OF) };
+#define EV_NAME_OF(id, name) [ENERGY_EV_##id] = name,
+static const char *const s_ev_name[ENERGY_EVENT_COUNT] = { ENERGY_EVENTS(EV_NAME_OF) };
+#define CURRENT_NAME_OF(id, name, ma) [ENERGY_MA_##id] = name,
+static const char *const s_current_name[ENERGY_CURRENT_COUNT] = { ENERGY_CURRENTS(CURRENT_NAME_OF) };
+
+// Updated with __atomic builtins only: callers run in any task or timer
+static int64_t s_state_us[ENERGY_STATE_COUNT];
+static uint32_t s_events[ENERGY_EVENT_COUNT];
+static uint32_t s_poll_interval_ms;
+static uint32_t s_ble_events;
+static uint32_t s_ble_radio_ms;
+// Baselines at energy_reset(): the BLE totals run since boot
+static uint32_t s_ble_events_base;
+static uint32_t s_ble_radio_ms_base;
+static int64_t s_start_us;
+
+/* ============================================================================
+ * ACCOUNTING
+ * ============================================================================ */
+
+void energy_add_us(energy_state_t state, int64_t us)
+{
+    if (state < ENERGY_STATE_COUNT && state != ENERGY_SLEEP && us > 0) {
+        __atomic_fetch_add(&s_state_us[state], us, __ATOMIC_RELAXED);
+    }
+}
+
+void energy_count(energy_event_t event, uint32_t n)
+{
+    if (event < ENERGY_EVENT_COUNT) {
+        __atomic_fetch_add(&s_events[event], n, __ATOMIC_RELAXED);
+    }
+}
+
+void energy_zb_frame(void)
+{
+    energy_count(ENERGY_EV_ZB_FRAME, 1);
+    energy_add_us(ENERGY_RADIO_TX, ENERGY_ZB_FRAME_TX_US);
+    energy_add_us(ENERGY_RADIO_RX, ENERGY_ZB_FRAME_RX_US);
+}
+
+void energy_set_poll_interval_ms(uint32_t ms)
+{
+    __atomic_store_n(&s_poll_interval_ms, ms, __ATOMIC_RELAXED);
+}
+
+void energy_set_ble_adv(uint32_t events, uint32_t radio_on_ms)
+{
+    __atomic_store_n(&s_ble_events, events, __ATOMIC_RELAXED);
+    __atomic_store_n(&s_ble_radio_ms, radio_on_ms, __ATOMIC_RELAXED);
+}
+
+// SLEEP is what the other states leave of the elapsed time
+static void derive_sleep(energy_ledger_t *l)
+{
+    int64_t busy_us = 0;
+    for (int s = 0; s < ENERGY_STATE_COUNT; s++) {
+        if (s != ENERGY_SLEEP) {
+            busy_us += l->state_us[s];
+        }
+    }
+    l->state_us[ENERGY_SLEEP] = l->elapsed_us > busy_us ? l->elapsed_us - busy_us : 0;
+}
+
+void energy_get(energy_ledger_t *out)
+{
+    memset(out, 0, sizeof(*out));
+    out->elapsed_us = esp_timer_get_time() - s_start_us;
+    for (int s = 0; s < ENERGY_STATE_COUNT; s++) {
+        out->state_us[s] = __atomic_load_n(&s_state_us[s], __ATOMIC_RELAXED);
+    }
+    for (int e = 0; e < ENERGY_EVENT_COUNT; e++) {
+        out->events[e] = __atomic_load_n(&s_events[e], __ATOMIC_RELAXED);
+    }
+
+    out->state_us[ENERGY_CPU_ACTIVE] += (int64_t)out->events[ENERGY_EV_WAKEUP] * ENERGY_WAKE_CPU_US;
+
+    uint32_t poll_ms = __atomic_load_n(&s_poll_interval_ms, __ATOMIC_RELAXED);
+    if (poll_ms > 0) {
+        uint32_t polls = (uint32_t)(out->elapsed_us / ((int64_t)poll_ms * 1000));
+        out->events[ENERGY_EV_ZB_POLL] += polls;
+        out->state_us[ENERGY_RADIO_TX] += (int64_t)polls * ENERGY_ZB_POLL_TX_US;
+        out->state_us[ENERGY_RADIO_RX] += (int64_t)polls * ENERGY_ZB_POLL_RX_US;
+    }
+
+    // Advertising airtime is mostly TX (three channels), the rest listening
+    out->events[ENERGY_EV_BLE_ADV] += __atomic_load_n(&s_ble_events, __ATOMIC_RELAXED) -
+                                      s_ble_events_base;
+    out->state_us[ENERGY_RADIO_TX] +=
+        (int64_t)(__atomic_load_n(&s_ble_radio_ms, __ATOMIC_RELAXED) - s_ble_radio_ms_base) * 1000;
+
+    derive_sleep(out);
+}
+
+void energy_reset(void)
+{
+    for (int s = 0; s < ENERGY_STATE_COUNT; s++) {
+        __atomic_store_n(&s_state_us[s], 0, __ATOMIC_RELAXED);
+    }
+    for (int e = 0; e < ENERGY_EVENT_COUNT; e++) {
+        __atomic_store_n(&s_events[e], 0, __ATOMIC_RELAXED);
+    }
+    s_ble_events_base = __atomic_load_n(&s_ble_events, __ATOMIC_RELAXED);
+    s_ble_radio_ms_base = __atomic_load_n(&s_ble_radio_ms, __ATOMIC_RELAXED);
+    s_start_us = esp_timer_get_time();
+}
+
+/* ============================================================================
+ * ESTIMATION
+ * ============================================================================ */
+
+void energy_from_config(const energy_config_t *cfg, energy_ledger_t *out)
+{
+    memset(out, 0, sizeof(*out));
+    out->elapsed_us = ENERGY_DAY_US;
+
+    uint32_t interval_s = cfg->report_interval_s > 0 ? cfg->report_interval_s : 1;
+    uint32_t cycles = 86400 / interval_s;
+    uint32_t ping_us = cfg->ping_us > 0 ? cfg->ping_us : ENERGY_PING_US_DEFAULT;
+    out->events[ENERGY_EV_WAKEUP] = cycles;
+    out->events[ENERGY_EV_PING] = cycles * cfg->samples;
+    out->events[ENERGY_EV_ZB_FRAME] = cycles;
+    out->state_us[ENERGY_ULTRASONIC] = (int64_t)out->events[ENERGY_EV_PING] * ping_us;
+    out->state_us[ENERGY_CPU_ACTIVE] = (int64_t)cycles * ENERGY_WAKE_CPU_US;
+    out->state_us[ENERGY_RADIO_TX] = (int64_t)cycles * ENERGY_ZB_FRAME_TX_US;
+    out->state_us[ENERGY_RADIO_RX] = (int64_t)cycles * ENERGY_ZB_FRAME_RX_US;
+
+    if (cfg->keep_alive_ms > 0) {
+        uint32_t polls = (uint32_t)(ENERGY_DAY_US / ((int64_t)cfg->keep_alive_ms * 1000));
+        out->events[ENERGY_EV_ZB_POLL] = polls;
+        out->state_us[ENERGY_RADIO_TX] += (int64_t)polls * ENERGY_ZB_POLL_TX_US;
+        out->state_us[ENERGY_RADIO_RX] += (int64_t)polls * ENERGY_ZB_POLL_RX_US;
+    }
+    if (cfg->ble_adv_interval_ms > 0) {
+        uint32_t adv = (uint32_t)(ENERGY_DAY_US / ((int64_t)cfg->ble_adv_interval_ms * 1000));
+        out->events[ENERGY_EV_BLE_ADV] = adv;
+        out->state_us[ENERGY_RADIO_TX] += (int64_t)adv * ENERGY_BLE_ADV_EVENT_US;
+    }
+
+    derive_sleep(out);
+}
+
+esp_err_t energy_estimate(const energy_ledger_t *ledger, const energy_model_t *model,
+                          energy_estimate_t *out)
+{
+    memset(out, 0, sizeof(*out));
+    if (ledger->elapsed_us <= 0) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    // The ultrasonic state is the module firing with the CPU busy-waiting
+    float state_ma[ENERGY_STATE_COUNT] = {
+        [ENERGY_CPU_ACTIVE] = model->ma[ENERGY_MA_CPU_ACTIVE],
+        [ENERGY_RADIO_TX] = model->ma[ENERGY_MA_RADIO_TX],
+        [ENERGY_RADIO_RX] = model->ma[ENERGY_MA_RADIO_RX],
+        [ENERGY_ULTRASONIC] = model->ma[ENERGY_MA_ULTRASONIC] + model->ma[ENERGY_MA_CPU_ACTIVE],
+        [ENERGY_SLEEP] = model->ma[ENERGY_MA_SLEEP],
+    };
+
+    // mA x us -> mAh, scaled from the ledger's span to a day
+    const float per_day = (float)ENERGY_DAY_US / (float)ledger->elapsed_us / 3.6e9f;
+    for (int s = 0; s < ENERGY_STATE_COUNT; s++) {
+        out->mah_state[s] = state_ma[s] * (float)ledger->state_us[s] * per_day;
+        out->mah_per_day += out->mah_state[s];
+    }
+    out->mah_standby = model->ma[ENERGY_MA_US_STANDBY] * (float)ENERGY_DAY_US / 3.6e9f;
+    out->mah_per_day += out->mah_standby;
+    out->avg_ma = out->mah_per_day / 24.0f;
+    if (out->mah_per_day > 0) {
+        out->battery_days = model->battery_mah * model->battery_usable / out->mah_per_day;
+    }
+    return ESP_OK;
+}
+
+esp_err_t energy_model_set(energy_model_t *model, const char *name, float ma)
+{
+    for (int i = 0; i < ENERGY_CURRENT_COUNT; i++) {
+        if (strcmp(name, s_current_name[i]) == 0) {
+            model->ma[i] = ma;
+            return ESP_OK;
+        }
+    }
+    return ESP_ERR_NOT_FOUND;
+}
+
+const char *energy_state_name(energy_state_t state)
+{
+    return state < ENERGY_STATE_COUNT ? s_state_name[state] : "?";
+}
+
+const char *energy_event_name(energy_event_t event)
+{
+    return event < ENERGY_EVENT_COUNT ? s_ev_name[event] : "?";
+}
+
+void energy_log(const energy_model_t *model)
+{
+    energy_ledger_t l;
+    energy_estimate_t est;
+    energy_get(&l);
+    if (energy_estimate(&l, model, &est) != ESP_OK) {
+        return;
+    }
+    ESP_LOGI(TAG, "%lld s: %lu wakeups, %lu pings, %lu frames, %lu polls, %lu adv events",
+             (long long)(l.elapsed_us / 1000000), (unsigned long)l.events[ENERGY_EV_WAKEUP],
+             (unsigned long)l.events[ENERGY_EV_PING], (unsigned long)l.events[ENERGY_EV_ZB_FRAME],
+             (unsigned long)l.events[ENERGY_EV_ZB_POLL], (unsigned long)l.events[ENERGY_EV_BLE_ADV]);
+    for (int s = 0; s < ENERGY_STATE_COUNT; s++) {
+        ESP_LOGI(TAG, "  %-10s %9lld ms %8.2f mAh/day", s_state_name[s],
+                 (long long)(l.state_us[s] / 1000), est.mah_state[s]);
+    }
+    ESP_LOGI(TAG, "  %-10s %12s %8.2f mAh/day", "us_standby", "", est.mah_standby);
+    ESP_LOGI(TAG, "  %.2f mAh/day (%.3f mA avg): %.0f days on %.0f mAh",
+             est.mah_per_day, est.avg_ma, est.battery_days, model->battery_mah);
+}
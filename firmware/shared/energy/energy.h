@@ -0,0 +1,198 @@
+/*
+ * Energy Accounting
+ * Where a sensor node's charge goes, and what a configuration would cost on
+ * a battery.
+ *
+ * Instrumentation adds time per power state and counts the events behind
+ * it, from any task or timer:
+ *
+ *   ULTRASONIC  pings, measured around water_level_ping_cm() (the CPU
+ *               busy-waits on the echo with the module active)
+ *   RADIO_TX/RX Zigbee frames (energy_zb_frame() per report sent, retries
+ *               included), the end device's keep-alive polls and BLE
+ *               advertising, all as airtime estimates: the stacks do not
+ *               report radio-on time
+ *   CPU_ACTIVE  ENERGY_WAKE_CPU_US per measurement cycle, plus whatever a
+ *               caller adds with energy_add_us()
+ *   SLEEP       the rest of the elapsed time
+ *
+ * The states are treated as exclusive; where they overlap (the CPU runs
+ * while the radio is on) the charge is counted twice, so estimates err high.
+ *
+ * Estimation: a ledger measured over a run (energy_get()) or a day derived
+ * from a configuration that is not running (energy_from_config()) goes
+ * through a current table (energy_model_t) to mAh per day and battery life.
+ */
+
+#ifndef ENERGY_H
+#define ENERGY_H
+
+#include <stdint.h>
+#include "esp_err.h"
+
+// X(id, name): power states
+#define ENERGY_STATES(X)                        \
+    X(CPU_ACTIVE,       "cpu_active")           \
+    X(RADIO_TX,         "radio_tx")             \
+    X(RADIO_RX,         "radio_rx")             \
+    X(ULTRASONIC,       "ultrasonic")           \
+    X(SLEEP,            "sleep")
+
+// X(id, name): events behind the state times
+#define ENERGY_EVENTS(X)                        \
+    X(WAKEUP,           "wakeups")              \
+    X(PING,             "pings")                \
+    X(ZB_FRAME,         "zb_frames")            \
+    X(ZB_POLL,          "zb_polls")             \
+    X(BLE_ADV,          "ble_adv_events")
+
+/*
+ * X(id, name, default mA): the current table. ESP32-H2 datasheet typicals
+ * at 3.3 V and an HC-SR04 class module; replace with bench measurements of
+ * the actual board. SLEEP is automatic light sleep (CONFIG_PM_ENABLE); with
+ * power management off the idle CPU draws several mA instead.
+ */
+#define ENERGY_CURRENTS(X)                      \
+    X(CPU_ACTIVE,       "cpu",          15.0f)  \
+    X(RADIO_TX,         "tx",           20.0f)  \
+    X(RADIO_RX,         "rx",           13.0f)  \
+    X(ULTRASONIC,       "ultrasonic",   15.0f)  \
+    X(SLEEP,            "sleep",        0.09f)  \
+    X(US_STANDBY,       "us_standby",   2.0f)
+
+typedef enum {
+#define ENERGY_STATE_ENUM(id, name) ENERGY_##id,
+    ENERGY_STATES(ENERGY_STATE_ENUM)
+#undef ENERGY_STATE_ENUM
+    ENERGY_STATE_COUNT
+} energy_state_t;
+
+typedef enum {
+#define ENERGY_EVENT_ENUM(id, name) ENERGY_EV_##id,
+    ENERGY_EVENTS(ENERGY_EVENT_ENUM)
+#undef ENERGY_EVENT_ENUM
+    ENERGY_EVENT_COUNT
+} energy_event_t;
+
+typedef enum {
+#define ENERGY_CURRENT_ENUM(id, name, ma) ENERGY_MA_##id,
+    ENERGY_CURRENTS(ENERGY_CURRENT_ENUM)
+#undef ENERGY_CURRENT_ENUM
+    ENERGY_CURRENT_COUNT
+} energy_current_t;
+
+// Airtime per event (250 kb/s 802.15.4)
+#define ENERGY_ZB_FRAME_TX_US       2000    // CSMA backoff + ~50 byte report
+#define ENERGY_ZB_FRAME_RX_US       1000    // Turnaround + MAC ACK
+#define ENERGY_ZB_POLL_TX_US        800     // Data request
+#define ENERGY_ZB_POLL_RX_US        4000    // Waiting for the parent's ACK / data
+#define ENERGY_BLE_ADV_EVENT_US     1500    // BLE_ADV_EVENT_AIRTIME_US
+#ifndef ENERGY_WAKE_CPU_US
+#define ENERGY_WAKE_CPU_US          5000    // Per measurement cycle: math, attributes, stack
+#endif
+#define ENERGY_PING_US_DEFAULT      12000   // Trigger + echo of a 2 m tank
+
+#define ENERGY_DAY_US               (86400LL * 1000000)
+
+typedef struct {
+    float ma[ENERGY_CURRENT_COUNT];
+    float battery_mah;          // Rated capacity
+    float battery_usable;       // Fraction usable before brown-out (0..1)
+} energy_model_t;
+
+#define ENERGY_CURRENT_DEFAULT(id, name, ma) [ENERGY_MA_##id] = ma,
+#define ENERGY_MODEL_DEFAULT() {                        \
+    .ma = { ENERGY_CURRENTS(ENERGY_CURRENT_DEFAULT) },   \
+    .battery_mah = 2600.0f,                             \
+    .battery_usable = 0.8f,                             \
+}
+
+typedef struct {
+    int64_t  elapsed_us;
+    int64_t  state_us[ENERGY_STATE_COUNT];
+    uint32_t events[ENERGY_EVENT_COUNT];
+} energy_ledger_t;
+
+// A configuration to project, see energy_from_config()
+typedef struct {
+    uint32_t report_interval_s;     // device_config_t report_interval_sec
+    uint8_t  samples;               // Pings per measurement (WATER_LEVEL_NUM_SAMPLES)
+    uint32_t ping_us;               // Mean ping time, ENERGY_PING_US_DEFAULT if 0
+    uint32_t keep_alive_ms;         // End device keep-alive poll period, 0: none
+    uint32_t ble_adv_interval_ms;   // Mean advertising interval, 0: not advertising
+} energy_config_t;
+
+typedef struct {
+    float mah_state[ENERGY_STATE_COUNT];    // Per day
+    float mah_standby;                      // Per day, ultrasonic module idle
+    float mah_per_day;
+    float avg_ma;
+    float battery_days;
+} energy_estimate_t;
+
+/* ============================================================================
+ * ACCOUNTING
+ * ============================================================================ */
+
+void energy_add_us(energy_state_t state, int64_t us);
+void energy_count(energy_event_t event, uint32_t n);
+
+/**
+ * One Zigbee frame sent and acknowledged (or retried)
+ */
+void energy_zb_frame(void);
+
+/**
+ * Keep-alive polls happen inside the stack: they are accounted from the
+ * configured period, over the elapsed time (0: none)
+ */
+void energy_set_poll_interval_ms(uint32_t ms);
+
+/**
+ * Advertising totals since boot, from ble_adv_get_stats()
+ */
+void energy_set_ble_adv(uint32_t events, uint32_t radio_on_ms);
+
+/**
+ * Everything accounted since the last energy_reset(), SLEEP derived
+ */
+void energy_get(energy_ledger_t *out);
+
+/**
+ * Start a new accounting period now
+ */
+void energy_reset(void);
+
+/* ============================================================================
+ * ESTIMATION
+ * ============================================================================ */
+
+/**
+ * The ledger of one day at a configuration: one frame per report, as
+ * against a controller that takes stamps (a pre-stamp controller doubles
+ * the report frames, e2e.h)
+ */
+void energy_from_config(const energy_config_t *cfg, energy_ledger_t *out);
+
+/**
+ * Charge per day and battery life of a ledger, at its rate
+ * @return ESP_OK, ESP_ERR_INVALID_ARG if the ledger covers no time
+ */
+esp_err_t energy_estimate(const energy_ledger_t *ledger, const energy_model_t *model,
+                          energy_estimate_t *out);
+
+/**
+ * Set a current of the table by name (ENERGY_CURRENTS)
+ * @return ESP_OK, ESP_ERR_NOT_FOUND for an unknown name
+ */
+esp_err_t energy_model_set(energy_model_t *model, const char *name, float ma);
+
+const char *energy_state_name(energy_state_t state);
+const char *energy_event_name(energy_event_t event);
+
+/**
+ * Log the ledger so far and its estimate under the model, at INFO level
+ */
+void energy_log(const energy_model_t *model);
+
+#endif // ENERGY_H
@@ -0,0 +1,206 @@
+/*
+ * Link Quality - per-peer EWMA table
+ * Platform-independent; the host mesh feeds it from simulated links.
+ */
+
+#include "link_quality.h"
+
+#include <string.h>
+#include "esp_log.h"
+#include "esp_timer.h"
+
+static const char *TAG = "LINK";
+
+// Sequence count, odd while the (single) writer is updating the table
+static uint32_t s_seq;
+static int s_peer_count;
+static link_peer_t s_peers[LINK_MAX_PEERS];
+
+/* ============================================================================
+ * UPDATES
+ * ============================================================================ */
+
+static uint32_t now_ms(void)
+{
+    return (uint32_t)(esp_timer_get_time() / 1000);
+}
+
+static int32_t unscale(int32_t avg)
+{
+    int32_t half = (1 << LINK_EWMA_SHIFT) / 2;
+    return (avg + (avg < 0 ? -half : half)) / (1 << LINK_EWMA_SHIFT);
+}
+
+// avg holds the mean << LINK_EWMA_SHIFT; returns the mean. Rounding in the
+// update too lets a steady input settle on exactly its value.
+static int32_t ewma(int32_t *avg, int32_t sample, bool first)
+{
+    if (first) {
+        *avg = sample * (1 << LINK_EWMA_SHIFT);
+    } else {
+        *avg += sample - unscale(*avg);
+    }
+    return unscale(*avg);
+}
+
+static link_peer_t *find_or_add(uint16_t addr)
+{
+    for (int i = 0; i < s_peer_count; i++) {
+        if (s_peers[i].addr == addr) {
+            return &s_peers[i];
+        }
+    }
+    link_peer_t *p;
+    if (s_peer_count < LINK_MAX_PEERS) {
+        p = &s_peers[s_peer_count++];
+    } else {
+        // Full: the peer heard from least recently goes
+        uint32_t now = now_ms();
+        p = &s_peers[0];
+        for (int i = 1; i < LINK_MAX_PEERS; i++) {
+            if (now - s_peers[i].last_ms > now - p->last_ms) {
+                p = &s_peers[i];
+            }
+        }
+    }
+    memset(p, 0, sizeof(*p));
+    p->addr = addr;
+    p->rssi_dbm = LINK_RSSI_NONE;
+    return p;
+}
+
+static void sample_lqi(link_peer_t *p, uint8_t lqi)
+{
+    bool first = p->frames == 0 && p->scans == 0;
+    p->lqi = (uint8_t)ewma(&p->lqi_avg, lqi, first);
+    p->last_ms = now_ms();
+}
+
+void link_quality_frame(uint16_t src, uint8_t lqi)
+{
+    __atomic_add_fetch(&s_seq, 1, __ATOMIC_ACQ_REL);
+    link_peer_t *p = find_or_add(src);
+    sample_lqi(p, lqi);
+    p->frames++;
+    __atomic_add_fetch(&s_seq, 1, __ATOMIC_RELEASE);
+}
+
+void link_quality_scan(const link_sample_t *neighbors, int count)
+{
+    __atomic_add_fetch(&s_seq, 1, __ATOMIC_ACQ_REL);
+    for (int i = 0; i < s_peer_count; i++) {
+        s_peers[i].flags &= (uint8_t)~LINK_PEER_NEIGHBOR;
+    }
+    for (int i = 0; i < count; i++) {
+        link_peer_t *p = find_or_add(neighbors[i].addr);
+        sample_lqi(p, neighbors[i].lqi);
+        p->rssi_dbm = (int8_t)ewma(&p->rssi_avg, neighbors[i].rssi_dbm,
+                                   p->rssi_dbm == LINK_RSSI_NONE);
+        p->scans++;
+        p->flags |= LINK_PEER_NEIGHBOR;
+    }
+    __atomic_add_fetch(&s_seq, 1, __ATOMIC_RELEASE);
+}
+
+void link_quality_reset(void)
+{
+    __atomic_add_fetch(&s_seq, 1, __ATOMIC_ACQ_REL);
+    memset(s_peers, 0, sizeof(s_peers));
+    s_peer_count = 0;
+    __atomic_add_fetch(&s_seq, 1, __ATOMIC_RELEASE);
+}
+
+/* ============================================================================
+ * READING
+ * ============================================================================ */
+
+int link_quality_get_peers(link_peer_t *out, int max)
+{
+    int n;
+    uint32_t seq;
+    do {
+        seq = __atomic_load_n(&s_seq, __ATOMIC_ACQUIRE);
+        n = s_peer_count < max ? s_peer_count : max;
+        for (int i = 0; i < n; i++) {
+            out[i] = s_peers[i];
+        }
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+    } while ((seq & 1) || seq != __atomic_load_n(&s_seq, __ATOMIC_RELAXED));
+    return n;
+}
+
+esp_err_t link_quality_get(uint16_t addr, link_peer_t *out)
+{
+    link_peer_t peers[LINK_MAX_PEERS];
+    int n = link_quality_get_peers(peers, LINK_MAX_PEERS);
+    for (int i = 0; i < n; i++) {
+        if (peers[i].addr == addr) {
+            *out = peers[i];
+            return ESP_OK;
+        }
+    }
+    return ESP_ERR_NOT_FOUND;
+}
+
+esp_err_t link_quality_best(link_peer_t *out)
+{
+    link_peer_t peers[LINK_MAX_PEERS];
+    int n = link_quality_get_peers(peers, LINK_MAX_PEERS);
+    const link_peer_t *best = NULL;
+    for (int i = 0; i < n; i++) {
+        if ((peers[i].flags & LINK_PEER_NEIGHBOR) && (best == NULL || peers[i].lqi > best->lqi)) {
+            best = &peers[i];
+        }
+    }
+    if (best == NULL) {
+        return ESP_ERR_NOT_FOUND;
+    }
+    *out = *best;
+    return ESP_OK;
+}
+
+size_t link_quality_encode(uint8_t *out, size_t len)
+{
+    if (len < LINK_ENCODED_MAX) {
+        return 0;
+    }
+    link_peer_t peers[LINK_MAX_PEERS];
+    int n = link_quality_get_peers(peers, LINK_MAX_PEERS);
+    uint32_t now = now_ms();
+
+    out[0] = (uint8_t)n;
+    uint8_t *p = out + 1;
+    for (int i = 0; i < n; i++) {
+        const link_peer_t *peer = &peers[i];
+        uint32_t age_s = (now - peer->last_ms) / 1000;
+        uint16_t age = age_s > UINT16_MAX ? UINT16_MAX : (uint16_t)age_s;
+        p[0] = (uint8_t)peer->addr;
+        p[1] = (uint8_t)(peer->addr >> 8);
+        p[2] = peer->flags;
+        p[3] = peer->lqi;
+        p[4] = (uint8_t)peer->rssi_dbm;
+        for (int b = 0; b < 4; b++) {
+            p[5 + b] = (uint8_t)(peer->frames >> (8 * b));
+        }
+        p[9] = (uint8_t)age;
+        p[10] = (uint8_t)(age >> 8);
+        p += LINK_SIZE_PEER;
+    }
+    return (size_t)(p - out);
+}
+
+/* ============================================================================
+ * LOGGING
+ * ============================================================================ */
+
+void link_quality_log(void)
+{
+    link_peer_t peers[LINK_MAX_PEERS];
+    int n = link_quality_get_peers(peers, LINK_MAX_PEERS);
+    for (int i = 0; i < n; i++) {
+        const link_peer_t *p = &peers[i];
+        ESP_LOGI(TAG, "0x%04x: lqi %u, rssi %d dBm, %lu frames, %lu scans%s", p->addr,
+                 p->lqi, p->rssi_dbm, (unsigned long)p->frames, (unsigned long)p->scans,
+                 (p->flags & LINK_PEER_NEIGHBOR) ? ", neighbour" : "");
+    }
+}
@@ -0,0 +1,111 @@
+/*
+ * Link Quality
+ * Smoothed LQI and RSSI per radio peer, so an installer can see which links
+ * are weak and place routers where they cut retransmissions.
+ *
+ * Two sources feed the table, both from the Zigbee task:
+ *
+ *   frames      link_quality_frame() for every APS frame received, with the
+ *               frame's LQI. It is the last hop's link into this node, so
+ *               for a source beyond one hop it describes the router that
+ *               relayed it rather than the source itself.
+ *   neighbours  link_quality_scan() with the whole neighbour table: LQI and
+ *               RSSI of every node in direct range. Peers missing from it
+ *               lose LINK_PEER_NEIGHBOR.
+ *
+ * Each sample moves the peer's average 1 / 2^LINK_EWMA_SHIFT of the way
+ * towards it; the first sample seeds it. When the table is full, the peer
+ * heard from least recently makes room.
+ *
+ * One writer (the caller holds the Zigbee lock on ESP), readers from any
+ * task: a sequence count guards the table, as for the metrics task table.
+ */
+
+#ifndef LINK_QUALITY_H
+#define LINK_QUALITY_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "esp_err.h"
+
+#define LINK_MAX_PEERS          16      // Sensors and direct neighbours of a small mesh
+#define LINK_EWMA_SHIFT         3       // alpha = 1/8: ~8 samples to settle
+#define LINK_RSSI_NONE          INT8_MIN
+
+#define LINK_PEER_NEIGHBOR      0x01    // In the neighbour table at the last scan
+
+typedef struct {
+    uint16_t addr;              // Short address
+    uint8_t  flags;             // LINK_PEER_*
+    uint8_t  lqi;               // Smoothed, 0-255
+    int8_t   rssi_dbm;          // Smoothed, LINK_RSSI_NONE until a neighbour scan has it
+    uint32_t frames;            // APS frames received
+    uint32_t scans;             // Neighbour table samples
+    uint32_t last_ms;           // Uptime of the last sample
+    int32_t  lqi_avg;           // Fixed point, << LINK_EWMA_SHIFT
+    int32_t  rssi_avg;
+} link_peer_t;
+
+typedef struct {
+    uint16_t addr;
+    uint8_t  lqi;
+    int8_t   rssi_dbm;
+} link_sample_t;
+
+/**
+ * An APS frame from src arrived with the given LQI
+ */
+void link_quality_frame(uint16_t src, uint8_t lqi);
+
+/**
+ * The current neighbour table
+ */
+void link_quality_scan(const link_sample_t *neighbors, int count);
+
+/**
+ * Copy one peer
+ *
+ * @return ESP_ERR_NOT_FOUND if addr is not in the table
+ */
+esp_err_t link_quality_get(uint16_t addr, link_peer_t *out);
+
+/**
+ * The current neighbour with the best smoothed LQI (usually the parent)
+ *
+ * @return ESP_ERR_NOT_FOUND if no peer was in the last scan
+ */
+esp_err_t link_quality_best(link_peer_t *out);
+
+/**
+ * Copy the table
+ *
+ * @return Peers copied
+ */
+int link_quality_get_peers(link_peer_t *out, int max);
+
+/*
+ * Encoded table (BLE characteristic 0xFF05, little-endian):
+ *
+ *   count:u8 | { addr:u16 | flags:u8 | lqi:u8 | rssi_dbm:i8 |
+ *                frames:u32 | age_s:u16 } x count
+ *
+ * age_s: seconds since the last sample, saturating.
+ */
+#define LINK_SIZE_PEER          11
+#define LINK_ENCODED_MAX        (1 + LINK_SIZE_PEER * LINK_MAX_PEERS)
+
+/**
+ * @param len At least LINK_ENCODED_MAX
+ * @return Bytes written, 0 if the buffer is too small
+ */
+size_t link_quality_encode(uint8_t *out, size_t len);
+
+void link_quality_reset(void);
+
+/**
+ * Log each peer at INFO level
+ */
+void link_quality_log(void);
+
+#endif // LINK_QUALITY_H
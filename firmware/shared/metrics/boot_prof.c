@@ -0,0 +1,115 @@
+/*
+ * Boot Profiler - stage marks and the boot table
+ * Platform-independent; the host runner marks the same stages on the
+ * simulator.
+ */
+
+#include "boot_prof.h"
+
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "metrics.h"
+
+static const char *TAG = "BOOT";
+
+#define LABEL_OF(id, label) [BOOT_STAGE_##id] = label,
+static const char *const s_label[BOOT_STAGE_COUNT] = { BOOT_STAGES(LABEL_OF) };
+
+typedef enum {
+    MARK_NONE = 0,
+    MARK_WRITING,       // Claimed, time not published yet
+    MARK_SET,
+} mark_state_t;
+
+static uint8_t s_state[BOOT_STAGE_COUNT];
+static int64_t s_at_us[BOOT_STAGE_COUNT];
+
+/* ============================================================================
+ * MARKS
+ * ============================================================================ */
+
+static void publish(boot_stage_t stage, int64_t at_us)
+{
+    int32_t ms = (int32_t)(at_us / 1000);
+    switch (stage) {
+    case BOOT_STAGE_READY:
+        metrics_set(METRIC_BOOT_READY_MS, ms);
+        break;
+    case BOOT_STAGE_NETWORK_JOINED:
+        metrics_set(METRIC_BOOT_JOINED_MS, ms);
+        break;
+    case BOOT_STAGE_FIRST_REPORT:
+        metrics_set(METRIC_BOOT_FIRST_REPORT_MS, ms);
+        break;
+    default:
+        break;
+    }
+}
+
+bool boot_prof_mark(boot_stage_t stage)
+{
+    if (stage >= BOOT_STAGE_COUNT) {
+        return false;
+    }
+    // Cheap check first: milestones are marked on every report
+    if (__atomic_load_n(&s_state[stage], __ATOMIC_RELAXED) != MARK_NONE) {
+        return false;
+    }
+    uint8_t expected = MARK_NONE;
+    if (!__atomic_compare_exchange_n(&s_state[stage], &expected, MARK_WRITING, false,
+                                     __ATOMIC_ACQUIRE, __ATOMIC_RELAXED)) {
+        return false;
+    }
+    int64_t now_us = esp_timer_get_time();
+    s_at_us[stage] = now_us;
+    __atomic_store_n(&s_state[stage], MARK_SET, __ATOMIC_RELEASE);
+    publish(stage, now_us);
+    if (stage >= BOOT_STAGE_FIRST_MILESTONE) {
+        ESP_LOGI(TAG, "%s at %lld ms", s_label[stage], (long long)(now_us / 1000));
+    }
+    return true;
+}
+
+int64_t boot_prof_get(boot_stage_t stage)
+{
+    if (stage >= BOOT_STAGE_COUNT ||
+        __atomic_load_n(&s_state[stage], __ATOMIC_ACQUIRE) != MARK_SET) {
+        return -1;
+    }
+    return s_at_us[stage];
+}
+
+const char *boot_prof_label(boot_stage_t stage)
+{
+    return stage < BOOT_STAGE_COUNT ? s_label[stage] : "?";
+}
+
+void boot_prof_reset(void)
+{
+    for (int i = 0; i < BOOT_STAGE_COUNT; i++) {
+        __atomic_store_n(&s_state[i], MARK_NONE, __ATOMIC_RELAXED);
+        s_at_us[i] = 0;
+    }
+}
+
+/* ============================================================================
+ * TABLE
+ * ============================================================================ */
+
+void boot_prof_log(void)
+{
+    ESP_LOGI(TAG, "Boot profile:         at ms   took ms");
+    int64_t prev_us = 0;
+    for (int i = 0; i < BOOT_STAGE_COUNT; i++) {
+        int64_t at_us = boot_prof_get((boot_stage_t)i);
+        if (at_us < 0) {
+            ESP_LOGI(TAG, "  %-16s        -", s_label[i]);
+        } else if (i < BOOT_STAGE_FIRST_MILESTONE) {
+            ESP_LOGI(TAG, "  %-16s %8lld  %8lld", s_label[i], (long long)(at_us / 1000),
+                     (long long)((at_us - prev_us) / 1000));
+            prev_us = at_us;
+        } else {
+            ESP_LOGI(TAG, "  %-16s %8lld", s_label[i], (long long)(at_us / 1000));
+        }
+    }
+}
@@ -0,0 +1,74 @@
+/*
+ * Boot Profiler
+ * Timestamps the stages of app_main and the first network milestones with
+ * esp_timer_get_time() (us since the esp_timer started, i.e. after the ROM
+ * and second-stage bootloader), prints them as a table and publishes the
+ * milestones as metrics gauges:
+ *
+ *   BOOT_READY_MS        app_main done (tasks started)
+ *   BOOT_JOINED_MS       network joined (or formed, on the coordinator)
+ *   BOOT_FIRST_REPORT_MS first level report sent (sensor) / received
+ *                        (controller)
+ *
+ * Each stage is marked once, when it ends; later marks are ignored, so
+ * milestones can be marked from every report. Marks are lock-free and safe
+ * from any task.
+ */
+
+#ifndef BOOT_PROF_H
+#define BOOT_PROF_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// X(id, label); table order is boot order, milestones last
+#define BOOT_STAGES(X)                          \
+    X(APP_MAIN,         "startup")              \
+    X(BANNER,           "banner")               \
+    X(NVS,              "nvs_init")             \
+    X(WATCHDOG,         "watchdog_init")        \
+    X(GPIO,             "led_button_init")      \
+    X(LED_BLINK,        "startup_blink")        \
+    X(BLE_INIT,         "ble_init")             \
+    X(BUTTON_CHECK,     "button_check")         \
+    X(ROLE_START,       "role_start")           \
+    X(BLE_STATUS,       "ble_status")           \
+    X(READY,            "ready")                \
+    X(NETWORK_JOINED,   "network_joined")       \
+    X(FIRST_REPORT,     "first_report")
+
+typedef enum {
+#define BOOT_STAGE_ENUM(id, label) BOOT_STAGE_##id,
+    BOOT_STAGES(BOOT_STAGE_ENUM)
+#undef BOOT_STAGE_ENUM
+    BOOT_STAGE_COUNT
+} boot_stage_t;
+
+// Stages from here on happen asynchronously to app_main
+#define BOOT_STAGE_FIRST_MILESTONE  BOOT_STAGE_NETWORK_JOINED
+
+/**
+ * Mark the end of a stage now
+ * @return true on the first mark of the stage
+ */
+bool boot_prof_mark(boot_stage_t stage);
+
+/**
+ * @return Time the stage ended in us, -1 if not marked yet
+ */
+int64_t boot_prof_get(boot_stage_t stage);
+
+const char *boot_prof_label(boot_stage_t stage);
+
+/**
+ * Log the table at INFO level: each app_main stage with its end time and
+ * duration (since the previous marked stage), milestones with their time
+ */
+void boot_prof_log(void);
+
+/**
+ * Forget every mark (tests, host runs)
+ */
+void boot_prof_reset(void);
+
+#endif // BOOT_PROF_H
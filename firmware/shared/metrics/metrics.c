@@ -0,0 +1,384 @@
+/*
+ * Runtime Metrics - registry and snapshot codec
+ * Platform-independent: the host build and the native tests use it as is.
+ */
+
+#include "metrics.h"
+
+#include <stdbool.h>
+#include <string.h>
+#include "esp_log.h"
+#include "esp_timer.h"
+
+static const char *TAG = "METRICS";
+
+/* ============================================================================
+ * STORAGE
+ * ============================================================================ */
+
+// Histogram storage only for histograms: slot per histogram metric
+#define HIST_SLOT_COUNTER(id)
+#define HIST_SLOT_GAUGE(id)
+#define HIST_SLOT_HISTOGRAM(id) HIST_SLOT_##id,
+#define HIST_SLOT(id, type, name) HIST_SLOT_##type(id)
+enum {
+    METRICS_LIST(HIST_SLOT)
+    HIST_SLOT_COUNT
+};
+
+#define SLOT_OF_COUNTER(id)     -1
+#define SLOT_OF_GAUGE(id)       -1
+#define SLOT_OF_HISTOGRAM(id)   HIST_SLOT_##id
+#define SLOT_OF(id, type, name) [METRIC_##id] = SLOT_OF_##type(id),
+static const int8_t s_hist_slot[METRIC_COUNT] = { METRICS_LIST(SLOT_OF) };
+
+#define TYPE_OF(id, type, name) [METRIC_##id] = METRIC_TYPE_##type,
+static const uint8_t s_type[METRIC_COUNT] = { METRICS_LIST(TYPE_OF) };
+
+#define NAME_OF(id, type, name) [METRIC_##id] = name,
+static const char *const s_name[METRIC_COUNT] = { METRICS_LIST(NAME_OF) };
+
+// Updated with __atomic builtins only: callers run in any task or timer
+static uint32_t s_value[METRIC_COUNT];
+static metrics_hist_t s_hist[HIST_SLOT_COUNT];
+
+// Task table: too big for atomics, guarded by a sequence count that is odd
+// while the (single) writer is copying
+static uint32_t s_task_seq;
+static int s_task_count;
+static metrics_task_t s_tasks[METRICS_MAX_TASKS];
+
+static bool valid(metric_id_t id, metric_type_t type)
+{
+    return (unsigned)id < METRIC_COUNT && s_type[id] == type;
+}
+
+/* ============================================================================
+ * UPDATES
+ * ============================================================================ */
+
+void metrics_add(metric_id_t id, uint32_t n)
+{
+    if (valid(id, METRIC_TYPE_COUNTER)) {
+        __atomic_fetch_add(&s_value[id], n, __ATOMIC_RELAXED);
+    }
+}
+
+void metrics_inc(metric_id_t id)
+{
+    metrics_add(id, 1);
+}
+
+void metrics_set(metric_id_t id, int32_t value)
+{
+    if (valid(id, METRIC_TYPE_GAUGE)) {
+        __atomic_store_n(&s_value[id], (uint32_t)value, __ATOMIC_RELAXED);
+    }
+}
+
+void metrics_hist_add(metrics_hist_t *h, int64_t value)
+{
+    uint32_t v = value < 0 ? 0 : value > UINT32_MAX ? UINT32_MAX : (uint32_t)value;
+
+    int bucket = 0;
+    while (bucket < METRICS_HIST_BUCKETS - 1 && v >= metrics_bucket_limit_us(bucket)) {
+        bucket++;
+    }
+    __atomic_fetch_add(&h->buckets[bucket], 1, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&h->count, 1, __ATOMIC_RELAXED);
+
+    uint32_t max = __atomic_load_n(&h->max_us, __ATOMIC_RELAXED);
+    while (v > max && !__atomic_compare_exchange_n(&h->max_us, &max, v, true,
+                                                   __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+    }
+}
+
+void metrics_observe_us(metric_id_t id, int64_t us)
+{
+    if (valid(id, METRIC_TYPE_HISTOGRAM)) {
+        metrics_hist_add(&s_hist[s_hist_slot[id]], us);
+    }
+}
+
+void metrics_set_tasks(const metrics_task_t *tasks, int count)
+{
+    if (count > METRICS_MAX_TASKS) {
+        count = METRICS_MAX_TASKS;
+    }
+    __atomic_add_fetch(&s_task_seq, 1, __ATOMIC_ACQ_REL);
+    for (int i = 0; i < count; i++) {
+        s_tasks[i] = tasks[i];
+    }
+    s_task_count = count;
+    __atomic_add_fetch(&s_task_seq, 1, __ATOMIC_RELEASE);
+}
+
+/* ============================================================================
+ * READING
+ * ============================================================================ */
+
+int metrics_get_tasks(metrics_task_t *out, int max)
+{
+    int n;
+    uint32_t seq;
+    do {
+        seq = __atomic_load_n(&s_task_seq, __ATOMIC_ACQUIRE);
+        n = s_task_count < max ? s_task_count : max;
+        for (int i = 0; i < n; i++) {
+            out[i] = s_tasks[i];
+        }
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+    } while ((seq & 1) || seq != __atomic_load_n(&s_task_seq, __ATOMIC_RELAXED));
+    return n;
+}
+
+int32_t metrics_get(metric_id_t id)
+{
+    if ((unsigned)id >= METRIC_COUNT || s_type[id] == METRIC_TYPE_HISTOGRAM) {
+        return 0;
+    }
+    return (int32_t)__atomic_load_n(&s_value[id], __ATOMIC_RELAXED);
+}
+
+void metrics_get_hist(metric_id_t id, metrics_hist_t *out)
+{
+    memset(out, 0, sizeof(*out));
+    if (!valid(id, METRIC_TYPE_HISTOGRAM)) {
+        return;
+    }
+    const metrics_hist_t *h = &s_hist[s_hist_slot[id]];
+    out->count = __atomic_load_n(&h->count, __ATOMIC_RELAXED);
+    out->max_us = __atomic_load_n(&h->max_us, __ATOMIC_RELAXED);
+    for (int i = 0; i < METRICS_HIST_BUCKETS; i++) {
+        out->buckets[i] = __atomic_load_n(&h->buckets[i], __ATOMIC_RELAXED);
+    }
+}
+
+const char *metrics_name(metric_id_t id)
+{
+    return (unsigned)id < METRIC_COUNT ? s_name[id] : "?";
+}
+
+metric_type_t metrics_type(metric_id_t id)
+{
+    return (unsigned)id < METRIC_COUNT ? (metric_type_t)s_type[id] : 0;
+}
+
+int64_t metrics_bucket_limit_us(int bucket)
+{
+    if (bucket >= METRICS_HIST_BUCKETS - 1) {
+        return INT64_MAX;
+    }
+    return (int64_t)METRICS_HIST_MIN_US << (2 * bucket);
+}
+
+void metrics_reset(void)
+{
+    for (int i = 0; i < METRIC_COUNT; i++) {
+        __atomic_store_n(&s_value[i], 0, __ATOMIC_RELAXED);
+    }
+    for (int i = 0; i < HIST_SLOT_COUNT; i++) {
+        metrics_hist_t *h = &s_hist[i];
+        __atomic_store_n(&h->count, 0, __ATOMIC_RELAXED);
+        __atomic_store_n(&h->max_us, 0, __ATOMIC_RELAXED);
+        for (int b = 0; b < METRICS_HIST_BUCKETS; b++) {
+            __atomic_store_n(&h->buckets[b], 0, __ATOMIC_RELAXED);
+        }
+    }
+    metrics_set_tasks(NULL, 0);
+}
+
+/* ============================================================================
+ * SNAPSHOT CODEC
+ * ============================================================================ */
+
+static void put_le16(uint8_t *p, uint16_t v)
+{
+    p[0] = (uint8_t)v;
+    p[1] = (uint8_t)(v >> 8);
+}
+
+static void put_le32(uint8_t *p, uint32_t v)
+{
+    put_le16(p, (uint16_t)v);
+    put_le16(p + 2, (uint16_t)(v >> 16));
+}
+
+static uint16_t get_le16(const uint8_t *p)
+{
+    return (uint16_t)(p[0] | (p[1] << 8));
+}
+
+static uint32_t get_le32(const uint8_t *p)
+{
+    return get_le16(p) | ((uint32_t)get_le16(p + 2) << 16);
+}
+
+static size_t entry_size(uint8_t type)
+{
+    switch (type) {
+        case METRIC_TYPE_COUNTER:   return METRICS_SIZE_COUNTER;
+        case METRIC_TYPE_GAUGE:     return METRICS_SIZE_GAUGE;
+        case METRIC_TYPE_HISTOGRAM: return METRICS_SIZE_HISTOGRAM;
+        default:                    return 0;
+    }
+}
+
+size_t metrics_encode_hist(const metrics_hist_t *h, uint8_t *out)
+{
+    put_le32(out, h->count);
+    put_le32(out + 4, h->max_us);
+    for (int b = 0; b < METRICS_HIST_BUCKETS; b++) {
+        put_le16(out + 8 + 2 * b, h->buckets[b] > UINT16_MAX ? UINT16_MAX : (uint16_t)h->buckets[b]);
+    }
+    return METRICS_SIZE_HISTOGRAM - 2;
+}
+
+size_t metrics_encode_range(uint8_t *out, size_t len, metric_id_t first, metric_id_t end)
+{
+    if (first > end || end > METRIC_COUNT) {
+        return 0;
+    }
+    size_t need = METRICS_HEADER_SIZE;
+    for (int id = first; id < (int)end; id++) {
+        need += entry_size(s_type[id]);
+    }
+    if (len < need) {
+        return 0;
+    }
+    out[0] = METRICS_FORMAT_VERSION;
+    out[1] = (uint8_t)(end - first);
+    put_le32(out + 2, (uint32_t)(esp_timer_get_time() / 1000000));
+    size_t pos = METRICS_HEADER_SIZE;
+
+    for (int id = first; id < (int)end; id++) {
+        uint8_t *p = out + pos;
+        p[0] = (uint8_t)id;
+        p[1] = s_type[id];
+        if (s_type[id] == METRIC_TYPE_HISTOGRAM) {
+            metrics_hist_t h;
+            metrics_get_hist((metric_id_t)id, &h);
+            metrics_encode_hist(&h, p + 2);
+        } else {
+            put_le32(p + 2, (uint32_t)metrics_get((metric_id_t)id));
+        }
+        pos += entry_size(s_type[id]);
+    }
+    return pos;
+}
+
+size_t metrics_encode(uint8_t *out, size_t len)
+{
+    if (len < METRICS_ENCODED_MAX) {
+        return 0;
+    }
+    return metrics_encode_range(out, len, 0, METRIC_COUNT);
+}
+
+size_t metrics_encode_tasks(uint8_t *out, size_t len)
+{
+    if (len < METRICS_TASKS_ENCODED_MAX) {
+        return 0;
+    }
+    metrics_task_t tasks[METRICS_MAX_TASKS];
+    int n = metrics_get_tasks(tasks, METRICS_MAX_TASKS);
+
+    out[0] = (uint8_t)n;
+    uint8_t *p = out + 1;
+    for (int i = 0; i < n; i++, p += METRICS_SIZE_TASK) {
+        memset(p, 0, METRICS_TASK_NAME_LEN);
+        memcpy(p, tasks[i].name, strnlen(tasks[i].name, METRICS_TASK_NAME_LEN));
+        p[METRICS_TASK_NAME_LEN] = tasks[i].priority;
+        put_le16(p + METRICS_TASK_NAME_LEN + 1, tasks[i].cpu_permille);
+        put_le16(p + METRICS_TASK_NAME_LEN + 3, tasks[i].stack_free);
+    }
+    return (size_t)(p - out);
+}
+
+static esp_err_t decode_tasks(const uint8_t *data, size_t len, metrics_snapshot_t *out)
+{
+    int n = data[0];
+    if (n > METRICS_MAX_TASKS) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (len - 1 < (size_t)n * METRICS_SIZE_TASK) {
+        return ESP_ERR_INVALID_SIZE;
+    }
+    const uint8_t *p = data + 1;
+    for (int i = 0; i < n; i++, p += METRICS_SIZE_TASK) {
+        metrics_task_t *t = &out->tasks[i];
+        memcpy(t->name, p, METRICS_TASK_NAME_LEN);
+        t->name[METRICS_TASK_NAME_LEN] = '\0';
+        t->priority = p[METRICS_TASK_NAME_LEN];
+        t->cpu_permille = get_le16(p + METRICS_TASK_NAME_LEN + 1);
+        t->stack_free = get_le16(p + METRICS_TASK_NAME_LEN + 3);
+    }
+    out->task_count = n;
+    return ESP_OK;
+}
+
+esp_err_t metrics_decode(const uint8_t *data, size_t len, metrics_snapshot_t *out)
+{
+    memset(out, 0, sizeof(*out));
+    if (len < METRICS_HEADER_SIZE) {
+        return ESP_ERR_INVALID_SIZE;
+    }
+    if (data[0] != METRICS_FORMAT_VERSION) {
+        return ESP_ERR_INVALID_VERSION;
+    }
+    out->uptime_s = get_le32(data + 2);
+
+    size_t pos = METRICS_HEADER_SIZE;
+    for (int i = 0; i < data[1]; i++) {
+        if (len - pos < 2) {
+            return ESP_ERR_INVALID_SIZE;
+        }
+        const uint8_t *p = data + pos;
+        size_t size = entry_size(p[1]);
+        if (size == 0) {
+            return ESP_ERR_INVALID_ARG;     // Unknown type: cannot skip it
+        }
+        if (len - pos < size) {
+            return ESP_ERR_INVALID_SIZE;
+        }
+        pos += size;
+
+        uint8_t id = p[0];
+        if (id >= METRIC_COUNT || s_type[id] != p[1]) {
+            continue;                       // Newer metric
+        }
+        if (p[1] == METRIC_TYPE_HISTOGRAM) {
+            metrics_hist_t *h = &out->hist[id];
+            h->count = get_le32(p + 2);
+            h->max_us = get_le32(p + 6);
+            for (int b = 0; b < METRICS_HIST_BUCKETS; b++) {
+                h->buckets[b] = get_le16(p + 10 + 2 * b);
+            }
+        } else {
+            out->value[id] = (int32_t)get_le32(p + 2);
+        }
+    }
+    return pos < len ? decode_tasks(data + pos, len - pos, out) : ESP_OK;
+}
+
+/* ============================================================================
+ * LOGGING
+ * ============================================================================ */
+
+void metrics_log(void)
+{
+    for (int id = 0; id < METRIC_COUNT; id++) {
+        if (s_type[id] == METRIC_TYPE_HISTOGRAM) {
+            metrics_hist_t h;
+            metrics_get_hist((metric_id_t)id, &h);
+            ESP_LOGI(TAG, "%-20s n=%lu max=%lu [%lu %lu %lu %lu %lu %lu %lu %lu]",
+                     s_name[id], (unsigned long)h.count, (unsigned long)h.max_us,
+                     (unsigned long)h.buckets[0], (unsigned long)h.buckets[1],
+                     (unsigned long)h.buckets[2], (unsigned long)h.buckets[3],
+                     (unsigned long)h.buckets[4], (unsigned long)h.buckets[5],
+                     (unsigned long)h.buckets[6], (unsigned long)h.buckets[7]);
+        } else {
+            ESP_LOGI(TAG, "%-20s %ld", s_name[id], (long)metrics_get((metric_id_t)id));
+        }
+    }
+}
@@ -0,0 +1,236 @@
+/*
+ * Runtime Metrics
+ * Fixed-size registry of counters, gauges and latency histograms, readable
+ * in one shot over BLE (metrics characteristic) and Zigbee (diagnostics
+ * cluster, in two attributes: see metrics_encode_range()).
+ *
+ * Every metric is declared once in METRICS_LIST; storage is static, updates
+ * are lock-free and safe from any task or timer callback. Histograms bucket
+ * microsecond durations by powers of 4:
+ *
+ *   bucket   0     1     2      3       4       5        6        7
+ *   < us     16    64    256    1024    4096    16384    65536    (rest)
+ *
+ * Histograms named *_ms hold milliseconds on the same buckets (< 16 ms ...
+ * < 65.5 s); max_us is then in ms too.
+ *
+ * Snapshot format (little-endian, version 1):
+ *
+ *   header     version:u8 | count:u8 | uptime_s:u32
+ *   counter    id:u8 | type:u8 | value:u32
+ *   gauge      id:u8 | type:u8 | value:i32
+ *   histogram  id:u8 | type:u8 | count:u32 | max_us:u32 | bucket:u16 x 8
+ *
+ * Bucket counts saturate at 65535 on the wire. Readers skip ids they do not
+ * know by type, so metrics can be appended without a version bump.
+ *
+ * The BLE characteristic appends the per-task table from the resource
+ * sampler (sysmon.h) after the entries; readers that stop after `count`
+ * entries never see it:
+ *
+ *   tasks      count:u8 | { name:char[8] | prio:u8 | cpu_permille:u16 |
+ *                           stack_free:u16 } x count
+ */
+
+#ifndef METRICS_H
+#define METRICS_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include "esp_err.h"
+
+/* ============================================================================
+ * REGISTRY
+ * ============================================================================ */
+
+// X(id, type, name); ids are wire ids, append only
+#define METRICS_LIST(X)                                                 \
+    X(REPORTS_SENT,         COUNTER,    "reports_sent")                 \
+    X(REPORTS_FAILED,       COUNTER,    "reports_failed")               \
+    X(REPORTS_RECEIVED,     COUNTER,    "reports_received")             \
+    X(JOIN_ATTEMPTS,        COUNTER,    "join_attempts")                \
+    X(JOIN_FAILURES,        COUNTER,    "join_failures")                \
+    X(SENSOR_TIMEOUTS,      COUNTER,    "sensor_timeouts")              \
+    X(PUMP_TRANSITIONS,     COUNTER,    "pump_transitions")             \
+    X(MANUAL_COMMANDS,      COUNTER,    "manual_commands")              \
+    X(LINK_RSSI,            GAUGE,      "link_rssi_dbm")                \
+    X(LINK_LQI,             GAUGE,      "link_lqi")                     \
+    X(NEIGHBORS,            GAUGE,      "neighbors")                    \
+    X(ZB_LOCK_WAIT_US,      HISTOGRAM,  "zb_lock_wait_us")              \
+    X(ZB_CALLBACK_US,       HISTOGRAM,  "zb_callback_us")               \
+    X(CONFIG_LOCK_WAIT_US,  HISTOGRAM,  "config_lock_wait_us")          \
+    X(HEAP_FREE,            GAUGE,      "heap_free")                    \
+    X(HEAP_MIN_FREE,        GAUGE,      "heap_min_free")                \
+    X(HEAP_LARGEST_BLOCK,   GAUGE,      "heap_largest_block")           \
+    X(STACK_MIN_FREE,       GAUGE,      "stack_min_free")               \
+    X(CPU_LOAD,             GAUGE,      "cpu_load_permille")            \
+    X(BOOT_READY_MS,        GAUGE,      "boot_ready_ms")                \
+    X(BOOT_JOINED_MS,       GAUGE,      "boot_joined_ms")               \
+    X(BOOT_FIRST_REPORT_MS, GAUGE,      "boot_first_report_ms")         \
+    X(ZB_LOCK_HOLD_US,      HISTOGRAM,  "zb_lock_hold_us")              \
+    X(ZB_CALLBACK_OVERRUNS, COUNTER,    "zb_callback_overruns")         \
+    X(E2E_SAMPLE_RX_MS,     HISTOGRAM,  "e2e_sample_rx_ms")             \
+    X(E2E_RX_RELAY_MS,      HISTOGRAM,  "e2e_rx_relay_ms")              \
+    X(REPORT_SEQ_GAPS,      COUNTER,    "report_seq_gaps")              \
+    X(ZB_LOCK_OVERRUNS,     COUNTER,    "zb_lock_overruns")
+
+typedef enum {
+    METRIC_TYPE_COUNTER = 1,
+    METRIC_TYPE_GAUGE,
+    METRIC_TYPE_HISTOGRAM,
+} metric_type_t;
+
+typedef enum {
+#define METRIC_ENUM(id, type, name) METRIC_##id,
+    METRICS_LIST(METRIC_ENUM)
+#undef METRIC_ENUM
+    METRIC_COUNT
+} metric_id_t;
+
+#define METRICS_HIST_BUCKETS    8
+#define METRICS_HIST_MIN_US     16      // Upper bound of bucket 0, x4 per bucket
+
+/* ============================================================================
+ * WIRE FORMAT
+ * ============================================================================ */
+
+#define METRICS_FORMAT_VERSION  1
+#define METRICS_HEADER_SIZE     6
+#define METRICS_SIZE_COUNTER    6
+#define METRICS_SIZE_GAUGE      6
+#define METRICS_SIZE_HISTOGRAM  (10 + 2 * METRICS_HIST_BUCKETS)
+
+#define METRIC_ENCODED_SIZE(id, type, name) METRICS_SIZE_##type +
+#define METRICS_ENCODED_MAX     (METRICS_HEADER_SIZE + METRICS_LIST(METRIC_ENCODED_SIZE) 0)
+
+#define METRICS_MAX_TASKS       16
+#define METRICS_TASK_NAME_LEN   8       // Truncated, not terminated on the wire
+#define METRICS_SIZE_TASK       (METRICS_TASK_NAME_LEN + 5)
+#define METRICS_TASKS_ENCODED_MAX (1 + METRICS_SIZE_TASK * METRICS_MAX_TASKS)
+
+typedef struct {
+    uint32_t count;
+    uint32_t max_us;
+    uint32_t buckets[METRICS_HIST_BUCKETS];
+} metrics_hist_t;
+
+/**
+ * One task as last sampled
+ */
+typedef struct {
+    char     name[METRICS_TASK_NAME_LEN + 1];
+    uint8_t  priority;
+    uint16_t cpu_permille;                  // Share of the last sample period
+    uint16_t stack_free;                    // High-water mark headroom, bytes
+} metrics_task_t;
+
+/**
+ * Decoded snapshot; metrics absent from the input read as 0
+ */
+typedef struct {
+    uint32_t uptime_s;
+    int32_t  value[METRIC_COUNT];           // Counters and gauges
+    metrics_hist_t hist[METRIC_COUNT];      // Histograms
+    int      task_count;                    // 0 without a task table
+    metrics_task_t tasks[METRICS_MAX_TASKS];
+} metrics_snapshot_t;
+
+/* ============================================================================
+ * UPDATES (any context)
+ * ============================================================================ */
+
+void metrics_inc(metric_id_t id);
+void metrics_add(metric_id_t id, uint32_t n);
+
+/**
+ * Gauges: replace the value
+ */
+void metrics_set(metric_id_t id, int32_t value);
+
+/**
+ * Histograms: record one duration
+ */
+void metrics_observe_us(metric_id_t id, int64_t us);
+
+/**
+ * Record one value into a histogram that is not in the registry (e2e.h
+ * keeps one per sensor). Safe against concurrent metrics_hist_add() calls.
+ */
+void metrics_hist_add(metrics_hist_t *h, int64_t value);
+
+/**
+ * Replace the task table (the resource sampler, one writer at a time)
+ *
+ * Entries beyond METRICS_MAX_TASKS are dropped.
+ */
+void metrics_set_tasks(const metrics_task_t *tasks, int count);
+
+/* ============================================================================
+ * READING
+ * ============================================================================ */
+
+int32_t metrics_get(metric_id_t id);
+
+/**
+ * Copy the task table
+ *
+ * @return Entries copied
+ */
+int metrics_get_tasks(metrics_task_t *out, int max);
+void metrics_get_hist(metric_id_t id, metrics_hist_t *out);
+const char *metrics_name(metric_id_t id);
+metric_type_t metrics_type(metric_id_t id);
+
+/**
+ * Upper bound of a histogram bucket in us (INT64_MAX for the last)
+ */
+int64_t metrics_bucket_limit_us(int bucket);
+
+/**
+ * Zero every metric and clear the task table
+ */
+void metrics_reset(void);
+
+/**
+ * Encode all metrics into one snapshot
+ *
+ * @param len At least METRICS_ENCODED_MAX
+ * @return Bytes written, 0 if the buffer is too small
+ */
+size_t metrics_encode(uint8_t *out, size_t len);
+
+/**
+ * Encode metrics [first, end) only, as a snapshot of their own: for
+ * transports that cannot carry METRICS_ENCODED_MAX in one piece
+ *
+ * @return Bytes written, 0 if the range does not fit in len
+ */
+size_t metrics_encode_range(uint8_t *out, size_t len, metric_id_t first, metric_id_t end);
+
+/**
+ * Encode one histogram's count | max | buckets (METRICS_SIZE_HISTOGRAM - 2
+ * bytes), as inside a snapshot entry
+ */
+size_t metrics_encode_hist(const metrics_hist_t *h, uint8_t *out);
+
+/**
+ * Encode the task table, to append after metrics_encode()
+ *
+ * @param len At least METRICS_TASKS_ENCODED_MAX
+ * @return Bytes written, 0 if the buffer is too small
+ */
+size_t metrics_encode_tasks(uint8_t *out, size_t len);
+
+/**
+ * Decode a snapshot from metrics_encode(), possibly from newer firmware,
+ * and a task table if one follows the entries
+ */
+esp_err_t metrics_decode(const uint8_t *data, size_t len, metrics_snapshot_t *out);
+
+/**
+ * Log every metric at INFO level (one line each; the task table is
+ * sysmon_log())
+ */
+void metrics_log(void);
+
+#endif // METRICS_H
@@ -0,0 +1,214 @@
+/*
+ * Resource Sampler - FreeRTOS task walk and heap figures into metrics
+ * The host build runs it on the simulator (firmware/host/freertos_sim.c).
+ */
+
+#include "sysmon.h"
+
+#include <stdbool.h>
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_heap_caps.h"
+#include "esp_log.h"
+#include "esp_system.h"
+#include "esp_timer.h"
+#include "metrics.h"
+
+static const char *TAG = "SYSMON";
+
+#define IDLE_TASK_PREFIX    "IDLE"      // IDLE, IDLE0, IDLE1: not load
+
+static esp_timer_handle_t g_timer = NULL;
+
+/* ============================================================================
+ * TASK WALK
+ * ============================================================================ */
+
+#if configUSE_TRACE_FACILITY
+
+// Static: the esp_timer task stack is small
+static TaskStatus_t g_status[SYSMON_MAX_SAMPLED_TASKS];
+
+#if configGENERATE_RUN_TIME_STATS
+// Run-time counters at the previous sample, by task number
+static struct {
+    UBaseType_t number;
+    uint32_t runtime;
+} g_prev[SYSMON_MAX_SAMPLED_TASKS];
+static int g_prev_count = 0;
+static uint32_t g_prev_total = 0;
+
+static uint32_t prev_runtime(UBaseType_t number)
+{
+    for (int i = 0; i < g_prev_count; i++) {
+        if (g_prev[i].number == number) {
+            return g_prev[i].runtime;
+        }
+    }
+    return 0;                           // New task: everything since it started
+}
+#endif
+
+static esp_err_t sample_tasks(void)
+{
+    uint32_t total = 0;
+    UBaseType_t n = uxTaskGetSystemState(g_status, SYSMON_MAX_SAMPLED_TASKS, &total);
+    if (n == 0) {
+        return ESP_ERR_INVALID_SIZE;
+    }
+
+    metrics_task_t tasks[METRICS_MAX_TASKS];
+    int count = 0;
+    uint32_t min_free = UINT32_MAX;
+    uint32_t load = 0;
+
+#if configGENERATE_RUN_TIME_STATS
+    uint32_t period = total - g_prev_total;     // Counters wrap: unsigned deltas
+#endif
+
+    for (UBaseType_t i = 0; i < n; i++) {
+        const TaskStatus_t *s = &g_status[i];
+        metrics_task_t t = {
+            .priority = (uint8_t)s->uxCurrentPriority,
+            .stack_free = s->usStackHighWaterMark > UINT16_MAX ?
+                          UINT16_MAX : (uint16_t)s->usStackHighWaterMark,
+        };
+        strncpy(t.name, s->pcTaskName, METRICS_TASK_NAME_LEN);
+        t.name[METRICS_TASK_NAME_LEN] = '\0';
+
+#if configGENERATE_RUN_TIME_STATS
+        if (period > 0) {
+            uint64_t ran = s->ulRunTimeCounter - prev_runtime(s->xTaskNumber);
+            uint32_t permille = (uint32_t)(ran * 1000 / period);
+            t.cpu_permille = permille > 1000 ? 1000 : (uint16_t)permille;
+        }
+#endif
+        if (strncmp(s->pcTaskName, IDLE_TASK_PREFIX, strlen(IDLE_TASK_PREFIX)) != 0) {
+            load += t.cpu_permille;
+        }
+        if (s->usStackHighWaterMark < min_free) {
+            min_free = s->usStackHighWaterMark;
+        }
+
+        // Keep the tightest stacks when there are more tasks than slots
+        int pos = count < METRICS_MAX_TASKS ? count++ : METRICS_MAX_TASKS;
+        while (pos > 0 && tasks[pos - 1].stack_free > t.stack_free) {
+            if (pos < METRICS_MAX_TASKS) {
+                tasks[pos] = tasks[pos - 1];
+            }
+            pos--;
+        }
+        if (pos < METRICS_MAX_TASKS) {
+            tasks[pos] = t;
+        }
+    }
+
+#if configGENERATE_RUN_TIME_STATS
+    for (UBaseType_t i = 0; i < n; i++) {
+        g_prev[i].number = g_status[i].xTaskNumber;
+        g_prev[i].runtime = g_status[i].ulRunTimeCounter;
+    }
+    g_prev_count = (int)n;
+    g_prev_total = total;
+#endif
+
+    metrics_set_tasks(tasks, count);
+    metrics_set(METRIC_STACK_MIN_FREE, (int32_t)min_free);
+    metrics_set(METRIC_CPU_LOAD, (int32_t)(load > 1000 ? 1000 : load));
+    return ESP_OK;
+}
+
+#else
+
+static esp_err_t sample_tasks(void)
+{
+    return ESP_OK;
+}
+
+#endif // configUSE_TRACE_FACILITY
+
+/* ============================================================================
+ * PUBLIC API
+ * ============================================================================ */
+
+esp_err_t sysmon_sample(void)
+{
+    metrics_set(METRIC_HEAP_FREE, (int32_t)esp_get_free_heap_size());
+    metrics_set(METRIC_HEAP_MIN_FREE, (int32_t)esp_get_minimum_free_heap_size());
+    metrics_set(METRIC_HEAP_LARGEST_BLOCK,
+                (int32_t)heap_caps_get_largest_free_block(MALLOC_CAP_DEFAULT));
+
+    esp_err_t ret = sample_tasks();
+    if (ret == ESP_ERR_INVALID_SIZE) {
+        ESP_LOGW(TAG, "More than %d tasks, task table not updated", SYSMON_MAX_SAMPLED_TASKS);
+    }
+    return ret;
+}
+
+static void sample_timer_cb(void *arg)
+{
+    (void)arg;
+    sysmon_sample();
+}
+
+esp_err_t sysmon_start(uint32_t period_ms)
+{
+    if (g_timer != NULL) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    if (period_ms == 0) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    const esp_timer_create_args_t args = {
+        .callback = sample_timer_cb,
+        .name = "sysmon",
+    };
+    esp_err_t ret = esp_timer_create(&args, &g_timer);
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to create sample timer: %s", esp_err_to_name(ret));
+        g_timer = NULL;
+        return ret;
+    }
+
+    sysmon_sample();
+    ret = esp_timer_start_periodic(g_timer, (uint64_t)period_ms * 1000);
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to start sample timer: %s", esp_err_to_name(ret));
+        esp_timer_delete(g_timer);
+        g_timer = NULL;
+        return ret;
+    }
+
+    ESP_LOGI(TAG, "Sampling tasks and heap every %lu ms", (unsigned long)period_ms);
+    return ESP_OK;
+}
+
+void sysmon_stop(void)
+{
+    if (g_timer == NULL) {
+        return;
+    }
+    esp_timer_stop(g_timer);
+    esp_timer_delete(g_timer);
+    g_timer = NULL;
+}
+
+void sysmon_log(void)
+{
+    ESP_LOGI(TAG, "Heap: free=%ld min=%ld largest=%ld, stack min free=%ld, CPU %ld.%ld%%",
+             (long)metrics_get(METRIC_HEAP_FREE), (long)metrics_get(METRIC_HEAP_MIN_FREE),
+             (long)metrics_get(METRIC_HEAP_LARGEST_BLOCK),
+             (long)metrics_get(METRIC_STACK_MIN_FREE),
+             (long)metrics_get(METRIC_CPU_LOAD) / 10, (long)metrics_get(METRIC_CPU_LOAD) % 10);
+
+    metrics_task_t tasks[METRICS_MAX_TASKS];
+    int n = metrics_get_tasks(tasks, METRICS_MAX_TASKS);
+    for (int i = 0; i < n; i++) {
+        ESP_LOGI(TAG, "  %-8s prio=%2u cpu=%3u.%u%% stack_free=%u",
+                 tasks[i].name, tasks[i].priority,
+                 tasks[i].cpu_permille / 10, tasks[i].cpu_permille % 10,
+                 tasks[i].stack_free);
+    }
+}
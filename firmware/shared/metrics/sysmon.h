@@ -0,0 +1,49 @@
+/*
+ * Resource Sampler
+ * Periodically publishes per-task CPU share and stack headroom, and heap
+ * free / minimum free / largest block, into the metrics registry.
+ *
+ * Needs CONFIG_FREERTOS_USE_TRACE_FACILITY for the task walk and
+ * CONFIG_FREERTOS_GENERATE_RUN_TIME_STATS for CPU shares; without them the
+ * corresponding figures stay 0 and only the heap is sampled.
+ */
+
+#ifndef SYSMON_H
+#define SYSMON_H
+
+#include <stdint.h>
+#include "esp_err.h"
+
+#define SYSMON_DEFAULT_PERIOD_MS    10000
+#define SYSMON_MAX_SAMPLED_TASKS    32      // Tasks walked per sample
+
+/**
+ * Sample now, then every period_ms from the esp_timer task
+ * @param period_ms Sample period; CPU shares are averaged over it
+ * @return ESP_OK on success, ESP_ERR_INVALID_STATE if already running
+ */
+esp_err_t sysmon_start(uint32_t period_ms);
+
+/**
+ * Stop periodic sampling; the last sample stays in the registry
+ */
+void sysmon_stop(void);
+
+/**
+ * Take one sample (not reentrant: the timer or a caller, not both)
+ *
+ * Task table: up to METRICS_MAX_TASKS tasks, least stack headroom first.
+ * CPU shares cover the time since the previous sample (since boot on the
+ * first one).
+ *
+ * @return ESP_OK, or ESP_ERR_INVALID_SIZE if more than
+ *         SYSMON_MAX_SAMPLED_TASKS tasks exist (heap still sampled)
+ */
+esp_err_t sysmon_sample(void);
+
+/**
+ * Log the last sample at INFO level
+ */
+void sysmon_log(void);
+
+#endif // SYSMON_H
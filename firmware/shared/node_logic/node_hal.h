@@ -0,0 +1,132 @@
+/*
+ * Node Hardware Abstraction Layer
+ * The seam between node logic (water level, pump control) and the platform
+ *
+ * node_hal_esp.c implements it on ESP-IDF; firmware/host/node_hal_posix.c
+ * implements it on Linux so the same logic builds and runs on a PC.
+ * NVS is not wrapped here: config_store.c uses the nvs.h API directly and the
+ * host build supplies a POSIX nvs.h implementation.
+ */
+
+#ifndef NODE_HAL_H
+#define NODE_HAL_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "esp_err.h"
+#include "ble_provision.h"
+#include "link_quality.h"
+
+/* ============================================================================
+ * PINS (ESP32-H2 Mini, same on every role)
+ * ============================================================================ */
+
+#define NODE_PIN_TRIGGER        2       // Ultrasonic trigger (sensor)
+#define NODE_PIN_RELAY          2       // Pump relay (controller)
+#define NODE_PIN_ECHO           3       // Ultrasonic echo (sensor)
+#define NODE_PIN_LED_STATUS     8       // Status LED
+#define NODE_PIN_LED_ACTIVITY   9       // Activity / pump LED
+#define NODE_PIN_BUTTON         10      // Provisioning button
+
+/* ============================================================================
+ * TIME
+ * ============================================================================ */
+
+/**
+ * Monotonic time since boot in microseconds (never wraps)
+ */
+int64_t node_hal_time_us(void);
+
+/**
+ * Block the calling task, letting others run
+ */
+void node_hal_delay_ms(uint32_t ms);
+
+/**
+ * Busy-wait (ultrasonic trigger pulse, echo polling)
+ */
+void node_hal_delay_us(uint32_t us);
+
+/**
+ * Give other tasks of the same priority a chance to run
+ */
+void node_hal_yield(void);
+
+/* ============================================================================
+ * GPIO
+ * ============================================================================ */
+
+void node_hal_gpio_set(int pin, int level);
+int  node_hal_gpio_get(int pin);
+
+/**
+ * Switch the pump relay and its LED. The ESP implementation also opens a
+ * radio coexistence window around the switch.
+ */
+void node_hal_pump_relay(bool on);
+
+/* ============================================================================
+ * ZIGBEE ATTRIBUTE I/O
+ * ============================================================================ */
+
+// Water level cluster, same layout on sensor and controller
+#define NODE_ZB_ENDPOINT            1
+#define NODE_ZB_CLUSTER_WATER_LEVEL 0xFC01
+#define NODE_ZB_ATTR_LEVEL_PCT      0x0000  // uint8_t
+#define NODE_ZB_ATTR_LEVEL_CM       0x0001  // uint16_t
+#define NODE_ZB_ATTR_SENSOR_STATUS  0x0002  // uint8_t
+#define NODE_ZB_ATTR_PUMP_STATE     0x0003  // uint8_t
+#define NODE_ZB_ATTR_LEVEL_STAMP    0x0004  // Octet string, e2e_stamp_t (e2e.h)
+
+// Network time beacons, controller -> sensors (net_time.h)
+#define NODE_ZB_CLUSTER_NET_TIME    0xFC03
+#define NODE_ZB_ATTR_NET_TIME_MS    0x0000  // uint32_t
+
+/**
+ * Set an attribute of the local water level cluster (server role).
+ * Caller must hold the Zigbee lock on ESP.
+ * @param attr_id NODE_ZB_ATTR_*
+ * @param value   Points to a value of the attribute's type
+ */
+esp_err_t node_hal_zb_set_attr(uint16_t attr_id, void *value);
+
+/* ============================================================================
+ * ZIGBEE LINK QUALITY
+ * ============================================================================ */
+
+#define NODE_ZB_PEER_ANY            0xFFFF  // Best neighbour, no preferred peer
+
+typedef struct {
+    int8_t  rssi_dbm;
+    uint8_t lqi;                    // 0-255
+    uint8_t neighbors;              // Entries in the neighbour table
+} node_zb_link_t;
+
+// LQI as the 0-100 signal quality shown in the app
+#define NODE_ZB_LQI_TO_PCT(lqi)     ((uint8_t)((lqi) * 100 / 255))
+
+/**
+ * Link quality from the neighbour table: the peer's entry if it is a direct
+ * neighbour, else the neighbour with the best LQI (usually the parent).
+ * Caller must hold the Zigbee lock on ESP.
+ * @return ESP_ERR_NOT_FOUND while the neighbour table is empty
+ */
+esp_err_t node_hal_zb_link_quality(uint16_t peer, node_zb_link_t *link);
+
+/**
+ * The neighbour table as link_quality_scan() samples.
+ * Caller must hold the Zigbee lock on ESP.
+ * @return Entries in the table; the first max are written
+ */
+int node_hal_zb_neighbors(link_sample_t *out, int max);
+
+/* ============================================================================
+ * BLE STATUS
+ * ============================================================================ */
+
+/**
+ * Publish device status to the BLE status characteristic
+ */
+void node_hal_ble_status(const device_status_t *status);
+
+#endif // NODE_HAL_H
@@ -0,0 +1,118 @@
+/*
+ * Node Hardware Abstraction Layer - ESP-IDF implementation
+ */
+
+#include "node_hal.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "driver/gpio.h"
+#include "esp_timer.h"
+#include "esp_rom_sys.h"
+#include "esp_zigbee_core.h"
+#include "radio_coex.h"
+
+/* ============================================================================
+ * TIME
+ * ============================================================================ */
+
+int64_t node_hal_time_us(void)
+{
+    return esp_timer_get_time();
+}
+
+void node_hal_delay_ms(uint32_t ms)
+{
+    vTaskDelay(pdMS_TO_TICKS(ms));
+}
+
+void node_hal_delay_us(uint32_t us)
+{
+    esp_rom_delay_us(us);
+}
+
+void node_hal_yield(void)
+{
+    taskYIELD();
+}
+
+/* ============================================================================
+ * GPIO
+ * ============================================================================ */
+
+void node_hal_gpio_set(int pin, int level)
+{
+    gpio_set_level((gpio_num_t)pin, level);
+}
+
+int node_hal_gpio_get(int pin)
+{
+    return gpio_get_level((gpio_num_t)pin);
+}
+
+void node_hal_pump_relay(bool on)
+{
+    // Relay coil switching couples into the radio; keep reports off the air
+    radio_coex_window_open(RADIO_COEX_WINDOW_PUMP, RADIO_COEX_PUMP_WINDOW_MS);
+    gpio_set_level(NODE_PIN_RELAY, on ? 1 : 0);
+    gpio_set_level(NODE_PIN_LED_ACTIVITY, on ? 1 : 0);
+}
+
+/* ============================================================================
+ * ZIGBEE ATTRIBUTE I/O
+ * ============================================================================ */
+
+esp_err_t node_hal_zb_set_attr(uint16_t attr_id, void *value)
+{
+    esp_zb_zcl_status_t status = esp_zb_zcl_set_attribute_val(NODE_ZB_ENDPOINT,
+        NODE_ZB_CLUSTER_WATER_LEVEL, ESP_ZB_ZCL_CLUSTER_SERVER_ROLE, attr_id, value, false);
+    return status == ESP_ZB_ZCL_STATUS_SUCCESS ? ESP_OK : ESP_FAIL;
+}
+
+esp_err_t node_hal_zb_link_quality(uint16_t peer, node_zb_link_t *link)
+{
+    esp_zb_nwk_info_iterator_t it = ESP_ZB_NWK_INFO_ITERATOR_INIT;
+    esp_zb_nwk_neighbor_info_t nbr;
+    bool found = false;
+    bool peer_found = false;
+
+    link->neighbors = 0;
+    while (esp_zb_nwk_get_next_neighbor(&it, &nbr) == ESP_OK) {
+        if (link->neighbors < UINT8_MAX) {
+            link->neighbors++;
+        }
+        if (peer_found) {
+            continue;
+        }
+        if (nbr.short_addr == peer || !found || nbr.lqi > link->lqi) {
+            link->rssi_dbm = nbr.rssi;
+            link->lqi = nbr.lqi;
+            found = true;
+            peer_found = nbr.short_addr == peer;
+        }
+    }
+    return found ? ESP_OK : ESP_ERR_NOT_FOUND;
+}
+
+int node_hal_zb_neighbors(link_sample_t *out, int max)
+{
+    esp_zb_nwk_info_iterator_t it = ESP_ZB_NWK_INFO_ITERATOR_INIT;
+    esp_zb_nwk_neighbor_info_t nbr;
+    int n = 0;
+
+    while (esp_zb_nwk_get_next_neighbor(&it, &nbr) == ESP_OK) {
+        if (n < max) {
+            out[n] = (link_sample_t){ .addr = nbr.short_addr, .lqi = nbr.lqi, .rssi_dbm = nbr.rssi };
+        }
+        n++;
+    }
+    return n;
+}
+
+/* ============================================================================
+ * BLE STATUS
+ * ============================================================================ */
+
+void node_hal_ble_status(const device_status_t *status)
+{
+    ble_status_update(status);
+}
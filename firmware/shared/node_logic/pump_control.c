@@ -0,0 +1,213 @@
+/*
+ * Pump Control
+ * Hysteresis control, safety timeout and manual override (controller role)
+ */
+
+#include "pump_control.h"
+#include "node_hal.h"
+#include "e2e.h"
+#include "metrics.h"
+#include "net_time.h"
+#include "trace.h"
+#include <string.h>
+#include "esp_log.h"
+
+static const char *TAG = "PUMP";
+
+/* ============================================================================
+ * RELAY
+ * ============================================================================ */
+
+void pump_control_init(pump_control_t *pc)
+{
+    memset(pc, 0, sizeof(*pc));
+    node_hal_pump_relay(false);
+}
+
+void pump_control_on(pump_control_t *pc)
+{
+    if (!pc->running) {
+        node_hal_pump_relay(true);
+        pc->running = true;
+        pc->start_us = node_hal_time_us();
+        pc->state_attr = 1;
+        metrics_inc(METRIC_PUMP_TRANSITIONS);
+        TRACE(PUMP_ON, pc->water_level_pct);
+    }
+}
+
+static void manual_clear(pump_control_t *pc)
+{
+    pc->manual_override = false;
+    pc->manual_end_us = 0;
+    pc->manual_duration_min = 0;
+}
+
+void pump_control_off(pump_control_t *pc)
+{
+    if (pc->manual_override) {
+        manual_clear(pc);
+        ESP_LOGI(TAG, "Manual override cleared");
+    }
+
+    if (pc->running) {
+        node_hal_pump_relay(false);
+        pc->running = false;
+        pc->state_attr = 0;
+        metrics_inc(METRIC_PUMP_TRANSITIONS);
+
+        int64_t runtime_us = node_hal_time_us() - pc->start_us;
+        pc->runtime_done_us += runtime_us;
+        TRACE(PUMP_OFF, (int32_t)(runtime_us / 1000000));
+    }
+}
+
+/* ============================================================================
+ * INPUTS
+ * ============================================================================ */
+
+void pump_control_sensor_update(pump_control_t *pc, uint8_t level_pct)
+{
+    pc->water_level_pct = level_pct;
+    pc->last_sensor_update_us = node_hal_time_us();
+    metrics_inc(METRIC_REPORTS_RECEIVED);
+}
+
+void pump_control_manual(pump_control_t *pc, const manual_pump_cmd_t *cmd)
+{
+    metrics_inc(METRIC_MANUAL_COMMANDS);
+    if (cmd->command == PUMP_CMD_START_TIMED && cmd->duration_minutes > 0) {
+        // Manual runs get the same 2 hour safety limit as automatic ones
+        uint16_t minutes = cmd->duration_minutes;
+        if (minutes > PUMP_CONTROL_MANUAL_MAX_MIN) {
+            ESP_LOGW(TAG, "Manual duration %d min capped to %d", minutes, PUMP_CONTROL_MANUAL_MAX_MIN);
+            minutes = PUMP_CONTROL_MANUAL_MAX_MIN;
+        }
+
+        int64_t now_us = node_hal_time_us();
+        pc->manual_override = true;
+        pc->manual_duration_min = minutes;
+        pc->manual_end_us = now_us + (int64_t)minutes * 60 * 1000000;
+        pc->manual_log_us = now_us;
+
+        ESP_LOGW(TAG, ">>> MANUAL OVERRIDE: Pump ON for %d minutes <<<", minutes);
+        pump_control_on(pc);
+    } else {
+        ESP_LOGW(TAG, ">>> MANUAL OVERRIDE: Pump STOP <<<");
+        manual_clear(pc);
+        pump_control_off(pc);
+    }
+}
+
+/* ============================================================================
+ * CONTROL PASS
+ * ============================================================================ */
+
+static void control_pass(pump_control_t *pc, const config_derived_t *dc)
+{
+    int64_t now_us = node_hal_time_us();
+
+    // ========== MANUAL OVERRIDE MODE ==========
+    if (pc->manual_override) {
+        if (now_us >= pc->manual_end_us) {
+            ESP_LOGW(TAG, "Manual override expired after %d minutes", pc->manual_duration_min);
+            manual_clear(pc);
+            pump_control_off(pc);
+            return;
+        }
+
+        if (!pc->running) {
+            pump_control_on(pc);
+        }
+
+        if (now_us - pc->manual_log_us >= PUMP_CONTROL_MANUAL_LOG_US) {
+            uint32_t remaining = pump_control_manual_remaining_sec(pc);
+            ESP_LOGI(TAG, "MANUAL MODE: %lu min %lu sec remaining",
+                     (unsigned long)(remaining / 60), (unsigned long)(remaining % 60));
+            pc->manual_log_us = now_us;
+        }
+        return; // Skip automatic control in manual mode
+    }
+
+    // ========== AUTOMATIC MODE ==========
+    bool sensor_online = pc->last_sensor_update_us > 0 &&
+                         now_us - pc->last_sensor_update_us < PUMP_CONTROL_SENSOR_TIMEOUT_US;
+
+    if (!sensor_online) {
+        if (pc->sensor_connected) {
+            ESP_LOGW(TAG, "Sensor offline!");
+            pc->sensor_connected = false;
+            metrics_inc(METRIC_SENSOR_TIMEOUTS);
+        }
+        if (pc->running) {
+            ESP_LOGW(TAG, "Turning pump OFF - sensor timeout");
+            pump_control_off(pc);
+        }
+        return;
+    }
+
+    if (!pc->sensor_connected) {
+        ESP_LOGI(TAG, "Sensor online");
+        pc->sensor_connected = true;
+    }
+
+    if (pc->running && now_us - pc->start_us >= dc->pump_timeout_us) {
+        ESP_LOGW(TAG, "Pump timeout after %lu seconds",
+                 (unsigned long)((now_us - pc->start_us) / 1000000));
+        pump_control_off(pc);
+        return;
+    }
+
+    if (pc->water_level_pct <= dc->pump_on_pct && !pc->running) {
+        TRACE(WATER_LOW, pc->water_level_pct, dc->pump_on_pct);
+        pump_control_on(pc);
+        e2e_relay_switched(net_time_now_ms(NULL));
+    }
+    else if (pc->water_level_pct >= dc->pump_off_pct && pc->running) {
+        TRACE(WATER_HIGH, pc->water_level_pct, dc->pump_off_pct);
+        pump_control_off(pc);
+        e2e_relay_switched(net_time_now_ms(NULL));
+    }
+}
+
+void pump_control_step(pump_control_t *pc, const config_derived_t *dc)
+{
+    TRACE(CONTROL_PASS, pc->water_level_pct);
+    control_pass(pc, dc);
+    TRACE(CONTROL_PASS_END, pc->running);
+}
+
+/* ============================================================================
+ * STATUS
+ * ============================================================================ */
+
+uint32_t pump_control_manual_remaining_sec(const pump_control_t *pc)
+{
+    if (!pc->manual_override) {
+        return 0;
+    }
+    int64_t remaining_us = pc->manual_end_us - node_hal_time_us();
+    return remaining_us > 0 ? (uint32_t)(remaining_us / 1000000) : 0;
+}
+
+uint32_t pump_control_runtime_sec(const pump_control_t *pc)
+{
+    uint64_t total_us = pc->runtime_done_us;
+    if (pc->running) {
+        total_us += node_hal_time_us() - pc->start_us;
+    }
+    return (uint32_t)(total_us / 1000000);
+}
+
+void pump_control_report_status(const pump_control_t *pc, device_status_t *status)
+{
+    status->water_level_percent = pc->water_level_pct;
+    status->water_level_cm = 0;
+    status->sensor_status = pc->sensor_connected ? 0 : 1;
+    status->pump_active = pc->running;
+    status->pump_runtime_sec = pump_control_runtime_sec(pc);
+    status->last_water_level = pc->water_level_pct;
+    status->manual_override = pc->manual_override;
+    status->manual_remaining_sec = pump_control_manual_remaining_sec(pc);
+    node_hal_ble_status(status);
+}
@@ -0,0 +1,93 @@
+/*
+ * Pump Control
+ * Hysteresis control, safety timeout and manual override (controller role)
+ */
+
+#ifndef PUMP_CONTROL_H
+#define PUMP_CONTROL_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "config_derived.h"
+#include "ble_provision.h"
+
+/* ============================================================================
+ * CONFIGURATION
+ * ============================================================================ */
+
+#define PUMP_CONTROL_SENSOR_TIMEOUT_US  (30LL * 1000000)    // Sensor offline after 30 s
+#define PUMP_CONTROL_MANUAL_LOG_US      (30LL * 1000000)    // Manual mode progress log
+#define PUMP_CONTROL_MANUAL_MAX_MIN     (CONFIG_MAX_PUMP_TIMEOUT_SEC / 60)
+
+/* ============================================================================
+ * STATE
+ * ============================================================================ */
+
+/*
+ * All times are node_hal_time_us() values: 64-bit, no 49-day wrap.
+ */
+typedef struct {
+    bool     running;
+    int64_t  start_us;                  // Current run start
+    uint64_t runtime_done_us;           // Sum of finished runs
+    uint8_t  state_attr;                // Zigbee ATTR_PUMP_STATE storage
+
+    // Manual override
+    bool     manual_override;
+    int64_t  manual_end_us;
+    uint16_t manual_duration_min;
+    int64_t  manual_log_us;
+
+    // Last report from the sensor
+    uint8_t  water_level_pct;
+    int64_t  last_sensor_update_us;     // 0 = never heard from
+    bool     sensor_connected;
+} pump_control_t;
+
+/* ============================================================================
+ * API
+ * ============================================================================ */
+
+/**
+ * Reset state and switch the relay off
+ */
+void pump_control_init(pump_control_t *pc);
+
+void pump_control_on(pump_control_t *pc);
+
+/**
+ * Switch the pump off; also ends a manual override
+ */
+void pump_control_off(pump_control_t *pc);
+
+/**
+ * Record a water level report from the sensor (Zigbee callback)
+ */
+void pump_control_sensor_update(pump_control_t *pc, uint8_t level_pct);
+
+/**
+ * Apply a manual pump command (BLE callback). Durations are capped to
+ * PUMP_CONTROL_MANUAL_MAX_MIN.
+ */
+void pump_control_manual(pump_control_t *pc, const manual_pump_cmd_t *cmd);
+
+/**
+ * One control pass: manual override expiry, sensor timeout, pump safety
+ * timeout, then the on/off hysteresis band from dc
+ */
+void pump_control_step(pump_control_t *pc, const config_derived_t *dc);
+
+uint32_t pump_control_manual_remaining_sec(const pump_control_t *pc);
+
+/**
+ * Total pump runtime since boot, including the current run
+ */
+uint32_t pump_control_runtime_sec(const pump_control_t *pc);
+
+/**
+ * Fill the controller fields of status and publish it over BLE.
+ * The caller sets the common fields (role, link, uptime, RSSI).
+ */
+void pump_control_report_status(const pump_control_t *pc, device_status_t *status);
+
+#endif // PUMP_CONTROL_H
@@ -0,0 +1,153 @@
+/*
+ * Water Level Measurement
+ * Ultrasonic ranging and tank level calculation (sensor role)
+ */
+
+#include "water_level.h"
+#include "node_hal.h"
+#include "trace.h"
+#include "energy.h"
+#include "esp_log.h"
+
+static const char *TAG = "WATER_LEVEL";
+
+/* ============================================================================
+ * ULTRASONIC
+ * ============================================================================ */
+
+float water_level_ping_cm(void)
+{
+    node_hal_gpio_set(NODE_PIN_TRIGGER, 0);
+    node_hal_delay_us(2);
+    node_hal_gpio_set(NODE_PIN_TRIGGER, 1);
+    node_hal_delay_us(10);
+    node_hal_gpio_set(NODE_PIN_TRIGGER, 0);
+
+    int64_t start_wait = node_hal_time_us();
+    while (node_hal_gpio_get(NODE_PIN_ECHO) == 0) {
+        if ((node_hal_time_us() - start_wait) > WATER_LEVEL_ECHO_TIMEOUT_US) {
+            return -1.0f;
+        }
+        // FIX: BUG #2 - Prevent watchdog timeout and allow task switching
+        node_hal_delay_us(10);
+        node_hal_yield();
+    }
+
+    int64_t echo_start = node_hal_time_us();
+    while (node_hal_gpio_get(NODE_PIN_ECHO) == 1) {
+        if ((node_hal_time_us() - echo_start) > WATER_LEVEL_ECHO_TIMEOUT_US) {
+            return -1.0f;
+        }
+        // FIX: BUG #2 - Prevent watchdog timeout and allow task switching
+        node_hal_delay_us(10);
+        node_hal_yield();
+    }
+    int64_t echo_end = node_hal_time_us();
+
+    float duration_us = (float)(echo_end - echo_start);
+    return (duration_us * WATER_LEVEL_SOUND_SPEED_CM_US) / 2.0f;
+}
+
+/* ============================================================================
+ * LEVEL CALCULATION
+ * ============================================================================ */
+
+uint8_t water_level_percent(const config_derived_t *dc, float depth_cm)
+{
+    // Multiplying by the reciprocal rounds a whole tank to 99.99...; the
+    // slack restores 100 % (and every other integer percent) before the cut
+    float percent = depth_cm * dc->pct_per_cm + WATER_LEVEL_PCT_EPSILON;
+    if (percent <= 0.0f) {
+        return 0;
+    }
+    return percent >= 100.0f ? 100 : (uint8_t)percent;
+}
+
+bool water_level_compute(const float *samples, int count,
+                         const config_derived_t *dc, water_level_t *wl)
+{
+    float total_distance = 0;
+    int valid_samples = 0;
+
+    for (int i = 0; i < count; i++) {
+        if (samples[i] > 0 && samples[i] < dc->max_distance_cm) {
+            total_distance += samples[i];
+            valid_samples++;
+        }
+    }
+
+    if (valid_samples == 0) {
+        wl->status = WATER_LEVEL_STATUS_ERROR;
+        return false;
+    }
+
+    // FIX: BUG #5 - config_derive() guarantees a non-zero tank height
+    float avg_distance = total_distance / valid_samples;
+    float water_depth = dc->tank_height_cm - avg_distance - dc->sensor_offset_cm;
+
+    if (water_depth < 0) water_depth = 0;
+    if (water_depth > dc->tank_height_cm) water_depth = dc->tank_height_cm;
+
+    wl->cm = (uint16_t)water_depth;
+    wl->percent = water_level_percent(dc, water_depth);
+    wl->litres = (uint32_t)(water_depth * dc->litres_per_cm);
+    wl->status = WATER_LEVEL_STATUS_OK;
+    return true;
+}
+
+bool water_level_measure(const config_derived_t *dc, water_level_t *wl)
+{
+    static uint32_t s_cycle;
+    int32_t cycle = (int32_t)++s_cycle;
+    float samples[WATER_LEVEL_NUM_SAMPLES];
+
+    TRACE(MEASURE, cycle);
+    energy_count(ENERGY_EV_WAKEUP, 1);
+
+    for (int i = 0; i < WATER_LEVEL_NUM_SAMPLES; i++) {
+        int64_t ping_start = node_hal_time_us();
+        samples[i] = water_level_ping_cm();
+        energy_add_us(ENERGY_ULTRASONIC, node_hal_time_us() - ping_start);
+        energy_count(ENERGY_EV_PING, 1);
+        node_hal_delay_ms(WATER_LEVEL_SAMPLE_DELAY_MS);
+    }
+
+    if (!water_level_compute(samples, WATER_LEVEL_NUM_SAMPLES, dc, wl)) {
+        TRACE(MEASURE_END, cycle, 0, wl->percent);
+        ESP_LOGW(TAG, "Sensor measurement failed");
+        return false;
+    }
+
+    TRACE(MEASURE_END, cycle, 1, wl->percent);
+    TRACE(WATER_LEVEL, wl->percent, wl->cm, (int32_t)wl->litres);
+    return true;
+}
+
+/* ============================================================================
+ * PUBLISHING
+ * ============================================================================ */
+
+void water_level_publish(const water_level_t *wl)
+{
+    // The stack copies the values; locals keep the caller's struct const
+    uint8_t percent = wl->percent;
+    uint16_t cm = wl->cm;
+    uint8_t status = wl->status;
+
+    node_hal_zb_set_attr(NODE_ZB_ATTR_LEVEL_PCT, &percent);
+    node_hal_zb_set_attr(NODE_ZB_ATTR_LEVEL_CM, &cm);
+    node_hal_zb_set_attr(NODE_ZB_ATTR_SENSOR_STATUS, &status);
+}
+
+void water_level_report_status(const water_level_t *wl, device_status_t *status)
+{
+    status->water_level_percent = wl->percent;
+    status->water_level_cm = wl->cm;
+    status->sensor_status = wl->status;
+    status->last_water_level = wl->percent;
+    status->pump_active = false;
+    status->pump_runtime_sec = 0;
+    status->manual_override = false;
+    status->manual_remaining_sec = 0;
+    node_hal_ble_status(status);
+}
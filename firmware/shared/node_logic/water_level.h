@@ -0,0 +1,83 @@
+/*
+ * Water Level Measurement
+ * Ultrasonic ranging and tank level calculation (sensor role)
+ */
+
+#ifndef WATER_LEVEL_H
+#define WATER_LEVEL_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "config_derived.h"
+#include "ble_provision.h"
+
+/* ============================================================================
+ * CONFIGURATION
+ * ============================================================================ */
+
+#define WATER_LEVEL_SOUND_SPEED_CM_US   0.0343f
+#define WATER_LEVEL_ECHO_TIMEOUT_US     30000
+#define WATER_LEVEL_NUM_SAMPLES         5
+#define WATER_LEVEL_SAMPLE_DELAY_MS     50
+
+// Slack added before truncating depth * pct_per_cm, so the product of the
+// float reciprocal lands on the same percent as depth * 100 / height
+#define WATER_LEVEL_PCT_EPSILON         1e-4f
+
+#define WATER_LEVEL_STATUS_OK           0
+#define WATER_LEVEL_STATUS_ERROR        1
+
+/* ============================================================================
+ * TYPES
+ * ============================================================================ */
+
+typedef struct {
+    uint8_t  percent;           // 0-100%
+    uint16_t cm;                // Water depth
+    uint8_t  status;            // WATER_LEVEL_STATUS_*
+    uint32_t litres;            // 0 if tank diameter unknown
+} water_level_t;
+
+/* ============================================================================
+ * API
+ * ============================================================================ */
+
+/**
+ * One ultrasonic ping
+ * @return Distance in cm, -1 on echo timeout
+ */
+float water_level_ping_cm(void);
+
+/**
+ * Depth to percent of tank height, truncated, 0-100. Pure function.
+ */
+uint8_t water_level_percent(const config_derived_t *dc, float depth_cm);
+
+/**
+ * Average the valid samples and convert to a level. Pure function.
+ * Samples <= 0 or >= dc->max_distance_cm are discarded.
+ * @param wl Out: level and status. On failure only status is changed, so the
+ *           last good level is still reported.
+ * @return true if at least one sample was valid
+ */
+bool water_level_compute(const float *samples, int count,
+                         const config_derived_t *dc, water_level_t *wl);
+
+/**
+ * Take WATER_LEVEL_NUM_SAMPLES pings and compute the level (blocks ~250 ms)
+ */
+bool water_level_measure(const config_derived_t *dc, water_level_t *wl);
+
+/**
+ * Write level, depth and status to the local Zigbee attributes.
+ * Caller must hold the Zigbee lock on ESP.
+ */
+void water_level_publish(const water_level_t *wl);
+
+/**
+ * Fill the sensor fields of status and publish it over BLE.
+ * The caller sets the common fields (role, link, uptime).
+ */
+void water_level_report_status(const water_level_t *wl, device_status_t *status);
+
+#endif // WATER_LEVEL_H
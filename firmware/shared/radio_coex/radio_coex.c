@@ -0,0 +1,286 @@
+/*
+ * BLE / IEEE 802.15.4 Radio Coexistence Implementation
+ * Application-level priority windows on top of the IDF radio arbiter
+ */
+
+#include "radio_coex.h"
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "sdkconfig.h"
+
+#if CONFIG_ESP_COEX_SW_COEXIST_ENABLE || CONFIG_EXTERNAL_COEX_ENABLE
+#include "esp_ieee802154.h"
+#define RADIO_COEX_HW_PRIORITY  1
+#else
+#define RADIO_COEX_HW_PRIORITY  0
+#endif
+
+static const char *TAG = "RADIO_COEX";
+
+#define MIN_REPORT_PERIOD_US    (1000 * 1000LL)     // Don't predict faster reports
+#define MAX_CONSECUTIVE_MISSED  3                   // Stop predicting after this
+
+/* ============================================================================
+ * GLOBAL VARIABLES
+ * ============================================================================ */
+
+static portMUX_TYPE g_coex_lock = portMUX_INITIALIZER_UNLOCKED;
+static bool g_initialized = false;
+static radio_coex_mode_t g_mode = RADIO_COEX_MODE_BALANCED;
+
+static esp_timer_handle_t g_window_timer = NULL;    // Closes the window
+static esp_timer_handle_t g_expect_timer = NULL;    // Opens the next RX window
+static bool g_window_open = false;
+static int64_t g_window_since_us = 0;
+static int64_t g_window_end_us = 0;
+
+// Receiver: learned report period
+static int64_t g_last_report_us = 0;
+static int64_t g_report_period_us = 0;
+static bool g_rx_pending = false;
+static uint8_t g_consecutive_missed = 0;
+
+// Sender: retries of the current report
+static uint8_t g_retry_count = 0;
+
+static radio_coex_stats_t g_stats = {0};
+
+/* ============================================================================
+ * HELPER FUNCTIONS
+ * ============================================================================ */
+
+static void set_zigbee_priority(bool high) {
+#if RADIO_COEX_HW_PRIORITY
+    if (g_mode == RADIO_COEX_MODE_ZIGBEE_FIRST) {
+        high = true;
+    }
+
+    // IDF defaults: idle LOW, txrx MIDDLE, txrx_at MIDDLE
+    esp_ieee802154_coex_config_t cfg = {
+        .idle = high ? IEEE802154_MIDDLE : IEEE802154_LOW,
+        .txrx = high ? IEEE802154_HIGH : IEEE802154_MIDDLE,
+        .txrx_at = high ? IEEE802154_HIGHEST : IEEE802154_MIDDLE,
+    };
+    esp_ieee802154_coex_config_set(cfg);
+#else
+    (void)high;
+#endif
+}
+
+static void arm_expect_timer(int64_t delay_us) {
+    esp_timer_stop(g_expect_timer);
+    esp_timer_start_once(g_expect_timer, delay_us > 0 ? (uint64_t)delay_us : 0);
+}
+
+static void window_close_cb(void *arg) {
+    int64_t now_us = esp_timer_get_time();
+
+    portENTER_CRITICAL(&g_coex_lock);
+    if (now_us < g_window_end_us) {
+        // Extended while the timer fired
+        int64_t remaining_us = g_window_end_us - now_us;
+        portEXIT_CRITICAL(&g_coex_lock);
+        esp_timer_start_once(g_window_timer, remaining_us);
+        return;
+    }
+
+    g_window_open = false;
+    g_stats.zigbee_priority_ms += (uint32_t)((now_us - g_window_since_us) / 1000);
+
+    bool missed = g_rx_pending;
+    g_rx_pending = false;
+    if (missed) {
+        g_stats.reports_missed++;
+        g_consecutive_missed++;
+    }
+    bool predict = missed && g_consecutive_missed < MAX_CONSECUTIVE_MISSED;
+    int64_t period_us = g_report_period_us;
+    portEXIT_CRITICAL(&g_coex_lock);
+
+    set_zigbee_priority(false);
+
+    if (missed) {
+        ESP_LOGW(TAG, "Expected report did not arrive");
+    }
+    if (predict) {
+        // Keep the schedule: next arrival is one period after the missed one
+        arm_expect_timer(period_us - (int64_t)RADIO_COEX_REPORT_RX_WINDOW_MS * 1000);
+    }
+}
+
+static void expect_report_cb(void *arg) {
+    portENTER_CRITICAL(&g_coex_lock);
+    g_rx_pending = true;
+    portEXIT_CRITICAL(&g_coex_lock);
+
+    radio_coex_window_open(RADIO_COEX_WINDOW_REPORT_RX, RADIO_COEX_REPORT_RX_WINDOW_MS);
+}
+
+/* ============================================================================
+ * PUBLIC API IMPLEMENTATION
+ * ============================================================================ */
+
+esp_err_t radio_coex_init(radio_coex_mode_t mode) {
+    if (g_initialized) {
+        return ESP_OK;
+    }
+
+    const esp_timer_create_args_t window_args = {
+        .callback = window_close_cb,
+        .name = "coex_window",
+    };
+    esp_err_t ret = esp_timer_create(&window_args, &g_window_timer);
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to create window timer: %s", esp_err_to_name(ret));
+        return ret;
+    }
+
+    const esp_timer_create_args_t expect_args = {
+        .callback = expect_report_cb,
+        .name = "coex_expect",
+    };
+    ret = esp_timer_create(&expect_args, &g_expect_timer);
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to create expect timer: %s", esp_err_to_name(ret));
+        esp_timer_delete(g_window_timer);
+        g_window_timer = NULL;
+        return ret;
+    }
+
+    g_mode = mode;
+    g_stats.mode = mode;
+    set_zigbee_priority(false);
+    g_initialized = true;
+
+    ESP_LOGI(TAG, "Radio coexistence: %s%s",
+             mode == RADIO_COEX_MODE_ZIGBEE_FIRST ? "Zigbee first" : "balanced",
+             RADIO_COEX_HW_PRIORITY ? "" : " (no HW priority control, deferral only)");
+    return ESP_OK;
+}
+
+void radio_coex_window_open(radio_coex_window_t reason, uint32_t duration_ms) {
+    if (!g_initialized || reason >= RADIO_COEX_WINDOW_MAX) {
+        return;
+    }
+
+    int64_t now_us = esp_timer_get_time();
+    int64_t end_us = now_us + (int64_t)duration_ms * 1000;
+    bool opened = false;
+
+    portENTER_CRITICAL(&g_coex_lock);
+    g_stats.windows[reason]++;
+    if (!g_window_open) {
+        g_window_open = true;
+        g_window_since_us = now_us;
+        opened = true;
+    }
+    if (end_us > g_window_end_us) {
+        g_window_end_us = end_us;
+    }
+    int64_t remaining_us = g_window_end_us - now_us;
+    portEXIT_CRITICAL(&g_coex_lock);
+
+    if (opened) {
+        set_zigbee_priority(true);
+    }
+    esp_timer_stop(g_window_timer);
+    esp_timer_start_once(g_window_timer, remaining_us);
+}
+
+uint32_t radio_coex_ble_defer_ms(bool first_ask) {
+    uint32_t defer_ms = 0;
+    int64_t now_us = esp_timer_get_time();
+
+    portENTER_CRITICAL(&g_coex_lock);
+    if (g_window_open && g_window_end_us > now_us) {
+        defer_ms = (uint32_t)((g_window_end_us - now_us + 999) / 1000);
+        if (first_ask) {
+            g_stats.ble_deferred++;
+        }
+    }
+    portEXIT_CRITICAL(&g_coex_lock);
+
+    return defer_ms;
+}
+
+void radio_coex_report_received(void) {
+    if (!g_initialized) {
+        return;
+    }
+
+    int64_t now_us = esp_timer_get_time();
+
+    portENTER_CRITICAL(&g_coex_lock);
+    if (g_last_report_us > 0) {
+        int64_t interval_us = now_us - g_last_report_us;
+        if (g_report_period_us == 0) {
+            g_report_period_us = interval_us;
+        } else if (interval_us < g_report_period_us * 3 / 2) {
+            // EWMA (1/4), ignoring gaps left by missed reports
+            g_report_period_us = (g_report_period_us * 3 + interval_us) / 4;
+        }
+    }
+    g_last_report_us = now_us;
+    g_rx_pending = false;
+    g_consecutive_missed = 0;
+    int64_t period_us = g_report_period_us;
+    portEXIT_CRITICAL(&g_coex_lock);
+
+    if (period_us >= MIN_REPORT_PERIOD_US) {
+        arm_expect_timer(period_us - (int64_t)RADIO_COEX_REPORT_RX_LEAD_MS * 1000);
+    }
+}
+
+void radio_coex_report_sent(bool retry) {
+    portENTER_CRITICAL(&g_coex_lock);
+    g_stats.zigbee_sent++;
+    if (retry) {
+        g_stats.zigbee_retried++;
+    } else {
+        g_retry_count = 0;
+    }
+    portEXIT_CRITICAL(&g_coex_lock);
+
+    radio_coex_window_open(RADIO_COEX_WINDOW_REPORT_TX, RADIO_COEX_REPORT_TX_WINDOW_MS);
+}
+
+bool radio_coex_report_result(bool ok) {
+    if (ok) {
+        return false;
+    }
+
+    bool retry = false;
+    portENTER_CRITICAL(&g_coex_lock);
+    if (g_retry_count < RADIO_COEX_REPORT_MAX_RETRIES) {
+        g_retry_count++;
+        retry = true;
+    } else {
+        g_stats.zigbee_lost++;
+    }
+    portEXIT_CRITICAL(&g_coex_lock);
+
+    if (!retry) {
+        ESP_LOGW(TAG, "Report lost after %d retries", RADIO_COEX_REPORT_MAX_RETRIES);
+    }
+    return retry;
+}
+
+esp_err_t radio_coex_get_stats(radio_coex_stats_t *stats) {
+    if (stats == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    int64_t now_us = esp_timer_get_time();
+
+    portENTER_CRITICAL(&g_coex_lock);
+    memcpy(stats, &g_stats, sizeof(radio_coex_stats_t));
+    stats->window_open = g_window_open;
+    if (g_window_open) {
+        stats->zigbee_priority_ms += (uint32_t)((now_us - g_window_since_us) / 1000);
+    }
+    portEXIT_CRITICAL(&g_coex_lock);
+
+    return ESP_OK;
+}
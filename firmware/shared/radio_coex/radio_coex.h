@@ -0,0 +1,131 @@
+/*
+ * BLE / IEEE 802.15.4 Radio Coexistence Policy
+ * ESP32-H2 / ESP32-C6 (single radio shared by Bluedroid and Zigbee)
+ */
+
+#ifndef RADIO_COEX_H
+#define RADIO_COEX_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "esp_err.h"
+
+/* ============================================================================
+ * POLICY
+ * ============================================================================ */
+
+/*
+ * The radio arbiter grants the antenna by priority. Outside a Zigbee window
+ * both stacks run at the IDF default priorities. While a window is open,
+ * 802.15.4 TX/RX is raised above BLE and application-level BLE work (beacon
+ * refresh, advertising restarts) is postponed until the window closes.
+ *
+ * Windows are opened:
+ *   - by the sensor around each water level report,
+ *   - by the controller around each expected sensor report (the report
+ *     period is learned from inter-arrival times),
+ *   - by the controller around every pump relay transition.
+ *
+ * Controllers (Zigbee coordinator) keep 802.15.4 priority permanently.
+ */
+
+// Coexistence modes
+typedef enum {
+    RADIO_COEX_MODE_BALANCED = 0,       // Default priorities, raised during windows
+    RADIO_COEX_MODE_ZIGBEE_FIRST,       // 802.15.4 always above BLE
+} radio_coex_mode_t;
+
+// Window reasons (for logging / stats)
+typedef enum {
+    RADIO_COEX_WINDOW_REPORT_TX = 0,    // Local report being sent
+    RADIO_COEX_WINDOW_REPORT_RX,        // Remote report expected
+    RADIO_COEX_WINDOW_PUMP,             // Pump relay transition
+    RADIO_COEX_WINDOW_MAX
+} radio_coex_window_t;
+
+#define RADIO_COEX_REPORT_TX_WINDOW_MS  300     // MAC ACK + APS ACK + MAC retries
+#define RADIO_COEX_REPORT_RX_LEAD_MS    150     // Open before the expected arrival
+#define RADIO_COEX_REPORT_RX_WINDOW_MS  500     // Jitter allowance around arrival
+#define RADIO_COEX_PUMP_WINDOW_MS       1000    // Relay switch + state reporting
+
+// Application-level retry for reports the stack failed to deliver
+#define RADIO_COEX_REPORT_MAX_RETRIES   2
+#define RADIO_COEX_REPORT_RETRY_MS      250
+
+// Relaxed BLE connection parameters requested once a phone connects, so a
+// connected app leaves most of each connection interval to 802.15.4
+#define RADIO_COEX_BLE_CONN_INT_MIN     0x28    // 50 ms  (units of 1.25 ms)
+#define RADIO_COEX_BLE_CONN_INT_MAX     0x50    // 100 ms
+#define RADIO_COEX_BLE_CONN_LATENCY     0
+#define RADIO_COEX_BLE_CONN_TIMEOUT     400     // 4 s    (units of 10 ms)
+
+/**
+ * Coexistence counters since boot
+ */
+typedef struct {
+    uint8_t  mode;                      // radio_coex_mode_t
+    bool     window_open;               // Zigbee window currently open
+    uint32_t windows[RADIO_COEX_WINDOW_MAX]; // Windows opened, per reason
+    uint32_t zigbee_priority_ms;        // Time with 802.15.4 raised (windows only)
+    uint32_t ble_deferred;              // BLE operations postponed by a window
+    uint32_t zigbee_sent;               // Reports handed to the stack
+    uint32_t zigbee_retried;            // Reports re-sent after a failed send
+    uint32_t zigbee_lost;               // Reports dropped after all retries
+    uint32_t reports_missed;            // Expected reports that never arrived
+} radio_coex_stats_t;
+
+/* ============================================================================
+ * API FUNCTIONS
+ * ============================================================================ */
+
+/**
+ * Initialize coexistence policy
+ * @param mode RADIO_COEX_MODE_ZIGBEE_FIRST on controllers, BALANCED otherwise
+ * @return ESP_OK on success
+ */
+esp_err_t radio_coex_init(radio_coex_mode_t mode);
+
+/**
+ * Open (or extend) a Zigbee priority window starting now
+ * @param reason Why the window is opened
+ * @param duration_ms Window length
+ */
+void radio_coex_window_open(radio_coex_window_t reason, uint32_t duration_ms);
+
+/**
+ * Ask whether BLE work should wait for the radio. Callers that get a
+ * non-zero answer must postpone the operation and ask again later.
+ * @param first_ask true the first time an operation asks; a deferral is
+ *                  counted in ble_deferred only then, so re-polls of an
+ *                  operation already postponed are not counted again
+ * @return Milliseconds until the current window closes, 0 to go ahead
+ */
+uint32_t radio_coex_ble_defer_ms(bool first_ask);
+
+/**
+ * Receiver side: a report arrived. Learns the report period and schedules
+ * a window around the next expected arrival.
+ */
+void radio_coex_report_received(void);
+
+/**
+ * Sender side: record the outcome of a report send
+ * @param ok true if the stack delivered the frame
+ * @return true if the caller should retry (within RADIO_COEX_REPORT_MAX_RETRIES)
+ */
+bool radio_coex_report_result(bool ok);
+
+/**
+ * Sender side: a report is being handed to the stack
+ * @param retry true if this is a retry of a failed report
+ */
+void radio_coex_report_sent(bool retry);
+
+/**
+ * Get coexistence counters
+ * @param stats Output counters
+ * @return ESP_OK on success
+ */
+esp_err_t radio_coex_get_stats(radio_coex_stats_t *stats);
+
+#endif // RADIO_COEX_H
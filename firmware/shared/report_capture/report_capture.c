@@ -0,0 +1,303 @@
+/*
+ * Report Capture - recorder and stream codec
+ * Platform-independent: the host replay tool builds this file as is.
+ */
+
+#include "report_capture.h"
+
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "esp_log.h"
+#include "node_hal.h"
+
+static const char *TAG = "CAPTURE";
+
+/* ============================================================================
+ * RECORD CODEC
+ * ============================================================================ */
+
+static void put_u16(uint8_t *p, uint16_t v)
+{
+    p[0] = (uint8_t)v;
+    p[1] = (uint8_t)(v >> 8);
+}
+
+static void put_u32(uint8_t *p, uint32_t v)
+{
+    put_u16(p, (uint16_t)v);
+    put_u16(p + 2, (uint16_t)(v >> 16));
+}
+
+static uint16_t get_u16(const uint8_t *p)
+{
+    return (uint16_t)(p[0] | (p[1] << 8));
+}
+
+static uint32_t get_u32(const uint8_t *p)
+{
+    return get_u16(p) | ((uint32_t)get_u16(p + 2) << 16);
+}
+
+void report_capture_encode_header(uint8_t out[REPORT_CAPTURE_REC_SIZE])
+{
+    memset(out, 0, REPORT_CAPTURE_REC_SIZE);
+    memcpy(out, REPORT_CAPTURE_MAGIC, 4);
+    out[4] = REPORT_CAPTURE_VERSION;
+    out[5] = REPORT_CAPTURE_REC_SIZE;
+}
+
+bool report_capture_is_header(const uint8_t *rec)
+{
+    return memcmp(rec, REPORT_CAPTURE_MAGIC, 4) == 0;
+}
+
+void report_capture_encode(uint8_t out[REPORT_CAPTURE_REC_SIZE], uint32_t dt_ms,
+                           const report_capture_event_t *ev)
+{
+    put_u32(out, dt_ms);
+    out[4] = ev->type;
+    out[5] = ev->arg;
+    put_u16(out + 6, ev->src);
+    put_u16(out + 8, ev->id);
+    put_u16(out + 10, ev->value);
+}
+
+void report_capture_reader_init(report_capture_reader_t *r, const uint8_t *data, size_t len)
+{
+    r->data = data;
+    r->len = len;
+    r->pos = 0;
+    r->t_ms = 0;
+}
+
+bool report_capture_next(report_capture_reader_t *r, report_capture_event_t *ev)
+{
+    while (r->pos + REPORT_CAPTURE_REC_SIZE <= r->len) {
+        const uint8_t *p = r->data + r->pos;
+        r->pos += REPORT_CAPTURE_REC_SIZE;
+        if (report_capture_is_header(p)) {
+            continue;
+        }
+
+        r->t_ms += get_u32(p);
+        ev->t_ms = r->t_ms;
+        ev->type = p[4];
+        ev->arg = p[5];
+        ev->src = get_u16(p + 6);
+        ev->id = get_u16(p + 8);
+        ev->value = get_u16(p + 10);
+        return true;
+    }
+    return false;
+}
+
+/* ============================================================================
+ * LINE CODEC (BASE64)
+ * ============================================================================ */
+
+static const char s_b64[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+size_t report_capture_line_encode(const uint8_t *data, size_t len, char *out, size_t out_size)
+{
+    size_t prefix = strlen(REPORT_CAPTURE_LINE_PREFIX);
+    size_t need = prefix + (len + 2) / 3 * 4 + 1;
+    if (out_size < need) {
+        return 0;
+    }
+
+    memcpy(out, REPORT_CAPTURE_LINE_PREFIX, prefix);
+    char *o = out + prefix;
+    for (size_t i = 0; i < len; i += 3) {
+        uint32_t v = (uint32_t)data[i] << 16;
+        if (i + 1 < len) v |= (uint32_t)data[i + 1] << 8;
+        if (i + 2 < len) v |= data[i + 2];
+        *o++ = s_b64[(v >> 18) & 0x3F];
+        *o++ = s_b64[(v >> 12) & 0x3F];
+        *o++ = i + 1 < len ? s_b64[(v >> 6) & 0x3F] : '=';
+        *o++ = i + 2 < len ? s_b64[v & 0x3F] : '=';
+    }
+    *o = '\0';
+    return (size_t)(o - out);
+}
+
+static int b64_value(char c)
+{
+    if (c >= 'A' && c <= 'Z') return c - 'A';
+    if (c >= 'a' && c <= 'z') return c - 'a' + 26;
+    if (c >= '0' && c <= '9') return c - '0' + 52;
+    if (c == '+') return 62;
+    if (c == '/') return 63;
+    return -1;
+}
+
+int report_capture_line_decode(const char *line, uint8_t *out, size_t out_size)
+{
+    const char *p = strstr(line, REPORT_CAPTURE_LINE_PREFIX);
+    if (p == NULL) {
+        return -1;
+    }
+    p += strlen(REPORT_CAPTURE_LINE_PREFIX);
+
+    size_t n = 0;
+    uint32_t acc = 0;
+    int bits = 0;
+    for (; *p != '\0' && *p != '='; p++) {
+        int v = b64_value(*p);
+        if (v < 0) {
+            break;                      // End of line, or log noise after it
+        }
+        acc = (acc << 6) | (uint32_t)v;
+        bits += 6;
+        if (bits >= 8) {
+            bits -= 8;
+            if (n >= out_size) {
+                return -1;
+            }
+            out[n++] = (uint8_t)(acc >> bits);
+        }
+    }
+    return (int)n;
+}
+
+/* ============================================================================
+ * RECORDER
+ * ============================================================================ */
+
+static report_capture_write_fn_t s_write;
+static void *s_write_ctx;
+static SemaphoreHandle_t s_lock;
+static int64_t s_last_ms;
+static uint8_t s_buf[REPORT_CAPTURE_BUF_RECORDS * REPORT_CAPTURE_REC_SIZE];
+static size_t s_buf_records;
+
+// Lock held
+static void flush_locked(void)
+{
+    if (s_buf_records == 0 || s_write == NULL) {
+        return;
+    }
+    esp_err_t ret = s_write(s_buf, s_buf_records * REPORT_CAPTURE_REC_SIZE, s_write_ctx);
+    s_buf_records = 0;
+    if (ret != ESP_OK) {
+        ESP_LOGW(TAG, "Sink failed (%s), capture stopped", esp_err_to_name(ret));
+        s_write = NULL;
+    }
+}
+
+static void record(const report_capture_event_t *ev, bool flush)
+{
+    if (s_write == NULL) {
+        return;
+    }
+
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    if (s_write != NULL) {
+        int64_t now_ms = node_hal_time_us() / 1000;
+        int64_t dt_ms = now_ms - s_last_ms;
+        if (dt_ms < 0) dt_ms = 0;
+        if (dt_ms > UINT32_MAX) dt_ms = UINT32_MAX;
+        s_last_ms = now_ms;
+
+        report_capture_encode(&s_buf[s_buf_records * REPORT_CAPTURE_REC_SIZE], (uint32_t)dt_ms, ev);
+        s_buf_records++;
+        if (flush || s_buf_records == REPORT_CAPTURE_BUF_RECORDS) {
+            flush_locked();
+        }
+    }
+    xSemaphoreGive(s_lock);
+}
+
+esp_err_t report_capture_start(report_capture_write_fn_t write, void *ctx, bool with_header)
+{
+    if (write == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (s_write != NULL) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    if (s_lock == NULL) {
+        s_lock = xSemaphoreCreateMutex();
+        if (s_lock == NULL) {
+            return ESP_ERR_NO_MEM;
+        }
+    }
+
+    if (with_header) {
+        uint8_t header[REPORT_CAPTURE_REC_SIZE];
+        report_capture_encode_header(header);
+        esp_err_t ret = write(header, sizeof(header), ctx);
+        if (ret != ESP_OK) {
+            return ret;
+        }
+    }
+
+    s_write_ctx = ctx;
+    s_last_ms = node_hal_time_us() / 1000;
+    s_buf_records = 0;
+    s_write = write;
+
+    report_capture_event_t boot = { .type = REPORT_CAPTURE_BOOT };
+    record(&boot, false);
+    ESP_LOGI(TAG, "Report capture started");
+    return ESP_OK;
+}
+
+void report_capture_stop(void)
+{
+    if (s_lock == NULL) {
+        return;
+    }
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    flush_locked();
+    s_write = NULL;
+    xSemaphoreGive(s_lock);         // Kept: a recorder may be waiting on it
+}
+
+bool report_capture_active(void)
+{
+    return s_write != NULL;
+}
+
+void report_capture_flush(void)
+{
+    if (s_write == NULL) {
+        return;
+    }
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    flush_locked();
+    xSemaphoreGive(s_lock);
+}
+
+void report_capture_report(uint16_t src, uint16_t attr_id, uint16_t value)
+{
+    report_capture_event_t ev = {
+        .type = REPORT_CAPTURE_REPORT, .src = src, .id = attr_id, .value = value,
+    };
+    record(&ev, false);
+}
+
+void report_capture_pump(bool on, uint8_t level_pct)
+{
+    report_capture_event_t ev = {
+        .type = REPORT_CAPTURE_PUMP, .arg = on ? 1 : 0, .value = level_pct,
+    };
+    record(&ev, true);
+}
+
+void report_capture_config(uint8_t on_pct, uint8_t off_pct, uint32_t timeout_sec)
+{
+    report_capture_event_t ev = {
+        .type = REPORT_CAPTURE_CONFIG, .arg = on_pct, .id = off_pct,
+        .value = (uint16_t)(timeout_sec > UINT16_MAX ? UINT16_MAX : timeout_sec),
+    };
+    record(&ev, false);
+}
+
+void report_capture_manual(uint8_t command, uint16_t duration_min)
+{
+    report_capture_event_t ev = {
+        .type = REPORT_CAPTURE_MANUAL, .arg = command, .value = duration_min,
+    };
+    record(&ev, true);
+}
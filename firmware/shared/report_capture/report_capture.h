@@ -0,0 +1,156 @@
+/*
+ * Report Capture
+ * Compact binary recording of what the controller receives and decides
+ * (sensor reports, pump transitions, config and manual commands), for
+ * replaying field behaviour through the controller logic on the host.
+ *
+ * Stream format (little-endian, 12-byte units):
+ *
+ *   header   "AQRC" | version | record size | 6 reserved
+ *   record   dt_ms:u32 | type:u8 | arg:u8 | src:u16 | id:u16 | value:u16
+ *
+ * dt_ms is the time since the previous record (capture start for the first),
+ * so captures run for months without wrapping. Each capture session starts
+ * with a BOOT record; sessions appended after a reboot may repeat the
+ * header, which readers skip.
+ *
+ * Over UART the stream is printed in base64 lines prefixed "AQRC:", so it
+ * survives being interleaved with the normal serial log: save the log and
+ * replay it as is (host/replay_host).
+ */
+
+#ifndef REPORT_CAPTURE_H
+#define REPORT_CAPTURE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "esp_err.h"
+
+/* ============================================================================
+ * FORMAT
+ * ============================================================================ */
+
+#define REPORT_CAPTURE_MAGIC        "AQRC"
+#define REPORT_CAPTURE_VERSION      1
+#define REPORT_CAPTURE_REC_SIZE     12
+#define REPORT_CAPTURE_LINE_PREFIX  "AQRC:"
+#define REPORT_CAPTURE_LINE_RECORDS 4       // Records per UART line (64 base64 chars)
+#define REPORT_CAPTURE_BUF_RECORDS  16      // Buffered before a sink write
+
+typedef enum {
+    REPORT_CAPTURE_BOOT = 1,        // Session start: controller state reset
+    REPORT_CAPTURE_REPORT,          // src = sender, id = attribute, value
+    REPORT_CAPTURE_PUMP,            // arg = 1 on / 0 off, value = level %
+    REPORT_CAPTURE_CONFIG,          // arg = ON %, id = OFF %, value = timeout s
+    REPORT_CAPTURE_MANUAL,          // arg = command, value = minutes
+} report_capture_type_t;
+
+typedef struct {
+    int64_t  t_ms;                  // Since the start of the stream
+    uint8_t  type;
+    uint8_t  arg;
+    uint16_t src;
+    uint16_t id;
+    uint16_t value;
+} report_capture_event_t;
+
+/* ============================================================================
+ * RECORDING
+ * ============================================================================ */
+
+/**
+ * Sink for encoded bytes (header and whole records only)
+ */
+typedef esp_err_t (*report_capture_write_fn_t)(const void *data, size_t len, void *ctx);
+
+/**
+ * Start a capture session into a sink
+ *
+ * @param with_header false when appending to a stream that has one
+ */
+esp_err_t report_capture_start(report_capture_write_fn_t write, void *ctx, bool with_header);
+
+/**
+ * Flush and stop; recording calls are no-ops afterwards
+ */
+void report_capture_stop(void);
+
+bool report_capture_active(void);
+
+// Recording calls, timestamped with node_hal_time_us(). Cheap no-ops while
+// no capture is active.
+void report_capture_report(uint16_t src, uint16_t attr_id, uint16_t value);
+void report_capture_pump(bool on, uint8_t level_pct);
+void report_capture_config(uint8_t on_pct, uint8_t off_pct, uint32_t timeout_sec);
+void report_capture_manual(uint8_t command, uint16_t duration_min);
+
+/**
+ * Hand buffered records to the sink (also done when the buffer fills and
+ * on every pump transition)
+ */
+void report_capture_flush(void);
+
+/* ============================================================================
+ * FIRMWARE SINKS (report_capture_esp.c)
+ * ============================================================================ */
+
+#define REPORT_CAPTURE_PARTITION    "capture"   // data partition, subtype 0x40
+
+/**
+ * Print records to the console as REPORT_CAPTURE_LINE_PREFIX lines
+ */
+esp_err_t report_capture_start_uart(void);
+
+/**
+ * Append to the capture partition, continuing a previous session's stream.
+ * Recording stops when the partition is full.
+ */
+esp_err_t report_capture_start_flash(void);
+
+/**
+ * Print the capture partition as UART lines (recording may continue)
+ */
+esp_err_t report_capture_dump_flash(void);
+
+esp_err_t report_capture_erase_flash(void);
+
+/* ============================================================================
+ * DECODING
+ * ============================================================================ */
+
+void report_capture_encode_header(uint8_t out[REPORT_CAPTURE_REC_SIZE]);
+bool report_capture_is_header(const uint8_t *rec);
+
+/**
+ * Encode a record; dt_ms is relative to the previous one
+ */
+void report_capture_encode(uint8_t out[REPORT_CAPTURE_REC_SIZE], uint32_t dt_ms,
+                           const report_capture_event_t *ev);
+
+/**
+ * Walk a binary stream. Skips headers; t_ms accumulates across records.
+ */
+typedef struct {
+    const uint8_t *data;
+    size_t   len;
+    size_t   pos;
+    int64_t  t_ms;
+} report_capture_reader_t;
+
+void report_capture_reader_init(report_capture_reader_t *r, const uint8_t *data, size_t len);
+
+/**
+ * @return false at the end of the stream (a trailing partial record is ignored)
+ */
+bool report_capture_next(report_capture_reader_t *r, report_capture_event_t *ev);
+
+/**
+ * Base64 line codec used by the UART sink. encode writes a NUL-terminated
+ * line with the prefix; decode accepts any text containing the prefix and
+ * returns the byte count, or -1 if the line holds no capture data.
+ */
+size_t report_capture_line_encode(const uint8_t *data, size_t len, char *out, size_t out_size);
+int report_capture_line_decode(const char *line, uint8_t *out, size_t out_size);
+
+#endif // REPORT_CAPTURE_H
@@ -0,0 +1,179 @@
+/*
+ * Report Capture - firmware sinks (UART console, flash partition)
+ */
+
+#include "report_capture.h"
+
+#include <stdio.h>
+#include <string.h>
+#include "esp_log.h"
+#include "esp_partition.h"
+
+static const char *TAG = "CAPTURE";
+
+#define PARTITION_SUBTYPE   0x40
+#define LINE_BYTES          (REPORT_CAPTURE_LINE_RECORDS * REPORT_CAPTURE_REC_SIZE)
+#define LINE_CHARS          (sizeof(REPORT_CAPTURE_LINE_PREFIX) + (LINE_BYTES + 2) / 3 * 4 + 1)
+
+/* ============================================================================
+ * UART
+ * ============================================================================ */
+
+static esp_err_t print_lines(const uint8_t *data, size_t len)
+{
+    char line[LINE_CHARS];
+    for (size_t off = 0; off < len; off += LINE_BYTES) {
+        size_t n = len - off < LINE_BYTES ? len - off : LINE_BYTES;
+        report_capture_line_encode(data + off, n, line, sizeof(line));
+        // Straight to the console: independent of log levels
+        printf("%s\n", line);
+    }
+    return ESP_OK;
+}
+
+static esp_err_t uart_write(const void *data, size_t len, void *ctx)
+{
+    (void)ctx;
+    return print_lines(data, len);
+}
+
+esp_err_t report_capture_start_uart(void)
+{
+    return report_capture_start(uart_write, NULL, true);
+}
+
+/* ============================================================================
+ * FLASH
+ * ============================================================================ */
+
+typedef struct {
+    const esp_partition_t *part;
+    size_t end;                         // Next write offset
+} flash_sink_t;
+
+static flash_sink_t s_flash;
+
+static const esp_partition_t *find_partition(void)
+{
+    return esp_partition_find_first(ESP_PARTITION_TYPE_DATA, PARTITION_SUBTYPE,
+                                    REPORT_CAPTURE_PARTITION);
+}
+
+// Erased flash reads 0xFF: the first all-0xFF record slot ends the stream
+static bool slot_erased(const esp_partition_t *part, size_t off)
+{
+    uint8_t rec[REPORT_CAPTURE_REC_SIZE];
+    if (esp_partition_read(part, off, rec, sizeof(rec)) != ESP_OK) {
+        return true;
+    }
+    for (size_t i = 0; i < sizeof(rec); i++) {
+        if (rec[i] != 0xFF) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static size_t find_end(const esp_partition_t *part)
+{
+    // Records are only ever appended: binary search for the first erased slot
+    size_t lo = 0;
+    size_t hi = part->size / REPORT_CAPTURE_REC_SIZE;
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+        if (slot_erased(part, mid * REPORT_CAPTURE_REC_SIZE)) {
+            hi = mid;
+        } else {
+            lo = mid + 1;
+        }
+    }
+    return lo * REPORT_CAPTURE_REC_SIZE;
+}
+
+static esp_err_t flash_write(const void *data, size_t len, void *ctx)
+{
+    flash_sink_t *sink = ctx;
+    size_t sector = sink->part->erase_size;
+
+    if (sink->end + len > sink->part->size) {
+        return ESP_ERR_NO_MEM;
+    }
+
+    // Erase sectors the write reaches into for the first time (everything
+    // from end up to its sector boundary is already erased)
+    size_t erased_to = (sink->end + sector - 1) / sector * sector;
+    if (sink->end + len > erased_to) {
+        size_t erase_len = (sink->end + len - erased_to + sector - 1) / sector * sector;
+        esp_err_t ret = esp_partition_erase_range(sink->part, erased_to, erase_len);
+        if (ret != ESP_OK) {
+            return ret;
+        }
+    }
+
+    esp_err_t ret = esp_partition_write(sink->part, sink->end, data, len);
+    if (ret == ESP_OK) {
+        sink->end += len;
+    }
+    return ret;
+}
+
+esp_err_t report_capture_start_flash(void)
+{
+    s_flash.part = find_partition();
+    if (s_flash.part == NULL) {
+        ESP_LOGW(TAG, "No '%s' partition", REPORT_CAPTURE_PARTITION);
+        return ESP_ERR_NOT_FOUND;
+    }
+
+    // A fresh partition may hold anything; only trust a stream with a header
+    uint8_t first[REPORT_CAPTURE_REC_SIZE];
+    esp_partition_read(s_flash.part, 0, first, sizeof(first));
+    bool resume = report_capture_is_header(first);
+    s_flash.end = resume ? find_end(s_flash.part) : 0;
+
+    ESP_LOGI(TAG, "Flash capture: %u of %lu bytes used",
+             (unsigned)s_flash.end, (unsigned long)s_flash.part->size);
+    return report_capture_start(flash_write, &s_flash, !resume);
+}
+
+esp_err_t report_capture_dump_flash(void)
+{
+    const esp_partition_t *part = find_partition();
+    if (part == NULL) {
+        return ESP_ERR_NOT_FOUND;
+    }
+
+    uint8_t first[REPORT_CAPTURE_REC_SIZE];
+    esp_partition_read(part, 0, first, sizeof(first));
+    if (!report_capture_is_header(first)) {
+        ESP_LOGI(TAG, "Capture partition empty");
+        return ESP_OK;
+    }
+
+    report_capture_flush();
+    size_t end = report_capture_active() && s_flash.part == part ? s_flash.end : find_end(part);
+    ESP_LOGI(TAG, "Dumping %u bytes of capture", (unsigned)end);
+
+    uint8_t chunk[LINE_BYTES * 4];
+    for (size_t off = 0; off < end; off += sizeof(chunk)) {
+        size_t n = end - off < sizeof(chunk) ? end - off : sizeof(chunk);
+        esp_err_t ret = esp_partition_read(part, off, chunk, n);
+        if (ret != ESP_OK) {
+            return ret;
+        }
+        print_lines(chunk, n);
+    }
+    return ESP_OK;
+}
+
+esp_err_t report_capture_erase_flash(void)
+{
+    const esp_partition_t *part = find_partition();
+    if (part == NULL) {
+        return ESP_ERR_NOT_FOUND;
+    }
+    if (report_capture_active() && s_flash.part == part) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    return esp_partition_erase_range(part, 0, part->size);
+}
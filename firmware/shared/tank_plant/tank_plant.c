@@ -0,0 +1,151 @@
+/*
+ * Tank and Pump Plant Model
+ */
+
+#include "tank_plant.h"
+
+#include <math.h>
+#include <stddef.h>
+
+#define SUBSTEP_US          1000000LL
+#define PLANT_PI            3.14159265f
+#define US_PER_HOUR         3600000000.0f
+
+/* ============================================================================
+ * HELPERS
+ * ============================================================================ */
+
+static uint32_t rng_next(tank_plant_t *p)
+{
+    // xorshift32: the same noise sequence on every platform
+    p->rng ^= p->rng << 13;
+    p->rng ^= p->rng >> 17;
+    p->rng ^= p->rng << 5;
+    return p->rng;
+}
+
+// Uniform in (0, 1]
+static float rng_unit(tank_plant_t *p)
+{
+    return (float)((rng_next(p) >> 8) + 1) / 16777216.0f;
+}
+
+// Standard normal (Box-Muller)
+static float rng_gauss(tank_plant_t *p)
+{
+    float u1 = rng_unit(p);
+    float u2 = rng_unit(p);
+    return sqrtf(-2.0f * logf(u1)) * cosf(2.0f * PLANT_PI * u2);
+}
+
+// Hours between two times of day, wrapped to [-12, 12)
+static float hours_from(float hour, float peak)
+{
+    return fmodf(hour - peak + 36.0f, 24.0f) - 12.0f;
+}
+
+/* ============================================================================
+ * API
+ * ============================================================================ */
+
+void tank_plant_init(tank_plant_t *plant, const tank_plant_config_t *cfg, int64_t now_us)
+{
+    const tank_plant_config_t defaults = TANK_PLANT_CONFIG_DEFAULT();
+    *plant = (tank_plant_t){ 0 };
+    plant->cfg = cfg != NULL ? *cfg : defaults;
+    if (plant->cfg.time_scale <= 0) {
+        plant->cfg.time_scale = 1;
+    }
+
+    float radius = plant->cfg.diameter_cm / 2.0f;
+    plant->litres_per_cm = PLANT_PI * radius * radius / 1000.0f;
+    plant->level_cm = plant->cfg.height_cm * plant->cfg.initial_pct / 100.0f;
+    plant->last_clock_us = now_us;
+    plant->rng = plant->cfg.seed != 0 ? plant->cfg.seed : 1;
+    plant->stats.min_cm = plant->stats.max_cm = plant->level_cm;
+}
+
+float tank_plant_demand_lph(const tank_plant_t *plant, int64_t plant_us)
+{
+    const tank_plant_config_t *c = &plant->cfg;
+    float hour = fmodf(c->start_hour + (float)plant_us / US_PER_HOUR, 24.0f);
+    float w = c->peak_width_h > 0 ? c->peak_width_h : 1.0f;
+    float dm = hours_from(hour, 7.0f) / w;
+    float de = hours_from(hour, 19.0f) / w;
+    return c->demand_base_lph +
+           c->demand_morning_lph * expf(-0.5f * dm * dm) +
+           c->demand_evening_lph * expf(-0.5f * de * de);
+}
+
+static void substep(tank_plant_t *p, int64_t dt_us)
+{
+    const tank_plant_config_t *c = &p->cfg;
+    tank_plant_stats_t *st = &p->stats;
+    float dt_h = (float)dt_us / US_PER_HOUR;
+
+    // Draw-off: only what sits above the outlet can leave through the taps
+    float want_l = tank_plant_demand_lph(p, p->plant_us + dt_us / 2) * dt_h;
+    float avail_l = (p->level_cm - c->outlet_cm) * p->litres_per_cm;
+    float used_l = want_l < avail_l ? want_l : (avail_l > 0 ? avail_l : 0);
+    st->consumed_l += used_l;
+    st->unmet_l += want_l - used_l;
+    p->level_cm -= used_l / p->litres_per_cm;
+
+    if (p->pump_on) {
+        st->pump_on_us += dt_us;
+        if (p->plant_us - p->pump_since_us >= (int64_t)(c->prime_s * 1e6f)) {
+            float in_l = c->inflow_lpm * 60.0f * dt_h;
+            float room_l = (c->height_cm - p->level_cm) * p->litres_per_cm;
+            if (in_l > room_l) {
+                st->spilled_l += in_l - room_l;
+                in_l = room_l;
+            }
+            st->delivered_l += in_l;
+            p->level_cm += in_l / p->litres_per_cm;
+        }
+    }
+
+    if (p->level_cm <= c->outlet_cm) st->dry_us += dt_us;
+    if (p->level_cm >= c->height_cm) st->full_us += dt_us;
+    if (p->level_cm < st->min_cm) st->min_cm = p->level_cm;
+    if (p->level_cm > st->max_cm) st->max_cm = p->level_cm;
+    p->plant_us += dt_us;
+}
+
+void tank_plant_step(tank_plant_t *plant, bool pump_on, int64_t now_us)
+{
+    int64_t remaining = (int64_t)((float)(now_us - plant->last_clock_us) * plant->cfg.time_scale);
+    plant->last_clock_us = now_us;
+    while (remaining > 0) {
+        int64_t dt = remaining < SUBSTEP_US ? remaining : SUBSTEP_US;
+        substep(plant, dt);
+        remaining -= dt;
+    }
+
+    if (pump_on && !plant->pump_on) {
+        plant->stats.pump_starts++;
+        plant->pump_since_us = plant->plant_us;
+    }
+    plant->pump_on = pump_on;
+}
+
+float tank_plant_level_pct(const tank_plant_t *plant)
+{
+    return plant->level_cm * 100.0f / plant->cfg.height_cm;
+}
+
+float tank_plant_echo_cm(void *ctx)
+{
+    tank_plant_t *p = ctx;
+    p->stats.pings++;
+    if (p->cfg.ping_fail_pct > 0 && rng_next(p) % 100 < p->cfg.ping_fail_pct) {
+        p->stats.ping_failures++;
+        return -1.0f;
+    }
+    // Matches the firmware's depth = height - distance - offset
+    float distance = p->cfg.height_cm - p->level_cm - p->cfg.sensor_offset_cm;
+    if (p->cfg.noise_cm > 0) {
+        distance += p->cfg.noise_cm * rng_gauss(p);
+    }
+    return distance > 0 ? distance : -1.0f;
+}
@@ -0,0 +1,126 @@
+/*
+ * Tank and Pump Plant Model
+ * Water tank physics for closing the loop around the firmware without a
+ * real tank: geometry, pump delivery, time-of-day consumption and an
+ * imperfect ultrasonic sensor. Plain C with no platform dependencies, so
+ * the host runners (firmware/host) and the test firmware share it.
+ */
+
+#ifndef TANK_PLANT_H
+#define TANK_PLANT_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/* ============================================================================
+ * CONFIGURATION
+ * ============================================================================ */
+
+typedef struct {
+    // Geometry
+    float    height_cm;
+    float    diameter_cm;
+    float    sensor_offset_cm;      // Sensor face below the top of the tank
+    float    outlet_cm;             // Taps run dry below this level
+    float    initial_pct;
+
+    // Pump
+    float    inflow_lpm;            // Delivery once the pipe is primed
+    float    prime_s;               // Running time before water arrives
+
+    // Consumption: base rate plus two daily peaks (Gaussian in time of day)
+    float    demand_base_lph;
+    float    demand_morning_lph;    // Extra at the peak, 07:00
+    float    demand_evening_lph;    // Extra at the peak, 19:00
+    float    peak_width_h;          // Standard deviation of each peak
+    float    start_hour;            // Time of day at t = 0
+
+    // Sensor
+    float    noise_cm;              // Standard deviation per ping
+    uint8_t  ping_fail_pct;         // Pings that get no echo
+    uint32_t seed;
+
+    float    time_scale;            // Plant seconds per clock second
+} tank_plant_config_t;
+
+// 200 x 100 cm tank (~1570 l), ~6000 l/day household, 20 l/min pump
+#define TANK_PLANT_CONFIG_DEFAULT() {   \
+    .height_cm = 200,                   \
+    .diameter_cm = 100,                 \
+    .sensor_offset_cm = 0,              \
+    .outlet_cm = 5,                     \
+    .initial_pct = 50,                  \
+    .inflow_lpm = 20,                   \
+    .prime_s = 10,                      \
+    .demand_base_lph = 120,             \
+    .demand_morning_lph = 600,          \
+    .demand_evening_lph = 450,          \
+    .peak_width_h = 1.0f,               \
+    .start_hour = 0,                    \
+    .noise_cm = 0.5f,                   \
+    .ping_fail_pct = 2,                 \
+    .seed = 1,                          \
+    .time_scale = 1,                    \
+}
+
+/* ============================================================================
+ * STATE
+ * ============================================================================ */
+
+typedef struct {
+    float    min_cm;
+    float    max_cm;
+    uint32_t pump_starts;
+    int64_t  pump_on_us;            // Relay closed
+    int64_t  dry_us;                // Level below the outlet
+    int64_t  full_us;               // Level at the top, inflow spilling
+    float    delivered_l;
+    float    consumed_l;
+    float    unmet_l;               // Demand while dry
+    float    spilled_l;
+    uint32_t pings;
+    uint32_t ping_failures;
+} tank_plant_stats_t;
+
+typedef struct {
+    tank_plant_config_t cfg;
+    float    litres_per_cm;
+    float    level_cm;
+    bool     pump_on;
+    int64_t  pump_since_us;         // Plant time the relay last closed
+    int64_t  plant_us;              // Plant time (clock time x time_scale)
+    int64_t  last_clock_us;
+    uint32_t rng;
+    tank_plant_stats_t stats;
+} tank_plant_t;
+
+/* ============================================================================
+ * API
+ * ============================================================================ */
+
+/**
+ * @param cfg NULL for TANK_PLANT_CONFIG_DEFAULT()
+ * @param now_us Clock time the model starts at
+ */
+void tank_plant_init(tank_plant_t *plant, const tank_plant_config_t *cfg, int64_t now_us);
+
+/**
+ * Integrate up to now_us, then take the relay state for the next interval.
+ * Any call rate works: the model sub-steps at 1 s of plant time.
+ */
+void tank_plant_step(tank_plant_t *plant, bool pump_on, int64_t now_us);
+
+/**
+ * Consumption at a plant time, litres per hour
+ */
+float tank_plant_demand_lph(const tank_plant_t *plant, int64_t plant_us);
+
+float tank_plant_level_pct(const tank_plant_t *plant);
+
+/**
+ * What the ultrasonic sensor sees: distance to the surface in cm with noise,
+ * or -1 for a missed echo. Same signature as node_hal_echo_fn_t.
+ */
+float tank_plant_echo_cm(void *plant);
+
+#endif // TANK_PLANT_H
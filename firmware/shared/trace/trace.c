@@ -0,0 +1,335 @@
+/*
+ * Event Trace - ring buffer, formatting and stream codec
+ * Platform-independent: the host build and the native tests use it as is.
+ */
+
+#include "trace.h"
+
+#include <stdio.h>
+#include <string.h>
+#include "esp_timer.h"
+
+/* ============================================================================
+ * EVENT TABLE
+ * ============================================================================ */
+
+#define EVENT_NAME_OF(id, kind, tag, format)    [TRACE_##id] = #id,
+#define EVENT_KIND_OF(id, kind, tag, format)    [TRACE_##id] = TRACE_KIND_##kind,
+#define TAG_OF(id, kind, tag, format)           [TRACE_##id] = tag,
+#define FORMAT_OF(id, kind, tag, format)        [TRACE_##id] = format,
+static const char *const s_event_name[TRACE_EVENT_COUNT] = { TRACE_EVENTS(EVENT_NAME_OF) };
+static const uint8_t s_event_kind[TRACE_EVENT_COUNT] = { TRACE_EVENTS(EVENT_KIND_OF) };
+static const char *const s_tag[TRACE_EVENT_COUNT] = { TRACE_EVENTS(TAG_OF) };
+static const char *const s_format[TRACE_EVENT_COUNT] = { TRACE_EVENTS(FORMAT_OF) };
+
+_Static_assert((TRACE_RING_SLOTS & (TRACE_RING_SLOTS - 1)) == 0, "ring size must be a power of two");
+_Static_assert(TRACE_EVENT_COUNT <= 256, "event ids are one byte on the wire");
+
+/* ============================================================================
+ * RING
+ * ============================================================================ */
+
+/*
+ * Producers claim a slot by incrementing s_head, fill it and publish it by
+ * storing claim + 1 in seq. The consumer (s_tail, one drain at a time) takes
+ * a slot only when seq matches; a larger seq means producers lapped it.
+ * Nothing blocks: when the consumer falls behind, the oldest events are
+ * overwritten and counted as dropped.
+ */
+typedef struct {
+    uint32_t seq;               // Claim index + 1 once published
+    trace_event_t ev;
+} trace_slot_t;
+
+static trace_slot_t s_ring[TRACE_RING_SLOTS];
+static uint32_t s_head;         // Next claim (producers, atomic)
+static uint32_t s_tail;         // Next to drain (consumer only)
+static uint32_t s_lost;         // Dropped, not reported yet (consumer only)
+static uint32_t s_dropped;      // Total (consumer writes, anyone reads)
+static uint32_t s_named[256 / 32];  // Tasks announced by trace_drain_named (consumer only)
+
+void trace_emit(trace_id_t id, const int32_t *args, int nargs)
+{
+    uint32_t claim = __atomic_fetch_add(&s_head, 1, __ATOMIC_RELAXED);
+    trace_slot_t *slot = &s_ring[claim & (TRACE_RING_SLOTS - 1)];
+
+    __atomic_store_n(&slot->seq, 0, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    if (nargs > TRACE_MAX_ARGS) {
+        nargs = TRACE_MAX_ARGS;
+    }
+    slot->ev.t_us = (uint32_t)esp_timer_get_time();
+    slot->ev.id = (uint8_t)id;
+    slot->ev.task = trace_port_task();
+    slot->ev.nargs = (uint8_t)nargs;
+    for (int i = 0; i < nargs; i++) {
+        slot->ev.arg[i] = args[i];
+    }
+    __atomic_store_n(&slot->seq, claim + 1, __ATOMIC_RELEASE);
+}
+
+static void emit_lost(trace_sink_fn_t sink, void *ctx)
+{
+    trace_event_t ev = {
+        .id = TRACE_DROPPED,
+        .nargs = 1,
+        .arg = { (int32_t)s_lost },
+    };
+    // Stamped now: the lost events were between the last drained and the next
+    ev.t_us = (uint32_t)esp_timer_get_time();
+    __atomic_fetch_add(&s_dropped, s_lost, __ATOMIC_RELAXED);
+    s_lost = 0;
+    sink(&ev, ctx);
+}
+
+size_t trace_drain(trace_sink_fn_t sink, void *ctx, size_t max)
+{
+    size_t n = 0;
+    size_t handed = 0;
+    uint32_t head = __atomic_load_n(&s_head, __ATOMIC_ACQUIRE);
+    if (head - s_tail > TRACE_RING_SLOTS) {
+        s_lost += head - TRACE_RING_SLOTS - s_tail;
+        s_tail = head - TRACE_RING_SLOTS;
+    }
+
+    while (s_tail != head && n < max) {
+        trace_slot_t *slot = &s_ring[s_tail & (TRACE_RING_SLOTS - 1)];
+        uint32_t want = s_tail + 1;
+        uint32_t seq = __atomic_load_n(&slot->seq, __ATOMIC_ACQUIRE);
+        if (seq != want) {
+            if ((int32_t)(seq - want) > 0) {
+                s_lost++;               // Lapped before we got here
+                s_tail++;
+                continue;
+            }
+            break;                      // Claimed, still being written
+        }
+
+        trace_event_t ev = slot->ev;
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+        if (__atomic_load_n(&slot->seq, __ATOMIC_RELAXED) != want) {
+            s_lost++;                   // Overwritten while copying
+            s_tail++;
+            continue;
+        }
+        s_tail++;
+
+        if (s_lost > 0) {
+            emit_lost(sink, ctx);
+            handed++;
+        }
+        sink(&ev, ctx);
+        handed++;
+        n++;
+    }
+    if (s_lost > 0) {
+        emit_lost(sink, ctx);
+        handed++;
+    }
+    return handed;
+}
+
+typedef struct {
+    trace_sink_fn_t sink;
+    void *ctx;
+} named_sink_t;
+
+static void named_sink(const trace_event_t *ev, void *ctx)
+{
+    const named_sink_t *named = ctx;
+    uint32_t bit = 1u << (ev->task % 32);
+    if (ev->task != 0 && !(s_named[ev->task / 32] & bit)) {
+        s_named[ev->task / 32] |= bit;
+        const char *name = trace_port_task_name(ev->task);
+        if (name != NULL) {
+            trace_event_t meta = { .t_us = ev->t_us, .task = ev->task };
+            trace_task_name_pack(&meta, ev->task, name);
+            named->sink(&meta, named->ctx);
+        }
+    }
+    named->sink(ev, named->ctx);
+}
+
+size_t trace_drain_named(trace_sink_fn_t sink, void *ctx, size_t max)
+{
+    named_sink_t named = { .sink = sink, .ctx = ctx };
+    return trace_drain(named_sink, &named, max);
+}
+
+void trace_reset(void)
+{
+    s_tail = __atomic_load_n(&s_head, __ATOMIC_ACQUIRE);
+    s_lost = 0;
+    memset(s_named, 0, sizeof(s_named));
+    __atomic_store_n(&s_dropped, 0, __ATOMIC_RELAXED);
+}
+
+void trace_get_stats(trace_stats_t *stats)
+{
+    stats->emitted = __atomic_load_n(&s_head, __ATOMIC_RELAXED);
+    stats->dropped = __atomic_load_n(&s_dropped, __ATOMIC_RELAXED);
+}
+
+/* ============================================================================
+ * FORMATTING
+ * ============================================================================ */
+
+const char *trace_event_tag(uint8_t id)
+{
+    return id < TRACE_EVENT_COUNT ? s_tag[id] : "TRACE";
+}
+
+const char *trace_event_name(uint8_t id)
+{
+    return id < TRACE_EVENT_COUNT ? s_event_name[id] : "UNKNOWN";
+}
+
+trace_kind_t trace_event_kind(uint8_t id)
+{
+    return id < TRACE_EVENT_COUNT ? (trace_kind_t)s_event_kind[id] : TRACE_KIND_LOG;
+}
+
+void trace_task_name_pack(trace_event_t *ev, uint8_t number, const char *name)
+{
+    memset(ev->arg, 0, sizeof(ev->arg));
+    ev->id = TRACE_TASK_NAME;
+    ev->nargs = TRACE_MAX_ARGS;
+    ev->arg[0] = number;
+    for (int i = 0; i < TRACE_TASK_NAME_LEN && name[i] != '\0'; i++) {
+        ev->arg[1 + i / 4] |= (int32_t)((uint32_t)(uint8_t)name[i] << (8 * (i % 4)));
+    }
+}
+
+void trace_task_name(const trace_event_t *ev, char *name)
+{
+    int n = 0;
+    for (int i = 0; i < TRACE_TASK_NAME_LEN && 1 + i / 4 < ev->nargs; i++) {
+        char c = (char)((uint32_t)ev->arg[1 + i / 4] >> (8 * (i % 4)));
+        if (c == '\0') {
+            break;
+        }
+        name[n++] = c;
+    }
+    name[n] = '\0';
+}
+
+int trace_format(const trace_event_t *ev, char *buf, size_t len)
+{
+    long a[TRACE_MAX_ARGS] = { 0 };
+    for (int i = 0; i < ev->nargs && i < TRACE_MAX_ARGS; i++) {
+        a[i] = ev->arg[i];
+    }
+    int n;
+    if (ev->id < TRACE_EVENT_COUNT) {
+        n = snprintf(buf, len, s_format[ev->id], a[0], a[1], a[2], a[3]);
+    } else {
+        n = snprintf(buf, len, "event %u: %ld %ld %ld %ld", ev->id, a[0], a[1], a[2], a[3]);
+    }
+    if (n < 0) {
+        n = 0;
+    }
+    return (size_t)n < len ? n : (int)(len > 0 ? len - 1 : 0);
+}
+
+/* ============================================================================
+ * STREAM CODEC
+ * ============================================================================ */
+
+static void store_le32(uint8_t *p, uint32_t v)
+{
+    p[0] = (uint8_t)v;
+    p[1] = (uint8_t)(v >> 8);
+    p[2] = (uint8_t)(v >> 16);
+    p[3] = (uint8_t)(v >> 24);
+}
+
+static uint32_t load_le32(const uint8_t *p)
+{
+    return p[0] | (p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+size_t trace_encode(const trace_event_t *ev, uint8_t *out)
+{
+    int nargs = ev->nargs > TRACE_MAX_ARGS ? TRACE_MAX_ARGS : ev->nargs;
+    store_le32(out, ev->t_us);
+    out[4] = ev->id;
+    out[5] = ev->task;
+    out[6] = (uint8_t)nargs;
+    for (int i = 0; i < nargs; i++) {
+        store_le32(out + TRACE_REC_HEADER_SIZE + 4 * i, (uint32_t)ev->arg[i]);
+    }
+    return TRACE_REC_HEADER_SIZE + 4 * (size_t)nargs;
+}
+
+size_t trace_decode(const uint8_t *data, size_t len, trace_event_t *ev)
+{
+    if (len < TRACE_REC_HEADER_SIZE || data[6] > TRACE_MAX_ARGS) {
+        return 0;
+    }
+    size_t size = TRACE_REC_HEADER_SIZE + 4 * (size_t)data[6];
+    if (len < size) {
+        return 0;
+    }
+    memset(ev, 0, sizeof(*ev));
+    ev->t_us = load_le32(data);
+    ev->id = data[4];
+    ev->task = data[5];
+    ev->nargs = data[6];
+    for (int i = 0; i < ev->nargs; i++) {
+        ev->arg[i] = (int32_t)load_le32(data + TRACE_REC_HEADER_SIZE + 4 * i);
+    }
+    return size;
+}
+
+/* ============================================================================
+ * LINE CODEC
+ * ============================================================================ */
+
+size_t trace_line_encode(const uint8_t *data, size_t len, char *out, size_t out_size)
+{
+    static const char hex[] = "0123456789abcdef";
+    size_t prefix = sizeof(TRACE_LINE_PREFIX) - 1;
+    if (out_size < prefix + 2 * len + 1) {
+        return 0;
+    }
+    memcpy(out, TRACE_LINE_PREFIX, prefix);
+    char *p = out + prefix;
+    for (size_t i = 0; i < len; i++) {
+        *p++ = hex[data[i] >> 4];
+        *p++ = hex[data[i] & 0x0F];
+    }
+    *p = '\0';
+    return (size_t)(p - out);
+}
+
+static int hex_value(char c)
+{
+    if (c >= '0' && c <= '9') return c - '0';
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+    return -1;
+}
+
+int trace_line_decode(const char *line, uint8_t *out, size_t out_size)
+{
+    const char *p = strstr(line, TRACE_LINE_PREFIX);
+    if (p == NULL) {
+        return -1;
+    }
+    p += sizeof(TRACE_LINE_PREFIX) - 1;
+
+    size_t n = 0;
+    for (;;) {
+        int hi = hex_value(p[0]);
+        int lo = hi < 0 ? -1 : hex_value(p[1]);
+        if (lo < 0) {
+            break;
+        }
+        if (n == out_size) {
+            return -1;
+        }
+        out[n++] = (uint8_t)(hi << 4 | lo);
+        p += 2;
+    }
+    return (int)n;
+}
@@ -0,0 +1,212 @@
+/*
+ * Event Trace
+ * Binary trace points for hot paths (report reception, pump decisions,
+ * sensor readings): a trace point stores an event id, a timestamp and up to
+ * four integer arguments in a lock-free RAM ring. Formatting happens later,
+ * in a low-priority drain task (trace_start_task) or on a host from the
+ * binary stream (host/trace_decode).
+ *
+ * Every event is declared once in TRACE_EVENTS with its kind, the log tag
+ * and the printf format its line used to have; arguments are passed as
+ * long, so formats use %ld / %lu / %lx only. LOG events are what the drain
+ * task prints; the other kinds only feed timeline exports
+ * (host/trace_export): spans are an event declared right before its _END
+ * event, ASYNC spans may overlap and are matched on their first argument.
+ *
+ * Stream format (little-endian, one record per event):
+ *
+ *   record   t_us:u32 | id:u8 | task:u8 | nargs:u8 | arg:i32 x nargs
+ *
+ * task is the FreeRTOS task number of the emitting task (0 outside a task);
+ * TASK_NAME events map numbers to names. t_us wraps every ~71 minutes;
+ * readers unwrap it assuming records are in order and less than one wrap
+ * apart. Over UART the stream is printed in hex lines prefixed "AQTR:" that
+ * survive interleaving with the normal log.
+ */
+
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "esp_err.h"
+
+/* ============================================================================
+ * EVENTS
+ * ============================================================================ */
+
+typedef enum {
+    TRACE_KIND_LOG = 0,         // Log line; instant on a timeline
+    TRACE_KIND_INSTANT,         // Timeline only
+    TRACE_KIND_META,            // Describes the trace itself
+    TRACE_KIND_BEGIN,           // Span on the emitting task
+    TRACE_KIND_END,
+    TRACE_KIND_ASYNC_BEGIN,     // Span that may overlap others, id in arg 0
+    TRACE_KIND_ASYNC_END,
+} trace_kind_t;
+
+// X(id, kind, tag, format); ids are wire ids, append only
+#define TRACE_EVENTS(X)                                                                     \
+    X(DROPPED,      LOG,     "TRACE",    "%ld events lost (ring full)")                     \
+    X(PUMP_ON,      LOG,     "PUMP",     ">>> PUMP ON <<< Water level: %ld%%")              \
+    X(PUMP_OFF,     LOG,     "PUMP",     ">>> PUMP OFF <<< Runtime: %lu seconds")           \
+    X(WATER_LOW,    LOG,     "PUMP",     "Water LOW (%ld%% <= %ld%%), pump ON")             \
+    X(WATER_HIGH,   LOG,     "PUMP",     "Water HIGH (%ld%% >= %ld%%), pump OFF")           \
+    X(WATER_LEVEL,  LOG,     "WATER_LEVEL", "Water Level: %ld%% (%ld cm, %lu L)")           \
+    X(REPORT_RX,    LOG,     "REPORT",   "Report from 0x%04lx - Water: %ld%%")              \
+    X(LEVEL_WRITE,  LOG,     "REPORT",   "Received water level: %ld%%")                     \
+    X(CTRL_STATUS,  LOG,     "CONTROLLER", "Water=%ld%%, Pump on=%ld, Sensor online=%ld")   \
+    X(TASK_NAME,    META,    "TRACE",    "Task %ld")                                        \
+    X(MEASURE,      ASYNC_BEGIN, "WATER_LEVEL", "Measurement %ld")                          \
+    X(MEASURE_END,  ASYNC_END, "WATER_LEVEL", "Measurement %ld: ok=%ld, %ld%%")             \
+    X(CONTROL_PASS, BEGIN,   "PUMP",     "Control pass, water %ld%%")                       \
+    X(CONTROL_PASS_END, END, "PUMP",     "Pump on=%ld")                                     \
+    X(ZB_CALLBACK,  BEGIN,   "ZIGBEE",   "Action callback 0x%lx")                           \
+    X(ZB_CALLBACK_END, END,  "ZIGBEE",   "Callback returned %ld")                           \
+    X(BLE_CONNECT,  INSTANT, "BLE_PROV", "Connected, provisioned=%ld")                      \
+    X(BLE_DISCONNECT, INSTANT, "BLE_PROV", "Disconnected, advertise=%ld")                   \
+    X(BLE_WRITE,    INSTANT, "BLE_PROV", "Config write, %ld bytes")
+
+typedef enum {
+#define TRACE_ENUM(id, kind, tag, format) TRACE_##id,
+    TRACE_EVENTS(TRACE_ENUM)
+#undef TRACE_ENUM
+    TRACE_EVENT_COUNT
+} trace_id_t;
+
+#define TRACE_MAX_ARGS          4
+#define TRACE_RING_SLOTS        128         // Power of two; 28 bytes each
+#define TRACE_REC_HEADER_SIZE   7
+#define TRACE_REC_MAX_SIZE      (TRACE_REC_HEADER_SIZE + 4 * TRACE_MAX_ARGS)
+#define TRACE_LINE_PREFIX       "AQTR:"
+#define TRACE_TEXT_MAX          96          // Formatted event, NUL included
+
+typedef struct {
+    uint32_t t_us;
+    uint8_t  id;
+    uint8_t  task;              // FreeRTOS task number, 0 outside a task
+    uint8_t  nargs;
+    int32_t  arg[TRACE_MAX_ARGS];
+} trace_event_t;
+
+/* ============================================================================
+ * TRACE POINTS (any context, never block)
+ * ============================================================================ */
+
+/**
+ * Record an event: TRACE(PUMP_ON, level). At least one argument, at most
+ * TRACE_MAX_ARGS; extra ones are dropped.
+ */
+#define TRACE(id, ...)                                                      \
+    trace_emit(TRACE_##id, (const int32_t[]){ __VA_ARGS__ },                \
+               sizeof((const int32_t[]){ __VA_ARGS__ }) / sizeof(int32_t))
+
+void trace_emit(trace_id_t id, const int32_t *args, int nargs);
+
+/**
+ * Port (trace_task.c, stubbed by the native tests): number of the calling
+ * task, 0 outside a task, and the name of a task number, NULL if unknown
+ */
+uint8_t trace_port_task(void);
+const char *trace_port_task_name(uint8_t number);
+
+/* ============================================================================
+ * DRAINING (one consumer)
+ * ============================================================================ */
+
+typedef void (*trace_sink_fn_t)(const trace_event_t *ev, void *ctx);
+
+/**
+ * Hand up to max recorded events to a sink, oldest first. Events the
+ * producers overwrote before they were drained are reported as one
+ * TRACE_DROPPED event in their place (not counted against max).
+ *
+ * @return Events handed over, DROPPED included
+ */
+size_t trace_drain(trace_sink_fn_t sink, void *ctx, size_t max);
+
+/**
+ * trace_drain() for exports: the first event from each task since the last
+ * trace_reset() is preceded by a TASK_NAME event for it (not counted
+ * against max). Tasks already deleted stay unnamed.
+ */
+size_t trace_drain_named(trace_sink_fn_t sink, void *ctx, size_t max);
+
+/**
+ * Discard everything recorded (tests, benchmarks)
+ */
+void trace_reset(void);
+
+typedef struct {
+    uint32_t emitted;
+    uint32_t dropped;
+} trace_stats_t;
+
+void trace_get_stats(trace_stats_t *stats);
+
+/* ============================================================================
+ * FORMATTING AND CODEC
+ * ============================================================================ */
+
+const char *trace_event_tag(uint8_t id);
+const char *trace_event_name(uint8_t id);          // "PUMP_ON"
+trace_kind_t trace_event_kind(uint8_t id);         // LOG for unknown ids
+
+/**
+ * Task name packed into / carried by a TASK_NAME event: args are the task
+ * number, then the name four characters per argument, little-endian,
+ * truncated to TRACE_TASK_NAME_LEN
+ * @param name At least TRACE_TASK_NAME_LEN + 1 bytes
+ */
+#define TRACE_TASK_NAME_LEN     12
+void trace_task_name_pack(trace_event_t *ev, uint8_t number, const char *name);
+void trace_task_name(const trace_event_t *ev, char *name);
+
+/**
+ * Format an event with its table format (NUL-terminated, truncated to len)
+ * @return Characters written, excluding the NUL
+ */
+int trace_format(const trace_event_t *ev, char *buf, size_t len);
+
+/**
+ * Encode one record
+ * @param out At least TRACE_REC_MAX_SIZE bytes
+ * @return Bytes written
+ */
+size_t trace_encode(const trace_event_t *ev, uint8_t *out);
+
+/**
+ * Decode one record from a stream
+ * @return Bytes consumed, 0 if the data holds no complete record
+ */
+size_t trace_decode(const uint8_t *data, size_t len, trace_event_t *ev);
+
+/**
+ * Hex line codec for the UART output. encode writes a NUL-terminated line
+ * with the prefix; decode accepts any text containing the prefix and
+ * returns the byte count, or -1 if the line holds no trace data.
+ */
+size_t trace_line_encode(const uint8_t *data, size_t len, char *out, size_t out_size);
+int trace_line_decode(const char *line, uint8_t *out, size_t out_size);
+
+/* ============================================================================
+ * DRAIN TASK (trace_task.c)
+ * ============================================================================ */
+
+typedef enum {
+    TRACE_OUTPUT_LOG = 0,       // Formatted ESP_LOGI lines under the event tag
+    TRACE_OUTPUT_LINES,         // Binary AQTR: lines, formatted by host/trace_decode
+} trace_output_t;
+
+#define TRACE_DRAIN_PERIOD_MS   100
+#define TRACE_LINE_RECORDS      4           // Records per UART line at most
+
+/**
+ * Start the drain task
+ * @param priority Below every task that traces (tskIDLE_PRIORITY + 1)
+ * @return ESP_OK, ESP_ERR_INVALID_STATE if already running
+ */
+esp_err_t trace_start_task(trace_output_t output, unsigned priority);
+
+#endif // TRACE_H
@@ -0,0 +1,156 @@
+/*
+ * Event Trace - FreeRTOS port and drain task (formatted log lines or binary
+ * UART lines)
+ */
+
+#include "trace.h"
+
+#include <stdio.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_log.h"
+
+static const char *TAG = "TRACE";
+
+#define DRAIN_BATCH     32      // Events per sink pass before yielding
+#define LINE_BYTES      (TRACE_LINE_RECORDS * TRACE_REC_MAX_SIZE)
+#define LINE_CHARS      (sizeof(TRACE_LINE_PREFIX) + 2 * LINE_BYTES)
+
+#define NAMED_TASKS_MAX 32      // Tasks a name lookup can see
+
+static TaskHandle_t s_task = NULL;
+static trace_output_t s_output;
+
+/* ============================================================================
+ * PORT
+ * ============================================================================ */
+
+#if configUSE_TRACE_FACILITY
+static uint32_t s_task_numbers;     // Trace numbers handed out (atomic)
+#endif
+
+/*
+ * Tasks are numbered with the trace-facility task number, which FreeRTOS
+ * leaves at 0 for the application: the first event of a task assigns it.
+ * Numbers past 255 wrap and share a track.
+ */
+uint8_t trace_port_task(void)
+{
+#if configUSE_TRACE_FACILITY
+    // From an ISR this is the interrupted task; NULL before the scheduler runs
+    TaskHandle_t task = xTaskGetCurrentTaskHandle();
+    if (task == NULL) {
+        return 0;
+    }
+    UBaseType_t number = uxTaskGetTaskNumber(task);
+    if (number == 0) {
+        number = __atomic_add_fetch(&s_task_numbers, 1, __ATOMIC_RELAXED);
+        if ((uint8_t)number == 0) {
+            number = __atomic_add_fetch(&s_task_numbers, 1, __ATOMIC_RELAXED);
+        }
+        vTaskSetTaskNumber(task, number);
+    }
+    return (uint8_t)number;
+#else
+    return 0;
+#endif
+}
+
+const char *trace_port_task_name(uint8_t number)
+{
+#if configUSE_TRACE_FACILITY
+    // Rare (first event of each task): a snapshot of every task is fine
+    static TaskStatus_t status[NAMED_TASKS_MAX];
+    UBaseType_t count = uxTaskGetSystemState(status, NAMED_TASKS_MAX, NULL);
+    for (UBaseType_t i = 0; i < count; i++) {
+        if ((uint8_t)uxTaskGetTaskNumber(status[i].xHandle) == number) {
+            return status[i].pcTaskName;
+        }
+    }
+#endif
+    (void)number;
+    return NULL;
+}
+
+/* ============================================================================
+ * SINKS
+ * ============================================================================ */
+
+static void log_sink(const trace_event_t *ev, void *ctx)
+{
+    (void)ctx;
+    if (trace_event_kind(ev->id) != TRACE_KIND_LOG) {
+        return;     // Spans and markers are for timeline exports
+    }
+    char text[TRACE_TEXT_MAX];
+    trace_format(ev, text, sizeof(text));
+    // Drained up to TRACE_DRAIN_PERIOD_MS late: keep the event's own time
+    ESP_LOGI(trace_event_tag(ev->id), "%s (t=%lu ms)", text, (unsigned long)(ev->t_us / 1000));
+}
+
+typedef struct {
+    uint8_t data[LINE_BYTES];
+    size_t  len;
+    int     records;
+} line_buf_t;
+
+static void line_flush(line_buf_t *line)
+{
+    if (line->len == 0) {
+        return;
+    }
+    char text[LINE_CHARS];
+    trace_line_encode(line->data, line->len, text, sizeof(text));
+    // Straight to the console: independent of log levels
+    printf("%s\n", text);
+    line->len = 0;
+    line->records = 0;
+}
+
+static void line_sink(const trace_event_t *ev, void *ctx)
+{
+    line_buf_t *line = ctx;
+    line->len += trace_encode(ev, line->data + line->len);
+    if (++line->records == TRACE_LINE_RECORDS) {
+        line_flush(line);
+    }
+}
+
+/* ============================================================================
+ * TASK
+ * ============================================================================ */
+
+static void drain_task(void *arg)
+{
+    (void)arg;
+    line_buf_t line = { .len = 0 };
+    for (;;) {
+        size_t n;
+        if (s_output == TRACE_OUTPUT_LINES) {
+            n = trace_drain_named(line_sink, &line, DRAIN_BATCH);
+            line_flush(&line);
+        } else {
+            n = trace_drain(log_sink, NULL, DRAIN_BATCH);
+        }
+        // A full batch means more is waiting: let equal priorities run first
+        if (n >= DRAIN_BATCH) {
+            taskYIELD();
+        } else {
+            vTaskDelay(pdMS_TO_TICKS(TRACE_DRAIN_PERIOD_MS));
+        }
+    }
+}
+
+esp_err_t trace_start_task(trace_output_t output, unsigned priority)
+{
+    if (s_task != NULL) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    s_output = output;
+    if (xTaskCreate(drain_task, "trace", 3072, NULL, priority, &s_task) != pdPASS) {
+        ESP_LOGE(TAG, "Failed to create drain task");
+        s_task = NULL;
+        return ESP_ERR_NO_MEM;
+    }
+    return ESP_OK;
+}
@@ -0,0 +1,187 @@
+/*
+ * Zigbee Instrumentation - lock and callback wrappers
+ * Platform-independent; on the host the stack is zb_sim.c.
+ */
+
+#include "zb_instr.h"
+
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "esp_zigbee_core.h"
+#include "metrics.h"
+
+static const char *TAG = "ZB_INSTR";
+
+#define SITE_NAME_OF(id, name) [ZB_LOCK_SITE_##id] = name,
+static const char *const s_site_name[ZB_LOCK_SITE_COUNT] = { ZB_INSTR_LOCK_SITES(SITE_NAME_OF) };
+#define CB_NAME_OF(id, name) [ZB_CB_##id] = name,
+static const char *const s_cb_name[ZB_CB_COUNT] = { ZB_INSTR_CALLBACKS(CB_NAME_OF) };
+
+// Updated with __atomic builtins only: several stacks share them on the host
+static zb_instr_stats_t s_site[ZB_LOCK_SITE_COUNT];
+static zb_instr_stats_t s_cb[ZB_CB_COUNT];
+// Last warning per site; a lost race only costs a duplicate warning
+static int64_t s_site_warned_us[ZB_LOCK_SITE_COUNT];
+static int64_t s_cb_warned_us[ZB_CB_COUNT];
+
+static uint32_t clamp_us(int64_t us)
+{
+    return us < 0 ? 0 : us > UINT32_MAX ? UINT32_MAX : (uint32_t)us;
+}
+
+static void update_max(uint32_t *max, uint32_t v)
+{
+    uint32_t cur = __atomic_load_n(max, __ATOMIC_RELAXED);
+    while (v > cur && !__atomic_compare_exchange_n(max, &cur, v, true,
+                                                   __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+    }
+}
+
+// Count an overrun in st and the fleet counter; true if it should be logged now
+static bool over_budget(zb_instr_stats_t *st, metric_id_t counter,
+                        int64_t *warned_us, int64_t now_us)
+{
+    __atomic_fetch_add(&st->over_budget, 1, __ATOMIC_RELAXED);
+    metrics_inc(counter);
+    int64_t last_us = *warned_us;
+    if (last_us != 0 && now_us - last_us < ZB_INSTR_WARN_INTERVAL_US) {
+        return false;
+    }
+    *warned_us = now_us;
+    return true;
+}
+
+/* ============================================================================
+ * LOCK
+ * ============================================================================ */
+
+zb_lock_held_t zb_instr_lock(zb_lock_site_t site)
+{
+    int64_t start_us = esp_timer_get_time();
+    esp_zb_lock_acquire(portMAX_DELAY);
+    zb_lock_held_t held = {
+        .acquired_us = esp_timer_get_time(),
+        .site = (uint8_t)site,
+    };
+    int64_t wait_us = held.acquired_us - start_us;
+    metrics_observe_us(METRIC_ZB_LOCK_WAIT_US, wait_us);
+    if (site < ZB_LOCK_SITE_COUNT) {
+        update_max(&s_site[site].wait_max_us, clamp_us(wait_us));
+    }
+    return held;
+}
+
+void zb_instr_unlock(const zb_lock_held_t *held)
+{
+    // Read the clock first: releasing can hand the CPU straight to the
+    // higher-priority stack task, and its work is not our hold time
+    int64_t now_us = esp_timer_get_time();
+    esp_zb_lock_release();
+    int64_t hold_us = now_us - held->acquired_us;
+    metrics_observe_us(METRIC_ZB_LOCK_HOLD_US, hold_us);
+    if (held->site >= ZB_LOCK_SITE_COUNT) {
+        return;
+    }
+    zb_instr_stats_t *st = &s_site[held->site];
+    __atomic_fetch_add(&st->count, 1, __ATOMIC_RELAXED);
+    update_max(&st->max_us, clamp_us(hold_us));
+    if (hold_us > ZB_INSTR_HOLD_BUDGET_US &&
+        over_budget(st, METRIC_ZB_LOCK_OVERRUNS, &s_site_warned_us[held->site], now_us)) {
+        ESP_LOGW(TAG, "Zigbee lock held %lld us by %s (budget %d us)",
+                 (long long)hold_us, s_site_name[held->site], ZB_INSTR_HOLD_BUDGET_US);
+    }
+}
+
+/* ============================================================================
+ * CALLBACKS
+ * ============================================================================ */
+
+int64_t zb_instr_callback_begin(void)
+{
+    return esp_timer_get_time();
+}
+
+void zb_instr_callback_end(zb_callback_t cb, int64_t start_us)
+{
+    int64_t now_us = esp_timer_get_time();
+    int64_t took_us = now_us - start_us;
+    metrics_observe_us(METRIC_ZB_CALLBACK_US, took_us);
+    if (cb >= ZB_CB_COUNT) {
+        return;
+    }
+    zb_instr_stats_t *st = &s_cb[cb];
+    __atomic_fetch_add(&st->count, 1, __ATOMIC_RELAXED);
+    update_max(&st->max_us, clamp_us(took_us));
+    if (took_us > ZB_INSTR_CALLBACK_BUDGET_US &&
+        over_budget(st, METRIC_ZB_CALLBACK_OVERRUNS, &s_cb_warned_us[cb], now_us)) {
+        ESP_LOGW(TAG, "Zigbee %s callback ran %lld us (budget %d us)",
+                 s_cb_name[cb], (long long)took_us, ZB_INSTR_CALLBACK_BUDGET_US);
+    }
+}
+
+/* ============================================================================
+ * READING
+ * ============================================================================ */
+
+static void copy_stats(const zb_instr_stats_t *st, zb_instr_stats_t *out)
+{
+    out->count = __atomic_load_n(&st->count, __ATOMIC_RELAXED);
+    out->max_us = __atomic_load_n(&st->max_us, __ATOMIC_RELAXED);
+    out->wait_max_us = __atomic_load_n(&st->wait_max_us, __ATOMIC_RELAXED);
+    out->over_budget = __atomic_load_n(&st->over_budget, __ATOMIC_RELAXED);
+}
+
+void zb_instr_get_lock_stats(zb_lock_site_t site, zb_instr_stats_t *out)
+{
+    static const zb_instr_stats_t none;
+    copy_stats(site < ZB_LOCK_SITE_COUNT ? &s_site[site] : &none, out);
+}
+
+void zb_instr_get_callback_stats(zb_callback_t cb, zb_instr_stats_t *out)
+{
+    static const zb_instr_stats_t none;
+    copy_stats(cb < ZB_CB_COUNT ? &s_cb[cb] : &none, out);
+}
+
+const char *zb_instr_site_name(zb_lock_site_t site)
+{
+    return site < ZB_LOCK_SITE_COUNT ? s_site_name[site] : "?";
+}
+
+const char *zb_instr_callback_name(zb_callback_t cb)
+{
+    return cb < ZB_CB_COUNT ? s_cb_name[cb] : "?";
+}
+
+void zb_instr_log(void)
+{
+    zb_instr_stats_t st;
+    for (int i = 0; i < ZB_LOCK_SITE_COUNT; i++) {
+        zb_instr_get_lock_stats((zb_lock_site_t)i, &st);
+        if (st.count > 0) {
+            ESP_LOGI(TAG, "lock %-14s %8lu holds, max wait %lu us, max hold %lu us, %lu over",
+                     s_site_name[i], (unsigned long)st.count, (unsigned long)st.wait_max_us,
+                     (unsigned long)st.max_us, (unsigned long)st.over_budget);
+        }
+    }
+    for (int i = 0; i < ZB_CB_COUNT; i++) {
+        zb_instr_get_callback_stats((zb_callback_t)i, &st);
+        if (st.count > 0) {
+            ESP_LOGI(TAG, "cb   %-14s %8lu calls, max %lu us, %lu over",
+                     s_cb_name[i], (unsigned long)st.count, (unsigned long)st.max_us,
+                     (unsigned long)st.over_budget);
+        }
+    }
+}
+
+void zb_instr_reset(void)
+{
+    for (int i = 0; i < ZB_LOCK_SITE_COUNT; i++) {
+        s_site[i] = (zb_instr_stats_t){ 0 };
+        s_site_warned_us[i] = 0;
+    }
+    for (int i = 0; i < ZB_CB_COUNT; i++) {
+        s_cb[i] = (zb_instr_stats_t){ 0 };
+        s_cb_warned_us[i] = 0;
+    }
+}
@@ -0,0 +1,125 @@
+/*
+ * Zigbee Instrumentation
+ * Wrappers around the Zigbee stack lock and the callbacks registered with
+ * the stack, to show where the stack is starved:
+ *
+ *   ZB_LOCK_WAIT_US       time an application task waited for the lock
+ *   ZB_LOCK_HOLD_US       time it then held it (the stack waits as long)
+ *   ZB_CALLBACK_US        time a callback ran inside the stack task
+ *   ZB_CALLBACK_OVERRUNS  callbacks over their budget
+ *   ZB_LOCK_OVERRUNS      lock holds over their budget
+ *
+ * The histograms are the metrics registry's (metrics.h). Per lock site and
+ * per callback the module also keeps a count, a maximum and an over-budget
+ * count, logged by zb_instr_log(); going over budget logs a warning naming
+ * the site, at most every ZB_INSTR_WARN_INTERVAL_US per site.
+ *
+ * The hold time travels in a token the caller keeps between lock and
+ * unlock, so nested holds (the lock is recursive) and several stacks in one
+ * process (the host mesh) need no shared state.
+ */
+
+#ifndef ZB_INSTR_H
+#define ZB_INSTR_H
+
+#include <stdint.h>
+
+// X(id, name): application code paths that take the Zigbee lock
+#define ZB_INSTR_LOCK_SITES(X)                  \
+    X(SENSOR_REPORT,    "sensor_report")        \
+    X(DIAGNOSTICS,      "diagnostics")          \
+    X(CONTROL,          "control")
+
+// X(id, name): callbacks the stack runs in its own task
+#define ZB_INSTR_CALLBACKS(X)                   \
+    X(ACTION,           "action")               \
+    X(SIGNAL,           "signal")               \
+    X(SEND_STATUS,      "send_status")          \
+    X(ALARM,            "alarm")                \
+    X(APS_INDICATION,   "aps_indication")
+
+typedef enum {
+#define ZB_INSTR_SITE_ENUM(id, name) ZB_LOCK_SITE_##id,
+    ZB_INSTR_LOCK_SITES(ZB_INSTR_SITE_ENUM)
+#undef ZB_INSTR_SITE_ENUM
+    ZB_LOCK_SITE_COUNT
+} zb_lock_site_t;
+
+typedef enum {
+#define ZB_INSTR_CB_ENUM(id, name) ZB_CB_##id,
+    ZB_INSTR_CALLBACKS(ZB_INSTR_CB_ENUM)
+#undef ZB_INSTR_CB_ENUM
+    ZB_CB_COUNT
+} zb_callback_t;
+
+#ifndef ZB_INSTR_CALLBACK_BUDGET_US
+#define ZB_INSTR_CALLBACK_BUDGET_US     10000   // A callback delays every frame behind it
+#endif
+#ifndef ZB_INSTR_HOLD_BUDGET_US
+#define ZB_INSTR_HOLD_BUDGET_US         20000
+#endif
+#define ZB_INSTR_WARN_INTERVAL_US       (10 * 1000000LL)
+
+typedef struct {
+    int64_t acquired_us;
+    uint8_t site;
+} zb_lock_held_t;
+
+typedef struct {
+    uint32_t count;
+    uint32_t max_us;            // Hold time for lock sites
+    uint32_t wait_max_us;       // Lock sites only
+    uint32_t over_budget;
+} zb_instr_stats_t;
+
+/* ============================================================================
+ * LOCK (application tasks)
+ * ============================================================================ */
+
+/**
+ * esp_zb_lock_acquire(portMAX_DELAY), recording the wait
+ * @return Token for zb_instr_unlock()
+ */
+zb_lock_held_t zb_instr_lock(zb_lock_site_t site);
+
+/**
+ * esp_zb_lock_release(), recording the hold
+ */
+void zb_instr_unlock(const zb_lock_held_t *held);
+
+/* ============================================================================
+ * CALLBACKS (stack task)
+ * ============================================================================ */
+
+/**
+ * Call first thing in a callback
+ * @return Start time for zb_instr_callback_end()
+ */
+int64_t zb_instr_callback_begin(void);
+
+/**
+ * Call last thing in a callback
+ */
+void zb_instr_callback_end(zb_callback_t cb, int64_t start_us);
+
+/* ============================================================================
+ * READING
+ * ============================================================================ */
+
+void zb_instr_get_lock_stats(zb_lock_site_t site, zb_instr_stats_t *out);
+void zb_instr_get_callback_stats(zb_callback_t cb, zb_instr_stats_t *out);
+const char *zb_instr_site_name(zb_lock_site_t site);
+const char *zb_instr_callback_name(zb_callback_t cb);
+
+/**
+ * Log one line per lock site and callback used so far, at INFO level
+ */
+void zb_instr_log(void);
+
+/**
+ * Zero the per-site statistics (tests, host runs); the histograms are
+ * reset with metrics_reset()
+ */
+void zb_instr_reset(void);
+
+#endif // ZB_INSTR_H
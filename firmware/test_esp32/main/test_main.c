@@ -7,7 +7,7 @@
  * Features tested:
  * - BLE GATT server
  * - Device provisioning via mobile app
- * - Simulated water level (random values)
+ * - Simulated water level (shared tank_plant model, 60x real time)
  * - Simulated pump control (LED on GPIO2)
  * - Manual pump override
  * - Status broadcasting
@@ -37,6 +37,7 @@
 #include "driver/gpio.h"
 #include "esp_timer.h"
 #include "esp_random.h"
+#include "tank_plant.h"
 
 static const char *TAG = "CULTIVIO_TEST";
 
@@ -312,28 +313,57 @@ static void set_device_name(void)
 // ============================================================================
 // Simulation Functions
 // ============================================================================
+#define PLANT_TIME_SCALE    60      // One minute on the desk is an hour of tank time
+
+static tank_plant_t s_plant;
+
+static void plant_setup(void)
+{
+    // Household demand scaled down to the small test tank (~200 l)
+    tank_plant_config_t pcfg = TANK_PLANT_CONFIG_DEFAULT();
+    pcfg.height_cm = g_config.tank_height_cm;
+    pcfg.diameter_cm = g_config.tank_diameter_cm;
+    pcfg.sensor_offset_cm = g_config.sensor_offset_cm;
+    pcfg.initial_pct = g_status.water_level_percent;
+    pcfg.inflow_lpm = 5;
+    pcfg.demand_base_lph = 12;
+    pcfg.demand_morning_lph = 60;
+    pcfg.demand_evening_lph = 45;
+    pcfg.seed = esp_random();
+    pcfg.time_scale = PLANT_TIME_SCALE;
+    tank_plant_init(&s_plant, &pcfg, esp_timer_get_time());
+}
+
 static void simulate_water_level(void)
 {
-    // Simulate water level changes
-    static int direction = -1;
-    
-    if (g_status.pump_running) {
-        // Water level increasing when pump is on
-        g_status.water_level_percent += 2;
-        if (g_status.water_level_percent >= g_config.pump_off_threshold) {
-            g_status.water_level_percent = g_config.pump_off_threshold;
-            if (!g_status.manual_mode) {
-                update_pump_state(false);
-            }
-        }
-    } else {
-        // Water level slowly decreasing (usage)
-        if (g_status.water_level_percent > 0) {
-            g_status.water_level_percent -= 1;
-        }
-        
-        // Auto-start pump if below threshold
-        if (g_status.water_level_percent <= g_config.pump_on_threshold && !g_status.manual_mode) {
+    if (g_config.tank_height_cm == 0) {
+        return;
+    }
+
+    // First call, or geometry changed through provisioning: start a new tank at the current level
+    if (s_plant.cfg.height_cm != g_config.tank_height_cm ||
+        s_plant.cfg.diameter_cm != g_config.tank_diameter_cm ||
+        s_plant.cfg.sensor_offset_cm != g_config.sensor_offset_cm) {
+        plant_setup();
+    }
+
+    tank_plant_step(&s_plant, g_status.pump_running, esp_timer_get_time());
+
+    // Read it the way the sensor node does; a missed echo keeps the last level
+    float distance = tank_plant_echo_cm(&s_plant);
+    if (distance >= 0) {
+        float depth = g_config.tank_height_cm - distance - g_config.sensor_offset_cm;
+        if (depth < 0) depth = 0;
+        if (depth > g_config.tank_height_cm) depth = g_config.tank_height_cm;
+        g_status.water_level_percent = (uint8_t)(depth * 100.0f / g_config.tank_height_cm);
+    }
+
+    if (!g_status.manual_mode) {
+        if (g_status.pump_running &&
+            g_status.water_level_percent >= g_config.pump_off_threshold) {
+            update_pump_state(false);
+        } else if (!g_status.pump_running &&
+                   g_status.water_level_percent <= g_config.pump_on_threshold) {
             update_pump_state(true);
         }
     }
@@ -0,0 +1,2 @@
+/* Forwarding header: firmware sources built natively include ESP-IDF names */
+#include "mock_esp.h"
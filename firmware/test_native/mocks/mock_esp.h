@@ -11,6 +11,7 @@
 #include <stdio.h>
 #include <string.h>
 #include <stdlib.h>
+#include "test_assert.h"
 
 /* ============================================================================
  * TYPE DEFINITIONS
@@ -21,6 +22,18 @@ typedef int esp_err_t;
 #define ESP_FAIL        -1
 #define ESP_ERR_TIMEOUT -2
 #define ESP_ERR_NO_MEM  -3
+#define ESP_ERR_INVALID_ARG     0x102
+#define ESP_ERR_INVALID_STATE   0x103
+#define ESP_ERR_INVALID_SIZE    0x104
+#define ESP_ERR_NOT_FOUND       0x105
+#define ESP_ERR_NOT_SUPPORTED   0x106
+#define ESP_ERR_INVALID_CRC     0x109
+#define ESP_ERR_INVALID_VERSION 0x10A
+
+static inline const char *esp_err_to_name(esp_err_t err) {
+    (void)err;
+    return "ESP_ERR";
+}
 
 /* ============================================================================
  * MOCK TIME FUNCTIONS
@@ -119,64 +132,149 @@ static inline void xSemaphoreGive(SemaphoreHandle_t sem) {
 
 typedef int nvs_handle_t;
 
+typedef enum {
+    NVS_READONLY,
+    NVS_READWRITE
+} nvs_open_mode_t;
+
 #define ESP_ERR_NVS_NO_FREE_PAGES   0x1100
 #define ESP_ERR_NVS_NEW_VERSION_FOUND 0x1101
+#define ESP_ERR_NVS_NOT_FOUND       0x1102
+#define ESP_ERR_NVS_INVALID_LENGTH  0x110c
+
+/*
+ * In-memory NVS: one flat key space (namespaces ignored), every set counts
+ * as a flash write so tests can check wear.
+ */
+#define MOCK_NVS_MAX_ENTRIES    32
+#define MOCK_NVS_MAX_VALUE      256
+
+typedef struct {
+    char     key[16];
+    uint8_t  value[MOCK_NVS_MAX_VALUE];
+    size_t   len;
+    bool     used;
+} mock_nvs_entry_t;
+
+static mock_nvs_entry_t g_mock_nvs[MOCK_NVS_MAX_ENTRIES];
+static int g_mock_nvs_writes = 0;       // Number of set calls
+static int g_mock_nvs_bytes = 0;        // Bytes written by set calls
+
+static inline void mock_nvs_reset(void) {
+    memset(g_mock_nvs, 0, sizeof(g_mock_nvs));
+    g_mock_nvs_writes = 0;
+    g_mock_nvs_bytes = 0;
+}
+
+static inline mock_nvs_entry_t *mock_nvs_find(const char *key) {
+    for (int i = 0; i < MOCK_NVS_MAX_ENTRIES; i++) {
+        if (g_mock_nvs[i].used && strcmp(g_mock_nvs[i].key, key) == 0) {
+            return &g_mock_nvs[i];
+        }
+    }
+    return NULL;
+}
+
+static inline esp_err_t mock_nvs_set(const char *key, const void *value, size_t len) {
+    mock_nvs_entry_t *e = mock_nvs_find(key);
+    for (int i = 0; !e && i < MOCK_NVS_MAX_ENTRIES; i++) {
+        if (!g_mock_nvs[i].used) {
+            e = &g_mock_nvs[i];
+            e->used = true;
+            strncpy(e->key, key, sizeof(e->key) - 1);
+        }
+    }
+    if (!e || len > MOCK_NVS_MAX_VALUE) return ESP_FAIL;
+    memcpy(e->value, value, len);
+    e->len = len;
+    g_mock_nvs_writes++;
+    g_mock_nvs_bytes += (int)len;
+    return ESP_OK;
+}
 
 static inline esp_err_t nvs_flash_init(void) {
     return ESP_OK;
 }
 
 static inline esp_err_t nvs_flash_erase(void) {
+    mock_nvs_reset();
     return ESP_OK;
 }
 
-/* ============================================================================
- * TEST ASSERTIONS
- * ============================================================================ */
+static inline esp_err_t nvs_open(const char *ns, nvs_open_mode_t mode, nvs_handle_t *out) {
+    (void)ns;
+    (void)mode;
+    *out = 1;
+    return ESP_OK;
+}
+
+static inline void nvs_close(nvs_handle_t h) {
+    (void)h;
+}
+
+static inline esp_err_t nvs_commit(nvs_handle_t h) {
+    (void)h;
+    return ESP_OK;
+}
 
-static int g_test_failures = 0;
-static int g_test_passes = 0;
-
-#define TEST_ASSERT(condition) do { \
-    if (!(condition)) { \
-        printf("  FAILED: %s (line %d)\n", #condition, __LINE__); \
-        g_test_failures++; \
-    } else { \
-        g_test_passes++; \
-    } \
-} while(0)
-
-#define TEST_ASSERT_EQUAL(expected, actual) do { \
-    if ((expected) != (actual)) { \
-        printf("  FAILED: Expected %d, got %d (line %d)\n", (int)(expected), (int)(actual), __LINE__); \
-        g_test_failures++; \
-    } else { \
-        g_test_passes++; \
-    } \
-} while(0)
-
-#define TEST_ASSERT_TRUE(condition) TEST_ASSERT(condition)
-#define TEST_ASSERT_FALSE(condition) TEST_ASSERT(!(condition))
-
-#define RUN_TEST(test_func) do { \
-    printf("  %s... ", #test_func); \
-    int failures_before = g_test_failures; \
-    test_func(); \
-    if (g_test_failures == failures_before) { \
-        printf("PASSED\n"); \
-    } \
-} while(0)
-
-#define TEST_SUMMARY() do { \
-    printf("\n================================\n"); \
-    printf("Tests: %d passed, %d failed\n", g_test_passes, g_test_failures); \
-    if (g_test_failures == 0) { \
-        printf("All tests PASSED!\n"); \
-    } else { \
-        printf("FAILURES detected!\n"); \
-    } \
-    printf("================================\n"); \
-} while(0)
+static inline esp_err_t nvs_set_blob(nvs_handle_t h, const char *key, const void *value, size_t len) {
+    (void)h;
+    return mock_nvs_set(key, value, len);
+}
+
+static inline esp_err_t nvs_get_blob(nvs_handle_t h, const char *key, void *out, size_t *len) {
+    (void)h;
+    mock_nvs_entry_t *e = mock_nvs_find(key);
+    if (!e) return ESP_ERR_NVS_NOT_FOUND;
+    if (out == NULL) {
+        *len = e->len;
+        return ESP_OK;
+    }
+    if (*len < e->len) return ESP_ERR_NVS_INVALID_LENGTH;
+    memcpy(out, e->value, e->len);
+    *len = e->len;
+    return ESP_OK;
+}
+
+static inline esp_err_t nvs_set_u8(nvs_handle_t h, const char *key, uint8_t v) {
+    (void)h;
+    return mock_nvs_set(key, &v, sizeof(v));
+}
+
+static inline esp_err_t nvs_set_u16(nvs_handle_t h, const char *key, uint16_t v) {
+    (void)h;
+    return mock_nvs_set(key, &v, sizeof(v));
+}
+
+static inline esp_err_t nvs_get_u8(nvs_handle_t h, const char *key, uint8_t *v) {
+    (void)h;
+    mock_nvs_entry_t *e = mock_nvs_find(key);
+    if (!e || e->len != sizeof(*v)) return ESP_ERR_NVS_NOT_FOUND;
+    memcpy(v, e->value, sizeof(*v));
+    return ESP_OK;
+}
+
+static inline esp_err_t nvs_get_u16(nvs_handle_t h, const char *key, uint16_t *v) {
+    (void)h;
+    mock_nvs_entry_t *e = mock_nvs_find(key);
+    if (!e || e->len != sizeof(*v)) return ESP_ERR_NVS_NOT_FOUND;
+    memcpy(v, e->value, sizeof(*v));
+    return ESP_OK;
+}
+
+static inline esp_err_t nvs_erase_key(nvs_handle_t h, const char *key) {
+    (void)h;
+    mock_nvs_entry_t *e = mock_nvs_find(key);
+    if (!e) return ESP_ERR_NVS_NOT_FOUND;
+    e->used = false;
+    return ESP_OK;
+}
+
+static inline esp_err_t nvs_erase_all(nvs_handle_t h) {
+    (void)h;
+    memset(g_mock_nvs, 0, sizeof(g_mock_nvs));
+    return ESP_OK;
+}
 
 #endif /* MOCK_ESP_H */
 
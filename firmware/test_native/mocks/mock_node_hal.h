@@ -0,0 +1,59 @@
+/*
+ * Mock Node HAL for Native Testing
+ * node_hal.h over the mock_esp.h clock and GPIO, so shared/node_logic
+ * sources compile into test_all.c unchanged
+ */
+
+#ifndef MOCK_NODE_HAL_H
+#define MOCK_NODE_HAL_H
+
+#include "mock_esp.h"
+#include "node_hal.h"
+
+static uint32_t g_mock_zb_attr[4];
+static device_status_t g_mock_ble_status;
+static int g_mock_relay_switches = 0;
+
+int64_t node_hal_time_us(void) {
+    return g_mock_time_us;
+}
+
+void node_hal_delay_ms(uint32_t ms) {
+    mock_advance_time_ms(ms);
+}
+
+void node_hal_delay_us(uint32_t us) {
+    g_mock_time_us += us;
+}
+
+void node_hal_yield(void) {
+}
+
+void node_hal_gpio_set(int pin, int level) {
+    gpio_set_level(pin, level);
+}
+
+int node_hal_gpio_get(int pin) {
+    return gpio_get_level(pin);
+}
+
+void node_hal_pump_relay(bool on) {
+    if (g_mock_gpio_levels[NODE_PIN_RELAY] != (on ? 1 : 0)) {
+        g_mock_relay_switches++;
+    }
+    g_mock_gpio_levels[NODE_PIN_RELAY] = on ? 1 : 0;
+    g_mock_gpio_levels[NODE_PIN_LED_ACTIVITY] = on ? 1 : 0;
+}
+
+esp_err_t node_hal_zb_set_attr(uint16_t attr_id, void *value) {
+    if (attr_id >= 4) return ESP_ERR_INVALID_ARG;
+    g_mock_zb_attr[attr_id] = (attr_id == NODE_ZB_ATTR_LEVEL_CM) ?
+                              *(uint16_t *)value : *(uint8_t *)value;
+    return ESP_OK;
+}
+
+void node_hal_ble_status(const device_status_t *status) {
+    g_mock_ble_status = *status;
+}
+
+#endif /* MOCK_NODE_HAL_H */
@@ -0,0 +1,59 @@
+/*
+ * Test Assertions for Native Testing
+ * Shared by test_all.c (through mock_esp.h) and the host-only tests
+ */
+
+#ifndef TEST_ASSERT_H
+#define TEST_ASSERT_H
+
+#include <stdio.h>
+
+/* ============================================================================
+ * TEST ASSERTIONS
+ * ============================================================================ */
+
+static int g_test_failures = 0;
+static int g_test_passes = 0;
+
+#define TEST_ASSERT(condition) do { \
+    if (!(condition)) { \
+        printf("  FAILED: %s (line %d)\n", #condition, __LINE__); \
+        g_test_failures++; \
+    } else { \
+        g_test_passes++; \
+    } \
+} while(0)
+
+#define TEST_ASSERT_EQUAL(expected, actual) do { \
+    if ((expected) != (actual)) { \
+        printf("  FAILED: Expected %d, got %d (line %d)\n", (int)(expected), (int)(actual), __LINE__); \
+        g_test_failures++; \
+    } else { \
+        g_test_passes++; \
+    } \
+} while(0)
+
+#define TEST_ASSERT_TRUE(condition) TEST_ASSERT(condition)
+#define TEST_ASSERT_FALSE(condition) TEST_ASSERT(!(condition))
+
+#define RUN_TEST(test_func) do { \
+    printf("  %s... ", #test_func); \
+    int failures_before = g_test_failures; \
+    test_func(); \
+    if (g_test_failures == failures_before) { \
+        printf("PASSED\n"); \
+    } \
+} while(0)
+
+#define TEST_SUMMARY() do { \
+    printf("\n================================\n"); \
+    printf("Tests: %d passed, %d failed\n", g_test_passes, g_test_failures); \
+    if (g_test_failures == 0) { \
+        printf("All tests PASSED!\n"); \
+    } else { \
+        printf("FAILURES detected!\n"); \
+    } \
+    printf("================================\n"); \
+} while(0)
+
+#endif /* TEST_ASSERT_H */
@@ -22,7 +22,7 @@ if %ERRORLEVEL% NEQ 0 (
 )
 
 echo [1/3] Compiling tests...
-gcc -o test_all.exe test_all.c -I./mocks -Wall -Wextra
+gcc -o test_all.exe test_all.c -I./mocks -I../shared/node_logic -I../shared/ble_provision -I../shared/metrics -I../shared/trace -I../shared/bench -I../shared/energy -I../shared/e2e -I../shared/link_quality -Wall -Wextra -lm
 if %ERRORLEVEL% NEQ 0 (
     echo.
     echo COMPILE ERROR: Check the output above
@@ -22,7 +22,7 @@ if (-not $gccPath) {
 
 Write-Host "[1/3] Compiling tests..." -ForegroundColor Cyan
 
-$compileResult = & gcc -o test_all.exe test_all.c -I./mocks -Wall -Wextra 2>&1
+$compileResult = & gcc -o test_all.exe test_all.c -I./mocks -I../shared/node_logic -I../shared/ble_provision -I../shared/metrics -I../shared/trace -I../shared/bench -I../shared/energy -I../shared/e2e -I../shared/link_quality -Wall -Wextra -lm 2>&1
 if ($LASTEXITCODE -ne 0) {
     Write-Host ""
     Write-Host "COMPILE ERROR:" -ForegroundColor Red
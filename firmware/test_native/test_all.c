@@ -2,193 +2,114 @@
  * Cultivio AquaSense - Native Unit Tests
  * Run on PC without ESP32 hardware
  * 
- * Compile: gcc -o test_all test_all.c -I./mocks
+ * Compile: gcc -o test_all test_all.c -I./mocks -I../shared/node_logic -I../shared/ble_provision -I../shared/metrics -I../shared/trace -I../shared/bench -I../shared/energy -I../shared/e2e -I../shared/link_quality -lm
  * Run: ./test_all
+ * (or build with CMake from firmware/host, see README)
  */
 
 #include "mocks/mock_esp.h"
+#include "mocks/mock_node_hal.h"
 
-static const char *TAG = "TEST";
-
-/* ============================================================================
- * EXTRACTED LOGIC FROM FIRMWARE (for testing)
- * ============================================================================ */
+// Firmware modules compiled in directly (their TAG renamed to avoid a clash)
+#define TAG CONFIG_STORE_TAG
+#include "../shared/ble_provision/config_store.c"
+#undef TAG
+#include "../shared/ble_provision/config_derived.c"
+#include "../shared/trace/trace.c"
 
-// Simulated config structure
-typedef struct {
-    uint16_t tank_height_cm;
-    uint16_t tank_diameter_cm;
-    uint8_t  sensor_offset_cm;
-    uint8_t  pump_on_threshold;
-    uint8_t  pump_off_threshold;
-    uint16_t pump_timeout_minutes;
-    uint16_t report_interval_sec;
-} test_config_t;
-
-static test_config_t g_config = {
-    .tank_height_cm = 200,
-    .tank_diameter_cm = 100,
-    .sensor_offset_cm = 5,
-    .pump_on_threshold = 20,
-    .pump_off_threshold = 80,
-    .pump_timeout_minutes = 60,
-    .report_interval_sec = 5
-};
-
-// Simulated globals
-static uint8_t  g_water_level_percent = 0;
-static uint16_t g_water_level_cm = 0;
-static uint8_t  g_sensor_status = 0;
-static bool     g_pump_running = false;
-static uint32_t g_pump_start_time = 0;
-static bool     g_manual_override = false;
-static uint32_t g_manual_override_end_time = 0;
-static int64_t  g_last_sensor_update_us = 0;
-
-#define SENSOR_TIMEOUT_MS       30000
-#define MAX_PUMP_TIMEOUT_SEC    7200
-#define SENSOR_TOLERANCE_CM     50
+// Trace port (trace_task.c on targets): one pretend task, number 3
+static uint8_t g_trace_task = 0;
+uint8_t trace_port_task(void) { return g_trace_task; }
+const char *trace_port_task_name(uint8_t number) { return number == 3 ? "control_task" : NULL; }
 
-/* ============================================================================
- * WATER LEVEL CALCULATION (from sensor_node.c)
- * ============================================================================ */
+#define TAG WATER_LEVEL_TAG
+#include "../shared/node_logic/water_level.c"
+#undef TAG
+#define TAG METRICS_TAG
+#include "../shared/metrics/metrics.c"
+#undef TAG
+#define TAG E2E_TAG
+#include "../shared/e2e/e2e.c"
+#undef TAG
+#include "../shared/e2e/net_time.c"
+#define TAG LINK_TAG
+#include "../shared/link_quality/link_quality.c"
+#undef TAG
+#define TAG PUMP_CONTROL_TAG
+#include "../shared/node_logic/pump_control.c"
+#undef TAG
+#include "../shared/bench/bench.c"
+#define TAG ENERGY_TAG
+#include "../shared/energy/energy.c"
+#undef TAG
 
-typedef struct {
-    float distances[5];
-    int count;
-} mock_samples_t;
+// Bench port: a clock that only the benchmarked code advances
+static uint64_t g_bench_cycles;
+uint64_t bench_port_cycles(void) { return g_bench_cycles; }
+uint64_t bench_port_cycle_hz(void) { return 1000000000; }
+const char *bench_port_clock(void) { return "fake"; }
+const char *bench_port_platform(void) { return "test"; }
 
-static mock_samples_t g_mock_samples = {0};
+static const char *TAG = "TEST";
 
-static void mock_set_distance_samples(float d1, float d2, float d3, float d4, float d5) {
-    g_mock_samples.distances[0] = d1;
-    g_mock_samples.distances[1] = d2;
-    g_mock_samples.distances[2] = d3;
-    g_mock_samples.distances[3] = d4;
-    g_mock_samples.distances[4] = d5;
-    g_mock_samples.count = 0;
-}
+/* ============================================================================
+ * TEST FIXTURES
+ * ============================================================================ */
 
-static float measure_distance_cm_mock(void) {
-    if (g_mock_samples.count < 5) {
-        return g_mock_samples.distances[g_mock_samples.count++];
-    }
-    return -1.0f;
+// Provisioned controller: 200 cm tank, pump 20% / 80%, 60 min timeout
+static void make_test_device_config(device_config_t *cfg) {
+    memset(cfg, 0, sizeof(*cfg));
+    strcpy(cfg->device_name, "Cultivio-Flat301");
+    strcpy(cfg->custom_name, "Flat301");
+    strcpy(cfg->password, "A1B2C3D4");
+    strcpy(cfg->location, "Building A, 3rd Floor");
+    cfg->password_enabled = true;
+    cfg->node_type = NODE_TYPE_CONTROLLER;
+    cfg->tank_height_cm = 200;
+    cfg->tank_diameter_cm = 100;
+    cfg->sensor_offset_cm = 5;
+    cfg->pump_on_threshold = 20;
+    cfg->pump_off_threshold = 80;
+    cfg->pump_timeout_minutes = 60;
+    cfg->zigbee_pan_id = 0x1234;
+    cfg->zigbee_channel = 15;
+    cfg->report_interval_sec = 5;
+    cfg->provisioned = true;
+    cfg->provision_timestamp = 123456;
 }
 
-static void calculate_water_level(void) {
-    float total_distance = 0;
-    int valid_samples = 0;
-    
-    uint16_t tank_height = g_config.tank_height_cm > 0 ? g_config.tank_height_cm : 200;
-    uint8_t sensor_offset = g_config.sensor_offset_cm;
-
-    g_mock_samples.count = 0;
-    for (int i = 0; i < 5; i++) {
-        float distance = measure_distance_cm_mock();
-        if (distance > 0 && distance < tank_height + SENSOR_TOLERANCE_CM) {
-            total_distance += distance;
-            valid_samples++;
-        }
-    }
+static config_derived_t g_dc;
+static water_level_t g_level;
+static pump_control_t g_pump;
 
-    if (valid_samples > 0) {
-        // Zero height check
-        if (tank_height == 0) {
-            g_sensor_status = 1;
-            g_water_level_percent = 0;
-            g_water_level_cm = 0;
-            return;
-        }
-        
-        float avg_distance = total_distance / valid_samples;
-        float water_depth = tank_height - avg_distance - sensor_offset;
-        
-        if (water_depth < 0) water_depth = 0;
-        if (water_depth > tank_height) water_depth = tank_height;
-
-        g_water_level_cm = (uint16_t)water_depth;
-        g_water_level_percent = (uint8_t)((water_depth / tank_height) * 100.0f);
-        g_sensor_status = 0;
-    } else {
-        g_sensor_status = 1;
-    }
+static void set_tank(uint16_t height_cm, uint8_t offset_cm) {
+    device_config_t cfg;
+    make_test_device_config(&cfg);
+    cfg.tank_height_cm = height_cm;
+    cfg.sensor_offset_cm = offset_cm;
+    config_derive(&cfg, &g_dc);
+    memset(&g_level, 0, sizeof(g_level));
 }
 
-/* ============================================================================
- * PUMP CONTROL LOGIC (from controller_node.c)
- * ============================================================================ */
-
-static void pump_on(void) {
-    if (!g_pump_running) {
-        g_pump_running = true;
-        g_pump_start_time = esp_timer_get_time() / 1000000;
-    }
+static void measure_samples(float d1, float d2, float d3, float d4, float d5) {
+    const float samples[WATER_LEVEL_NUM_SAMPLES] = { d1, d2, d3, d4, d5 };
+    water_level_compute(samples, WATER_LEVEL_NUM_SAMPLES, &g_dc, &g_level);
 }
 
-static void pump_off(void) {
-    if (g_manual_override) {
-        g_manual_override = false;
-        g_manual_override_end_time = 0;
-    }
-    g_pump_running = false;
+static void reset_pump(void) {
+    device_config_t cfg;
+    make_test_device_config(&cfg);
+    config_derive(&cfg, &g_dc);
+    mock_set_time_us(0);
+    pump_control_init(&g_pump);
 }
 
-static void pump_control_logic(void) {
-    int64_t now_us = esp_timer_get_time();
-    uint32_t now_sec = (uint32_t)(now_us / 1000000);
-    
-    int64_t sensor_elapsed_ms = (now_us - g_last_sensor_update_us) / 1000;
-    bool sensor_online = sensor_elapsed_ms < SENSOR_TIMEOUT_MS && g_last_sensor_update_us > 0;
-    
-    uint8_t pump_on_threshold = g_config.pump_on_threshold > 0 ? g_config.pump_on_threshold : 20;
-    uint8_t pump_off_threshold = g_config.pump_off_threshold > 0 ? g_config.pump_off_threshold : 80;
-    
-    uint32_t pump_timeout_sec = g_config.pump_timeout_minutes > 0 ? 
-                                ((uint32_t)g_config.pump_timeout_minutes * 60) : 3600;
-    
-    if (pump_timeout_sec > MAX_PUMP_TIMEOUT_SEC) {
-        pump_timeout_sec = MAX_PUMP_TIMEOUT_SEC;
-    }
-    
-    // Manual override mode
-    if (g_manual_override) {
-        if (now_sec >= g_manual_override_end_time) {
-            g_manual_override = false;
-            g_manual_override_end_time = 0;
-            pump_off();
-            return;
-        }
-        if (!g_pump_running) {
-            pump_on();
-        }
-        return;
-    }
-    
-    // Sensor offline check
-    if (!sensor_online) {
-        if (g_pump_running) {
-            pump_off();
-        }
-        return;
-    }
-
-    // Pump timeout check
-    if (g_pump_running) {
-        uint32_t runtime = now_sec - g_pump_start_time;
-        if (runtime >= pump_timeout_sec) {
-            pump_off();
-            return;
-        }
-    }
-
-    // Auto control logic
-    if (g_water_level_percent <= pump_on_threshold && !g_pump_running) {
-        pump_on();
-    }
-    else if (g_water_level_percent >= pump_off_threshold && g_pump_running) {
-        pump_off();
-    }
+// Sensor report arrives at at_us, control pass runs at now_us
+static void report_and_step(uint8_t level_pct, int64_t at_us, int64_t now_us) {
+    mock_set_time_us(at_us);
+    pump_control_sensor_update(&g_pump, level_pct);
+    mock_set_time_us(now_us);
+    pump_control_step(&g_pump, &g_dc);
 }
 
 /* ============================================================================
@@ -224,204 +145,221 @@ static bool validate_report_interval(uint16_t interval) {
 }
 
 /* ============================================================================
- * TEST: WATER LEVEL CALCULATION
+ * TEST: WATER LEVEL CALCULATION (shared/node_logic/water_level.c)
  * ============================================================================ */
 
 void test_water_level_normal_reading(void) {
-    g_config.tank_height_cm = 200;
-    g_config.sensor_offset_cm = 0;
+    set_tank(200, 0);
     
     // Distance 50cm from top = 150cm water depth = 75%
-    mock_set_distance_samples(50.0f, 50.0f, 50.0f, 50.0f, 50.0f);
-    calculate_water_level();
+    measure_samples(50.0f, 50.0f, 50.0f, 50.0f, 50.0f);
     
-    TEST_ASSERT_EQUAL(0, g_sensor_status);
-    TEST_ASSERT_EQUAL(75, g_water_level_percent);
-    TEST_ASSERT_EQUAL(150, g_water_level_cm);
+    TEST_ASSERT_EQUAL(WATER_LEVEL_STATUS_OK, g_level.status);
+    TEST_ASSERT_EQUAL(75, g_level.percent);
+    TEST_ASSERT_EQUAL(150, g_level.cm);
 }
 
 void test_water_level_zero_height(void) {
-    g_config.tank_height_cm = 0;  // Invalid!
+    set_tank(0, 0);  // Invalid: config_derive() falls back to 200 cm
     
-    mock_set_distance_samples(50.0f, 50.0f, 50.0f, 50.0f, 50.0f);
-    calculate_water_level();
+    measure_samples(50.0f, 50.0f, 50.0f, 50.0f, 50.0f);
     
-    TEST_ASSERT_EQUAL(1, g_sensor_status);  // Error status
-    TEST_ASSERT_EQUAL(0, g_water_level_percent);
+    TEST_ASSERT_EQUAL(200, g_dc.tank_height_cm);
+    TEST_ASSERT_EQUAL(WATER_LEVEL_STATUS_OK, g_level.status);
+    TEST_ASSERT_EQUAL(75, g_level.percent);
 }
 
 void test_water_level_full_tank(void) {
-    g_config.tank_height_cm = 200;
-    g_config.sensor_offset_cm = 0;
+    set_tank(200, 0);
     
-    // Distance 0 = full tank
-    mock_set_distance_samples(0.0f, 0.0f, 0.0f, 0.0f, 0.0f);
-    calculate_water_level();
+    // Water 1cm below the sensor = 199cm = 99%
+    measure_samples(1.0f, 1.0f, 1.0f, 1.0f, 1.0f);
+    TEST_ASSERT_EQUAL(WATER_LEVEL_STATUS_OK, g_level.status);
+    TEST_ASSERT_EQUAL(99, g_level.percent);
     
-    TEST_ASSERT_EQUAL(0, g_sensor_status);
-    TEST_ASSERT_EQUAL(100, g_water_level_percent);
+    // Distance 0 is no echo, not a full tank: error, last level kept
+    measure_samples(0.0f, 0.0f, 0.0f, 0.0f, 0.0f);
+    TEST_ASSERT_EQUAL(WATER_LEVEL_STATUS_ERROR, g_level.status);
+    TEST_ASSERT_EQUAL(99, g_level.percent);
+    
+    // Water up to the full height reads 100%, including heights whose
+    // reciprocal is inexact (100 / 97 * 97 = 99.99...)
+    static const uint16_t heights[] = { 97, 99, 171, 200, 1000 };
+    for (size_t i = 0; i < sizeof(heights) / sizeof(heights[0]); i++) {
+        set_tank(heights[i], 0);
+        TEST_ASSERT_EQUAL(100, water_level_percent(&g_dc, heights[i]));
+    }
+}
+
+void test_water_level_percent_matches_division(void) {
+    // Every whole-cm depth at every valid height: same as depth * 100 / height
+    int mismatches = 0;
+    for (uint16_t height = 50; height <= 1000; height++) {
+        set_tank(height, 0);
+        for (uint16_t depth = 0; depth <= height; depth++) {
+            if (water_level_percent(&g_dc, depth) != depth * 100 / height) {
+                mismatches++;
+            }
+        }
+    }
+    TEST_ASSERT_EQUAL(0, mismatches);
 }
 
 void test_water_level_empty_tank(void) {
-    g_config.tank_height_cm = 200;
-    g_config.sensor_offset_cm = 0;
+    set_tank(200, 0);
     
     // Distance 200 = empty tank
-    mock_set_distance_samples(200.0f, 200.0f, 200.0f, 200.0f, 200.0f);
-    calculate_water_level();
+    measure_samples(200.0f, 200.0f, 200.0f, 200.0f, 200.0f);
     
-    TEST_ASSERT_EQUAL(0, g_sensor_status);
-    TEST_ASSERT_EQUAL(0, g_water_level_percent);
+    TEST_ASSERT_EQUAL(WATER_LEVEL_STATUS_OK, g_level.status);
+    TEST_ASSERT_EQUAL(0, g_level.percent);
 }
 
 void test_water_level_invalid_samples(void) {
-    g_config.tank_height_cm = 200;
+    set_tank(200, 0);
     
-    // All invalid readings
-    mock_set_distance_samples(-1.0f, -1.0f, -1.0f, -1.0f, -1.0f);
-    calculate_water_level();
+    // All invalid readings, including echoes beyond height + tolerance
+    measure_samples(-1.0f, -1.0f, -1.0f, 250.0f, 300.0f);
     
-    TEST_ASSERT_EQUAL(1, g_sensor_status);  // Error
+    TEST_ASSERT_EQUAL(WATER_LEVEL_STATUS_ERROR, g_level.status);
 }
 
 void test_water_level_partial_samples(void) {
-    g_config.tank_height_cm = 200;
-    g_config.sensor_offset_cm = 0;
+    set_tank(200, 0);
     
     // 3 valid, 2 invalid -> should use avg of 3
-    mock_set_distance_samples(100.0f, 100.0f, 100.0f, -1.0f, -1.0f);
-    calculate_water_level();
+    measure_samples(100.0f, 100.0f, 100.0f, -1.0f, -1.0f);
     
-    TEST_ASSERT_EQUAL(0, g_sensor_status);
-    TEST_ASSERT_EQUAL(50, g_water_level_percent);  // 100cm depth
+    TEST_ASSERT_EQUAL(WATER_LEVEL_STATUS_OK, g_level.status);
+    TEST_ASSERT_EQUAL(50, g_level.percent);  // 100cm depth
 }
 
 void test_water_level_with_offset(void) {
-    g_config.tank_height_cm = 200;
-    g_config.sensor_offset_cm = 10;
+    set_tank(200, 10);
     
     // Distance 50cm, offset 10cm -> water depth = 200 - 50 - 10 = 140cm = 70%
-    mock_set_distance_samples(50.0f, 50.0f, 50.0f, 50.0f, 50.0f);
-    calculate_water_level();
+    measure_samples(50.0f, 50.0f, 50.0f, 50.0f, 50.0f);
+    
+    TEST_ASSERT_EQUAL(WATER_LEVEL_STATUS_OK, g_level.status);
+    TEST_ASSERT_EQUAL(70, g_level.percent);
+    TEST_ASSERT_EQUAL(1099, g_level.litres);  // 140cm x 7.85 L/cm (100cm diameter)
+}
+
+void test_water_level_publish(void) {
+    set_tank(200, 0);
+    measure_samples(50.0f, 50.0f, 50.0f, 50.0f, 50.0f);
+    
+    water_level_publish(&g_level);
     
-    TEST_ASSERT_EQUAL(0, g_sensor_status);
-    TEST_ASSERT_EQUAL(70, g_water_level_percent);
+    TEST_ASSERT_EQUAL(75, g_mock_zb_attr[NODE_ZB_ATTR_LEVEL_PCT]);
+    TEST_ASSERT_EQUAL(150, g_mock_zb_attr[NODE_ZB_ATTR_LEVEL_CM]);
+    TEST_ASSERT_EQUAL(WATER_LEVEL_STATUS_OK, g_mock_zb_attr[NODE_ZB_ATTR_SENSOR_STATUS]);
 }
 
 /* ============================================================================
- * TEST: PUMP CONTROL LOGIC
+ * TEST: PUMP CONTROL LOGIC (shared/node_logic/pump_control.c)
  * ============================================================================ */
 
 void test_pump_low_water_trigger(void) {
-    // Reset state
-    g_pump_running = false;
-    g_manual_override = false;
-    g_config.pump_on_threshold = 20;
-    g_config.pump_off_threshold = 80;
-    g_water_level_percent = 15;  // Below threshold
+    reset_pump();
     
-    // Set sensor as online
-    mock_set_time_us(10000000);  // 10 seconds
-    g_last_sensor_update_us = 9000000;  // 1 second ago
+    // Below threshold, reported 1 second ago
+    report_and_step(15, 9000000, 10000000);
     
-    pump_control_logic();
-    
-    TEST_ASSERT_TRUE(g_pump_running);
+    TEST_ASSERT_TRUE(g_pump.running);
+    TEST_ASSERT_EQUAL(1, g_mock_gpio_levels[NODE_PIN_RELAY]);
+    TEST_ASSERT_EQUAL(1, g_pump.state_attr);
 }
 
 void test_pump_high_water_stop(void) {
-    // Setup: pump running, water high
-    g_pump_running = true;
-    g_pump_start_time = 0;
-    g_manual_override = false;
-    g_config.pump_on_threshold = 20;
-    g_config.pump_off_threshold = 80;
-    g_water_level_percent = 85;  // Above threshold
-    
-    mock_set_time_us(10000000);
-    g_last_sensor_update_us = 9000000;
+    reset_pump();
+    pump_control_on(&g_pump);
     
-    pump_control_logic();
+    report_and_step(85, 9000000, 10000000);
     
-    TEST_ASSERT_FALSE(g_pump_running);
+    TEST_ASSERT_FALSE(g_pump.running);
+    TEST_ASSERT_EQUAL(0, g_mock_gpio_levels[NODE_PIN_RELAY]);
 }
 
 void test_pump_hysteresis(void) {
     // Water at 50% - no action should be taken
-    g_pump_running = false;
-    g_manual_override = false;
-    g_config.pump_on_threshold = 20;
-    g_config.pump_off_threshold = 80;
-    g_water_level_percent = 50;
+    reset_pump();
     
-    mock_set_time_us(10000000);
-    g_last_sensor_update_us = 9000000;
+    report_and_step(50, 9000000, 10000000);
+    
+    TEST_ASSERT_FALSE(g_pump.running);  // Should stay off
+}
+
+void test_pump_no_report_at_boot(void) {
+    // Nothing heard from the sensor yet: offline, even in the first 30 s
+    reset_pump();
+    mock_set_time_us(5000000);
     
-    pump_control_logic();
+    pump_control_step(&g_pump, &g_dc);
     
-    TEST_ASSERT_FALSE(g_pump_running);  // Should stay off
+    TEST_ASSERT_FALSE(g_pump.running);
+    TEST_ASSERT_FALSE(g_pump.sensor_connected);
 }
 
 void test_pump_timeout(void) {
-    // Pump running for too long
-    g_pump_running = true;
-    g_pump_start_time = 0;  // Started at time 0
-    g_manual_override = false;
-    g_config.pump_timeout_minutes = 60;  // 60 min = 3600 sec
-    g_water_level_percent = 50;
+    // Pump started at time 0, timeout 60 min = 3600 sec
+    reset_pump();
+    pump_control_on(&g_pump);
     
     // Time is now 3601 seconds (past timeout)
-    mock_set_time_us(3601000000LL);
-    g_last_sensor_update_us = 3600000000LL;
-    
-    pump_control_logic();
+    report_and_step(50, 3600000000LL, 3601000000LL);
     
-    TEST_ASSERT_FALSE(g_pump_running);  // Should be off due to timeout
+    TEST_ASSERT_FALSE(g_pump.running);  // Should be off due to timeout
+    TEST_ASSERT_EQUAL(3601, pump_control_runtime_sec(&g_pump));
 }
 
 void test_pump_manual_override(void) {
-    // Manual override active
-    g_pump_running = false;
-    g_manual_override = true;
-    g_manual_override_end_time = 1000;  // Ends at second 1000
-    g_water_level_percent = 90;  // High water (would normally stop pump)
+    reset_pump();
+    manual_pump_cmd_t cmd = { .command = PUMP_CMD_START_TIMED, .duration_minutes = 17 };
+    pump_control_manual(&g_pump, &cmd);
     
-    mock_set_time_us(500000000LL);  // 500 seconds (before end)
-    g_last_sensor_update_us = 499000000LL;
+    // High water (would normally stop pump), 500 s into a 1020 s override
+    report_and_step(90, 499000000LL, 500000000LL);
     
-    pump_control_logic();
-    
-    TEST_ASSERT_TRUE(g_pump_running);  // Manual override keeps it on
-    TEST_ASSERT_TRUE(g_manual_override);
+    TEST_ASSERT_TRUE(g_pump.running);  // Manual override keeps it on
+    TEST_ASSERT_TRUE(g_pump.manual_override);
+    TEST_ASSERT_EQUAL(520, pump_control_manual_remaining_sec(&g_pump));
 }
 
 void test_pump_manual_override_expire(void) {
-    // Manual override expired
-    g_pump_running = true;
-    g_manual_override = true;
-    g_manual_override_end_time = 1000;
+    reset_pump();
+    manual_pump_cmd_t cmd = { .command = PUMP_CMD_START_TIMED, .duration_minutes = 16 };
+    pump_control_manual(&g_pump, &cmd);
+    
+    // 1001 seconds (after the 960 s end)
+    report_and_step(50, 1000000000LL, 1001000000LL);
     
-    mock_set_time_us(1001000000LL);  // 1001 seconds (after end)
-    g_last_sensor_update_us = 1000000000LL;
+    TEST_ASSERT_FALSE(g_pump.running);
+    TEST_ASSERT_FALSE(g_pump.manual_override);
+}
+
+void test_pump_manual_duration_capped(void) {
+    reset_pump();
+    manual_pump_cmd_t cmd = { .command = PUMP_CMD_START_TIMED, .duration_minutes = 600 };
+    pump_control_manual(&g_pump, &cmd);
     
-    pump_control_logic();
+    // Capped to the 2 hour safety limit
+    TEST_ASSERT_EQUAL(120, g_pump.manual_duration_min);
+    TEST_ASSERT_EQUAL(7200, pump_control_manual_remaining_sec(&g_pump));
     
-    TEST_ASSERT_FALSE(g_pump_running);
-    TEST_ASSERT_FALSE(g_manual_override);
+    report_and_step(50, 7200000000LL, 7201000000LL);
+    TEST_ASSERT_FALSE(g_pump.running);
 }
 
 void test_pump_sensor_offline(void) {
     // Sensor offline (no updates for 30+ seconds)
-    g_pump_running = true;
-    g_manual_override = false;
-    g_water_level_percent = 50;
+    reset_pump();
+    pump_control_on(&g_pump);
     
-    mock_set_time_us(60000000LL);  // 60 seconds
-    g_last_sensor_update_us = 10000000LL;  // Last update at 10 sec (50 sec ago)
+    // Last update at 10 sec, now 60 sec (50 sec ago)
+    report_and_step(50, 10000000LL, 60000000LL);
     
-    pump_control_logic();
-    
-    TEST_ASSERT_FALSE(g_pump_running);  // Should stop due to sensor offline
+    TEST_ASSERT_FALSE(g_pump.running);  // Should stop due to sensor offline
 }
 
 /* ============================================================================
@@ -429,34 +367,32 @@ void test_pump_sensor_offline(void) {
  * ============================================================================ */
 
 void test_time_49_day_overflow(void) {
-    // Simulate 50 days in microseconds
     // 50 days = 50 * 24 * 60 * 60 * 1000000 = 4,320,000,000,000 us
     int64_t fifty_days_us = 50LL * 24 * 60 * 60 * 1000000;
+    reset_pump();
     
-    mock_set_time_us(fifty_days_us);
-    g_last_sensor_update_us = fifty_days_us - 1000000;  // 1 second ago
-    
-    // This should NOT overflow
-    int64_t elapsed_ms = (esp_timer_get_time() - g_last_sensor_update_us) / 1000;
+    // Reported 1 second ago: online and acted on, not seen as stale
+    report_and_step(15, fifty_days_us - 1000000, fifty_days_us);
     
-    TEST_ASSERT_EQUAL(1000, elapsed_ms);  // Should be 1000ms, not negative
+    TEST_ASSERT_TRUE(g_pump.sensor_connected);
+    TEST_ASSERT_TRUE(g_pump.running);
 }
 
 void test_time_manual_override_50_days(void) {
-    // Start manual override at day 50
+    // Start a 10 minute manual override at day 50
     int64_t fifty_days_us = 50LL * 24 * 60 * 60 * 1000000;
-    uint32_t fifty_days_sec = (uint32_t)(fifty_days_us / 1000000);
-    
+    reset_pump();
     mock_set_time_us(fifty_days_us);
+    manual_pump_cmd_t cmd = { .command = PUMP_CMD_START_TIMED, .duration_minutes = 10 };
+    pump_control_manual(&g_pump, &cmd);
     
-    // Set 10 minute override
-    g_manual_override = true;
-    g_manual_override_end_time = fifty_days_sec + 600;  // +10 min
-    g_pump_running = false;
+    mock_set_time_us(fifty_days_us + 300000000LL);
+    pump_control_step(&g_pump, &g_dc);
+    TEST_ASSERT_TRUE(g_pump.running);  // Should still work
     
-    pump_control_logic();
-    
-    TEST_ASSERT_TRUE(g_pump_running);  // Should still work
+    mock_set_time_us(fifty_days_us + 601000000LL);
+    pump_control_step(&g_pump, &g_dc);
+    TEST_ASSERT_FALSE(g_pump.running);
 }
 
 /* ============================================================================
@@ -505,6 +441,855 @@ void test_validate_report_interval(void) {
     TEST_ASSERT_FALSE(validate_report_interval(301));
 }
 
+/* ============================================================================
+ * TEST: CONFIG STORE (from shared/ble_provision/config_store.c)
+ * ============================================================================ */
+
+static void make_test_v1_image(config_v1_t *v1) {
+    memset(v1, 0, sizeof(*v1));
+    strcpy(v1->device_name, "Cultivio-Tank1");
+    strcpy(v1->custom_name, "Tank1");
+    strcpy(v1->password, "SECRET12");
+    strcpy(v1->location, "Roof");
+    v1->password_enabled = true;
+    v1->node_type = NODE_TYPE_SENSOR;
+    v1->tank_height_cm = 250;
+    v1->tank_diameter_cm = 120;
+    v1->sensor_offset_cm = 7;
+    v1->pump_on_threshold = 25;
+    v1->pump_off_threshold = 85;
+    v1->pump_timeout_minutes = 45;
+    v1->zigbee_pan_id = 0xBEEF;
+    v1->zigbee_channel = 20;
+    v1->report_interval_sec = 10;
+    v1->provisioned = true;
+    v1->provision_timestamp = 42;
+}
+
+static void reset_config_store(void) {
+    mock_nvs_reset();
+    g_store_shadow_valid = false;
+    g_store_legacy_present = false;
+    memset(&g_store_stats, 0, sizeof(g_store_stats));
+}
+
+void test_config_crc32_vector(void) {
+    TEST_ASSERT(config_crc32((const uint8_t *)"123456789", 9) == 0xCBF43926);
+}
+
+void test_config_ident_roundtrip(void) {
+    device_config_t in, out;
+    uint8_t buf[CONFIG_IDENT_MAX_LEN];
+    make_test_device_config(&in);
+    memset(&out, 0, sizeof(out));
+    
+    size_t len = config_ident_encode(&in, buf);
+    TEST_ASSERT_EQUAL(CONFIG_IDENT_HEADER_LEN + CONFIG_IDENT_PAYLOAD_LEN, len);
+    TEST_ASSERT_EQUAL(ESP_OK, config_ident_decode(buf, len, &out));
+    TEST_ASSERT(strcmp(out.custom_name, "Flat301") == 0);
+    TEST_ASSERT(strcmp(out.location, "Building A, 3rd Floor") == 0);
+    TEST_ASSERT_EQUAL(NODE_TYPE_CONTROLLER, out.node_type);
+    TEST_ASSERT_EQUAL(0x1234, out.zigbee_pan_id);
+    TEST_ASSERT_EQUAL(123456, out.provision_timestamp);
+    TEST_ASSERT_EQUAL(0, out.pump_on_threshold);  // Hot field, not in record
+}
+
+void test_config_ident_corruption(void) {
+    device_config_t cfg;
+    uint8_t buf[CONFIG_IDENT_MAX_LEN];
+    make_test_device_config(&cfg);
+    size_t len = config_ident_encode(&cfg, buf);
+    
+    buf[CONFIG_IDENT_HEADER_LEN + 10] ^= 0x01;
+    TEST_ASSERT_EQUAL(ESP_ERR_INVALID_CRC, config_ident_decode(buf, len, &cfg));
+    buf[CONFIG_IDENT_HEADER_LEN + 10] ^= 0x01;
+    
+    TEST_ASSERT_EQUAL(ESP_ERR_INVALID_SIZE, config_ident_decode(buf, len - 1, &cfg));
+    buf[0] = 2;
+    TEST_ASSERT_EQUAL(ESP_ERR_INVALID_VERSION, config_ident_decode(buf, len, &cfg));
+}
+
+void test_config_ident_newer_version(void) {
+    // Newer firmware appends fields: an older build still reads its part
+    device_config_t in, out;
+    uint8_t buf[CONFIG_IDENT_MAX_LEN];
+    make_test_device_config(&in);
+    config_ident_encode(&in, buf);
+    
+    uint8_t *p = buf + CONFIG_IDENT_HEADER_LEN;
+    uint16_t longer = CONFIG_IDENT_PAYLOAD_LEN + 4;
+    memset(p + CONFIG_IDENT_PAYLOAD_LEN, 0xAA, 4);
+    buf[0] = CONFIG_SCHEMA_VERSION + 1;
+    put_u16(buf + 2, longer);
+    put_u32(buf + 4, config_crc32(p, longer));
+    
+    memset(&out, 0, sizeof(out));
+    TEST_ASSERT_EQUAL(ESP_OK, config_ident_decode(buf, CONFIG_IDENT_HEADER_LEN + longer, &out));
+    TEST_ASSERT(strcmp(out.device_name, in.device_name) == 0);
+}
+
+void test_config_migrate_v1(void) {
+    config_v1_t v1;
+    device_config_t cfg;
+    uint8_t from = 0;
+    make_test_v1_image(&v1);
+    
+    TEST_ASSERT_EQUAL(ESP_OK, config_migrate_legacy((const uint8_t *)&v1, sizeof(v1), &cfg, &from));
+    TEST_ASSERT_EQUAL(1, from);
+    TEST_ASSERT(strcmp(cfg.device_name, "Cultivio-Tank1") == 0);
+    TEST_ASSERT(strcmp(cfg.password, "SECRET12") == 0);
+    TEST_ASSERT_EQUAL(NODE_TYPE_SENSOR, cfg.node_type);
+    TEST_ASSERT_EQUAL(250, cfg.tank_height_cm);
+    TEST_ASSERT_EQUAL(85, cfg.pump_off_threshold);
+    TEST_ASSERT_EQUAL(45, cfg.pump_timeout_minutes);
+    TEST_ASSERT_EQUAL(0xBEEF, cfg.zigbee_pan_id);
+    TEST_ASSERT_EQUAL(10, cfg.report_interval_sec);
+    TEST_ASSERT_TRUE(cfg.provisioned);
+    TEST_ASSERT_EQUAL(42, cfg.provision_timestamp);
+    TEST_ASSERT_EQUAL(BLE_ADV_POLICY_ROLE_DEFAULT, cfg.ble_adv_policy);
+    TEST_ASSERT_EQUAL(0, cfg.ble_triggers);
+    TEST_ASSERT_EQUAL(0, cfg.ble_idle_timeout_sec);
+}
+
+void test_config_migrate_v2_sanitizes(void) {
+    config_v2_t v2;
+    device_config_t cfg;
+    uint8_t from = 0;
+    memset(&v2, 0, sizeof(v2));
+    strcpy(v2.device_name, "Cultivio-Pump");
+    v2.pump_on_threshold = 30;
+    v2.ble_adv_policy = BLE_ADV_POLICY_DECAY;
+    v2.ble_triggers = 0xF5;            // Unknown high bits
+    v2.ble_idle_timeout_sec = 10;      // Below the 30 s minimum
+    
+    TEST_ASSERT_EQUAL(ESP_OK, config_migrate_legacy((const uint8_t *)&v2, sizeof(v2), &cfg, &from));
+    TEST_ASSERT_EQUAL(2, from);
+    TEST_ASSERT(strcmp(cfg.device_name, "Cultivio-Pump") == 0);
+    TEST_ASSERT_EQUAL(30, cfg.pump_on_threshold);
+    TEST_ASSERT_EQUAL(BLE_ADV_POLICY_DECAY, cfg.ble_adv_policy);
+    TEST_ASSERT_EQUAL(0x05, cfg.ble_triggers);
+    TEST_ASSERT_EQUAL(0, cfg.ble_idle_timeout_sec);
+    
+    v2.ble_adv_policy = 0xFF;
+    config_migrate_legacy((const uint8_t *)&v2, sizeof(v2), &cfg, NULL);
+    TEST_ASSERT_EQUAL(BLE_ADV_POLICY_ROLE_DEFAULT, cfg.ble_adv_policy);
+}
+
+void test_config_migrate_unknown_size(void) {
+    uint8_t blob[100] = {0};
+    device_config_t cfg;
+    TEST_ASSERT_EQUAL(ESP_ERR_INVALID_SIZE, config_migrate_legacy(blob, sizeof(blob), &cfg, NULL));
+}
+
+void test_config_store_boot_migration(void) {
+    config_v1_t v1;
+    device_config_t cfg;
+    config_store_stats_t stats;
+    reset_config_store();
+    make_test_v1_image(&v1);
+    nvs_set_blob(1, "config", &v1, sizeof(v1));
+    
+    // First boot on new firmware: migrate and rewrite as schema 3
+    memset(&cfg, 0, sizeof(cfg));
+    TEST_ASSERT_EQUAL(ESP_OK, config_store_load(&cfg));
+    config_store_get_stats(&stats);
+    TEST_ASSERT_EQUAL(1, stats.loaded_version);
+    TEST_ASSERT(mock_nvs_find("config") == NULL);
+    TEST_ASSERT(mock_nvs_find("ident") != NULL);
+    TEST_ASSERT(mock_nvs_find("cfg_ver") != NULL);
+    
+    // Second boot: read schema 3 directly
+    g_store_shadow_valid = false;
+    device_config_t again;
+    memset(&again, 0, sizeof(again));
+    TEST_ASSERT_EQUAL(ESP_OK, config_store_load(&again));
+    config_store_get_stats(&stats);
+    TEST_ASSERT_EQUAL(CONFIG_SCHEMA_VERSION, stats.loaded_version);
+    TEST_ASSERT(strcmp(again.location, "Roof") == 0);
+    TEST_ASSERT_EQUAL(25, again.pump_on_threshold);
+    TEST_ASSERT_EQUAL(45, again.pump_timeout_minutes);
+    TEST_ASSERT_EQUAL(10, again.report_interval_sec);
+}
+
+void test_config_store_hot_write_only(void) {
+    device_config_t cfg;
+    config_store_stats_t stats;
+    reset_config_store();
+    make_test_device_config(&cfg);
+    TEST_ASSERT_EQUAL(ESP_OK, config_store_save(&cfg));
+    
+    // Threshold tweak: one small key, identity record untouched
+    int writes_before = g_mock_nvs_writes;
+    int bytes_before = g_mock_nvs_bytes;
+    cfg.pump_on_threshold = 30;
+    TEST_ASSERT_EQUAL(ESP_OK, config_store_save(&cfg));
+    config_store_get_stats(&stats);
+    TEST_ASSERT_EQUAL(1, stats.cold_writes);
+    TEST_ASSERT_EQUAL(1, g_mock_nvs_writes - writes_before);
+    TEST_ASSERT_EQUAL(1, g_mock_nvs_bytes - bytes_before);
+    
+    // Unchanged save writes nothing
+    writes_before = g_mock_nvs_writes;
+    TEST_ASSERT_EQUAL(ESP_OK, config_store_save(&cfg));
+    TEST_ASSERT_EQUAL(0, g_mock_nvs_writes - writes_before);
+    
+    // Rename rewrites the record only
+    strcpy(cfg.custom_name, "Flat302");
+    writes_before = g_mock_nvs_writes;
+    TEST_ASSERT_EQUAL(ESP_OK, config_store_save(&cfg));
+    TEST_ASSERT_EQUAL(1, g_mock_nvs_writes - writes_before);
+    config_store_get_stats(&stats);
+    TEST_ASSERT_EQUAL(2, stats.cold_writes);
+}
+
+void test_config_store_corrupt_record(void) {
+    device_config_t cfg, loaded;
+    reset_config_store();
+    make_test_device_config(&cfg);
+    config_store_save(&cfg);
+    
+    mock_nvs_entry_t *e = mock_nvs_find("ident");
+    TEST_ASSERT(e != NULL);
+    if (e) e->value[CONFIG_IDENT_HEADER_LEN + 3] ^= 0x40;
+    
+    // Defaults kept on CRC failure
+    memset(&loaded, 0, sizeof(loaded));
+    loaded.tank_height_cm = 200;
+    g_store_shadow_valid = false;
+    TEST_ASSERT_EQUAL(ESP_ERR_INVALID_CRC, config_store_load(&loaded));
+    TEST_ASSERT_EQUAL(200, loaded.tank_height_cm);
+    TEST_ASSERT_FALSE(loaded.provisioned);
+}
+
+void test_config_store_empty(void) {
+    device_config_t cfg;
+    reset_config_store();
+    memset(&cfg, 0, sizeof(cfg));
+    cfg.pump_on_threshold = 20;
+    TEST_ASSERT_EQUAL(ESP_ERR_NVS_NOT_FOUND, config_store_load(&cfg));
+    TEST_ASSERT_EQUAL(20, cfg.pump_on_threshold);
+}
+
+/* ============================================================================
+ * TEST: DERIVED CONFIG (from shared/ble_provision/config_derived.c)
+ * ============================================================================ */
+
+void test_derived_defaults(void) {
+    device_config_t cfg;
+    config_derived_t dc;
+    memset(&cfg, 0, sizeof(cfg));
+    config_derive(&cfg, &dc);
+    
+    TEST_ASSERT_TRUE(dc.defaults_applied);
+    TEST_ASSERT_EQUAL(CONFIG_DEFAULT_TANK_HEIGHT_CM, dc.tank_height_cm);
+    TEST_ASSERT_EQUAL(CONFIG_DEFAULT_PUMP_ON_PCT, dc.pump_on_pct);
+    TEST_ASSERT_EQUAL(CONFIG_DEFAULT_PUMP_OFF_PCT, dc.pump_off_pct);
+    TEST_ASSERT_EQUAL(3600, dc.pump_timeout_sec);
+    TEST_ASSERT_EQUAL(5000, dc.report_interval_ms);
+    TEST_ASSERT_EQUAL(0, dc.capacity_litres);  // No diameter, no volume
+}
+
+void test_derived_precomputed(void) {
+    device_config_t cfg;
+    config_derived_t dc;
+    make_test_device_config(&cfg);
+    config_derive(&cfg, &dc);
+    
+    TEST_ASSERT_FALSE(dc.defaults_applied);
+    TEST_ASSERT_FALSE(dc.pump_timeout_capped);
+    TEST_ASSERT(dc.pct_per_cm > 0.4999f && dc.pct_per_cm < 0.5001f);    // 100 / 200 cm
+    TEST_ASSERT(dc.max_distance_cm == 250.0f);
+    TEST_ASSERT(dc.litres_per_cm > 7.85f && dc.litres_per_cm < 7.86f);  // r = 50 cm
+    TEST_ASSERT_EQUAL(1570, dc.capacity_litres);
+    TEST_ASSERT(dc.pump_timeout_us == 3600LL * 1000000);
+}
+
+void test_derived_timeout_cap(void) {
+    device_config_t cfg;
+    config_derived_t dc;
+    make_test_device_config(&cfg);
+    cfg.pump_timeout_minutes = 60000;   // Would overflow uint16_t * 60
+    config_derive(&cfg, &dc);
+    
+    TEST_ASSERT_TRUE(dc.pump_timeout_capped);
+    TEST_ASSERT_EQUAL(CONFIG_MAX_PUMP_TIMEOUT_SEC, dc.pump_timeout_sec);
+    TEST_ASSERT(dc.pump_timeout_us == (int64_t)CONFIG_MAX_PUMP_TIMEOUT_SEC * 1000000);
+}
+
+void test_derived_hysteresis_band(void) {
+    device_config_t cfg;
+    config_derived_t dc;
+    make_test_device_config(&cfg);
+    
+    // Inverted band falls back to defaults as a pair
+    cfg.pump_on_threshold = 90;
+    cfg.pump_off_threshold = 50;
+    config_derive(&cfg, &dc);
+    TEST_ASSERT_EQUAL(CONFIG_DEFAULT_PUMP_ON_PCT, dc.pump_on_pct);
+    TEST_ASSERT_EQUAL(CONFIG_DEFAULT_PUMP_OFF_PCT, dc.pump_off_pct);
+    
+    // OFF unset with ON above the OFF default: still a valid band
+    cfg.pump_on_threshold = 85;
+    cfg.pump_off_threshold = 0;
+    config_derive(&cfg, &dc);
+    TEST_ASSERT(dc.pump_on_pct < dc.pump_off_pct);
+}
+
+/* ============================================================================
+ * TEST: RUNTIME METRICS
+ * ============================================================================ */
+
+void test_metrics_pump_counters(void) {
+    reset_pump();
+    metrics_reset();
+    
+    report_and_step(15, 1000000LL, 2000000LL);          // Low: pump ON
+    TEST_ASSERT_TRUE(g_pump.running);
+    mock_set_time_us(40000000LL);                       // 39 s without a report
+    pump_control_step(&g_pump, &g_dc);
+    TEST_ASSERT_FALSE(g_pump.running);
+    
+    TEST_ASSERT_EQUAL(1, metrics_get(METRIC_REPORTS_RECEIVED));
+    TEST_ASSERT_EQUAL(2, metrics_get(METRIC_PUMP_TRANSITIONS));
+    TEST_ASSERT_EQUAL(1, metrics_get(METRIC_SENSOR_TIMEOUTS));
+    
+    // Wrong-type updates are ignored
+    metrics_set(METRIC_PUMP_TRANSITIONS, 100);
+    metrics_inc(METRIC_LINK_RSSI);
+    TEST_ASSERT_EQUAL(2, metrics_get(METRIC_PUMP_TRANSITIONS));
+    TEST_ASSERT_EQUAL(0, metrics_get(METRIC_LINK_RSSI));
+}
+
+void test_metrics_histogram_buckets(void) {
+    metrics_reset();
+    int64_t samples[] = { -5, 0, 15, 16, 63, 64, 65535, 65536, 10000000000LL };
+    for (size_t i = 0; i < sizeof(samples) / sizeof(samples[0]); i++) {
+        metrics_observe_us(METRIC_ZB_LOCK_WAIT_US, samples[i]);
+    }
+    
+    metrics_hist_t h;
+    metrics_get_hist(METRIC_ZB_LOCK_WAIT_US, &h);
+    TEST_ASSERT_EQUAL(9, h.count);
+    TEST_ASSERT_EQUAL(UINT32_MAX, h.max_us);            // Saturated, not wrapped
+    TEST_ASSERT_EQUAL(3, h.buckets[0]);                 // < 16 us
+    TEST_ASSERT_EQUAL(2, h.buckets[1]);                 // < 64 us
+    TEST_ASSERT_EQUAL(1, h.buckets[2]);
+    TEST_ASSERT_EQUAL(1, h.buckets[6]);                 // < 65536 us
+    TEST_ASSERT_EQUAL(2, h.buckets[7]);
+    
+    // Other histograms untouched
+    metrics_get_hist(METRIC_ZB_CALLBACK_US, &h);
+    TEST_ASSERT_EQUAL(0, h.count);
+}
+
+void test_metrics_snapshot_roundtrip(void) {
+    metrics_reset();
+    mock_set_time_us(3600LL * 1000000);
+    metrics_add(METRIC_REPORTS_SENT, 70000);
+    metrics_set(METRIC_LINK_RSSI, -87);
+    for (int i = 0; i < 70000; i++) {
+        metrics_observe_us(METRIC_ZB_CALLBACK_US, 100);
+    }
+    
+    uint8_t buf[METRICS_ENCODED_MAX + METRICS_SIZE_COUNTER];
+    // Zigbee splits it over two octet string attributes (unified_main.c)
+    size_t part1 = metrics_encode_range(buf, 254, 0, METRIC_E2E_SAMPLE_RX_MS);
+    size_t part2 = metrics_encode_range(buf, 254, METRIC_E2E_SAMPLE_RX_MS, METRIC_COUNT);
+    TEST_ASSERT(part1 > 0 && part2 > 0);
+    TEST_ASSERT_EQUAL(METRICS_ENCODED_MAX + METRICS_HEADER_SIZE, part1 + part2);
+    
+    TEST_ASSERT_EQUAL(0, metrics_encode(buf, METRICS_ENCODED_MAX - 1));
+    size_t len = metrics_encode(buf, sizeof(buf));
+    TEST_ASSERT_EQUAL(METRICS_ENCODED_MAX, len);
+    
+    metrics_snapshot_t snap;
+    TEST_ASSERT_EQUAL(ESP_OK, metrics_decode(buf, len, &snap));
+    TEST_ASSERT_EQUAL(3600, snap.uptime_s);
+    TEST_ASSERT_EQUAL(70000, snap.value[METRIC_REPORTS_SENT]);
+    TEST_ASSERT_EQUAL(-87, snap.value[METRIC_LINK_RSSI]);
+    TEST_ASSERT_EQUAL(70000, snap.hist[METRIC_ZB_CALLBACK_US].count);
+    TEST_ASSERT_EQUAL(100, snap.hist[METRIC_ZB_CALLBACK_US].max_us);
+    TEST_ASSERT_EQUAL(65535, snap.hist[METRIC_ZB_CALLBACK_US].buckets[2]);  // Saturated
+    
+    // A metric from newer firmware is skipped
+    uint8_t *extra = buf + len;
+    memset(extra, 0, METRICS_SIZE_COUNTER);
+    extra[0] = 200;
+    extra[1] = METRIC_TYPE_COUNTER;
+    buf[1]++;
+    TEST_ASSERT_EQUAL(ESP_OK, metrics_decode(buf, len + METRICS_SIZE_COUNTER, &snap));
+    TEST_ASSERT_EQUAL(70000, snap.value[METRIC_REPORTS_SENT]);
+    
+    // Truncated and foreign input
+    TEST_ASSERT_EQUAL(ESP_ERR_INVALID_SIZE, metrics_decode(buf, len - 1, &snap));
+    buf[0] = METRICS_FORMAT_VERSION + 1;
+    TEST_ASSERT_EQUAL(ESP_ERR_INVALID_VERSION, metrics_decode(buf, len, &snap));
+}
+
+/* ============================================================================
+ * TEST: EVENT TRACE
+ * ============================================================================ */
+
+#define TRACE_TEST_MAX (TRACE_RING_SLOTS + 8)
+
+static trace_event_t g_traced[TRACE_TEST_MAX];
+static int g_traced_count;
+
+static void collect_trace(const trace_event_t *ev, void *ctx) {
+    (void)ctx;
+    if (g_traced_count < TRACE_TEST_MAX) {
+        g_traced[g_traced_count++] = *ev;
+    }
+}
+
+static void drain_trace(void) {
+    g_traced_count = 0;
+    trace_drain(collect_trace, NULL, TRACE_TEST_MAX);
+}
+
+void test_trace_pump_events(void) {
+    reset_pump();
+    trace_reset();
+    
+    report_and_step(15, 1000000LL, 2000000LL);          // Low: pump ON
+    drain_trace();
+    TEST_ASSERT_EQUAL(4, g_traced_count);
+    TEST_ASSERT_EQUAL(TRACE_CONTROL_PASS, g_traced[0].id);
+    TEST_ASSERT_EQUAL(TRACE_WATER_LOW, g_traced[1].id);
+    TEST_ASSERT_EQUAL(TRACE_PUMP_ON, g_traced[2].id);
+    TEST_ASSERT_EQUAL(2000000, g_traced[2].t_us);
+    TEST_ASSERT_EQUAL(TRACE_CONTROL_PASS_END, g_traced[3].id);
+    TEST_ASSERT_EQUAL(1, g_traced[3].arg[0]);                 // Pump on when the pass ended
+    TEST_ASSERT_EQUAL(TRACE_KIND_BEGIN, trace_event_kind(g_traced[0].id));
+    TEST_ASSERT_EQUAL(TRACE_KIND_END, trace_event_kind(g_traced[3].id));
+    
+    char text[TRACE_TEXT_MAX], expected[TRACE_TEXT_MAX];
+    trace_format(&g_traced[1], text, sizeof(text));
+    snprintf(expected, sizeof(expected), "Water LOW (15%% <= %d%%), pump ON", g_dc.pump_on_pct);
+    TEST_ASSERT(strcmp(text, expected) == 0);
+    trace_format(&g_traced[2], text, sizeof(text));
+    TEST_ASSERT(strcmp(text, ">>> PUMP ON <<< Water level: 15%") == 0);
+    TEST_ASSERT(strcmp(trace_event_tag(g_traced[2].id), "PUMP") == 0);
+    TEST_ASSERT(strcmp(trace_event_name(g_traced[2].id), "PUMP_ON") == 0);
+    
+    // Nothing twice
+    drain_trace();
+    TEST_ASSERT_EQUAL(0, g_traced_count);
+}
+
+void test_trace_overrun_reports_drops(void) {
+    trace_reset();
+    for (int i = 0; i < TRACE_RING_SLOTS + 10; i++) {
+        TRACE(PUMP_OFF, i);
+    }
+    drain_trace();
+    
+    // The oldest 10 were overwritten: one DROPPED, then the rest in order
+    TEST_ASSERT_EQUAL(TRACE_RING_SLOTS + 1, g_traced_count);
+    TEST_ASSERT_EQUAL(TRACE_DROPPED, g_traced[0].id);
+    TEST_ASSERT_EQUAL(10, g_traced[0].arg[0]);
+    TEST_ASSERT_EQUAL(10, g_traced[1].arg[0]);
+    TEST_ASSERT_EQUAL(TRACE_RING_SLOTS + 9, g_traced[TRACE_RING_SLOTS].arg[0]);
+    
+    trace_stats_t stats;
+    trace_get_stats(&stats);
+    TEST_ASSERT_EQUAL(10, stats.dropped);
+}
+
+void test_trace_stream_codec(void) {
+    trace_event_t ev = { .t_us = 0xFFFFFFF0u, .id = TRACE_WATER_LEVEL, .task = 7, .nargs = 3,
+                         .arg = { 42, 180, 2100 } };
+    uint8_t rec[2 * TRACE_REC_MAX_SIZE];
+    size_t len = trace_encode(&ev, rec);
+    TEST_ASSERT_EQUAL(TRACE_REC_HEADER_SIZE + 12, len);
+    
+    char line[128];
+    trace_line_encode(rec, len, line, sizeof(line));
+    char noisy[160];
+    snprintf(noisy, sizeof(noisy), "I (5120) APP: %s\r", line);  // Serial log framing
+    uint8_t back[sizeof(rec)];
+    TEST_ASSERT_EQUAL((int)len, trace_line_decode(noisy, back, sizeof(back)));
+    TEST_ASSERT_EQUAL(-1, trace_line_decode("I (5120) APP: no trace here", back, sizeof(back)));
+    
+    trace_event_t out;
+    TEST_ASSERT_EQUAL(0, trace_decode(back, len - 1, &out));         // Truncated
+    TEST_ASSERT_EQUAL(len, trace_decode(back, len, &out));
+    TEST_ASSERT_EQUAL(0xFFFFFFF0u, out.t_us);
+    TEST_ASSERT_EQUAL(7, out.task);
+    TEST_ASSERT_EQUAL(2100, out.arg[2]);
+    char text[TRACE_TEXT_MAX];
+    trace_format(&out, text, sizeof(text));
+    TEST_ASSERT(strcmp(text, "Water Level: 42% (180 cm, 2100 L)") == 0);
+}
+
+void test_trace_names_tasks_once(void) {
+    trace_reset();
+    g_trace_task = 3;
+    TRACE(PUMP_OFF, 10);
+    TRACE(PUMP_OFF, 20);
+    g_trace_task = 4;                                       // No name known
+    TRACE(PUMP_OFF, 30);
+    g_trace_task = 0;
+    TRACE(PUMP_OFF, 40);
+    
+    g_traced_count = 0;
+    trace_drain_named(collect_trace, NULL, TRACE_TEST_MAX);
+    TEST_ASSERT_EQUAL(5, g_traced_count);
+    TEST_ASSERT_EQUAL(TRACE_TASK_NAME, g_traced[0].id);
+    TEST_ASSERT_EQUAL(3, g_traced[0].arg[0]);
+    TEST_ASSERT_EQUAL(3, g_traced[1].task);
+    TEST_ASSERT_EQUAL(3, g_traced[2].task);
+    TEST_ASSERT_EQUAL(4, g_traced[3].task);
+    TEST_ASSERT_EQUAL(0, g_traced[4].task);
+    char name[TRACE_TASK_NAME_LEN + 1];
+    trace_task_name(&g_traced[0], name);
+    TEST_ASSERT(strcmp(name, "control_task") == 0);
+    
+    // Announced once per reset
+    g_trace_task = 3;
+    TRACE(PUMP_OFF, 50);
+    g_trace_task = 0;
+    g_traced_count = 0;
+    trace_drain_named(collect_trace, NULL, TRACE_TEST_MAX);
+    TEST_ASSERT_EQUAL(1, g_traced_count);
+}
+
+/* ============================================================================
+ * MICROBENCHMARK TESTS
+ * ============================================================================ */
+
+static void bench_fixed_cost(void *ctx) {
+    g_bench_cycles += (uintptr_t)ctx;
+}
+
+void test_bench_batches_and_stats(void) {
+    g_bench_cycles = 0;
+    bench_case_t c = { "fixed", bench_fixed_cost, (void *)(uintptr_t)10 };
+    bench_config_t cfg = BENCH_CONFIG_DEFAULT();
+    bench_result_t r;
+    TEST_ASSERT_EQUAL(ESP_OK, bench_run(&c, &cfg, &r));
+    
+    // Batch doubled until a sample reaches BENCH_MIN_SAMPLE_CYCLES
+    TEST_ASSERT_EQUAL(2048, r.batch);
+    TEST_ASSERT_EQUAL(64, r.samples);
+    TEST_ASSERT(r.min_cycles == 10 && r.median_cycles == 10 && r.max_cycles == 10);
+    TEST_ASSERT(r.stddev_cycles == 0);
+    TEST_ASSERT(r.median_ns == 10);
+    
+    cfg.samples = BENCH_MAX_SAMPLES + 1;
+    TEST_ASSERT_EQUAL(ESP_ERR_INVALID_ARG, bench_run(&c, &cfg, &r));
+}
+
+void test_bench_json_roundtrip(void) {
+    bench_config_t cfg = BENCH_CONFIG_DEFAULT();
+    bench_result_t a = { .name = "alpha", .batch = 8, .samples = 64, .median_ns = 12.5 };
+    bench_result_t b = { .name = "beta", .batch = 4, .samples = 64, .median_cycles = 99, .median_ns = 3 };
+    
+    FILE *f = tmpfile();
+    TEST_ASSERT(f != NULL);
+    bench_json_t j;
+    bench_json_open(&j, f, "abc123", &cfg);
+    bench_json_add(&j, &a);
+    bench_json_add(&j, &b);
+    bench_json_close(&j);
+    char text[1024];
+    rewind(f);
+    text[fread(text, 1, sizeof(text) - 1, f)] = '\0';
+    fclose(f);
+    
+    TEST_ASSERT(strstr(text, "\"label\":\"abc123\"") != NULL);
+    double v;
+    TEST_ASSERT_EQUAL(ESP_OK, bench_json_find(text, "alpha", "median_ns", &v));
+    TEST_ASSERT(v == 12.5);
+    TEST_ASSERT_EQUAL(ESP_OK, bench_json_find(text, "beta", "median_cycles", &v));
+    TEST_ASSERT(v == 99);
+    TEST_ASSERT_EQUAL(ESP_ERR_NOT_FOUND, bench_json_find(text, "gamma", "median_ns", &v));
+    TEST_ASSERT_EQUAL(ESP_ERR_NOT_FOUND, bench_json_find(text, "alpha", "bogus", &v));
+}
+
+/* ============================================================================
+ * ENERGY ACCOUNTING TESTS
+ * ============================================================================ */
+
+static bool near(float a, float b) {
+    return fabsf(a - b) <= 1e-3f * (fabsf(b) > 1 ? fabsf(b) : 1);
+}
+
+void test_energy_config_day(void) {
+    energy_config_t cfg = { .report_interval_s = 60, .samples = 5, .ping_us = 10000, .keep_alive_ms = 3000 };
+    energy_ledger_t day;
+    energy_from_config(&cfg, &day);
+    TEST_ASSERT_EQUAL(1440, day.events[ENERGY_EV_WAKEUP]);
+    TEST_ASSERT_EQUAL(7200, day.events[ENERGY_EV_PING]);
+    TEST_ASSERT_EQUAL(28800, day.events[ENERGY_EV_ZB_POLL]);
+    TEST_ASSERT(day.state_us[ENERGY_ULTRASONIC] == 72000000);
+    // 1440 reports + 28800 polls on air
+    TEST_ASSERT(day.state_us[ENERGY_RADIO_TX] == 1440LL * ENERGY_ZB_FRAME_TX_US + 28800LL * ENERGY_ZB_POLL_TX_US);
+    int64_t total = 0;
+    for (int s = 0; s < ENERGY_STATE_COUNT; s++) {
+        total += day.state_us[s];
+    }
+    TEST_ASSERT(total == ENERGY_DAY_US);
+    
+    // Only the module's standby current: 1 mA all day
+    energy_model_t model = ENERGY_MODEL_DEFAULT();
+    memset(model.ma, 0, sizeof(model.ma));
+    TEST_ASSERT_EQUAL(ESP_OK, energy_model_set(&model, "us_standby", 1.0f));
+    TEST_ASSERT_EQUAL(ESP_ERR_NOT_FOUND, energy_model_set(&model, "bogus", 1.0f));
+    energy_estimate_t est;
+    TEST_ASSERT_EQUAL(ESP_OK, energy_estimate(&day, &model, &est));
+    TEST_ASSERT(near(est.mah_per_day, 24.0f) && near(est.avg_ma, 1.0f));
+    TEST_ASSERT(near(est.battery_days, 2600.0f * 0.8f / 24.0f));
+    
+    // The radio adds 20 mA for its time on air
+    energy_model_set(&model, "tx", 20.0f);
+    energy_estimate(&day, &model, &est);
+    TEST_ASSERT(near(est.mah_state[ENERGY_RADIO_TX], 20.0f * 25.92f / 3600.0f));
+}
+
+void test_energy_ledger_scales_to_day(void) {
+    mock_set_time_us(1000000);
+    energy_reset();
+    energy_set_poll_interval_ms(0);
+    energy_count(ENERGY_EV_WAKEUP, 2);
+    energy_add_us(ENERGY_ULTRASONIC, 1000000);
+    energy_add_us(ENERGY_SLEEP, 5000000);           // Derived, not added
+    mock_advance_time_sec(12 * 3600);
+    
+    energy_ledger_t l;
+    energy_get(&l);
+    TEST_ASSERT(l.elapsed_us == 12 * 3600 * 1000000LL);
+    TEST_ASSERT(l.state_us[ENERGY_CPU_ACTIVE] == 2 * ENERGY_WAKE_CPU_US);
+    TEST_ASSERT(l.state_us[ENERGY_SLEEP] == l.elapsed_us - 1000000 - 2 * ENERGY_WAKE_CPU_US);
+    
+    // 36 mA for 1 s in half a day: 0.02 mAh per day
+    energy_model_t model = ENERGY_MODEL_DEFAULT();
+    memset(model.ma, 0, sizeof(model.ma));
+    model.ma[ENERGY_MA_ULTRASONIC] = 36.0f;
+    energy_estimate_t est;
+    TEST_ASSERT_EQUAL(ESP_OK, energy_estimate(&l, &model, &est));
+    TEST_ASSERT(near(est.mah_per_day, 0.02f));
+    
+    energy_reset();
+    energy_get(&l);
+    TEST_ASSERT_EQUAL(ESP_ERR_INVALID_ARG, energy_estimate(&l, &model, &est));
+}
+
+/* ============================================================================
+ * END-TO-END LATENCY TESTS
+ * ============================================================================ */
+
+void test_e2e_stamp_roundtrip(void) {
+    e2e_stamp_t in = { .level_pct = 42, .status = 1, .seq = 0xBEEF,
+                       .sample_ms = 0xFFFFFF00u, .flags = E2E_STAMP_SYNCED };
+    uint8_t attr[E2E_STAMP_ATTR_SIZE + 2];
+    e2e_stamp_encode(&in, attr);
+    TEST_ASSERT_EQUAL(E2E_STAMP_LEN, attr[0]);
+    
+    e2e_stamp_t out;
+    TEST_ASSERT_EQUAL(ESP_OK, e2e_stamp_decode(attr, E2E_STAMP_ATTR_SIZE, &out));
+    TEST_ASSERT_EQUAL(42, out.level_pct);
+    TEST_ASSERT_EQUAL(0xBEEF, out.seq);
+    TEST_ASSERT(out.sample_ms == 0xFFFFFF00u);
+    TEST_ASSERT_EQUAL(E2E_STAMP_SYNCED, out.flags);
+    
+    // Short stamps are rejected, longer ones (newer firmware) decode
+    TEST_ASSERT_EQUAL(ESP_ERR_INVALID_SIZE, e2e_stamp_decode(attr, E2E_STAMP_ATTR_SIZE - 1, &out));
+    attr[0] = E2E_STAMP_LEN - 1;
+    TEST_ASSERT_EQUAL(ESP_ERR_INVALID_SIZE, e2e_stamp_decode(attr, E2E_STAMP_ATTR_SIZE, &out));
+    attr[0] = E2E_STAMP_LEN + 2;
+    TEST_ASSERT_EQUAL(ESP_OK, e2e_stamp_decode(attr, sizeof(attr), &out));
+    TEST_ASSERT_EQUAL(0xBEEF, out.seq);
+}
+
+void test_e2e_sequence_and_latency(void) {
+    reset_pump();
+    metrics_reset();
+    e2e_reset();
+    e2e_stamp_t st = { .level_pct = 50, .seq = 0xFFFE, .sample_ms = 900, .flags = E2E_STAMP_SYNCED };
+    TEST_ASSERT_TRUE(e2e_report_rx(0x1001, &st, 1000));     // New sensor
+    TEST_ASSERT_FALSE(e2e_report_rx(0x1001, &st, 1100));    // Retry of the same report
+    
+    st.seq = 0x0001;                                        // 0xFFFF and 0x0000 lost
+    st.sample_ms = 0xFFFFFFF0u;                             // Across the ms wrap
+    e2e_report_rx(0x1001, &st, 0x10);
+    st.seq = 0x0002;
+    st.flags = 0;                                           // Not synced: no latency
+    TEST_ASSERT_TRUE(e2e_report_rx(0x1001, &st, 0x20));     // but the time again
+    
+    e2e_sensor_t s[E2E_MAX_SENSORS];
+    TEST_ASSERT_EQUAL(1, e2e_get_sensors(s, E2E_MAX_SENSORS));
+    TEST_ASSERT_EQUAL(3, s[0].reports);
+    TEST_ASSERT_EQUAL(1, s[0].duplicates);
+    TEST_ASSERT_EQUAL(2, s[0].seq_gaps);
+    TEST_ASSERT_EQUAL(2, metrics_get(METRIC_REPORT_SEQ_GAPS));
+    TEST_ASSERT_EQUAL(2, s[0].sample_rx.count);
+    TEST_ASSERT_EQUAL(100, s[0].sample_rx.max_us);          // ms
+    TEST_ASSERT_EQUAL(1, s[0].sample_rx.buckets[1]);        // 32 ms
+    
+    // The control pass switches the relay on a low level 30 ms later
+    mock_set_time_us(1000000);
+    st.seq = 3;
+    st.level_pct = 10;
+    e2e_report_rx(0x1001, &st, net_time_now_ms(NULL));
+    pump_control_sensor_update(&g_pump, st.level_pct);
+    mock_advance_time_ms(30);
+    pump_control_step(&g_pump, &g_dc);
+    TEST_ASSERT_TRUE(g_pump.running);
+    e2e_get_sensors(s, E2E_MAX_SENSORS);
+    TEST_ASSERT_EQUAL(1, s[0].rx_relay.count);
+    TEST_ASSERT_EQUAL(30, s[0].rx_relay.max_us);
+    
+    // Only a report can be relayed once
+    mock_advance_time_ms(10);
+    e2e_relay_switched(net_time_now_ms(NULL));
+    metrics_hist_t h;
+    metrics_get_hist(METRIC_E2E_RX_RELAY_MS, &h);
+    TEST_ASSERT_EQUAL(1, h.count);
+    
+    uint8_t buf[E2E_ENCODED_MAX];
+    TEST_ASSERT(E2E_ENCODED_MAX <= 254);                    // Zigbee octet string attribute
+    TEST_ASSERT_EQUAL(1 + E2E_SIZE_SENSOR, e2e_encode(buf, sizeof(buf)));
+    TEST_ASSERT_EQUAL(0x01, buf[1]);
+    TEST_ASSERT_EQUAL(0x10, buf[2]);
+}
+
+void test_e2e_copying_sources(void) {
+    e2e_reset();
+    e2e_stamp_t st = { .level_pct = 50, .seq = 1 };
+    TEST_ASSERT_FALSE(e2e_sends_copy(0x1001));              // Bare reports only so far
+    e2e_report_rx(0x1001, &st, 1000);
+    TEST_ASSERT_TRUE(e2e_sends_copy(0x1001));               // Unsynced stamp
+    st.flags = E2E_STAMP_SYNCED;
+    e2e_report_rx(0x1001, &st, 2000);
+    TEST_ASSERT_FALSE(e2e_sends_copy(0x1001));              // No copy after a synced one
+    
+    // Synced sensors take no room, however many there are
+    for (uint16_t a = 0x3000; a < 0x3000 + 4 * E2E_MAX_COPIERS; a++) {
+        e2e_report_rx(a, &st, 3000);
+    }
+    st.flags = 0;
+    for (uint16_t a = 0x2000; a < 0x2000 + E2E_MAX_COPIERS; a++) {
+        e2e_report_rx(a, &st, 4000 + a);
+    }
+    TEST_ASSERT_TRUE(e2e_sends_copy(0x2000));
+    
+    // Full: the one stamped longest ago makes room, not the one re-stamped
+    e2e_report_rx(0x2000, &st, 9000);
+    e2e_report_rx(0x1001, &st, 9001);
+    TEST_ASSERT_TRUE(e2e_sends_copy(0x2000));
+    TEST_ASSERT_TRUE(e2e_sends_copy(0x1001));
+    TEST_ASSERT_FALSE(e2e_sends_copy(0x2001));
+    
+    e2e_reset();
+    TEST_ASSERT_FALSE(e2e_sends_copy(0x2000));
+}
+
+void test_net_time_min_delay(void) {
+    net_time_t nt;
+    net_time_init(&nt);
+    mock_set_time_us(10000000);
+    TEST_ASSERT_FALSE(net_time_synced(&nt));
+    TEST_ASSERT(net_time_now_ms(&nt) == 10000);
+    
+    // Source runs 40 s ahead; beacons arrive 30, 5 and 100 ms late
+    const uint32_t delays[] = { 30, 5, 100 };
+    for (int i = 0; i < 3; i++) {
+        mock_advance_time_sec(60);
+        net_time_beacon(&nt, net_time_local_ms() + 40000 - delays[i]);
+    }
+    TEST_ASSERT_TRUE(net_time_synced(&nt));
+    TEST_ASSERT_EQUAL(40000 - 5, nt.offset_ms);
+    TEST_ASSERT(net_time_now_ms(&nt) == net_time_local_ms() + 39995);
+    
+    // The best beacon ages out of the window
+    for (int i = 0; i < NET_TIME_WINDOW; i++) {
+        net_time_beacon(&nt, net_time_local_ms() + 40000 - 20);
+    }
+    TEST_ASSERT_EQUAL(40000 - 20, nt.offset_ms);
+}
+
+/* ============================================================================
+ * LINK QUALITY TESTS
+ * ============================================================================ */
+
+void test_link_quality_ewma(void) {
+    link_quality_reset();
+    mock_set_time_us(1000000);
+    
+    // First frame seeds the average, later ones move it 1/8 of the way
+    link_quality_frame(0x1001, 200);
+    link_peer_t p;
+    TEST_ASSERT_EQUAL(ESP_OK, link_quality_get(0x1001, &p));
+    TEST_ASSERT_EQUAL(200, p.lqi);
+    TEST_ASSERT_EQUAL(LINK_RSSI_NONE, p.rssi_dbm);
+    link_quality_frame(0x1001, 120);
+    TEST_ASSERT_EQUAL(ESP_OK, link_quality_get(0x1001, &p));
+    TEST_ASSERT_EQUAL(190, p.lqi);
+    TEST_ASSERT_EQUAL(2, p.frames);
+    
+    // A steady link settles on its value, negative RSSI included
+    link_sample_t nbr = { .addr = 0x1001, .lqi = 120, .rssi_dbm = -71 };
+    for (int i = 0; i < 60; i++) {
+        link_quality_scan(&nbr, 1);
+    }
+    TEST_ASSERT_EQUAL(ESP_OK, link_quality_get(0x1001, &p));
+    TEST_ASSERT_EQUAL(120, p.lqi);
+    TEST_ASSERT_EQUAL(-71, p.rssi_dbm);
+    TEST_ASSERT_EQUAL(60, p.scans);
+    TEST_ASSERT(p.flags & LINK_PEER_NEIGHBOR);
+    
+    // One bad frame barely moves it
+    link_quality_frame(0x1001, 0);
+    TEST_ASSERT_EQUAL(ESP_OK, link_quality_get(0x1001, &p));
+    TEST_ASSERT_EQUAL(105, p.lqi);
+    
+    // Gone from the neighbour table: kept, no longer a neighbour
+    link_quality_scan(NULL, 0);
+    TEST_ASSERT_EQUAL(ESP_OK, link_quality_get(0x1001, &p));
+    TEST_ASSERT_FALSE(p.flags & LINK_PEER_NEIGHBOR);
+    TEST_ASSERT_EQUAL(ESP_ERR_NOT_FOUND, link_quality_best(&p));
+}
+
+void test_link_quality_table(void) {
+    link_quality_reset();
+    mock_set_time_us(1000000);
+    
+    // A full table drops the peer heard from least recently
+    for (int i = 0; i < LINK_MAX_PEERS; i++) {
+        link_quality_frame((uint16_t)(0x2000 + i), (uint8_t)(100 + i));
+        mock_advance_time_ms(100);
+    }
+    link_quality_frame(0x2000, 100);                        // Heard again
+    link_quality_frame(0x3000, 50);
+    link_peer_t p;
+    TEST_ASSERT_EQUAL(ESP_OK, link_quality_get(0x2000, &p));
+    TEST_ASSERT_EQUAL(ESP_ERR_NOT_FOUND, link_quality_get(0x2001, &p));
+    TEST_ASSERT_EQUAL(ESP_OK, link_quality_get(0x3000, &p));
+    
+    link_sample_t nbrs[] = {
+        { .addr = 0x0000, .lqi = 90, .rssi_dbm = -80 },
+        { .addr = 0x2003, .lqi = 180, .rssi_dbm = -55 },
+    };
+    link_quality_scan(nbrs, 2);
+    TEST_ASSERT_EQUAL(ESP_OK, link_quality_best(&p));
+    TEST_ASSERT_EQUAL(0x2003, p.addr);
+    
+    mock_advance_time_sec(5);
+    uint8_t buf[LINK_ENCODED_MAX];
+    TEST_ASSERT_EQUAL(0, link_quality_encode(buf, sizeof(buf) - 1));
+    TEST_ASSERT_EQUAL(LINK_ENCODED_MAX, link_quality_encode(buf, sizeof(buf)));
+    TEST_ASSERT_EQUAL(LINK_MAX_PEERS, buf[0]);
+    const uint8_t *e = buf + 1 + LINK_SIZE_PEER * 2;        // 0x0000 took 0x2002's place
+    TEST_ASSERT_EQUAL(0x00, e[0]);
+    TEST_ASSERT_EQUAL(0x00, e[1]);
+    TEST_ASSERT_EQUAL(LINK_PEER_NEIGHBOR, e[2]);
+    TEST_ASSERT_EQUAL(90, e[3]);
+    TEST_ASSERT_EQUAL(-80, (int8_t)e[4]);
+    TEST_ASSERT_EQUAL(0, e[5]);                             // No frames, scans only
+    TEST_ASSERT_EQUAL(5, e[9]);                             // Seconds since
+}
+
 /* ============================================================================
  * MAIN TEST RUNNER
  * ============================================================================ */
@@ -519,19 +1304,23 @@ int main(void) {
     RUN_TEST(test_water_level_normal_reading);
     RUN_TEST(test_water_level_zero_height);
     RUN_TEST(test_water_level_full_tank);
+    RUN_TEST(test_water_level_percent_matches_division);
     RUN_TEST(test_water_level_empty_tank);
     RUN_TEST(test_water_level_invalid_samples);
     RUN_TEST(test_water_level_partial_samples);
     RUN_TEST(test_water_level_with_offset);
+    RUN_TEST(test_water_level_publish);
     
     // Pump Control Tests
     printf("\nPump Control Logic Tests:\n");
     RUN_TEST(test_pump_low_water_trigger);
     RUN_TEST(test_pump_high_water_stop);
     RUN_TEST(test_pump_hysteresis);
+    RUN_TEST(test_pump_no_report_at_boot);
     RUN_TEST(test_pump_timeout);
     RUN_TEST(test_pump_manual_override);
     RUN_TEST(test_pump_manual_override_expire);
+    RUN_TEST(test_pump_manual_duration_capped);
     RUN_TEST(test_pump_sensor_offline);
     
     // Time Calculation Tests
@@ -547,6 +1336,58 @@ int main(void) {
     RUN_TEST(test_validate_zigbee_channel);
     RUN_TEST(test_validate_report_interval);
     
+    // Config Store Tests
+    printf("\nConfig Store Tests (schema migration):\n");
+    RUN_TEST(test_config_crc32_vector);
+    RUN_TEST(test_config_ident_roundtrip);
+    RUN_TEST(test_config_ident_corruption);
+    RUN_TEST(test_config_ident_newer_version);
+    RUN_TEST(test_config_migrate_v1);
+    RUN_TEST(test_config_migrate_v2_sanitizes);
+    RUN_TEST(test_config_migrate_unknown_size);
+    RUN_TEST(test_config_store_boot_migration);
+    RUN_TEST(test_config_store_hot_write_only);
+    RUN_TEST(test_config_store_corrupt_record);
+    RUN_TEST(test_config_store_empty);
+    
+    // Derived Config Tests
+    printf("\nDerived Config Tests:\n");
+    RUN_TEST(test_derived_defaults);
+    RUN_TEST(test_derived_precomputed);
+    RUN_TEST(test_derived_timeout_cap);
+    RUN_TEST(test_derived_hysteresis_band);
+    
+    // Runtime Metrics Tests
+    printf("\nRuntime Metrics Tests:\n");
+    RUN_TEST(test_metrics_pump_counters);
+    RUN_TEST(test_metrics_histogram_buckets);
+    RUN_TEST(test_metrics_snapshot_roundtrip);
+    
+    // Event Trace Tests
+    printf("\nEvent Trace Tests:\n");
+    RUN_TEST(test_trace_pump_events);
+    RUN_TEST(test_trace_overrun_reports_drops);
+    RUN_TEST(test_trace_stream_codec);
+    RUN_TEST(test_trace_names_tasks_once);
+    
+    printf("\nMicrobenchmark Tests:\n");
+    RUN_TEST(test_bench_batches_and_stats);
+    RUN_TEST(test_bench_json_roundtrip);
+    
+    printf("\nEnergy Accounting Tests:\n");
+    RUN_TEST(test_energy_config_day);
+    RUN_TEST(test_energy_ledger_scales_to_day);
+    
+    printf("\nEnd-to-End Latency Tests:\n");
+    RUN_TEST(test_e2e_stamp_roundtrip);
+    RUN_TEST(test_e2e_sequence_and_latency);
+    RUN_TEST(test_e2e_copying_sources);
+    RUN_TEST(test_net_time_min_delay);
+    
+    printf("\nLink Quality Tests:\n");
+    RUN_TEST(test_link_quality_ewma);
+    RUN_TEST(test_link_quality_table);
+    
     TEST_SUMMARY();
     
     return g_test_failures > 0 ? 1 : 0;
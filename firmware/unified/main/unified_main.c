@@ -14,6 +14,7 @@
 #include "driver/gpio.h"
 #include "esp_log.h"
 #include "esp_timer.h"
+#include "esp_system.h"
 #include "nvs_flash.h"
 #include "esp_task_wdt.h"
 
@@ -21,6 +22,21 @@
 #include "ha/esp_zigbee_ha_standard.h"
 
 #include "ble_provision.h"
+#include "config_derived.h"
+#include "node_hal.h"
+#include "water_level.h"
+#include "pump_control.h"
+#include "radio_coex.h"
+#include "report_capture.h"
+#include "metrics.h"
+#include "sysmon.h"
+#include "boot_prof.h"
+#include "trace.h"
+#include "zb_instr.h"
+#include "energy.h"
+#include "e2e.h"
+#include "net_time.h"
+#include "link_quality.h"
 #include "cultivio_brand.h"
 
 /* ============================================================================
@@ -29,23 +45,34 @@
 
 static const char *TAG = "UNIFIED";
 
-// Hardware Pins (ESP32-H2 Mini compatible)
+// Hardware Pins (ESP32-H2 Mini compatible, see node_hal.h)
 // These pins are shared across all roles
-#define GPIO_PIN_2              GPIO_NUM_2      // Trig (Sensor) / Relay (Controller)
-#define GPIO_PIN_3              GPIO_NUM_3      // Echo (Sensor) / Unused (Controller)
-#define LED_STATUS_PIN          GPIO_NUM_8      // Status LED (all roles)
-#define LED_ACTIVITY_PIN        GPIO_NUM_9      // Activity LED / Pump LED
-#define BUTTON_PIN              GPIO_NUM_10     // Provisioning button
-
-// Ultrasonic sensor settings (Sensor role)
-#define SOUND_SPEED_CM_US       0.0343f
-#define ULTRASONIC_TIMEOUT_US   30000
-#define NUM_SAMPLES             5
-#define SAMPLE_DELAY_MS         50
+#define GPIO_PIN_2              NODE_PIN_TRIGGER        // Trig (Sensor) / Relay (Controller)
+#define GPIO_PIN_3              NODE_PIN_ECHO           // Echo (Sensor) / Unused (Controller)
+#define LED_STATUS_PIN          NODE_PIN_LED_STATUS     // Status LED (all roles)
+#define LED_ACTIVITY_PIN        NODE_PIN_LED_ACTIVITY   // Activity LED / Pump LED
+#define BUTTON_PIN              NODE_PIN_BUTTON         // Provisioning button
 
 // Timing (Controller role)
-#define SENSOR_TIMEOUT_MS       30000
 #define STATUS_UPDATE_MS        1000
+#define BUTTON_POLL_MS          50
+
+// Task CPU / stack high-water mark / heap sampling into the metrics
+// snapshot (sysmon.h); shares are averaged over the period
+#define SYSMON_PERIOD_MS        SYSMON_DEFAULT_PERIOD_MS
+
+// Report capture (controller): received reports and pump decisions recorded
+// for replay on the host (host/replay_host). Off in production builds.
+#define CAPTURE_OFF             0
+#define CAPTURE_UART            1       // "AQRC:" lines in the serial log
+#define CAPTURE_FLASH           2       // "capture" partition, appended across boots
+#define REPORT_CAPTURE_MODE     CAPTURE_OFF
+#define CAPTURE_DUMP_HOLD_MS    5000    // Button hold that prints the flash capture
+
+// Hot-path events (reports, pump decisions, readings) go through the trace
+// ring (trace.h) and are printed by a low-priority task: TRACE_OUTPUT_LOG
+// for readable lines, TRACE_OUTPUT_LINES for AQTR: lines (host/trace_decode)
+#define TRACE_OUTPUT            TRACE_OUTPUT_LOG
 
 // Zigbee configuration
 #define DEVICE_ENDPOINT         1
@@ -54,6 +81,30 @@ static const char *TAG = "UNIFIED";
 #define ATTR_WATER_LEVEL_CM     0x0001
 #define ATTR_SENSOR_STATUS      0x0002
 #define ATTR_PUMP_STATE         0x0003
+#define ATTR_LEVEL_STAMP        0x0004  // Octet string, the reported level (e2e.h)
+
+// Diagnostics cluster (manufacturer specific, server on every role): the
+// metrics snapshot (metrics.h) and the link quality, refreshed periodically
+#define CLUSTER_DIAGNOSTICS     0xFC02
+#define ATTR_DIAG_METRICS       0x0000  // Octet string, metrics before DIAG_METRICS_SPLIT
+#define ATTR_DIAG_LQI           0x0001  // uint8_t, 0-255
+#define ATTR_DIAG_RSSI          0x0002  // int8_t, dBm
+#define ATTR_DIAG_METRICS_2     0x0003  // Octet string, metrics from DIAG_METRICS_SPLIT on
+#define ATTR_DIAG_E2E           0x0004  // Octet string, per-sensor latencies (controller)
+#define DIAG_OCTET_MAX          254     // Octet string: one length byte, 0xFF invalid
+#define DIAG_METRICS_SPLIT      METRIC_E2E_SAMPLE_RX_MS
+#define DIAG_REFRESH_US         (10LL * 1000000)
+
+// Network time (net_time.h): the controller sends it to each sensor it
+// hears from, then every NET_TIME_BEACON_PERIOD_MS
+#define CLUSTER_NET_TIME        0xFC03
+#define ATTR_NET_TIME_MS        0x0000  // uint32_t
+
+// Sensor end device: one poll of its parent per keep-alive period. Polls,
+// pings, reports and BLE advertising are accounted (energy.h) and the
+// projected battery life logged every ENERGY_LOG_PERIOD_US.
+#define SENSOR_KEEP_ALIVE_MS    3000
+#define ENERGY_LOG_PERIOD_US    (3600LL * 1000000)
 
 /* ============================================================================
  * GLOBAL VARIABLES
@@ -64,24 +115,34 @@ static bool g_provisioning_mode = false;
 static bool g_zigbee_connected = false;
 static uint32_t g_uptime_seconds = 0;
 
-// Sensor-specific globals
-static uint8_t  g_water_level_percent = 0;
-static uint16_t g_water_level_cm = 0;
-static uint8_t  g_sensor_status = 0;
+// Sensor-specific globals (also the Zigbee attribute storage)
+static water_level_t g_level = { .status = WATER_LEVEL_STATUS_OK };
+static uint8_t  g_level_stamp[E2E_STAMP_ATTR_SIZE];
+static uint16_t g_report_seq;
+static bool     g_report_copy;                  // Follow the stamp with the bare percentage
+static uint8_t  g_report_frames_pending;        // Send statuses still due for this report
+static bool     g_report_frames_ok;
+static net_time_t g_net_time;
 
 // Controller-specific globals
-static uint32_t g_last_sensor_update = 0;
-static bool     g_pump_running = false;
-static uint32_t g_pump_start_time = 0;
-static uint8_t  g_pump_state_attr = 0;
-static bool     g_sensor_connected = false;
-static bool     g_manual_override = false;
-static uint32_t g_manual_override_end_time = 0;
-static uint16_t g_manual_duration_min = 0;
-static uint32_t g_pump_runtime_total = 0;
+static pump_control_t g_pump;
+
+// Smoothed link quality (link_quality.h), refreshed by diagnostics_refresh().
+// The controller tracks the sensor it last heard from while it is in direct
+// range, otherwise (and in other roles) the best neighbour.
+static uint16_t g_link_peer = NODE_ZB_PEER_ANY;
 static int8_t   g_last_rssi = -100;
+static uint8_t  g_last_lqi = 0;
 static uint8_t  g_signal_quality = 0;
 
+// Network time attribute storage: received (sensor) or sent (controller)
+static uint32_t g_net_time_ms;
+
+// Diagnostics cluster attribute storage (octet string: length byte first)
+static uint8_t  g_diag_metrics[1 + DIAG_OCTET_MAX];
+static uint8_t  g_diag_metrics_2[1 + DIAG_OCTET_MAX];
+static uint8_t  g_diag_e2e[1 + E2E_ENCODED_MAX];
+
 /* ============================================================================
  * COMMON LED FUNCTIONS
  * ============================================================================ */
@@ -150,83 +211,12 @@ static void ultrasonic_init(void)
     ESP_LOGI(TAG, "Ultrasonic sensor initialized");
 }
 
-static float measure_distance_cm(void)
-{
-    gpio_set_level(GPIO_PIN_2, 0);
-    esp_rom_delay_us(2);
-    gpio_set_level(GPIO_PIN_2, 1);
-    esp_rom_delay_us(10);
-    gpio_set_level(GPIO_PIN_2, 0);
-
-    int64_t start_wait = esp_timer_get_time();
-    while (gpio_get_level(GPIO_PIN_3) == 0) {
-        if ((esp_timer_get_time() - start_wait) > ULTRASONIC_TIMEOUT_US) {
-            return -1.0f;
-        }
-        // FIX: BUG #2 - Prevent watchdog timeout and allow task switching
-        esp_rom_delay_us(10);
-        taskYIELD();
-    }
-
-    int64_t echo_start = esp_timer_get_time();
-    while (gpio_get_level(GPIO_PIN_3) == 1) {
-        if ((esp_timer_get_time() - echo_start) > ULTRASONIC_TIMEOUT_US) {
-            return -1.0f;
-        }
-        // FIX: BUG #2 - Prevent watchdog timeout and allow task switching
-        esp_rom_delay_us(10);
-        taskYIELD();
-    }
-    int64_t echo_end = esp_timer_get_time();
-
-    float duration_us = (float)(echo_end - echo_start);
-    float distance_cm = (duration_us * SOUND_SPEED_CM_US) / 2.0f;
-
-    return distance_cm;
-}
-
 static void measure_water_level(void)
 {
-    float total_distance = 0;
-    int valid_samples = 0;
-    
-    uint16_t tank_height = g_config.tank_height_cm > 0 ? g_config.tank_height_cm : 200;
-    uint8_t sensor_offset = g_config.sensor_offset_cm;
-
-    for (int i = 0; i < NUM_SAMPLES; i++) {
-        float distance = measure_distance_cm();
-        if (distance > 0 && distance < tank_height + 50) {
-            total_distance += distance;
-            valid_samples++;
-        }
-        vTaskDelay(pdMS_TO_TICKS(SAMPLE_DELAY_MS));
-    }
-
-    if (valid_samples > 0) {
-        // FIX: BUG #5 - Validate tank height before division
-        if (tank_height == 0) {
-            ESP_LOGE(TAG, "FATAL: Tank height is 0! Cannot calculate water level.");
-            g_sensor_status = 1;
-            g_water_level_percent = 0;
-            g_water_level_cm = 0;
-            return;
-        }
-        
-        float avg_distance = total_distance / valid_samples;
-        float water_depth = tank_height - avg_distance - sensor_offset;
-        
-        if (water_depth < 0) water_depth = 0;
-        if (water_depth > tank_height) water_depth = tank_height;
-
-        g_water_level_cm = (uint16_t)water_depth;
-        g_water_level_percent = (uint8_t)((water_depth / tank_height) * 100.0f);
-        g_sensor_status = 0;
-
-        ESP_LOGI(TAG, "Water Level: %d%% (%d cm)", g_water_level_percent, g_water_level_cm);
-    } else {
-        g_sensor_status = 1;
-        ESP_LOGW(TAG, "Sensor measurement failed");
-    }
+    // Live derived config, copied once per measurement
+    config_derived_t dc;
+    ble_provision_config_derived(&dc);
+    water_level_measure(&dc, &g_level);
 }
 
 /* ============================================================================
@@ -243,133 +233,133 @@ static void pump_init(void)
         .intr_type = GPIO_INTR_DISABLE
     };
     gpio_config(&relay_conf);
-    gpio_set_level(GPIO_PIN_2, 0);
+    pump_control_init(&g_pump);
     ESP_LOGI(TAG, "Pump relay initialized (OFF)");
 }
 
-static void pump_on(void)
-{
-    if (!g_pump_running) {
-        gpio_set_level(GPIO_PIN_2, 1);
-        g_pump_running = true;
-        g_pump_start_time = xTaskGetTickCount() * portTICK_PERIOD_MS / 1000;
-        g_pump_state_attr = 1;
-        gpio_set_level(LED_ACTIVITY_PIN, 1);
-        ESP_LOGI(TAG, ">>> PUMP ON <<< Water level: %d%%", g_water_level_percent);
-    }
-}
-
-static void pump_off(void)
-{
-    if (g_manual_override) {
-        g_manual_override = false;
-        g_manual_override_end_time = 0;
-        g_manual_duration_min = 0;
-        ESP_LOGI(TAG, "Manual override cleared");
-    }
-    
-    if (g_pump_running) {
-        gpio_set_level(GPIO_PIN_2, 0);
-        g_pump_running = false;
-        g_pump_state_attr = 0;
-        gpio_set_level(LED_ACTIVITY_PIN, 0);
-        
-        uint32_t runtime = (xTaskGetTickCount() * portTICK_PERIOD_MS / 1000) - g_pump_start_time;
-        ESP_LOGI(TAG, ">>> PUMP OFF <<< Runtime: %lu seconds", runtime);
-    }
-}
-
 static void manual_pump_cmd_handler(const manual_pump_cmd_t *cmd)
 {
-    if (cmd->command == PUMP_CMD_START_TIMED && cmd->duration_minutes > 0) {
-        g_manual_override = true;
-        g_manual_duration_min = cmd->duration_minutes;
-        g_manual_override_end_time = (xTaskGetTickCount() * portTICK_PERIOD_MS / 1000) 
-                                     + (cmd->duration_minutes * 60);
-        
-        ESP_LOGW(TAG, ">>> MANUAL OVERRIDE: Pump ON for %d minutes <<<", cmd->duration_minutes);
-        pump_on();
+    report_capture_manual(cmd->command, cmd->duration_minutes);
+    pump_control_manual(&g_pump, cmd);
+    if (g_pump.manual_override) {
         led_blink(LED_STATUS_PIN, 3, 100);
-    } else {
-        ESP_LOGW(TAG, ">>> MANUAL OVERRIDE: Pump STOP <<<");
-        g_manual_override = false;
-        g_manual_override_end_time = 0;
-        g_manual_duration_min = 0;
-        pump_off();
     }
 }
 
 static void pump_control_logic(void)
 {
-    uint32_t now = xTaskGetTickCount() * portTICK_PERIOD_MS;
-    uint32_t now_sec = now / 1000;
-    bool sensor_online = (now - g_last_sensor_update) < SENSOR_TIMEOUT_MS;
-    
-    uint8_t pump_on_threshold = g_config.pump_on_threshold > 0 ? g_config.pump_on_threshold : 20;
-    uint8_t pump_off_threshold = g_config.pump_off_threshold > 0 ? g_config.pump_off_threshold : 80;
-    
-    // FIX: BUG #3 - Use uint32_t to prevent overflow when multiplying by 60
-    uint32_t pump_timeout_sec = g_config.pump_timeout_minutes > 0 ? 
-                                ((uint32_t)g_config.pump_timeout_minutes * 60) : 3600;
-    
-    // Safety limit: Max 2 hours (7200 seconds)
-    if (pump_timeout_sec > 7200) {
-        ESP_LOGW(TAG, "Pump timeout capped at 2 hours for safety (was %lu)", pump_timeout_sec);
-        pump_timeout_sec = 7200;
-    }
-    
-    // Manual override mode
-    if (g_manual_override) {
-        if (now_sec >= g_manual_override_end_time) {
-            ESP_LOGW(TAG, "Manual override expired after %d minutes", g_manual_duration_min);
-            g_manual_override = false;
-            g_manual_override_end_time = 0;
-            g_manual_duration_min = 0;
-            pump_off();
-            return;
-        }
-        
-        if (!g_pump_running) {
-            pump_on();
-        }
-        return;
-    }
+    // Live derived config: defaults, the 2 hour cap and the hysteresis band
+    // are resolved once per config change, BLE changes apply on the next pass
+    static uint32_t s_config_generation = 0;
+    uint32_t generation = ble_provision_config_generation();
+    config_derived_t dc;
+    ble_provision_config_derived(&dc);
     
-    // Automatic mode
-    if (!sensor_online) {
-        if (g_sensor_connected) {
-            ESP_LOGW(TAG, "Sensor offline!");
-            g_sensor_connected = false;
-        }
-        if (g_pump_running) {
-            ESP_LOGW(TAG, "Turning pump OFF - sensor timeout");
-            pump_off();
+    if (generation != s_config_generation) {
+        if (s_config_generation != 0) {
+            ESP_LOGI(TAG, "Config updated: ON %d%%, OFF %d%%, timeout %lu s",
+                     dc.pump_on_pct, dc.pump_off_pct, dc.pump_timeout_sec);
         }
-        return;
+        s_config_generation = generation;
+        report_capture_config(dc.pump_on_pct, dc.pump_off_pct, dc.pump_timeout_sec);
     }
     
-    if (!g_sensor_connected) {
-        ESP_LOGI(TAG, "Sensor online");
-        g_sensor_connected = true;
+    // Reports update g_pump from the Zigbee task
+    zb_lock_held_t held = zb_instr_lock(ZB_LOCK_SITE_CONTROL);
+    bool was_running = g_pump.running;
+    pump_control_step(&g_pump, &dc);
+    zb_instr_unlock(&held);
+    if (g_pump.running != was_running) {
+        report_capture_pump(g_pump.running, g_pump.water_level_pct);
     }
+}
 
-    if (g_pump_running) {
-        uint32_t runtime = now_sec - g_pump_start_time;
-        if (runtime >= pump_timeout_sec) {
-            ESP_LOGW(TAG, "Pump timeout after %lu seconds", runtime);
-            pump_off();
-            return;
-        }
-    }
+/* ============================================================================
+ * ZIGBEE - DIAGNOSTICS (ALL ROLES)
+ * ============================================================================ */
 
-    if (g_water_level_percent <= pump_on_threshold && !g_pump_running) {
-        ESP_LOGI(TAG, "Water LOW (%d%% <= %d%%), pump ON", g_water_level_percent, pump_on_threshold);
-        pump_on();
+static void add_diagnostics_cluster(esp_zb_cluster_list_t *cluster_list)
+{
+    esp_zb_attribute_list_t *diag_cluster = esp_zb_zcl_attr_list_create(CLUSTER_DIAGNOSTICS);
+
+    esp_zb_custom_cluster_add_custom_attr(diag_cluster, ATTR_DIAG_METRICS,
+        ESP_ZB_ZCL_ATTR_TYPE_OCTET_STRING, ESP_ZB_ZCL_ATTR_ACCESS_READ_ONLY,
+        g_diag_metrics);
+
+    esp_zb_custom_cluster_add_custom_attr(diag_cluster, ATTR_DIAG_LQI,
+        ESP_ZB_ZCL_ATTR_TYPE_U8, ESP_ZB_ZCL_ATTR_ACCESS_READ_ONLY,
+        &g_last_lqi);
+
+    esp_zb_custom_cluster_add_custom_attr(diag_cluster, ATTR_DIAG_RSSI,
+        ESP_ZB_ZCL_ATTR_TYPE_S8, ESP_ZB_ZCL_ATTR_ACCESS_READ_ONLY,
+        &g_last_rssi);
+
+    esp_zb_custom_cluster_add_custom_attr(diag_cluster, ATTR_DIAG_METRICS_2,
+        ESP_ZB_ZCL_ATTR_TYPE_OCTET_STRING, ESP_ZB_ZCL_ATTR_ACCESS_READ_ONLY,
+        g_diag_metrics_2);
+
+    esp_zb_custom_cluster_add_custom_attr(diag_cluster, ATTR_DIAG_E2E,
+        ESP_ZB_ZCL_ATTR_TYPE_OCTET_STRING, ESP_ZB_ZCL_ATTR_ACCESS_READ_ONLY,
+        g_diag_e2e);
+
+    esp_zb_cluster_list_add_custom_cluster(cluster_list, diag_cluster, ESP_ZB_ZCL_CLUSTER_SERVER_ROLE);
+}
+
+/**
+ * Refresh link quality and the diagnostics cluster, at most every
+ * DIAG_REFRESH_US. Takes the Zigbee lock.
+ */
+static void diagnostics_refresh(void)
+{
+    static int64_t s_last_us = 0;
+    int64_t now_us = esp_timer_get_time();
+    if (s_last_us != 0 && now_us - s_last_us < DIAG_REFRESH_US) {
+        return;
     }
-    else if (g_water_level_percent >= pump_off_threshold && g_pump_running) {
-        ESP_LOGI(TAG, "Water HIGH (%d%% >= %d%%), pump OFF", g_water_level_percent, pump_off_threshold);
-        pump_off();
+    s_last_us = now_us;
+
+    zb_lock_held_t held = zb_instr_lock(ZB_LOCK_SITE_DIAGNOSTICS);
+
+    link_sample_t nbrs[LINK_MAX_PEERS];
+    int neighbors = node_hal_zb_neighbors(nbrs, LINK_MAX_PEERS);
+    link_quality_scan(nbrs, neighbors < LINK_MAX_PEERS ? neighbors : LINK_MAX_PEERS);
+    metrics_set(METRIC_NEIGHBORS, neighbors);
+
+    link_peer_t peer;
+    bool have_peer = g_link_peer != NODE_ZB_PEER_ANY &&
+                     link_quality_get(g_link_peer, &peer) == ESP_OK &&
+                     (peer.flags & LINK_PEER_NEIGHBOR);
+    if (have_peer || link_quality_best(&peer) == ESP_OK) {
+        g_last_rssi = peer.rssi_dbm;
+        g_last_lqi = peer.lqi;
+        g_signal_quality = NODE_ZB_LQI_TO_PCT(peer.lqi);
+    } else {
+        g_last_rssi = -100;
+        g_last_lqi = 0;
+        g_signal_quality = 0;
     }
+    metrics_set(METRIC_LINK_RSSI, g_last_rssi);
+    metrics_set(METRIC_LINK_LQI, g_last_lqi);
+
+    // The snapshot no longer fits one octet string: two snapshots of their
+    // own (metrics_encode_range()), each 0-length if it outgrew the attribute
+    uint8_t diag[1 + DIAG_OCTET_MAX];
+    diag[0] = (uint8_t)metrics_encode_range(diag + 1, DIAG_OCTET_MAX, 0, DIAG_METRICS_SPLIT);
+    esp_zb_zcl_set_attribute_val(DEVICE_ENDPOINT, CLUSTER_DIAGNOSTICS,
+        ESP_ZB_ZCL_CLUSTER_SERVER_ROLE, ATTR_DIAG_METRICS, diag, false);
+    diag[0] = (uint8_t)metrics_encode_range(diag + 1, DIAG_OCTET_MAX, DIAG_METRICS_SPLIT, METRIC_COUNT);
+    esp_zb_zcl_set_attribute_val(DEVICE_ENDPOINT, CLUSTER_DIAGNOSTICS,
+        ESP_ZB_ZCL_CLUSTER_SERVER_ROLE, ATTR_DIAG_METRICS_2, diag, false);
+    _Static_assert(E2E_ENCODED_MAX <= DIAG_OCTET_MAX, "e2e table too big for the diag attribute");
+    diag[0] = (uint8_t)e2e_encode(diag + 1, sizeof(diag) - 1);
+    esp_zb_zcl_set_attribute_val(DEVICE_ENDPOINT, CLUSTER_DIAGNOSTICS,
+        ESP_ZB_ZCL_CLUSTER_SERVER_ROLE, ATTR_DIAG_E2E, diag, false);
+    esp_zb_zcl_set_attribute_val(DEVICE_ENDPOINT, CLUSTER_DIAGNOSTICS,
+        ESP_ZB_ZCL_CLUSTER_SERVER_ROLE, ATTR_DIAG_LQI, &g_last_lqi, false);
+    esp_zb_zcl_set_attribute_val(DEVICE_ENDPOINT, CLUSTER_DIAGNOSTICS,
+        ESP_ZB_ZCL_CLUSTER_SERVER_ROLE, ATTR_DIAG_RSSI, &g_last_rssi, false);
+
+    zb_instr_unlock(&held);
 }
 
 /* ============================================================================
@@ -395,31 +385,36 @@ static esp_zb_cluster_list_t *create_sensor_clusters(void)
     
     esp_zb_custom_cluster_add_custom_attr(water_cluster, ATTR_WATER_LEVEL_PCT,
         ESP_ZB_ZCL_ATTR_TYPE_U8, ESP_ZB_ZCL_ATTR_ACCESS_READ_ONLY | ESP_ZB_ZCL_ATTR_ACCESS_REPORTING,
-        &g_water_level_percent);
+        &g_level.percent);
     
     esp_zb_custom_cluster_add_custom_attr(water_cluster, ATTR_WATER_LEVEL_CM,
         ESP_ZB_ZCL_ATTR_TYPE_U16, ESP_ZB_ZCL_ATTR_ACCESS_READ_ONLY | ESP_ZB_ZCL_ATTR_ACCESS_REPORTING,
-        &g_water_level_cm);
+        &g_level.cm);
     
     esp_zb_custom_cluster_add_custom_attr(water_cluster, ATTR_SENSOR_STATUS,
         ESP_ZB_ZCL_ATTR_TYPE_U8, ESP_ZB_ZCL_ATTR_ACCESS_READ_ONLY,
-        &g_sensor_status);
+        &g_level.status);
+    
+    esp_zb_custom_cluster_add_custom_attr(water_cluster, ATTR_LEVEL_STAMP,
+        ESP_ZB_ZCL_ATTR_TYPE_OCTET_STRING, ESP_ZB_ZCL_ATTR_ACCESS_READ_ONLY | ESP_ZB_ZCL_ATTR_ACCESS_REPORTING,
+        g_level_stamp);
 
     esp_zb_cluster_list_add_custom_cluster(cluster_list, water_cluster, ESP_ZB_ZCL_CLUSTER_SERVER_ROLE);
 
+    esp_zb_attribute_list_t *time_cluster = esp_zb_zcl_attr_list_create(CLUSTER_NET_TIME);
+    esp_zb_custom_cluster_add_custom_attr(time_cluster, ATTR_NET_TIME_MS,
+        ESP_ZB_ZCL_ATTR_TYPE_U32, ESP_ZB_ZCL_ATTR_ACCESS_READ_WRITE, &g_net_time_ms);
+    esp_zb_cluster_list_add_custom_cluster(cluster_list, time_cluster, ESP_ZB_ZCL_CLUSTER_CLIENT_ROLE);
+    add_diagnostics_cluster(cluster_list);
+
     return cluster_list;
 }
 
-static void send_water_level_report(void)
+// A report is the stamp, then the bare percentage for controllers from
+// before the stamp (controller_node among them) until network time shows
+// the controller takes stamps (e2e.h). Retries resend what the first try did.
+static void send_report_cmd(bool retry)
 {
-    if (!g_zigbee_connected) return;
-
-    esp_zb_zcl_set_attribute_val(DEVICE_ENDPOINT, CLUSTER_WATER_LEVEL,
-        ESP_ZB_ZCL_CLUSTER_SERVER_ROLE, ATTR_WATER_LEVEL_PCT, &g_water_level_percent, false);
-    
-    esp_zb_zcl_set_attribute_val(DEVICE_ENDPOINT, CLUSTER_WATER_LEVEL,
-        ESP_ZB_ZCL_CLUSTER_SERVER_ROLE, ATTR_WATER_LEVEL_CM, &g_water_level_cm, false);
-
     esp_zb_zcl_report_attr_cmd_t report_cmd = {
         .zcl_basic_cmd = {
             .dst_addr_u.addr_short = 0x0000,
@@ -428,10 +423,76 @@ static void send_water_level_report(void)
         },
         .address_mode = ESP_ZB_APS_ADDR_MODE_16_ENDP_PRESENT,
         .clusterID = CLUSTER_WATER_LEVEL,
-        .attributeID = ATTR_WATER_LEVEL_PCT,
+        .attributeID = ATTR_LEVEL_STAMP,
     };
     
+    radio_coex_report_sent(retry);
+    g_report_frames_pending = g_report_copy ? 2 : 1;
+    g_report_frames_ok = true;
     esp_zb_zcl_report_attr_cmd_req(&report_cmd);
+    energy_zb_frame();
+    if (g_report_copy) {
+        report_cmd.attributeID = ATTR_WATER_LEVEL_PCT;
+        esp_zb_zcl_report_attr_cmd_req(&report_cmd);
+        energy_zb_frame();
+    }
+    metrics_inc(METRIC_REPORTS_SENT);
+}
+
+// Runs in Zigbee task context (scheduler alarm)
+static void report_retry_cb(uint8_t param)
+{
+    int64_t start_us = zb_instr_callback_begin();
+    if (g_zigbee_connected) {
+        send_report_cmd(true);
+    }
+    zb_instr_callback_end(ZB_CB_ALARM, start_us);
+}
+
+// Called by the stack for every ZCL command sent; the sensor only sends
+// reports. A report has failed if either of its frames did.
+static void zcl_send_status_cb(esp_zb_zcl_command_send_status_message_t message)
+{
+    int64_t start_us = zb_instr_callback_begin();
+    if (message.status != ESP_OK) {
+        g_report_frames_ok = false;
+    }
+    if (g_report_frames_pending > 0 && --g_report_frames_pending == 0) {
+        if (!g_report_frames_ok) {
+            metrics_inc(METRIC_REPORTS_FAILED);
+        } else {
+            boot_prof_mark(BOOT_STAGE_FIRST_REPORT);
+        }
+        if (radio_coex_report_result(g_report_frames_ok)) {
+            esp_zb_scheduler_alarm((esp_zb_callback_t)report_retry_cb, 0, RADIO_COEX_REPORT_RETRY_MS);
+        }
+    }
+    zb_instr_callback_end(ZB_CB_SEND_STATUS, start_us);
+}
+
+// The measurement just published, stamped for the controller (e2e.h).
+// Retries resend it unchanged. Caller must hold the Zigbee lock.
+static void publish_level_stamp(uint32_t sample_ms)
+{
+    e2e_stamp_t stamp = {
+        .level_pct = g_level.percent,
+        .status = g_level.status,
+        .seq = ++g_report_seq,
+        .sample_ms = sample_ms,
+        .flags = net_time_synced(&g_net_time) ? E2E_STAMP_SYNCED : 0,
+    };
+    e2e_stamp_encode(&stamp, g_level_stamp);
+    esp_zb_zcl_set_attribute_val(DEVICE_ENDPOINT, CLUSTER_WATER_LEVEL,
+        ESP_ZB_ZCL_CLUSTER_SERVER_ROLE, ATTR_LEVEL_STAMP, g_level_stamp, false);
+    g_report_copy = !(stamp.flags & E2E_STAMP_SYNCED);
+}
+
+// Caller must hold the Zigbee lock
+static void send_water_level_report(void)
+{
+    if (!g_zigbee_connected) return;
+
+    send_report_cmd(false);
 }
 
 /* ============================================================================
@@ -457,21 +518,73 @@ static esp_zb_cluster_list_t *create_controller_clusters(void)
     
     esp_zb_custom_cluster_add_custom_attr(water_cluster, ATTR_WATER_LEVEL_PCT,
         ESP_ZB_ZCL_ATTR_TYPE_U8, ESP_ZB_ZCL_ATTR_ACCESS_READ_WRITE,
-        &g_water_level_percent);
+        &g_pump.water_level_pct);
     
     esp_zb_custom_cluster_add_custom_attr(water_cluster, ATTR_WATER_LEVEL_CM,
         ESP_ZB_ZCL_ATTR_TYPE_U16, ESP_ZB_ZCL_ATTR_ACCESS_READ_WRITE,
-        &g_water_level_cm);
+        &g_level.cm);
     
     esp_zb_custom_cluster_add_custom_attr(water_cluster, ATTR_PUMP_STATE,
         ESP_ZB_ZCL_ATTR_TYPE_U8, ESP_ZB_ZCL_ATTR_ACCESS_READ_ONLY,
-        &g_pump_state_attr);
+        &g_pump.state_attr);
+
+    esp_zb_custom_cluster_add_custom_attr(water_cluster, ATTR_LEVEL_STAMP,
+        ESP_ZB_ZCL_ATTR_TYPE_OCTET_STRING, ESP_ZB_ZCL_ATTR_ACCESS_READ_WRITE,
+        g_level_stamp);
 
     esp_zb_cluster_list_add_custom_cluster(cluster_list, water_cluster, ESP_ZB_ZCL_CLUSTER_CLIENT_ROLE);
 
+    esp_zb_attribute_list_t *time_cluster = esp_zb_zcl_attr_list_create(CLUSTER_NET_TIME);
+    esp_zb_custom_cluster_add_custom_attr(time_cluster, ATTR_NET_TIME_MS,
+        ESP_ZB_ZCL_ATTR_TYPE_U32, ESP_ZB_ZCL_ATTR_ACCESS_READ_ONLY | ESP_ZB_ZCL_ATTR_ACCESS_REPORTING,
+        &g_net_time_ms);
+    esp_zb_cluster_list_add_custom_cluster(cluster_list, time_cluster, ESP_ZB_ZCL_CLUSTER_SERVER_ROLE);
+    add_diagnostics_cluster(cluster_list);
+
     return cluster_list;
 }
 
+// Our network time to one sensor, read as late as possible. Caller must
+// hold the Zigbee lock (or run in the Zigbee task).
+static void send_net_time(uint16_t addr)
+{
+    g_net_time_ms = net_time_now_ms(NULL);
+    esp_zb_zcl_set_attribute_val(DEVICE_ENDPOINT, CLUSTER_NET_TIME,
+        ESP_ZB_ZCL_CLUSTER_SERVER_ROLE, ATTR_NET_TIME_MS, &g_net_time_ms, false);
+
+    esp_zb_zcl_report_attr_cmd_t report_cmd = {
+        .zcl_basic_cmd = {
+            .dst_addr_u.addr_short = addr,
+            .dst_endpoint = DEVICE_ENDPOINT,
+            .src_endpoint = DEVICE_ENDPOINT,
+        },
+        .address_mode = ESP_ZB_APS_ADDR_MODE_16_ENDP_PRESENT,
+        .clusterID = CLUSTER_NET_TIME,
+        .attributeID = ATTR_NET_TIME_MS,
+    };
+    esp_zb_zcl_report_attr_cmd_req(&report_cmd);
+}
+
+// Every NET_TIME_BEACON_PERIOD_MS, to each sensor heard from. Takes the
+// Zigbee lock.
+static void net_time_beacon_tick(void)
+{
+    static int64_t s_last_us = 0;
+    int64_t now_us = esp_timer_get_time();
+    if (!g_zigbee_connected || now_us - s_last_us < NET_TIME_BEACON_PERIOD_MS * 1000LL) {
+        return;
+    }
+    s_last_us = now_us;
+
+    zb_lock_held_t held = zb_instr_lock(ZB_LOCK_SITE_CONTROL);
+    e2e_sensor_t sensors[E2E_MAX_SENSORS];
+    int n = e2e_get_sensors(sensors, E2E_MAX_SENSORS);
+    for (int i = 0; i < n; i++) {
+        send_net_time(sensors[i].addr);
+    }
+    zb_instr_unlock(&held);
+}
+
 /* ============================================================================
  * ZIGBEE - ROUTER ROLE
  * ============================================================================ */
@@ -490,6 +603,7 @@ static esp_zb_cluster_list_t *create_router_clusters(void)
     esp_zb_identify_cluster_cfg_t identify_cfg = { .identify_time = 0 };
     esp_zb_attribute_list_t *identify_cluster = esp_zb_identify_cluster_create(&identify_cfg);
     esp_zb_cluster_list_add_identify_cluster(cluster_list, identify_cluster, ESP_ZB_ZCL_CLUSTER_SERVER_ROLE);
+    add_diagnostics_cluster(cluster_list);
 
     return cluster_list;
 }
@@ -498,9 +612,24 @@ static esp_zb_cluster_list_t *create_router_clusters(void)
  * ZIGBEE CALLBACKS
  * ============================================================================ */
 
-static esp_err_t zb_action_handler(esp_zb_core_action_callback_id_t callback_id, const void *message)
+// Sensor: network time beacons from the controller
+static esp_err_t sensor_action_dispatch(esp_zb_core_action_callback_id_t callback_id, const void *message)
+{
+    if (callback_id == ESP_ZB_CORE_REPORT_ATTR_CB_ID) {
+        const esp_zb_zcl_report_attr_message_t *msg = message;
+        if (msg->cluster == CLUSTER_NET_TIME && msg->attribute.id == ATTR_NET_TIME_MS) {
+            net_time_beacon(&g_net_time, *(uint32_t *)msg->attribute.data.value);
+        }
+    }
+    return ESP_OK;
+}
+
+static esp_err_t zb_action_dispatch(esp_zb_core_action_callback_id_t callback_id, const void *message)
 {
-    // Only controller needs to handle incoming data
+    if (g_config.node_type == NODE_TYPE_SENSOR) {
+        return sensor_action_dispatch(callback_id, message);
+    }
+    // Otherwise only the controller handles incoming data
     if (g_config.node_type != NODE_TYPE_CONTROLLER) {
         return ESP_OK;
     }
@@ -510,16 +639,16 @@ static esp_err_t zb_action_handler(esp_zb_core_action_callback_id_t callback_id,
             esp_zb_zcl_set_attr_value_message_t *msg = (esp_zb_zcl_set_attr_value_message_t *)message;
             if (msg->info.cluster == CLUSTER_WATER_LEVEL) {
                 if (msg->attribute.id == ATTR_WATER_LEVEL_PCT) {
-                    g_water_level_percent = *(uint8_t *)msg->attribute.data.value;
-                    g_last_sensor_update = xTaskGetTickCount() * portTICK_PERIOD_MS;
-                    ESP_LOGI(TAG, "Received water level: %d%%", g_water_level_percent);
+                    pump_control_sensor_update(&g_pump, *(uint8_t *)msg->attribute.data.value);
+                    TRACE(LEVEL_WRITE, g_pump.water_level_pct);
+                    boot_prof_mark(BOOT_STAGE_FIRST_REPORT);
                 }
                 else if (msg->attribute.id == ATTR_WATER_LEVEL_CM) {
-                    g_water_level_cm = *(uint16_t *)msg->attribute.data.value;
+                    g_level.cm = *(uint16_t *)msg->attribute.data.value;
                 }
                 else if (msg->attribute.id == ATTR_SENSOR_STATUS) {
-                    g_sensor_status = *(uint8_t *)msg->attribute.data.value;
-                    ESP_LOGD(TAG, "Sensor status updated: %d", g_sensor_status);
+                    g_level.status = *(uint8_t *)msg->attribute.data.value;
+                    ESP_LOGD(TAG, "Sensor status updated: %d", g_level.status);
                 }
             }
             break;
@@ -527,11 +656,33 @@ static esp_err_t zb_action_handler(esp_zb_core_action_callback_id_t callback_id,
         
         case ESP_ZB_CORE_REPORT_ATTR_CB_ID: {
             esp_zb_zcl_report_attr_message_t *msg = (esp_zb_zcl_report_attr_message_t *)message;
-            if (msg->cluster == CLUSTER_WATER_LEVEL) {
-                if (msg->attribute.id == ATTR_WATER_LEVEL_PCT) {
-                    g_water_level_percent = *(uint8_t *)msg->attribute.data.value;
-                    g_last_sensor_update = xTaskGetTickCount() * portTICK_PERIOD_MS;
-                    ESP_LOGI(TAG, "Report - Water: %d%%", g_water_level_percent);
+            e2e_stamp_t stamp;
+            if (msg->cluster == CLUSTER_WATER_LEVEL && msg->attribute.id == ATTR_LEVEL_STAMP &&
+                e2e_stamp_decode(msg->attribute.data.value, msg->attribute.data.size, &stamp) == ESP_OK) {
+                uint16_t src = msg->src_address.u.short_addr;
+                if (e2e_report_rx(src, &stamp, net_time_now_ms(NULL))) {
+                    send_net_time(src);
+                }
+                report_capture_report(src, ATTR_WATER_LEVEL_PCT, stamp.level_pct);
+                g_link_peer = src;
+                pump_control_sensor_update(&g_pump, stamp.level_pct);
+                TRACE(REPORT_RX, src, g_pump.water_level_pct);
+                boot_prof_mark(BOOT_STAGE_FIRST_REPORT);
+                radio_coex_report_received();
+                led_blink(LED_STATUS_PIN, 1, 50);
+            }
+            else if (msg->cluster == CLUSTER_WATER_LEVEL) {
+                // Sensors from before the stamp report only the bare
+                // percentage; newer ones follow an unsynced stamp with a copy
+                if (msg->attribute.id == ATTR_WATER_LEVEL_PCT &&
+                    !e2e_sends_copy(msg->src_address.u.short_addr)) {
+                    uint8_t level = *(uint8_t *)msg->attribute.data.value;
+                    report_capture_report(msg->src_address.u.short_addr, ATTR_WATER_LEVEL_PCT, level);
+                    g_link_peer = msg->src_address.u.short_addr;
+                    pump_control_sensor_update(&g_pump, level);
+                    TRACE(REPORT_RX, msg->src_address.u.short_addr, g_pump.water_level_pct);
+                    boot_prof_mark(BOOT_STAGE_FIRST_REPORT);
+                    radio_coex_report_received();
                     led_blink(LED_STATUS_PIN, 1, 50);
                 }
             }
@@ -545,12 +696,36 @@ static esp_err_t zb_action_handler(esp_zb_core_action_callback_id_t callback_id,
     return ESP_OK;
 }
 
+// Stack callbacks run in the Zigbee task: their duration is time the stack
+// cannot spend on other frames (zb_instr.h)
+static esp_err_t zb_action_handler(esp_zb_core_action_callback_id_t callback_id, const void *message)
+{
+    int64_t start_us = zb_instr_callback_begin();
+    TRACE(ZB_CALLBACK, callback_id);
+    esp_err_t ret = zb_action_dispatch(callback_id, message);
+    TRACE(ZB_CALLBACK_END, ret);
+    zb_instr_callback_end(ZB_CB_ACTION, start_us);
+    return ret;
+}
+
+// Every frame received, before ZCL: its LQI per source (link_quality.h).
+// Returns false so the stack goes on to process it.
+static bool zb_aps_indication_cb(esp_zb_apsde_data_ind_t ind)
+{
+    int64_t start_us = zb_instr_callback_begin();
+    link_quality_frame(ind.src_short_addr, (uint8_t)ind.lqi);
+    zb_instr_callback_end(ZB_CB_APS_INDICATION, start_us);
+    return false;
+}
+
 static void bdb_start_top_level_commissioning_cb(uint8_t mode_mask)
 {
+    int64_t start_us = zb_instr_callback_begin();
     ESP_ERROR_CHECK(esp_zb_bdb_start_top_level_commissioning(mode_mask));
+    zb_instr_callback_end(ZB_CB_ALARM, start_us);
 }
 
-void esp_zb_app_signal_handler(esp_zb_app_signal_t *signal_struct)
+static void zb_signal_dispatch(esp_zb_app_signal_t *signal_struct)
 {
     uint32_t *p_sg_p = signal_struct->p_app_signal;
     esp_err_t err_status = signal_struct->esp_err_status;
@@ -576,31 +751,42 @@ void esp_zb_app_signal_handler(esp_zb_app_signal_t *signal_struct)
             break;
 
         case ESP_ZB_BDB_SIGNAL_FORMATION:
+            metrics_inc(METRIC_JOIN_ATTEMPTS);
             if (err_status == ESP_OK) {
                 ESP_LOGI(TAG, "Network formed! PAN: 0x%04x, CH: %d",
                          esp_zb_get_pan_id(), esp_zb_get_current_channel());
+                boot_prof_mark(BOOT_STAGE_NETWORK_JOINED);
                 esp_zb_bdb_start_top_level_commissioning(ESP_ZB_BDB_MODE_NETWORK_STEERING);
                 g_zigbee_connected = true;
                 led_blink(LED_STATUS_PIN, 3, 100);
             } else {
                 ESP_LOGW(TAG, "Formation failed, retrying...");
+                metrics_inc(METRIC_JOIN_FAILURES);
                 esp_zb_scheduler_alarm((esp_zb_callback_t)bdb_start_top_level_commissioning_cb,
                                        ESP_ZB_BDB_MODE_NETWORK_FORMATION, 1000);
             }
             break;
 
         case ESP_ZB_BDB_SIGNAL_STEERING:
+            // On the coordinator steering only opens the network
+            if (g_config.node_type != NODE_TYPE_CONTROLLER) {
+                metrics_inc(METRIC_JOIN_ATTEMPTS);
+            }
             if (err_status == ESP_OK) {
                 if (g_config.node_type == NODE_TYPE_CONTROLLER) {
                     ESP_LOGI(TAG, "Network open for joining");
                 } else {
                     ESP_LOGI(TAG, "Joined network! PAN: 0x%04x, CH: %d",
                              esp_zb_get_pan_id(), esp_zb_get_current_channel());
+                    boot_prof_mark(BOOT_STAGE_NETWORK_JOINED);
                     g_zigbee_connected = true;
                     led_blink(LED_STATUS_PIN, 3, 100);
                 }
             } else {
                 ESP_LOGW(TAG, "Steering failed, retrying...");
+                if (g_config.node_type != NODE_TYPE_CONTROLLER) {
+                    metrics_inc(METRIC_JOIN_FAILURES);
+                }
                 esp_zb_scheduler_alarm((esp_zb_callback_t)bdb_start_top_level_commissioning_cb,
                                        ESP_ZB_BDB_MODE_NETWORK_STEERING, 1000);
             }
@@ -619,6 +805,13 @@ void esp_zb_app_signal_handler(esp_zb_app_signal_t *signal_struct)
     }
 }
 
+void esp_zb_app_signal_handler(esp_zb_app_signal_t *signal_struct)
+{
+    int64_t start_us = zb_instr_callback_begin();
+    zb_signal_dispatch(signal_struct);
+    zb_instr_callback_end(ZB_CB_SIGNAL, start_us);
+}
+
 /* ============================================================================
  * ZIGBEE TASK - ROLE BASED
  * ============================================================================ */
@@ -635,7 +828,8 @@ static void zigbee_task(void *pvParameters)
             zb_nwk_cfg.esp_zb_role = ESP_ZB_DEVICE_TYPE_ED;
             zb_nwk_cfg.install_code_policy = false;
             zb_nwk_cfg.nwk_cfg.zed_cfg.ed_timeout = ESP_ZB_ED_AGING_TIMEOUT_64MIN;
-            zb_nwk_cfg.nwk_cfg.zed_cfg.keep_alive = 3000;
+            zb_nwk_cfg.nwk_cfg.zed_cfg.keep_alive = SENSOR_KEEP_ALIVE_MS;
+            energy_set_poll_interval_ms(SENSOR_KEEP_ALIVE_MS);
             break;
             
         case NODE_TYPE_CONTROLLER:
@@ -687,6 +881,10 @@ static void zigbee_task(void *pvParameters)
     esp_zb_device_register(ep_list);
 
     esp_zb_core_action_handler_register(zb_action_handler);
+    esp_zb_aps_data_indication_handler_register(zb_aps_indication_cb);
+    if (g_config.node_type == NODE_TYPE_SENSOR) {
+        esp_zb_zcl_command_send_status_handler_register(zcl_send_status_cb);
+    }
     esp_err_t ret_channel = esp_zb_set_channel_mask(ESP_ZB_TRANSCEIVER_ALL_CHANNELS_MASK);
     if (ret_channel != ESP_OK) {
         ESP_LOGE(TAG, "Failed to set channel mask: %s", esp_err_to_name(ret_channel));
@@ -697,59 +895,99 @@ static void zigbee_task(void *pvParameters)
     esp_zb_stack_main_loop();
 }
 
+/* ============================================================================
+ * LAZY BLE TRIGGERS
+ * ============================================================================ */
+
+// Zigbee gets this long after boot to join before "network lost" counts
+#define BLE_NETWORK_GRACE_US    (60LL * 1000000)
+
+/**
+ * Bring BLE up when a condition the app needs to see appears. Edge-triggered
+ * so a persistent fault does not keep re-opening the fast advertising window.
+ */
+static void check_ble_triggers(bool fault)
+{
+    static bool s_network_lost = false;
+    static bool s_fault = false;
+    
+    bool network_lost = !g_zigbee_connected &&
+                        esp_timer_get_time() > BLE_NETWORK_GRACE_US;
+    if (network_lost && !s_network_lost) {
+        ESP_LOGW(TAG, "Zigbee network lost - requesting BLE");
+        ble_status_request(BLE_TRIGGER_NETWORK_LOST);
+    }
+    if (fault && !s_fault) {
+        ESP_LOGW(TAG, "Fault detected - requesting BLE");
+        ble_status_request(BLE_TRIGGER_FAULT);
+    }
+    s_network_lost = network_lost;
+    s_fault = fault;
+}
+
 /* ============================================================================
  * ROLE-SPECIFIC TASKS
  * ============================================================================ */
 
+// Battery projection at the default current table (energy.h)
+static void sensor_energy_log(void)
+{
+    static const energy_model_t model = ENERGY_MODEL_DEFAULT();
+    static int64_t last_us = 0;
+    int64_t now_us = esp_timer_get_time();
+    if (now_us - last_us < ENERGY_LOG_PERIOD_US) {
+        return;
+    }
+    last_us = now_us;
+
+    ble_adv_stats_t adv;
+    if (ble_adv_get_stats(&adv) == ESP_OK) {
+        energy_set_ble_adv(adv.adv_events, adv.radio_on_ms);
+    }
+    energy_log(&model);
+}
+
 static void sensor_task(void *pvParameters)
 {
-    uint16_t interval = g_config.report_interval_sec > 0 ? g_config.report_interval_sec : 5;
-    
     while (1) {
+        // Re-read each cycle so a new report interval applies without reboot
+        config_derived_t dc;
+        ble_provision_config_derived(&dc);
+        uint32_t interval_ms = dc.report_interval_ms;
+        
         if (!g_provisioning_mode) {
             measure_water_level();
-            send_water_level_report();
+            uint32_t sample_ms = net_time_now_ms(&g_net_time);
             
-            esp_zb_lock_acquire(portMAX_DELAY);
-            esp_zb_zcl_set_attribute_val(DEVICE_ENDPOINT, CLUSTER_WATER_LEVEL,
-                ESP_ZB_ZCL_CLUSTER_SERVER_ROLE, ATTR_WATER_LEVEL_PCT, 
-                &g_water_level_percent, false);
-            esp_zb_zcl_set_attribute_val(DEVICE_ENDPOINT, CLUSTER_WATER_LEVEL,
-                ESP_ZB_ZCL_CLUSTER_SERVER_ROLE, ATTR_WATER_LEVEL_CM, 
-                &g_water_level_cm, false);
-            esp_zb_zcl_set_attribute_val(DEVICE_ENDPOINT, CLUSTER_WATER_LEVEL,
-                ESP_ZB_ZCL_CLUSTER_SERVER_ROLE, ATTR_SENSOR_STATUS, 
-                &g_sensor_status, false);
-            esp_zb_lock_release();
+            zb_lock_held_t held = zb_instr_lock(ZB_LOCK_SITE_SENSOR_REPORT);
+            water_level_publish(&g_level);
+            publish_level_stamp(sample_ms);
+            send_water_level_report();
+            zb_instr_unlock(&held);
+            diagnostics_refresh();
 
             device_status_t status = {
                 .node_type = NODE_TYPE_SENSOR,
                 .zigbee_connected = g_zigbee_connected,
                 .uptime_seconds = g_uptime_seconds,
-                .water_level_percent = g_water_level_percent,
-                .water_level_cm = g_water_level_cm,
-                .sensor_status = g_sensor_status,
-                .pump_active = false,
-                .pump_runtime_sec = 0,
-                .last_water_level = g_water_level_percent,
                 .last_update_time = g_uptime_seconds,
-                .manual_override = false,
-                .manual_remaining_sec = 0,
-                .rssi_dbm = -50,
-                .signal_quality = g_zigbee_connected ? 80 : 0
+                .rssi_dbm = g_last_rssi,
+                .signal_quality = g_signal_quality
             };
-            ble_status_update(&status);
+            water_level_report_status(&g_level, &status);
+            check_ble_triggers(g_level.status != WATER_LEVEL_STATUS_OK);
+            sensor_energy_log();
             
-            if (g_sensor_status == 0) {
+            if (g_level.status == WATER_LEVEL_STATUS_OK) {
                 led_blink(LED_STATUS_PIN, 1, 50);
             } else {
                 led_blink(LED_STATUS_PIN, 3, 100);
             }
             
-            g_uptime_seconds += interval;
+            g_uptime_seconds += interval_ms / 1000;
         }
         
-        vTaskDelay(pdMS_TO_TICKS(interval * 1000));
+        vTaskDelay(pdMS_TO_TICKS(interval_ms));
     }
 }
 
@@ -758,37 +996,24 @@ static void controller_task(void *pvParameters)
     while (1) {
         if (!g_provisioning_mode) {
             pump_control_logic();
-            
-            uint32_t manual_remaining = 0;
-            if (g_manual_override && g_manual_override_end_time > g_uptime_seconds) {
-                manual_remaining = g_manual_override_end_time - (xTaskGetTickCount() * portTICK_PERIOD_MS / 1000);
-            }
+            net_time_beacon_tick();
+            diagnostics_refresh();
             
             device_status_t status = {
                 .node_type = NODE_TYPE_CONTROLLER,
                 .zigbee_connected = g_zigbee_connected,
                 .uptime_seconds = g_uptime_seconds,
-                .water_level_percent = g_water_level_percent,
-                .water_level_cm = 0,
-                .sensor_status = g_sensor_connected ? 0 : 1,
-                .pump_active = g_pump_running,
-                .pump_runtime_sec = g_pump_runtime_total,
-                .last_water_level = g_water_level_percent,
                 .last_update_time = g_uptime_seconds,
-                .manual_override = g_manual_override,
-                .manual_remaining_sec = manual_remaining,
                 .rssi_dbm = g_last_rssi,
                 .signal_quality = g_signal_quality
             };
-            ble_status_update(&status);
+            pump_control_report_status(&g_pump, &status);
+            check_ble_triggers(g_zigbee_connected && !g_pump.sensor_connected);
             
-            if (g_pump_running) {
-                g_pump_runtime_total++;
-            }
             g_uptime_seconds++;
             
             if (g_zigbee_connected) {
-                if (g_sensor_connected) {
+                if (g_pump.sensor_connected) {
                     gpio_set_level(LED_STATUS_PIN, 1);
                 } else {
                     static bool toggle = false;
@@ -806,6 +1031,8 @@ static void router_task(void *pvParameters)
 {
     while (1) {
         if (!g_provisioning_mode) {
+            diagnostics_refresh();
+            
             device_status_t status = {
                 .node_type = NODE_TYPE_ROUTER,
                 .zigbee_connected = g_zigbee_connected,
@@ -819,10 +1046,11 @@ static void router_task(void *pvParameters)
                 .last_update_time = 0,
                 .manual_override = false,
                 .manual_remaining_sec = 0,
-                .rssi_dbm = -50,
-                .signal_quality = g_zigbee_connected ? 90 : 0
+                .rssi_dbm = g_last_rssi,
+                .signal_quality = g_signal_quality
             };
             ble_status_update(&status);
+            check_ble_triggers(false);
             
             g_uptime_seconds++;
             
@@ -889,6 +1117,7 @@ static void start_provisioning_mode(void)
     ble_provision_start();
     
     xTaskCreate(provisioning_led_task, "prov_led", 2048, NULL, 3, NULL);
+    sysmon_start(SYSMON_PERIOD_MS);     // Task table readable over BLE while provisioning
 }
 
 static bool check_provisioning_button(void)
@@ -912,6 +1141,32 @@ static bool check_provisioning_button(void)
     return false;
 }
 
+// Short press at runtime brings BLE up (if idle) and opens a fast advertising
+// window, so the app can find the device without a reboot. With a flash
+// report capture, holding it prints the capture to the serial console.
+static void button_task(void *pvParameters)
+{
+    bool was_pressed = false;
+    uint32_t held_ms = 0;
+    
+    while (1) {
+        bool pressed = (gpio_get_level(BUTTON_PIN) == 0);
+        if (pressed && !was_pressed) {
+            ESP_LOGI(TAG, "Button pressed - requesting BLE status window");
+            ble_status_wake();
+            led_blink(LED_STATUS_PIN, 1, 100);
+        }
+        held_ms = pressed ? held_ms + BUTTON_POLL_MS : 0;
+#if REPORT_CAPTURE_MODE == CAPTURE_FLASH
+        if (held_ms == CAPTURE_DUMP_HOLD_MS) {
+            report_capture_dump_flash();
+        }
+#endif
+        was_pressed = pressed;
+        vTaskDelay(pdMS_TO_TICKS(BUTTON_POLL_MS));
+    }
+}
+
 static const char* get_role_name(prov_node_type_t type)
 {
     switch (type) {
@@ -928,6 +1183,9 @@ static const char* get_role_name(prov_node_type_t type)
 
 void app_main(void)
 {
+    // Stage marks: each one ends the stage above it (boot_prof.h)
+    boot_prof_mark(BOOT_STAGE_APP_MAIN);
+    
     // Print Cultivio brand banner
     PRINT_CULTIVIO_COMPACT();
     
@@ -935,6 +1193,7 @@ void app_main(void)
     ESP_LOGI(TAG, "║     CULTIVIO AquaSense - UNIFIED FIRMWARE      ║");
     ESP_LOGI(TAG, "║           Single Firmware, All Roles           ║");
     ESP_LOGI(TAG, "╚════════════════════════════════════════════════╝");
+    boot_prof_mark(BOOT_STAGE_BANNER);
 
     // Initialize NVS
     esp_err_t ret = nvs_flash_init();
@@ -943,6 +1202,7 @@ void app_main(void)
         ret = nvs_flash_init();
     }
     ESP_ERROR_CHECK(ret);
+    boot_prof_mark(BOOT_STAGE_NVS);
 
     // FIX: BUG #10 - Configure watchdog timer (30 seconds)
     ESP_LOGI(TAG, "Configuring watchdog timer...");
@@ -957,25 +1217,33 @@ void app_main(void)
     } else {
         ESP_LOGW(TAG, "Failed to init watchdog: %s", esp_err_to_name(ret));
     }
+    boot_prof_mark(BOOT_STAGE_WATCHDOG);
 
     // Initialize hardware
     led_init();
     button_init();
+    boot_prof_mark(BOOT_STAGE_GPIO);
     
     // Startup indication
     led_blink(LED_STATUS_PIN, 2, 200);
     ESP_LOGI(TAG, "Hardware initialized");
+    trace_start_task(TRACE_OUTPUT, tskIDLE_PRIORITY + 1);
+    boot_prof_mark(BOOT_STAGE_LED_BLINK);
 
     // Initialize provisioning (loads config from NVS)
     ble_provision_init(NODE_TYPE_SENSOR);  // Default type, will be overwritten if provisioned
     ble_provision_get_config(&g_config);
+    boot_prof_mark(BOOT_STAGE_BLE_INIT);
 
     // Check if button is pressed for provisioning mode
     bool force_provision = check_provisioning_button();
+    boot_prof_mark(BOOT_STAGE_BUTTON_CHECK);
 
     if (force_provision || !ble_provision_is_provisioned()) {
         // Enter provisioning mode
         start_provisioning_mode();
+        boot_prof_mark(BOOT_STAGE_READY);
+        boot_prof_log();
     } else {
         // Normal operation based on configured role
         ESP_LOGI(TAG, "");
@@ -984,6 +1252,10 @@ void app_main(void)
         ESP_LOGI(TAG, "╚════════════════════════════════════════════════╝");
         ESP_LOGI(TAG, "");
         
+        // Coordinator keeps 802.15.4 priority; other roles raise it per window
+        radio_coex_init(g_config.node_type == NODE_TYPE_CONTROLLER ?
+                        RADIO_COEX_MODE_ZIGBEE_FIRST : RADIO_COEX_MODE_BALANCED);
+        
         // Role-specific initialization and tasks
         switch (g_config.node_type) {
             case NODE_TYPE_SENSOR:
@@ -1000,6 +1272,11 @@ void app_main(void)
                          g_config.pump_on_threshold, g_config.pump_off_threshold,
                          g_config.pump_timeout_minutes);
                 pump_init();
+#if REPORT_CAPTURE_MODE == CAPTURE_UART
+                report_capture_start_uart();
+#elif REPORT_CAPTURE_MODE == CAPTURE_FLASH
+                report_capture_start_flash();
+#endif
                 xTaskCreate(zigbee_task, "zigbee_task", 4096, NULL, 5, NULL);
                 vTaskDelay(pdMS_TO_TICKS(2000));
                 xTaskCreate(controller_task, "control_task", 4096, NULL, 4, NULL);
@@ -1019,14 +1296,31 @@ void app_main(void)
                 return;
         }
         
-        // Start BLE status monitoring for mobile app
+        boot_prof_mark(BOOT_STAGE_ROLE_START);
+        ESP_LOGI(TAG, "Boot to role start: %lld ms, free heap %lu bytes",
+                 esp_timer_get_time() / 1000, (unsigned long)esp_get_free_heap_size());
+        
+        // BLE status is brought up on demand; the BOOT trigger restores the
+        // old always-on behaviour
         vTaskDelay(pdMS_TO_TICKS(1000));
-        ble_status_start();
+        bool ble_at_boot = (ble_status_request(BLE_TRIGGER_BOOT) == ESP_OK);
+        boot_prof_mark(BOOT_STAGE_BLE_STATUS);
+        xTaskCreate(button_task, "button_task", 2048, NULL, 2, NULL);
+        
+        // After the last task so the first sample sees every stack
+        sysmon_start(SYSMON_PERIOD_MS);
+        boot_prof_mark(BOOT_STAGE_READY);
+        boot_prof_log();
         
         ESP_LOGI(TAG, "");
         ESP_LOGI(TAG, "Device started successfully!");
-        ESP_LOGI(TAG, "Mobile app can connect via BLE to view status");
-        ESP_LOGI(TAG, "Hold button for 3 seconds to re-provision");
+        if (ble_at_boot) {
+            ESP_LOGI(TAG, "Mobile app can connect via BLE to view status");
+        } else {
+            ESP_LOGI(TAG, "BLE off until needed (button, network loss or fault)");
+        }
+        ESP_LOGI(TAG, "Press button to make BLE discoverable");
+        ESP_LOGI(TAG, "Hold button for 3 seconds at boot to re-provision");
     }
 }
 